@@ -43,6 +43,7 @@
 #include "global_control_define.h"
 #include "super_capacitance_control_task.h"
 #include "pid_auto_tune_task.h"
+#include "CAN_receive.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -60,13 +61,12 @@ osThreadId referee_tx_task_handle;
 osThreadId print_task_handle;
 osThreadId battery_voltage_handle;
 osThreadId servo_task_handle;
-osThreadId usart6tx_active_task_handle;
-osThreadId usart1tx_active_task_handle;
 osThreadId vision_rx_task_handle;
 osThreadId vision_tx_task_handle;
 osThreadId matlabSync_task_handle;
 osThreadId superCapacitanceControl_Task_Handle;
 osThreadId pidAutoTune_Task_Handle;
+osThreadId can_rx_task_handle;
 
 
 /* USER CODE END PTD */
@@ -185,6 +185,9 @@ void MX_FREERTOS_Init(void) {
 
     osThreadDef(imuTask, INS_task, osPriorityRealtime, 0, 1024);
     imuTaskHandle = osThreadCreate(osThread(imuTask), NULL);
+
+    osThreadDef(CAN_RX, can_rx_task, osPriorityRealtime, 0, 128);
+    can_rx_task_handle = osThreadCreate(osThread(CAN_RX), NULL);
     if (PID_AUTO_TUNE) {
         osThreadDef(PID_Auto_Tune_Task, pid_auto_tune_task, osPriorityRealtime, 0, 1024);
         pidAutoTune_Task_Handle = osThreadCreate(osThread(PID_Auto_Tune_Task), NULL);
@@ -198,12 +201,6 @@ void MX_FREERTOS_Init(void) {
     osThreadDef(REFEREE_RX, referee_rx_task, osPriorityRealtime, 0, 512);
     referee_rx_task_handle = osThreadCreate(osThread(REFEREE_RX), NULL);
 
-    osThreadDef(USART6TXAactiveTask, USART6TX_active_task, osPriorityRealtime, 0, 256);
-    usart6tx_active_task_handle = osThreadCreate(osThread(USART6TXAactiveTask), NULL);
-
-    osThreadDef(USART1TXAactiveTask, USART1TX_active_task, osPriorityRealtime, 0, 256);
-    usart1tx_active_task_handle = osThreadCreate(osThread(USART1TXAactiveTask), NULL);
-
     osThreadDef(REFEREE_TX, referee_tx_task, osPriorityNormal, 0, 256);
     referee_tx_task_handle = osThreadCreate(osThread(REFEREE_TX), NULL);
 
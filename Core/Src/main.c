@@ -36,6 +36,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "bsp_can.h"
+#include "CAN_receive.h"
 #include "bsp_delay.h"
 #include "bsp_usart.h"
 #include "remote_control.h"
@@ -52,6 +53,8 @@
 #include "referee_task.h"
 #include "SEGGER_RTT.h"
 #include "DWT.h"
+#include "profile.h"
+#include "flight_recorder.h"
 #if __CC_ARM
 #if EventRecorder_MODE == Enable_EventRecorder
 #include "EventRecorder.h"
@@ -150,6 +153,8 @@ int main(void)
   MX_RNG_Init();
   MX_TIM7_Init();
   /* USER CODE BEGIN 2 */
+    can_rx_init();
+    CAN_cmd_init();
     can_filter_init();
     delay_init();
     cali_param_init();
@@ -158,6 +163,10 @@ int main(void)
 //    usart1_tx_dma_init();//abundant
 //    HAL_TIM_Base_Start_IT(&htim2);
     DWT_init();
+    profile_init();
+    //复位标志记录在飞行记录仪中后清除,下次复位时只保留新的原因
+    flight_recorder_init(RCC->CSR, HAL_RCC_GetHCLKFreq());
+    __HAL_RCC_CLEAR_RESET_FLAGS();
   /* USER CODE END 2 */
 
   /* Call init function for freertos objects (in freertos.c) */
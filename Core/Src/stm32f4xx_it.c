@@ -30,6 +30,7 @@
 #include "vision_task.h"
 #include "matlab_sync_task.h"
 #include "global_control_define.h"
+#include "flight_recorder.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -54,11 +55,41 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+//没有入栈的序言,入口处的栈指针就是异常压栈的位置
+void HardFault_Handler(void) __attribute__((naked));
+void hard_fault_record(const uint32_t *stack_frame, uint32_t exc_return);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/**
+  * @brief          把HardFault时的PC,LR和故障寄存器写入飞行记录仪,连接调试器时停住,否则软复位,
+  *                 下次启动时输出记录
+  * @param[in]      stack_frame: 异常压栈的r0,r1,r2,r3,r12,lr,pc,xpsr
+  * @param[in]      exc_return: 进入异常时的lr
+  * @retval         none
+  */
+void hard_fault_record(const uint32_t *stack_frame, uint32_t exc_return) {
+    uint32_t address = (uint32_t) stack_frame;
+    uint32_t pc = 0U, lr = 0U;
+
+    //栈溢出时栈指针可能已不在RAM中,不读取压栈内容. SRAM1,SRAM2连续共128KB
+    if ((address >= SRAM1_BASE && address < SRAM1_BASE + 0x1FFE0U) ||
+        (address >= CCMDATARAM_BASE && address < CCMDATARAM_BASE + 0xFFE0U)) {
+        pc = stack_frame[6];
+        lr = stack_frame[5];
+    }
+    flight_recorder_log(FLIGHT_RECORD_FAULT, 0, (int16_t) exc_return, pc, lr);
+    flight_recorder_log(FLIGHT_RECORD_FAULT, 1, 0, SCB->CFSR, SCB->HFSR);
+    flight_recorder_log(FLIGHT_RECORD_FAULT, 2, 0, SCB->MMFAR, SCB->BFAR);
+    if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) {
+        __BKPT(0);
+        while (1) {
+        }
+    }
+    NVIC_SystemReset();
+}
 
 /* USER CODE END 0 */
 
@@ -98,6 +129,17 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
+    //EXC_RETURN的bit2选择异常压栈使用的栈指针, 主机仿真中没有异常压栈
+#if defined(__arm__)
+    __asm volatile(
+            "tst lr, #4                 \n"
+            "ite eq                     \n"
+            "mrseq r0, msp              \n"
+            "mrsne r0, psp              \n"
+            "mov r1, lr                 \n"
+            "b hard_fault_record        \n"
+            );
+#endif
 
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+飞行记录仪输出解码工具,对应固件 User/Components/support/flight_recorder.c
+
+输出格式(小端):
+  头部 magic("FDMP") version(u16) record_size(u16) tick_hz(u32) boot_cnt(u32)
+       reset_flags(u32) end_reset_flags(u32) head(u32) count(u32)
+  记录 count条,最早的在前: tick(u32) type(u8) id(u8) v0(i16) v1(u32) v2(u32)
+  尾部 crc16(u16) 0x0000, CRC16与裁判系统相同,覆盖头部和全部记录
+类型为0的记录是被故障打断未写完的记录,跳过
+
+用法:
+  RTT:  JLinkRTTLogger -Device STM32F407IG -If SWD -Speed 4000 -RTTChannel 2 dump.bin
+        复位后等待输出完成, python flight_recorder_decode.py dump.bin --csv dump.csv
+  USB:  python flight_recorder_decode.py --serial COM5 --duration 10
+  只打印最后N条: python flight_recorder_decode.py dump.bin --tail 50
+"""
+import argparse
+import csv
+import struct
+import sys
+import time
+
+DUMP_MAGIC = 0x504D4446
+HEAD_STRUCT = struct.Struct('<IHHIIIIII')
+RECORD_STRUCT = struct.Struct('<IBBhII')
+TAIL_SIZE = 4
+
+# 记录类型: (名称, v0含义, v1含义, v2含义, v1/v2格式) 格式'f'为浮点数, 'I'为整数
+RECORD_TYPES = {
+    1: ('boot', '', 'reset_flags', 'boot_cnt', 'I'),
+    2: ('gimbal', 'current', 'angle_set', 'angle', 'f'),
+    3: ('ins', 'roll_mrad', 'yaw', 'pitch', 'f'),
+    4: ('motor', 'current', 'speed_set', 'speed', 'f'),
+    5: ('power', 'scale_permille', 'power', 'buffer', 'f'),
+    6: ('task_time', 'count', 'mean_tick', 'max_tick', 'I'),
+    7: ('detect', 'event', 'time_ms', '', 'I'),
+    8: ('fault', 'exc_return', 'v1', 'v2', 'I'),
+}
+FAULT_FIELDS = {0: ('pc', 'lr'), 1: ('cfsr', 'hfsr'), 2: ('mmfar', 'bfar')}
+DETECT_EVENTS = {0: 'online', 1: 'lost', 2: 'data_error'}
+
+# RCC_CSR复位标志
+RESET_FLAGS = [(31, 'LPWR'), (30, 'WWDG'), (29, 'IWDG'), (28, 'SFT'), (27, 'POR'), (26, 'PIN'), (25, 'BOR')]
+
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ byte) & 0xFF]
+    return crc
+
+
+def reset_flags_text(flags):
+    names = [name for bit, name in RESET_FLAGS if flags & (1 << bit)]
+    return '|'.join(names) if names else 'none'
+
+
+class FlightDump:
+    """一次输出的解码结果"""
+
+    def __init__(self, head, records, crc_ok, complete):
+        (self.magic, self.version, self.record_size, self.tick_hz, self.boot_cnt, self.reset_flags,
+         self.end_reset_flags, self.head, self.count) = head
+        self.crc_ok = crc_ok
+        self.complete = complete
+        self.torn_cnt = 0
+        self.rows = []              # [(time_s, type, id, v0, v1, v2), ...]
+        self._decode(records)
+
+    def _decode(self, records):
+        base = None
+        last = None
+        tick = 0
+        for raw_tick, rec_type, rec_id, v0, v1, v2 in records:
+            if rec_type not in RECORD_TYPES:
+                self.torn_cnt += 1
+                continue
+            # DWT计数32位回绕,按有符号差值展开,允许相邻记录的时间戳稍有倒退
+            if last is None:
+                tick = raw_tick
+            else:
+                delta = (raw_tick - last) & 0xFFFFFFFF
+                if delta >= 1 << 31:
+                    delta -= 1 << 32
+                tick += delta
+            last = raw_tick
+            if base is None:
+                base = tick
+            if RECORD_TYPES[rec_type][4] == 'f':
+                v1 = struct.unpack('<f', struct.pack('<I', v1))[0]
+                v2 = struct.unpack('<f', struct.pack('<I', v2))[0]
+            self.rows.append(((tick - base) / self.tick_hz, rec_type, rec_id, v0, v1, v2))
+
+    @staticmethod
+    def format_row(row):
+        t, rec_type, rec_id, v0, v1, v2 = row
+        name, n0, n1, n2, fmt = RECORD_TYPES[rec_type]
+        if name == 'fault':
+            f1, f2 = FAULT_FIELDS.get(rec_id, ('v1', 'v2'))
+            text = '%s=0x%08X %s=0x%08X' % (f1, v1, f2, v2)
+            if rec_id == 0:
+                text = 'exc_return=0x%04X ' % (v0 & 0xFFFF) + text
+        elif name == 'detect':
+            text = 'toe=%d %s time=%dms' % (rec_id, DETECT_EVENTS.get(v0, str(v0)), v1)
+        elif name == 'boot':
+            text = 'reset=%s boot_cnt=%d' % (reset_flags_text(v1), v2)
+        elif fmt == 'f':
+            text = 'id=%d %s=%d %s=%.4f %s=%.4f' % (rec_id, n0, v0, n1, v1, n2, v2)
+        else:
+            text = 'id=%d %s=%d %s=%d %s=%d' % (rec_id, n0, v0, n1, v1, n2, v2)
+        return '%10.4f %-9s %s' % (t, name, text)
+
+
+def parse(data):
+    """从字节流中找出所有输出,返回FlightDump列表"""
+    dumps = []
+    magic = struct.pack('<I', DUMP_MAGIC)
+    pos = data.find(magic)
+    while pos >= 0:
+        if len(data) - pos < HEAD_STRUCT.size:
+            break
+        head = HEAD_STRUCT.unpack_from(data, pos)
+        record_size, count = head[2], head[8]
+        if record_size != RECORD_STRUCT.size or count > 1 << 20:
+            pos = data.find(magic, pos + 1)
+            continue
+        body_len = HEAD_STRUCT.size + count * record_size
+        available = min(count, (len(data) - pos - HEAD_STRUCT.size) // record_size)
+        records = [RECORD_STRUCT.unpack_from(data, pos + HEAD_STRUCT.size + i * record_size)
+                   for i in range(available)]
+        complete = len(data) - pos >= body_len + TAIL_SIZE
+        crc_ok = False
+        if complete:
+            crc_ok = crc16(data[pos:pos + body_len]) == struct.unpack_from('<H', data, pos + body_len)[0]
+        dumps.append(FlightDump(head, records, crc_ok, complete))
+        pos = data.find(magic, pos + (body_len if crc_ok else 1))
+    return dumps
+
+
+def read_serial(port, baud, duration):
+    import serial  # pyserial
+    data = bytearray()
+    with serial.Serial(port, baud, timeout=0.1) as ser:
+        end = time.time() + duration
+        while time.time() < end:
+            data += ser.read(4096)
+    return bytes(data)
+
+
+def write_csv(dump, path):
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['time_s', 'type', 'id', 'v0', 'v1', 'v2'])
+        for row in dump.rows:
+            writer.writerow(['%.6f' % row[0], RECORD_TYPES[row[1]][0]] + list(row[2:]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode a flight recorder dump')
+    parser.add_argument('input', nargs='?', help='captured binary file (RTT logger output)')
+    parser.add_argument('--serial', help='read from a USB CDC serial port instead of a file')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--duration', type=float, default=10.0, help='serial capture time in seconds')
+    parser.add_argument('--csv', help='write the records of the last dump to a csv file')
+    parser.add_argument('--tail', type=int, default=20, help='print the last N records, 0 for all')
+    args = parser.parse_args()
+
+    if args.serial:
+        data = read_serial(args.serial, args.baud, args.duration)
+    elif args.input:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        parser.error('an input file or --serial is required')
+
+    dumps = parse(data)
+    if not dumps:
+        print('no flight recorder dump found', file=sys.stderr)
+        sys.exit(1)
+    for dump in dumps:
+        print('boot %d: started by %s, ended by %s, %d of %d records, %d torn, crc %s%s' % (
+            dump.boot_cnt, reset_flags_text(dump.reset_flags), reset_flags_text(dump.end_reset_flags),
+            len(dump.rows), dump.head, dump.torn_cnt, 'ok' if dump.crc_ok else 'error',
+            '' if dump.complete else ' (incomplete)'))
+        for row in dump.rows:
+            if RECORD_TYPES[row[1]][0] == 'fault':
+                print('  ' + dump.format_row(row))
+    dump = dumps[-1]
+    rows = dump.rows[-args.tail:] if args.tail > 0 else dump.rows
+    for row in rows:
+        print(dump.format_row(row))
+    if args.csv:
+        write_csv(dump, args.csv)
+
+
+if __name__ == '__main__':
+    main()
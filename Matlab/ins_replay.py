@@ -0,0 +1,494 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+INS录制回放工具,录制INS_task每次融合的原始传感器样本,在上位机上按固件相同的处理链回放,
+比较不同融合算法和参数的姿态误差、每步耗时和漂移,用数据而不是猜测选择融合设置
+
+录制: global_control_define.h 中 INS_CAPTURE 设为 ON, UART1_TARGET_MODE 设为 Matlab_MODE,
+      INS_task把样本写入mag_data_tx_fifo, 上位机每发送一个'$', matlab_sync_task就把缓存的
+      样本逐帧发出, 并每秒发送一次校准参数. 录制时串口1为921600波特(UART1_BAUD_RATE),
+      115200每秒只能发出约167个69字节的样本帧, 跟不上约200Hz的INS融合
+帧格式(小端): '$' data_len(u8) type(u8) payload CRC16(u16), CRC16与裁判系统相同, 覆盖type和payload
+  'S' INS_capture_sample_t: gyro_tick accel_tick mag_tick(u32) gyro[3] accel[3] mag[3] temp angle[3](f32)
+  'C' INS_capture_cali_t:   id(u8, 0:gyro 1:accel 2:mag) tick_hz(u32) rotation_factor[3][3] offset[3] scale[3](f32)
+
+回放处理链与INS_task相同:
+  imu_mag_rotate  原始数据乘以安装旋转矩阵
+  imu_mag_cali    乘以比例系数, 与固件一样不加零漂(--offset 时加上校准零漂)
+  融合步长         陀螺仪数据就绪时刻的间隔, 首帧或间隔异常时用名义步长, 常量从 INS_task.h 读取;
+                   --compare-dt 时每个融合算法再用固定的名义步长回放一次, 比较两种步长的误差
+  融合             bsxlite 只有ARM版本的库无法在上位机运行, 录制中的固件输出作为对照;
+                   回放的融合算法在 FUSIONS 中注册, 默认提供:
+                     fusion  仓库中的 FusionAhrs.c, 用本机C编译器编译后通过ctypes调用
+                     mahony  Mahony互补滤波, 增益为比例系数
+姿态误差为回放输出与固件输出之差, 航向按第一个样本对齐; 漂移为误差和航向对时间的线性拟合斜率;
+每步耗时为上位机上的耗时, 只用于比较算法之间的相对开销, 固件上的耗时见飞行记录仪中INS_task的统计
+
+用法:
+  录制: python ins_replay.py --serial COM4 --duration 60 --save ins.bin
+  回放: python ins_replay.py ins.bin --fusion fusion mahony --gain 0.1 0.5 1 2
+        python ins_replay.py ins.bin --fusion fusion --gain 0.5 --mag --csv replay.csv
+        python ins_replay.py ins.bin --fusion mahony --compare-dt
+  坐标系不同时用 --sign 调整回放输出的 yaw,pitch,roll 符号, 例如 --sign 1,-1,1
+"""
+import argparse
+import csv
+import ctypes
+import math
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+from flight_recorder_decode import crc16  # noqa: E402
+
+INS_TASK_H = os.path.join(HERE, '..', 'User', 'Application', 'INS_task.h')
+FUSION_DIR = os.path.join(HERE, '..', 'User', 'Components', 'algorithm')
+
+SYNC_CHAR = ord('$')
+FRAME_SAMPLE = ord('S')
+FRAME_CALI = ord('C')
+SAMPLE_STRUCT = struct.Struct('<III3f3f3ff3f')
+CALI_STRUCT = struct.Struct('<BI9f3f3f')
+DEFAULT_TICK_HZ = 168000000
+IDENTITY = [[1.0, 0.0, 0.0], [0.0, 1.0, 0.0], [0.0, 0.0, 1.0]]
+
+
+def parse_ins_defines(path):
+    """读取融合名义步长和最大步长, 单位us"""
+    values = {'INS_FUSION_NOMINAL_DT_US': 9000, 'INS_FUSION_MAX_DT_US': 50000}
+    try:
+        with open(path, encoding='utf-8', errors='ignore') as f:
+            text = f.read()
+    except OSError:
+        return values
+    for name in values:
+        m = re.search(r'#define\s+%s\s+(\d+)' % name, text)
+        if m:
+            values[name] = int(m.group(1))
+    return values
+
+
+class Sample:
+    def __init__(self, fields):
+        self.gyro_tick, self.accel_tick, self.mag_tick = fields[0:3]
+        self.gyro = fields[3:6]
+        self.accel = fields[6:9]
+        self.mag = fields[9:12]
+        self.temp = fields[12]
+        self.angle = fields[13:16]
+
+
+class Capture:
+    """一次录制的解码结果"""
+
+    def __init__(self):
+        self.samples = []
+        self.cali = {}              # id: (rotation_factor, offset, scale)
+        self.tick_hz = DEFAULT_TICK_HZ
+        self.crc_error = 0
+
+    def parse(self, data):
+        pos = 0
+        end = len(data)
+        while True:
+            pos = data.find(b'$', pos)
+            if pos < 0 or end - pos < 5:
+                break
+            data_len = data[pos + 1]
+            if data_len == 0 or end - pos < data_len + 4:
+                pos += 1
+                continue
+            body = data[pos + 2:pos + 2 + data_len]
+            crc = struct.unpack_from('<H', data, pos + 2 + data_len)[0]
+            frame_type = body[0]
+            if frame_type not in (FRAME_SAMPLE, FRAME_CALI):
+                pos += 1
+                continue
+            if crc16(body) != crc:
+                self.crc_error += 1
+                pos += 1
+                continue
+            if frame_type == FRAME_SAMPLE and data_len - 1 == SAMPLE_STRUCT.size:
+                self.samples.append(Sample(SAMPLE_STRUCT.unpack_from(body, 1)))
+            elif frame_type == FRAME_CALI and data_len - 1 == CALI_STRUCT.size:
+                fields = CALI_STRUCT.unpack_from(body, 1)
+                rotation = [list(fields[2:5]), list(fields[5:8]), list(fields[8:11])]
+                self.cali[fields[0]] = (rotation, list(fields[11:14]), list(fields[14:17]))
+                self.tick_hz = fields[1]
+            pos += data_len + 4
+        return self
+
+
+def rotate(matrix, vector):
+    return [matrix[i][0] * vector[0] + matrix[i][1] * vector[1] + matrix[i][2] * vector[2] for i in range(3)]
+
+
+class Chain:
+    """imu_mag_rotate, imu_mag_cali 和融合步长, 与INS_task相同"""
+
+    def __init__(self, capture, use_offset, fixed_dt=False):
+        self.capture = capture
+        self.use_offset = use_offset
+        self.fixed_dt = fixed_dt
+        defines = parse_ins_defines(INS_TASK_H)
+        self.nominal_dt = defines['INS_FUSION_NOMINAL_DT_US'] * 1e-6
+        self.max_dt = defines['INS_FUSION_MAX_DT_US'] * 1e-6
+
+    def _cali(self, cali_id, raw):
+        rotation, offset, scale = self.capture.cali.get(cali_id, (IDENTITY, [0.0] * 3, [1.0] * 3))
+        value = rotate(rotation, raw)
+        if self.use_offset:
+            return [value[i] * scale[i] + offset[i] for i in range(3)]
+        return [value[i] * scale[i] for i in range(3)]
+
+    def steps(self):
+        """逐个样本返回 (t, dt, gyro rad/s, accel m/s2, mag uT, 固件输出的角度)"""
+        last_tick = None
+        t = 0.0
+        for sample in self.capture.samples:
+            if last_tick is None:
+                dt = 0.0
+            else:
+                dt = ((sample.gyro_tick - last_tick) & 0xFFFFFFFF) / self.capture.tick_hz
+            last_tick = sample.gyro_tick
+            # fixed_dt: 数据就绪时刻之前的固定周期步长
+            if self.fixed_dt or dt <= 0.0 or dt > self.max_dt:
+                dt = self.nominal_dt
+            t += dt
+            yield (t, dt, self._cali(0, sample.gyro), self._cali(1, sample.accel), self._cali(2, sample.mag),
+                   sample.angle)
+
+
+class FusionAhrsLib:
+    """仓库中的FusionAhrs.c, 编译为动态库后调用"""
+    _lib = None
+    _tmp_dir = None
+
+    class Vector3(ctypes.Structure):
+        _fields_ = [('x', ctypes.c_float), ('y', ctypes.c_float), ('z', ctypes.c_float)]
+
+    class Quaternion(ctypes.Structure):
+        _fields_ = [('w', ctypes.c_float), ('x', ctypes.c_float), ('y', ctypes.c_float), ('z', ctypes.c_float)]
+
+    @classmethod
+    def load(cls):
+        if cls._lib is not None:
+            return cls._lib
+        cc = os.environ.get('CC') or shutil.which('cc') or shutil.which('gcc') or shutil.which('clang')
+        if cc is None:
+            raise RuntimeError('a C compiler is required to build FusionAhrs.c')
+        cls._tmp_dir = tempfile.mkdtemp(prefix='ins_replay_')
+        lib_path = os.path.join(cls._tmp_dir, 'fusion_ahrs.so')
+        subprocess.check_call([cc, '-O2', '-shared', '-fPIC', '-I', FUSION_DIR,
+                               os.path.join(FUSION_DIR, 'FusionAhrs.c'), '-o', lib_path, '-lm'])
+        lib = ctypes.CDLL(lib_path)
+        lib.FusionAhrsInitialise.argtypes = [ctypes.c_void_p, ctypes.c_float]
+        lib.FusionAhrsSetMagneticField.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_float]
+        lib.FusionAhrsUpdate.argtypes = [ctypes.c_void_p, cls.Vector3, cls.Vector3, cls.Vector3, ctypes.c_float]
+        lib.FusionAhrsUpdateWithoutMagnetometer.argtypes = [ctypes.c_void_p, cls.Vector3, cls.Vector3,
+                                                            ctypes.c_float]
+        lib.FusionAhrsGetQuaternion.argtypes = [ctypes.c_void_p]
+        lib.FusionAhrsGetQuaternion.restype = cls.Quaternion
+        lib.FusionAhrsIsInitialising.argtypes = [ctypes.c_void_p]
+        lib.FusionAhrsIsInitialising.restype = ctypes.c_bool
+        cls._lib = lib
+        return lib
+
+    def __init__(self, gain, use_mag):
+        self.lib = self.load()
+        self.use_mag = use_mag
+        self.ahrs = ctypes.create_string_buffer(128)   # 大于sizeof(FusionAhrs)
+        self.lib.FusionAhrsInitialise(self.ahrs, gain)
+        self.lib.FusionAhrsSetMagneticField(self.ahrs, 20.0, 70.0)
+
+    def update(self, gyro, accel, mag, dt):
+        g = self.Vector3(*[math.degrees(v) for v in gyro])
+        a = self.Vector3(*accel)
+        if self.use_mag:
+            self.lib.FusionAhrsUpdate(self.ahrs, g, a, self.Vector3(*mag), dt)
+        else:
+            self.lib.FusionAhrsUpdateWithoutMagnetometer(self.ahrs, g, a, dt)
+
+    def initialising(self):
+        # 初始化期间增益从10逐渐降低, 结束时不用磁力计的更新把航向清零
+        return self.lib.FusionAhrsIsInitialising(self.ahrs)
+
+    def euler(self):
+        # 与FusionQuaternionToEulerAngles相同, 四元数表示地球相对传感器的姿态
+        q = self.lib.FusionAhrsGetQuaternion(self.ahrs)
+        half = q.w * q.w - 0.5
+        roll = math.atan2(q.y * q.z - q.w * q.x, half + q.z * q.z)
+        pitch = -math.asin(max(-1.0, min(1.0, 2.0 * (q.x * q.z + q.w * q.y))))
+        yaw = math.atan2(q.x * q.y - q.w * q.z, half + q.x * q.x)
+        return yaw, pitch, roll
+
+
+class Mahony:
+    """Mahony互补滤波, 四元数表示传感器相对地球的姿态"""
+
+    def __init__(self, gain, use_mag, ki=0.0):
+        self.kp = gain
+        self.ki = ki
+        self.use_mag = use_mag
+        self.q = [1.0, 0.0, 0.0, 0.0]
+        self.integral = [0.0, 0.0, 0.0]
+
+    def initialising(self):
+        return False
+
+    def update(self, gyro, accel, mag, dt):
+        w, x, y, z = self.q
+        gx, gy, gz = gyro
+        norm = math.sqrt(accel[0] ** 2 + accel[1] ** 2 + accel[2] ** 2)
+        if norm > 0.0:
+            ax, ay, az = accel[0] / norm, accel[1] / norm, accel[2] / norm
+            # 估计的重力方向
+            vx = 2.0 * (x * z - w * y)
+            vy = 2.0 * (w * x + y * z)
+            vz = w * w - x * x - y * y + z * z
+            ex = ay * vz - az * vy
+            ey = az * vx - ax * vz
+            ez = ax * vy - ay * vx
+            mag_norm = math.sqrt(mag[0] ** 2 + mag[1] ** 2 + mag[2] ** 2)
+            if self.use_mag and mag_norm > 0.0:
+                mx, my, mz = mag[0] / mag_norm, mag[1] / mag_norm, mag[2] / mag_norm
+                hx = 2.0 * (mx * (0.5 - y * y - z * z) + my * (x * y - w * z) + mz * (x * z + w * y))
+                hy = 2.0 * (mx * (x * y + w * z) + my * (0.5 - x * x - z * z) + mz * (y * z - w * x))
+                bx = math.sqrt(hx * hx + hy * hy)
+                bz = 2.0 * (mx * (x * z - w * y) + my * (y * z + w * x) + mz * (0.5 - x * x - y * y))
+                wx = 2.0 * (bx * (0.5 - y * y - z * z) + bz * (x * z - w * y))
+                wy = 2.0 * (bx * (x * y - w * z) + bz * (w * x + y * z))
+                wz = 2.0 * (bx * (w * y + x * z) + bz * (0.5 - x * x - y * y))
+                ex += my * wz - mz * wy
+                ey += mz * wx - mx * wz
+                ez += mx * wy - my * wx
+            if self.ki > 0.0:
+                self.integral = [self.integral[0] + self.ki * ex * dt, self.integral[1] + self.ki * ey * dt,
+                                 self.integral[2] + self.ki * ez * dt]
+            gx += self.kp * ex + self.integral[0]
+            gy += self.kp * ey + self.integral[1]
+            gz += self.kp * ez + self.integral[2]
+        half = 0.5 * dt
+        w, x, y, z = (w + (-x * gx - y * gy - z * gz) * half,
+                      x + (w * gx + y * gz - z * gy) * half,
+                      y + (w * gy - x * gz + z * gx) * half,
+                      z + (w * gz + x * gy - y * gx) * half)
+        norm = math.sqrt(w * w + x * x + y * y + z * z)
+        self.q = [w / norm, x / norm, y / norm, z / norm]
+
+    def euler(self):
+        w, x, y, z = self.q
+        yaw = math.atan2(2.0 * (w * z + x * y), 1.0 - 2.0 * (y * y + z * z))
+        pitch = math.asin(max(-1.0, min(1.0, 2.0 * (w * y - z * x))))
+        roll = math.atan2(2.0 * (w * x + y * z), 1.0 - 2.0 * (x * x + y * y))
+        return yaw, pitch, roll
+
+
+# 可回放的融合算法: 名称 -> 构造函数(gain, use_mag),
+# 实例提供 update(gyro, accel, mag, dt), initialising() 和 euler() yaw pitch roll rad
+FUSIONS = {
+    'fusion': FusionAhrsLib,
+    'mahony': Mahony,
+}
+
+
+def wrap(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+def slope(times, values):
+    """最小二乘直线斜率"""
+    n = len(times)
+    if n < 2:
+        return 0.0
+    mean_t = sum(times) / n
+    mean_v = sum(values) / n
+    den = sum((t - mean_t) ** 2 for t in times)
+    if den == 0.0:
+        return 0.0
+    return sum((t - mean_t) * (v - mean_v) for t, v in zip(times, values)) / den
+
+
+def unwrap(values):
+    out = []
+    offset = 0.0
+    last = None
+    for v in values:
+        if last is not None:
+            step = v - last
+            if step > math.pi:
+                offset -= 2.0 * math.pi
+            elif step < -math.pi:
+                offset += 2.0 * math.pi
+        last = v
+        out.append(v + offset)
+    return out
+
+
+class Result:
+    def __init__(self, name):
+        self.name = name
+        self.times = []
+        self.angles = []            # 回放输出 yaw pitch roll
+        self.errors = []            # 与固件输出之差
+        self.step_us = []
+        self.init_time = 0.0        # 融合初始化结束的时刻
+
+    def summary(self):
+        n = len(self.errors)
+        rms = [math.degrees(math.sqrt(sum(e[i] ** 2 for e in self.errors) / n)) for i in range(3)]
+        peak = [math.degrees(max(abs(e[i]) for e in self.errors)) for i in range(3)]
+        yaw_error = unwrap([e[0] for e in self.errors])
+        yaw = unwrap([a[0] for a in self.angles])
+        steps = sorted(self.step_us)
+        return {
+            'rms': rms,
+            'max': peak,
+            'error_drift': math.degrees(slope(self.times, yaw_error)) * 60.0,
+            'yaw_drift': math.degrees(slope(self.times, yaw)) * 60.0,
+            'step_mean': sum(steps) / len(steps),
+            'step_p99': steps[min(len(steps) - 1, int(len(steps) * 0.99))],
+            'step_max': steps[-1],
+            'init_time': self.init_time,
+        }
+
+
+def replay(chain, name, fusion, sign, align_yaw):
+    """融合初始化结束后才对齐航向并统计误差"""
+    result = Result(name)
+    yaw_offset = None
+    for t, dt, gyro, accel, mag, ref in chain.steps():
+        start = time.perf_counter()
+        fusion.update(gyro, accel, mag, dt)
+        result.step_us.append((time.perf_counter() - start) * 1e6)
+        if fusion.initialising():
+            result.init_time = t
+            continue
+        angle = [s * a for s, a in zip(sign, fusion.euler())]
+        if yaw_offset is None:
+            yaw_offset = wrap(ref[0] - angle[0]) if align_yaw else 0.0
+        angle[0] = wrap(angle[0] + yaw_offset)
+        result.times.append(t)
+        result.angles.append(angle)
+        result.errors.append([wrap(angle[i] - ref[i]) for i in range(3)])
+    return result
+
+
+def onboard_drift(chain):
+    times, yaw = [], []
+    for t, _, _, _, _, ref in chain.steps():
+        times.append(t)
+        yaw.append(ref[0])
+    return math.degrees(slope(times, unwrap(yaw))) * 60.0
+
+
+def capture_gaps(capture):
+    """陀螺仪时间戳间隔超过中位数1.5倍的次数, 即丢失样本的位置"""
+    ticks = [s.gyro_tick for s in capture.samples]
+    deltas = sorted((b - a) & 0xFFFFFFFF for a, b in zip(ticks, ticks[1:]))
+    if not deltas:
+        return 0, 0.0
+    median = deltas[len(deltas) // 2]
+    gaps = sum(1 for d in deltas if d > median * 1.5)
+    return gaps, median / capture.tick_hz
+
+
+def read_serial(port, baud, duration):
+    import serial  # pyserial
+    data = bytearray()
+    with serial.Serial(port, baud, timeout=0.01) as ser:
+        end = time.time() + duration
+        while time.time() < end:
+            # 每个'$'触发一次发送, 发送缓存中的全部样本
+            ser.write(b'$')
+            data += ser.read(4096)
+    return bytes(data)
+
+
+def write_csv(results, path):
+    """每行一个融合算法的一步, 包括回放输出和固件输出, 单位rad"""
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['fusion', 'time_s', 'yaw', 'pitch', 'roll', 'onboard_yaw', 'onboard_pitch', 'onboard_roll'])
+        for result in results:
+            for t, angle, error in zip(result.times, result.angles, result.errors):
+                ref = [wrap(angle[i] - error[i]) for i in range(3)]
+                writer.writerow([result.name, '%.6f' % t] + ['%.6f' % v for v in angle + ref])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='record and replay INS_task sensor captures')
+    parser.add_argument('input', nargs='?', help='captured binary file')
+    parser.add_argument('--serial', help='record from the UART1 serial port instead of a file')
+    parser.add_argument('--baud', type=int, default=921600, help='serial baud rate, UART1_BAUD_RATE of the INS_CAPTURE build')
+    parser.add_argument('--duration', type=float, default=30.0, help='serial capture time in seconds')
+    parser.add_argument('--save', help='save the raw serial capture to a file')
+    parser.add_argument('--fusion', nargs='+', default=['fusion', 'mahony'], choices=sorted(FUSIONS))
+    parser.add_argument('--gain', nargs='+', type=float, default=[0.5], help='fusion gains to compare')
+    parser.add_argument('--mag', action='store_true', help='use the magnetometer in the fusion')
+    parser.add_argument('--offset', action='store_true', help='add the calibrated zero offset in imu_mag_cali')
+    parser.add_argument('--sign', default='1,1,1', help='signs applied to the replayed yaw,pitch,roll')
+    parser.add_argument('--no-align', action='store_true', help='do not align the replayed yaw to the capture')
+    parser.add_argument('--csv', help='write the replayed and onboard angles to a csv file')
+    parser.add_argument('--compare-dt', action='store_true',
+                        help='also replay with the fixed nominal step instead of the data-ready tick intervals')
+    args = parser.parse_args()
+
+    if args.serial:
+        data = read_serial(args.serial, args.baud, args.duration)
+        if args.save:
+            with open(args.save, 'wb') as f:
+                f.write(data)
+    elif args.input:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        parser.error('an input file or --serial is required')
+
+    sign = [float(s) for s in args.sign.split(',')]
+    if len(sign) != 3:
+        parser.error('--sign needs three values')
+    capture = Capture().parse(data)
+    if not capture.samples:
+        print('no INS capture sample found', file=sys.stderr)
+        sys.exit(1)
+    gaps, period = capture_gaps(capture)
+    chain = Chain(capture, args.offset)
+    chains = [('', chain)]
+    if args.compare_dt:
+        chains.append(('/fixed', Chain(capture, args.offset, fixed_dt=True)))
+    print('%d samples, %.1f s, period %.2f ms, %d gaps, %d crc errors, calibration %s' % (
+        len(capture.samples), len(capture.samples) * period, period * 1e3, gaps, capture.crc_error,
+        'captured' if len(capture.cali) == 3 else 'missing, identity used'))
+    print('onboard yaw drift %.3f deg/min' % onboard_drift(chain))
+    print('%-16s %26s %26s %10s %10s %22s %6s' % ('fusion', 'rms err yaw/pitch/roll deg', 'max err yaw/pitch/roll deg',
+                                                 'err drift', 'yaw drift', 'step us mean/p99/max', 'init s'))
+    results = []
+    for name in args.fusion:
+        for gain in args.gain:
+            for suffix, step_chain in chains:
+                label = '%s@%g%s' % (name, gain, suffix)
+                result = replay(step_chain, label, FUSIONS[name](gain, args.mag), sign, not args.no_align)
+                if not result.errors:
+                    print('%-16s still initialising at the end of the capture' % label)
+                    continue
+                s = result.summary()
+                print('%-16s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %10.3f %10.3f %6.1f %6.1f %8.1f %6.1f' % (
+                    label, s['rms'][0], s['rms'][1], s['rms'][2], s['max'][0], s['max'][1], s['max'][2],
+                    s['error_drift'], s['yaw_drift'], s['step_mean'], s['step_p99'], s['step_max'],
+                    s['init_time']))
+                results.append(result)
+    print('drift in deg/min, step time measured on this host, errors counted after the fusion initialisation')
+    if args.csv:
+        write_csv(results, args.csv)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+在线调参工具,对应固件 User/Components/support/param_registry.c 和 PC_receive_task.c
+
+帧格式(小端,与裁判系统相同): SOF(0xA7) len(u16) seq(u8) CRC8 cmd_id(u16) data CRC16
+  0x0101 INFO  data: id(u8)
+               应答: status num id type owner min(f32) max(f32) value name[16]
+  0x0102 GET   data: id(u8)*n                 应答: status n {id value}*n
+  0x0103 SET   data: {id(u8) value}*n         应答: status 出错的序号, 整批暂存或整批拒绝
+  0x0104 SAVE  data: set(u8)                  应答: status set
+  0x0105 LOAD  data: set(u8)                  应答: status set
+应答的cmd_id为请求 | 0x8000,序号与请求相同.参数值固定4字节,浮点数的位或整数
+暂存的参数在所属控制循环的下一个周期开始时整批生效
+
+用法:
+  USB:  python param_tool.py --serial COM5 list
+        python param_tool.py --serial COM5 set yaw_spd_kp=3000 yaw_spd_ki=20
+        python param_tool.py --serial COM5 get yaw_spd_kp yaw_spd_ki
+        python param_tool.py --serial COM5 save 0
+  RTT:  python param_tool.py --jlink STM32F407IG list      (需要pylink, RTT通道3)
+"""
+import argparse
+import struct
+import sys
+import time
+
+SOF = 0xA7
+HEAD_SIZE = 5
+CMD_SIZE = 2
+TAIL_SIZE = 2
+MAX_DATA = 128
+BATCH_MAX = 24
+REPLY_FLAG = 0x8000
+RTT_CHANNEL = 3
+
+CMD_INFO = 0x0101
+CMD_GET = 0x0102
+CMD_SET = 0x0103
+CMD_SAVE = 0x0104
+CMD_LOAD = 0x0105
+
+# param_type_e -> (名称, struct格式)
+TYPES = {0: ('float', 'f'), 1: ('int32', 'i'), 2: ('uint32', 'I'), 3: ('int16', 'i'), 4: ('uint16', 'i'),
+         5: ('uint8', 'i'), 6: ('bool', 'i')}
+STATUS = {0: 'ok', 1: 'bad id', 2: 'out of range', 3: 'bad length', 4: 'unknown command', 5: 'busy',
+          6: 'flash error or no saved set', 7: 'saved set does not match the registry'}
+OWNERS = {0: 'gimbal', 1: 'chassis', 0xFF: 'none'}
+
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+def _crc8_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8C if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+CRC8_TABLE = _crc8_table()
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ byte) & 0xFF]
+    return crc
+
+
+def crc8(data, crc=0xFF):
+    for byte in data:
+        crc = CRC8_TABLE[crc ^ byte]
+    return crc
+
+
+def pack_frame(cmd_id, seq, data=b''):
+    head = struct.pack('<BHB', SOF, len(data), seq & 0xFF)
+    frame = head + bytes([crc8(head)]) + struct.pack('<H', cmd_id) + bytes(data)
+    return frame + struct.pack('<H', crc16(frame))
+
+
+class FrameParser:
+    """流式解析,feed()可按任意长度分段输入,返回[(cmd_id, seq, data), ...]"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.err_cnt = 0
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(bytes([SOF]))
+            if start < 0:
+                self.buf.clear()
+                break
+            del self.buf[:start]
+            if len(self.buf) < HEAD_SIZE:
+                break
+            if crc8(self.buf[:HEAD_SIZE - 1]) != self.buf[HEAD_SIZE - 1]:
+                self.err_cnt += 1
+                del self.buf[:1]
+                continue
+            data_len, seq = struct.unpack_from('<HB', self.buf, 1)
+            frame_len = HEAD_SIZE + CMD_SIZE + data_len + TAIL_SIZE
+            if data_len > MAX_DATA:
+                self.err_cnt += 1
+                del self.buf[:1]
+                continue
+            if len(self.buf) < frame_len:
+                break
+            if crc16(self.buf[:frame_len - TAIL_SIZE]) != struct.unpack_from('<H', self.buf, frame_len - TAIL_SIZE)[0]:
+                self.err_cnt += 1
+                del self.buf[:1]
+                continue
+            cmd_id = struct.unpack_from('<H', self.buf, HEAD_SIZE)[0]
+            frames.append((cmd_id, seq, bytes(self.buf[HEAD_SIZE + CMD_SIZE:frame_len - TAIL_SIZE])))
+            del self.buf[:frame_len]
+        return frames
+
+
+class Param:
+    def __init__(self, pid, type_id, owner, vmin, vmax, raw, name):
+        self.id = pid
+        self.type = type_id
+        self.owner = owner
+        self.min = vmin
+        self.max = vmax
+        self.name = name
+        self.value = self.decode(raw)
+
+    def decode(self, raw):
+        return struct.unpack('<' + TYPES[self.type][1], raw)[0]
+
+    def encode(self, value):
+        if TYPES[self.type][1] == 'f':
+            return struct.pack('<f', float(value))
+        value = int(round(float(value)))
+        return struct.pack('<I' if self.type == 2 else '<i', value)
+
+
+class ParamClient:
+    """请求/应答,transport需提供write(bytes)和read() -> bytes"""
+
+    def __init__(self, transport, timeout=1.0):
+        self.transport = transport
+        self.timeout = timeout
+        self.parser = FrameParser()
+        self.seq = 0
+        self.params = []
+
+    def request(self, cmd_id, data=b''):
+        self.seq = (self.seq + 1) & 0xFF
+        self.transport.write(pack_frame(cmd_id, self.seq, data))
+        end = time.time() + self.timeout
+        while time.time() < end:
+            for reply_cmd, seq, reply in self.parser.feed(self.transport.read()):
+                if reply_cmd == cmd_id | REPLY_FLAG and seq == self.seq:
+                    return reply
+            time.sleep(0.002)
+        raise TimeoutError('no reply to command 0x%04X' % cmd_id)
+
+    def load_table(self):
+        self.params = []
+        num = 1
+        pid = 0
+        while pid < num:
+            reply = self.request(CMD_INFO, bytes([pid]))
+            status, num = reply[0], reply[1]
+            if status != 0:
+                break
+            type_id, owner = reply[3], reply[4]
+            vmin, vmax = struct.unpack_from('<ff', reply, 5)
+            name = reply[17:33].split(b'\0')[0].decode('ascii', 'replace')
+            self.params.append(Param(pid, type_id, owner, vmin, vmax, reply[13:17], name))
+            pid += 1
+        return self.params
+
+    def find(self, key):
+        for param in self.params:
+            if param.name == key or str(param.id) == key or 'param%d' % param.id == key:
+                return param
+        raise KeyError('unknown parameter %s' % key)
+
+    def get(self, params):
+        values = {}
+        for i in range(0, len(params), BATCH_MAX):
+            batch = params[i:i + BATCH_MAX]
+            reply = self.request(CMD_GET, bytes(p.id for p in batch))
+            check_status(reply[0])
+            for k in range(reply[1]):
+                pid = reply[2 + k * 5]
+                param = next(p for p in batch if p.id == pid)
+                values[param.name] = param.decode(reply[3 + k * 5:7 + k * 5])
+        return values
+
+    def set(self, pairs):
+        """pairs: [(Param, value)], 超过一帧时分多批,每批各自整体生效"""
+        for i in range(0, len(pairs), BATCH_MAX):
+            batch = pairs[i:i + BATCH_MAX]
+            data = b''.join(bytes([p.id]) + p.encode(v) for p, v in batch)
+            reply = self.request(CMD_SET, data)
+            if reply[0] != 0:
+                param = batch[reply[1]][0] if reply[1] < len(batch) else None
+                raise RuntimeError('%s rejected: %s' % (param.name if param else 'batch', STATUS.get(reply[0])))
+
+    def store(self, cmd_id, set_id):
+        reply = self.request(cmd_id, bytes([set_id]))
+        check_status(reply[0])
+
+
+def check_status(status):
+    if status != 0:
+        raise RuntimeError(STATUS.get(status, 'status %d' % status))
+
+
+class SerialTransport:
+    def __init__(self, port, baud):
+        import serial  # pyserial
+        self.ser = serial.Serial(port, baud, timeout=0)
+
+    def write(self, data):
+        self.ser.write(data)
+
+    def read(self):
+        return self.ser.read(4096)
+
+
+class JLinkTransport:
+    def __init__(self, device):
+        import pylink
+        self.jlink = pylink.JLink()
+        self.jlink.open()
+        self.jlink.set_tif(pylink.enums.JLinkInterfaces.SWD)
+        self.jlink.connect(device)
+        self.jlink.rtt_start()
+        time.sleep(0.5)
+
+    def write(self, data):
+        self.jlink.rtt_write(RTT_CHANNEL, list(data))
+
+    def read(self):
+        return bytes(self.jlink.rtt_read(RTT_CHANNEL, 1024))
+
+
+def format_value(param, value):
+    if TYPES[param.type][1] == 'f':
+        return '%.6g' % value
+    return str(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='read, write and save tuning parameters')
+    parser.add_argument('--serial', help='USB CDC serial port')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--jlink', metavar='DEVICE', help='use RTT channel 3 through a J-Link, e.g. STM32F407IG')
+    parser.add_argument('--timeout', type=float, default=1.0, help='reply timeout in seconds')
+    parser.add_argument('command', choices=['list', 'get', 'set', 'save', 'load'])
+    parser.add_argument('args', nargs='*', help='names or ids for get, name=value for set, set number for save/load')
+    args = parser.parse_args()
+
+    if args.serial:
+        transport = SerialTransport(args.serial, args.baud)
+    elif args.jlink:
+        transport = JLinkTransport(args.jlink)
+    else:
+        parser.error('--serial or --jlink is required')
+
+    client = ParamClient(transport, args.timeout)
+    try:
+        if args.command in ('save', 'load'):
+            set_id = int(args.args[0]) if args.args else 0
+            client.store(CMD_SAVE if args.command == 'save' else CMD_LOAD, set_id)
+            print('%s set %d ok' % (args.command, set_id))
+            return
+        client.load_table()
+        if args.command == 'list':
+            for p in client.params:
+                print('%3d %-16s %-6s %-7s [%g, %g] %s' % (p.id, p.name, TYPES[p.type][0],
+                                                          OWNERS.get(p.owner, str(p.owner)), p.min, p.max,
+                                                          format_value(p, p.value)))
+        elif args.command == 'get':
+            params = [client.find(key) for key in args.args] if args.args else client.params
+            for name, value in client.get(params).items():
+                print('%-16s %s' % (name, format_value(client.find(name), value)))
+        else:
+            pairs = []
+            for item in args.args:
+                key, value = item.split('=', 1)
+                pairs.append((client.find(key), value))
+            client.set(pairs)
+            print('staged %d parameters' % len(pairs))
+    except (RuntimeError, KeyError, TimeoutError) as err:
+        print(err, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+扫频辨识结果解析,对应固件 User/Components/algorithm/sys_id.c 和 pid_auto_tune_task.c
+
+global_control_define.h 中 PID_AUTO_TUNE 为 ON 且 PID_AUTO_TUNE_SYS_ID 为 1 时,
+pid_auto_tune_task 在RTT通道0输出文本行:
+  SYSID,P,index,freq_hz,gain,phase_deg,quality
+  SYSID,FIT,valid,model,K,T,wn,zeta,delay_s,bandwidth_hz,peak_hz,peak_db,fit_error,point_used
+  SYSID,ABORT,point_done
+PID_AUTO_TUNE_CASCADE 不为 0 时每一级辨识前输出 CASCADE,STAGE,级,参数名,并输出每级结果:
+  CASCADE,RESULT,stage,error,kp,ki,kd,crossover_hz,pm,gm,meas_pm,meas_gm,overshoot,final_error
+  CASCADE,SAVE,set,status
+  CASCADE,END,accepted,stage_num,error
+用J-Link RTT Viewer/RTT Logger保存通道0的日志后解析,可以混有其他打印
+
+用法:
+  python sys_id_bode.py rtt_log.txt                 打印频率点、拟合参数,并画Bode图(需要matplotlib)
+  python sys_id_bode.py rtt_log.txt --csv bode.csv  导出频率点和拟合模型的响应
+  python sys_id_bode.py rtt_log.txt --no-plot
+  python sys_id_bode.py rtt_log.txt --stage 1       串级整定时取第1级的辨识结果,并打印各级整定结果
+"""
+import argparse
+import cmath
+import csv
+import math
+import re
+import sys
+
+MODELS = {0: 'K/(Ts+1)', 1: 'K wn^2/(s^2+2 zeta wn s+wn^2)', 2: 'K/(s(Ts+1))',
+          3: 'K wn^2/(s(s^2+2 zeta wn s+wn^2))'}
+FIT_FIELDS = ['valid', 'model', 'K', 'T', 'wn', 'zeta', 'delay', 'bandwidth', 'peak_freq', 'peak_db',
+              'fit_error', 'point_used']
+# 与cascade_tune_error_e相同
+CASCADE_ERRORS = ['ok', 'bad parameter or pid', 'identification aborted', 'fit failed', 'negative plant gain',
+                  'no crossover meets the margins', 'measured margin too low', 'gain not applied',
+                  'feedback limit in verification', 'step response', 'save failed', 'stopped']
+RESULT_FIELDS = ['error', 'kp', 'ki', 'kd', 'crossover', 'pm', 'gm', 'meas_pm', 'meas_gm', 'overshoot',
+                 'final_error']
+
+
+def parse(lines, stage=None):
+    """返回(points, fit, aborted), 同一日志中有多次辨识时取最后一次, stage不为None时只取该级串级整定的辨识"""
+    points, fit, aborted = [], None, False
+    current = None
+    for line in lines:
+        # RTT终端切换为0xFF加一个字符
+        line = re.sub('\xff.', '', line)
+        start = line.find('CASCADE,STAGE,')
+        if start >= 0:
+            try:
+                current = int(line[start:].split(',')[2])
+            except (IndexError, ValueError):
+                pass
+            continue
+        start = line.find('SYSID,')
+        if start < 0 or (stage is not None and current != stage):
+            continue
+        field = line[start:].strip().split(',')
+        try:
+            if field[1] == 'P':
+                index = int(field[2])
+                if index == 0:
+                    points, fit, aborted = [], None, False
+                points.append({'freq': float(field[3]), 'gain': float(field[4]),
+                               'phase': float(field[5]), 'quality': float(field[6])})
+            elif field[1] == 'FIT':
+                fit = dict(zip(FIT_FIELDS, [float(v) for v in field[2:]]))
+                fit['valid'] = int(fit['valid'])
+                fit['model'] = int(fit['model'])
+            elif field[1] == 'ABORT':
+                aborted = True
+        except (IndexError, ValueError):
+            continue
+    return points, fit, aborted
+
+
+def parse_cascade(lines):
+    """返回(stages, results, save, end), 同一日志中有多次串级整定时取最后一次"""
+    stages, results, save, end = {}, {}, None, None
+    for line in lines:
+        line = re.sub('\xff.', '', line)
+        start = line.find('CASCADE,')
+        if start < 0:
+            continue
+        field = line[start:].strip().split(',')
+        try:
+            if field[1] == 'STAGE':
+                if int(field[2]) == 0:
+                    stages, results, save, end = {}, {}, None, None
+                stages[int(field[2])] = field[3]
+            elif field[1] == 'RESULT':
+                result = dict(zip(RESULT_FIELDS, [float(v) for v in field[3:]]))
+                result['error'] = int(result['error'])
+                results[int(field[2])] = result
+            elif field[1] == 'SAVE':
+                save = (int(field[2]), int(field[3]))
+            elif field[1] == 'END':
+                end = [int(v) for v in field[2:5]]
+        except (IndexError, ValueError):
+            continue
+    return stages, results, save, end
+
+
+def report_cascade(stages, results, save, end):
+    print('%3s %-12s %10s %10s %8s %7s %7s %7s %7s %6s %6s  %s' % (
+        'i', 'param', 'kp', 'ki', 'fc Hz', 'pm', 'gm', 'meas pm', 'meas gm', 'os', 'error', 'result'))
+    for i in sorted(results):
+        r = results[i]
+        error = CASCADE_ERRORS[r['error']] if r['error'] < len(CASCADE_ERRORS) else str(r['error'])
+        # 增益裕度100为无穷或测量范围内相位未到-180度
+        print('%3d %-12s %10.5g %10.5g %8.4g %7.2f %7.2f %7.2f %7.2f %6.3f %6.3f  %s' % (
+            i, stages.get(i, '?'), r['kp'], r['ki'], r['crossover'], r['pm'], r['gm'], r['meas_pm'],
+            r['meas_gm'], r['overshoot'], r['final_error'], error))
+    if save is not None:
+        print('gains saved to parameter set %d, status %d' % save)
+    if end is not None:
+        print('cascade end: %d of %d stages accepted, %s' % (
+            end[0], end[1], CASCADE_ERRORS[end[2]] if end[2] < len(CASCADE_ERRORS) else str(end[2])))
+
+
+def model_response(fit, freq):
+    """与sys_id_model_response相同, 返回(增益, 相位deg)"""
+    s = 2j * math.pi * freq
+    if fit['model'] in (0, 2):
+        g = 1.0 / (fit['T'] * s + 1.0)
+    else:
+        wn, zeta = fit['wn'], fit['zeta']
+        g = wn * wn / (s * s + 2.0 * zeta * wn * s + wn * wn)
+    if fit['model'] in (2, 3):
+        g /= s
+    g *= fit['K'] * cmath.exp(-s * fit['delay'])
+    return abs(g), math.degrees(cmath.phase(g))
+
+
+def align_phase(phase, reference):
+    """把相位移动2pi的整数倍到参考值附近"""
+    return phase + 360.0 * round((reference - phase) / 360.0)
+
+
+def report(points, fit, aborted):
+    print('%3s %9s %12s %9s %10s %7s' % ('i', 'freq Hz', 'gain', 'gain dB', 'phase deg', 'quality'))
+    for i, p in enumerate(points):
+        db = 20.0 * math.log10(p['gain']) if p['gain'] > 0 else float('-inf')
+        print('%3d %9.4g %12.5g %9.2f %10.2f %7.3f' % (i, p['freq'], p['gain'], db, p['phase'], p['quality']))
+    if aborted:
+        print('identification aborted after %d points (feedback limit or remote lost)' % len(points))
+    if fit is None:
+        return
+    if fit['valid'] != 0:
+        print('fit failed: %d usable points, try a longer measurement or a different model' % fit['point_used'])
+        return
+    print('model %s' % MODELS.get(fit['model'], str(fit['model'])))
+    print('  K = %.6g' % fit['K'])
+    if fit['model'] in (0, 2):
+        print('  T = %.5g s (corner %.4g Hz)' % (fit['T'], 1.0 / (2.0 * math.pi * fit['T']) if fit['T'] > 0 else 0))
+    else:
+        print('  wn = %.5g rad/s (%.4g Hz), zeta = %.4g' % (fit['wn'], fit['wn'] / (2.0 * math.pi), fit['zeta']))
+    print('  delay = %.3f ms' % (fit['delay'] * 1e3))
+    print('  measured -3dB bandwidth = %s' % ('%.4g Hz' % fit['bandwidth'] if fit['bandwidth'] > 0
+                                              else 'above the last point'))
+    print('  measured peak = %.2f dB at %.4g Hz' % (fit['peak_db'], fit['peak_freq']))
+    print('  gain fit error (rms) = %.2f %% over %d points' % (fit['fit_error'] * 100.0, fit['point_used']))
+
+
+def write_csv(path, points, fit):
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['freq_hz', 'gain', 'phase_deg', 'quality', 'model_gain', 'model_phase_deg'])
+        for p in points:
+            row = [p['freq'], p['gain'], p['phase'], p['quality']]
+            if fit is not None and fit['valid'] == 0:
+                g, ph = model_response(fit, p['freq'])
+                row += [g, align_phase(ph, p['phase'])]
+            writer.writerow(row)
+
+
+def plot(points, fit):
+    import matplotlib.pyplot as plt
+    freq = [p['freq'] for p in points]
+    fig, (ax_g, ax_p) = plt.subplots(2, 1, sharex=True)
+    ax_g.semilogx(freq, [20.0 * math.log10(max(p['gain'], 1e-30)) for p in points], 'o', label='measured')
+    ax_p.semilogx(freq, [p['phase'] for p in points], 'o')
+    low = [p for p in points if p['quality'] < 0.5]
+    if low:
+        ax_g.semilogx([p['freq'] for p in low], [20.0 * math.log10(max(p['gain'], 1e-30)) for p in low], 'x',
+                      color='r', label='quality < 0.5')
+    if fit is not None and fit['valid'] == 0:
+        n = 200
+        f_model = [freq[0] * (freq[-1] / freq[0]) ** (i / (n - 1.0)) for i in range(n)]
+        response = [model_response(fit, f) for f in f_model]
+        # 模型相位对齐到第一个测量点
+        shift = align_phase(response[0][1], points[0]['phase']) - response[0][1]
+        phase = [response[0][1] + shift]
+        for g, ph in response[1:]:
+            phase.append(align_phase(ph + shift, phase[-1]))
+        ax_g.semilogx(f_model, [20.0 * math.log10(g) for g, _ in response], label='fit')
+        ax_p.semilogx(f_model, phase)
+        if fit['bandwidth'] > 0:
+            ax_g.axvline(fit['bandwidth'], linestyle='--', color='gray')
+    ax_g.set_ylabel('gain dB')
+    ax_p.set_ylabel('phase deg')
+    ax_p.set_xlabel('frequency Hz')
+    ax_g.grid(True, which='both')
+    ax_p.grid(True, which='both')
+    ax_g.legend()
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode and plot sys_id frequency response output')
+    parser.add_argument('log', help='RTT channel 0 log, - for stdin')
+    parser.add_argument('--csv', help='write points and model response to a csv file')
+    parser.add_argument('--no-plot', action='store_true')
+    parser.add_argument('--stage', type=int, help='cascade tuning stage whose identification is shown')
+    args = parser.parse_args()
+
+    if args.log == '-':
+        lines = sys.stdin.read().splitlines()
+    else:
+        with open(args.log, encoding='latin-1') as f:
+            lines = f.read().splitlines()
+    stages, results, save, end = parse_cascade(lines)
+    if results:
+        report_cascade(stages, results, save, end)
+        print()
+    points, fit, aborted = parse(lines, args.stage)
+    if not points:
+        print('no SYSID lines found', file=sys.stderr)
+        sys.exit(1)
+    report(points, fit, aborted)
+    if args.csv:
+        write_csv(args.csv, points, fit)
+    if not args.no_plot:
+        try:
+            plot(points, fit)
+        except ImportError:
+            print('matplotlib not installed, plot skipped', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,392 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+任务调度仿真工具,在上位机上按FreeRTOS固定优先级抢占调度运行整个任务集,输出各任务的
+CPU占用率、响应时间和超时次数,用于在上车之前检查优先级、周期和执行时间的修改
+
+本工具只是任务表层面的快速估算. 运行真实固件任务和外设模型的主机仿真见 test/sim
+(firmware_sim), 修改后以它的结果为准
+
+任务表(名称、线程函数、优先级、栈大小)直接从 Core/Src/freertos.c 的 osThreadDef 读取,
+修改优先级后无需改动本工具. 每个线程函数的激活方式和执行时间在 TASK_MODEL 中给出,
+中断在 ISR_MODEL 中给出, 默认值为估计值, 应该用实测值替换:
+  --recorder dump.bin  用飞行记录仪输出中的任务执行时间(profile统计点)替换默认值
+  --exec gimbal_task=60:150  指定平均/最大执行时间, 单位us
+  --prio gimbal_task=osPriorityRealtime  假设修改优先级
+  --period gimbal_task=2  假设修改周期, 单位ms
+
+调度模型:
+  中断优先于所有任务, 中断之间按到达顺序执行, 不嵌套
+  SysTick中断每1ms唤醒到期的周期任务(vTaskDelayUntil), 同优先级任务在tick时轮转
+  周期任务超过一个周期未完成记为超时, vTaskDelayUntil的唤醒时刻已过时任务不阻塞
+  通知任务(ulTaskNotifyTake)由中断唤醒, 等待期间的多次通知合并为一次, 执行时间累加
+  响应时间为激活到完成, 超过截止时间(周期任务为周期)记为超时
+
+用法:
+  python task_schedule_sim.py
+  python task_schedule_sim.py --duration 20 --recorder dump.bin
+  python task_schedule_sim.py --prio chassis_task=osPriorityHigh --exec gimbal_task=300:900
+"""
+import argparse
+import heapq
+import os
+import random
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FREERTOS_C = os.path.join(HERE, '..', 'Core', 'Src', 'freertos.c')
+CONTROL_DEFINE_H = os.path.join(HERE, '..', 'User', 'Application', 'global_control_define.h')
+
+TICK_US = 1000
+CMSIS_PRIORITY = {
+    'osPriorityIdle': 0, 'osPriorityLow': 1, 'osPriorityBelowNormal': 2, 'osPriorityNormal': 3,
+    'osPriorityAboveNormal': 4, 'osPriorityHigh': 5, 'osPriorityRealtime': 6,
+}
+
+# 线程函数: (激活方式, 周期ms或唤醒中断, 平均执行时间us, 最大执行时间us, 截止时间ms)
+# 通知任务的执行时间为每次通知的处理时间
+TASK_MODEL = {
+    'INS_task': ('notify', 'imu_spi_dma_isr', 120, 260, 5),
+    'can_rx_task': ('notify', 'can_rx_isr', 4, 10, 1),
+    'gimbal_task': ('period', 1, 60, 150, None),
+    'chassis_task': ('period', 1, 40, 120, None),
+    'pid_auto_tune_task': ('period', 1, 20, 60, None),
+    'super_capacitance_control_task': ('period', 100, 20, 60, None),
+    'vision_rx_task': ('notify', 'uart1_idle_isr', 30, 80, 10),
+    'matlab_sync_task': ('notify', 'uart1_idle_isr', 30, 80, 10),
+    'referee_rx_task': ('period', 10, 40, 150, None),
+    'servo_task': ('period', 13, 5, 15, None),
+    'calibrate_task': ('period', 1, 4, 15, None),
+    'detect_task': ('period', 10, 30, 90, None),
+    'test_task': ('period', 10, 2, 5, None),
+    'referee_tx_task': ('period', 100, 60, 250, None),
+    'vision_tx_task': ('period', 10, 20, 50, None),
+    'print_task': ('period', 60, 200, 900, None),
+    'PC_receive_task': ('period', 13, 10, 40, None),
+    'battery_voltage_task': ('period', 100, 10, 30, None),
+    'led_RGB_flow_task': ('period', 100, 10, 30, None),
+}
+
+# 中断: (频率Hz, 平均执行时间us, 最大执行时间us, 完成后触发的中断), 频率None表示只由其他中断触发
+ISR_MODEL = {
+    'systick': (1000, 2, 6, None),
+    'imu_exti_isr': (200, 2, 5, 'imu_spi_dma_isr'),         # 陀螺仪数据就绪, 启动SPI DMA
+    'imu_spi_dma_isr': (None, 4, 8, None),
+    'can_rx_isr': (9000, 1.5, 3, None),                     # 两路CAN全部电机反馈
+    'tim7_isr': (571, 15, 40, None),                        # 遥测采样
+    'uart1_idle_isr': (100, 3, 6, None),                    # 视觉数据
+    'usart6_isr': (500, 2, 5, None),                        # 裁判系统数据
+}
+
+# freertos.c中按编译开关创建的任务: 线程函数 -> (宏, 创建时的值)
+CONDITIONAL_TASKS = {
+    'pid_auto_tune_task': ('PID_AUTO_TUNE', 'ON'),
+    'vision_tx_task': ('UART1_TARGET_MODE', 'Vision_MODE'),
+    'matlab_sync_task': ('UART1_TARGET_MODE', 'Matlab_MODE'),
+}
+
+# 飞行记录仪任务执行时间记录的id, 对应profile_id_e
+PROFILE_NAMES = ['gimbal_task', 'chassis_task', 'INS_task', 'imu_exti_isr', 'imu_spi_dma_isr', 'can_rx_isr',
+                 'chassis_pid']
+
+
+def parse_freertos(path):
+    """读取osThreadDef(name, function, priority, instances, stacksz)"""
+    pattern = re.compile(r'^\s*osThreadDef\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*\d+\s*,\s*(\d+)\s*\)')
+    threads = []
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = pattern.match(line)
+            if match:
+                name, function, priority, stack = match.groups()
+                threads.append({'name': name, 'function': function, 'priority': CMSIS_PRIORITY[priority],
+                                'stack': int(stack)})
+    return threads
+
+
+def parse_defines(path):
+    """读取#define NAME VALUE, 只取第一个单词作为值"""
+    pattern = re.compile(r'^\s*#define\s+(\w+)\s+(\w+)')
+    defines = {}
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = pattern.match(line)
+            if match and match.group(1) not in defines:
+                defines[match.group(1)] = match.group(2)
+    return defines
+
+
+def exec_sampler(rng, mean, maximum):
+    """三角分布, 下限为平均值的70%, 众数使平均值不变, 最大值远大于平均值时降低下限"""
+    if maximum <= mean:
+        return lambda: mean
+    low = 0.7 * mean
+    mode = 3.0 * mean - low - maximum
+    if mode < low:
+        low = mode = max((3.0 * mean - maximum) / 2.0, 0.0)
+    return lambda: rng.triangular(low, maximum, min(mode, maximum))
+
+
+class Task:
+    def __init__(self, thread, model, rng):
+        self.name = thread['function']
+        self.priority = thread['priority']
+        self.stack = thread['stack']
+        self.kind, self.source, mean, maximum, deadline = model
+        self.mean, self.maximum = mean, maximum
+        self.sample = exec_sampler(rng, mean, maximum)
+        self.period_us = self.source * TICK_US if self.kind == 'period' else None
+        self.deadline_us = self.period_us if self.kind == 'period' else deadline * TICK_US
+        self.next_tick = 0                  # 周期任务下次唤醒的tick
+        self.ready = False
+        self.remaining = 0.0
+        self.release = 0.0
+        self.started = False
+        # 统计
+        self.busy = 0.0
+        self.misses = 0
+        self.response = []
+        self.max_latency = 0.0
+
+
+class Isr:
+    def __init__(self, name, model, rng):
+        self.name = name
+        rate, mean, maximum, self.chain = model
+        self.period_us = 1e6 / rate if rate else None
+        self.mean, self.maximum = mean, maximum
+        self.sample = exec_sampler(rng, mean, maximum)
+        self.busy = 0.0
+        self.count = 0
+
+
+class Simulator:
+    def __init__(self, tasks, isrs, rng):
+        self.tasks = tasks
+        self.isrs = isrs
+        self.time = 0.0
+        self.tick = 0
+        self.tick_phase = 0.0               # 第1个tick的时刻
+        self.idle = 0.0
+        self.arrivals = []                  # (time, seq, isr)
+        self.isr_queue = []                 # [[isr, remaining]]
+        self.seq = 0
+        self.current = None                 # 当前运行的任务
+        self.notify_map = {}
+        for task in tasks:
+            if task.kind == 'notify':
+                self.notify_map.setdefault(task.source, []).append(task)
+            else:
+                task.next_tick = 1
+        for isr in isrs.values():
+            if isr.period_us:
+                # 各中断随机相位, 避免人为的同时到达
+                phase = rng.uniform(0.0, isr.period_us)
+                if isr.name == 'systick':
+                    self.tick_phase = phase
+                self.push_arrival(phase, isr)
+
+    def push_arrival(self, time, isr):
+        heapq.heappush(self.arrivals, (time, self.seq, isr))
+        self.seq += 1
+
+    def release(self, task, exec_us):
+        if task.ready:
+            # 通知合并, 本次激活多处理一份数据
+            task.remaining += exec_us
+            return
+        task.ready = True
+        task.started = False
+        task.remaining = exec_us
+        task.release = self.time
+
+    def pick_task(self):
+        best = None
+        for task in self.tasks:
+            if task.ready and (best is None or task.priority > best.priority):
+                best = task
+        # 同优先级时继续运行当前任务, 只在tick时轮转
+        if self.current is not None and self.current.ready and best is not None and \
+                self.current.priority == best.priority:
+            return self.current
+        return best
+
+    def rotate(self):
+        """时间片轮转, 当前任务移到同优先级任务的最后"""
+        if self.current is not None and self.current.ready:
+            self.tasks.remove(self.current)
+            self.tasks.append(self.current)
+            same = [t for t in self.tasks if t.ready and t.priority == self.current.priority and t is not self.current]
+            if same:
+                self.current = same[0]
+
+    def isr_done(self, isr):
+        isr.count += 1
+        if isr.chain:
+            chained = self.isrs[isr.chain]
+            self.isr_queue.append([chained, chained.sample()])
+        for task in self.notify_map.get(isr.name, []):
+            self.release(task, task.sample())
+        if isr.name == 'systick':
+            self.tick += 1
+            for task in self.tasks:
+                if task.kind == 'period' and not task.ready and task.next_tick <= self.tick:
+                    self.release(task, task.sample())
+            self.rotate()
+
+    def task_done(self, task):
+        response = self.time - task.release
+        task.response.append(response)
+        if response > task.deadline_us:
+            task.misses += 1
+        task.ready = False
+        if task.kind == 'period':
+            # vTaskDelayUntil: 唤醒时刻已过时立即再次运行
+            task.next_tick += task.source
+            if task.next_tick <= self.tick:
+                self.release(task, task.sample())
+                task.release = self.tick_phase + (task.next_tick - 1) * TICK_US
+
+    def run(self, duration_us):
+        while self.time < duration_us:
+            next_arrival = self.arrivals[0][0] if self.arrivals else duration_us
+            if self.isr_queue:
+                entry = self.isr_queue[0]
+                isr, remaining = entry
+                step = min(remaining, next_arrival - self.time) if next_arrival > self.time else 0.0
+                if step >= remaining:
+                    step = remaining
+                self.time += step
+                isr.busy += step
+                entry[1] -= step
+                if entry[1] <= 1e-9:
+                    self.isr_queue.pop(0)
+                    self.isr_done(isr)
+            else:
+                task = self.pick_task()
+                self.current = task
+                if task is None:
+                    step = max(next_arrival - self.time, 0.0)
+                    self.idle += step
+                    self.time += step
+                else:
+                    if not task.started:
+                        task.started = True
+                        task.max_latency = max(task.max_latency, self.time - task.release)
+                    step = min(task.remaining, max(next_arrival - self.time, 0.0))
+                    self.time += step
+                    task.busy += step
+                    task.remaining -= step
+                    if task.remaining <= 1e-9:
+                        self.task_done(task)
+            while self.arrivals and self.arrivals[0][0] <= self.time:
+                _, _, isr = heapq.heappop(self.arrivals)
+                self.isr_queue.append([isr, isr.sample()])
+                self.push_arrival(self.time + isr.period_us, isr)
+
+
+def percentile(values, permille):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, len(values) * permille // 1000)]
+
+
+def load_recorder(path):
+    """从飞行记录仪输出读取各profile统计点的平均/最大执行时间, us"""
+    sys.path.insert(0, HERE)
+    import flight_recorder_decode
+    with open(path, 'rb') as f:
+        dumps = flight_recorder_decode.parse(f.read())
+    result = {}
+    for dump in dumps:
+        sums = {}
+        for row in dump.rows:
+            if flight_recorder_decode.RECORD_TYPES[row[1]][0] != 'task_time' or row[2] >= len(PROFILE_NAMES):
+                continue
+            name = PROFILE_NAMES[row[2]]
+            count, mean, maximum = row[3], row[4], row[5]
+            total, num, peak = sums.get(name, (0.0, 0, 0))
+            sums[name] = (total + mean * count, num + count, max(peak, maximum))
+        for name, (total, num, peak) in sums.items():
+            if num > 0:
+                result[name] = (total / num * 1e6 / dump.tick_hz, peak * 1e6 / dump.tick_hz)
+    return result
+
+
+def parse_overrides(items, convert):
+    result = {}
+    for item in items or []:
+        name, _, value = item.partition('=')
+        result[name] = convert(value)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='simulate the FreeRTOS task set on the host')
+    parser.add_argument('--freertos', default=FREERTOS_C, help='freertos.c with the osThreadDef table')
+    parser.add_argument('--duration', type=float, default=10.0, help='simulated time in seconds')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--recorder', help='flight recorder dump, measured execution times')
+    parser.add_argument('--exec', action='append', help='function=mean_us:max_us')
+    parser.add_argument('--prio', action='append', help='function=osPriorityXxx')
+    parser.add_argument('--period', action='append', help='function=ms for a periodic task')
+    parser.add_argument('--exclude', action='append', default=[], help='function not created in this build')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    model = dict(TASK_MODEL)
+    isr_model = dict(ISR_MODEL)
+    measured = load_recorder(args.recorder) if args.recorder else {}
+    measured.update(parse_overrides(args.exec, lambda v: tuple(float(x) for x in v.split(':'))))
+    for name, (mean, maximum) in measured.items():
+        if name in model:
+            model[name] = model[name][:2] + (mean, maximum) + model[name][4:]
+        elif name in isr_model:
+            isr_model[name] = isr_model[name][:1] + (mean, maximum) + isr_model[name][3:]
+    for name, period in parse_overrides(args.period, int).items():
+        model[name] = ('period', period) + model[name][2:]
+    priorities = parse_overrides(args.prio, lambda v: CMSIS_PRIORITY[v])
+
+    defines = parse_defines(CONTROL_DEFINE_H)
+    tasks = []
+    for thread in parse_freertos(args.freertos):
+        function = thread['function']
+        if function in args.exclude:
+            continue
+        if function in CONDITIONAL_TASKS:
+            macro, value = CONDITIONAL_TASKS[function]
+            if defines.get(macro) != value:
+                continue
+        if function not in model:
+            print('no model for %s, skipped' % function, file=sys.stderr)
+            continue
+        if function in priorities:
+            thread['priority'] = priorities[function]
+        tasks.append(Task(thread, model[function], rng))
+    isrs = {name: Isr(name, value, rng) for name, value in isr_model.items()}
+
+    sim = Simulator(list(tasks), isrs, rng)
+    duration_us = args.duration * 1e6
+    sim.run(duration_us)
+
+    print('%-32s %4s %6s %8s %7s %9s %9s %9s %9s %7s' % (
+        'task', 'prio', 'stack', 'period', 'load%', 'resp_mean', 'resp_p99', 'resp_max', 'lat_max', 'misses'))
+    for task in sorted(tasks, key=lambda t: -t.priority):
+        period = '%dms' % task.source if task.kind == 'period' else 'notify'
+        print('%-32s %4d %6d %8s %7.2f %9.1f %9.1f %9.1f %9.1f %7d' % (
+            task.name, task.priority, task.stack, period, 100.0 * task.busy / sim.time,
+            sum(task.response) / len(task.response) if task.response else 0.0,
+            percentile(task.response, 990), max(task.response) if task.response else 0.0,
+            task.max_latency, task.misses))
+    for isr in isrs.values():
+        print('%-32s %4s %6s %8s %7.2f %9.1f' % (isr.name, 'isr', '', '', 100.0 * isr.busy / sim.time,
+                                                 isr.busy / isr.count if isr.count else 0.0))
+    print('cpu load %.2f%%, simulated %.1f s, times in us' % (100.0 * (1.0 - sim.idle / sim.time), sim.time / 1e6))
+    if any(task.misses for task in tasks):
+        sys.exit(2)
+
+
+if __name__ == '__main__':
+    main()
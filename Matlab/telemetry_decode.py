@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+二进制遥测数据流解码/绘图工具,对应固件 User/Components/support/telemetry.c
+
+帧格式(小端): SOF(0xA6) type(u8) seq(u8) len(u16) payload CRC16
+  type 0x01 通道表: tick_hz(u32) channel_num(u8) {type(u8) name[15]}...
+  type 0x02 采样:   timestamp(u32) 各通道值按注册顺序紧密排列
+CRC16与裁判系统相同(初值0xFFFF,反射多项式0x8408),覆盖CRC之前的所有字节
+
+用法:
+  RTT:  JLinkRTTLogger -Device STM32F407IG -If SWD -Speed 4000 -RTTChannel 1 capture.bin
+        python telemetry_decode.py capture.bin --csv capture.csv --plot yaw_gyro_set,yaw_gyro
+  USB:  python telemetry_decode.py --serial COM5 --duration 10 --csv capture.csv
+  只列出通道: python telemetry_decode.py capture.bin --list
+"""
+import argparse
+import csv
+import struct
+import sys
+import time
+
+SOF = 0xA6
+FRAME_SCHEMA = 0x01
+FRAME_SAMPLE = 0x02
+HEAD_SIZE = 5
+TAIL_SIZE = 2
+NAME_LEN = 15
+MAX_PAYLOAD = 1024
+
+# 通道类型: telemetry_type_e -> struct格式
+CHANNEL_FORMAT = {0: 'f', 1: 'h', 2: 'I'}
+
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ byte) & 0xFF]
+    return crc
+
+
+class TelemetryDecoder:
+    """流式解码,feed()可按任意长度分段输入"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.tick_hz = None
+        self.names = []
+        self.sample_struct = None
+        self.samples = []           # [(timestamp_s, (values...)), ...]
+        self.crc_err_cnt = 0
+        self.lost_frame_cnt = 0
+        self.skip_sample_cnt = 0    # 收到通道表之前的采样
+        self._last_seq = None
+        self._tick_base = None
+        self._tick_wrap = 0
+        self._last_tick = None
+
+    def _on_schema(self, payload):
+        tick_hz, num = struct.unpack_from('<IB', payload, 0)
+        names, fmt = [], '<I'
+        for i in range(num):
+            off = 5 + i * (1 + NAME_LEN)
+            ch_type = payload[off]
+            name = payload[off + 1:off + 1 + NAME_LEN].split(b'\0', 1)[0].decode('ascii', 'replace')
+            names.append(name)
+            fmt += CHANNEL_FORMAT[ch_type]
+        if names != self.names and self.samples:
+            print('warning: channel table changed, later samples use the new table', file=sys.stderr)
+        self.tick_hz, self.names = tick_hz, names
+        self.sample_struct = struct.Struct(fmt)
+
+    def _on_sample(self, payload):
+        if self.sample_struct is None or len(payload) != self.sample_struct.size:
+            self.skip_sample_cnt += 1
+            return
+        values = self.sample_struct.unpack(payload)
+        tick = values[0]
+        # DWT计数32位回绕,展开为连续时间
+        if self._last_tick is not None and tick < self._last_tick:
+            self._tick_wrap += 1 << 32
+        self._last_tick = tick
+        tick += self._tick_wrap
+        if self._tick_base is None:
+            self._tick_base = tick
+        self.samples.append(((tick - self._tick_base) / self.tick_hz, values[1:]))
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            start = self.buf.find(bytes([SOF]))
+            if start < 0:
+                self.buf.clear()
+                return
+            del self.buf[:start]
+            if len(self.buf) < HEAD_SIZE:
+                return
+            frame_type, seq, length = struct.unpack_from('<BBH', self.buf, 1)
+            if length > MAX_PAYLOAD or frame_type not in (FRAME_SCHEMA, FRAME_SAMPLE):
+                del self.buf[0]
+                continue
+            frame_len = HEAD_SIZE + length + TAIL_SIZE
+            if len(self.buf) < frame_len:
+                return
+            frame = bytes(self.buf[:frame_len])
+            if crc16(frame[:-TAIL_SIZE]) != struct.unpack_from('<H', frame, frame_len - TAIL_SIZE)[0]:
+                # 只丢弃SOF,藏在错误数据中的真实帧仍能被找到
+                self.crc_err_cnt += 1
+                del self.buf[0]
+                continue
+            del self.buf[:frame_len]
+            if self._last_seq is not None:
+                self.lost_frame_cnt += (seq - self._last_seq - 1) & 0xFF
+            self._last_seq = seq
+            payload = frame[HEAD_SIZE:-TAIL_SIZE]
+            if frame_type == FRAME_SCHEMA:
+                self._on_schema(payload)
+            else:
+                self._on_sample(payload)
+
+
+def read_serial(decoder, port, baud, duration):
+    import serial  # pyserial
+    with serial.Serial(port, baud, timeout=0.1) as ser:
+        end = time.time() + duration
+        while time.time() < end:
+            decoder.feed(ser.read(4096))
+
+
+def write_csv(decoder, path):
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['time_s'] + decoder.names)
+        for t, values in decoder.samples:
+            writer.writerow(['%.6f' % t] + list(values))
+
+
+def plot(decoder, names):
+    import matplotlib.pyplot as plt
+    if not names:
+        names = decoder.names
+    times = [t for t, _ in decoder.samples]
+    for name in names:
+        if name not in decoder.names:
+            print('unknown channel: %s' % name, file=sys.stderr)
+            continue
+        index = decoder.names.index(name)
+        plt.plot(times, [v[index] for _, v in decoder.samples], label=name)
+    plt.xlabel('time (s)')
+    plt.grid(True)
+    plt.legend()
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode the binary telemetry stream')
+    parser.add_argument('input', nargs='?', help='captured binary file (RTT logger output)')
+    parser.add_argument('--serial', help='read from a USB CDC serial port instead of a file')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--duration', type=float, default=10.0, help='serial capture time in seconds')
+    parser.add_argument('--csv', help='write decoded samples to a csv file')
+    parser.add_argument('--plot', nargs='?', const='', help='plot channels, comma separated, empty for all')
+    parser.add_argument('--list', action='store_true', help='list channels and statistics only')
+    args = parser.parse_args()
+
+    decoder = TelemetryDecoder()
+    if args.serial:
+        read_serial(decoder, args.serial, args.baud, args.duration)
+    elif args.input:
+        with open(args.input, 'rb') as f:
+            while True:
+                chunk = f.read(65536)
+                if not chunk:
+                    break
+                decoder.feed(chunk)
+    else:
+        parser.error('an input file or --serial is required')
+
+    rate = 0.0
+    if len(decoder.samples) > 1:
+        rate = (len(decoder.samples) - 1) / decoder.samples[-1][0]
+    print('channels: %s' % ', '.join(decoder.names))
+    print('samples: %d (%.1f Hz), crc errors: %d, lost frames: %d, samples before schema: %d' % (
+        len(decoder.samples), rate, decoder.crc_err_cnt, decoder.lost_frame_cnt, decoder.skip_sample_cnt))
+    if args.list:
+        return
+    if args.csv:
+        write_csv(decoder, args.csv)
+    if args.plot is not None:
+        plot(decoder, [n for n in args.plot.split(',') if n])
+
+
+if __name__ == '__main__':
+    main()
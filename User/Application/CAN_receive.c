@@ -4,11 +4,17 @@
   * @brief      there is CAN interrupt function  to receive motor data,
   *             and CAN send function to send motor current to control motor.
   *             这里是CAN中断接收函数，接收电机数据,CAN发送函数发送电机电流控制电机.
-  * @note       
+  * @note       the rx interrupt only timestamps each frame and queues it, can_rx_task
+  *             decodes the queue into the motor data and publishes a double
+  *             buffered snapshot with the receive time of every motor.
+  *             接收中断只记录帧的接收时刻并放入队列,can_rx_task解码后更新电机数据,
+  *             并为每个电机发布带接收时刻的双缓存快照
   * @history
   *  Version    Date            Author          Modification
   *  V1.0.0     Dec-26-2018     RM              1. done
   *  V1.1.0     Nov-11-2019     RM              1. support hal lib
+  *  V1.2.0                                     1. deferred decoding and timestamped snapshots
+  *  V1.3.0                                     1. send through the per-ID can_tx scheduler
   *
   @verbatim
   ==============================================================================
@@ -29,6 +35,10 @@
 #include "detect_task.h"
 #include "print_task.h"
 #include "SEGGER_RTT.h"
+#include "profile.h"
+#include "DWT.h"
+#include "spsc_fifo.h"
+#include "can_tx.h"
 
 extern CAN_HandleTypeDef hcan1;
 extern CAN_HandleTypeDef hcan2;
@@ -62,50 +72,124 @@ extern CAN_HandleTypeDef hcan2;
         (ptr)->InputCurrent = (uint16_t)((data)[5] << 8 | (data)[4]) / 100.0f;            \
         (ptr)->Target_Power = (uint16_t)((data)[7] << 8 | (data)[6]) / 100.0f;            \
     }
+
+#define CAN_RX_FIFO_FRAME_NUM 64     //与帧大小之积须为2的幂, 在can_rx_init中检查
+//电机电流帧的最小发送间隔,控制周期1ms,同一周期内的多次更新合并为一帧
+#define CAN_CMD_MIN_INTERVAL_US 500U
+
+#define CAN_TX_PORT(hcan) (((hcan)->Instance == CAN1) ? &can1_tx_port : &can2_tx_port)
+
+//电机快照双缓存,seq每次发布加1,seq的最低位即当前可读的缓存
+typedef struct {
+    motor_snapshot_t buf[2];
+    uint32_t seq;
+} motor_snapshot_buf_t;
+
 /*
-motor data,  0:chassis motor1 3508;1:chassis motor3 3508;2:chassis motor3 3508;3:chassis motor4 3508;
-4:yaw gimbal motor 6020;5:pitch gimbal motor 6020;6:trigger motor 2006;
-电机数据, 0:底盘电机1 3508电机,  1:底盘电机2 3508电机,2:底盘电机3 3508电机,3:底盘电机4 3508电机;
-4:yaw云台电机 6020电机; 5:pitch云台电机 6020电机; 6:拨弹电机 2006电机*/
-static motor_measure_t can1_motor_data[7];
-static motor_measure_t can2_motor_data[7];
+motor data, decoded by can_rx_task only, see can_motor_e for the index.
+电机数据,仅由can_rx_task解码写入,下标见can_motor_e*/
+static motor_measure_t motor_data[CAN_MOTOR_NUM];
+static motor_snapshot_buf_t motor_snapshot[CAN_MOTOR_NUM];
 super_capacitance_measure_t super_capacitance_data;
 
-static CAN_TxHeaderTypeDef can_tx_message;
-static uint8_t can_send_data[8];
+//CAN1和CAN2接收中断抢占优先级相同,不会互相打断,因此共用一个单生产者队列
+static uint8_t can_rx_fifo_buf[CAN_RX_FIFO_FRAME_NUM * sizeof(can_rx_frame_t)];
+static spsc_fifo_t can_rx_fifo;
+static TaskHandle_t can_rx_task_local_handler;
+uint32_t can_rx_drop_cnt;
+
+can_tx_port_t can1_tx_port;
+can_tx_port_t can2_tx_port;
 
 /**
-  * @brief          hal CAN fifo call back, receive motor data
+  * @brief          发布一份电机快照,写入当前未被读取的缓存后再翻转seq
+  */
+static void motor_snapshot_publish(motor_snapshot_buf_t *p_snapshot, const motor_measure_t *p_measure,
+                                   uint32_t rx_tick) {
+    uint32_t seq = p_snapshot->seq + 1U;
+
+    p_snapshot->buf[seq & 1U].measure = *p_measure;
+    p_snapshot->buf[seq & 1U].rx_tick = rx_tick;
+    __atomic_store_n(&p_snapshot->seq, seq, __ATOMIC_SEQ_CST);
+}
+
+/**
+  * @brief          hal CAN fifo call back, only timestamps the frame and queues it for can_rx_task
   * @param[in]      hcan, the point to CAN handle
   * @retval         none
   */
 /**
-  * @brief          hal库CAN回调函数,接收电机数据
+  * @brief          hal库CAN回调函数,只记录接收时刻并把帧放入队列,由can_rx_task解码
   * @param[in]      hcan:CAN句柄指针
   * @retval         none
   */
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
     CAN_RxHeaderTypeDef rx_header;
-    uint8_t rx_data[8];
-    static uint8_t i = 0;
-    HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &rx_header, rx_data);
-    if (hcan->Instance == CAN1) {
-        switch (rx_header.StdId) {
+    can_rx_frame_t frame;
+    profile_begin(PROFILE_CAN_RX_ISR);
+    frame.rx_tick = DWT_get_tick();
+    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &rx_header, frame.data) != HAL_OK) {
+        profile_end(PROFILE_CAN_RX_ISR);
+        return;
+    }
+    frame.std_id = (uint16_t) rx_header.StdId;
+    frame.bus = (hcan->Instance == CAN1) ? CAN_RX_BUS_1 : CAN_RX_BUS_2;
+    frame.dlc = (uint8_t) rx_header.DLC;
+
+    can_tx_rx_account(CAN_TX_PORT(hcan), frame.dlc);
+
+    //只写入完整的帧,队列满时丢弃并计数
+    if (spsc_fifo_free(&can_rx_fifo) >= sizeof(can_rx_frame_t)) {
+        spsc_fifo_puts(&can_rx_fifo, (const uint8_t *) &frame, sizeof(can_rx_frame_t));
+    } else {
+        can_rx_drop_cnt++;
+    }
+
+    //wake up the task
+    //唤醒任务,任务启动前的帧留在队列中
+    if (can_rx_task_local_handler != NULL) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(can_rx_task_local_handler, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+    profile_end(PROFILE_CAN_RX_ISR);
+}
+
+/**
+  * @brief          init the can rx fifo, call before the CAN rx interrupts are enabled
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化CAN接收队列,在开启CAN接收中断前调用
+  * @param[in]      none
+  * @retval         none
+  */
+void can_rx_init(void) {
+    if (spsc_fifo_init(&can_rx_fifo, can_rx_fifo_buf, sizeof(can_rx_fifo_buf)) != 0) {
+        Error_Handler();
+    }
+}
+
+void can_rx_decode(const can_rx_frame_t *p_frame) {
+    can_motor_e motor = CAN_MOTOR_NUM;
+    uint8_t toe = 0;
+
+    if (p_frame->bus == CAN_RX_BUS_1) {
+        switch (p_frame->std_id) {
             case CAN_3508_M1_ID:
             case CAN_3508_M2_ID:
             case CAN_3508_M3_ID:
             case CAN_3508_M4_ID:
             case CAN_YAW_MOTOR_ID: {
-
                 //get motor id
-                i = rx_header.StdId - CAN_3508_M1_ID;
-                get_motor_measure(&can1_motor_data[i], rx_data);
-                detect_hook(CHASSIS_MOTOR1_TOE + i);
+                motor = (can_motor_e) (CAN_MOTOR_CHASSIS_1 + p_frame->std_id - CAN_3508_M1_ID);
+                toe = CHASSIS_MOTOR1_TOE + p_frame->std_id - CAN_3508_M1_ID;
                 break;
             }
 
             case CAN_SUPER_CAPACITANCE_RECEIVE_ID: {
-                get_super_capacitance_measure(&super_capacitance_data, rx_data);
+                get_super_capacitance_measure(&super_capacitance_data, p_frame->data);
                 detect_hook(SUPER_CAPACITANCE_TOE);
                 break;
             }
@@ -114,24 +198,29 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
                 break;
             }
         }
-
-    } else if (hcan->Instance == CAN2) {
-//        id_test = rx_header.StdId;//for_test
-        switch (rx_header.StdId) {
+    } else {
+        switch (p_frame->std_id) {
             case CAN_PITCH_MOTOR_ID: {
-
-                get_motor_measure(&can2_motor_data[5], rx_data);
-                detect_hook(PITCH_GIMBAL_MOTOR_TOE);
+                motor = CAN_MOTOR_PITCH;
+                toe = PITCH_GIMBAL_MOTOR_TOE;
+                break;
+            }
+            case CAN_3508_M1_ID: {
+                motor = CAN_MOTOR_FRIC_1;
+                id_test = p_frame->std_id - CAN_3508_M1_ID;//for_test
+                toe = CHASSIS_MOTOR1_TOE;
+                break;
+            }
+            case CAN_3508_M4_ID: {
+                motor = CAN_MOTOR_FRIC_2;
+                id_test = p_frame->std_id - CAN_3508_M1_ID;//for_test
+                toe = CHASSIS_MOTOR4_TOE;
                 break;
             }
-            case CAN_3508_M1_ID:
-            case CAN_3508_M4_ID:
             case CAN_TRIGGER_MOTOR_ID: {
-                //get motor id
-                i = rx_header.StdId - CAN_3508_M1_ID;
-                id_test = i;//for_test
-                get_motor_measure(&can2_motor_data[i], rx_data);
-                detect_hook(CHASSIS_MOTOR1_TOE + i);
+                motor = CAN_MOTOR_TRIGGER;
+                id_test = p_frame->std_id - CAN_3508_M1_ID;//for_test
+                toe = TRIGGER_MOTOR_TOE;
                 break;
             }
 
@@ -140,31 +229,172 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
             }
         }
     }
-//    switch (rx_header.StdId)
-//    {
-//        case CAN_3508_M1_ID:
-//        case CAN_3508_M2_ID:
-//        case CAN_3508_M3_ID:
-//        case CAN_3508_M4_ID:
-//        case CAN_YAW_MOTOR_ID:
-//        case CAN_PITCH_MOTOR_ID:
-//        case CAN_TRIGGER_MOTOR_ID:
-//        {
-//            static uint8_t i = 0;
-//            //get motor id
-//            i = rx_header.StdId - CAN_3508_M1_ID;
-//            get_motor_measure(&can1_motor_data[i], rx_data);
-//            detect_hook(CHASSIS_MOTOR1_TOE + i);
-//            break;
-//        }
-//
-//        default:
-//        {
-//            break;
-//        }
-//    }
+
+    if (motor != CAN_MOTOR_NUM) {
+        get_motor_measure(&motor_data[motor], p_frame->data);
+        motor_snapshot_publish(&motor_snapshot[motor], &motor_data[motor], p_frame->rx_tick);
+        detect_hook(toe);
+    }
+}
+
+/**
+  * @brief          can rx task, decodes the queued frames into the motor data and snapshots
+  * @param[in]      argument: NULL
+  * @retval         none
+  */
+/**
+  * @brief          CAN接收任务,把队列中的帧解码为电机数据和快照
+  * @param[in]      argument: NULL
+  * @retval         none
+  */
+void can_rx_task(void const *argument) {
+    can_rx_frame_t frame;
+
+    can_rx_task_local_handler = xTaskGetCurrentTaskHandle();
+    while (1) {
+        while (spsc_fifo_gets(&can_rx_fifo, (uint8_t *) &frame, sizeof(can_rx_frame_t)) ==
+               sizeof(can_rx_frame_t)) {
+            can_rx_decode(&frame);
+        }
+        //wait for the next frame
+        //等待下一帧
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+
+/**
+  * @brief          把一帧写入空闲的发送邮箱,由can_tx在临界区内调用
+  * @retval         邮箱号0~2, -1:没有空闲邮箱
+  */
+static int can_tx_mailbox_write(CAN_HandleTypeDef *hcan, uint16_t std_id, const uint8_t *p_data, uint8_t dlc) {
+    CAN_TxHeaderTypeDef tx_header;
+    uint32_t send_mail_box;
+
+    if (HAL_CAN_GetTxMailboxesFreeLevel(hcan) == 0U) {
+        return -1;
+    }
+    tx_header.StdId = std_id;
+    tx_header.IDE = CAN_ID_STD;
+    tx_header.RTR = CAN_RTR_DATA;
+    tx_header.DLC = dlc;
+    tx_header.TransmitGlobalTime = DISABLE;
+    if (HAL_CAN_AddTxMessage(hcan, &tx_header, (uint8_t *) p_data, &send_mail_box) != HAL_OK) {
+        return -1;
+    }
+    if (send_mail_box == CAN_TX_MAILBOX0) {
+        return 0;
+    } else if (send_mail_box == CAN_TX_MAILBOX1) {
+        return 1;
+    }
+    return 2;
+}
+
+static int can1_tx_write(uint16_t std_id, const uint8_t *p_data, uint8_t dlc) {
+    return can_tx_mailbox_write(&hcan1, std_id, p_data, dlc);
+}
+
+static int can2_tx_write(uint16_t std_id, const uint8_t *p_data, uint8_t dlc) {
+    return can_tx_mailbox_write(&hcan2, std_id, p_data, dlc);
+}
+
+static void can1_tx_abort(uint8_t mailbox) {
+    HAL_CAN_AbortTxRequest(&hcan1, CAN_TX_MAILBOX0 << mailbox);
+}
+
+static void can2_tx_abort(uint8_t mailbox) {
+    HAL_CAN_AbortTxRequest(&hcan2, CAN_TX_MAILBOX0 << mailbox);
+}
+
+/**
+  * @brief          由CAN初始化参数计算波特率
+  */
+static uint32_t can_bitrate(const CAN_HandleTypeDef *hcan) {
+    uint32_t tq_num = 1U + ((hcan->Init.TimeSeg1 >> CAN_BTR_TS1_Pos) + 1U) +
+                      ((hcan->Init.TimeSeg2 >> CAN_BTR_TS2_Pos) + 1U);
+    return HAL_RCC_GetPCLK1Freq() / (hcan->Init.Prescaler * tq_num);
+}
+
+/**
+  * @brief          init the CAN transmit schedulers, call before can_filter_init
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化CAN发送调度器,在can_filter_init之前调用
+  * @param[in]      none
+  * @retval         none
+  */
+void CAN_cmd_init(void) {
+    uint32_t tick_per_us = HAL_RCC_GetHCLKFreq() / 1000000U;
+    can_tx_init(&can1_tx_port, can1_tx_write, can1_tx_abort, DWT_get_tick, tick_per_us, can_bitrate(&hcan1));
+    can_tx_init(&can2_tx_port, can2_tx_write, can2_tx_abort, DWT_get_tick, tick_per_us, can_bitrate(&hcan2));
+    can_tx_slot_config(&can1_tx_port, CAN_IDENTIFIER_0X200, 8, CAN_CMD_MIN_INTERVAL_US);
+    can_tx_slot_config(&can1_tx_port, CAN_IDENTIFIER_0X1FF, 8, CAN_CMD_MIN_INTERVAL_US);
+    can_tx_slot_config(&can2_tx_port, CAN_IDENTIFIER_0X200, 8, CAN_CMD_MIN_INTERVAL_US);
+    can_tx_slot_config(&can2_tx_port, CAN_IDENTIFIER_0X1FF, 8, CAN_CMD_MIN_INTERVAL_US);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_complete_irq(CAN_TX_PORT(hcan), 0);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_complete_irq(CAN_TX_PORT(hcan), 1);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_complete_irq(CAN_TX_PORT(hcan), 2);
+}
+
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_fail_irq(CAN_TX_PORT(hcan), 0);
+}
+
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_fail_irq(CAN_TX_PORT(hcan), 1);
+}
+
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan) {
+    can_tx_fail_irq(CAN_TX_PORT(hcan), 2);
+}
+
+/**
+  * @brief          hal库CAN错误回调,自动重传关闭时无应答或仲裁失败的邮箱在这里释放
+  */
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) {
+    static const uint32_t tx_error[CAN_TX_MAILBOX_NUM] = {
+            HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0,
+            HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_TERR1,
+            HAL_CAN_ERROR_TX_ALST2 | HAL_CAN_ERROR_TX_TERR2,
+    };
+    uint8_t i;
+
+    for (i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if (hcan->ErrorCode & tx_error[i]) {
+            hcan->ErrorCode &= ~tx_error[i];
+            can_tx_fail_irq(CAN_TX_PORT(hcan), i);
+        }
+    }
 }
 
+/**
+  * @brief          电机控制电流按大端写入4个16位字段后交给发送调度器
+  */
+static void CAN_cmd_current(can_tx_port_t *p_port, uint16_t std_id, int16_t current1, int16_t current2,
+                            int16_t current3, int16_t current4) {
+    uint8_t data[8];
+    data[0] = (current1 >> 8);
+    data[1] = current1;
+    data[2] = (current2 >> 8);
+    data[3] = current2;
+    data[4] = (current3 >> 8);
+    data[5] = current3;
+    data[6] = (current4 >> 8);
+    data[7] = current4;
+    can_tx_update(p_port, std_id, 8, 0, data, 8);
+    can_tx_flush(p_port);
+}
 
 /**
   * @brief          发送电机控制电流(0x205,0x206,0x207,0x208)
@@ -175,20 +405,7 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
   * @retval         none
   */
 void CAN2_cmd_0x1ff(int16_t ID5, int16_t ID6, int16_t ID7, int16_t ID8) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = CAN_IDENTIFIER_0X1FF;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = (ID5 >> 8);
-    can_send_data[1] = ID5;
-    can_send_data[2] = (ID6 >> 8);
-    can_send_data[3] = ID6;
-    can_send_data[4] = (ID7 >> 8);
-    can_send_data[5] = ID7;
-    can_send_data[6] = (ID8 >> 8);
-    can_send_data[7] = ID8;
-    HAL_CAN_AddTxMessage(&hcan2, &can_tx_message, can_send_data, &send_mail_box);
+    CAN_cmd_current(&can2_tx_port, CAN_IDENTIFIER_0X1FF, ID5, ID6, ID7, ID8);
 }
 
 
@@ -201,20 +418,7 @@ void CAN2_cmd_0x1ff(int16_t ID5, int16_t ID6, int16_t ID7, int16_t ID8) {
   * @retval         none
   */
 void CAN1_cmd_0x1ff(int16_t ID5, int16_t ID6, int16_t ID7, int16_t ID8) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = CAN_IDENTIFIER_0X1FF;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = (ID5 >> 8);
-    can_send_data[1] = ID5;
-    can_send_data[2] = (ID6 >> 8);
-    can_send_data[3] = ID6;
-    can_send_data[4] = (ID7 >> 8);
-    can_send_data[5] = ID7;
-    can_send_data[6] = (ID8 >> 8);
-    can_send_data[7] = ID8;
-    HAL_CAN_AddTxMessage(&hcan1, &can_tx_message, can_send_data, &send_mail_box);
+    CAN_cmd_current(&can1_tx_port, CAN_IDENTIFIER_0X1FF, ID5, ID6, ID7, ID8);
 }
 
 /**
@@ -226,20 +430,7 @@ void CAN1_cmd_0x1ff(int16_t ID5, int16_t ID6, int16_t ID7, int16_t ID8) {
   * @retval         none
   */
 void CAN2_cmd_0x200(int16_t ID1, int16_t ID2, int16_t ID3, int16_t ID4) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = CAN_IDENTIFIER_0X200;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = (ID1 >> 8);
-    can_send_data[1] = ID1;
-    can_send_data[2] = (ID2 >> 8);
-    can_send_data[3] = ID2;
-    can_send_data[4] = (ID3 >> 8);
-    can_send_data[5] = ID3;
-    can_send_data[6] = (ID4 >> 8);
-    can_send_data[7] = ID4;
-    HAL_CAN_AddTxMessage(&hcan2, &can_tx_message, can_send_data, &send_mail_box);
+    CAN_cmd_current(&can2_tx_port, CAN_IDENTIFIER_0X200, ID1, ID2, ID3, ID4);
 }
 
 
@@ -252,21 +443,7 @@ void CAN2_cmd_0x200(int16_t ID1, int16_t ID2, int16_t ID3, int16_t ID4) {
   * @retval         none
   */
 void CAN1_cmd_0x200(int16_t ID1, int16_t ID2, int16_t ID3, int16_t ID4) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = CAN_IDENTIFIER_0X200;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = ID1 >> 8;
-    can_send_data[1] = ID1;
-    can_send_data[2] = ID2 >> 8;
-    can_send_data[3] = ID2;
-    can_send_data[4] = ID3 >> 8;
-    can_send_data[5] = ID3;
-    can_send_data[6] = ID4 >> 8;
-    can_send_data[7] = ID4;
-
-    HAL_CAN_AddTxMessage(&hcan1, &can_tx_message, can_send_data, &send_mail_box);
+    CAN_cmd_current(&can1_tx_port, CAN_IDENTIFIER_0X200, ID1, ID2, ID3, ID4);
 }
 
 /**
@@ -275,15 +452,11 @@ void CAN1_cmd_0x200(int16_t ID1, int16_t ID2, int16_t ID3, int16_t ID4) {
   * @retval         none
   */
 void CAN1_cmd_0x210(uint16_t Power) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = CAN_SUPER_CAPACITANCE_SENT_ID;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = Power >> 8;
-    can_send_data[1] = Power;
-
-    HAL_CAN_AddTxMessage(&hcan1, &can_tx_message, can_send_data, &send_mail_box);
+    uint8_t data[2];
+    data[0] = Power >> 8;
+    data[1] = Power;
+    can_tx_update(&can1_tx_port, CAN_SUPER_CAPACITANCE_SENT_ID, 8, 0, data, 2);
+    can_tx_flush(&can1_tx_port);
 }
 
 /**
@@ -297,21 +470,9 @@ void CAN1_cmd_0x210(uint16_t Power) {
   * @retval         none
   */
 void CAN_cmd_chassis_reset_ID(void) {
-    uint32_t send_mail_box;
-    can_tx_message.StdId = 0x700;
-    can_tx_message.IDE = CAN_ID_STD;
-    can_tx_message.RTR = CAN_RTR_DATA;
-    can_tx_message.DLC = 0x08;
-    can_send_data[0] = 0;
-    can_send_data[1] = 0;
-    can_send_data[2] = 0;
-    can_send_data[3] = 0;
-    can_send_data[4] = 0;
-    can_send_data[5] = 0;
-    can_send_data[6] = 0;
-    can_send_data[7] = 0;
-
-    HAL_CAN_AddTxMessage(&hcan1, &can_tx_message, can_send_data, &send_mail_box);
+    static const uint8_t data[8] = {0};
+    can_tx_update(&can1_tx_port, 0x700, 8, 0, data, 8);
+    can_tx_flush(&can1_tx_port);
 }
 
 
@@ -326,7 +487,7 @@ void CAN_cmd_chassis_reset_ID(void) {
   * @retval         电机数据指针
   */
 const motor_measure_t *get_yaw_gimbal_motor_measure_point(void) {
-    return &can1_motor_data[4];
+    return &motor_data[CAN_MOTOR_YAW];
 }
 
 /**
@@ -340,7 +501,7 @@ const motor_measure_t *get_yaw_gimbal_motor_measure_point(void) {
   * @retval         电机数据指针
   */
 const motor_measure_t *get_pitch_gimbal_motor_measure_point(void) {
-    return &can2_motor_data[5];
+    return &motor_data[CAN_MOTOR_PITCH];
 }
 
 
@@ -355,7 +516,7 @@ const motor_measure_t *get_pitch_gimbal_motor_measure_point(void) {
   * @retval         电机数据指针
   */
 const motor_measure_t *get_trigger_motor_measure_point(void) {
-    return &can2_motor_data[6];
+    return &motor_data[CAN_MOTOR_TRIGGER];
 }
 
 
@@ -370,15 +531,15 @@ const motor_measure_t *get_trigger_motor_measure_point(void) {
   * @retval         电机数据指针
   */
 const motor_measure_t *get_chassis_motor_measure_point(uint8_t i) {
-    return &can1_motor_data[(i & 0x03)];
+    return &motor_data[CAN_MOTOR_CHASSIS_1 + (i & 0x03)];
 }
 
 const motor_measure_t *get_trigger_motor1_measure_point(void) {
-    return &can2_motor_data[0];
+    return &motor_data[CAN_MOTOR_FRIC_1];
 }
 
 const motor_measure_t *get_trigger_motor2_measure_point(void) {
-    return &can2_motor_data[3];
+    return &motor_data[CAN_MOTOR_FRIC_2];
 }
 
 /**
@@ -388,4 +549,21 @@ const motor_measure_t *get_trigger_motor2_measure_point(void) {
   */
 const volatile super_capacitance_measure_t *get_super_capacitance_measure_point(void) {
     return &super_capacitance_data;
-}
\ No newline at end of file
+}
+
+bool can_motor_snapshot(can_motor_e motor, motor_snapshot_t *p_out) {
+    const motor_snapshot_buf_t *p_snapshot = &motor_snapshot[motor];
+    uint32_t seq;
+
+    //拷贝期间被发布了两次以上时,拷贝的缓存可能被改写,重新拷贝
+    do {
+        seq = __atomic_load_n(&p_snapshot->seq, __ATOMIC_ACQUIRE);
+        *p_out = p_snapshot->buf[seq & 1U];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&p_snapshot->seq, __ATOMIC_RELAXED) != seq);
+    return seq != 0U;
+}
+
+uint32_t can_motor_snapshot_age_us(const motor_snapshot_t *p_snapshot) {
+    return DWT_tick_to_us(DWT_get_tick() - p_snapshot->rx_tick);
+}
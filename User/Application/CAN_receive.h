@@ -4,11 +4,17 @@
   * @brief      there is CAN interrupt function  to receive motor data,
   *             and CAN send function to send motor current to control motor.
   *             这里是CAN中断接收函数，接收电机数据,CAN发送函数发送电机电流控制电机.
-  * @note       
+  * @note       the rx interrupt only timestamps each frame and queues it, can_rx_task
+  *             decodes the queue into the motor data and publishes a double
+  *             buffered snapshot with the receive time of every motor.
+  *             接收中断只记录帧的接收时刻并放入队列,can_rx_task解码后更新电机数据,
+  *             并为每个电机发布带接收时刻的双缓存快照
   * @history
   *  Version    Date            Author          Modification
   *  V1.0.0     Dec-26-2018     RM              1. done
   *  V1.1.0     Nov-11-2019     RM              1. support hal lib
+  *  V1.2.0                                     1. deferred decoding and timestamped snapshots
+  *  V1.3.0                                     1. send through the per-ID can_tx scheduler
   *
   @verbatim
   ==============================================================================
@@ -24,6 +30,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "super_capacitance_control_task.h"
+#include "can_tx.h"
 
 
 /* CAN send and receive ID */
@@ -57,8 +64,115 @@ typedef struct {
     bool init_flag;
 } motor_measure_t;
 
+//motor index of the decoded data and snapshots
+//解码后的电机数据和快照下标
+typedef enum {
+    CAN_MOTOR_CHASSIS_1 = 0,    //CAN1 0x201
+    CAN_MOTOR_CHASSIS_2,        //CAN1 0x202
+    CAN_MOTOR_CHASSIS_3,        //CAN1 0x203
+    CAN_MOTOR_CHASSIS_4,        //CAN1 0x204
+    CAN_MOTOR_YAW,              //CAN1 0x205
+    CAN_MOTOR_PITCH,            //CAN2 0x205
+    CAN_MOTOR_TRIGGER,          //CAN2 0x207
+    CAN_MOTOR_FRIC_1,           //CAN2 0x201
+    CAN_MOTOR_FRIC_2,           //CAN2 0x204
+    CAN_MOTOR_NUM,
+} can_motor_e;
+
+typedef enum {
+    CAN_RX_BUS_1 = 0,
+    CAN_RX_BUS_2,
+} can_rx_bus_e;
+
+//一帧接收数据,由接收中断写入队列
+typedef struct {
+    uint32_t rx_tick;       //接收时刻DWT计数
+    uint16_t std_id;
+    uint8_t bus;            //can_rx_bus_e
+    uint8_t dlc;
+    uint8_t data[8];
+} can_rx_frame_t;
+
+//电机数据的一致快照
+typedef struct {
+    motor_measure_t measure;
+    uint32_t rx_tick;       //产生该数据的帧的接收时刻DWT计数
+} motor_snapshot_t;
+
+extern uint32_t can_rx_drop_cnt;
+extern can_tx_port_t can1_tx_port;
+extern can_tx_port_t can2_tx_port;
+
 extern super_capacitance_measure_t super_capacitance_data;
 
+/**
+  * @brief          init the can rx fifo, call before the CAN rx interrupts are enabled
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化CAN接收队列,在开启CAN接收中断前调用
+  * @param[in]      none
+  * @retval         none
+  */
+extern void can_rx_init(void);
+
+/**
+  * @brief          decode one received frame into the motor data and publish its snapshot,
+  *                 only called by can_rx_task (or a host replay)
+  * @param[in]      p_frame: received frame
+  * @retval         none
+  */
+/**
+  * @brief          把一帧接收数据解码为电机数据并发布快照,仅由can_rx_task(或上位机回放)调用
+  * @param[in]      p_frame: 接收帧
+  * @retval         none
+  */
+extern void can_rx_decode(const can_rx_frame_t *p_frame);
+
+/**
+  * @brief          can rx task, decodes the frames queued by the CAN rx interrupts
+  * @param[in]      argument: NULL
+  * @retval         none
+  */
+/**
+  * @brief          CAN接收任务,解码接收中断放入队列的帧
+  * @param[in]      argument: NULL
+  * @retval         none
+  */
+extern void can_rx_task(void const *argument);
+
+/**
+  * @brief          copy a consistent snapshot of a motor, safe from any task
+  * @param[in]      motor: can_motor_e
+  * @param[out]     p_out: snapshot
+  * @retval         false: no frame of this motor has been received yet
+  */
+/**
+  * @brief          拷贝电机数据的一致快照,任意任务中均可调用
+  * @param[in]      motor: can_motor_e
+  * @param[out]     p_out: 快照
+  * @retval         false:尚未收到该电机的数据
+  */
+extern bool can_motor_snapshot(can_motor_e motor, motor_snapshot_t *p_out);
+
+/**
+  * @brief          快照数据的年龄,即接收时刻到现在的时间,单位us
+  */
+extern uint32_t can_motor_snapshot_age_us(const motor_snapshot_t *p_snapshot);
+
+/**
+  * @brief          init the CAN transmit schedulers, call before can_filter_init
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化CAN发送调度器,在can_filter_init之前调用
+  * @param[in]      none
+  * @retval         none
+  */
+extern void CAN_cmd_init(void);
+
 /**
   * @brief          send control current of motor (0x205, 0x206, 0x207, 0x208)
   * @param[in]      ID5: (0x205) 6020电机控制电流, 范围 [-30000,30000]
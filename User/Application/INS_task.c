@@ -29,10 +29,13 @@
 #include "ist8310driver_middleware.h"
 #include "detect_task.h"
 #include "DWT.h"
+#include "profile.h"
 #include "SEGGER_RTT.h"
 #include "fifo.h"
 #include "bsxlite_interface.h"
 #include "gimbal_task.h"
+#include "attitude_history.h"
+#include "global_control_define.h"
 
 
 #define IMU_temp_PWM(pwm)  imu_pwm_set(pwm)                    //pwm给定
@@ -85,6 +88,32 @@ static void imu_cmd_spi_dma(void);
   * @retval         none
   */
 static void ist_cmd_i2c_dma(void);
+/**
+  * @brief          update the timestamp of a sample when it is fused
+  * @param[out]     sample_time: timestamp and dt of the sensor
+  * @param[in]      tick: DWT tick latched at data ready
+  * @retval         none
+  */
+/**
+  * @brief          样本参与融合时更新其时间戳与间隔
+  * @param[out]     sample_time: 传感器的时间戳与间隔
+  * @param[in]      tick: 数据就绪时锁存的DWT计数
+  * @retval         none
+  */
+static void imu_sample_time_update(IMU_MAG_sample_time_t *sample_time, uint32_t tick);
+#if INS_CAPTURE == ON
+/**
+  * @brief          push the raw sensor sample of this fusion step into mag_data_tx_fifo
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          把本次融合的原始传感器样本写入mag_data_tx_fifo
+  * @param[in]      none
+  * @retval         none
+  */
+static void INS_capture_push(void);
+#endif
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t INS_task_stack;
@@ -110,6 +139,15 @@ volatile uint8_t accel_temp_update_flag = 0;
 volatile uint8_t mag_update_flag = 0;
 volatile uint8_t imu_start_dma_flag = 0;
 
+//数据就绪中断时刻,在外部中断记录
+static volatile uint32_t gyro_dr_tick = 0;
+static volatile uint32_t accel_dr_tick = 0;
+static volatile uint32_t mag_dr_tick = 0;
+//读取完成时锁存对应的数据就绪时刻,保证时间戳与缓存中的数据是同一个样本
+static volatile uint32_t gyro_sample_tick = 0;
+static volatile uint32_t accel_sample_tick = 0;
+static volatile uint32_t mag_sample_tick = 0;
+
 
 bmi088_real_data_t bmi088_real_data;
 ist8310_real_data_t ist8310_real_data;
@@ -136,8 +174,11 @@ float32_t INS_accel_cali[3] = {0.0f, 0.0f, 0.0f};
 float32_t INS_mag_cali[3] = {0.0f, 0.0f, 0.0f};
 float32_t INS_angle[3] = {0.0f, 0.0f, 0.0f};      //yaw-pitch-roll euler angle, unit rad.欧拉角 单位 rad
 float32_t INS_quat[4] = {1.0f, 0.0f, 0.0f, 0.0f}; //w x y z 标量在前同matlab
+IMU_MAG_timestamp_t INS_timestamp;
+attitude_history_t INS_angle_history;                //按陀螺仪采样时刻记录的欧拉角历史
 fifo_s_t mag_data_tx_fifo;
 uint8_t mag_data_tx_buf[MAG_FIFO_BUF_LENGTH];
+uint32_t INS_capture_drop_cnt;                       //fifo已满丢弃的录制样本数
 
 /**
   * @brief          imu task, init bmi088, ist8310, calculate the euler angle
@@ -182,6 +223,9 @@ void INS_task(void const *pvParameters) {
     fifo_s_init(&mag_data_tx_fifo, mag_data_tx_buf, MAG_FIFO_BUF_LENGTH);
     vector_3d_t accel_in, gyro_in;
     int32_t w_time_stamp = 0U;
+    uint32_t fusion_dt_us;
+    memset(&INS_timestamp, 0, sizeof(INS_timestamp));
+    attitude_history_init(&INS_angle_history);
     bsxlite_out_t bsxlite_fusion_out;
     bsxlite_return_t result;
     bsxlite_instance_t instance = 0x00;
@@ -198,6 +242,7 @@ void INS_task(void const *pvParameters) {
         //等待SPI DMA传输
         while (ulTaskNotifyTake(pdTRUE, portMAX_DELAY) != pdPASS) {
         }
+        profile_begin(PROFILE_INS_TASK);
 
         if (accel_temp_update_flag & (1 << IMU_MAG_UPDATE_SHFITS)) {
             accel_temp_update_flag &= ~(1 << IMU_MAG_UPDATE_SHFITS);
@@ -211,15 +256,19 @@ void INS_task(void const *pvParameters) {
             gyro_update_flag &= ~(1 << IMU_MAG_NOTIFY_SHFITS);
             BMI088_gyro_read_over(gyro_dma_rx_buf + BMI088_GYRO_RX_BUF_DATA_OFFSET, bmi088_real_data.gyro);
             DWT_get_time_interval_us(&IMU_time_record.gyro);
+            imu_sample_time_update(&INS_timestamp.gyro, gyro_sample_tick);
             accel_update_flag &= ~(1 << IMU_MAG_UPDATE_SHFITS);
             BMI088_accel_read_over(accel_dma_rx_buf + BMI088_ACCEL_RX_BUF_DATA_OFFSET, bmi088_real_data.accel,
                                    &bmi088_real_data.time);
             DWT_get_time_interval_us(&IMU_time_record.accel);
+            imu_sample_time_update(&INS_timestamp.accel, accel_sample_tick);
             mag_update_flag &= ~(1 << IMU_MAG_UPDATE_SHFITS);
             ist8310_read_over(mag_dma_rx_buf, ist8310_real_data.mag);
             DWT_get_time_interval_us(&IMU_time_record.mag);
+            imu_sample_time_update(&INS_timestamp.mag, mag_sample_tick);
             imu_mag_rotate(INS_gyro, INS_accel, INS_mag, &bmi088_real_data, &ist8310_real_data);
             imu_mag_cali(INS_gyro, INS_accel, INS_mag, INS_gyro_cali, INS_accel_cali, INS_mag_cali);
+#if INS_CAPTURE != ON
             if (fifo_s_free(&mag_data_tx_fifo)) {
                 fifo_s_puts(&mag_data_tx_fifo, (char *) INS_mag_cali, sizeof(INS_mag_cali));
 //                SEGGER_RTT_WriteString(0,"yes\r\n");
@@ -228,6 +277,7 @@ void INS_task(void const *pvParameters) {
                 fifo_s_puts(&mag_data_tx_fifo, (char *) INS_mag_cali, sizeof(INS_mag_cali));
 //                SEGGER_RTT_WriteString(0,"no\r\n");
             }
+#endif
             accel_in.x = INS_accel_cali[0];
             accel_in.y = INS_accel_cali[1];
             accel_in.z = INS_accel_cali[2];
@@ -235,7 +285,12 @@ void INS_task(void const *pvParameters) {
             gyro_in.x = INS_gyro_cali[0];
             gyro_in.y = INS_gyro_cali[1];
             gyro_in.z = INS_gyro_cali[2];
-            w_time_stamp += 9000U;
+            //以陀螺仪数据就绪的实际间隔推进融合时间戳,首帧或间隔异常时退回名义步长
+            fusion_dt_us = INS_timestamp.gyro.dt_us;
+            if (fusion_dt_us == 0U || fusion_dt_us > INS_FUSION_MAX_DT_US) {
+                fusion_dt_us = INS_FUSION_NOMINAL_DT_US;
+            }
+            w_time_stamp += (int32_t) fusion_dt_us;
             result = bsxlite_do_step(&instance,
                                      w_time_stamp,
                                      &accel_in,
@@ -283,6 +338,10 @@ void INS_task(void const *pvParameters) {
 //            }
 
             INS_angle[2] = bsxlite_fusion_out.orientation.roll;
+            attitude_history_push(&INS_angle_history, INS_timestamp.gyro.tick, INS_angle);
+#if INS_CAPTURE == ON
+            INS_capture_push();
+#endif
 
             INS_quat[0] = bsxlite_fusion_out.rotation_vector.w;
             INS_quat[1] = bsxlite_fusion_out.rotation_vector.x;
@@ -292,7 +351,10 @@ void INS_task(void const *pvParameters) {
 #if INCLUDE_uxTaskGetStackHighWaterMark
             INS_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
+            profile_end(PROFILE_INS_TASK);
             vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(9));
+        } else {
+            profile_end(PROFILE_INS_TASK);
         }
     }
 
@@ -357,6 +419,49 @@ void imu_mag_rotate(float32_t gyro[3], float32_t accel[3], float32_t mag[3], bmi
     }
 }
 
+/**
+  * @brief          update the timestamp of a sample when it is fused
+  * @param[out]     sample_time: timestamp and dt of the sensor
+  * @param[in]      tick: DWT tick latched at data ready
+  * @retval         none
+  */
+/**
+  * @brief          样本参与融合时更新其时间戳与间隔
+  * @param[out]     sample_time: 传感器的时间戳与间隔
+  * @param[in]      tick: 数据就绪时锁存的DWT计数
+  * @retval         none
+  */
+static void imu_sample_time_update(IMU_MAG_sample_time_t *sample_time, uint32_t tick) {
+    //首个样本没有可参考的上一时刻,间隔记为0
+    if (sample_time->tick == 0U) {
+        sample_time->dt_us = 0U;
+    } else {
+        sample_time->dt_us = DWT_tick_to_us(tick - sample_time->tick);
+    }
+    sample_time->tick = tick;
+}
+
+#if INS_CAPTURE == ON
+static void INS_capture_push(void) {
+    INS_capture_sample_t sample;
+
+    //fifo满时丢弃新样本而不是清空,上位机由时间戳的间断发现丢失
+    if (fifo_s_free(&mag_data_tx_fifo) < (int) sizeof(sample)) {
+        INS_capture_drop_cnt++;
+        return;
+    }
+    sample.gyro_tick = INS_timestamp.gyro.tick;
+    sample.accel_tick = INS_timestamp.accel.tick;
+    sample.mag_tick = INS_timestamp.mag.tick;
+    memcpy(sample.gyro, bmi088_real_data.gyro, sizeof(sample.gyro));
+    memcpy(sample.accel, bmi088_real_data.accel, sizeof(sample.accel));
+    memcpy(sample.mag, ist8310_real_data.mag, sizeof(sample.mag));
+    sample.temp = bmi088_real_data.temp;
+    memcpy(sample.angle, INS_angle, sizeof(sample.angle));
+    fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample));
+}
+#endif
+
 /**
   * @brief          control the temperature of bmi088
   * @param[in]      temp: the temperature of bmi088
@@ -544,6 +649,36 @@ const float32_t *get_INS_angle_point(void) {
     return INS_angle;
 }
 
+/**
+  * @brief          get the data ready timestamp and dt of the last fused gyro, accel and mag sample
+  * @param[in]      none
+  * @retval         the point of INS_timestamp
+  */
+/**
+  * @brief          获取最近一次参与融合的陀螺仪,加速度计,磁力计样本的数据就绪时刻与间隔
+  * @param[in]      none
+  * @retval         INS_timestamp的指针
+  */
+const IMU_MAG_timestamp_t *get_INS_timestamp_point(void) {
+    return &INS_timestamp;
+}
+
+/**
+  * @brief          get the euler angle at a past DWT tick, interpolated from the angle history
+  * @param[in]      tick: DWT tick
+  * @param[out]     angle: 0:yaw, 1:pitch, 2:roll unit rad
+  * @retval         attitude_history_result_e
+  */
+/**
+  * @brief          获取过去某一DWT时刻的欧拉角,由欧拉角历史插值得到
+  * @param[in]      tick: DWT计数
+  * @param[out]     angle: 0:yaw, 1:pitch, 2:roll 单位 rad
+  * @retval         attitude_history_result_e
+  */
+attitude_history_result_e get_INS_angle_at(uint32_t tick, float32_t angle[3]) {
+    return attitude_history_lookup(&INS_angle_history, tick, angle);
+}
+
 /**
   * @brief          get the rotation speed, 0:x-axis, 1:y-axis, 2:roll-axis,unit rad/s
   * @param[in]      none
@@ -586,8 +721,10 @@ extern const float32_t *get_mag_data_point(void) {
 
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    profile_begin(PROFILE_IMU_EXTI_ISR);
     if (GPIO_Pin == INT1_ACCEL_Pin) {
         detect_hook(BOARD_ACCEL_TOE);
+        accel_dr_tick = DWT_get_tick();
         accel_update_flag |= 1 << IMU_MAG_DR_SHFITS;
         accel_temp_update_flag |= 1 << IMU_MAG_DR_SHFITS;
         if (imu_start_dma_flag) {
@@ -595,12 +732,14 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
         }
     } else if (GPIO_Pin == INT1_GYRO_Pin) {
         detect_hook(BOARD_GYRO_TOE);
+        gyro_dr_tick = DWT_get_tick();
         gyro_update_flag |= 1 << IMU_MAG_DR_SHFITS;
         if (imu_start_dma_flag) {
             imu_cmd_spi_dma();
         }
     } else if (GPIO_Pin == DRDY_IST8310_Pin) {
         detect_hook(BOARD_MAG_TOE);
+        mag_dr_tick = DWT_get_tick();
         mag_update_flag |= 1 << IMU_MAG_DR_SHFITS;
         if (imu_start_dma_flag) {
             ist_cmd_i2c_dma();
@@ -617,8 +756,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
         }
 
     }
-
-
+    profile_end(PROFILE_IMU_EXTI_ISR);
 }
 
 /**
@@ -704,7 +842,7 @@ static void imu_cmd_spi_dma(void) {
 
 
 void DMA2_Stream2_IRQHandler(void) {
-
+    profile_begin(PROFILE_IMU_SPI_DMA_ISR);
     if (__HAL_DMA_GET_FLAG(hspi1.hdmarx, __HAL_DMA_GET_TC_FLAG_INDEX(hspi1.hdmarx)) != RESET) {
         __HAL_DMA_CLEAR_FLAG(hspi1.hdmarx, __HAL_DMA_GET_TC_FLAG_INDEX(hspi1.hdmarx));
 
@@ -713,6 +851,7 @@ void DMA2_Stream2_IRQHandler(void) {
         if (gyro_update_flag & (1 << IMU_MAG_SPI_I2C_SHFITS)) {
             gyro_update_flag &= ~(1 << IMU_MAG_SPI_I2C_SHFITS);
             gyro_update_flag |= (1 << IMU_MAG_UPDATE_SHFITS);
+            gyro_sample_tick = gyro_dr_tick;
 
             HAL_GPIO_WritePin(CS1_GYRO_GPIO_Port, CS1_GYRO_Pin, GPIO_PIN_SET);
 
@@ -723,6 +862,7 @@ void DMA2_Stream2_IRQHandler(void) {
         if (accel_update_flag & (1 << IMU_MAG_SPI_I2C_SHFITS)) {
             accel_update_flag &= ~(1 << IMU_MAG_SPI_I2C_SHFITS);
             accel_update_flag |= (1 << IMU_MAG_UPDATE_SHFITS);
+            accel_sample_tick = accel_dr_tick;
 
             HAL_GPIO_WritePin(CS1_ACCEL_GPIO_Port, CS1_ACCEL_Pin, GPIO_PIN_SET);
         }
@@ -743,6 +883,7 @@ void DMA2_Stream2_IRQHandler(void) {
             __HAL_GPIO_EXTI_GENERATE_SWIT(GPIO_PIN_0);
         }
     }
+    profile_end(PROFILE_IMU_SPI_DMA_ISR);
 }
 
 void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
@@ -750,6 +891,7 @@ void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
         if (mag_update_flag & (1 << IMU_MAG_SPI_I2C_SHFITS)) {
             mag_update_flag &= ~(1 << IMU_MAG_SPI_I2C_SHFITS);
             mag_update_flag |= (1 << IMU_MAG_UPDATE_SHFITS);
+            mag_sample_tick = mag_dr_tick;
         }
     }
 }
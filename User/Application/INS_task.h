@@ -28,6 +28,7 @@
 #include "struct_typedef.h"
 #include "DWT.h"
 #include "FusionAhrs.h"
+#include "attitude_history.h"
 #include "ahrs_ukf.h"
 #include "BMI088driver.h"
 #include "ist8310driver.h"
@@ -85,12 +86,49 @@
 
 #define MAG_FIFO_BUF_LENGTH 960
 
+#define INS_FUSION_NOMINAL_DT_US 9000U  //融合名义步长,首帧或时间戳异常时使用
+#define INS_FUSION_MAX_DT_US     50000U //超过该间隔认为时间戳无效
+
 typedef struct {
     float32_t rotation_factor[3][3];
     float32_t offset[3];
     float32_t scale[3];
 } IMU_MAG_Cali_t;
 
+typedef struct {
+    uint32_t tick;  //数据就绪中断时刻的DWT计数
+    uint32_t dt_us; //与上一个被融合样本的间隔 单位 us
+} IMU_MAG_sample_time_t;
+
+typedef struct {
+    IMU_MAG_sample_time_t gyro;
+    IMU_MAG_sample_time_t accel;
+    IMU_MAG_sample_time_t mag;
+} IMU_MAG_timestamp_t;
+
+#pragma pack(push, 1)
+
+//录制的一次融合的原始传感器样本,INS_CAPTURE为ON时写入mag_data_tx_fifo
+typedef struct {
+    uint32_t gyro_tick;     //数据就绪中断时刻的DWT计数
+    uint32_t accel_tick;
+    uint32_t mag_tick;
+    float32_t gyro[3];      //bmi088_real_data,未旋转未校准 rad/s
+    float32_t accel[3];     //m/s2
+    float32_t mag[3];       //ist8310_real_data uT
+    float32_t temp;         //bmi088温度
+    float32_t angle[3];     //本次融合输出的INS_angle yaw pitch roll rad,回放的对照
+} INS_capture_sample_t;
+
+//录制时定期发送的校准参数,回放时用于重现imu_mag_rotate和imu_mag_cali
+typedef struct {
+    uint8_t id;             //0:gyro 1:accel 2:mag
+    uint32_t tick_hz;       //DWT计数频率
+    IMU_MAG_Cali_t cali;
+} INS_capture_cali_t;
+
+#pragma pack(pop)
+
 extern float32_t INS_angle[3];
 
 extern SPI_HandleTypeDef hspi1;
@@ -206,6 +244,32 @@ extern const float32_t *get_INS_quat_point(void);
   */
 extern const float32_t *get_INS_angle_point(void);
 
+/**
+  * @brief          get the data ready timestamp and dt of the last fused gyro, accel and mag sample
+  * @param[in]      none
+  * @retval         the point of INS_timestamp
+  */
+/**
+  * @brief          获取最近一次参与融合的陀螺仪,加速度计,磁力计样本的数据就绪时刻与间隔
+  * @param[in]      none
+  * @retval         INS_timestamp的指针
+  */
+extern const IMU_MAG_timestamp_t *get_INS_timestamp_point(void);
+
+/**
+  * @brief          get the euler angle at a past DWT tick, interpolated from the angle history
+  * @param[in]      tick: DWT tick
+  * @param[out]     angle: 0:yaw, 1:pitch, 2:roll unit rad
+  * @retval         attitude_history_result_e
+  */
+/**
+  * @brief          获取过去某一DWT时刻的欧拉角,由欧拉角历史插值得到
+  * @param[in]      tick: DWT计数
+  * @param[out]     angle: 0:yaw, 1:pitch, 2:roll 单位 rad
+  * @retval         attitude_history_result_e
+  */
+extern attitude_history_result_e get_INS_angle_at(uint32_t tick, float32_t angle[3]);
+
 
 /**
   * @brief          get the rotation speed, 0:x-axis, 1:y-axis, 2:roll-axis,unit rad/s
@@ -255,6 +319,7 @@ extern float32_t INS_quat[4];
 extern float32_t INS_angle_ukf[3];
 extern AHRS_t IMU;
 extern fifo_s_t mag_data_tx_fifo;
+extern uint32_t INS_capture_drop_cnt;
 extern IMU_MAG_Cali_t gyro_cali_data;
 extern IMU_MAG_Cali_t accel_cali_data;
 extern IMU_MAG_Cali_t mag_cali_data;
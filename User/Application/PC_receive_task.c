@@ -3,178 +3,497 @@
 //
 
 #include "PC_receive_task.h"
+#include "main.h"
 #include "SEGGER_RTT.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include "referee_task.h"
 #include "print_task.h"
-#include "SEGGER_RTT.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "gimbal_task.h"
+#include "chassis_task.h"
 #include "remote_control.h"
 #include "user_lib.h"
 #include "shoot.h"
 #include "vision_task.h"
 #include "gimbal_behaviour.h"
 #include "DWT.h"
+#include "frame_parser.h"
+#include "spsc_fifo.h"
+#include "usbd_cdc_if.h"
+#include "flash_kv.h"
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t PC_receive_task_stack;
 #endif
 
+#define PC_RECEIVE_TIME             13
+//二进制参数请求使用的RTT上下行缓存,0号缓存留给文本命令
+#define PARAM_RTT_BUFFER_INDEX      3
+#define PARAM_RTT_UP_SIZE           512
+#define PARAM_RTT_DOWN_SIZE         256
+#define PARAM_RTT_READ_LEN          64
+#define PARAM_FIFO_BUF_LENGTH       512     //必须为2的幂
+//等待上一帧USB应答发送完成的最长时间,ms
+#define PARAM_USB_TX_TIMEOUT        5
+
+#define PARAM_GAIN_MAX              100000.0f
+#define PARAM_KALMAN_MIN            0.000001f
+#define PARAM_KALMAN_MAX            10000.0f
+
+#if (PARAM_FIFO_BUF_LENGTH & (PARAM_FIFO_BUF_LENGTH - 1)) != 0
+#error "PARAM_FIFO_BUF_LENGTH must be a power of two"
+#endif
+
+//参数组须能放进一条flash记录
+#if PARAM_SET_WORD_NUM(PARAM_REGISTRY_MAX_NUM) > FLASH_KV_MAX_LEN
+#error "PARAM_REGISTRY_MAX_NUM is too large for one flash_kv record"
+#endif
+
+typedef enum {
+    PARAM_PORT_RTT = 0,
+    PARAM_PORT_USB,
+    PARAM_PORT_NUM,
+} param_port_e;
+
+param_registry_t param_registry;
+
 char Char_Receive_Buffer[256];
-char *p;
-int param_num;
-char param_value[16];
-int32_t param_value_int;
-float param_value_float;
-void *PC_receive_data[29];
-
-//$param0=12;$param1=13;$param2=12.32;$param3=11.21;
-void PC_receive_task(void const *argument) {
-    /********vision start***********/
-//    PC_receive_data[param0] = (void *) &vision_pitch_angle_deadband_sen;
-//    PC_receive_data[param1] = (void *) &vision_yaw_angle_deadband_sen;
-//    PC_receive_data[param2] = (void *) &vision_pitch_control_sen;
-//    PC_receive_data[param3] = (void *) &vision_yaw_control_sen;
-//    PC_receive_data[param4] = (void *) &vision_pitch_lpf_factor;
-//    PC_receive_data[param5] = (void *) &vision_yaw_control_lpf_factor;
-
-    /********vision end***********/
-
-    /********pitch start***********/
-//    PC_receive_data[param0] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_absolute_angle_pid.kp;
-//    PC_receive_data[param1] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_absolute_angle_pid.ki;
-
-//    PC_receive_data[param0] = (void *) &shoot_control.fric_all_speed;
-////    PC_receive_data[param1] = (void *) &shoot_control.fric2_speed_set;
-//    PC_receive_data[param2] = (void *) &shoot_control.fric1_motor_pid.Kp;
-//    PC_receive_data[param3] = (void *) &shoot_control.fric1_motor_pid.Ki;
-//    PC_receive_data[param4] = (void *) &shoot_control.fric1_motor_pid.Kd;
-//    PC_receive_data[param5] = (void *) &shoot_control.fric1_motor_pid.Integral_Separation;
-//    PC_receive_data[param6] = (void *) &shoot_control.fric2_motor_pid.Kp;
-//    PC_receive_data[param7] = (void *) &shoot_control.fric2_motor_pid.Ki;
-//    PC_receive_data[param8] = (void *) &shoot_control.fric2_motor_pid.Kd;
-//    PC_receive_data[param9] = (void *) &shoot_control.fric2_motor_pid.Integral_Separation;
-
-//    PC_receive_data[param0] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.kp;
-//    PC_receive_data[param1] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.ki;
-//    PC_receive_data[param2] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.kd;
-//    PC_receive_data[param3] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid.Kp;
-//    PC_receive_data[param4] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid.Ki;
-//    PC_receive_data[param5] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid.Kd;
-//    PC_receive_data[param6] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid.Integral_Separation;
-//    PC_receive_data[param7] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.max_iout;
-//    PC_receive_data[param8] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.max_out;
-//    PC_receive_data[param9] = (void *) &gimbal_control.gimbal_pitch_motor.max_relative_angle;
-//    PC_receive_data[param10] = (void *) &gimbal_control.gimbal_pitch_motor.min_relative_angle;
-//    PC_receive_data[param11] = (void *) &gimbal_control.gimbal_pitch_motor.relative_angle_set;
-//    PC_receive_data[param12] = (void *) &gimbal_control.gimbal_pitch_motor.Cloud_Motor_Current_Kalman_Filter.R;
-//    PC_receive_data[param13] = (void *) &gimbal_control.gimbal_pitch_motor.Cloud_Motor_Current_Kalman_Filter.Q;
-//    PC_receive_data[param14] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.Cloud_OCKalman.R;
-//    PC_receive_data[param15] = (void *) &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid.Cloud_OCKalman.Q;
-//    PC_receive_data[param16] = (void *) &gimbal_control.gimbal_pitch_motor.LpfFactor;
-    /********pitch end***********/
+
+static spsc_fifo_t param_rx_fifo[PARAM_PORT_NUM];
+static uint8_t param_fifo_buf[PARAM_PORT_NUM][PARAM_FIFO_BUF_LENGTH];
+static frame_parser_t param_parser[PARAM_PORT_NUM];
+static uint8_t param_frame_buf[PARAM_PORT_NUM][PARAM_FRAME_MAX_LEN];
+static uint8_t param_reply_frame[PARAM_PORT_NUM][PARAM_FRAME_MAX_LEN];
+static uint8_t param_reply_data[PARAM_FRAME_MAX_DATA];
+static uint8_t param_rtt_up_buf[PARAM_RTT_UP_SIZE];
+static uint8_t param_rtt_down_buf[PARAM_RTT_DOWN_SIZE];
+static uint32_t param_reply_drop_cnt;
+static volatile uint8_t param_usb_rx_ready;    //队列初始化前USB收到的数据丢弃
+
+//保存或读取参数组的请求,同一时间只有一个,由calibrate_task执行
+static struct {
+    uint8_t busy;
+    uint8_t reply;                  //0:启动时加载,不应答
+    uint8_t port;
+    uint8_t seq;
+    uint16_t cmd_id;
+    uint8_t set;
+    uint8_t len;
+    uint32_t buf[PARAM_SET_WORD_NUM(PARAM_REGISTRY_MAX_NUM)];
+} param_store_op;
+
+//其他任务请求保存的参数组,PARAM_SET_NUM为没有请求
+static volatile uint8_t param_save_request = PARAM_SET_NUM;
+static volatile uint8_t param_save_status = PARAM_OK;
+
+//命令码注册表,请求在帧回调中统一处理
+static const frame_cmd_t param_cmd_table[] = {
+        {PARAM_CMD_INFO, 0, NULL, NULL, NULL},
+        {PARAM_CMD_GET,  0, NULL, NULL, NULL},
+        {PARAM_CMD_SET,  0, NULL, NULL, NULL},
+        {PARAM_CMD_SAVE, 0, NULL, NULL, NULL},
+        {PARAM_CMD_LOAD, 0, NULL, NULL, NULL},
+};
+
+static void param_rtt_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id);
+static void param_usb_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id);
+
+/**
+  * @brief          注册一个pid的kp ki kd, 参数名为prefix_kp等, 供串级自动整定按名字查找
+  */
+static void param_registry_add_gain(const char *prefix, pid_type_def *pid, uint8_t owner) {
+    char name[PARAM_NAME_LEN];
+
+    snprintf(name, sizeof(name), "%s_kp", prefix);
+    param_registry_add(&param_registry, name, &pid->Kp, PARAM_FLOAT, owner, 0.0f, PARAM_GAIN_MAX);
+    snprintf(name, sizeof(name), "%s_ki", prefix);
+    param_registry_add(&param_registry, name, &pid->Ki, PARAM_FLOAT, owner, 0.0f, PARAM_GAIN_MAX);
+    snprintf(name, sizeof(name), "%s_kd", prefix);
+    param_registry_add(&param_registry, name, &pid->Kd, PARAM_FLOAT, owner, 0.0f, PARAM_GAIN_MAX);
+}
+
+/**
+  * @brief          注册可在线修改的参数,编号与文本命令的param编号相同
+  */
+static void param_registry_setup(void) {
+    gimbal_motor_t *p_yaw = &gimbal_control.gimbal_yaw_motor;
+    pid_type_def *p_rel = &p_yaw->gimbal_motor_relative_angle_pid;
+    pid_type_def *p_spd = &p_yaw->gimbal_motor_gyro_pid;
+    pid_type_def *p_chs = &chassis_move.chassis_angle_pid;
 
     /********yaw start***********/
-    PC_receive_data[param0] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Kp;
-    PC_receive_data[param1] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Ki;
-    PC_receive_data[param2] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Kd;
-    PC_receive_data[param3] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Kp;
-    PC_receive_data[param4] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Ki;
-    PC_receive_data[param5] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Kd;
-    PC_receive_data[param6] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.max_iout;
-    PC_receive_data[param7] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.max_out;
-    PC_receive_data[param8] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Integral_Separation;
-    PC_receive_data[param9] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Integral_Separation;
-
-    PC_receive_data[param10] = (void *) &gimbal_control.gimbal_yaw_motor.Cloud_Motor_Current_Kalman_Filter.R;
-    PC_receive_data[param11] = (void *) &gimbal_control.gimbal_yaw_motor.Cloud_Motor_Current_Kalman_Filter.Q;
-    PC_receive_data[param12] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.D_Kalman.R;
-    PC_receive_data[param13] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.D_Kalman.Q;
-
-    PC_receive_data[param14] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Variable_I;
-    PC_receive_data[param15] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Variable_I_Down;
-    PC_receive_data[param16] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.Variable_I_UP;
-    PC_receive_data[param17] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Variable_I;
-    PC_receive_data[param18] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Variable_I_Down;
-    PC_receive_data[param19] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Variable_I_UP;
-
-
-    PC_receive_data[param20] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.NF_D;
-    PC_receive_data[param21] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.D_Alpha;
-    PC_receive_data[param22] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.NF_D;
-    PC_receive_data[param23] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.D_Alpha;
-    PC_receive_data[param24] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.D_First;
-    PC_receive_data[param25] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid.D_Filter_Ratio;
-    PC_receive_data[param26] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.D_First;
-    PC_receive_data[param27] = (void *) &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.D_Filter_Ratio;
-
-    PC_receive_data[param28] = (void *) &gimbal_control.gimbal_yaw_motor.LpfFactor;
-
-//    PC_receive_data[param9] = (void *) &gimbal_control.gimbal_yaw_motor.max_relative_angle;
-//    PC_receive_data[param10] = (void *) &gimbal_control.gimbal_yaw_motor.min_relative_angle;
-//    PC_receive_data[param12] = (void *) &gimbal_control.gimbal_yaw_motor.relative_angle_set;
-//    PC_receive_data[param13] = (void *) &gimbal_control.gimbal_yaw_motor.relative_angle;
-//    PC_receive_data[param14] = (void *) &gimbal_control.gimbal_yaw_motor.offset_ecd;
+    param_registry_add(&param_registry, "yaw_rel_kp", &p_rel->Kp, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_ki", &p_rel->Ki, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_kd", &p_rel->Kd, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_spd_kp", &p_spd->Kp, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_spd_ki", &p_spd->Ki, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_spd_kd", &p_spd->Kd, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_maxiout", &p_rel->max_iout, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, 1000.0f);
+    param_registry_add(&param_registry, "yaw_rel_maxout", &p_rel->max_out, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, 1000.0f);
+    param_registry_add(&param_registry, "yaw_spd_IS", &p_spd->Integral_Separation, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_IS", &p_rel->Integral_Separation, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, PARAM_GAIN_MAX);
+
+    param_registry_add(&param_registry, "yaw_cur_kal_R", &p_yaw->Cloud_Motor_Current_Kalman_Filter.R,
+                       PARAM_FLOAT, PARAM_OWNER_GIMBAL, PARAM_KALMAN_MIN, PARAM_KALMAN_MAX);
+    param_registry_add(&param_registry, "yaw_cur_kal_Q", &p_yaw->Cloud_Motor_Current_Kalman_Filter.Q,
+                       PARAM_FLOAT, PARAM_OWNER_GIMBAL, PARAM_KALMAN_MIN, PARAM_KALMAN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_dkal_R", &p_rel->D_Kalman.R, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       PARAM_KALMAN_MIN, PARAM_KALMAN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_dkal_Q", &p_rel->D_Kalman.Q, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       PARAM_KALMAN_MIN, PARAM_KALMAN_MAX);
+
+    param_registry_add(&param_registry, "yaw_rel_VI", &p_rel->Variable_I, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_rel_VI_down", &p_rel->Variable_I_Down, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_rel_VI_up", &p_rel->Variable_I_UP, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_spd_VI", &p_spd->Variable_I, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_spd_VI_down", &p_spd->Variable_I_Down, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "yaw_spd_VI_up", &p_spd->Variable_I_UP, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, PARAM_GAIN_MAX);
+
+    param_registry_add(&param_registry, "yaw_rel_NF_D", &p_rel->NF_D, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_rel_D_alpha", &p_rel->D_Alpha, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, 1.0f);
+    param_registry_add(&param_registry, "yaw_spd_NF_D", &p_spd->NF_D, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_spd_D_alpha", &p_spd->D_Alpha, PARAM_FLOAT, PARAM_OWNER_GIMBAL,
+                       0.0f, 1.0f);
+    param_registry_add(&param_registry, "yaw_rel_D_first", &p_rel->D_First, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_rel_D_ratio", &p_rel->D_Filter_Ratio, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, 1.0f);
+    param_registry_add(&param_registry, "yaw_spd_D_first", &p_spd->D_First, PARAM_BOOL, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
+    param_registry_add(&param_registry, "yaw_spd_D_ratio", &p_spd->D_Filter_Ratio, PARAM_FLOAT,
+                       PARAM_OWNER_GIMBAL, 0.0f, 1.0f);
+
+    param_registry_add(&param_registry, "yaw_lpf", &p_yaw->LpfFactor, PARAM_FLOAT, PARAM_OWNER_GIMBAL, 0.0f,
+                       1.0f);
     /********yaw end***********/
 
-    /********trigger start***********/
-//    PC_receive_data[param0] = (void *) &shoot_control.trigger_motor_speed_pid.Kp;
-//    PC_receive_data[param1] = (void *) &shoot_control.trigger_motor_speed_pid.Ki;
-//    PC_receive_data[param2] = (void *) &shoot_control.trigger_motor_speed_pid.Kd;
-//    PC_receive_data[param3] = (void *) &shoot_control.trigger_speed_set;
-    /********trigger end***********/
+    /********chassis start***********/
+    param_registry_add(&param_registry, "chs_ang_kp", &p_chs->Kp, PARAM_FLOAT, PARAM_OWNER_CHASSIS, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "chs_ang_ki", &p_chs->Ki, PARAM_FLOAT, PARAM_OWNER_CHASSIS, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "chs_ang_kd", &p_chs->Kd, PARAM_FLOAT, PARAM_OWNER_CHASSIS, 0.0f,
+                       PARAM_GAIN_MAX);
+    param_registry_add(&param_registry, "chs_ang_maxiout", &p_chs->max_iout, PARAM_FLOAT, PARAM_OWNER_CHASSIS,
+                       0.0f, 1000.0f);
+    param_registry_add(&param_registry, "chs_ang_maxout", &p_chs->max_out, PARAM_FLOAT, PARAM_OWNER_CHASSIS,
+                       0.0f, 1000.0f);
+    /********chassis end***********/
+
+    /********auto tune gains start***********/
+    //拨盘在gimbal_task中控制,属于云台循环
+    param_registry_add_gain("pitch_rel", &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid,
+                            PARAM_OWNER_GIMBAL);
+    param_registry_add_gain("pitch_spd", &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid,
+                            PARAM_OWNER_GIMBAL);
+    param_registry_add_gain("trig_ang", &shoot_control.trigger_motor_angle_pid, PARAM_OWNER_GIMBAL);
+    param_registry_add_gain("trig_spd", &shoot_control.trigger_motor_speed_pid, PARAM_OWNER_GIMBAL);
+    param_registry_add_gain("wheel0_spd", &chassis_move.motor_speed_pid[0], PARAM_OWNER_CHASSIS);
+    param_registry_add_gain("wheel1_spd", &chassis_move.motor_speed_pid[1], PARAM_OWNER_CHASSIS);
+    param_registry_add_gain("wheel2_spd", &chassis_move.motor_speed_pid[2], PARAM_OWNER_CHASSIS);
+    param_registry_add_gain("wheel3_spd", &chassis_move.motor_speed_pid[3], PARAM_OWNER_CHASSIS);
+    /********auto tune gains end***********/
+}
+
+/**
+  * @brief          发送应答帧,USB上一帧发送完成前不改写发送缓存
+  */
+static void param_reply(uint8_t port, uint16_t cmd_id, uint8_t seq, const uint8_t *p_data, uint16_t len) {
+    uint8_t *p_frame = param_reply_frame[port];
+    uint16_t frame_len;
+    TickType_t start_time;
+
+    if (port == PARAM_PORT_USB) {
+        start_time = xTaskGetTickCount();
+        while (CDC_Transmit_Busy_FS()) {
+            if (xTaskGetTickCount() - start_time >= pdMS_TO_TICKS(PARAM_USB_TX_TIMEOUT)) {
+                param_reply_drop_cnt++;
+                return;
+            }
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+    }
+    frame_len = param_frame_pack(p_frame, cmd_id | PARAM_REPLY_FLAG, seq, p_data, len);
+    if (port == PARAM_PORT_RTT) {
+        if (SEGGER_RTT_Write(PARAM_RTT_BUFFER_INDEX, p_frame, frame_len) != frame_len) {
+            param_reply_drop_cnt++;
+        }
+    } else if (CDC_Transmit_FS(p_frame, frame_len) != USBD_OK) {
+        param_reply_drop_cnt++;
+    }
+}
+
+/**
+  * @brief          交给calibrate_task保存或读取参数组
+  * @retval         param_status_e
+  */
+static uint8_t param_store_begin(uint16_t cmd_id, uint8_t set) {
+    uint8_t write = (cmd_id == PARAM_CMD_SAVE);
+
+    if (set >= PARAM_SET_NUM) {
+        return PARAM_ERR_ID;
+    }
+    if (param_store_op.busy) {
+        return PARAM_ERR_BUSY;
+    }
+    if (write) {
+        param_store_op.len = param_registry_export(&param_registry, param_store_op.buf);
+    } else {
+        param_store_op.len = PARAM_SET_WORD_NUM(param_registry.num);
+    }
+    if (cali_store_request(PARAM_SET_KEY(set), param_store_op.buf, param_store_op.len, write) != 0) {
+        return PARAM_ERR_BUSY;
+    }
+    param_store_op.cmd_id = cmd_id;
+    param_store_op.set = set;
+    param_store_op.busy = 1;
+    return PARAM_OK;
+}
+
+/**
+  * @brief          开始其他任务请求的保存,完成后在param_store_poll中记录结果
+  */
+static void param_save_poll(void) {
+    uint8_t status;
+
+    if (param_save_request >= PARAM_SET_NUM || param_store_op.busy) {
+        return;
+    }
+    status = param_store_begin(PARAM_CMD_SAVE, param_save_request);
+    param_save_request = PARAM_SET_NUM;
+    if (status != PARAM_OK) {
+        param_save_status = status;
+        return;
+    }
+    param_store_op.reply = 0;
+}
+
+/**
+  * @brief          检查保存或读取是否完成,读取完成后整批暂存参数组
+  */
+static void param_store_poll(void) {
+    uint8_t state;
+
+    if (!param_store_op.busy) {
+        return;
+    }
+    state = cali_store_request_state();
+    if (state == CALI_STORE_PENDING) {
+        return;
+    }
+    if (state != CALI_STORE_DONE) {
+        param_reply_data[0] = PARAM_ERR_STORE;
+    } else if (param_store_op.cmd_id == PARAM_CMD_LOAD) {
+        param_reply_data[0] = param_registry_import(&param_registry, param_store_op.buf, param_store_op.len);
+    } else {
+        param_reply_data[0] = PARAM_OK;
+    }
+    param_reply_data[1] = param_store_op.set;
+    param_store_op.busy = 0;
+    if (param_store_op.reply) {
+        param_reply(param_store_op.port, param_store_op.cmd_id, param_store_op.seq, param_reply_data, 2);
+    } else if (param_store_op.cmd_id == PARAM_CMD_SAVE) {
+        param_save_status = param_reply_data[0];
+    } else if (param_reply_data[0] != PARAM_OK && param_reply_data[0] != PARAM_ERR_STORE) {
+        SEGGER_RTT_printf(0, "param set %d not loaded, status %d\n", param_store_op.set, param_reply_data[0]);
+    }
+}
+
+/**
+  * @brief          处理一个校验通过的请求帧,应答从请求来的端口发回
+  */
+static void param_frame_handle(uint8_t port, const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    const uint8_t *p_data = p_frame + PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE;
+    uint16_t len = frame_len - PARAM_FRAME_HEAD_SIZE - PARAM_FRAME_CMD_SIZE - FRAME_PARSER_CRC16_SIZE;
+    uint8_t seq = p_frame[3];
+    int reply_len;
+
+    if (cmd_id & PARAM_REPLY_FLAG) {
+        return;
+    }
+    if (cmd_id == PARAM_CMD_SAVE || cmd_id == PARAM_CMD_LOAD) {
+        param_reply_data[0] = (len == 1U) ? param_store_begin(cmd_id, p_data[0]) : PARAM_ERR_LEN;
+        if (param_reply_data[0] == PARAM_OK) {
+            //完成后在param_store_poll中应答
+            param_store_op.reply = 1;
+            param_store_op.port = port;
+            param_store_op.seq = seq;
+            return;
+        }
+        param_reply_data[1] = (len == 1U) ? p_data[0] : 0;
+        reply_len = 2;
+    } else {
+        reply_len = param_registry_handle(&param_registry, cmd_id, p_data, len, param_reply_data);
+        if (reply_len < 0) {
+            param_reply_data[0] = PARAM_ERR_CMD;
+            reply_len = 1;
+        }
+    }
+    param_reply(port, cmd_id, seq, param_reply_data, (uint16_t) reply_len);
+}
+
+static void param_rtt_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    param_frame_handle(PARAM_PORT_RTT, p_frame, frame_len, cmd_id);
+}
+
+static void param_usb_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    param_frame_handle(PARAM_PORT_USB, p_frame, frame_len, cmd_id);
+}
+
+/**
+  * @brief          解析文本命令,一次读到的所有参数作为一批整体暂存
+  *                 $param0=12;$param1=13;$yaw_spd_kp=2.5;
+  */
+static void param_text_parse(char *p_text) {
+    uint8_t id[PARAM_BATCH_MAX_NUM];
+    param_value_t value[PARAM_BATCH_MAX_NUM];
+    char name[PARAM_NAME_LEN];
+    uint8_t num = 0;
+    uint8_t bad_index, status;
+    char *p, *p_value;
+    int index;
+
+    for (p = strchr(p_text, '$'); p != NULL; p = strchr(p + 1, '$')) {
+        p_value = strchr(p, '=');
+        if (p_value == NULL || sscanf(p, "$%15[^=;]", name) != 1) {
+            continue;
+        }
+        if (sscanf(name, "param%d", &index) != 1) {
+            index = param_registry_find(&param_registry, name);
+        }
+        if (index < 0 || index >= param_registry.num) {
+            SEGGER_RTT_printf(0, "unknown param %s\n", name);
+            continue;
+        }
+        if (num >= PARAM_BATCH_MAX_NUM) {
+            SEGGER_RTT_WriteString(0, "Too many params.");
+            break;
+        }
+        id[num] = (uint8_t) index;
+        param_registry_from_float(&param_registry, id[num], strtof(p_value + 1, NULL), &value[num]);
+        num++;
+    }
+    if (num == 0) {
+        return;
+    }
+    status = param_registry_stage(&param_registry, id, value, num, &bad_index);
+    if (status != PARAM_OK) {
+        SEGGER_RTT_printf(0, "params rejected, %s status %d\n", param_registry.entry[id[bad_index]].name, status);
+    }
+}
+
+/**
+  * @brief          把RTT下行缓存中的参数请求放入队列
+  */
+static void param_rtt_receive(void) {
+    uint8_t rx_buf[PARAM_RTT_READ_LEN];
+    uint32_t free_num, len;
+
+    while ((free_num = spsc_fifo_free(&param_rx_fifo[PARAM_PORT_RTT])) != 0U) {
+        len = SEGGER_RTT_Read(PARAM_RTT_BUFFER_INDEX, rx_buf,
+                              (free_num < PARAM_RTT_READ_LEN) ? free_num : PARAM_RTT_READ_LEN);
+        if (len == 0U) {
+            break;
+        }
+        spsc_fifo_puts(&param_rx_fifo[PARAM_PORT_RTT], rx_buf, len);
+    }
+}
+
+void PC_receive_usb_rx(const uint8_t *p_data, uint32_t len) {
+    if (!param_usb_rx_ready) {
+        return;
+    }
+    spsc_fifo_puts(&param_rx_fifo[PARAM_PORT_USB], p_data, len);
+}
+
+void PC_receive_task(void const *argument) {
+    uint8_t i;
+
+    SEGGER_RTT_ConfigUpBuffer(PARAM_RTT_BUFFER_INDEX, "param", param_rtt_up_buf, PARAM_RTT_UP_SIZE,
+                              SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    SEGGER_RTT_ConfigDownBuffer(PARAM_RTT_BUFFER_INDEX, "param", param_rtt_down_buf, PARAM_RTT_DOWN_SIZE,
+                                SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    for (i = 0; i < PARAM_PORT_NUM; i++) {
+        if (spsc_fifo_init(&param_rx_fifo[i], param_fifo_buf[i], PARAM_FIFO_BUF_LENGTH) != 0) {
+            Error_Handler();
+        }
+        frame_parser_init(&param_parser[i], &param_frame_protocol, param_cmd_table,
+                          sizeof(param_cmd_table) / sizeof(param_cmd_table[0]),
+                          (i == PARAM_PORT_RTT) ? param_rtt_frame : param_usb_frame, param_frame_buf[i]);
+    }
+    param_usb_rx_ready = 1;
+    param_registry_setup();
+    //启动时加载保存的参数组,在云台和底盘循环开始时生效
+    param_store_op.reply = 0;
+    param_store_begin(PARAM_CMD_LOAD, PARAM_SET_BOOT);
+
     TickType_t LoopStartTime;
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_PC_receive_task);
         LoopStartTime = xTaskGetTickCount();
-//        SEGGER_RTT_printf(0,"%d",i);
         if (SEGGER_RTT_HasKey()) {
-            uint16_t Char_Buffer_len = sizeof(Char_Receive_Buffer);
+            uint16_t Char_Buffer_len = sizeof(Char_Receive_Buffer) - 1;
             uint16_t NumBytes = SEGGER_RTT_Read(0, &Char_Receive_Buffer[0], Char_Buffer_len);
             if ((NumBytes < Char_Buffer_len)) {
-                for (p = &Char_Receive_Buffer[0]; p != NULL; p = strstr(p, "$param")) {
-//                    taskENTER_CRITICAL();
-                    sscanf(p, "$param%5d[^=]", &param_num);
-                    p = strstr(p, "=");
-                    sscanf(p, "=%15[^;]", param_value);
-                    if (strstr(param_value, ".") == NULL) {
-                        param_value_int = strtol(param_value, NULL, 0);
-                        int32_t *tmp = (int32_t *) PC_receive_data[param_num];
-                        if (param_num == 10) {
-                            *(tmp) = int32_constrain(param_value_int,
-                                                     gimbal_control.gimbal_pitch_motor.min_relative_angle,
-                                                     gimbal_control.gimbal_pitch_motor.max_relative_angle);
-                        } else {
-                            *(tmp) = param_value_int;
-                        }
-                    } else {
-                        param_value_float = strtof(param_value, NULL);
-                        float *tmp = (float *) PC_receive_data[param_num];
-                        if (param_num == 11) {
-                            *(tmp) = fp32_constrain(param_value_float,
-                                                    gimbal_control.gimbal_pitch_motor.min_relative_angle,
-                                                    gimbal_control.gimbal_pitch_motor.max_relative_angle);;
-                        } else {
-                            *(tmp) = param_value_float;
-                        }
-
-                    }
-//                    taskEXIT_CRITICAL();
+                //0号下行缓存只在这里读取,去掉换行后只有一个字符时转交print_task作为打印命令
+                while (NumBytes > 0U && (Char_Receive_Buffer[NumBytes - 1U] == '\r' ||
+                                         Char_Receive_Buffer[NumBytes - 1U] == '\n')) {
+                    NumBytes--;
+                }
+                if (NumBytes != 1U || print_terminal_command(Char_Receive_Buffer[0]) != 0) {
+                    Char_Receive_Buffer[NumBytes] = '\0';
+                    param_text_parse(Char_Receive_Buffer);
                 }
-
             } else {
                 SEGGER_RTT_WriteString(0, "Too many params.");
             }
         }
+        param_rtt_receive();
+        for (i = 0; i < PARAM_PORT_NUM; i++) {
+            frame_parser_unpack_fifo(&param_parser[i], &param_rx_fifo[i]);
+        }
+        param_save_poll();
+        param_store_poll();
 #if INCLUDE_uxTaskGetStackHighWaterMark
         PC_receive_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
-        vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(13));
+        vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(PC_RECEIVE_TIME));
+    }
+}
+
+int PC_receive_param_save(uint8_t set) {
+    if (set >= PARAM_SET_NUM || param_save_status == PARAM_ERR_BUSY) {
+        return -1;
     }
+    param_save_status = PARAM_ERR_BUSY;
+    param_save_request = set;
+    return 0;
+}
+
+uint8_t PC_receive_param_save_status(void) {
+    return param_save_status;
 }
 
 /**
@@ -184,4 +503,4 @@ void PC_receive_task(void const *argument) {
   */
 uint32_t get_stack_of_PC_receive_task(void) {
     return PC_receive_task_stack;
-}
\ No newline at end of file
+}
@@ -8,52 +8,56 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "struct_typedef.h"
+#include "calibrate_task.h"
+#include "param_registry.h"
 
-enum {
-    param0 = 0,//re/abangle-kp
-    param1,//re/abangle-ki
-    param2,//re/abangle-kd
-    param3,//gimspeed-kp
-    param4,//gimspeed-ki
-    param5,//gimspeed-kd
-    param6,//gimspeed-IS
-    param7,//re/abangle-maxiout
-    param8,//re/abangle-maxout
-    param9,//max_relative_angle
-    param10,//min_relative_angle
-    param11,//relative_angle_set
-    param12,//err_kal_R
-    param13,//err_kal_Q
-    param14,//pid_kal_R
-    param15,//pid_kal_Q
-    param16,//LpfFactor
-    param17,//Variable_I
-    param18,//Variable_I_Down
-    param19,//Variable_I_UP
-    param20,//re-D_First
-    param21,//re-D_Filter_Ratio 0-1
-    param22,//sp-D_First
-    param23,//sp-D_Filter_Ratio 0-1
-    param24,//D_Low_Pass
-    param25,//D_Low_Pass_Filter_num 0-1
-    param26,
-    param27,
-    param28,
+//参数组保存在校准存储中校准数据之后的键上
+#define PARAM_SET_NUM               4
+#define PARAM_SET_KEY(set)          (CALI_STORE_USER_KEY + (set))
+//启动时加载的参数组
+#define PARAM_SET_BOOT              0
 
+//owner loops of the parameters.参数所属的控制循环,在循环开始时调用param_registry_apply
+typedef enum {
+    PARAM_OWNER_GIMBAL = 0,
+    PARAM_OWNER_CHASSIS,
+} param_owner_e;
 
+//text command "$param<id>=value;" or "$<name>=value;", ids of the yaw parameters
+//文本命令"$param编号=值;"或"$参数名=值;", yaw参数的编号
+enum {
+    param0 = 0,//yaw_rel_kp
+    param1,//yaw_rel_ki
+    param2,//yaw_rel_kd
+    param3,//yaw_spd_kp
+    param4,//yaw_spd_ki
+    param5,//yaw_spd_kd
+    param6,//yaw_rel_maxiout
+    param7,//yaw_rel_maxout
+    param8,//yaw_spd_IS
+    param9,//yaw_rel_IS
+    param10,//yaw_cur_kal_R
+    param11,//yaw_cur_kal_Q
+    param12,//yaw_rel_dkal_R
+    param13,//yaw_rel_dkal_Q
+    param14,//yaw_rel_VI
+    param15,//yaw_rel_VI_down
+    param16,//yaw_rel_VI_up
+    param17,//yaw_spd_VI
+    param18,//yaw_spd_VI_down
+    param19,//yaw_spd_VI_up
+    param20,//yaw_rel_NF_D
+    param21,//yaw_rel_D_alpha 0-1
+    param22,//yaw_spd_NF_D
+    param23,//yaw_spd_D_alpha 0-1
+    param24,//yaw_rel_D_first
+    param25,//yaw_rel_D_ratio 0-1
+    param26,//yaw_spd_D_first
+    param27,//yaw_spd_D_ratio 0-1
+    param28,//yaw_lpf 0-1
 };
 
-typedef union {
-    int8_t *varInt8;
-    int16_t *varInt16;
-    int32_t *varInt32;
-    uint8_t *varUint8;
-    uint16_t *varUint16;
-    uint32_t *varUint32;
-    float *varFloat;
-} DebugVarTrans;
-
-extern void *PC_receive_data[29];
+extern param_registry_t param_registry;
 
 extern void PC_receive_task(void const *argument);
 
@@ -64,4 +68,31 @@ extern void PC_receive_task(void const *argument);
   */
 extern uint32_t get_stack_of_PC_receive_task(void);
 
+/**
+  * @brief          USB CDC接收回调,把收到的数据放入参数请求队列,在USB中断中调用
+  * @param[in]      p_data: 数据
+  * @param[in]      len: 长度
+  * @retval         none
+  */
+extern void PC_receive_usb_rx(const uint8_t *p_data, uint32_t len);
+
+/**
+  * @brief          request from another task to save all parameters to a set,
+  *                 done by PC_receive_task
+  * @param[in]      set: set number, below PARAM_SET_NUM
+  * @retval         0: requested, -1: bad set or the last request is not done
+  */
+/**
+  * @brief          其他任务请求把全部参数保存到参数组,由PC_receive_task执行
+  * @param[in]      set: 参数组编号, 小于PARAM_SET_NUM
+  * @retval         0:已请求, -1:编号错误或上一次请求未完成
+  */
+extern int PC_receive_param_save(uint8_t set);
+
+/**
+  * @brief          上一次PC_receive_param_save的结果
+  * @retval         param_status_e, 未完成时为PARAM_ERR_BUSY
+  */
+extern uint8_t PC_receive_param_save_status(void);
+
 #endif //STANDARDROBOTBASICCODE_PC_RECEIVE_TASK_H
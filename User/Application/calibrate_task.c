@@ -26,13 +26,15 @@
   *                     or set to '\/', begin the gimbal calibration
   *                     or set to /''\, begin the chassis calibration
   *
-  *             data in flash, include cali data and name[3] and cali_flag
-  *             for example, head_cali has 8 bytes, and it need 12 bytes in flash. if it starts in 0x080A0000
-  *             0x080A0000-0x080A0007: head_cali data
-  *             0x080A0008: name[0]
-  *             0x080A0009: name[1]
-  *             0x080A000A: name[2]
-  *             0x080A000B: cali_flag, when cali_flag == 0x55, means head_cali has been calibrated.
+  *             data in flash: every sensor is one record of the key/value store
+  *             (flash_kv.c/h) on sector 10 and 11, the key is cali_id_e, the value is
+  *             the cali data followed by name[3] and cali_flag, when cali_flag == 0x55,
+  *             means it has been calibrated. A finished calibration appends only the
+  *             record of that sensor, a sector is erased only when the store is full.
+  *             The old fixed layout in sector 9 (FLASH_USER_ADDR) is imported once
+  *             when the store is empty.
+  *             Keys from CALI_STORE_USER_KEY hold records of other modules, they
+  *             are read and written by calibrate_task on request (cali_store_request).
   *             if add a sensor
   *             1.add cail sensro name in cali_id_e at calibrate_task.h, like
   *             typedef enum
@@ -50,7 +52,7 @@
   *                 uint16_t yyy;
   *                 float32_t zzz;
   *             } xxx_cali_t; //size: 8 bytes, must be 4, 8, 12, 16...
-  *             3.in "FLASH_WRITE_BUF_LENGHT", add "sizeof(xxx_cali_t)", and implement new function.
+  *             3.implement new function
   *             bool_t cali_xxx_hook(uint32_t *cali, bool_t cmd), and add the name in "cali_name[CALI_LIST_LENGHT][3]"
   *             and declare variable xxx_cali_t xxx_cail, add the data address in cali_sensor_buf[CALI_LIST_LENGHT]
   *             and add the data lenght in cali_sensor_size, at last, add function in cali_hook_fun[CALI_LIST_LENGHT]
@@ -61,13 +63,11 @@
   *                    或者摇杆打成'\/' 开始云台校准
   *                    或者摇杆打成/''\ 开始底盘校准
   *
-  *             数据在flash中，包括校准数据和名字 name[3] 和 校准标志位 cali_flag
-  *             例如head_cali有八个字节,但它需要12字节在flash,如果它从0x080A0000开始
-  *             0x080A0000-0x080A0007: head_cali数据
-  *             0x080A0008: 名字name[0]
-  *             0x080A0009: 名字name[1]
-  *             0x080A000A: 名字name[2]
-  *             0x080A000B: 校准标志位 cali_flag,当校准标志位为0x55,意味着head_cali已经校准了
+  *             数据在flash中: 每个设备是扇区10和11上键值存储(flash_kv.c/h)的一条记录,键为
+  *             cali_id_e,值为校准数据加上名字name[3]和校准标志位cali_flag,当校准标志位为0x55,
+  *             意味着已经校准了.校准完成时只追加该设备的记录,存储写满时才擦除扇区.
+  *             存储为空时从扇区9(FLASH_USER_ADDR)的旧格式导入一次
+  *             从CALI_STORE_USER_KEY开始的键保存其他模块的记录,由calibrate_task按请求读写
   *             添加新设备
   *             1.添加设备名在calibrate_task.h的cali_id_e, 像
   *             typedef enum
@@ -85,7 +85,7 @@
   *                 uint16_t yyy;
   *                 float32_t zzz;
   *             } xxx_cali_t; //长度:8字节 8 bytes, 必须是 4, 8, 12, 16...
-  *             3.在 "FLASH_WRITE_BUF_LENGHT",添加"sizeof(xxx_cali_t)", 和实现新函数
+  *             3.实现新函数
   *             bool_t cali_xxx_hook(uint32_t *cali, bool_t cmd), 添加新名字在 "cali_name[CALI_LIST_LENGHT][3]"
   *             和申明变量 xxx_cali_t xxx_cail, 添加变量地址在cali_sensor_buf[CALI_LIST_LENGHT]
   *             在cali_sensor_size[CALI_LIST_LENGHT]添加数据长度, 最后在cali_hook_fun[CALI_LIST_LENGHT]添加函数
@@ -96,6 +96,7 @@
   */
 
 #include "calibrate_task.h"
+#include "flash_kv.h"
 #include "string.h"
 #include "cmsis_os.h"
 
@@ -103,7 +104,7 @@
 #include "bsp_buzzer.h"
 #include "bsp_flash.h"
 
-#include "can_receive.h"
+#include "CAN_receive.h"
 #include "remote_control.h"
 #include "INS_task.h"
 #include "gimbal_task.h"
@@ -113,9 +114,6 @@
 #include "SEGGER_RTT.h"
 
 
-//include head,gimbal,gyro,accel,mag. gyro,accel and mag have the same data struct. total 5(CALI_LIST_LENGHT) devices, need data lenght + 5 * 4 bytes(name[3]+cali)
-#define FLASH_WRITE_BUF_LENGHT  (sizeof(head_cali_t) + sizeof(gimbal_cali_t) + sizeof(ahrs_cali_t) + CALI_LIST_LENGHT * 4)
-
 
 
 
@@ -144,16 +142,40 @@ static void RC_cmd_to_calibrate(void);
 static void cali_data_read(void);
 
 /**
-  * @brief          write the data to flash
+  * @brief          read cali data in the old fixed layout from FLASH_USER_ADDR
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          从FLASH_USER_ADDR读取旧格式的校准数据
+  * @param[in]      none
+  * @retval         none
+  */
+static void cali_data_read_legacy(void);
+
+/**
+  * @brief          append the cali data of one sensor to flash
+  * @param[in]      cali_id: sensor
+  * @retval         none
+  */
+/**
+  * @brief          往flash追加一个设备的校准数据
+  * @param[in]      cali_id: 设备
+  * @retval         none
+  */
+static void cali_data_write(uint8_t cali_id);
+
+/**
+  * @brief          carry out the pending store request of another module
   * @param[in]      none
   * @retval         none
   */
 /**
-  * @brief          往flash写入校准数据
+  * @brief          执行其他模块等待中的读写请求
   * @param[in]      none
   * @retval         none
   */
-static void cali_data_write(void);
+static void cali_store_request_handle(void);
 
 
 /**
@@ -229,7 +251,29 @@ static gimbal_cali_t gimbal_cali;     //gimbal cali data
 ahrs_cali_t gyro_mag_cali;       //gyro cali data
 
 
-static uint8_t flash_write_buf[FLASH_WRITE_BUF_LENGHT];
+static int8_t cali_flash_kv_erase(uint32_t address) {
+    cali_flash_erase(address, 1);
+    return 0;
+}
+
+static int8_t cali_flash_kv_program(uint32_t address, const uint32_t *buf, uint32_t len) {
+    return cali_flash_write(address, (uint32_t *) buf, len);
+}
+
+static void cali_flash_kv_read(uint32_t address, uint32_t *buf, uint32_t len) {
+    cali_flash_read(address, buf, len);
+}
+
+static const flash_kv_ops_t cali_flash_ops = {cali_flash_kv_erase, cali_flash_kv_program, cali_flash_kv_read};
+static flash_kv_t cali_store;           //cali data store.校准数据的键值存储
+static bool_t cali_store_ready;
+static uint32_t cali_record_buf[FLASH_KV_MAX_LEN];
+//store request of another module.其他模块的读写请求
+static volatile uint8_t cali_store_state = CALI_STORE_IDLE;
+static uint8_t cali_store_key;
+static uint8_t cali_store_len;
+static bool_t cali_store_write;
+static uint32_t *cali_store_buf;
 
 cali_sensor_t cali_sensor[CALI_LIST_LENGHT];
 
@@ -285,11 +329,12 @@ void calibrate_task(void const *pvParameters) {
 
                         cali_sensor[i].cali_cmd = 0;
                         //write
-                        cali_data_write();
+                        cali_data_write(i);
                     }
                 }
             }
         }
+        cali_store_request_handle();
 #if INCLUDE_uxTaskGetStackHighWaterMark
         calibrate_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
@@ -306,6 +351,29 @@ uint32_t get_stack_of_calibrate_task(void) {
     return calibrate_task_stack;
 }
 
+int cali_store_request(uint8_t key, uint32_t *buf, uint8_t len, bool_t write) {
+    int res = -1;
+
+    if (key < CALI_STORE_USER_KEY || key >= FLASH_KV_KEY_NUM || len == 0 || len > FLASH_KV_MAX_LEN) {
+        return -1;
+    }
+    taskENTER_CRITICAL();
+    if (cali_store_state != CALI_STORE_PENDING) {
+        cali_store_key = key;
+        cali_store_buf = buf;
+        cali_store_len = len;
+        cali_store_write = write;
+        cali_store_state = CALI_STORE_PENDING;
+        res = 0;
+    }
+    taskEXIT_CRITICAL();
+    return res;
+}
+
+uint8_t cali_store_request_state(void) {
+    return cali_store_state;
+}
+
 /**
   * @brief          get imu control temperature, unit ℃
   * @param[in]      none
@@ -513,6 +581,53 @@ void cali_param_init(void) {
   * @retval         none
   */
 static void cali_data_read(void) {
+    uint8_t i = 0;
+
+    cali_store_ready = (flash_kv_mount(&cali_store, &cali_flash_ops, CALI_FLASH_SECTOR_A, CALI_FLASH_SECTOR_B,
+                                       CALI_FLASH_SECTOR_SIZE) == 0);
+    if (!cali_store_ready || flash_kv_is_empty(&cali_store)) {
+        //first boot with the store, import the old layout
+        //首次使用键值存储,导入旧格式
+        cali_data_read_legacy();
+        for (i = 0; i < CALI_LIST_LENGHT; i++) {
+            if (cali_sensor[i].cali_done == CALIED_FLAG) {
+                cali_data_write(i);
+            }
+        }
+    } else {
+        for (i = 0; i < CALI_LIST_LENGHT; i++) {
+            if (flash_kv_read(&cali_store, i, cali_record_buf,
+                              cali_sensor[i].flash_len + CALI_SENSOR_HEAD_LEGHT) == 0) {
+                memcpy((void *) cali_sensor[i].flash_buf, (void *) cali_record_buf, cali_sensor[i].flash_len * 4);
+                memcpy((void *) cali_sensor[i].name, (void *) (cali_record_buf + cali_sensor[i].flash_len),
+                       CALI_SENSOR_HEAD_LEGHT * 4);
+            } else {
+                //no record or the data struct has changed, need calibrate
+                //没有记录或数据结构已改变,需要校准
+                cali_sensor[i].cali_done = 0;
+            }
+        }
+    }
+
+    for (i = 0; i < CALI_LIST_LENGHT; i++) {
+        if (CALI_BLOCK == Cali_Auto)
+            if (cali_sensor[i].cali_done != CALIED_FLAG && cali_sensor[i].cali_hook != NULL) {
+                cali_sensor[i].cali_cmd = 1;
+            }
+    }
+}
+
+/**
+  * @brief          read cali data in the old fixed layout from FLASH_USER_ADDR
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          从FLASH_USER_ADDR读取旧格式的校准数据
+  * @param[in]      none
+  * @retval         none
+  */
+static void cali_data_read_legacy(void) {
     uint8_t flash_read_buf[CALI_SENSOR_HEAD_LEGHT * 4];
     uint8_t i = 0;
     uint16_t offset = 0;
@@ -532,43 +647,49 @@ static void cali_data_read(void) {
         cali_sensor[i].cali_done = flash_read_buf[3];
 
         offset += CALI_SENSOR_HEAD_LEGHT * 4;
-        if (CALI_BLOCK == Cali_Auto)
-            if (cali_sensor[i].cali_done != CALIED_FLAG && cali_sensor[i].cali_hook != NULL) {
-                cali_sensor[i].cali_cmd = 1;
-            }
     }
 }
 
 
 /**
-  * @brief          write the data to flash
-  * @param[in]      none
+  * @brief          append the cali data of one sensor to flash
+  * @param[in]      cali_id: sensor
   * @retval         none
   */
 /**
-  * @brief          往flash写入校准数据
-  * @param[in]      none
+  * @brief          往flash追加一个设备的校准数据
+  * @param[in]      cali_id: 设备
   * @retval         none
   */
-static void cali_data_write(void) {
-    uint8_t i = 0;
-    uint16_t offset = 0;
+static void cali_data_write(uint8_t cali_id) {
+    cali_sensor_t *p_sensor = &cali_sensor[cali_id];
 
+    if (!cali_store_ready) {
+        return;
+    }
+    //copy the data of device calibration data, then the name and "CALI_FLAG" of device
+    //复制设备校准数据,之后是名字和校准标志位
+    memcpy((void *) cali_record_buf, (void *) p_sensor->flash_buf, p_sensor->flash_len * 4);
+    memcpy((void *) (cali_record_buf + p_sensor->flash_len), (void *) p_sensor->name, CALI_SENSOR_HEAD_LEGHT * 4);
+    //only this record is appended, no sector erase unless the store is full
+    //只追加这一条记录,存储写满之前不擦除扇区
+    flash_kv_write(&cali_store, cali_id, cali_record_buf, p_sensor->flash_len + CALI_SENSOR_HEAD_LEGHT);
+}
 
-    for (i = 0; i < CALI_LIST_LENGHT; i++) {
-        //copy the data of device calibration data
-        memcpy((void *) (flash_write_buf + offset), (void *) cali_sensor[i].flash_buf, cali_sensor[i].flash_len * 4);
-        offset += cali_sensor[i].flash_len * 4;
+static void cali_store_request_handle(void) {
+    int res = -1;
 
-        //copy the name and "CALI_FLAG" of device
-        memcpy((void *) (flash_write_buf + offset), (void *) cali_sensor[i].name, CALI_SENSOR_HEAD_LEGHT * 4);
-        offset += CALI_SENSOR_HEAD_LEGHT * 4;
+    if (cali_store_state != CALI_STORE_PENDING) {
+        return;
     }
-
-    //erase the page
-    cali_flash_erase(FLASH_USER_ADDR, 1);
-    //write data
-    cali_flash_write(FLASH_USER_ADDR, (uint32_t *) flash_write_buf, (FLASH_WRITE_BUF_LENGHT + 3) / 4);
+    if (cali_store_ready) {
+        if (cali_store_write) {
+            res = flash_kv_write(&cali_store, cali_store_key, cali_store_buf, cali_store_len);
+        } else {
+            res = flash_kv_read(&cali_store, cali_store_key, cali_store_buf, cali_store_len);
+        }
+    }
+    cali_store_state = (res == 0) ? CALI_STORE_DONE : CALI_STORE_FAILED;
 }
 
 
@@ -26,13 +26,15 @@
   *                     or set to '\/', begin the gimbal calibration
   *                     or set to /''\, begin the chassis calibration
   *
-  *             data in flash, include cali data and name[3] and cali_flag
-  *             for example, head_cali has 8 bytes, and it need 12 bytes in flash. if it starts in 0x080A0000
-  *             0x080A0000-0x080A0007: head_cali data
-  *             0x080A0008: name[0]
-  *             0x080A0009: name[1]
-  *             0x080A000A: name[2]
-  *             0x080A000B: cali_flag, when cali_flag == 0x55, means head_cali has been calibrated.
+  *             data in flash: every sensor is one record of the key/value store
+  *             (flash_kv.c/h) on sector 10 and 11, the key is cali_id_e, the value is
+  *             the cali data followed by name[3] and cali_flag, when cali_flag == 0x55,
+  *             means it has been calibrated. A finished calibration appends only the
+  *             record of that sensor, a sector is erased only when the store is full.
+  *             The old fixed layout in sector 9 (FLASH_USER_ADDR) is imported once
+  *             when the store is empty.
+  *             Keys from CALI_STORE_USER_KEY hold records of other modules, they
+  *             are read and written by calibrate_task on request (cali_store_request).
   *             if add a sensor
   *             1.add cail sensro name in cali_id_e at calibrate_task.h, like
   *             typedef enum
@@ -50,7 +52,7 @@
   *                 uint16_t yyy;
   *                 float32_t zzz;
   *             } xxx_cali_t; //size: 8 bytes, must be 4, 8, 12, 16...
-  *             3.in "FLASH_WRITE_BUF_LENGHT", add "sizeof(xxx_cali_t)", and implement new function.
+  *             3.implement new function
   *             bool_t cali_xxx_hook(uint32_t *cali, bool_t cmd), and add the name in "cali_name[CALI_LIST_LENGHT][3]"
   *             and declare variable xxx_cali_t xxx_cail, add the data address in cali_sensor_buf[CALI_LIST_LENGHT]
   *             and add the data lenght in cali_sensor_size, at last, add function in cali_hook_fun[CALI_LIST_LENGHT]
@@ -61,13 +63,11 @@
   *                    或者摇杆打成'\/' 开始云台校准
   *                    或者摇杆打成/''\ 开始底盘校准
   *
-  *             数据在flash中，包括校准数据和名字 name[3] 和 校准标志位 cali_flag
-  *             例如head_cali有八个字节,但它需要12字节在flash,如果它从0x080A0000开始
-  *             0x080A0000-0x080A0007: head_cali数据
-  *             0x080A0008: 名字name[0]
-  *             0x080A0009: 名字name[1]
-  *             0x080A000A: 名字name[2]
-  *             0x080A000B: 校准标志位 cali_flag,当校准标志位为0x55,意味着head_cali已经校准了
+  *             数据在flash中: 每个设备是扇区10和11上键值存储(flash_kv.c/h)的一条记录,键为
+  *             cali_id_e,值为校准数据加上名字name[3]和校准标志位cali_flag,当校准标志位为0x55,
+  *             意味着已经校准了.校准完成时只追加该设备的记录,存储写满时才擦除扇区.
+  *             存储为空时从扇区9(FLASH_USER_ADDR)的旧格式导入一次
+  *             从CALI_STORE_USER_KEY开始的键保存其他模块的记录,由calibrate_task按请求读写
   *             添加新设备
   *             1.添加设备名在calibrate_task.h的cali_id_e, 像
   *             typedef enum
@@ -85,7 +85,7 @@
   *                 uint16_t yyy;
   *                 float32_t zzz;
   *             } xxx_cali_t; //长度:8字节 8 bytes, 必须是 4, 8, 12, 16...
-  *             3.在 "FLASH_WRITE_BUF_LENGHT",添加"sizeof(xxx_cali_t)", 和实现新函数
+  *             3.实现新函数
   *             bool_t cali_xxx_hook(uint32_t *cali, bool_t cmd), 添加新名字在 "cali_name[CALI_LIST_LENGHT][3]"
   *             和申明变量 xxx_cali_t xxx_cail, 添加变量地址在cali_sensor_buf[CALI_LIST_LENGHT]
   *             在cali_sensor_size[CALI_LIST_LENGHT]添加数据长度, 最后在cali_hook_fun[CALI_LIST_LENGHT]添加函数
@@ -125,7 +125,10 @@
 #define gyro_cali_disable_control()         RC_unable()                 //when imu is calibrating, disable the remote control.当imu在校准时候,失能遥控器
 #define gyro_cali_enable_control()          RC_restart(SBUS_RX_BUF_NUM)
 
-#define FLASH_USER_ADDR         ADDR_FLASH_SECTOR_9 //write flash page 9,保存的flash页地址
+#define FLASH_USER_ADDR         ADDR_FLASH_SECTOR_9 //old fixed layout, only read once to import.旧格式的flash页地址,仅导入时读取
+#define CALI_FLASH_SECTOR_A     ADDR_FLASH_SECTOR_10 //key/value store sectors.键值存储的两个扇区
+#define CALI_FLASH_SECTOR_B     ADDR_FLASH_SECTOR_11
+#define CALI_FLASH_SECTOR_SIZE  (128U * 1024U)
 
 #define GYRO_CONST_MAX_TEMP     45.0f               //max control temperature of gyro,最大陀螺仪控制温度
 
@@ -158,6 +161,9 @@
 
 #define GYRO_CALIBRATE_TIME         20000   //gyro calibrate time,陀螺仪校准时间 GYRO_CALIBRATE_TIME*
 
+//keys after the cali data are left to other modules, like the parameter sets.校准数据之后的键留给其他模块,如参数组
+#define CALI_STORE_USER_KEY         CALI_LIST_LENGHT
+
 //cali device name
 typedef enum {
     CALI_HEAD = 0,
@@ -167,6 +173,14 @@ typedef enum {
     CALI_LIST_LENGHT,
 } cali_id_e;
 
+//state of a store request.其他模块读写请求的状态
+typedef enum {
+    CALI_STORE_IDLE = 0,
+    CALI_STORE_PENDING,
+    CALI_STORE_DONE,
+    CALI_STORE_FAILED,
+} cali_store_state_e;
+
 #pragma pack(push, 1)
 typedef struct {
     uint8_t name[3];                                    //device name
@@ -257,6 +271,32 @@ extern void get_flash_latitude(float *latitude);
   * @retval         none
   */
 extern void calibrate_task(void const *pvParameters);
+
+/**
+  * @brief          request calibrate_task to read or append a record of a key after
+  *                 the cali data, so the flash is only accessed by calibrate_task.
+  *                 buf must stay valid until the request is done.
+  * @param[in]      key: CALI_STORE_USER_KEY ~ FLASH_KV_KEY_NUM - 1
+  * @param[in][out] buf: record, [out] when reading
+  * @param[in]      len: record length in words, a read needs the saved length
+  * @param[in]      write: 1 append, 0 read
+  * @retval         0: accepted, -1: bad key or the last request is pending
+  */
+/**
+  * @brief          请求calibrate_task读取或追加一条校准数据之后的键的记录,flash只由
+  *                 calibrate_task访问.请求完成前buf必须保持有效
+  * @param[in]      key: CALI_STORE_USER_KEY ~ FLASH_KV_KEY_NUM - 1
+  * @param[in][out] buf: 记录,读取时为[out]
+  * @param[in]      len: 记录长度,单位字,读取时必须与保存时相同
+  * @param[in]      write: 1追加, 0读取
+  * @retval         0:已接受, -1:键错误或上一次请求尚未完成
+  */
+extern int cali_store_request(uint8_t key, uint32_t *buf, uint8_t len, bool_t write);
+
+/**
+  * @brief          获取读写请求的状态, cali_store_state_e
+  */
+extern uint8_t cali_store_request_state(void);
 extern ahrs_cali_t gyro_mag_cali;
 extern cali_sensor_t cali_sensor[CALI_LIST_LENGHT];
 #endif
@@ -2,12 +2,14 @@
   ****************************(C) COPYRIGHT 2019 DJI****************************
   * @file       chassis_power_control.c/h
   * @brief      chassis power control.底盘功率控制
-  * @note       this is only controling 80 w power, mainly limit motor current set.
-  *             if power limit is 40w, reduce the value JUDGE_TOTAL_CURRENT_LIMIT 
-  *             and POWER_CURRENT_LIMIT, and chassis max speed (include max_vx_speed, min_vx_speed)
-  *             只控制80w功率，主要通过控制电机电流设定值,如果限制功率是40w，减少
-  *             JUDGE_TOTAL_CURRENT_LIMIT和POWER_CURRENT_LIMIT的值，还有底盘最大速度
-  *             (包括max_vx_speed, min_vx_speed)
+  * @note       the electrical power of the four wheels is predicted every cycle from
+  *             the current set and the motor speed, the referee buffer energy is
+  *             integrated between the slow referee packets, and the accelerating
+  *             wheels are scaled to the largest current that fits the budget, see
+  *             power_limiter.c/h. Without referee the total current is limited only.
+  *             每个周期由电流设定值和电机转速预测四个轮子的电功率,在较慢的裁判数据之间
+  *             积分缓冲能量,把加速的轮子缩放到预算内的最大电流,见power_limiter.c/h.
+  *             无裁判系统时只限制总电流
   * @history
   *  Version    Date            Author          Modification
   *  V1.0.0     Nov-11-2019     RM              1. add chassis power control
@@ -23,7 +25,53 @@
 #include "referee_task.h"
 #include "arm_math.h"
 #include "detect_task.h"
-#include "SEGGER_RTT.h"
+#include "super_capacitance_control_task.h"
+#include "flight_recorder.h"
+/**
+  * @brief          init the power limiter
+  * @param[out]     chassis_power_control: chassis data
+  * @retval         none
+  */
+/**
+  * @brief          初始化功率限制器
+  * @param[out]     chassis_power_control: 底盘数据
+  * @retval         none
+  */
+void chassis_power_control_init(chassis_move_t *chassis_power_control) {
+    static const power_limiter_param_t chassis_power_param = {
+            .torque_constant = CHASSIS_MOTOR_TORQUE_CONSTANT,
+            .resistance = CHASSIS_MOTOR_RESISTANCE,
+            .speed_loss = CHASSIS_MOTOR_SPEED_LOSS,
+            .static_power = CHASSIS_STATIC_POWER,
+            .buffer_max = CHASSIS_POWER_BUFFER_MAX,
+            .buffer_reserve = CHASSIS_POWER_BUFFER_RESERVE,
+            .spend_time = CHASSIS_POWER_SPEND_TIME,
+            .recover_time = CHASSIS_POWER_RECOVER_TIME,
+            .cap_spend_time = SUPER_CAPACITANCE_SPEND_TIME,
+            .cap_power_max = SUPER_CAPACITANCE_POWER_MAX,
+            .correction_min = CHASSIS_POWER_CORRECTION_MIN,
+            .correction_max = CHASSIS_POWER_CORRECTION_MAX,
+    };
+    power_limiter_init(&chassis_power_control->power_limiter, &chassis_power_param);
+}
+
+/**
+  * @brief          超级电容可用能量 0.5*C*(V^2 - Vmin^2),离线或未开启时为0
+  */
+static float32_t chassis_super_capacitance_energy(const chassis_move_t *chassis_power_control) {
+    float32_t voltage;
+    if (toe_is_error(SUPER_CAPACITANCE_TOE) || !super_capacitance_enable_flag ||
+        chassis_power_control->super_capacitance_measure_point == NULL) {
+        return 0.0f;
+    }
+    voltage = chassis_power_control->super_capacitance_measure_point->CapacitanceVoltage;
+    if (voltage <= SUPER_CAPACITANCE_MIN_VOLTAGE) {
+        return 0.0f;
+    }
+    return 0.5f * SUPER_CAPACITANCE_FARAD *
+           (voltage * voltage - SUPER_CAPACITANCE_MIN_VOLTAGE * SUPER_CAPACITANCE_MIN_VOLTAGE);
+}
+
 /**
   * @brief          limit the power, mainly limit motor current
   * @param[in]      chassis_power_control: chassis data 
@@ -37,82 +85,50 @@
 void chassis_power_control(chassis_move_t *chassis_power_control) {
     float32_t chassis_power = 0.0f;
     float32_t chassis_power_buffer = 0.0f;
-    float32_t total_current_limit = 0.0f;
     float32_t total_current = 0.0f;
+    float32_t current[4], speed[4];
     uint8_t robot_id = get_robot_id();
+    uint8_t i;
     if (toe_is_error(SUPER_CAPACITANCE_TOE)) {
         chassis_power_control->soft_power_limit = chassis_power_control->power_limit;
     } else{
-//        SEGGER_RTT_printf(0,"%d",chassis_power_control->soft_power_limit);
         if(!super_capacitance_enable_flag){
             chassis_power_control->soft_power_limit = chassis_power_control->power_limit;
         }
     }
-    if (toe_is_error(REFEREE_RX_TOE)) {
-        total_current_limit = NO_JUDGE_TOTAL_CURRENT_LIMIT;
-    } else if (robot_id == 2 || robot_id == 102 || robot_id == 0) {
-        total_current_limit = NO_JUDGE_TOTAL_CURRENT_LIMIT;
-    } else {
-//        SEGGER_RTT_printf(0,"%d\r\n",chassis_power_control->soft_power_limit);
-        get_chassis_power_and_buffer(&chassis_power, &chassis_power_buffer);
-        // power > 80w and buffer < 60j, because buffer < 60 means power has been more than 80w
-        //功率超过80w 和缓冲能量小于60j,因为缓冲能量小于60意味着功率超过80w
-        if (chassis_power_buffer < WARNING_POWER_BUFF) {
-            float32_t power_scale;
-            if (chassis_power_buffer > 6.0f) {
-                //scale down WARNING_POWER_BUFF
-                //缩小WARNING_POWER_BUFF
-                power_scale = chassis_power_buffer / WARNING_POWER_BUFF;
-            } else {
-                //only left 10% of WARNING_POWER_BUFF
-                power_scale = 6.0f / WARNING_POWER_BUFF;
-            }
-            //scale down
-            //缩小
-            total_current_limit = BUFFER_TOTAL_CURRENT_LIMIT * power_scale;
-        } else {
-            //power > WARNING_POWER
-            //功率大于WARNING_POWER
-            if (chassis_power > (chassis_power_control->soft_power_limit - WARNING_POWER)) {
-                float32_t power_scale;
-                //power < 60w
-                //功率小于60w
-                if (chassis_power < chassis_power_control->soft_power_limit) {
-                    //scale down
-                    //缩小
-                    power_scale = (chassis_power_control->soft_power_limit - chassis_power) /
-                                  (chassis_power_control->soft_power_limit -
-                                   (chassis_power_control->soft_power_limit - WARNING_POWER));
-
-                } else {
-                    //power > 80w
-                    //功率大于80w
-                    power_scale = 0.0f;
-                }
-
-                total_current_limit = BUFFER_TOTAL_CURRENT_LIMIT + POWER_TOTAL_CURRENT_LIMIT * power_scale;
-            } else {
-                //power < WARNING_POWER
-                //功率小于WARNING_POWER
-                total_current_limit = BUFFER_TOTAL_CURRENT_LIMIT + POWER_TOTAL_CURRENT_LIMIT;
+    if (toe_is_error(REFEREE_RX_TOE) || robot_id == 2 || robot_id == 102 || robot_id == 0) {
+        //calculate the original motor current set
+        //计算原本电机电流设定
+        for (i = 0; i < 4; i++) {
+            total_current += fabsf(chassis_power_control->motor_speed_batch.out[i]);
+        }
+        if (total_current > NO_JUDGE_TOTAL_CURRENT_LIMIT) {
+            float32_t current_scale = NO_JUDGE_TOTAL_CURRENT_LIMIT / total_current;
+            for (i = 0; i < 4; i++) {
+                chassis_power_control->motor_speed_batch.out[i] *= current_scale;
             }
         }
+        return;
     }
 
-
-    total_current = 0.0f;
-    //calculate the original motor current set
-    //计算原本电机电流设定
-    for (uint8_t i = 0; i < 4; i++) {
-        total_current += fabsf(chassis_power_control->motor_speed_pid[i].out);
+    //新的裁判数据校正功率模型,重置缓冲能量估计
+    if (get_chassis_power_update(&chassis_power, &chassis_power_buffer)) {
+        power_limiter_referee_update(&chassis_power_control->power_limiter, chassis_power, chassis_power_buffer);
+        flight_recorder_log_f(FLIGHT_RECORD_POWER, 0,
+                              (int16_t) (chassis_power_control->power_limiter.scale * 1000.0f),
+                              chassis_power, chassis_power_buffer);
     }
-
-
-    if (total_current > total_current_limit) {
-        float32_t current_scale = total_current_limit / total_current;
-        chassis_power_control->motor_speed_pid[0].out *= current_scale;
-        chassis_power_control->motor_speed_pid[1].out *= current_scale;
-        chassis_power_control->motor_speed_pid[2].out *= current_scale;
-        chassis_power_control->motor_speed_pid[3].out *= current_scale;
+    for (i = 0; i < 4; i++) {
+        current[i] = chassis_power_control->motor_speed_batch.out[i] * CHASSIS_MOTOR_CURRENT_TO_A;
+        speed[i] = chassis_power_control->motor_chassis[i].motor_snapshot.measure.speed_rpm *
+                   CHASSIS_MOTOR_RPM_TO_RAD_S;
+    }
+    power_limiter_budget(&chassis_power_control->power_limiter, chassis_power_control->power_limit,
+                         chassis_super_capacitance_energy(chassis_power_control));
+    if (power_limiter_apply(&chassis_power_control->power_limiter, current, speed, 4,
+                            chassis_power_control->power_limit, CHASSIS_CONTROL_TIME) < 1.0f) {
+        for (i = 0; i < 4; i++) {
+            chassis_power_control->motor_speed_batch.out[i] = current[i] / CHASSIS_MOTOR_CURRENT_TO_A;
+        }
     }
 }
@@ -2,12 +2,14 @@
   ****************************(C) COPYRIGHT 2019 DJI****************************
   * @file       chassis_power_control.c/h
   * @brief      chassis power control.底盘功率控制
-  * @note       this is only controling 80 w power, mainly limit motor current set.
-  *             if power limit is 40w, reduce the value JUDGE_TOTAL_CURRENT_LIMIT 
-  *             and POWER_CURRENT_LIMIT, and chassis max speed (include max_vx_speed, min_vx_speed)
-  *             只控制80w功率，主要通过控制电机电流设定值,如果限制功率是40w，减少
-  *             JUDGE_TOTAL_CURRENT_LIMIT和POWER_CURRENT_LIMIT的值，还有底盘最大速度
-  *             (包括max_vx_speed, min_vx_speed)
+  * @note       the electrical power of the four wheels is predicted every cycle from
+  *             the current set and the motor speed, the referee buffer energy is
+  *             integrated between the slow referee packets, and the accelerating
+  *             wheels are scaled to the largest current that fits the budget, see
+  *             power_limiter.c/h. Without referee the total current is limited only.
+  *             每个周期由电流设定值和电机转速预测四个轮子的电功率,在较慢的裁判数据之间
+  *             积分缓冲能量,把加速的轮子缩放到预算内的最大电流,见power_limiter.c/h.
+  *             无裁判系统时只限制总电流
   * @history
   *  Version    Date            Author          Modification
   *  V1.1.0     Nov-11-2019     RM              1. add chassis power control
@@ -25,12 +27,40 @@
 #include "main.h"
 
 #define POWER_LIMIT         40.0f
-#define WARNING_POWER       10.0f
-#define WARNING_POWER_BUFF  60.0f
 
 #define NO_JUDGE_TOTAL_CURRENT_LIMIT    64000.0f    //16000 * 4,
-#define BUFFER_TOTAL_CURRENT_LIMIT      16000.0f
-#define POWER_TOTAL_CURRENT_LIMIT       20000.0f
+
+//M3508功率模型,转子侧,系数需按实车标定,运行时由裁判功率在线校正
+#define CHASSIS_MOTOR_CURRENT_TO_A          (20.0f / 16384.0f)
+#define CHASSIS_MOTOR_RPM_TO_RAD_S          0.10471975512f
+#define CHASSIS_MOTOR_TORQUE_CONSTANT       (0.3f * 187.0f / 3591.0f)
+#define CHASSIS_MOTOR_RESISTANCE            0.2f
+#define CHASSIS_MOTOR_SPEED_LOSS            1.0e-5f
+#define CHASSIS_STATIC_POWER                3.0f
+#define CHASSIS_POWER_CORRECTION_MIN        0.5f
+#define CHASSIS_POWER_CORRECTION_MAX        2.0f
+//缓冲能量:高于保留值的部分在SPEND_TIME内用完,低于保留值时在RECOVER_TIME内补回
+#define CHASSIS_POWER_BUFFER_MAX            60.0f
+#define CHASSIS_POWER_BUFFER_RESERVE        10.0f
+#define CHASSIS_POWER_SPEND_TIME            0.2f
+#define CHASSIS_POWER_RECOVER_TIME          1.0f
+//超级电容:可用能量 0.5*C*(V^2 - Vmin^2)
+#define SUPER_CAPACITANCE_FARAD             6.0f
+#define SUPER_CAPACITANCE_MIN_VOLTAGE       12.0f
+#define SUPER_CAPACITANCE_SPEND_TIME        2.0f
+#define SUPER_CAPACITANCE_POWER_MAX         200.0f
+
+/**
+  * @brief          init the power limiter
+  * @param[out]     chassis_power_control: chassis data
+  * @retval         none
+  */
+/**
+  * @brief          初始化功率限制器
+  * @param[out]     chassis_power_control: 底盘数据
+  * @retval         none
+  */
+extern void chassis_power_control_init(chassis_move_t *chassis_power_control);
 
 /**
   * @brief          limit the power, mainly limit motor current
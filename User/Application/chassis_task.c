@@ -29,9 +29,12 @@
 #include "INS_task.h"
 #include "chassis_power_control.h"
 #include "DWT.h"
+#include "profile.h"
+#include "flight_recorder.h"
 #include "SEGGER_RTT.h"
 #include "pid_auto_tune_task.h"
 #include "global_control_define.h"
+#include "PC_receive_task.h"
 
 #define rc_deadband_limit(input, output, dealine)        \
     {                                                    \
@@ -119,6 +122,13 @@ static void chassis_set_contorl(chassis_move_t *chassis_move_control);
   */
 static void chassis_control_loop(chassis_move_t *chassis_move_control_loop);
 
+/**
+  * @brief          四个电机速度环合并计算,结果在motor_speed_batch.out
+  * @param[out]     chassis_speed_pid:"chassis_move"变量指针.
+  * @retval         none
+  */
+static void chassis_motor_speed_pid(chassis_move_t *chassis_speed_pid);
+
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t chassis_task_stack;
 #endif
@@ -155,10 +165,20 @@ void chassis_task(void const *pvParameters) {
     }
 
     TickType_t LoopStartTime;
+    uint8_t record_cnt = 0;
+    uint8_t i;
 
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_chassis_task);
+        profile_begin(PROFILE_CHASSIS_TASK);
         LoopStartTime = xTaskGetTickCount();
+        //apply the staged parameters as a whole
+        //在线修改的参数整批生效
+        if (param_registry_apply(&param_registry, PARAM_OWNER_CHASSIS) > 0U) {
+            for (i = 0; i < 4; i++) {
+                pid_batch_load(&chassis_move.motor_speed_batch, i, &chassis_move.motor_speed_pid[i]);
+            }
+        }
         //set chassis control mode
         //设置底盘控制模式
         chassis_set_mode(&chassis_move);
@@ -190,9 +210,18 @@ void chassis_task(void const *pvParameters) {
                                chassis_move.motor_chassis[2].give_current, chassis_move.motor_chassis[3].give_current);
             }
         }
+        //飞行记录仪记录电机电流,速度设定和速度
+        if (++record_cnt >= CHASSIS_RECORD_TIME_MS / CHASSIS_CONTROL_TIME_MS) {
+            record_cnt = 0;
+            for (i = 0; i < 4; i++) {
+                flight_recorder_log_f(FLIGHT_RECORD_MOTOR, i, chassis_move.motor_chassis[i].give_current,
+                                      chassis_move.motor_chassis[i].speed_set, chassis_move.motor_chassis[i].speed);
+            }
+        }
 #if INCLUDE_uxTaskGetStackHighWaterMark
         chassis_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
+        profile_end(PROFILE_CHASSIS_TASK);
         vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(CHASSIS_CONTROL_TIME_MS));
     }
 }
@@ -231,9 +260,24 @@ static void chassis_init(chassis_move_t *chassis_move_init) {
     //chassis angle PID
     //底盘角度pid值
     const static float32_t chassis_yaw_follow_pid[3] = {2.8f, 10.143f, 300.4152f};
+    //跟随云台的相对角度按2pi回绕
+    const static pid_config_t chassis_angle_config = {
+            .mode = PID_POSITION,
+            .max_out = CHASSIS_FOLLOW_GIMBAL_PID_MAX_OUT,
+            .max_iout = CHASSIS_FOLLOW_GIMBAL_PID_MAX_IOUT,
+            .integral_separation = 1000,
+            .wrap = PID_WRAP_ANGLE,
+            .integral = PID_INTEGRAL_TRAPEZOID,
+            .derivative = PID_D_NORMAL,
+            .reset_time = PID_RESET_TIME,
+    };
 
 //    const static float32_t chassis_x_order_filter[1] = {CHASSIS_ACCEL_X_NUM};
 //    const static float32_t chassis_y_order_filter[1] = {CHASSIS_ACCEL_Y_NUM};
+    const pid_type_def *const motor_speed_lane[4] = {&chassis_move_init->motor_speed_pid[0],
+                                                     &chassis_move_init->motor_speed_pid[1],
+                                                     &chassis_move_init->motor_speed_pid[2],
+                                                     &chassis_move_init->motor_speed_pid[3]};
     uint8_t i;
 
     //in beginning， chassis mode is raw 
@@ -260,11 +304,10 @@ static void chassis_init(chassis_move_t *chassis_move_init) {
         PID_init(&chassis_move_init->motor_speed_pid[i], PID_POSITION, motor_speed_pid, M3505_MOTOR_SPEED_PID_MAX_OUT,
                  M3505_MOTOR_SPEED_PID_MAX_IOUT, 1000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
+    pid_batch_init(&chassis_move_init->motor_speed_batch, motor_speed_lane, 4);
     //initialize angle PID
     //初始化角度PID
-    PID_init(&chassis_move_init->chassis_angle_pid, PID_POSITION, chassis_yaw_follow_pid,
-             CHASSIS_FOLLOW_GIMBAL_PID_MAX_OUT,
-             CHASSIS_FOLLOW_GIMBAL_PID_MAX_IOUT, 1000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    PID_build(&chassis_move_init->chassis_angle_pid, chassis_yaw_follow_pid, &chassis_angle_config);
     PID_init(&chassis_move_init->chassis_vx_speed_pid, PID_POSITION, chassis_vx_speed_pid,
              CHASSIS_FOLLOW_GIMBAL_PID_MAX_OUT,
              CHASSIS_FOLLOW_GIMBAL_PID_MAX_IOUT, 0.1f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
@@ -291,6 +334,7 @@ static void chassis_init(chassis_move_t *chassis_move_init) {
     chassis_move_init->vy_min_speed = -NORMAL_MAX_CHASSIS_SPEED_Y;
 
     chassis_move_init->soft_power_limit = chassis_move_init->power_limit = POWER_LIMIT;
+    chassis_power_control_init(chassis_move_init);
     //update data
     //更新一下数据
     chassis_feedback_update(chassis_move_init);
@@ -413,10 +457,11 @@ static void chassis_feedback_update(chassis_move_t *chassis_move_update) {
     for (i = 0; i < 4; i++) {
         //update motor speed, accel is differential of speed PID
         //更新电机速度，加速度是速度的PID微分
+        can_motor_snapshot((can_motor_e) (CAN_MOTOR_CHASSIS_1 + i), &chassis_move_update->motor_chassis[i].motor_snapshot);
         chassis_move_update->motor_chassis[i].speed = CHASSIS_MOTOR_RPM_TO_VECTOR_SEN *
-                                                      chassis_move_update->motor_chassis[i].chassis_motor_measure->speed_rpm;
+                                                      chassis_move_update->motor_chassis[i].motor_snapshot.measure.speed_rpm;
         chassis_move_update->motor_chassis[i].accel =
-                chassis_move_update->motor_speed_pid[i].Dbuf[0] * CHASSIS_CONTROL_FREQUENCE;
+                chassis_move_update->motor_speed_batch.dbuf[i] * CHASSIS_CONTROL_FREQUENCE;
     }
 
     //calculate vertical speed, horizontal speed ,rotation speed, left hand rule 
@@ -839,14 +884,10 @@ static void chassis_control_loop(chassis_move_t *chassis_move_control_loop) {
             }
             //calculate pid
             //计算pid
-            for (i = 0; i < 4; i++) {
-                ALL_PID(&chassis_move_control_loop->motor_speed_pid[i],
-                        chassis_move_control_loop->motor_chassis[i].speed,
-                        chassis_move_control_loop->motor_chassis[i].speed_set);
-            }
+            chassis_motor_speed_pid(chassis_move_control_loop);
             //赋值电流值
             for (i = 0; i < 4; i++) {
-                chassis_move_control_loop->motor_chassis[i].give_current = (int16_t) (chassis_move_control_loop->motor_speed_pid[i].out);
+                chassis_move_control_loop->motor_chassis[i].give_current = (int16_t) (chassis_move_control_loop->motor_speed_batch.out[i]);
             }
         }
 
@@ -854,10 +895,7 @@ static void chassis_control_loop(chassis_move_t *chassis_move_control_loop) {
     } else {
         //calculate pid
         //计算pid
-        for (i = 0; i < 4; i++) {
-            ALL_PID(&chassis_move_control_loop->motor_speed_pid[i], chassis_move_control_loop->motor_chassis[i].speed,
-                    chassis_move_control_loop->motor_chassis[i].speed_set);
-        }
+        chassis_motor_speed_pid(chassis_move_control_loop);
 
 //        SEGGER_RTT_printf(0,"%d",chassis_move_control_loop->soft_power_limit);
         //功率控制
@@ -866,8 +904,21 @@ static void chassis_control_loop(chassis_move_t *chassis_move_control_loop) {
 
         //赋值电流值
         for (i = 0; i < 4; i++) {
-            chassis_move_control_loop->motor_chassis[i].give_current = (int16_t) (chassis_move_control_loop->motor_speed_pid[i].out);
+            chassis_move_control_loop->motor_chassis[i].give_current = (int16_t) (chassis_move_control_loop->motor_speed_batch.out[i]);
         }
     }
 
 }
+
+static void chassis_motor_speed_pid(chassis_move_t *chassis_speed_pid) {
+    float32_t speed[4], speed_set[4];
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        speed[i] = chassis_speed_pid->motor_chassis[i].speed;
+        speed_set[i] = chassis_speed_pid->motor_chassis[i].speed_set;
+    }
+    profile_begin(PROFILE_CHASSIS_PID);
+    pid_batch_calc(&chassis_speed_pid->motor_speed_batch, speed, speed_set);
+    profile_end(PROFILE_CHASSIS_PID);
+}
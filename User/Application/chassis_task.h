@@ -21,6 +21,8 @@
 
 #include "struct_typedef.h"
 #include "gimbal_task.h"
+#include "power_limiter.h"
+#include "pid_batch.h"
 
 //in the beginning of task ,wait a time
 //任务开始空闲一段时间
@@ -86,6 +88,8 @@
 //chassis task control time 0.001s
 //底盘任务控制间隔 0.001s
 #define CHASSIS_CONTROL_TIME 0.001f
+//飞行记录仪记录底盘电机的间隔 ms
+#define CHASSIS_RECORD_TIME_MS 20
 //chassis control frequence, no use now.
 //底盘任务控制频率，尚未使用这个宏
 #define CHASSIS_CONTROL_FREQUENCE 1000.0f
@@ -159,6 +163,7 @@ typedef enum {
 
 typedef struct {
     const motor_measure_t *chassis_motor_measure;
+    motor_snapshot_t motor_snapshot;    //本周期反馈使用的电机数据快照
     float32_t accel;
     float32_t speed;
     float32_t speed_set;
@@ -178,6 +183,7 @@ typedef struct {
     chassis_mode_e last_chassis_mode;          //last state machine.底盘上次控制状态机
     chassis_motor_t motor_chassis[4];          //chassis motor data.底盘电机数据
     pid_type_def motor_speed_pid[4];             //motor speed PID.底盘电机速度pid
+    pid_batch_t motor_speed_batch;               //四个电机速度环合并计算, 增益取自motor_speed_pid
     pid_type_def chassis_angle_pid;              //follow angle PID.底盘跟随角度pid
     pid_type_def chassis_vx_speed_pid;              //底盘速度闭环pid
     pid_type_def chassis_vy_speed_pid;              //底盘速度闭环pid
@@ -209,7 +215,7 @@ typedef struct {
 
     uint16_t soft_power_limit;
     uint16_t power_limit;
-
+    power_limiter_t power_limiter;              //功率预测和限制
 
 
 } chassis_move_t;
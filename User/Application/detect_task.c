@@ -55,6 +55,8 @@
 #include "global_control_define.h"
 #include "remote_control.h"
 #include "DWT.h"
+#include "profile.h"
+#include "flight_recorder.h"
 
 /**
   * @brief          init error_list, assign  offline_time, online_time, priority.
@@ -68,6 +70,12 @@
   */
 static void detect_init(uint32_t time);
 
+/**
+  * @brief          把各统计点上一段时间的平均执行时间和最大执行时间写入飞行记录仪
+  * @param[in]      none
+  * @retval         none
+  */
+static void detect_record_task_time(void);
 
 error_t error_list[ERROR_LIST_LENGHT + 1];
 
@@ -95,6 +103,7 @@ void detect_task(void const *pvParameters) {
     //wait a time.空闲一段时间
     vTaskDelay(pdMS_TO_TICKS(DETECT_TASK_INIT_TIME));
     TickType_t LoopStartTime;
+    uint8_t record_cnt = 0;
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_detect_task);
         LoopStartTime = xTaskGetTickCount();
@@ -120,6 +129,7 @@ void detect_task(void const *pvParameters) {
                     error_list[i].is_lost = 1;
                     error_list[i].error_exist = 1;
                     error_list[i].lost_time = system_time;
+                    flight_recorder_log(FLIGHT_RECORD_DETECT, i, FLIGHT_DETECT_LOST, system_time, 0);
                 }
                 //judge the priority,save the highest priority ,
                 //判断错误优先级， 保存优先级最高的错误码
@@ -157,6 +167,10 @@ void detect_task(void const *pvParameters) {
                 }
             }
         }
+        if (++record_cnt >= DETECT_RECORD_TIME / DETECT_CONTROL_TIME) {
+            record_cnt = 0;
+            detect_record_task_time();
+        }
 #if INCLUDE_uxTaskGetStackHighWaterMark
         detect_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
@@ -204,10 +218,14 @@ void detect_hook(uint8_t toe) {
     if (error_list[toe].is_lost) {
         error_list[toe].is_lost = 0;
         error_list[toe].work_time = error_list[toe].new_time;
+        flight_recorder_log(FLIGHT_RECORD_DETECT, toe, FLIGHT_DETECT_ONLINE, error_list[toe].new_time, 0);
     }
 
     if (error_list[toe].data_is_error_fun != NULL) {
         if (error_list[toe].data_is_error_fun()) {
+            if (error_list[toe].data_is_error == 0) {
+                flight_recorder_log(FLIGHT_RECORD_DETECT, toe, FLIGHT_DETECT_DATA_ERROR, error_list[toe].new_time, 0);
+            }
             error_list[toe].error_exist = 1;
             error_list[toe].data_is_error = 1;
 
@@ -236,6 +254,28 @@ const error_t *get_error_list_point(void) {
     return error_list;
 }
 
+static void detect_record_task_time(void) {
+    //快照较大,检测任务栈小,放在静态区
+    static profile_point_t point;
+    static uint32_t last_cnt[PROFILE_NUM];
+    static uint64_t last_sum[PROFILE_NUM];
+    uint32_t cnt, mean = 0;
+    uint8_t id;
+
+    for (id = 0; id < PROFILE_NUM; id++) {
+        profile_snapshot((profile_id_e) id, &point);
+        cnt = point.exec.cnt - last_cnt[id];
+        if (cnt > 0) {
+            mean = (uint32_t) ((point.exec.sum - last_sum[id]) / cnt);
+        }
+        flight_recorder_log(FLIGHT_RECORD_TASK_TIME, id, (int16_t) ((cnt > INT16_MAX) ? INT16_MAX : cnt), mean,
+                            point.exec.max);
+        last_cnt[id] = point.exec.cnt;
+        last_sum[id] = point.exec.sum;
+        mean = 0;
+    }
+}
+
 static void detect_init(uint32_t time) {
     //设置离线时间，上线稳定工作时间，优先级 offlineTime onlinetime priority
     uint16_t set_item[ERROR_LIST_LENGHT][3] =
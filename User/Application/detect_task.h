@@ -59,6 +59,8 @@
 
 #define DETECT_TASK_INIT_TIME 57
 #define DETECT_CONTROL_TIME 10
+//飞行记录仪记录任务执行时间的间隔 ms
+#define DETECT_RECORD_TIME 100
 
 //错误码以及对应设备顺序
 enum errorList
@@ -95,6 +95,8 @@
 #include "pid_auto_tune_task.h"
 #include "print_task.h"
 #include "SEGGER_RTT.h"
+#include "shoot.h"
+#include "DWT.h"
 
 //when gimbal is in calibrating, set buzzer frequency and strenght
 //当云台在校准, 设置蜂鸣器频率和强度
@@ -325,8 +327,7 @@ static void gimbal_motionless_control(float32_t *yaw, float32_t *pitch, gimbal_c
 gimbal_behaviour_e gimbal_behaviour = GIMBAL_ZERO_FORCE;
 float32_t yaw_rc_Interpolation[14] = {0};
 float32_t pitch_rc_Interpolation[14] = {0};
-float32_t yaw_vision_Interpolation[200] = {0};
-float32_t pitch_vision_Interpolation[200] = {0};
+target_tracker_t vision_tracker;
 
 /**
   * @brief          the function is called by gimbal_set_mode function in gimbal_task.c
@@ -959,6 +960,87 @@ static void gimbal_motionless_control(float32_t *yaw, float32_t *pitch, gimbal_c
 }
 
 
+void gimbal_vision_tracker_init(void) {
+    static const float32_t vision_tracker_q[TARGET_TRACKER_AXIS_NUM] = {VISION_TRACKER_YAW_Q, VISION_TRACKER_PITCH_Q};
+
+    target_tracker_init(&vision_tracker, VISION_TRACKER_MODEL, vision_tracker_q, VISION_TRACKER_R,
+                        VISION_TRACKER_SPEED_STD, VISION_TRACKER_ACCEL_STD, VISION_TRACKER_GATE,
+                        VISION_TRACKER_TIMEOUT, (float32_t) HAL_RCC_GetHCLKFreq());
+}
+
+/**
+  * @brief          把最新的视觉帧换算到世界坐标系,按拍摄时刻融合进跟踪器
+  */
+static void gimbal_vision_tracker_update(void) {
+    float32_t target[TARGET_TRACKER_AXIS_NUM];
+    uint32_t capture_tick;
+
+    if (get_vision_target_world(&capture_tick, target)) {
+        target_tracker_update(&vision_tracker, capture_tick, target);
+    }
+}
+
+/**
+  * @brief          弹丸飞行时间加固定的发射延迟,射速优先使用裁判系统实测值,其次为射速上限,
+  *                 都低于1m/s(未收到裁判系统数据)时用VISION_DEFAULT_BULLET_SPEED.
+  *                 距离为0或不是有限值时只有发射延迟,结果不超过VISION_AIM_MAX_LEAD
+  */
+static float32_t gimbal_vision_lead_time(void) {
+    float32_t bullet_speed = global_judge_info.ShootData.bullet_speed;
+    float32_t distance = global_vision_info.vision_control.distance;
+    float32_t lead = VISION_AIM_EXTRA_LEAD;
+
+    if (!(bullet_speed >= 1.0f)) {
+        bullet_speed = (float32_t) shoot_control.shoot_speed_referee_set;
+    }
+    if (!(bullet_speed >= 1.0f)) {
+        bullet_speed = VISION_DEFAULT_BULLET_SPEED;
+    }
+    if (isfinite(distance) && distance > 0.0f) {
+        lead += distance / bullet_speed;
+    }
+    if (lead > VISION_AIM_MAX_LEAD) {
+        lead = VISION_AIM_MAX_LEAD;
+    }
+    return lead;
+}
+
+/**
+  * @brief          predict the aim point for this control period and turn it into setpoint increments
+  * @param[in]      gimbal_vision: gimbal data
+  * @param[out]     yaw: yaw increment, rad, 0 without target
+  * @param[out]     pitch: pitch increment, rad, 0 without target
+  * @retval         none
+  */
+/**
+  * @brief          预测本控制周期的瞄准点并换算为设定值增量.新的设定值使控制误差等于瞄准点与当前
+  *                 姿态之差,绝对角度模式下即设定值等于瞄准点
+  * @param[in]      gimbal_vision: 云台数据
+  * @param[out]     yaw: yaw增量, rad, 无目标时为0
+  * @param[out]     pitch: pitch增量, rad, 无目标时为0
+  * @retval         none
+  */
+static void gimbal_vision_aim(gimbal_control_t *gimbal_vision, float32_t *yaw, float32_t *pitch) {
+    const gimbal_motor_t *yaw_motor = &gimbal_vision->gimbal_yaw_motor;
+    const gimbal_motor_t *pitch_motor = &gimbal_vision->gimbal_pitch_motor;
+    float32_t aim[TARGET_TRACKER_AXIS_NUM];
+
+    *yaw = 0.0f;
+    *pitch = 0.0f;
+    if (!target_tracker_predict(&vision_tracker, DWT_get_tick(), gimbal_vision_lead_time(), aim)) {
+        return;
+    }
+    if (gimbal_behaviour == GIMBAL_ABSOLUTE_ANGLE) {
+        *yaw = jump_error(aim[TARGET_TRACKER_YAW] - yaw_motor->absolute_angle_set, 2 * PI);
+        *pitch = aim[TARGET_TRACKER_PITCH] - pitch_motor->absolute_angle_set;
+    } else {
+        *yaw = jump_error(aim[TARGET_TRACKER_YAW] - yaw_motor->absolute_angle, 2 * PI) -
+               jump_error(yaw_motor->relative_angle_set - yaw_motor->relative_angle, 2 * PI);
+        *pitch = (aim[TARGET_TRACKER_PITCH] - pitch_motor->absolute_angle) -
+                 (pitch_motor->relative_angle_set - pitch_motor->relative_angle);
+    }
+}
+
 /**
   * @brief          根据遥控器通道值，计算yaw和pitch控制量
   *
@@ -973,11 +1055,8 @@ void gimbal_rc_to_control_vector(float32_t *yaw, float32_t *pitch, gimbal_contro
     }
     static bool_t micro_pitch_lock = 0;
     static uint8_t rc_interpolation_num = 10;
-    static uint8_t vision_yaw_interpolation_num = 1;
-    static uint8_t vision_pitch_interpolation_num = 1;
     static bool_t no_bias_flag = 0;
     static uint8_t rc_move_point = 0;
-    static uint8_t vision_move_point = 0;
     static int16_t yaw_rc_last;
     float32_t yaw_bias = 0;
     static float32_t last_yaw_bias = 0;
@@ -986,47 +1065,13 @@ void gimbal_rc_to_control_vector(float32_t *yaw, float32_t *pitch, gimbal_contro
     int16_t yaw_channel, pitch_channel;
     float32_t yaw_set_channel, pitch_set_channel, add_vision_yaw, add_vision_pitch, lim_vision_yaw, lim_vision_pitch, micro_pitch_add;
     yaw_set_channel = pitch_set_channel = add_vision_yaw = add_vision_pitch = yaw_channel = pitch_channel = micro_pitch_add = 0;
-    //视觉控制
+    //视觉控制:视觉帧按拍摄时刻融合进跟踪器,每个控制周期由跟踪器预测瞄准点
     if (gimbal_move_rc_to_vector->gimbal_vision_ctrl->update_flag) {
         clear_vision_update_flag();
-        memset(yaw_vision_Interpolation, 0, sizeof(yaw_vision_Interpolation));
-        memset(yaw_vision_Interpolation, 0, sizeof(yaw_vision_Interpolation));
         rc_move_point = 0;
-//        SEGGER_RTT_printf(0, "%d,%f,%f\r\n", gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps,
-//                          gimbal_move_rc_to_vector->gimbal_vision_ctrl->yaw_angle,
-//                          gimbal_move_rc_to_vector->gimbal_vision_ctrl->pitch_angle);
-        if (gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps <= 10) {
-            global_vision_info.vision_control.fps = 20;
-        } else if (gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps > 60) {
-            global_vision_info.vision_control.fps = 60;
-        }
-//        SEGGER_RTT_WriteString(0,"IN\r\n");
-        if (fabsf(add_vision_yaw) > 2.0f) {
-            vision_yaw_interpolation_num = 3;
-        } else {
-            vision_yaw_interpolation_num = 2;
-        }
-        if (fabsf(add_vision_pitch) > 2.0f) {
-            vision_pitch_interpolation_num = 3;
-        } else {
-            vision_pitch_interpolation_num = 2;
-        }
-        sigmoidInterpolation(0,
-                             (gimbal_move_rc_to_vector->gimbal_vision_ctrl->yaw_angle / vision_yaw_interpolation_num) *
-                             1000,
-                             (1000 / gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps) * 2,
-                             yaw_vision_Interpolation);
-        sigmoidInterpolation(0, (gimbal_move_rc_to_vector->gimbal_vision_ctrl->pitch_angle /
-                                 vision_pitch_interpolation_num) * 1000,
-                             (1000 / gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps) * 2,
-                             pitch_vision_Interpolation);
-    }
-    add_vision_yaw = yaw_vision_Interpolation[vision_move_point] / 1000;
-    add_vision_pitch = pitch_vision_Interpolation[vision_move_point] / 1000;
-    vision_move_point++;
-    if (vision_move_point > (1000 / gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps) - 1) {
-        vision_move_point = 0;
+        gimbal_vision_tracker_update();
     }
+    gimbal_vision_aim(gimbal_move_rc_to_vector, &add_vision_yaw, &add_vision_pitch);
 //    SEGGER_RTT_printf(0, "%d,%f,%f\r\n", gimbal_move_rc_to_vector->gimbal_vision_ctrl->fps,
 //                      add_vision_yaw,
 //                      add_vision_pitch);
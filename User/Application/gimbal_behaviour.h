@@ -84,6 +84,7 @@
 #include "struct_typedef.h"
 
 #include "gimbal_task.h"
+#include "target_tracker.h"
 
 #define RADIO_CONTROL_SWITCH_R       0
 #define RADIO_CONTROL_SWITCH_L       1
@@ -94,6 +95,23 @@
 //will_replace_to_accurate_value
 #define GIMBAL_TASK_CONTROL_DELAY_SEN       6.3f
 
+//视觉目标跟踪器:匀速模型,过程噪声为目标角加速度的谱密度 rad^2/s^3,测量标准差约0.2度
+//yaw随目标平移和小陀螺机动大,pitch主要是测量噪声,取较小的过程噪声
+#define VISION_TRACKER_MODEL        TARGET_TRACKER_CV
+#define VISION_TRACKER_YAW_Q        20.0f
+#define VISION_TRACKER_PITCH_Q      0.5f
+#define VISION_TRACKER_R            (0.0035f * 0.0035f)
+#define VISION_TRACKER_SPEED_STD    2.0f
+#define VISION_TRACKER_ACCEL_STD    10.0f
+#define VISION_TRACKER_GATE         5.0f
+#define VISION_TRACKER_TIMEOUT      0.2f
+//弹丸飞行时间之外的固定提前量(拨弹到出膛) s
+#define VISION_AIM_EXTRA_LEAD       0.0f
+//裁判系统实测射速和射速上限都不可用时的射速 m/s
+#define VISION_DEFAULT_BULLET_SPEED 15.0f
+//提前量上限 s,距离异常大时不会预测到很远
+#define VISION_AIM_MAX_LEAD         0.5f
+
 typedef enum {
     GIMBAL_ZERO_FORCE = 0,
     GIMBAL_PID_AUTO_TUNE,
@@ -112,6 +130,19 @@ extern float32_t vision_yaw_control_sen;
 extern float32_t vision_pitch_lpf_factor;
 extern float32_t vision_yaw_control_lpf_factor;
 extern gimbal_behaviour_e gimbal_behaviour;
+extern target_tracker_t vision_tracker;
+
+/**
+  * @brief          init the vision target tracker, called by gimbal_init
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化视觉目标跟踪器,由gimbal_init调用
+  * @param[in]      none
+  * @retval         none
+  */
+extern void gimbal_vision_tracker_init(void);
 /**
   * @brief          the function is called by gimbal_set_mode function in gimbal_task.c
   *                 the function set gimbal_behaviour variable, and set motor mode.
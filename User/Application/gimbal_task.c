@@ -40,6 +40,11 @@
 #include "user_lib.h"
 #include "pid_auto_tune_task.h"
 #include "chassis_behaviour.h"
+#include "profile.h"
+#include "flight_recorder.h"
+#include "PC_receive_task.h"
+#include "print_task.h"
+#include "DWT.h"
 
 //motor enconde value format, range[0-8191]
 //电机编码值规整 0—8191
@@ -102,6 +107,8 @@ static void gimbal_set_mode(gimbal_control_t *set_mode);
   */
 static void gimbal_feedback_update(gimbal_control_t *feedback_update);
 
+static void gimbal_feedback_predict(gimbal_motor_t *gimbal_motor, uint8_t turn);
+
 /**
   * @brief          when gimbal mode change, some param should be changed, suan as  yaw_set should be new yaw
   * @param[out]     mode_change: "gimbal_control" valiable point
@@ -227,6 +234,20 @@ calc_gimbal_cali(const gimbal_step_cali_t *gimbal_cali, int32_t *yaw_offset, int
                  float32_t *max_yaw,
                  float32_t *min_yaw, float32_t *max_pitch, float32_t *min_pitch);
 
+/**
+  * @brief          把云台角度设定,角度,电流和姿态角写入飞行记录仪
+  * @param[in]      record: 云台数据
+  * @retval         none
+  */
+static void gimbal_flight_record(const gimbal_control_t *record);
+
+/**
+  * @brief          参数表写入后重新选择云台pid的计算函数
+  * @param[out]     refresh: 云台数据
+  * @retval         none
+  */
+static void gimbal_pid_refresh(gimbal_control_t *refresh);
+
 
 //gimbal control data
 //云台控制所有相关数据
@@ -265,13 +286,19 @@ void gimbal_task(void const *pvParameters) {
     }
 
     TickType_t LoopStartTime;
+    uint8_t record_cnt = 0;
 //for_test
 //设置当前云台朝向为前
 //    gimbal_control.gimbal_yaw_motor.offset_ecd = gimbal_control.gimbal_yaw_motor.gimbal_motor_measure->total_ecd;
 
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_gimbal_task);
+        profile_begin(PROFILE_GIMBAL_TASK);
         LoopStartTime = xTaskGetTickCount();
+        //在线修改的参数整批生效, 功能开关可能改变, 重新选择pid计算函数
+        if (param_registry_apply(&param_registry, PARAM_OWNER_GIMBAL) > 0U) {
+            gimbal_pid_refresh(&gimbal_control);
+        }
         gimbal_set_mode(&gimbal_control);                    //设置云台控制模式
         gimbal_mode_change_control_transit(&gimbal_control); //控制模式切换 控制数据过渡
         gimbal_feedback_update(&gimbal_control);             //云台数据反馈
@@ -312,9 +339,17 @@ void gimbal_task(void const *pvParameters) {
             }
         }
 
+        if (++record_cnt >= GIMBAL_RECORD_TIME / GIMBAL_CONTROL_TIME) {
+            record_cnt = 0;
+            gimbal_flight_record(&gimbal_control);
+        }
+        //遥测在控制量发出后采样,每个控制周期一条记录
+        telemetry_sample(&telemetry, DWT_get_tick());
+
 #if INCLUDE_uxTaskGetStackHighWaterMark
         gimbal_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
+        profile_end(PROFILE_GIMBAL_TASK);
         vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(GIMBAL_CONTROL_TIME));
     }
 }
@@ -730,6 +765,31 @@ static void gimbal_init(gimbal_control_t *init) {
     static const float32_t Yaw_relative_angle_pid[3] = {15.61f, 3.1436f, 8.9522f};
     static const float32_t Pitch_absolute_angle_pid[3] = {15.89f, 0.0f, 200.0f};
     static const float32_t Pitch_relative_angle_pid[3] = {29.2f, 0.0f, 500.0f};
+    //角度环误差和微分按2pi回绕, 变积分
+    static const pid_config_t yaw_angle_config = {
+            .mode = PID_POSITION,
+            .max_out = YAW_ENCODE_RELATIVE_PID_MAX_OUT,
+            .max_iout = YAW_ENCODE_RELATIVE_PID_MAX_IOUT,
+            .integral_separation = 1000,
+            .wrap = PID_WRAP_ANGLE,
+            .integral = PID_INTEGRAL_VARIABLE,
+            .variable_i_down = 0.01f,
+            .variable_i_up = 2.0f,
+            .derivative = PID_D_NORMAL,
+            .reset_time = PID_RESET_TIME,
+    };
+    static const pid_config_t pitch_angle_config = {
+            .mode = PID_POSITION,
+            .max_out = PITCH_ENCODE_RELATIVE_PID_MAX_OUT,
+            .max_iout = PITCH_ENCODE_RELATIVE_PID_MAX_IOUT,
+            .integral_separation = 1000,
+            .wrap = PID_WRAP_ANGLE,
+            .integral = PID_INTEGRAL_VARIABLE,
+            .variable_i_down = 0.01f,
+            .variable_i_up = 2.0f,
+            .derivative = PID_D_NORMAL,
+            .reset_time = PID_RESET_TIME,
+    };
     //电机数据指针获取
     init->gimbal_yaw_motor.gimbal_motor_measure = get_yaw_gimbal_motor_measure_point();
     init->gimbal_pitch_motor.gimbal_motor_measure = get_pitch_gimbal_motor_measure_point();
@@ -746,23 +806,17 @@ static void gimbal_init(gimbal_control_t *init) {
     init->gimbal_yaw_motor.gimbal_motor_mode = init->gimbal_yaw_motor.last_gimbal_motor_mode = GIMBAL_MOTOR_RAW;
     init->gimbal_pitch_motor.gimbal_motor_mode = init->gimbal_pitch_motor.last_gimbal_motor_mode = GIMBAL_MOTOR_RAW;
     //初始化yaw电机pid
-    PID_init(&init->gimbal_yaw_motor.gimbal_motor_relative_angle_pid, PID_POSITION, Yaw_relative_angle_pid,
-             YAW_ENCODE_RELATIVE_PID_MAX_OUT,
-             YAW_ENCODE_RELATIVE_PID_MAX_IOUT, 1000, 1, 0.01f, 2.0f, 0, 0.0f, 0, 0.0f, 0, 0, 0, 1, 0.9f);
-    PID_init(&init->gimbal_yaw_motor.gimbal_motor_absolute_angle_pid, PID_POSITION, Yaw_absolute_angle_pid,
-             YAW_ENCODE_RELATIVE_PID_MAX_OUT,
-             YAW_ENCODE_RELATIVE_PID_MAX_IOUT, 1000, 1, 0.01f, 2.0f, 0, 0.0f, 0, 0.0f, 0, 0, 0, 0, 0);
+    PID_build(&init->gimbal_yaw_motor.gimbal_motor_relative_angle_pid, Yaw_relative_angle_pid, &yaw_angle_config);
+    PID_build(&init->gimbal_yaw_motor.gimbal_motor_absolute_angle_pid, Yaw_absolute_angle_pid, &yaw_angle_config);
     PID_init(&init->gimbal_yaw_motor.gimbal_motor_gyro_pid, PID_POSITION, Yaw_speed_pid, YAW_SPEED_PID_MAX_OUT,
              YAW_SPEED_PID_MAX_IOUT, 1000, 1, 0.15f, 3.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 
 
     //初始化pitch电机pid
-    PID_init(&init->gimbal_pitch_motor.gimbal_motor_relative_angle_pid, PID_POSITION, Pitch_relative_angle_pid,
-             PITCH_ENCODE_RELATIVE_PID_MAX_OUT,
-             PITCH_ENCODE_RELATIVE_PID_MAX_IOUT, 1000, 1, 0.01f, 2.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-    PID_init(&init->gimbal_pitch_motor.gimbal_motor_absolute_angle_pid, PID_POSITION, Pitch_absolute_angle_pid,
-             PITCH_ENCODE_RELATIVE_PID_MAX_OUT,
-             PITCH_ENCODE_RELATIVE_PID_MAX_IOUT, 1000, 1, 0.01f, 2.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    PID_build(&init->gimbal_pitch_motor.gimbal_motor_relative_angle_pid, Pitch_relative_angle_pid,
+              &pitch_angle_config);
+    PID_build(&init->gimbal_pitch_motor.gimbal_motor_absolute_angle_pid, Pitch_absolute_angle_pid,
+              &pitch_angle_config);
     PID_init(&init->gimbal_pitch_motor.gimbal_motor_gyro_pid, PID_POSITION, Pitch_speed_pid, PITCH_SPEED_PID_MAX_OUT,
              PITCH_SPEED_PID_MAX_IOUT, 0.8f, 1, 0.8f, 2.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     KalmanCreate(&init->gimbal_pitch_motor.Cloud_Motor_Current_Kalman_Filter, 0.001f, 0.05f);
@@ -775,8 +829,14 @@ static void gimbal_init(gimbal_control_t *init) {
     KalmanCreate(&init->gimbal_pitch_motor.gimbal_motor_gyro_pid.D_Kalman, 1.0f, 1.0f);
     KalmanCreate(&init->gimbal_yaw_motor.MotorSpeed_Kalman, 0.001f, 0.4f);
     KalmanCreate(&init->gimbal_pitch_motor.MotorSpeed_Kalman, 0.001f, 0.4f);
+    motor_predict_init(&init->gimbal_yaw_motor.feedback_predict, YAW_FEEDBACK_PREDICT_ENABLE,
+                       YAW_FEEDBACK_PREDICT_ACCEL, YAW_FEEDBACK_PREDICT_DAMPING, GIMBAL_FEEDBACK_PREDICT_MAX_DT);
+    motor_predict_init(&init->gimbal_pitch_motor.feedback_predict, PITCH_FEEDBACK_PREDICT_ENABLE,
+                       PITCH_FEEDBACK_PREDICT_ACCEL, PITCH_FEEDBACK_PREDICT_DAMPING, GIMBAL_FEEDBACK_PREDICT_MAX_DT);
 
 
+    gimbal_vision_tracker_init();
+
     init->gimbal_pitch_motor.LpfFactor = 0.9f;
     init->gimbal_yaw_motor.LpfFactor = 0.5f;
 
@@ -869,22 +929,32 @@ static void gimbal_feedback_update(gimbal_control_t *feedback_update) {
 //                 feedback_update->gimbal_yaw_motor.offset_ecd) * MOTOR_ECD_TO_RAD / YAW_MOTOR_REDUCTION);
 //#endif
 
+    //同一帧的编码值和转速一起取出,不会被CAN接收任务改写一半
+    can_motor_snapshot(CAN_MOTOR_PITCH, &feedback_update->gimbal_pitch_motor.motor_snapshot);
+    can_motor_snapshot(CAN_MOTOR_YAW, &feedback_update->gimbal_yaw_motor.motor_snapshot);
+
     feedback_update->gimbal_pitch_motor.relative_angle = motor_ecd_to_pitch_angle_change(
-            gimbal_control.gimbal_pitch_motor.gimbal_motor_measure->ecd,
-            gimbal_control.gimbal_pitch_motor.offset_ecd);
+            feedback_update->gimbal_pitch_motor.motor_snapshot.measure.ecd,
+            feedback_update->gimbal_pitch_motor.offset_ecd);
 
     feedback_update->gimbal_yaw_motor.relative_angle = motor_ecd_to_yaw_angle_change(
-            gimbal_control.gimbal_yaw_motor.gimbal_motor_measure->ecd,
-            gimbal_control.gimbal_yaw_motor.offset_ecd);
+            feedback_update->gimbal_yaw_motor.motor_snapshot.measure.ecd,
+            feedback_update->gimbal_yaw_motor.offset_ecd);
 
     feedback_update->gimbal_pitch_motor.motor_gyro = *(feedback_update->gimbal_INT_gyro_point +
                                                        INS_GYRO_Y_ADDRESS_OFFSET);
     feedback_update->gimbal_pitch_motor.motor_speed = (
-            feedback_update->gimbal_pitch_motor.gimbal_motor_measure->speed_rpm * PI / 30.0f / PITCH_MOTOR_REDUCTION);
+            feedback_update->gimbal_pitch_motor.motor_snapshot.measure.speed_rpm * PI / 30.0f / PITCH_MOTOR_REDUCTION);
 
-    feedback_update->gimbal_yaw_motor.motor_speed = (feedback_update->gimbal_yaw_motor.gimbal_motor_measure->speed_rpm *
+    feedback_update->gimbal_yaw_motor.motor_speed = (feedback_update->gimbal_yaw_motor.motor_snapshot.measure.speed_rpm *
                                                      PI / 30.0f / YAW_MOTOR_REDUCTION);
 
+    //反馈帧到达后已过去的时间内,用上一次输出的电流把角度和速度外推到当前时刻
+    gimbal_feedback_predict(&feedback_update->gimbal_pitch_motor, PITCH_TURN);
+    gimbal_feedback_predict(&feedback_update->gimbal_yaw_motor, YAW_TURN);
+    feedback_update->gimbal_yaw_motor.relative_angle = loop_fp32_constrain(
+            feedback_update->gimbal_yaw_motor.relative_angle, 0.0f, 2.0f * PI / YAW_MOTOR_REDUCTION);
+
     feedback_update->gimbal_yaw_motor.absolute_angle = *(feedback_update->gimbal_INT_angle_point +
                                                          INS_YAW_ADDRESS_OFFSET);
     feedback_update->gimbal_pitch_motor.absolute_angle = *(feedback_update->gimbal_INT_angle_point +
@@ -908,6 +978,29 @@ static void gimbal_feedback_update(gimbal_control_t *feedback_update) {
                                                         INS_GYRO_X_ADDRESS_OFFSET));
 }
 
+/**
+  * @brief          move the feedback of one motor forward by the age of its CAN frame
+  * @param[out]     gimbal_motor: gimbal motor
+  * @param[in]      turn: motor mounted reversed, relative_angle and given_current are reversed
+  *                 against the motor while motor_speed is not
+  * @retval         none
+  */
+/**
+  * @brief          按CAN帧的年龄把电机反馈向前预测
+  * @param[out]     gimbal_motor: 云台电机
+  * @param[in]      turn: 电机反装,relative_angle和given_current与电机反向,motor_speed与电机同向
+  * @retval         none
+  */
+static void gimbal_feedback_predict(gimbal_motor_t *gimbal_motor, uint8_t turn) {
+    float32_t dt = can_motor_snapshot_age_us(&gimbal_motor->motor_snapshot) * 1e-6f;
+    float32_t current = turn ? -(float32_t) gimbal_motor->given_current : (float32_t) gimbal_motor->given_current;
+
+    //在电机方向上预测,角度增量再换回云台方向
+    motor_predict(&gimbal_motor->feedback_predict, current, dt, NULL, &gimbal_motor->motor_speed);
+    gimbal_motor->relative_angle += turn ? -gimbal_motor->feedback_predict.angle_delta
+                                         : gimbal_motor->feedback_predict.angle_delta;
+}
+
 /**
   * @brief          calculate the relative angle between ecd and offset_ecd
   * @param[in]      ecd: motor now encode
@@ -1442,4 +1535,24 @@ void gimbal_offset_ecd_cali(gimbal_control_t *init) {
                                                           init->gimbal_pitch_motor.offset_ecd) / 8192) + 1) * 8192;
         }
     }
-}
\ No newline at end of file
+}
+
+static void gimbal_flight_record(const gimbal_control_t *record) {
+    const float32_t *angle = record->gimbal_INT_angle_point;
+
+    flight_recorder_log_f(FLIGHT_RECORD_GIMBAL, 0, record->gimbal_yaw_motor.given_current,
+                          record->gimbal_yaw_motor.relative_angle_set, record->gimbal_yaw_motor.relative_angle);
+    flight_recorder_log_f(FLIGHT_RECORD_GIMBAL, 1, record->gimbal_pitch_motor.given_current,
+                          record->gimbal_pitch_motor.relative_angle_set, record->gimbal_pitch_motor.relative_angle);
+    flight_recorder_log_f(FLIGHT_RECORD_INS, 0, (int16_t) (angle[INS_ROLL_ADDRESS_OFFSET] * 1000.0f),
+                          angle[INS_YAW_ADDRESS_OFFSET], angle[INS_PITCH_ADDRESS_OFFSET]);
+}
+
+static void gimbal_pid_refresh(gimbal_control_t *refresh) {
+    PID_refresh(&refresh->gimbal_yaw_motor.gimbal_motor_relative_angle_pid);
+    PID_refresh(&refresh->gimbal_yaw_motor.gimbal_motor_absolute_angle_pid);
+    PID_refresh(&refresh->gimbal_yaw_motor.gimbal_motor_gyro_pid);
+    PID_refresh(&refresh->gimbal_pitch_motor.gimbal_motor_relative_angle_pid);
+    PID_refresh(&refresh->gimbal_pitch_motor.gimbal_motor_absolute_angle_pid);
+    PID_refresh(&refresh->gimbal_pitch_motor.gimbal_motor_gyro_pid);
+}
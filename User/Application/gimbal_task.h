@@ -35,6 +35,7 @@
 #include "pid.h"
 #include "vision_task.h"
 #include "PID_AutoTune.h"
+#include "motor_predict.h"
 
 #define MAX_6020_MOTOR_CAN_CURRENT 30000.0f
 
@@ -77,6 +78,17 @@
 #define YAW_ENCODE_RELATIVE_PID_MAX_OUT   30.0f
 #define YAW_ENCODE_RELATIVE_PID_MAX_IOUT  15.0f
 
+//motor feedback prediction: acceleration per current command unit (rad/s^2), damping (1/s), max sample age (s)
+//电机反馈延迟补偿:每单位电流命令的角加速度(rad/s^2),阻尼(1/s),最大预测时间(s)
+//GM6020空载约33.5rad/s@30000,机械时间常数按50ms估计
+#define YAW_FEEDBACK_PREDICT_ENABLE     1
+#define YAW_FEEDBACK_PREDICT_ACCEL      (0.0223f / YAW_MOTOR_REDUCTION)
+#define YAW_FEEDBACK_PREDICT_DAMPING    20.0f
+#define PITCH_FEEDBACK_PREDICT_ENABLE   1
+#define PITCH_FEEDBACK_PREDICT_ACCEL    (0.0223f / PITCH_MOTOR_REDUCTION)
+#define PITCH_FEEDBACK_PREDICT_DAMPING  20.0f
+#define GIMBAL_FEEDBACK_PREDICT_MAX_DT  0.005f
+
 
 //任务初始化 空闲一段时间
 #define GIMBAL_TASK_INIT_TIME 201
@@ -114,6 +126,8 @@
 #define PITCH_ENCODE_SEN  0.01f
 
 #define GIMBAL_CONTROL_TIME 1
+//飞行记录仪记录云台数据的间隔 ms
+#define GIMBAL_RECORD_TIME  10
 
 //电机码盘值最大以及中值
 #define HALF_ECD_RANGE  4096
@@ -201,6 +215,8 @@ typedef struct {
 
 typedef struct {
     const motor_measure_t *gimbal_motor_measure;
+    motor_snapshot_t motor_snapshot;    //本周期反馈使用的电机数据快照
+    motor_predict_t feedback_predict;   //反馈延迟补偿
 
     pid_type_def gimbal_motor_absolute_angle_pid;
     pid_type_def gimbal_motor_relative_angle_pid;
@@ -35,6 +35,10 @@
 #define ON     1
 #define PID_AUTO_TUNE OFF
 #define PID_AUTO_TUNE_CHASSIS_FOLLOW 0
+#define PID_AUTO_TUNE_SYS_ID 0  //1:扫频辨识频率响应,代替继电振荡调参
+//串级自动整定,由内环到外环整定并保存到启动参数组,优先于PID_AUTO_TUNE_SYS_ID
+//0:关闭 1:yaw 2:pitch 3:拨盘 4:底盘电机
+#define PID_AUTO_TUNE_CASCADE 0
 /************ PID Auto Tune End *******************/
 
 /************ Init To Offset Start*******************/
@@ -60,6 +64,8 @@
 #define RTT_MODE 1
 //#define PRINTF_MODE USB_MODE //print from usb
 #define PRINTF_MODE RTT_MODE //print from RTT terminal
+//二进制遥测数据流输出方式,USB_MODE时不要同时使用USB打印
+#define TELEMETRY_MODE RTT_MODE
 /************ Choose Print Mode End*******************/
 
 ///************ Choose UART Send Mode Start*******************/
@@ -78,6 +84,18 @@
 //#define UART1_TARGET_MODE Vision_rx_Matlab_tx_MODE //UART1 rx to vision tx to matlab //not_use
 /************ Choose UART1 TX Target End*******************/
 
+/************ INS Capture Start*******************/
+//ON时INS_task把每次融合的原始传感器样本写入mag_data_tx_fifo,由matlab_sync_task经串口1发出,
+//Matlab/ins_replay.py录制并回放,需要UART1_TARGET_MODE为Matlab_MODE
+#define INS_CAPTURE OFF
+//串口1波特率,INS录制的样本帧69字节,115200最多每秒约167帧,跟不上INS融合频率
+#if INS_CAPTURE == ON
+#define UART1_BAUD_RATE 921600U
+#else
+#define UART1_BAUD_RATE 115200U
+#endif
+/************ INS Capture End*******************/
+
 /************ Choose Detect Block Device Start*******************/
 #define Block_Buzzer 1
 #define Block_None_Device 0
@@ -120,6 +138,10 @@
 #error "You mast define PRINTF_MODE to chose a printf option"
 #endif
 
+#if !defined(TELEMETRY_MODE)
+#error "You mast define TELEMETRY_MODE to chose a telemetry option"
+#endif
+
 //#if !defined(UART_SEND_MODE)
 //#error "You mast define UART_SEND_MODE to choose a UART send option"
 //#endif
@@ -128,6 +150,10 @@
 #error "You mast define UART1_TARGET_MODE to chose a UART1 target"
 #endif
 
+#if INS_CAPTURE == ON && UART1_TARGET_MODE != Matlab_MODE
+#error "INS_CAPTURE needs UART1_TARGET_MODE to be Matlab_MODE"
+#endif
+
 #if !defined(DETECT_BLOCK)
 #error "You mast define DETECT_BLOCK to chose a block mode"
 #endif
@@ -21,14 +21,11 @@
 uint32_t matlab_sync_task_stack;
 #endif
 
-uint8_t matlab_fifo_tx_len_buf[MATLAB_FIFO_BUF_LENGTH];
-uint8_t matlab_fifo_tx_buf[MATLAB_FIFO_BUF_LENGTH];
-fifo_s_t matlab_tx_len_fifo;
-fifo_s_t matlab_tx_fifo;
-uint8_t usart1_matlab_tx_buf[2][USART1_MATLAB_TX_BUF_LENGHT];
-volatile uint8_t Matlab_No_DMA_IRQHandler = 1;
-volatile uint8_t matlab_dma_send_data_len = 0;
-volatile uint8_t Matlab_IRQ_Return_Before = 0;
+//每字节10位,串口1的带宽不够时mag_data_tx_fifo很快溢出,样本被丢弃
+#if INS_CAPTURE == ON && UART1_BAUD_RATE < INS_CAPTURE_SAMPLE_FRAME_LEN * 10U * INS_CAPTURE_MAX_RATE_HZ
+#error "UART1_BAUD_RATE is too low for INS_CAPTURE_MAX_RATE_HZ sample frames"
+#endif
+
 TaskHandle_t matlab_tx_task_local_handler;
 /* 发送数据包缓存区 */
 uint8_t matlab_transmit_pack[256];
@@ -42,9 +39,7 @@ Matlab_SyncStruct test1;
   */
 void matlab_sync_task(void const *argument) {
     init_matlab_struct_data();
-    fifo_s_init(&matlab_tx_len_fifo, matlab_fifo_tx_len_buf, MATLAB_FIFO_BUF_LENGTH);
-    fifo_s_init(&matlab_tx_fifo, matlab_fifo_tx_buf, MATLAB_FIFO_BUF_LENGTH);
-    usart1_tx_init(usart1_matlab_tx_buf[0], usart1_matlab_tx_buf[1], USART1_MATLAB_TX_BUF_LENGHT);
+    usart1_tx_init();
     matlab_tx_task_local_handler = xTaskGetCurrentTaskHandle();
 //    TickType_t LoopStartTime;
     while (1) {
@@ -55,6 +50,9 @@ void matlab_sync_task(void const *argument) {
 //        matlab_sync_task_stack = uxTaskGetStackHighWaterMark(NULL);
 //#endif
 //        LoopStartTime = xTaskGetTickCount();
+#if INS_CAPTURE == ON
+        INS_capture_sync();
+#else
         if (global_task_time.tim_matlab_sync_task.time < 15000) {
             data_sync(sizeof(test1));
         } else if (fifo_s_used(&mag_data_tx_fifo) > 120) {
@@ -66,6 +64,7 @@ void matlab_sync_task(void const *argument) {
             memcpy((void *) matlab_transmit_pack, &test1, sizeof(test1));
             data_sync(sizeof(test1));
         }
+#endif
 //        data_sync(sizeof(test1));
 //        data_sync(sizeof(test1));
 //        data_sync(sizeof(test1));
@@ -84,116 +83,62 @@ uint32_t get_stack_of_matlab_sync_task(void) {
 }
 
 void init_matlab_struct_data(void) {
-    memset(&matlab_fifo_tx_len_buf, 0, MATLAB_FIFO_BUF_LENGTH);
-    memset(&matlab_fifo_tx_buf, 0, MATLAB_FIFO_BUF_LENGTH);
     memset(&matlab_transmit_pack, 0, 256);
     memset(&test1.data.mag_xyz_5data, 0, 120);
-    memset(&usart1_matlab_tx_buf, 0, 2 * USART1_MATLAB_TX_BUF_LENGHT);
     test1.header.sync_char = '$';
 }
 
 //not_use
 void send_sync_char(void) {
-    fifo_s_put(&matlab_tx_len_fifo, sizeof(sync_char));
-    fifo_s_puts(&matlab_tx_fifo, (char *) &sync_char, sizeof(sync_char));
+    uart_tx_send(&usart1_tx_port, (uint8_t *) &sync_char, sizeof(sync_char), UART_TX_PRIORITY_LOW,
+                 MATLAB_TX_TIMEOUT_MS);
 }
 
 void data_sync(int data_len) {
 //    send_sync_char();
-    fifo_s_put(&matlab_tx_len_fifo, data_len);
-    fifo_s_puts(&matlab_tx_fifo, (char *) &matlab_transmit_pack, data_len);
-//    SEGGER_RTT_printf(0, "0len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//    SEGGER_RTT_printf(0, "0fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-    if (Matlab_No_DMA_IRQHandler || Matlab_IRQ_Return_Before) {
-        if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
-            xTaskNotifyGive(USART1TX_active_task_local_handler);
-            portYIELD(); //如此函数不是循环中最后一个执行的函数请注释掉（实时性可能有问题）
-        }
-    }
+    //帧缓存耗尽时丢弃该帧,发送由串口1发送调度器在DMA完成中断中接续
+    uart_tx_send(&usart1_tx_port, matlab_transmit_pack, data_len, UART_TX_PRIORITY_HIGH, MATLAB_TX_TIMEOUT_MS);
 }
 
-void MY_USART_DMA_Stream7_Matlab_TX_IRQHandler(void) {
-    __HAL_DMA_DISABLE(huart1.hdmatx);
-    while (huart1.hdmatx->Instance->CR & DMA_SxCR_EN) {
-        __HAL_DMA_DISABLE(huart1.hdmatx);
-    }
-    __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_HT_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_TE_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_DME_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_FE_FLAG_INDEX(huart1.hdmatx));;
-//    SEGGER_RTT_printf(0, "5len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//    SEGGER_RTT_printf(0, "5fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-//    SEGGER_RTT_printf(0, "return1=%d\r\n", Matlab_IRQ_Return_Before);
-    if ((!fifo_s_used(&matlab_tx_fifo)) || (!fifo_s_used(&matlab_tx_len_fifo))) {
-        if ((fifo_s_used(&matlab_tx_fifo)) || (fifo_s_used(&matlab_tx_len_fifo))) {
-            //should not come in here
-            fifo_s_flush(&matlab_tx_fifo);
-            fifo_s_flush(&matlab_tx_len_fifo);
+//帧头2字节,类型1字节,CRC16 2字节
+static uint16_t INS_capture_frame_fill(uint8_t *p_frame, uint8_t type, const void *p_payload, uint8_t len) {
+    p_frame[0] = (uint8_t) sync_char;
+    p_frame[1] = (uint8_t) (len + 1U);
+    p_frame[2] = type;
+    memcpy(&p_frame[3], p_payload, len);
+    append_CRC16_check_sum(&p_frame[2], len + 3U);
+    return len + 5U;
+}
+
+void INS_capture_sync(void) {
+    static uint32_t cali_ms = 0U;
+    static uint8_t cali_sent = 0U;
+    INS_capture_cali_t cali;
+    INS_capture_sample_t sample;
+    uart_tx_frame_t *p_frame;
+    uint16_t len;
+    uint8_t i;
+    const IMU_MAG_Cali_t *cali_data[3] = {&gyro_cali_data, &accel_cali_data, &mag_cali_data};
+
+    if (!cali_sent || HAL_GetTick() - cali_ms >= INS_CAPTURE_CALI_PERIOD_MS) {
+        cali_ms = HAL_GetTick();
+        cali_sent = 1U;
+        cali.tick_hz = HAL_RCC_GetHCLKFreq();
+        for (i = 0; i < 3; i++) {
+            cali.id = i;
+            memcpy(&cali.cali, cali_data[i], sizeof(IMU_MAG_Cali_t));
+            len = INS_capture_frame_fill(matlab_transmit_pack, INS_CAPTURE_FRAME_CALI, &cali, sizeof(cali));
+            uart_tx_send(&usart1_tx_port, matlab_transmit_pack, len, UART_TX_PRIORITY_NORMAL, 0U);
         }
     }
-//    SEGGER_RTT_printf(0, "len=%d\r\n", matlab_dma_send_data_len);
-    if (matlab_dma_send_data_len == 1) {
-        Matlab_IRQ_Return_Before = 1;
-    }
-    if (matlab_dma_send_data_len) {
-        if ((huart1.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-            __HAL_DMA_DISABLE(huart1.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-            __HAL_DMA_SET_COUNTER(huart1.hdmatx, matlab_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_0\r\n");
-            __HAL_DMA_ENABLE(huart1.hdmatx);
-            matlab_dma_send_data_len = 0;
-            detect_hook(USART1_TX_TOE);
-            if (!Matlab_IRQ_Return_Before) {
-                if (fifo_s_used(&matlab_tx_fifo)) {
-                    if (fifo_s_used(&matlab_tx_len_fifo)) {
-//                        SEGGER_RTT_printf(0, "7len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                        SEGGER_RTT_printf(0, "7fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                        matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                        memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                        fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[1], matlab_dma_send_data_len);
-                    }
-                } else {
-                    matlab_dma_send_data_len = 0;
-                    Matlab_No_DMA_IRQHandler = 1;
-                    memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                }
-            }
-        } else {
-            __HAL_DMA_DISABLE(huart1.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-            __HAL_DMA_SET_COUNTER(huart1.hdmatx, matlab_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_1\r\n");
-            __HAL_DMA_ENABLE(huart1.hdmatx);
-            matlab_dma_send_data_len = 0;
-            detect_hook(USART1_TX_TOE);
-            if (!Matlab_IRQ_Return_Before) {
-                if (fifo_s_used(&matlab_tx_fifo)) {
-                    if (fifo_s_used(&matlab_tx_len_fifo)) {
-//                        SEGGER_RTT_printf(0, "7len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                        SEGGER_RTT_printf(0, "7fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                        matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                        memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                        fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[0], matlab_dma_send_data_len);
-                    }
-                } else {
-                    matlab_dma_send_data_len = 0;
-                    Matlab_No_DMA_IRQHandler = 1;
-                    memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                }
-            }
-        }
-    } else {
-        memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-        memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-        if (!Matlab_No_DMA_IRQHandler) {
-            Matlab_IRQ_Return_Before = 1;
-            if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
-//                SEGGER_RTT_WriteString(0, "yield\r\n");
-                static BaseType_t xHigherPriorityTaskWoken;
-                vTaskNotifyGiveFromISR(USART1TX_active_task_local_handler, &xHigherPriorityTaskWoken);
-            }
+    //样本不设截止时间,帧缓存耗尽时留在fifo中等待下一次发送
+    while (fifo_s_used(&mag_data_tx_fifo) >= (int) sizeof(sample)) {
+        p_frame = uart_tx_alloc(&usart1_tx_port);
+        if (p_frame == NULL) {
+            break;
         }
+        fifo_s_gets(&mag_data_tx_fifo, (char *) &sample, sizeof(sample));
+        len = INS_capture_frame_fill(p_frame->data, INS_CAPTURE_FRAME_SAMPLE, &sample, sizeof(sample));
+        uart_tx_commit(&usart1_tx_port, p_frame, len, UART_TX_PRIORITY_NORMAL, 0U);
     }
 }
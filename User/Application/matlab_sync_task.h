@@ -8,20 +8,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "struct_typedef.h"
-#include "fifo.h"
+#include "spsc_fifo.h"
 #include "cmsis_os.h"
 
-#define USART1_MATLAB_TX_BUF_LENGHT     128
-#define MATLAB_FIFO_BUF_LENGTH 1024
+//发送帧排队超过该时间仍未发出则丢弃,保证上位机拿到的是最新数据
+#define MATLAB_TX_TIMEOUT_MS 20U
 
+//INS录制帧: '$' data_len type payload CRC16, CRC16覆盖type和payload
+#define INS_CAPTURE_FRAME_SAMPLE        'S'     //payload为INS_capture_sample_t
+#define INS_CAPTURE_FRAME_CALI          'C'     //payload为INS_capture_cali_t
+#define INS_CAPTURE_CALI_PERIOD_MS      1000U   //校准参数的发送周期
+#define INS_CAPTURE_SAMPLE_FRAME_LEN    69U     //样本帧长度, 帧头3字节+INS_capture_sample_t+CRC16
+#define INS_CAPTURE_MAX_RATE_HZ         200U    //INS融合的最高频率, 串口1需要按该频率发出样本帧
 
-extern volatile uint8_t Matlab_No_DMA_IRQHandler;
-extern volatile uint8_t matlab_dma_send_data_len;
-extern volatile uint8_t Matlab_IRQ_Return_Before;
-
-extern fifo_s_t matlab_tx_len_fifo;
-extern fifo_s_t matlab_tx_fifo;
-extern uint8_t usart1_matlab_tx_buf[2][USART1_MATLAB_TX_BUF_LENGHT];
 extern TaskHandle_t matlab_tx_task_local_handler;
 
 #pragma pack(push, 1)
@@ -64,12 +63,23 @@ void matlab_sync_task(void const *argument);
 
 void init_matlab_struct_data(void);
 
-void MY_USART_DMA_Stream7_Matlab_TX_IRQHandler(void);
-
 void send_sync_char(void);
 
 void data_sync(int data_len);
 
+/**
+  * @brief          send the buffered INS capture samples, and the calibration every
+  *                 INS_CAPTURE_CALI_PERIOD_MS, one frame per sample
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          发送缓存的INS录制样本,每个样本一帧,每INS_CAPTURE_CALI_PERIOD_MS发送一次校准参数
+  * @param[in]      none
+  * @retval         none
+  */
+void INS_capture_sync(void);
+
 /**
   * @brief          获取matlab_sync_task栈大小
   * @param[in]      none
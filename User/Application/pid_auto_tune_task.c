@@ -16,14 +16,92 @@
 #include "print_task.h"
 #include "chassis_task.h"
 #include "shoot.h"
+#include "sys_id.h"
+#include "cascade_tune.h"
+#include "PC_receive_task.h"
+#include <stdio.h>
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t pid_auto_tune_stack;
 #endif
 
+#define PID_AUTO_TUNE_CASCADE_DT    0.001f  //与云台、底盘、拨盘控制周期相同
+#define CASCADE_STAGE_NUM(stage)    ((uint8_t) (sizeof(stage) / sizeof((stage)[0])))
+
 pid_auto_tune_t pid_auto_tune_data;
+sys_id_t sys_id_data;
+cascade_tune_t cascade_tune_data;
 const volatile RC_ctrl_t *pid_auto_tune_rc;
 
+//串级自动整定的各级,内环在前.外环辨识时内环已使用新增益,由tune_type选择注入电流还是速度给定
+//yaw: 电流-速度, 速度给定-相对角度
+static const cascade_stage_t yaw_cascade_stage[] = {
+        {.param = {"yaw_spd"}, .param_num = 1, .pid = &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid,
+                .feedback = &gimbal_control.gimbal_yaw_motor.motor_speed, .feedback_sign = -1.0f,
+                .command = &pid_auto_tune_data.control_list.yaw_control_value, .inject = SPEED_TO_CURRENT,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_FIRST_ORDER, .offset = 0.0f, .amplitude = 3000.0f,
+                .f_start = 0.5f, .f_end = 80.0f, .point_num = 20, .input_limit = 20.0f,
+                .pi_ratio = 4.0f, .phase_margin = 50.0f, .gain_margin = 8.0f, .kp_max = 0.0f,
+                .step = 3.0f, .verify_time = 0.2f},
+        {.param = {"yaw_rel"}, .param_num = 1,
+                .pid = &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid,
+                .feedback = &gimbal_control.gimbal_yaw_motor.relative_angle, .feedback_sign = 1.0f,
+                .command = &pid_auto_tune_data.control_list.yaw_control_value, .inject = ANGLE_TO_SPEED,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_INTEGRATOR_FIRST_ORDER, .offset = 0.0f,
+                .amplitude = 1.5f, .f_start = 1.0f, .f_end = 60.0f, .point_num = 16, .input_limit = 1.5f,
+                .pi_ratio = 0.0f, .phase_margin = 60.0f, .gain_margin = 10.0f, .kp_max = 0.0f,
+                .step = 0.3f, .verify_time = 0.8f},
+};
+//pitch: 以平衡重力的电流为中心,先用check_StartValue_mode测出
+static const cascade_stage_t pitch_cascade_stage[] = {
+        {.param = {"pitch_spd"}, .param_num = 1, .pid = &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid,
+                .feedback = &gimbal_control.gimbal_pitch_motor.motor_speed, .feedback_sign = -1.0f,
+                .command = &pid_auto_tune_data.control_list.pitch_control_value, .inject = SPEED_TO_CURRENT,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_FIRST_ORDER, .offset = 2000.0f, .amplitude = 2000.0f,
+                .f_start = 0.5f, .f_end = 80.0f, .point_num = 20, .input_limit = 20.0f,
+                .pi_ratio = 4.0f, .phase_margin = 50.0f, .gain_margin = 8.0f, .kp_max = 0.0f,
+                .step = 1.0f, .verify_time = 0.15f},
+        {.param = {"pitch_rel"}, .param_num = 1,
+                .pid = &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid,
+                .feedback = &gimbal_control.gimbal_pitch_motor.relative_angle, .feedback_sign = 1.0f,
+                .command = &pid_auto_tune_data.control_list.pitch_control_value, .inject = ANGLE_TO_SPEED,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_INTEGRATOR_FIRST_ORDER, .offset = 0.0f,
+                .amplitude = 0.8f, .f_start = 1.0f, .f_end = 60.0f, .point_num = 16, .input_limit = 0.6f,
+                .pi_ratio = 0.0f, .phase_margin = 60.0f, .gain_margin = 10.0f, .kp_max = 0.0f,
+                .step = 0.15f, .verify_time = 0.8f},
+};
+//拨盘: 电流-速度, 速度给定-角度
+static const cascade_stage_t trigger_cascade_stage[] = {
+        {.param = {"trig_spd"}, .param_num = 1, .pid = &shoot_control.trigger_motor_speed_pid,
+                .feedback = &shoot_control.speed, .feedback_sign = 1.0f,
+                .command = &pid_auto_tune_data.control_list.trigger_control_value, .inject = SPEED_TO_CURRENT,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_FIRST_ORDER, .offset = 0.0f, .amplitude = 3000.0f,
+                .f_start = 1.0f, .f_end = 100.0f, .point_num = 20, .input_limit = 30.0f,
+                .pi_ratio = 4.0f, .phase_margin = 50.0f, .gain_margin = 8.0f, .kp_max = 0.0f,
+                .step = 5.0f, .verify_time = 0.3f},
+        {.param = {"trig_ang"}, .param_num = 1, .pid = &shoot_control.trigger_motor_angle_pid,
+                .feedback = &shoot_control.angle, .feedback_sign = 1.0f,
+                .command = &pid_auto_tune_data.control_list.trigger_control_value, .inject = ANGLE_TO_SPEED,
+                .mode = SYS_ID_STEPPED_SINE, .model = SYS_ID_INTEGRATOR_FIRST_ORDER, .offset = 0.0f,
+                .amplitude = 5.0f, .f_start = 1.0f, .f_end = 60.0f, .point_num = 16, .input_limit = 0.0f,
+                .pi_ratio = 0.0f, .phase_margin = 60.0f, .gain_margin = 10.0f, .kp_max = 0.0f,
+                .step = 1.0f, .verify_time = 0.5f},
+};
+//底盘电机: 放地上四个电机给同一电流自转,按0号电机设计,增益写入四个电机
+static const cascade_stage_t wheel_cascade_stage[] = {
+        {.param = {"wheel0_spd", "wheel1_spd", "wheel2_spd", "wheel3_spd"}, .param_num = 4,
+                .pid = &chassis_move.motor_speed_pid[0], .feedback = &chassis_move.motor_chassis[0].speed,
+                .feedback_sign = 1.0f, .command = &pid_auto_tune_data.control_list.wheel_control_value,
+                .inject = SPEED_TO_CURRENT, .mode = SYS_ID_CHIRP, .model = SYS_ID_FIRST_ORDER, .offset = 0.0f,
+                .amplitude = 2000.0f, .f_start = 0.5f, .f_end = 40.0f, .point_num = 16, .input_limit = 3.0f,
+                .pi_ratio = 4.0f, .phase_margin = 50.0f, .gain_margin = 8.0f, .kp_max = 0.0f,
+                .step = 0.5f, .verify_time = 0.5f},
+};
+
+static void sys_id_print(const sys_id_t *id, uint8_t *p_point_printed, uint8_t *p_result_printed);
+static void sys_id_run(void);
+static void cascade_tune_poll(void);
+
 //调整顺序，1.底盘电流环,放地上，四个电机给同一电流，自转 2.底盘速度，放地上带摩擦力调（不跟随）3，云台速度，角度（不跟随，陀螺）4，底盘跟随角度，以云台绝对角度为准，设定到保持当前云台角度下动底盘(理论前面调好了P直接设为2)，5，小陀螺云台逆向旋转前馈，6，拨盘角度速度
 //克服重力调整务必找到平衡时电流并以此为起点上下震动，例如所有的pitch
 //电流起始2000
@@ -99,6 +177,48 @@ void pid_auto_tune_task(void const *pvParameters) {
     pid_auto_tune_init(&pid_auto_tune_data, &gimbal_control.gimbal_yaw_motor.relative_angle,
                        &pid_auto_tune_data.control_list.wz_control_value, USE_PID, 0.0f, 2.0f,
                        1, 3.0f, 0.0f, ANGLE_TO_SPEED, 0);
+    //串级自动整定
+    if (PID_AUTO_TUNE_CASCADE == 1) {
+        cascade_tune_init(&cascade_tune_data, yaw_cascade_stage, CASCADE_STAGE_NUM(yaw_cascade_stage),
+                          &param_registry, &pid_auto_tune_data.tune_type, PID_AUTO_TUNE_CASCADE_DT);
+    } else if (PID_AUTO_TUNE_CASCADE == 2) {
+        cascade_tune_init(&cascade_tune_data, pitch_cascade_stage, CASCADE_STAGE_NUM(pitch_cascade_stage),
+                          &param_registry, &pid_auto_tune_data.tune_type, PID_AUTO_TUNE_CASCADE_DT);
+    } else if (PID_AUTO_TUNE_CASCADE == 3) {
+        cascade_tune_init(&cascade_tune_data, trigger_cascade_stage, CASCADE_STAGE_NUM(trigger_cascade_stage),
+                          &param_registry, &pid_auto_tune_data.tune_type, PID_AUTO_TUNE_CASCADE_DT);
+    } else if (PID_AUTO_TUNE_CASCADE == 4) {
+        cascade_tune_init(&cascade_tune_data, wheel_cascade_stage, CASCADE_STAGE_NUM(wheel_cascade_stage),
+                          &param_registry, &pid_auto_tune_data.tune_type, PID_AUTO_TUNE_CASCADE_DT);
+    }
+    //扫频辨识,激励写入control_list,由tune_type选择注入电流还是速度给定
+    if (PID_AUTO_TUNE_SYS_ID) {
+        //yaw 电流-速度
+        sys_id_init(&sys_id_data, &gimbal_control.gimbal_yaw_motor.motor_gyro,
+                    &pid_auto_tune_data.control_list.yaw_control_value, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER,
+                    0.0f, 3000.0f, 0.5f, 80.0f, 20, 20.0f, 0.001f);
+        pid_auto_tune_data.tune_type = SPEED_TO_CURRENT;
+        //pitch 电流-速度,以平衡重力的电流为中心
+//        sys_id_init(&sys_id_data, &gimbal_control.gimbal_pitch_motor.motor_gyro,
+//                    &pid_auto_tune_data.control_list.pitch_control_value, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER,
+//                    2000.0f, 2000.0f, 0.5f, 80.0f, 20, 20.0f, 0.001f);
+//        pid_auto_tune_data.tune_type = SPEED_TO_CURRENT;
+        //yaw 速度环闭环,速度给定-相对角度
+//        sys_id_init(&sys_id_data, &gimbal_control.gimbal_yaw_motor.relative_angle,
+//                    &pid_auto_tune_data.control_list.yaw_control_value, SYS_ID_STEPPED_SINE,
+//                    SYS_ID_INTEGRATOR_FIRST_ORDER, 0.0f, 2.0f, 1.0f, 60.0f, 16, 1.5f, 0.001f);
+//        pid_auto_tune_data.tune_type = ANGLE_TO_SPEED;
+        //底盘电机 电流-速度,四个电机给同一电流,扫频较快
+//        sys_id_init(&sys_id_data, &chassis_move.motor_chassis[0].speed,
+//                    &pid_auto_tune_data.control_list.wheel_control_value, SYS_ID_CHIRP, SYS_ID_FIRST_ORDER,
+//                    0.0f, 2000.0f, 0.5f, 40.0f, 16, 3.0f, 0.001f);
+//        pid_auto_tune_data.tune_type = SPEED_TO_CURRENT;
+        //拨盘 电流-速度
+//        sys_id_init(&sys_id_data, &shoot_control.speed,
+//                    &pid_auto_tune_data.control_list.trigger_control_value, SYS_ID_STEPPED_SINE,
+//                    SYS_ID_FIRST_ORDER, 0.0f, 3000.0f, 1.0f, 100.0f, 20, 30.0f, 0.001f);
+//        pid_auto_tune_data.tune_type = SPEED_TO_CURRENT;
+    }
     TickType_t LoopStartTime;
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_pid_auto_tune_task);
@@ -110,8 +230,20 @@ void pid_auto_tune_task(void const *pvParameters) {
                 CAN2_cmd_0x200(0, 0, 0, 0);
                 CAN1_cmd_0x200(0, 0, 0, 0);
 //                pid_auto_tune_cancel(&pid_auto_tune_data);
+                //遥控器断开时停止已开始的辨识,不再继续
+                if (PID_AUTO_TUNE_CASCADE) {
+                    cascade_tune_stop(&cascade_tune_data);
+                    cascade_tune_poll();
+                } else if (PID_AUTO_TUNE_SYS_ID && sys_id_data.state != SYS_ID_IDLE) {
+                    sys_id_stop(&sys_id_data);
+                }
             } else {
-                if (pid_auto_tune_data.check_StartValue_mode) {
+                if (PID_AUTO_TUNE_CASCADE) {
+                    cascade_tune_update(&cascade_tune_data);
+                    cascade_tune_poll();
+                } else if (PID_AUTO_TUNE_SYS_ID) {
+                    sys_id_run();
+                } else if (pid_auto_tune_data.check_StartValue_mode) {
                     pid_auto_tune_set_check_StartValue_loop(&pid_auto_tune_data);
                 } else {
                     if (running_flag) {
@@ -191,6 +323,111 @@ void pid_auto_tune_task(void const *pvParameters) {
     }
 }
 
+/**
+  * @brief          输出完成的频率点和拟合结果,文本行由Matlab/sys_id_bode.py解析
+  * @param[in]      id: 辨识数据
+  * @param[in,out]  p_point_printed: 已输出的频率点数
+  * @param[in,out]  p_result_printed: 已输出拟合结果或中止
+  * @retval         none
+  */
+static void sys_id_print(const sys_id_t *id, uint8_t *p_point_printed, uint8_t *p_result_printed) {
+    char buf[160];
+
+    //每个点完成后立即输出,中途停止也保留已测的点
+    while (*p_point_printed < id->point_done) {
+        const sys_id_point_t *point = &id->point[*p_point_printed];
+        snprintf(buf, sizeof(buf), "SYSID,P,%d,%.5g,%.6g,%.2f,%.3f\r\n", *p_point_printed, point->freq, point->gain,
+                 point->phase * 57.2957795f, point->quality);
+        SEGGER_RTT_WriteString(0, buf);
+        (*p_point_printed)++;
+    }
+    if (*p_result_printed) {
+        return;
+    }
+    if (id->state == SYS_ID_DONE) {
+        const sys_id_fit_t *fit = &id->fit;
+        snprintf(buf, sizeof(buf), "SYSID,FIT,%d,%d,%.6g,%.5g,%.5g,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g,%d\r\n",
+                 fit->valid, fit->model, fit->gain, fit->time_const, fit->wn, fit->zeta, fit->delay, fit->bandwidth,
+                 fit->peak_freq, fit->peak_db, fit->fit_error, fit->point_used);
+        SEGGER_RTT_WriteString(0, buf);
+        *p_result_printed = 1;
+    } else if (id->state == SYS_ID_ABORT) {
+        snprintf(buf, sizeof(buf), "SYSID,ABORT,%d\r\n", id->point_done);
+        SEGGER_RTT_WriteString(0, buf);
+        *p_result_printed = 1;
+    }
+}
+
+/**
+  * @brief          运行一步扫频辨识,完成的频率点和拟合结果以文本输出到RTT通道0
+  * @param[in]      none
+  * @retval         none
+  */
+static void sys_id_run(void) {
+    static uint8_t point_printed = 0;
+    static uint8_t result_printed = 0;
+
+    sys_id_update(&sys_id_data);
+    sys_id_print(&sys_id_data, &point_printed, &result_printed);
+}
+
+/**
+  * @brief          输出串级整定的过程和结果,并执行保存.每一级的辨识结果同样以SYSID行输出,
+  *                 文本行由Matlab/sys_id_bode.py解析
+  *                 CASCADE,STAGE,级,参数名
+  *                 CASCADE,RESULT,级,错误,kp,ki,kd,穿越频率,相位裕度,增益裕度,测量相位裕度,测量增益裕度,超调,稳态误差
+  *                 CASCADE,SAVE,参数组,param_status_e
+  *                 CASCADE,END,通过级数,总级数,错误
+  * @param[in]      none
+  * @retval         none
+  */
+static void cascade_tune_poll(void) {
+    static uint8_t ident_stage = 0xFF;
+    static uint8_t point_printed = 0;
+    static uint8_t fit_printed = 0;
+    static uint8_t result_printed = 0;
+    static uint8_t save_requested = 0;
+    static uint8_t end_printed = 0;
+    const cascade_tune_t *tune = &cascade_tune_data;
+    char buf[200];
+    uint8_t status;
+
+    if (tune->state == CASCADE_TUNE_IDENTIFY && tune->stage_index != ident_stage) {
+        ident_stage = tune->stage_index;
+        point_printed = 0;
+        fit_printed = 0;
+        snprintf(buf, sizeof(buf), "CASCADE,STAGE,%d,%s\r\n", ident_stage, tune->stage[ident_stage].param[0]);
+        SEGGER_RTT_WriteString(0, buf);
+    }
+    if (ident_stage == tune->stage_index) {
+        sys_id_print(&tune->sys_id, &point_printed, &fit_printed);
+    }
+    while (result_printed < tune->stage_done) {
+        const cascade_stage_result_t *result = &tune->result[result_printed];
+        snprintf(buf, sizeof(buf), "CASCADE,RESULT,%d,%d,%.6g,%.6g,%.6g,%.4g,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f\r\n",
+                 result_printed, result->error, result->kp, result->ki, result->kd, result->crossover,
+                 result->phase_margin, result->gain_margin, result->meas_phase_margin, result->meas_gain_margin,
+                 result->overshoot, result->final_error);
+        SEGGER_RTT_WriteString(0, buf);
+        result_printed++;
+    }
+    //通过的增益保存到启动参数组,下次上电自动加载
+    if (tune->state == CASCADE_TUNE_SAVE) {
+        if (!save_requested) {
+            save_requested = (PC_receive_param_save(PARAM_SET_BOOT) == 0);
+        } else if ((status = PC_receive_param_save_status()) != PARAM_ERR_BUSY) {
+            snprintf(buf, sizeof(buf), "CASCADE,SAVE,%d,%d\r\n", PARAM_SET_BOOT, status);
+            SEGGER_RTT_WriteString(0, buf);
+            cascade_tune_save_done(&cascade_tune_data, status == PARAM_OK);
+        }
+    }
+    if (!end_printed && (tune->state == CASCADE_TUNE_DONE || tune->state == CASCADE_TUNE_FAILED)) {
+        snprintf(buf, sizeof(buf), "CASCADE,END,%d,%d,%d\r\n", tune->accepted, tune->stage_num, tune->error);
+        SEGGER_RTT_WriteString(0, buf);
+        end_printed = 1;
+    }
+}
+
 /**
   * @brief          获取pid自动调谐控制指针
   * @param[in]      none
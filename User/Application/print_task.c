@@ -43,6 +43,9 @@
 #include "bsp_buzzer.h"
 #include "bsp_adc.h"
 #include "super_capacitance_control_task.h"
+#include "telemetry.h"
+#include "profile.h"
+#include "flight_recorder.h"
 
 
 #if PRINTF_MODE == RTT_MODE
@@ -61,6 +64,24 @@
 uint32_t print_task_stack;
 #endif
 
+//遥测数据使用的RTT上行缓存,0号缓存留给文本打印
+#define TELEMETRY_RTT_BUFFER_INDEX      1
+#define TELEMETRY_RTT_BUFFER_SIZE       2048
+//USB CDC每批发送的字节数,RTT每帧直接写入
+#define TELEMETRY_USB_FLUSH_LEN         256
+//飞行记录输出使用的RTT上行缓存,单次写入的字节数和等待上位机读取的最长时间
+#define FLIGHT_RECORDER_RTT_BUFFER_INDEX    2
+#define FLIGHT_RECORDER_RTT_BUFFER_SIZE     1024
+#define FLIGHT_RECORDER_CHUNK_LEN           512
+#define FLIGHT_RECORDER_DUMP_TIMEOUT        5000
+
+telemetry_t telemetry;
+//PC_receive_task转交的终端命令,无命令时为负
+static volatile int print_command_key = -1;
+#if TELEMETRY_MODE == RTT_MODE
+static uint8_t telemetry_rtt_buf[TELEMETRY_RTT_BUFFER_SIZE];
+#endif
+
 static uint8_t print_buf[256];
 static uint8_t read_buf[256];
 static const char status[2][7] = {"OK", "ERROR!"};
@@ -92,7 +113,176 @@ float32_t pid_pout_probe = 0;
 float32_t pid_iout_probe = 0;
 float32_t pid_dout_probe = 0;
 
+/**
+  * @brief          遥测数据发送端,RTT缓存空间不足或USB正在发送时返回忙
+  */
+static int telemetry_write(const uint8_t *p_data, uint16_t len) {
+#if TELEMETRY_MODE == RTT_MODE
+    return (SEGGER_RTT_Write(TELEMETRY_RTT_BUFFER_INDEX, p_data, len) == len) ? 0 : -1;
+#else
+    return (CDC_Transmit_FS((uint8_t *) p_data, len) == USBD_OK) ? 0 : -1;
+#endif
+}
+
+/**
+  * @brief          飞行记录输出端,与遥测使用同一种方式,RTT使用单独的上行缓存
+  */
+static int flight_recorder_write(const uint8_t *p_data, uint16_t len) {
+#if TELEMETRY_MODE == RTT_MODE
+    return (SEGGER_RTT_Write(FLIGHT_RECORDER_RTT_BUFFER_INDEX, p_data, len) == len) ? 0 : -1;
+#else
+    return (CDC_Transmit_FS((uint8_t *) p_data, len) == USBD_OK) ? 0 : -1;
+#endif
+}
+
+/**
+  * @brief          输出上一次运行的飞行记录,最多等待FLIGHT_RECORDER_DUMP_TIMEOUT.在遥测初始化之前调用,
+  *                 USB CDC上不与遥测帧交错.超时后冻结的记录区保留,RTT方式下在打印循环中继续输出,
+  *                 USB方式下在下一次启动时输出,本次运行的记录不受影响
+  */
+static void flight_recorder_dump_boot(void) {
+#if TELEMETRY_MODE == RTT_MODE
+    static uint8_t flight_recorder_rtt_buf[FLIGHT_RECORDER_RTT_BUFFER_SIZE];
+#endif
+    TickType_t start_time;
+
+    if (flight_recorder_dump_pending()) {
+#if TELEMETRY_MODE == RTT_MODE
+        SEGGER_RTT_ConfigUpBuffer(FLIGHT_RECORDER_RTT_BUFFER_INDEX, "flight_recorder", flight_recorder_rtt_buf,
+                                  FLIGHT_RECORDER_RTT_BUFFER_SIZE, SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+#endif
+        start_time = xTaskGetTickCount();
+        while (flight_recorder_dump(flight_recorder_write, FLIGHT_RECORDER_CHUNK_LEN) == 0 &&
+               xTaskGetTickCount() - start_time < pdMS_TO_TICKS(FLIGHT_RECORDER_DUMP_TIMEOUT)) {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+    }
+}
+
+/**
+  * @brief          初始化遥测数据流并注册云台、底盘PID内部量,由TIM7中断按固定频率采样
+  */
+static void telemetry_setup(void) {
+#if TELEMETRY_MODE == RTT_MODE
+    SEGGER_RTT_ConfigUpBuffer(TELEMETRY_RTT_BUFFER_INDEX, "telemetry", telemetry_rtt_buf,
+                              TELEMETRY_RTT_BUFFER_SIZE, SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    telemetry_init(&telemetry, telemetry_write, HAL_RCC_GetHCLKFreq(), 1);
+#else
+    telemetry_init(&telemetry, telemetry_write, HAL_RCC_GetHCLKFreq(), TELEMETRY_USB_FLUSH_LEN);
+#endif
+    telemetry_add(&telemetry, "yaw_angle_set", &gimbal_control.gimbal_yaw_motor.relative_angle_set,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_angle", &gimbal_control.gimbal_yaw_motor.relative_angle, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_gyro_set", &gimbal_control.gimbal_yaw_motor.motor_gyro_set, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_gyro", &gimbal_control.gimbal_yaw_motor.motor_gyro, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_gyro_Pout", &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Pout,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_gyro_Iout", &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Iout,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_gyro_Dout", &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid.Dout,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "yaw_current", &gimbal_control.gimbal_yaw_motor.given_current, TELEMETRY_INT16);
+    telemetry_add(&telemetry, "pitch_angle_set", &gimbal_control.gimbal_pitch_motor.relative_angle_set,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "pitch_angle", &gimbal_control.gimbal_pitch_motor.relative_angle, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "pitch_gyro_out", &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid.out,
+                  TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "pitch_current", &gimbal_control.gimbal_pitch_motor.given_current, TELEMETRY_INT16);
+    telemetry_add(&telemetry, "m1_speed_set", &chassis_move.motor_chassis[0].speed_set, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "m1_speed", &chassis_move.motor_chassis[0].speed, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "m1_Pout", &chassis_move.motor_speed_batch.pout[0], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "m1_Iout", &chassis_move.motor_speed_batch.iout[0], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "m1_current", &chassis_move.motor_chassis[0].give_current, TELEMETRY_INT16);
+    telemetry_add(&telemetry, "wz_pid_out", &chassis_move.chassis_wz_speed_pid.out, TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "trk_yaw", &vision_tracker.axis[TARGET_TRACKER_YAW].x[0], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "trk_yaw_speed", &vision_tracker.axis[TARGET_TRACKER_YAW].x[1], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "trk_pitch", &vision_tracker.axis[TARGET_TRACKER_PITCH].x[0], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "trk_pitch_speed", &vision_tracker.axis[TARGET_TRACKER_PITCH].x[1], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "aim_yaw", &vision_tracker.aim[TARGET_TRACKER_YAW], TELEMETRY_FLOAT);
+    telemetry_add(&telemetry, "aim_pitch", &vision_tracker.aim[TARGET_TRACKER_PITCH], TELEMETRY_FLOAT);
+}
+
+/**
+  * @brief          打印一个直方图的统计值和非空格,格k统计[2^k, 2^(k+1))个DWT计数
+  */
+static void print_profile_hist(const char *label, const profile_hist_t *p_hist) {
+    uint8_t i;
+    printf("  %s n=%u min=%u mean=%u p99=%u max=%u\r\n  ", label, p_hist->cnt,
+           p_hist->cnt ? p_hist->min : 0U, profile_hist_mean(p_hist), profile_hist_percentile(p_hist, 990),
+           p_hist->max);
+    for (i = 0; i < PROFILE_BUCKET_NUM; i++) {
+        if (p_hist->bucket[i]) {
+            printf("2^%u:%u ", i, p_hist->bucket[i]);
+        }
+    }
+    printf("\r\n");
+}
+
+/**
+  * @brief          RTT终端命令:'p'打印所有统计点的快照,'r'清空所有统计点,单位为DWT计数
+  * @param[in]      key: print_terminal_command转交的命令,无输入时为负
+  */
+static void print_profile_command(int key) {
+    static profile_point_t snapshot;
+    uint8_t i;
+    if (key == 'r') {
+        profile_reset(PROFILE_NUM);
+        printf("profile reset\r\n");
+    } else if (key == 'p') {
+        printf("profile: %u cycles/us, begin+end overhead %u cycles\r\n", HAL_RCC_GetHCLKFreq() / 1000000U,
+               profile_overhead_cycles);
+        for (i = 0; i < PROFILE_NUM; i++) {
+            profile_snapshot((profile_id_e) i, &snapshot);
+            printf("%s period=%u\r\n", snapshot.name, snapshot.period);
+            print_profile_hist("exec", &snapshot.exec);
+            print_profile_hist(snapshot.period ? "jitter" : "interval", &snapshot.jitter);
+        }
+    }
+}
+
+/**
+  * @brief          打印一条CAN总线的发送统计,负载为距上次打印以来的平均值
+  */
+static void print_can_tx_port(const char *name, can_tx_port_t *p_port) {
+    printf("%s load=%u%% sent=%u overwrite=%u full=%u fail=%u abort=%u latency_us last=%u max=%u\r\n", name,
+           can_tx_load_permille(p_port) / 10U, p_port->sent_cnt, p_port->overwrite_cnt, p_port->mailbox_full_cnt,
+           p_port->fail_cnt, p_port->abort_cnt, p_port->latency_us_last, p_port->latency_us_max);
+}
+
+/**
+  * @brief          RTT终端命令:'f'丢弃未输出的上一次运行的飞行记录
+  * @param[in]      key: print_terminal_command转交的命令,无输入时为负
+  */
+static void print_flight_recorder_command(int key) {
+    if (key == 'f') {
+        printf("flight recorder %s\r\n", flight_recorder_dump_pending() ? "cleared" : "empty");
+        flight_recorder_clear();
+    }
+}
+
+/**
+  * @brief          RTT终端命令:'c'打印CAN发送统计和接收队列丢帧数
+  * @param[in]      key: print_terminal_command转交的命令,无输入时为负
+  */
+static void print_can_command(int key) {
+    if (key == 'c') {
+        print_can_tx_port("can1", &can1_tx_port);
+        print_can_tx_port("can2", &can2_tx_port);
+        printf("can rx drop=%u\r\n", can_rx_drop_cnt);
+    }
+}
+
+int print_terminal_command(char key) {
+    if (key != 'p' && key != 'r' && key != 'c' && key != 'f') {
+        return -1;
+    }
+    print_command_key = key;
+    return 0;
+}
+
 void print_task(void const *argument) {
+    flight_recorder_dump_boot();
+    telemetry_setup();
     if (PRINTF_MODE == USB_MODE) {
         error_list_print_local = get_error_list_point();
         vTaskDelay(pdMS_TO_TICKS(500));
@@ -136,6 +326,7 @@ referee usart:%s\r\n\
         error_list_print_local = get_error_list_point();
         vTaskDelay(pdMS_TO_TICKS(500));
         TickType_t LoopStartTime;
+        int key;
         while (1) {
             DWT_get_time_interval_us(&global_task_time.tim_print_task);
             LoopStartTime = xTaskGetTickCount();
@@ -870,6 +1061,15 @@ referee usart:%s\r\n\
 //                    rc_ctrl.mouse.press_l,
 //                    rc_ctrl.mouse.press_r,
 //                    rc_ctrl.key.v);
+            key = print_command_key;
+            print_command_key = -1;
+            print_profile_command(key);
+            print_can_command(key);
+            print_flight_recorder_command(key);
+#if TELEMETRY_MODE == RTT_MODE
+            //启动时未输出完的飞行记录,单独的RTT上行缓存,每个周期输出一块
+            flight_recorder_dump(flight_recorder_write, FLIGHT_RECORDER_CHUNK_LEN);
+#endif
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
             print_task_stack = uxTaskGetStackHighWaterMark(NULL);
@@ -960,6 +1160,7 @@ void RTT_PrintWave_np(int num_args, ...) {
   * @retval         none
   */
 void RTT_timer_trigger(void) {
+    //遥测改为在云台任务每个控制周期末尾采样
 //                RTT_PrintWave(3,
 //                          &gimbal_control.gimbal_yaw_motor.motor_gyro_set,
 //                          &gimbal_control.gimbal_yaw_motor.motor_gyro,
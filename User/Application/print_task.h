@@ -19,6 +19,7 @@
 
 #include "struct_typedef.h"
 #include <stdint.h>
+#include "telemetry.h"
 
 
 /**
@@ -57,6 +58,17 @@ extern void RTT_PrintWave_np(int num_args, ...);
   */
 extern void RTT_timer_trigger(void);
 
+/**
+  * @brief          RTT终端的单字符命令,0号下行缓存只由PC_receive_task读取,读到后转交到这里,
+  *                 在print_task的下一个周期执行
+  * @param[in]      key: 'p'打印统计点 'r'清空统计点 'c'打印CAN统计 'f'丢弃冻结的飞行记录
+  * @retval         0:已接收 -1:不是打印命令
+  */
+extern int print_terminal_command(char key);
+
+//二进制遥测数据流,需要观察的变量用telemetry_add注册
+extern telemetry_t telemetry;
+
 extern float32_t bias_angle_test;
 extern float32_t add_angle_test;
 extern int8_t imu_temp;
@@ -1,10 +1,13 @@
 //#include <memory.h>
 #include "referee_task.h"
 #include "CRC8_CRC16.h"
+#include "main.h"
 #include "usart.h"
 #include "bsp_usart.h"
 #include "detect_task.h"
-#include "fifo.h"
+#include "spsc_fifo.h"
+#include "frame_parser.h"
+#include "referee_ui.h"
 #include "cmsis_os.h"
 #include "SEGGER_RTT.h"
 #include "global_control_define.h"
@@ -20,33 +23,38 @@
 #define SET_AUTO 0
 #define SET_MANUAL 1
 
+//UI发送预算与已同步图形的重发周期
+#define REFEREE_UI_BYTES_PER_SECOND 1000U
+#define REFEREE_UI_REFRESH_MS       2000U
+#define REFEREE_UI_TX_PERIOD_MS     100U
+//发送帧排队超过该时间仍未发出则丢弃,UI会在下次刷新时补发
+#define REFEREE_TX_TIMEOUT_MS       500U
+//UI图形优先级,数值越小越先发送
+#define UI_PRIORITY_COLLIMATOR      0U
+#define UI_PRIORITY_RULER           1U
+#define UI_PRIORITY_ROBOT_LIMIT     2U
+
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t referee_rx_task_stack;
 uint32_t referee_tx_task_stack;
-uint32_t USART6TX_active_task_stack;
+#endif
+
+#if (REFEREE_FIFO_BUF_LENGTH & (REFEREE_FIFO_BUF_LENGTH - 1)) != 0
+#error "REFEREE_FIFO_BUF_LENGTH must be a power of two"
 #endif
 
 volatile bool_t referee_set_manual_flag = SET_AUTO;
 
 judge_info_t global_judge_info;
 uint8_t referee_fifo_rx_buf[REFEREE_FIFO_BUF_LENGTH];
-uint8_t referee_fifo_tx_len_buf[REFEREE_FIFO_BUF_LENGTH];
-uint8_t referee_fifo_tx_buf[REFEREE_FIFO_BUF_LENGTH];
-unpack_data_t referee_unpack_obj;
-fifo_s_t referee_rx_fifo;
-fifo_s_t referee_tx_len_fifo;
-fifo_s_t referee_tx_fifo;
+frame_parser_t referee_parser;
+uint8_t referee_frame_buf[REF_PROTOCOL_FRAME_MAX_SIZE];
+spsc_fifo_t referee_rx_fifo;
 uint8_t usart6_rx_buf[2][USART6_RX_BUF_LENGHT];
-uint8_t usart6_tx_buf[2][USART6_TX_BUF_LENGHT];
-TaskHandle_t USART6TX_active_task_local_handler;
 ext_client_custom_graphic_delete_t cleaning;
 uint8_t data_pack[DRAWING_PACK * 7] = {0};
-volatile uint8_t Referee_No_DMA_IRQHandler = 1;
-volatile uint8_t referee_dma_send_data_len = 0;
-volatile uint8_t Referee_IRQ_Return_Before = 0;
-/* 发送数据包缓存区，最大128字节 */
-uint8_t referee_transmit_pack[128] = {0};
+referee_ui_t referee_ui;
 /*****************裁判系统接收功能 Start**********************/
 /**
   * @brief  裁判系统数据内存空间初始化
@@ -58,14 +66,115 @@ void init_referee_struct_data(void) {
 }
 
 /***********客户端图形绘制***********/
-static uint8_t UI_ruler(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t scale_step, uint16_t scale_long,
-                        uint16_t scale_short, colorType_e _color, drawOperate_e _operate_type);
+static void UI_ruler(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t scale_step, uint16_t scale_long,
+                     uint16_t scale_short, colorType_e _color);
+
+static void UI_Collimator(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t line_length, colorType_e _color);
+
+void Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uint16_t line_width, colorType_e _color);
+
+int pack_send_robotData(uint16_t _data_cmd_id, uint8_t *_data, uint16_t _data_len);
+
+static void send_toReferee(uart_tx_frame_t *p_frame, uint16_t _cmd_id, uint16_t _data_len);
 
-static void UI_Collimator(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t line_length, colorType_e _color,
-                          drawOperate_e _operate_type);
+/**
+  * @brief          每个校验通过的裁判系统帧,记录帧头信息
+  */
+static void judge_frame_update(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    memcpy((void *) &global_judge_info.FrameHeader, p_frame, LEN_FRAME_HEAD);
+    global_judge_info.frame_length = frame_len;
+    global_judge_info.cmd_id = cmd_id;
+    global_judge_info.data_valid = true;
+}
 
-void Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uint16_t line_width, colorType_e _color,
-                      drawOperate_e _operate_type);
+/**
+  * @brief          0x0201 机器人状态数据更新后,计算对应客户端ID
+  */
+static void judge_robot_status_update(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    global_judge_info.self_client_id = global_judge_info.GameRobotStatus.robot_id + 0x0100;
+}
+
+/* 裁判系统命令码注册表,数据段拷贝到global_judge_info对应成员 */
+static const frame_cmd_t referee_cmd_table[] = {
+        //0x0001 比赛状态数据
+        {ID_GAME_STATUS, LEN_GAME_STATUS, &global_judge_info.GameStatus, NULL, NULL},
+        //0x0002 比赛结果数据
+        {ID_GAME_RESULT, LEN_GAME_RESULT, &global_judge_info.GameResult, NULL, NULL},
+        //0x0003 比赛机器人血量数据
+        {ID_GAME_ROBOT_HP, LEN_GAME_ROBOT_HP, &global_judge_info.GameRobotHP, NULL, NULL},
+        //0x0005 人工智能挑战赛(ICRA)加成与惩罚区状态
+        {ID_ICRA_BUFF_DEBUFF_ZONE_STATUS, LEN_ICRA_BUFF_DEBUFF_ZONE_STATUS, &global_judge_info.ICRA_Buff_Debuff_zone_status,
+         &global_judge_info.ICRA_buff_debuff_zone_status_update, NULL},
+        //0x0101 场地事件数据
+        {ID_EVENT_DATA, LEN_EVENT_DATA, &global_judge_info.EventData, NULL, NULL},
+        //0x0102 场地补给站动作标识数据
+        {ID_SUPPLY_PROJECTILE_ACTION, LEN_SUPPLY_PROJECTILE_ACTION, &global_judge_info.SupplyProjectileAction,
+         &global_judge_info.supply_data_update, NULL},
+        //0x0104 裁判警告数据
+        {ID_REFEREE_WARNING, LEN_REFEREE_WARNING, &global_judge_info.RefereeWarning, NULL, NULL},
+        //0x0105 比赛机器人血量数据
+        {ID_DART_REMAINING_TIME, LEN_DART_REMAINING_TIME, &global_judge_info.DartRemainingTime, NULL, NULL},
+        //0x0201 机器人状态数据
+        {ID_GAME_ROBOT_STATUS, LEN_GAME_ROBOT_STATUS, &global_judge_info.GameRobotStatus,
+         NULL, judge_robot_status_update},
+        //0x0202 实时功率热量数据
+        {ID_POWER_HEAT_DATA, LEN_POWER_HEAT_DATA, &global_judge_info.PowerHeatData,
+         &global_judge_info.power_heat_update, NULL},
+        //0x0203 机器人位置数据
+        {ID_GAME_ROBOT_POS, LEN_GAME_ROBOT_POS, &global_judge_info.GameRobotPos, NULL, NULL},
+        //0x0204 机器人增益数据
+        {ID_BUFF, LEN_BUFF, &global_judge_info.Buff, NULL, NULL},
+        //0x0205 空中机器人能量状态数据
+        {ID_AERIAL_ROBOT_ENERGY, LEN_AERIAL_ROBOT_ENERGY, &global_judge_info.AerialRobotEnergy, NULL, NULL},
+        //0x0206 伤害状态数据
+        {ID_ROBOT_HURT, LEN_ROBOT_HURT, &global_judge_info.RobotHurt, &global_judge_info.hurt_data_update, NULL},
+        //0x0207 实时射击数据
+        {ID_SHOOT_DATA, LEN_SHOOT_DATA, &global_judge_info.ShootData, &global_judge_info.shoot_update, NULL},
+        //0x0208 弹丸剩余发射数
+        {ID_BULLET_REMAINING, LEN_BULLET_REMAINING, &global_judge_info.BulletRemaining, NULL, NULL},
+        //0x0209 机器人RFID状态
+        {ID_RFID_STATUS, LEN_RFID_STATUS, &global_judge_info.RFIDStatus, NULL, NULL},
+        //0x020A 飞镖机器人客户端指令数据
+        {ID_DART_CLIENT_COMMAND, LEN_DART_CLIENT_COMMAND, &global_judge_info.DartClientCMD,
+         &global_judge_info.dart_data_update, NULL},
+        //0x020B 地面机器人位置数据
+        {ID_GROUND_ROBOT_POSITION, LEN_GROUND_ROBOT_POSITION, &global_judge_info.GroundRobotPosition,
+         &global_judge_info.ground_robot_position_update, NULL},
+        //0x020C 雷达标记进度数据
+        {ID_RADAR_MARK_DATA, LEN_RADAR_MARK_DATA, &global_judge_info.RadarMarkData,
+         &global_judge_info.radar_mark_data_update, NULL},
+        //0x0301 机器人间交互数据（裁判系统），10HZ，最大128字节，数据段113字节
+        {ID_COMMUNICATION, LEN_COMMUNICATION, &global_judge_info.AerialData,
+         &global_judge_info.communication_data_update, NULL},
+        //0x0302 自定义控制器交互数据接口，30HZ
+        {ID_CUSTOMIZE_CONTROL_DATA, LEN_CUSTOMIZE_CONTROL_DATA, &global_judge_info.RobotInteractiveData,
+         &global_judge_info.customize_control_data_update, NULL},
+        //0x0303 客户端小地图交互数据
+        {ID_MAP_INTERACTION_DATA, LEN_MAP_INTERACTION_DATA, &global_judge_info.RobotCommand,
+         &global_judge_info.map_data_update, NULL},
+        //0x0304 图传串口发送键盘、鼠标信息
+        {ID_CONTROL_UART_DATA, LEN_CONTROL_UART_DATA, &global_judge_info.ControlUart,
+         &global_judge_info.map_data_update, NULL},
+        //0x0305 客户端小地图接收信息
+        {ID_MAP_DATA, LEN_MAP_DATA, &global_judge_info.ClientMapCommand,
+         &global_judge_info.client_map_data_update, NULL},
+        //0x0306 客户端小地图接收信息
+        {ID_CUSTOM_CLIENT_DATA, LEN_CUSTOM_CLIENT_DATA, &global_judge_info.CustomClientData,
+         &global_judge_info.custom_client_data_update, NULL},
+        //0x0307 选手端小地图接收哨兵数据
+        {ID_MAP_SENTRY_DATA, LEN_MAP_SENTRY_DATA, &global_judge_info.MapSentryData,
+         &global_judge_info.map_sentry_data_update, NULL},
+};
+
+static const frame_protocol_t referee_protocol = {
+        .sof = HEADER_SOF,
+        .header_len = LEN_FRAME_HEAD,
+        .len_offset = DATA_LENGTH,
+        .len_size = 2,
+        .header_crc8 = 1,
+        .cmd_id_size = LEN_CMD_ID,
+        .max_frame_len = REF_PROTOCOL_FRAME_MAX_SIZE,
+};
 
 /**
   * @brief          referee rx task
@@ -79,9 +188,12 @@ void Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uin
   */
 void referee_rx_task(void const *argument) {
     init_referee_struct_data();
-    fifo_s_init(&referee_rx_fifo, referee_fifo_rx_buf, REFEREE_FIFO_BUF_LENGTH);
-    usart6_init(usart6_rx_buf[0], usart6_rx_buf[1], USART6_RX_BUF_LENGHT, usart6_tx_buf[0], usart6_tx_buf[1],
-                USART6_TX_BUF_LENGHT);
+    if (spsc_fifo_init(&referee_rx_fifo, referee_fifo_rx_buf, REFEREE_FIFO_BUF_LENGTH) != 0) {
+        Error_Handler();
+    }
+    frame_parser_init(&referee_parser, &referee_protocol, referee_cmd_table,
+                      sizeof(referee_cmd_table) / sizeof(referee_cmd_table[0]), judge_frame_update, referee_frame_buf);
+    usart6_init(usart6_rx_buf[0], usart6_rx_buf[1], USART6_RX_BUF_LENGHT);
     static uint8_t armor_heart_flag = 0;
     TickType_t LoopStartTime;
     static uint16_t key_count = 0;
@@ -142,262 +254,22 @@ void referee_rx_task(void const *argument) {
     }
 }
 
-void judge_update(uint8_t *rxBuf) {
-    uint8_t res = false;
-    uint16_t frame_length = 0;
-    uint16_t cmd_id = 0;
-    judge_info_t *judge_info = &global_judge_info;
-    memcpy((void *) &judge_info->FrameHeader, rxBuf, LEN_FRAME_HEAD);
-//    printf("%d",judge_info->FrameHeader.SEQ);
-
-    if (rxBuf[J_SOF] == HEADER_SOF) {
-        if (verify_CRC8_check_sum(rxBuf, LEN_FRAME_HEAD) == true) {
-            frame_length = LEN_FRAME_HEAD + LEN_CMD_ID + judge_info->FrameHeader.data_length + LEN_FRAME_TAIL;
-            judge_info->frame_length = frame_length;
-
-            if (verify_CRC16_check_sum(rxBuf, frame_length) == true) {
-                res = true;
-                cmd_id = (rxBuf[CMD_ID + 1] << 8 | rxBuf[CMD_ID]);
-                judge_info->cmd_id = cmd_id;
-//                printf("%d",cmd_id);
-                switch (cmd_id) {
-                    // 0x000x
-                    case ID_GAME_STATUS://!< 0x0001 比赛状态数据
-                        memcpy((void *) &judge_info->GameStatus, (rxBuf + DATA_SEG), LEN_GAME_STATUS);
-                        break;
-
-                    case ID_GAME_RESULT://!< 0x0002 比赛结果数据
-                        memcpy((void *) &judge_info->GameResult, (rxBuf + DATA_SEG), LEN_GAME_RESULT);
-                        break;
-
-                    case ID_GAME_ROBOT_HP://!< 0x0003 比赛机器人血量数据
-                        memcpy((void *) &judge_info->GameRobotHP, (rxBuf + DATA_SEG), LEN_GAME_ROBOT_HP);
-                        break;
-
-                    case ID_ICRA_BUFF_DEBUFF_ZONE_STATUS://!< 0x0005 人工智能挑战赛(ICRA)加成与惩罚区状态
-                        memcpy((void *) &judge_info->ICRA_Buff_Debuff_zone_status, (rxBuf + DATA_SEG),
-                               LEN_ICRA_BUFF_DEBUFF_ZONE_STATUS);
-                        judge_info->ICRA_buff_debuff_zone_status_update = true;
-                        break;
-                        // 0x010x
-                    case ID_EVENT_DATA://!< 0x0101 场地事件数据
-                        memcpy((void *) &judge_info->EventData, (rxBuf + DATA_SEG), LEN_EVENT_DATA);
-                        break;
-
-                    case ID_SUPPLY_PROJECTILE_ACTION://!< 0x0102, 场地补给站动作标识数据
-                        memcpy((void *) &judge_info->SupplyProjectileAction, (rxBuf + DATA_SEG),
-                               LEN_SUPPLY_PROJECTILE_ACTION);
-                        judge_info->supply_data_update = true;
-                        break;
-
-                    case ID_REFEREE_WARNING://!< 0x0104 裁判警告数据
-                        memcpy((void *) &judge_info->RefereeWarning, (rxBuf + DATA_SEG), LEN_REFEREE_WARNING);
-                        break;
-
-                    case ID_DART_REMAINING_TIME://!< 0x0105 比赛机器人血量数据
-                        memcpy((void *) &judge_info->DartRemainingTime, (rxBuf + DATA_SEG),
-                               LEN_DART_REMAINING_TIME);
-                        break;
-                        // 0x020x
-                    case ID_GAME_ROBOT_STATUS://!< 0x0201 机器人状态数据
-                        memcpy((void *) &judge_info->GameRobotStatus, (rxBuf + DATA_SEG),
-                               LEN_GAME_ROBOT_STATUS);
-                        judge_info->self_client_id = judge_info->GameRobotStatus.robot_id + 0x0100;
-//                        printf("/r/n judge_client_id=%d", judge_info->self_client_id);
-                        break;
-
-                    case ID_POWER_HEAT_DATA://!< 0x0202 实时功率热量数据
-                        memcpy((void *) &judge_info->PowerHeatData, (rxBuf + DATA_SEG), LEN_POWER_HEAT_DATA);
-                        judge_info->power_heat_update = true;
-                        break;
-
-                    case ID_GAME_ROBOT_POS://!< 0x0203 机器人位置数据
-                        memcpy((void *) &judge_info->GameRobotPos, (rxBuf + DATA_SEG), LEN_GAME_ROBOT_POS);
-                        break;
-
-                    case ID_BUFF://!< 0x0204 机器人增益数据
-                        memcpy((void *) &judge_info->Buff, (rxBuf + DATA_SEG), LEN_BUFF);
-                        break;
-
-                    case ID_AERIAL_ROBOT_ENERGY://!< 0x0205 空中机器人能量状态数据
-                        memcpy((void *) &judge_info->AerialRobotEnergy, (rxBuf + DATA_SEG),
-                               LEN_AERIAL_ROBOT_ENERGY);
-                        break;
-
-                    case ID_ROBOT_HURT://!< 0x0206 伤害状态数据
-                        memcpy((void *) &judge_info->RobotHurt, (rxBuf + DATA_SEG), LEN_ROBOT_HURT);
-                        judge_info->hurt_data_update = true;
-                        break;
-
-                    case ID_SHOOT_DATA://!< 0x0207 实时射击数据
-                        memcpy((void *) &judge_info->ShootData, (rxBuf + DATA_SEG), LEN_SHOOT_DATA);
-                        judge_info->shoot_update = true;
-                        break;
-
-                    case ID_BULLET_REMAINING://!< 0x0208 弹丸剩余发射数
-                        memcpy((void *) &judge_info->BulletRemaining, (rxBuf + DATA_SEG), LEN_BULLET_REMAINING);
-                        break;
-
-                    case ID_RFID_STATUS://!< 0x0209 机器人RFID状态
-                        memcpy((void *) &judge_info->RFIDStatus, (rxBuf + DATA_SEG), LEN_RFID_STATUS);
-                        break;
-
-                    case ID_DART_CLIENT_COMMAND://!< 0x020A 飞镖机器人客户端指令数据
-                        memcpy((void *) &judge_info->DartClientCMD, (rxBuf + DATA_SEG),
-                               LEN_DART_CLIENT_COMMAND);
-                        judge_info->dart_data_update = true;
-                        break;
-                    case ID_GROUND_ROBOT_POSITION://!< 0x020B 地面机器人位置数据
-                        memcpy((void *) &judge_info->GroundRobotPosition, (rxBuf + DATA_SEG),
-                               LEN_GROUND_ROBOT_POSITION);
-                        judge_info->ground_robot_position_update = true;
-                        break;
-                    case ID_RADAR_MARK_DATA://!< 0x020C 雷达标记进度数据
-                        memcpy((void *) &judge_info->RadarMarkData, (rxBuf + DATA_SEG), LEN_RADAR_MARK_DATA);
-                        judge_info->radar_mark_data_update = true;
-                        break;
-
-                    case ID_COMMUNICATION://!< 0x0301 机器人间交互数据（裁判系统），10HZ，最大128字节，数据段113字节
-                        memcpy((void *) &judge_info->AerialData, (rxBuf + DATA_SEG), LEN_COMMUNICATION);
-                        judge_info->communication_data_update = true;
-                        break;
-
-                    case ID_CUSTOMIZE_CONTROL_DATA://!< 0x0302 自定义控制器交互数据接口，30HZ
-                        memcpy((void *) &judge_info->RobotInteractiveData, (rxBuf + DATA_SEG),
-                               LEN_CUSTOMIZE_CONTROL_DATA);
-                        judge_info->customize_control_data_update = true;
-                        break;
-
-                    case ID_MAP_INTERACTION_DATA://!< 0x0303 客户端小地图交互数据
-                        memcpy((void *) &judge_info->RobotCommand, (rxBuf + DATA_SEG),
-                               LEN_MAP_INTERACTION_DATA);
-                        judge_info->map_data_update = true;
-                        break;
-                    case ID_CONTROL_UART_DATA://!< 0x0304 图传串口发送键盘、鼠标信息
-                        memcpy((void *) &judge_info->ControlUart, (rxBuf + DATA_SEG), LEN_CONTROL_UART_DATA);
-                        judge_info->map_data_update = true;
-                        break;
-                    case ID_MAP_DATA://!< 0x0305 客户端小地图接收信息
-                        memcpy((void *) &judge_info->ClientMapCommand, (rxBuf + DATA_SEG), LEN_MAP_DATA);
-                        judge_info->client_map_data_update = true;
-                        break;
-                    case ID_CUSTOM_CLIENT_DATA://!< 0x0306 客户端小地图接收信息
-                        memcpy((void *) &judge_info->CustomClientData, (rxBuf + DATA_SEG),
-                               LEN_CUSTOM_CLIENT_DATA);
-                        judge_info->custom_client_data_update = true;
-                        break;
-                    case ID_MAP_SENTRY_DATA://!< 0x0307 选手端小地图接收哨兵数据
-                        memcpy((void *) &judge_info->MapSentryData, (rxBuf + DATA_SEG), LEN_MAP_SENTRY_DATA);
-                        judge_info->map_sentry_data_update = true;
-                        break;
-                    default:
-                        break;
-                }
-
-                if (rxBuf[frame_length] == 0xA5) {
-                    judge_update(&rxBuf[frame_length]);
-                }
-            }
-        }
-    }
-    judge_info->data_valid = res;
-    if (judge_info->data_valid != true) {
-        judge_info->err_cnt++;
-        judge_info->data_valid = false;
-    } else {
-        judge_info->data_valid = true;
-    }
-}
-
 /**
-  * @brief          single byte upacked
+  * @brief          unpack the referee frames in the rx fifo
   * @param[in]      void
   * @retval         none
   */
 /**
-  * @brief          单字节解包
+  * @brief          解析接收队列中的裁判系统数据帧
   * @param[in]      void
   * @retval         none
   */
 void referee_unpack_fifo_data(void) {
-    uint8_t byte = 0;
-    uint8_t sof = HEADER_SOF;
-    unpack_data_t *p_obj = &referee_unpack_obj;
-
-    while (fifo_s_used(&referee_rx_fifo)) {
-        byte = fifo_s_get(&referee_rx_fifo);
-        switch (p_obj->unpack_step) {
-            case STEP_HEADER_SOF: {
-                if (byte == sof) {
-                    p_obj->unpack_step = STEP_LENGTH_LOW;
-                    p_obj->protocol_packet[p_obj->index++] = byte;
-                } else {
-                    p_obj->index = 0;
-                }
-            }
-                break;
-
-            case STEP_LENGTH_LOW: {
-                p_obj->data_len = byte;
-                p_obj->protocol_packet[p_obj->index++] = byte;
-                p_obj->unpack_step = STEP_LENGTH_HIGH;
-            }
-                break;
-
-            case STEP_LENGTH_HIGH: {
-                p_obj->data_len |= (byte << 8);
-                p_obj->protocol_packet[p_obj->index++] = byte;
-
-                if (p_obj->data_len < (REF_PROTOCOL_FRAME_MAX_SIZE - REF_HEADER_CRC_CMDID_LEN)) {
-                    p_obj->unpack_step = STEP_FRAME_SEQ;
-                } else {
-                    p_obj->unpack_step = STEP_HEADER_SOF;
-                    p_obj->index = 0;
-                }
-            }
-                break;
-            case STEP_FRAME_SEQ: {
-                p_obj->protocol_packet[p_obj->index++] = byte;
-                p_obj->unpack_step = STEP_HEADER_CRC8;
-            }
-                break;
-
-            case STEP_HEADER_CRC8: {
-                p_obj->protocol_packet[p_obj->index++] = byte;
-
-                if (p_obj->index == REF_PROTOCOL_HEADER_SIZE) {
-                    if (verify_CRC8_check_sum(p_obj->protocol_packet, REF_PROTOCOL_HEADER_SIZE)) {
-                        p_obj->unpack_step = STEP_DATA_CRC16;
-                    } else {
-                        p_obj->unpack_step = STEP_HEADER_SOF;
-                        p_obj->index = 0;
-                    }
-                }
-            }
-                break;
-
-            case STEP_DATA_CRC16: {
-                if (p_obj->index < (REF_HEADER_CRC_CMDID_LEN + p_obj->data_len)) {
-                    p_obj->protocol_packet[p_obj->index++] = byte;
-                }
-                if (p_obj->index >= (REF_HEADER_CRC_CMDID_LEN + p_obj->data_len)) {
-                    p_obj->unpack_step = STEP_HEADER_SOF;
-                    p_obj->index = 0;
-
-                    if (verify_CRC16_check_sum(p_obj->protocol_packet,
-                                               REF_HEADER_CRC_CMDID_LEN + p_obj->data_len)) {
-                        judge_update(p_obj->protocol_packet);
-                    }
-                }
-            }
-                break;
-
-            default: {
-                p_obj->unpack_step = STEP_HEADER_SOF;
-                p_obj->index = 0;
-            }
-                break;
-        }
+    uint32_t last_err_cnt = referee_parser.err_cnt;
+    frame_parser_unpack_fifo(&referee_parser, &referee_rx_fifo);
+    if (referee_parser.err_cnt != last_err_cnt) {
+        global_judge_info.err_cnt += (uint16_t) (referee_parser.err_cnt - last_err_cnt);
+        global_judge_info.data_valid = false;
     }
 }
 
@@ -418,7 +290,7 @@ void USART6_IRQHandler(void) {
             __HAL_DMA_SET_COUNTER(huart6.hdmarx, USART6_RX_BUF_LENGHT);
             huart6.hdmarx->Instance->CR |= DMA_SxCR_CT;
             __HAL_DMA_ENABLE(huart6.hdmarx);
-            fifo_s_puts(&referee_rx_fifo, (char *) usart6_rx_buf[0], this_time_rx_len);
+            spsc_fifo_puts(&referee_rx_fifo, usart6_rx_buf[0], this_time_rx_len);
             detect_hook(REFEREE_RX_TOE);
         } else {
             __HAL_DMA_DISABLE(huart6.hdmarx);
@@ -426,22 +298,11 @@ void USART6_IRQHandler(void) {
             __HAL_DMA_SET_COUNTER(huart6.hdmarx, USART6_RX_BUF_LENGHT);
             huart6.hdmarx->Instance->CR &= ~(DMA_SxCR_CT);
             __HAL_DMA_ENABLE(huart6.hdmarx);
-            fifo_s_puts(&referee_rx_fifo, (char *) usart6_rx_buf[1], this_time_rx_len);
+            spsc_fifo_puts(&referee_rx_fifo, usart6_rx_buf[1], this_time_rx_len);
             detect_hook(REFEREE_RX_TOE);
         }
     }
 }
-
-/**
-  * @brief          发送串口（USART6）DMA回调函数
-  * @param[in]      void
-  * @retval         none
-  */
-void DMA2_Stream6_IRQHandler(void) {
-    if (__HAL_DMA_GET_FLAG(huart6.hdmatx, DMA_HISR_TCIF6) != RESET) {
-        MY_USART_DMA_Stream6_TX_IRQHandler();
-    }
-}
 /*****************裁判系统接收功能 END**********************/
 /*****************裁判系统接收数据分析函数 START**********************/
 
@@ -451,6 +312,15 @@ void get_chassis_power_and_buffer(float32_t *power, float32_t *buffer) {
 
 }
 
+bool_t get_chassis_power_update(float32_t *power, float32_t *buffer) {
+    if (!global_judge_info.power_heat_update) {
+        return 0;
+    }
+    global_judge_info.power_heat_update = 0;
+    get_chassis_power_and_buffer(power, buffer);
+    return 1;
+}
+
 uint8_t get_robot_id(void) {
     return global_judge_info.GameRobotStatus.robot_id;
 }
@@ -473,19 +343,28 @@ void get_shoot_heat0_limit_and_heat0(uint16_t *heat0_limit, uint16_t *heat0) {
   * @retval         none
   */
 void referee_tx_task(void const *argument) {
-    fifo_s_init(&referee_tx_len_fifo, referee_fifo_tx_len_buf, REFEREE_FIFO_BUF_LENGTH);
-    fifo_s_init(&referee_tx_fifo, referee_fifo_tx_buf, REFEREE_FIFO_BUF_LENGTH);
+    referee_ui_init(&referee_ui, pack_send_robotData, REFEREE_UI_BYTES_PER_SECOND, REFEREE_UI_REFRESH_MS);
     //下坠UI标尺的水平刻度线长度、距离、颜色；垂直线总长度由为各水平刻度线距离之和
     vTaskDelay(pdMS_TO_TICKS(5000));
     while (toe_is_error(REFEREE_RX_TOE)) {
         UI_clean_all();
     }
     TickType_t LoopStartTime;
+    bool_t referee_offline = 0;
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_referee_tx_task);
         LoopStartTime = xTaskGetTickCount();
-        Draw_Robot_Limit(180, 80, 961, 3, YELLOW, ADD_PICTURE);
-        UI_ruler(4, 961, 538, 30, 70, 40, YELLOW, ADD_PICTURE);
+        //裁判系统重连后客户端图形已丢失,全部重新新增
+        if (toe_is_error(REFEREE_RX_TOE)) {
+            referee_offline = 1;
+        } else if (referee_offline) {
+            referee_offline = 0;
+            referee_ui_invalidate(&referee_ui);
+        }
+        //每周期声明期望的图形,只有变化部分按优先级在带宽预算内发送
+        Draw_Robot_Limit(180, 80, 961, 3, YELLOW);
+        UI_ruler(4, 961, 538, 30, 70, 40, YELLOW);
+        referee_ui_flush(&referee_ui, LoopStartTime * portTICK_PERIOD_MS);
 //        SEGGER_RTT_printf(0,"robot_id=%d,client_id=%d\r\n",global_judge_info.GameRobotStatus.robot_id,global_judge_info.self_client_id);
 //        SEGGER_RTT_WriteString(0, "referee_task_loop_on");
 //        draw_cnt++;
@@ -498,7 +377,7 @@ void referee_tx_task(void const *argument) {
 #if INCLUDE_uxTaskGetStackHighWaterMark
         referee_tx_task_stack = uxTaskGetStackHighWaterMark(NULL);
 #endif
-        vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(500));
+        vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(REFEREE_UI_TX_PERIOD_MS));
     }
 }
 
@@ -526,33 +405,43 @@ uint32_t get_stack_of_referee_rx_task(void) {
  * 		  _receiver_ID: 接收方ID，可以是机器人对应客户端、或者己方其他机器人
  * 		  _data: 数据段段首指针
  * 		  _data_len: 数据段长度
- * @retval None
+ * @retval 0:已提交发送 -1:数据段过长或帧缓存耗尽,该帧丢弃
  */
-void pack_send_robotData(uint16_t _data_cmd_id, uint8_t *_data, uint16_t _data_len) {
+int pack_send_robotData(uint16_t _data_cmd_id, uint8_t *_data, uint16_t _data_len) {
     ext_student_interactive_header_data_t data_header;                                                                //定义数据段段首并设置
+    uart_tx_frame_t *p_frame;
+    uint8_t header_len = sizeof(data_header);
+    if (_data_len > UART_TX_FRAME_SIZE - REF_HEADER_CRC_CMDID_LEN - header_len) {
+        return -1;
+    }
+    //帧缓存耗尽时丢弃该帧
+    p_frame = uart_tx_alloc(&usart6_tx_port);
+    if (p_frame == NULL) {
+        return -1;
+    }
     memset(&data_header, 0, sizeof(data_header));
     data_header.data_CMD_ID = _data_cmd_id;
     data_header.sender_ID = global_judge_info.GameRobotStatus.robot_id;                                        //设置发送者ID
     data_header.receiver_ID = global_judge_info.self_client_id;
 //    printf("/r/nclient_id=%d", global_judge_info.self_client_id);
-    uint8_t header_len = 6;
-    memcpy((void *) (referee_transmit_pack + 7), &data_header,
+    memcpy((void *) (p_frame->data + LEN_FRAME_HEAD + LEN_CMD_ID), &data_header,
            header_len);                        //将数据帧的数据段进行封装（封装段首）
-    memcpy((void *) (referee_transmit_pack + 7 + header_len), _data,
+    memcpy((void *) (p_frame->data + LEN_FRAME_HEAD + LEN_CMD_ID + header_len), _data,
            _data_len);                    //将数据帧的数据段进行封装（封装数据）
-    send_toReferee(ID_COMMUNICATION, header_len + _data_len);
+    send_toReferee(p_frame, ID_COMMUNICATION, header_len + _data_len);
+    return 0;
 }
 
 /**
- * @brief 底层发送函数。负责发送数据包，以及对发送速率做控制
- * @param _cmd_id，
- * @param _data，
- * @param data_len，
- * @param _receive_type，判断车间通信 or 雷达站 or UI，决定数据需不需要发多次（客户端数据经常丢包，所以需要发多次），以及发送频率
+ * @brief 底层发送函数。在帧缓存中补全帧头、命令码和CRC16后提交到串口6发送调度器
+ * @param p_frame，uart_tx_alloc申请的帧缓存，数据段已写入
+ * @param _cmd_id，命令码
+ * @param _data_len，数据段长度
  */
-void send_toReferee(uint16_t _cmd_id, uint16_t _data_len) {
+static void send_toReferee(uart_tx_frame_t *p_frame, uint16_t _cmd_id, uint16_t _data_len) {
     static uint8_t seq = 0;
     std_frame_header_t send_frame_header;                                                                                            //交互数据帧帧头设置
+    uint16_t frame_len = LEN_FRAME_HEAD + LEN_CMD_ID + _data_len + LEN_FRAME_TAIL;
     memset(&send_frame_header, 0, sizeof(send_frame_header));
     send_frame_header.SOF = HEADER_SOF;
     send_frame_header.data_length = _data_len;
@@ -560,283 +449,17 @@ void send_toReferee(uint16_t _cmd_id, uint16_t _data_len) {
     if (seq == 255) {
         seq = 0;
     }
-//    printf("/r/n seq=%d", send_frame_header.SEQ);
     append_CRC8_check_sum((uint8_t *) &send_frame_header, sizeof(send_frame_header));
-//    send_frame_header.CRC8 = get_CRC8_check_sum((uint8_t *) &send_frame_header, 4, 0xff);
     uint16_t CmdID = _cmd_id;
 
-    uint8_t header_len = 5;
-
-    memcpy((void *) referee_transmit_pack, &send_frame_header, header_len);//将帧头装入缓存区
-    memcpy((void *) (referee_transmit_pack + 5), &CmdID,
-           2);                                                                    //将数据段转入缓存区
-    append_CRC16_check_sum(referee_transmit_pack, header_len + _data_len + 4);
-//    for (int i = 0; i <= header_len + _data_len + 4;i++) {
-//        printf(" %02x",referee_transmit_pack[i]);
-//    }
-    fifo_s_put(&referee_tx_len_fifo, header_len + _data_len + 4);
-    fifo_s_puts(&referee_tx_fifo, (char *) referee_transmit_pack, header_len + _data_len + 4);
-    memset(referee_transmit_pack, 0, sizeof(referee_transmit_pack));
-    if (Referee_No_DMA_IRQHandler || Referee_IRQ_Return_Before) {
-        if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
-            xTaskNotifyGive(USART6TX_active_task_local_handler);
-//            portYIELD();
-        }
-    }
-}
-
-////will_abandon
-//void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-//    if (htim->Instance == htim2.Instance) {
-////    printf("%d", fifo_s_used(&referee_tx_fifo));
-//        if (Referee_No_DMA_IRQHandler) {
-//            if (fifo_s_used(&referee_tx_fifo)) {
-//                if (fifo_s_used(&referee_tx_len_fifo)) {
-//                    if ((huart6.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-////                    SEGGER_RTT_WriteString(0, "ST0DMA_1");
-//                        __HAL_DMA_DISABLE(huart6.hdmatx);
-//                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-//                        memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-//                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[1], referee_dma_send_data_len);
-//                        huart6.hdmatx->Instance->CR |= DMA_SxCR_CT;
-//                        __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-//                        __HAL_DMA_ENABLE(huart6.hdmatx);
-//                        Referee_No_DMA_IRQHandler = 0;
-//                        detect_hook(REFEREE_TX_TOE);
-//                        if (fifo_s_used(&referee_tx_fifo)) {
-//                            if (fifo_s_used(&referee_tx_len_fifo)) {
-//                                referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-//                                memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-//                                fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[0], referee_dma_send_data_len);
-//                            }
-//                        } else {
-//                            referee_dma_send_data_len = 0;
-//                            Referee_No_DMA_IRQHandler = 1;
-//                            memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-//                        }
-//                    } else {
-////                    SEGGER_RTT_WriteString(0, "ST0DMA_0");
-//                        __HAL_DMA_DISABLE(huart6.hdmatx);
-//                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-//                        memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-//                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[0], referee_dma_send_data_len);
-//                        huart6.hdmatx->Instance->CR &= ~(DMA_SxCR_CT);
-//                        __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-//                        __HAL_DMA_ENABLE(huart6.hdmatx);
-//                        Referee_No_DMA_IRQHandler = 0;
-//                        detect_hook(REFEREE_TX_TOE);
-//                        if (fifo_s_used(&referee_tx_fifo)) {
-//                            if (fifo_s_used(&referee_tx_len_fifo)) {
-//                                referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-//                                memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-//                                fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[1], referee_dma_send_data_len);
-//
-//                            }
-//                        } else {
-//                            referee_dma_send_data_len = 0;
-//                            Referee_No_DMA_IRQHandler = 1;
-//                            memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-//                        }
-//                    }
-//                }
-//            }
-//        }
-//    }
-//}
-
-/**
-  * @brief          usart6发送启动任务，由发送时任务通知激活
-  * @param[in]      pvParameters: 空
-  * @retval         none
-  */
-void USART6TX_active_task(void const *pvParameters) {
-    USART6TX_active_task_local_handler = xTaskGetCurrentTaskHandle();
-    TickType_t LoopStartTime;
-    while (1) {
-        while (ulTaskNotifyTake(pdFALSE, portMAX_DELAY) != pdPASS) {
-        }
-        DWT_get_time_interval_us(&global_task_time.tim_USART6TX_active_task);
-//        SEGGER_RTT_printf(0,"%d\r\n",global_task_time.tim_USART6TX_active_task.time);
-        LoopStartTime = xTaskGetTickCount();
-        vTaskSuspendAll();
-        if (Referee_No_DMA_IRQHandler || Referee_IRQ_Return_Before) {
-            if (fifo_s_used(&referee_tx_fifo)) {
-                if (fifo_s_used(&referee_tx_len_fifo)) {
-                    if ((huart6.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-//                    SEGGER_RTT_WriteString(0, "ST0DMA_1");
-                        __HAL_DMA_DISABLE(huart6.hdmatx);
-                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                        if (referee_dma_send_data_len > 1) {
-                            Referee_IRQ_Return_Before = 0;
-                        }
-                        memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[1], referee_dma_send_data_len);
-                        huart6.hdmatx->Instance->CR |= DMA_SxCR_CT;
-                        __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-                        __HAL_DMA_ENABLE(huart6.hdmatx);
-                        Referee_No_DMA_IRQHandler = 0;
-                        referee_dma_send_data_len = 0;
-                        detect_hook(REFEREE_TX_TOE);
-                        taskENTER_CRITICAL();
-                        if (!Referee_IRQ_Return_Before) {
-                            if (fifo_s_used(&referee_tx_fifo)) {
-                                if (fifo_s_used(&referee_tx_len_fifo)) {
-                                    referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                                    memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-                                    fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[0],
-                                                referee_dma_send_data_len);
-                                }
-                            } else {
-                                referee_dma_send_data_len = 0;
-                                Referee_No_DMA_IRQHandler = 1;
-                                memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-                            }
-                        }
-                        taskEXIT_CRITICAL();
-                    } else {
-//                    SEGGER_RTT_WriteString(0, "ST0DMA_0");
-                        __HAL_DMA_DISABLE(huart6.hdmatx);
-                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                        if (referee_dma_send_data_len > 1) {
-                            Referee_IRQ_Return_Before = 0;
-                        }
-                        memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[0], referee_dma_send_data_len);
-                        huart6.hdmatx->Instance->CR &= ~(DMA_SxCR_CT);
-                        __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-                        __HAL_DMA_ENABLE(huart6.hdmatx);
-                        Referee_No_DMA_IRQHandler = 0;
-                        referee_dma_send_data_len = 0;
-                        detect_hook(REFEREE_TX_TOE);
-                        taskENTER_CRITICAL();
-                        if (!Referee_IRQ_Return_Before) {
-                            if (fifo_s_used(&referee_tx_fifo)) {
-                                if (fifo_s_used(&referee_tx_len_fifo)) {
-                                    referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                                    memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-                                    fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[1],
-                                                referee_dma_send_data_len);
-                                }
-                            } else {
-                                referee_dma_send_data_len = 0;
-                                Referee_No_DMA_IRQHandler = 1;
-                                memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-                            }
-                        }
-                        taskEXIT_CRITICAL();
-                    }
-                }
-            }
-        }
-        xTaskResumeAll();
-        vTaskDelayUntil(&LoopStartTime, pdMS_TO_TICKS(100));
-#if INCLUDE_uxTaskGetStackHighWaterMark
-        USART6TX_active_task_stack = uxTaskGetStackHighWaterMark(NULL);
-#endif
-    }
-}
-
-void MY_USART_DMA_Stream6_TX_IRQHandler(void) {
-    __HAL_DMA_DISABLE(huart6.hdmatx);
-    while (huart6.hdmatx->Instance->CR & DMA_SxCR_EN) {
-        __HAL_DMA_DISABLE(huart6.hdmatx);
-    }
-    __HAL_DMA_CLEAR_FLAG(huart6.hdmatx, DMA_HISR_TCIF6);
-    __HAL_DMA_CLEAR_FLAG (huart6.hdmatx, __HAL_DMA_GET_HT_FLAG_INDEX(huart6.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart6.hdmatx, __HAL_DMA_GET_TE_FLAG_INDEX(huart6.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart6.hdmatx, __HAL_DMA_GET_DME_FLAG_INDEX(huart6.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart6.hdmatx, __HAL_DMA_GET_FE_FLAG_INDEX(huart6.hdmatx));
-    if ((!fifo_s_used(&referee_tx_fifo)) || (!fifo_s_used(&referee_tx_len_fifo))) {
-        if ((fifo_s_used(&referee_tx_fifo)) || (fifo_s_used(&referee_tx_len_fifo))) {
-            //should not come in here
-            fifo_s_flush(&referee_tx_fifo);
-            fifo_s_flush(&referee_tx_len_fifo);
-        }
-    }
-    if (referee_dma_send_data_len == 1) {
-        Referee_IRQ_Return_Before = 1;
-    }
-    if (referee_dma_send_data_len) {
-        if ((huart6.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-            __HAL_DMA_DISABLE(huart6.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart6.hdmatx, DMA_HISR_TCIF6);
-            __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_0");
-            __HAL_DMA_ENABLE(huart6.hdmatx);
-            referee_dma_send_data_len = 0;
-            detect_hook(REFEREE_TX_TOE);
-            if (!Referee_IRQ_Return_Before) {
-                if (fifo_s_used(&referee_tx_fifo)) {
-                    if (fifo_s_used(&referee_tx_len_fifo)) {
-                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                        memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[1], referee_dma_send_data_len);
-                    }
-                } else {
-                    referee_dma_send_data_len = 0;
-                    Referee_No_DMA_IRQHandler = 1;
-                    memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-                }
-            }
-        } else {
-            __HAL_DMA_DISABLE(huart6.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart6.hdmatx, DMA_HISR_TCIF6);
-            __HAL_DMA_SET_COUNTER(huart6.hdmatx, referee_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_1");
-            __HAL_DMA_ENABLE(huart6.hdmatx);
-            referee_dma_send_data_len = 0;
-            detect_hook(REFEREE_TX_TOE);
-            if (!Referee_IRQ_Return_Before) {
-                if (fifo_s_used(&referee_tx_fifo)) {
-                    if (fifo_s_used(&referee_tx_len_fifo)) {
-                        referee_dma_send_data_len = fifo_s_get(&referee_tx_len_fifo);
-                        memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-                        fifo_s_gets(&referee_tx_fifo, (char *) usart6_tx_buf[0], referee_dma_send_data_len);
-                    }
-                } else {
-                    referee_dma_send_data_len = 0;
-                    Referee_No_DMA_IRQHandler = 1;
-                    memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-                }
-            }
-        }
-    } else {
-        memset(&usart6_tx_buf[1], 0, USART6_TX_BUF_LENGHT);
-        memset(&usart6_tx_buf[0], 0, USART6_TX_BUF_LENGHT);
-        if (!Referee_No_DMA_IRQHandler) {
-            Referee_IRQ_Return_Before = 1;
-            if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
-//                SEGGER_RTT_WriteString(0, "yield\r\n");
-                static BaseType_t xHigherPriorityTaskWoken;
-                vTaskNotifyGiveFromISR(USART6TX_active_task_local_handler, &xHigherPriorityTaskWoken);
-            }
-        }
-    }
-}
-
-/**
-  * @brief          获取USART6TX_active_task栈大小
-  * @param[in]      none
-  * @retval         USART6TX_active_task_stack:任务堆栈大小
-  */
-uint32_t get_stack_of_USART6TX_active_task(void) {
-    return USART6TX_active_task_stack;
+    memcpy((void *) p_frame->data, &send_frame_header, LEN_FRAME_HEAD);//将帧头装入缓存区
+    memcpy((void *) (p_frame->data + LEN_FRAME_HEAD), &CmdID, LEN_CMD_ID);
+    append_CRC16_check_sum(p_frame->data, frame_len);
+    uart_tx_commit(&usart6_tx_port, p_frame, frame_len, UART_TX_PRIORITY_NORMAL, REFEREE_TX_TIMEOUT_MS);
 }
 
 /************UI operation start*****************/
 
-/**
- * @brief 空操作数据包
- * @param
- * @retval
- */
-static graphic_data_struct_t *null_drawing(uint8_t _layer, uint8_t name[]) {
-    static graphic_data_struct_t drawing;
-    memcpy(drawing.graphic_name, name, 3);
-    drawing.operate_type = NULL_OPERATION;
-    return &drawing;
-}
-
 /**
  * @brief 直线绘制数据包
  * @param line_width 线宽
@@ -1207,133 +830,88 @@ void UI_clean_all(
 }
 
 /**
- * @brief 【自定义图层】UI标尺绘制，一次性绘制一条标尺
+ * @brief 【自定义图层】UI标尺绘制，一次性声明一条标尺
  * @note  准心圆半径为24
  * @param _sys_time, sacle_num多少条刻度线(<9),ruler_tag第几条标尺, startpoint(标尺左上角起点), step(间距),scale_long(长刻度线的长度),scale_short
- * @note 测试后的实例，对普通步兵：referee.UI_ruler(4,961,538,30,70,40,BLUE,ADD_PICTURE);
+ * @note 测试后的实例，对普通步兵：referee.UI_ruler(4,961,538,30,70,40,BLUE);
  */
-uint8_t UI_ruler(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t scale_step, uint16_t scale_long,
-                 uint16_t scale_short, colorType_e _color, drawOperate_e _operate_type) {
+void UI_ruler(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t scale_step, uint16_t scale_long,
+              uint16_t scale_short, colorType_e _color) {
     static uint8_t ruler_name[] = "ru0";
-    static uint8_t if_short = 0;
+    uint16_t scale;
 
     ruler_name[2] = '0';
-    memcpy(data_pack,
-           (uint8_t *) circle_drawing(_layer, _operate_type, start_x, start_y, 24, 3, _color, ruler_name),
-           DRAWING_PACK);
+    referee_ui_set(&referee_ui, circle_drawing(_layer, ADD_PICTURE, start_x, start_y, 24, 3, _color, ruler_name),
+                   UI_PRIORITY_RULER);
     ruler_name[2] = '1';
-    memcpy(&data_pack[DRAWING_PACK],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x, start_y, start_x, start_y - 200, 3, _color,
-                                    ruler_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x, start_y, start_x, start_y - 200, 3, _color,
+                                             ruler_name), UI_PRIORITY_RULER);
     ruler_name[2] = '2';
-    memcpy(&data_pack[DRAWING_PACK * 2],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x - 100, start_y - 10, start_x + 100,
-                                    start_y - 10, 3,
-                                    _color, ruler_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x - 100, start_y - 10, start_x + 100,
+                                             start_y - 10, 3, _color, ruler_name), UI_PRIORITY_RULER);
 
+    //长短刻度线交替,第一条为短刻度
     for (uint8_t i = 0; i < 4; i++) {
-        if (if_short == 0) {
-            if_short = 1;
-            ruler_name[2] = '3' + i;
-            memcpy(&data_pack[DRAWING_PACK * (i + 3)],
-                   (uint8_t *) line_drawing(_layer, _operate_type, start_x - scale_short / 2,
-                                            start_y - 24 - scale_step * (i + 1), start_x + scale_short / 2,
-                                            start_y - 24 - scale_step * (i + 1), 3, _color, ruler_name),
-                   DRAWING_PACK);
-        } else {
-            if_short = 0;
-            ruler_name[2] = '3' + i;
-            memcpy(&data_pack[DRAWING_PACK * (i + 3)],
-                   (uint8_t *) line_drawing(_layer, _operate_type, start_x - scale_long / 2,
-                                            start_y - 24 - scale_step * (i + 1), start_x + scale_long / 2,
-                                            start_y - 24 - scale_step * (i + 1), 3, _color, ruler_name),
-                   DRAWING_PACK);
-        }
+        scale = (i % 2 == 0) ? scale_short : scale_long;
+        ruler_name[2] = '3' + i;
+        referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x - scale / 2,
+                                                 start_y - 24 - scale_step * (i + 1), start_x + scale / 2,
+                                                 start_y - 24 - scale_step * (i + 1), 3, _color, ruler_name),
+                       UI_PRIORITY_RULER);
     }
-
-    pack_send_robotData(Drawing_7_ID, (uint8_t *) data_pack, DRAWING_PACK * 7);
 }
 
 /**
- * @brief 【自定义图层】UI准星绘制，一次性绘制一个准星，且准星中点为红外激光中心点
- * @note 测试后的实例，对普通步兵：referee.UI_Collimator(5, 961, 538, 25, YELLOW, ADD_PICTURE);
+ * @brief 【自定义图层】UI准星绘制，一次性声明一个准星，且准星中点为红外激光中心点
+ * @note 测试后的实例，对普通步兵：referee.UI_Collimator(5, 961, 538, 25, YELLOW);
  * @param
  */
-void UI_Collimator(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t line_length, colorType_e _color,
-                   drawOperate_e _operate_type) {
+void UI_Collimator(uint8_t _layer, uint16_t start_x, uint16_t start_y, uint16_t line_length, colorType_e _color) {
     static uint8_t point_name[] = "poi";
     static uint8_t line_name[] = "cl0";
 
     //中心点
-    line_name[2] = '0';
-    memcpy(data_pack,
-           (uint8_t *) circle_drawing(_layer, _operate_type, start_x, start_y, 1, 3, _color, point_name),
-           DRAWING_PACK);
+    referee_ui_set(&referee_ui, circle_drawing(_layer, ADD_PICTURE, start_x, start_y, 1, 3, _color, point_name),
+                   UI_PRIORITY_COLLIMATOR);
 
     //准星四方向横线
-    memcpy(&data_pack[DRAWING_PACK],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x - 5, start_y, start_x - 5 - line_length,
-                                    start_y, 3,
-                                    _color, line_name), DRAWING_PACK);
+    line_name[2] = '0';
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x - 5, start_y, start_x - 5 - line_length,
+                                             start_y, 3, _color, line_name), UI_PRIORITY_COLLIMATOR);
     line_name[2] = '1';
-    memcpy(&data_pack[DRAWING_PACK * 2],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x + 5, start_y, start_x + 5 + line_length,
-                                    start_y, 3,
-                                    _color, line_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x + 5, start_y, start_x + 5 + line_length,
+                                             start_y, 3, _color, line_name), UI_PRIORITY_COLLIMATOR);
     line_name[2] = '2';
-    memcpy(&data_pack[DRAWING_PACK * 3],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x, start_y - 5, start_x,
-                                    start_y - 5 - line_length, 3,
-                                    _color, line_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x, start_y - 5, start_x,
+                                             start_y - 5 - line_length, 3, _color, line_name),
+                   UI_PRIORITY_COLLIMATOR);
     line_name[2] = '3';
-    memcpy(&data_pack[DRAWING_PACK * 4],
-           (uint8_t *) line_drawing(_layer, _operate_type, start_x, start_y + 5, start_x,
-                                    start_y + 5 + line_length, 3,
-                                    _color, line_name), DRAWING_PACK);
-
-    //空操作包
-    line_name[2] = '4';
-    memcpy(&data_pack[DRAWING_PACK * 5], (uint8_t *) null_drawing(_layer, line_name), DRAWING_PACK);
-    line_name[2] = '5';
-    memcpy(&data_pack[DRAWING_PACK * 6], (uint8_t *) null_drawing(_layer, line_name), DRAWING_PACK);
-
-    pack_send_robotData(Drawing_7_ID, (uint8_t *) data_pack, DRAWING_PACK * 7);
+    referee_ui_set(&referee_ui, line_drawing(_layer, ADD_PICTURE, start_x, start_y + 5, start_x,
+                                             start_y + 5 + line_length, 3, _color, line_name),
+                   UI_PRIORITY_COLLIMATOR);
 }
 
-void
-Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uint16_t line_width, colorType_e _color,
-                 drawOperate_e _operate_type) {
+void Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uint16_t line_width,
+                      colorType_e _color) {
     static uint8_t limit_name[] = "li0";
 
     //右侧车界线绘制
     limit_name[2] = '0';
-    memcpy(data_pack,
-           (uint8_t *) line_drawing(0, _operate_type, center_x + distance, height, center_x + distance + 200,
-                                    height,
-                                    line_width, _color, limit_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(0, ADD_PICTURE, center_x + distance, height, center_x + distance + 200,
+                                             height, line_width, _color, limit_name), UI_PRIORITY_ROBOT_LIMIT);
     limit_name[2] = '1';
-    memcpy(&data_pack[DRAWING_PACK],
-           (uint8_t *) line_drawing(0, _operate_type, center_x + distance + 200, height,
-                                    center_x + distance + 360,
-                                    height - 100, line_width, _color, limit_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(0, ADD_PICTURE, center_x + distance + 200, height,
+                                             center_x + distance + 360, height - 100, line_width, _color,
+                                             limit_name), UI_PRIORITY_ROBOT_LIMIT);
 
     //左侧车界线绘制
     limit_name[2] = '2';
-    memcpy(&data_pack[DRAWING_PACK * 2],
-           (uint8_t *) line_drawing(0, _operate_type, center_x - distance, height, center_x - distance - 200,
-                                    height,
-                                    line_width, _color, limit_name), DRAWING_PACK);
+    referee_ui_set(&referee_ui, line_drawing(0, ADD_PICTURE, center_x - distance, height, center_x - distance - 200,
+                                             height, line_width, _color, limit_name), UI_PRIORITY_ROBOT_LIMIT);
     limit_name[2] = '3';
-    memcpy(&data_pack[DRAWING_PACK * 3],
-           (uint8_t *) line_drawing(0, _operate_type, center_x - distance - 200, height,
-                                    center_x - distance - 360,
-                                    height - 100, line_width, _color, limit_name), DRAWING_PACK);
-
-    //空包
-    limit_name[2] = '4';
-    memcpy(&data_pack[DRAWING_PACK * 4], (uint8_t *) null_drawing(0, limit_name), DRAWING_PACK);
-
-    pack_send_robotData(Drawing_5_ID, (uint8_t *) data_pack, DRAWING_PACK * 5);
+    referee_ui_set(&referee_ui, line_drawing(0, ADD_PICTURE, center_x - distance - 200, height,
+                                             center_x - distance - 360, height - 100, line_width, _color,
+                                             limit_name), UI_PRIORITY_ROBOT_LIMIT);
 }
 
 //void Draw_armer_and_heading(uint16_t height, uint16_t distance, uint16_t center_x,uint16_t center_y, uint16_t line_width,
@@ -1363,9 +941,5 @@ Draw_Robot_Limit(uint16_t height, uint16_t distance, uint16_t center_x, uint16_t
 //           (uint8_t *) line_drawing(0, _operate_type, center_x - distance - 200, height, center_x - distance - 360,
 //                                    height - 100, line_width, _color, limit_name), DRAWING_PACK);
 //
-//    //空包
-//    limit_name[2] = '4';
-//    memcpy(&data_pack[DRAWING_PACK * 4], (uint8_t *) null_drawing(0, limit_name), DRAWING_PACK);
-//
 //    pack_send_robotData(Drawing_5_ID, (uint8_t *) data_pack, DRAWING_PACK * 5);
 //}
\ No newline at end of file
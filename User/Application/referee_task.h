@@ -4,11 +4,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "struct_typedef.h"
-#include "fifo.h"
+#include "spsc_fifo.h"
 #include "cmsis_os.h"
 
 #define USART6_RX_BUF_LENGHT     512
-#define USART6_TX_BUF_LENGHT     128
 #define REFEREE_FIFO_BUF_LENGTH 1024
 
 //装甲板受击bit
@@ -691,24 +690,6 @@ typedef volatile struct {
 #define REF_HEADER_CRC_CMDID_LEN            (REF_PROTOCOL_HEADER_SIZE + REF_PROTOCOL_CRC16_SIZE + REF_PROTOCOL_CMD_SIZE)
 #define REF_HEADER_CMDID_LEN                (REF_PROTOCOL_HEADER_SIZE + REF_PROTOCOL_CMD_SIZE)
 
-
-typedef enum {
-    STEP_HEADER_SOF = 0,
-    STEP_LENGTH_LOW = 1,
-    STEP_LENGTH_HIGH = 2,
-    STEP_FRAME_SEQ = 3,
-    STEP_HEADER_CRC8 = 4,
-    STEP_DATA_CRC16 = 5,
-} unpack_step_e;
-
-typedef struct {
-    std_frame_header_t *p_header;
-    uint16_t data_len;
-    uint8_t protocol_packet[REF_PROTOCOL_FRAME_MAX_SIZE];
-    unpack_step_e unpack_step;
-    uint16_t index;
-} unpack_data_t;
-
 //TX Declare
 #define DRAWING_PACK    15
 /* UI绘制数据包 */
@@ -861,14 +842,20 @@ typedef struct {
 //RX Declare
 extern judge_info_t global_judge_info;
 
-void judge_update(uint8_t *rxBuf);
-
 extern uint8_t get_robot_id(void);
 
 static void referee_unpack_fifo_data(void);
 
 extern void get_chassis_power_and_buffer(float32_t *power, float32_t *buffer);
 
+/**
+  * @brief          读取新的底盘功率和缓冲能量,每个0x0202数据包只返回一次
+  * @param[out]     power: 底盘功率, W
+  * @param[out]     buffer: 缓冲能量, J
+  * @retval         1:有新数据, 0:无新数据,输出不变
+  */
+extern bool_t get_chassis_power_update(float32_t *power, float32_t *buffer);
+
 extern void get_shoot_heat0_limit_and_heat0(uint16_t *heat0_limit, uint16_t *heat0);
 
 extern void init_referee_struct_data(void);
@@ -891,44 +878,17 @@ extern uint32_t get_stack_of_referee_tx_task(void);
   */
 extern uint32_t get_stack_of_referee_rx_task(void);
 
-/**
-  * @brief          获取USART6TX_active_task栈大小
-  * @param[in]      none
-  * @retval         USART6TX_active_task_stack:任务堆栈大小
-  */
-extern uint32_t get_stack_of_USART6TX_active_task(void);
-
-extern volatile uint8_t Referee_No_DMA_IRQHandler;
-extern volatile uint8_t referee_dma_send_data_len;
-extern volatile uint8_t Referee_IRQ_Return_Before;
 extern uint8_t data_pack[DRAWING_PACK * 7];
 extern ext_client_custom_graphic_delete_t cleaning;
 /******declare move frome referee_task.c********/
-extern fifo_s_t referee_rx_fifo;
-extern fifo_s_t referee_tx_len_fifo;
-extern fifo_s_t referee_tx_fifo;
+extern spsc_fifo_t referee_rx_fifo;
 extern uint8_t usart6_rx_buf[2][USART6_RX_BUF_LENGHT];
-extern uint8_t usart6_tx_buf[2][USART6_TX_BUF_LENGHT];
 
 /******declare move frome referee_task.c********/
-static void send_toReferee(uint16_t _cmd_id, uint16_t _data_len);
-
 static void UI_clean_all(void);
 
-extern TaskHandle_t USART6TX_active_task_local_handler;
-
 void USART6_IRQHandler(void);
 
-void DMA2_Stream6_IRQHandler(void);
-
-/**
-  * @brief          usart6发送启动任务，由发送时任务通知激活
-  * @param[in]      pvParameters: 空
-  * @retval         none
-  */
-void USART6TX_active_task(void const *pvParameters);
-
-extern void MY_USART_DMA_Stream6_TX_IRQHandler(void);
 
 
 /**
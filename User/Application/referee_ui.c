@@ -0,0 +1,210 @@
+/**
+  * @file       referee_ui.c/h
+  * @brief      retained-mode client UI with diffing and batched sending.
+  *             带差异比较和批量发送的保留模式客户端UI
+  * @note       a frame carries 1, 2, 5 or 7 graphics (0x0101~0x0104), the smallest
+  *             one holding all picked graphics is used and padded with null
+  *             operations. The budget is a token bucket refilled at
+  *             bytes_per_second and capped at two full frames.
+  *             一帧可携带1/2/5/7个图形(0x0101~0x0104),选用能装下本次图形的最小帧,
+  *             空位填空操作.预算为按bytes_per_second补充的令牌桶,上限为两个满帧
+  */
+#include "referee_ui.h"
+#include <string.h>
+
+#define REFEREE_UI_GRAPHIC_SIZE     sizeof(graphic_data_struct_t)
+#define REFEREE_UI_FRAME_COST(num)  (REFEREE_UI_FRAME_OVERHEAD + (num) * REFEREE_UI_GRAPHIC_SIZE)
+#define REFEREE_UI_BUDGET_MAX       (2U * 1000U * REFEREE_UI_FRAME_COST(REFEREE_UI_BATCH_MAX_NUM))
+
+static referee_ui_slot_t *referee_ui_find(referee_ui_t *p_ui, const uint8_t name[3]) {
+    uint8_t i;
+    for (i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+        if (p_ui->slot[i].state != UI_SLOT_FREE && memcmp(p_ui->slot[i].graphic.graphic_name, name, 3) == 0) {
+            return &p_ui->slot[i];
+        }
+    }
+    return NULL;
+}
+
+static bool_t referee_ui_slot_pending(const referee_ui_slot_t *p_slot) {
+    return p_slot->state >= UI_SLOT_ADD;
+}
+
+/**
+  * @brief          a是否应先于b发送:实际变化先于周期重发,其次优先级,其次等待时间
+  */
+static bool_t referee_ui_slot_before(const referee_ui_slot_t *a, const referee_ui_slot_t *b) {
+    bool_t a_refresh = (a->state == UI_SLOT_REFRESH);
+    bool_t b_refresh = (b->state == UI_SLOT_REFRESH);
+    if (a_refresh != b_refresh) {
+        return b_refresh;
+    }
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return (int32_t) (a->dirty_ms - b->dirty_ms) < 0;
+}
+
+/**
+  * @brief          按发送顺序挑选最多7个待发送图形
+  * @retval         挑选数量
+  */
+static uint8_t referee_ui_pick(referee_ui_t *p_ui, referee_ui_slot_t *p_pick[REFEREE_UI_BATCH_MAX_NUM]) {
+    bool_t picked[REFEREE_UI_GRAPHIC_MAX_NUM] = {0};
+    referee_ui_slot_t *p_best;
+    uint8_t best_index = 0;
+    uint8_t num, i;
+
+    for (num = 0; num < REFEREE_UI_BATCH_MAX_NUM; num++) {
+        p_best = NULL;
+        for (i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+            if (picked[i] || !referee_ui_slot_pending(&p_ui->slot[i])) {
+                continue;
+            }
+            if (p_best == NULL || referee_ui_slot_before(&p_ui->slot[i], p_best)) {
+                p_best = &p_ui->slot[i];
+                best_index = i;
+            }
+        }
+        if (p_best == NULL) {
+            break;
+        }
+        picked[best_index] = 1;
+        p_pick[num] = p_best;
+    }
+    return num;
+}
+
+void referee_ui_init(referee_ui_t *p_ui, referee_ui_send_f send, uint32_t bytes_per_second, uint32_t refresh_ms) {
+    memset(p_ui, 0, sizeof(referee_ui_t));
+    p_ui->send = send;
+    p_ui->bytes_per_second = bytes_per_second;
+    p_ui->refresh_ms = refresh_ms;
+}
+
+int referee_ui_set(referee_ui_t *p_ui, const graphic_data_struct_t *p_graphic, uint8_t priority) {
+    referee_ui_slot_t *p_slot = referee_ui_find(p_ui, p_graphic->graphic_name);
+    graphic_data_struct_t graphic = *p_graphic;
+    uint8_t i;
+
+    graphic.operate_type = NULL_OPERATION;
+    if (p_slot == NULL) {
+        for (i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+            if (p_ui->slot[i].state == UI_SLOT_FREE) {
+                p_slot = &p_ui->slot[i];
+                break;
+            }
+        }
+        if (p_slot == NULL) {
+            return -1;
+        }
+        p_slot->graphic = graphic;
+        p_slot->state = UI_SLOT_ADD;
+        p_slot->priority = priority;
+        p_slot->dirty_ms = p_ui->last_ms;
+        return 0;
+    }
+
+    p_slot->priority = priority;
+    if (p_slot->state == UI_SLOT_DELETE) {
+        //删除尚未发出,客户端仍有旧图形
+        p_slot->graphic = graphic;
+        p_slot->state = UI_SLOT_MODIFY;
+        p_slot->dirty_ms = p_ui->last_ms;
+    } else if (memcmp(&p_slot->graphic, &graphic, REFEREE_UI_GRAPHIC_SIZE) != 0) {
+        p_slot->graphic = graphic;
+        if (p_slot->state == UI_SLOT_SYNCED || p_slot->state == UI_SLOT_REFRESH) {
+            p_slot->state = UI_SLOT_MODIFY;
+            p_slot->dirty_ms = p_ui->last_ms;
+        }
+    }
+    return 0;
+}
+
+void referee_ui_remove(referee_ui_t *p_ui, const uint8_t name[3]) {
+    referee_ui_slot_t *p_slot = referee_ui_find(p_ui, name);
+    if (p_slot == NULL) {
+        return;
+    }
+    if (p_slot->state == UI_SLOT_ADD) {
+        p_slot->state = UI_SLOT_FREE;
+    } else if (p_slot->state != UI_SLOT_DELETE) {
+        p_slot->state = UI_SLOT_DELETE;
+        p_slot->dirty_ms = p_ui->last_ms;
+    }
+}
+
+void referee_ui_invalidate(referee_ui_t *p_ui) {
+    uint8_t i;
+    for (i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+        if (p_ui->slot[i].state == UI_SLOT_DELETE) {
+            p_ui->slot[i].state = UI_SLOT_FREE;
+        } else if (p_ui->slot[i].state != UI_SLOT_FREE) {
+            p_ui->slot[i].state = UI_SLOT_ADD;
+            p_ui->slot[i].dirty_ms = p_ui->last_ms;
+        }
+    }
+}
+
+uint8_t referee_ui_flush(referee_ui_t *p_ui, uint32_t now_ms) {
+    static const uint16_t data_cmd_id[REFEREE_UI_BATCH_MAX_NUM + 1] = {
+            0, Drawing_1_ID, Drawing_2_ID, Drawing_5_ID, Drawing_5_ID, Drawing_5_ID, Drawing_7_ID, Drawing_7_ID};
+    static const uint8_t frame_num[REFEREE_UI_BATCH_MAX_NUM + 1] = {0, 1, 2, 5, 5, 5, 7, 7};
+    referee_ui_slot_t *p_pick[REFEREE_UI_BATCH_MAX_NUM];
+    graphic_data_struct_t *p_pack = (graphic_data_struct_t *) p_ui->pack;
+    uint32_t dt_ms = now_ms - p_ui->last_ms;
+    uint32_t cost;
+    uint8_t num, i;
+    uint8_t frame_sent = 0;
+
+    //补充预算,长时间未调用时最多补1s
+    if (dt_ms > 1000U) {
+        dt_ms = 1000U;
+    }
+    p_ui->budget += p_ui->bytes_per_second * dt_ms;
+    if (p_ui->budget > REFEREE_UI_BUDGET_MAX) {
+        p_ui->budget = REFEREE_UI_BUDGET_MAX;
+    }
+    p_ui->last_ms = now_ms;
+
+    if (p_ui->refresh_ms) {
+        for (i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+            if (p_ui->slot[i].state == UI_SLOT_SYNCED && now_ms - p_ui->slot[i].sent_ms >= p_ui->refresh_ms) {
+                p_ui->slot[i].state = UI_SLOT_REFRESH;
+                p_ui->slot[i].dirty_ms = now_ms;
+            }
+        }
+    }
+
+    while ((num = referee_ui_pick(p_ui, p_pick)) != 0U) {
+        cost = REFEREE_UI_FRAME_COST(frame_num[num]);
+        if (p_ui->budget < cost * 1000U) {
+            break;
+        }
+        memset(p_ui->pack, 0, sizeof(p_ui->pack));
+        for (i = 0; i < num; i++) {
+            p_pack[i] = p_pick[i]->graphic;
+            if (p_pick[i]->state == UI_SLOT_MODIFY) {
+                p_pack[i].operate_type = MODIFY_PICTURE;
+            } else if (p_pick[i]->state == UI_SLOT_DELETE) {
+                p_pack[i].operate_type = CLEAR_PICTURE;
+            } else {
+                p_pack[i].operate_type = ADD_PICTURE;
+            }
+        }
+        //没有进入发送队列的图形保持原状态,下次重发
+        if (p_ui->send(data_cmd_id[num], p_ui->pack, frame_num[num] * REFEREE_UI_GRAPHIC_SIZE) != 0) {
+            p_ui->drop_cnt++;
+            break;
+        }
+        for (i = 0; i < num; i++) {
+            p_pick[i]->state = (p_pick[i]->state == UI_SLOT_DELETE) ? UI_SLOT_FREE : UI_SLOT_SYNCED;
+            p_pick[i]->sent_ms = now_ms;
+        }
+        p_ui->budget -= cost * 1000U;
+        p_ui->sent_bytes += cost;
+        p_ui->frame_cnt++;
+        frame_sent++;
+    }
+    return frame_sent;
+}
@@ -0,0 +1,117 @@
+/**
+  * @file       referee_ui.c/h
+  * @brief      retained-mode client UI. Callers declare the graphics they want on
+  *             screen every cycle, the layer keeps a shadow copy of each graphic and
+  *             only sends add/modify/delete diffs, packing up to 7 graphics per
+  *             0x0104 frame in priority order within a bytes-per-second budget.
+  *             保留模式客户端UI:调用者每周期声明期望显示的图形,本层保存每个图形的影子
+  *             副本,只发送新增/修改/删除的差异,按优先级在字节/秒预算内每帧最多打包7个图形
+  * @note       graphics are indexed by their 3-byte name like the client does.
+  *             Synced graphics are re-added every refresh_ms at the lowest priority
+  *             to recover from frames dropped by the client.
+  *             图形与客户端一样以3字节名称为索引.已同步的图形每refresh_ms以最低优先级
+  *             重新发送新增操作,补偿客户端丢包
+  */
+#ifndef REFEREE_UI_H
+#define REFEREE_UI_H
+
+#include "struct_typedef.h"
+#include "referee_task.h"
+
+#define REFEREE_UI_GRAPHIC_MAX_NUM  32
+#define REFEREE_UI_BATCH_MAX_NUM    7
+//交互数据帧中图形以外的字节数:帧头 + 命令码 + 交互数据段首 + CRC16
+#define REFEREE_UI_FRAME_OVERHEAD   (LEN_FRAME_HEAD + LEN_CMD_ID + sizeof(ext_student_interactive_header_data_t) + LEN_FRAME_TAIL)
+
+/**
+  * @brief          发送一帧图形数据
+  * @param[in]      data_cmd_id: 数据段内容ID,0x0101/0x0102/0x0103/0x0104
+  * @param[in]      p_data: 图形数组
+  * @param[in]      data_len: 图形数组字节数
+  * @retval         0:已进入发送队列 -1:丢弃(帧缓存耗尽等)
+  */
+typedef int (*referee_ui_send_f)(uint16_t data_cmd_id, uint8_t *p_data, uint16_t data_len);
+
+typedef enum {
+    UI_SLOT_FREE = 0,
+    UI_SLOT_SYNCED,     //客户端与目标一致
+    UI_SLOT_ADD,        //客户端尚无该图形,待新增
+    UI_SLOT_MODIFY,     //客户端图形与目标不一致,待修改
+    UI_SLOT_DELETE,     //待删除
+    UI_SLOT_REFRESH,    //周期重发,优先级低于所有实际变化
+} referee_ui_slot_state_e;
+
+typedef struct {
+    graphic_data_struct_t graphic;  //目标图形,operate_type在发送时按状态填写
+    uint8_t state;
+    uint8_t priority;               //数值越小越先发送
+    uint32_t dirty_ms;              //进入待发送状态的时间,同优先级先到先发
+    uint32_t sent_ms;               //最近一次发送时间
+} referee_ui_slot_t;
+
+typedef struct {
+    referee_ui_slot_t slot[REFEREE_UI_GRAPHIC_MAX_NUM];
+    referee_ui_send_f send;
+    uint32_t bytes_per_second;      //带宽预算
+    uint32_t refresh_ms;            //已同步图形的重发周期,0不重发
+    uint32_t budget;                //可用预算,单位0.001字节
+    uint32_t last_ms;
+    uint32_t sent_bytes;            //累计发送字节数(调试时使用)
+    uint32_t frame_cnt;             //累计发送帧数(调试时使用)
+    uint32_t drop_cnt;              //发送函数丢弃的帧数,图形保持待发送(调试时使用)
+    uint8_t pack[REFEREE_UI_BATCH_MAX_NUM * sizeof(graphic_data_struct_t)];
+} referee_ui_t;
+
+/**
+  * @brief          init the ui layer
+  * @param[out]     p_ui: ui layer
+  * @param[in]      send: frame sender
+  * @param[in]      bytes_per_second: bandwidth budget
+  * @param[in]      refresh_ms: re-add period of synced graphics, 0 to disable
+  * @retval         none
+  */
+/**
+  * @brief          初始化UI层
+  * @param[out]     p_ui: UI层
+  * @param[in]      send: 帧发送函数
+  * @param[in]      bytes_per_second: 带宽预算
+  * @param[in]      refresh_ms: 已同步图形的重发周期,0不重发
+  * @retval         none
+  */
+extern void referee_ui_init(referee_ui_t *p_ui, referee_ui_send_f send, uint32_t bytes_per_second,
+                            uint32_t refresh_ms);
+
+/**
+  * @brief          声明图形的目标状态,与已发送内容相同时不产生发送
+  * @param[in]      p_graphic: 目标图形,operate_type被忽略
+  * @param[in]      priority: 优先级,数值越小越先发送
+  * @retval         0:成功, -1:图形数已满
+  */
+extern int referee_ui_set(referee_ui_t *p_ui, const graphic_data_struct_t *p_graphic, uint8_t priority);
+
+/**
+  * @brief          删除图形,客户端尚未显示时直接丢弃
+  * @param[in]      name: 3字节图形名
+  */
+extern void referee_ui_remove(referee_ui_t *p_ui, const uint8_t name[3]);
+
+/**
+  * @brief          客户端图形已全部清除(删除所有或客户端重连)后调用,全部图形重新新增
+  */
+extern void referee_ui_invalidate(referee_ui_t *p_ui);
+
+/**
+  * @brief          send pending diffs within the budget, highest priority first
+  * @param[in]      p_ui: ui layer
+  * @param[in]      now_ms: current time
+  * @retval         frames sent, stops at the first frame the send function drops
+  */
+/**
+  * @brief          在预算内按优先级发送待发送的差异
+  * @param[in]      p_ui: UI层
+  * @param[in]      now_ms: 当前时间
+  * @retval         本次发送的帧数,发送函数丢弃一帧时停止,图形保持待发送
+  */
+extern uint8_t referee_ui_flush(referee_ui_t *p_ui, uint32_t now_ms);
+
+#endif
@@ -89,6 +89,7 @@ void shoot_init(void) {
     static const float32_t Trigger_angle_pid[3] = {TRIGGER_ANGLE_PID_KP, TRIGGER_ANGLE_PID_KI, TRIGGER_ANGLE_PID_KD};
     static const float32_t fric1_speed_pid[3] = {500, 0, 0};
     static const float32_t fric2_speed_pid[3] = {500, 0, 0};
+    const pid_type_def *const fric_lane[2] = {&shoot_control.fric1_motor_pid, &shoot_control.fric2_motor_pid};
     shoot_control.shoot_mode = SHOOT_STOP;
     //遥控器指针
     shoot_control.shoot_rc = get_remote_control_point();
@@ -109,6 +110,7 @@ void shoot_init(void) {
              TRIGGER_READY_PID_MAX_IOUT, 1000, 0, 0, 0, 0, 0, 1, 0.003f, 0, 0, 0, 0, 0);
     PID_init(&shoot_control.fric2_motor_pid, PID_POSITION, fric2_speed_pid, TRIGGER_READY_PID_MAX_OUT,
              TRIGGER_READY_PID_MAX_IOUT, 1000, 0, 0, 0, 0, 0, 1, 0.003f, 0, 0, 0, 0, 0);
+    pid_batch_init(&shoot_control.fric_motor_batch, fric_lane, 2);
 //    shoot_control.pwm = SHOOT_FRIC_PWM_ADD_VALUE;
     KalmanCreate(&shoot_control.Trigger_Motor_Current_Kalman_Filter, 10.0f, 0.5f);
     //更新数据
@@ -145,6 +147,7 @@ void shoot_init(void) {
   * @retval         返回can控制值
   */
 int16_t shoot_control_loop(void) {
+    float32_t fric_speed[2], fric_speed_set[2];
 
     shoot_set_mode();        //设置状态机
     shoot_feedback_update(); //更新数据
@@ -233,10 +236,13 @@ int16_t shoot_control_loop(void) {
 //        ramp_calc(&shoot_control.fric2_ramp, shoot_control.pwm);
 //        gimbal_control.fric1_current_set = Cloud_IPID(&shoot_control.fric1_motor_pid, shoot_control.fric1_speed,
 //                                                      shoot_control.fric1_speed_set);
-            gimbal_control.fric1_current_set = ALL_PID(&shoot_control.fric1_motor_pid, shoot_control.fric1_speed,
-                                                       shoot_control.fric1_speed_set);
-            gimbal_control.fric2_current_set = ALL_PID(&shoot_control.fric2_motor_pid, shoot_control.fric2_speed,
-                                                       shoot_control.fric2_speed_set);
+            fric_speed[0] = shoot_control.fric1_speed;
+            fric_speed[1] = shoot_control.fric2_speed;
+            fric_speed_set[0] = shoot_control.fric1_speed_set;
+            fric_speed_set[1] = shoot_control.fric2_speed_set;
+            pid_batch_calc(&shoot_control.fric_motor_batch, fric_speed, fric_speed_set);
+            gimbal_control.fric1_current_set = shoot_control.fric_motor_batch.out[0];
+            gimbal_control.fric2_current_set = shoot_control.fric_motor_batch.out[1];
 
         }
     }
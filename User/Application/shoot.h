@@ -24,6 +24,7 @@
 #include "gimbal_task.h"
 #include "remote_control.h"
 #include "user_lib.h"
+#include "pid_batch.h"
 
 
 
@@ -135,6 +136,7 @@ typedef struct {
 
     pid_type_def fric1_motor_pid;
     pid_type_def fric2_motor_pid;
+    pid_batch_t fric_motor_batch;               //两个摩擦轮速度环合并计算, 增益取自fric1/fric2_motor_pid
 
     float32_t fric_all_speed;
     float32_t fric1_speed_set;
@@ -3,16 +3,7 @@
 #include "stdint.h"
 #include "stdbool.h"
 
-typedef signed char int8_t;
-typedef signed short int int16_t;
-//typedef signed int int32_t;
-typedef signed long long int64_t;
-
-/* exact-width unsigned integer types */
-typedef unsigned char uint8_t;
-typedef unsigned short int uint16_t;
-//typedef unsigned int uint32_t;
-typedef unsigned long long uint64_t;
+/* exact-width integer types come from stdint.h, int64_t is not long long on every host */
 typedef unsigned char bool_t;
 typedef float float32_t;
 typedef double float64_t;
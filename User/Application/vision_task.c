@@ -2,12 +2,14 @@
 // Created by Ken_n on 2022/4/18.
 //
 #include <stdlib.h>
+#include <stddef.h>
 #include "vision_task.h"
 #include "CRC8_CRC16.h"
 #include "usart.h"
 #include "bsp_usart.h"
 #include "detect_task.h"
-#include "fifo.h"
+#include "spsc_fifo.h"
+#include "frame_parser.h"
 #include "cmsis_os.h"
 #include "SEGGER_RTT.h"
 #include "global_control_define.h"
@@ -15,28 +17,136 @@
 #include "matlab_sync_task.h"
 #include "print_task.h"
 #include "DWT.h"
+#include "INS_task.h"
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
 uint32_t vision_rx_task_stack;
 uint32_t vision_tx_task_stack;
-uint32_t USART1TX_active_task_stack;
+#endif
+
+#if (VISION_FIFO_BUF_LENGTH & (VISION_FIFO_BUF_LENGTH - 1)) != 0
+#error "VISION_FIFO_BUF_LENGTH must be a power of two"
 #endif
 
 uint8_t vision_fifo_rx_buf[VISION_FIFO_BUF_LENGTH];
-uint8_t vision_fifo_tx_len_buf[VISION_FIFO_BUF_LENGTH];
-uint8_t vision_fifo_tx_buf[VISION_FIFO_BUF_LENGTH];
-fifo_s_t vision_rx_fifo;
-fifo_s_t vision_tx_len_fifo;
-fifo_s_t vision_tx_fifo;
+spsc_fifo_t vision_rx_fifo;
 uint8_t usart1_rx_buf[2][USART1_RX_BUF_LENGHT];
-uint8_t usart1_vision_tx_buf[2][USART1_VISION_TX_BUF_LENGHT];
-TaskHandle_t USART1TX_active_task_local_handler;
 TaskHandle_t vision_rx_task_local_handler;
-volatile uint8_t Vision_No_DMA_IRQHandler = 1;
-volatile uint8_t vision_dma_send_data_len = 0;
-volatile uint8_t Vision_IRQ_Return_Before = 0;
 vision_unpack_data_t vision_unpack_obj;
+frame_parser_t vision_parser;
 vision_info_t global_vision_info;
+static volatile uint32_t vision_rx_tick; //最近一次串口空闲中断的DWT计数
+
+//空闲中断片段: 写入后队列的累计写入字节数和中断时刻, 中断写入, vision_rx_task读取
+typedef struct {
+    uint32_t end;
+    uint32_t tick;
+} vision_rx_chunk_t;
+static vision_rx_chunk_t vision_rx_chunk[VISION_RX_CHUNK_NUM];
+static volatile uint32_t vision_rx_chunk_head;
+static volatile uint32_t vision_rx_chunk_tail;
+uint32_t vision_rx_chunk_lost_cnt; //片段记录已满时丢弃的片段数
+
+/**
+  * @brief          put one IDLE chunk into the rx fifo and latch its receive tick
+  * @param[in]      p_data: chunk
+  * @param[in]      len: chunk length
+  * @retval         none
+  */
+/**
+  * @brief          把一个空闲中断片段写入接收队列并记录其接收时刻
+  * @param[in]      p_data: 片段
+  * @param[in]      len: 片段长度
+  * @retval         none
+  */
+static void vision_rx_chunk_put(const uint8_t *p_data, uint16_t len) {
+    uint32_t tick = DWT_get_tick();
+    uint32_t head = vision_rx_chunk_head;
+
+    spsc_fifo_puts(&vision_rx_fifo, p_data, len);
+    vision_rx_tick = tick;
+    if (head - __atomic_load_n(&vision_rx_chunk_tail, __ATOMIC_ACQUIRE) >= VISION_RX_CHUNK_NUM) {
+        vision_rx_chunk_lost_cnt++;
+        return;
+    }
+    vision_rx_chunk[head % VISION_RX_CHUNK_NUM].end = vision_rx_fifo.head;
+    vision_rx_chunk[head % VISION_RX_CHUNK_NUM].tick = tick;
+    __atomic_store_n(&vision_rx_chunk_head, head + 1U, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief          receive tick of the chunk that holds the first byte of a frame
+  * @param[in]      frame_start: fifo read count at the frame start
+  * @param[out]     rx_len: bytes of the chunk from the frame start to the chunk end
+  * @retval         IDLE interrupt tick, DWT tick
+  */
+/**
+  * @brief          帧第一个字节所在片段的接收时刻
+  * @param[in]      frame_start: 帧起始对应的队列累计读出字节数
+  * @param[out]     rx_len: 片段中从帧起始到片段末尾的字节数
+  * @retval         空闲中断时刻, DWT计数
+  */
+static uint32_t vision_rx_chunk_tick(uint32_t frame_start, uint32_t *rx_len) {
+    uint32_t head = __atomic_load_n(&vision_rx_chunk_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = vision_rx_chunk_tail;
+
+    //丢弃帧起始之前已经结束的片段
+    while (tail != head && (int32_t) (vision_rx_chunk[tail % VISION_RX_CHUNK_NUM].end - frame_start) <= 0) {
+        tail++;
+    }
+    __atomic_store_n(&vision_rx_chunk_tail, tail, __ATOMIC_RELEASE);
+    if (tail == head) {
+        //片段记录溢出,退回最近一次中断时刻
+        *rx_len = vision_rx_fifo.head - frame_start;
+        return vision_rx_tick;
+    }
+    *rx_len = vision_rx_chunk[tail % VISION_RX_CHUNK_NUM].end - frame_start;
+    return vision_rx_chunk[tail % VISION_RX_CHUNK_NUM].tick;
+}
+
+/**
+  * @brief          每个校验通过的视觉帧,保存帧头信息并推算拍摄时刻
+  * @note           空闲中断在片段最后一个字节后再过一个字节时间触发,帧开始发送时刻 = 帧第一个字节所在片段的
+  *                 中断时刻 - 片段中从帧起始到末尾的字节和空闲字节的传输时间,拍摄时刻再减去帧中的拍摄到发送延迟.
+  *                 帧中途停顿被分为两个片段时也以第一个片段为准.分发在丢弃队列数据之前,帧起始为队列tail.
+  *                 在数据段拷贝到vision_control之前调用,update_flag置位时capture_tick已经有效
+  */
+static void vision_frame_update(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    uint16_t data_len = frame_len - sizeof(vision_frame_header) - sizeof(vision_frame_tail);
+    uint32_t latency_us = VISION_DEFAULT_LATENCY_US;
+    uint32_t rx_len;
+    uint32_t rx_tick = vision_rx_chunk_tick(vision_rx_fifo.tail, &rx_len);
+    uint32_t transfer_us = (uint32_t) ((rx_len + 1U) * 10U * 1000000ULL / huart1.Init.BaudRate);
+
+    memcpy(&vision_unpack_obj.frame, p_frame,
+           (frame_len < sizeof(vision_sync_struct)) ? frame_len : sizeof(vision_sync_struct));
+    vision_unpack_obj.data_valid = true;
+    if (data_len >= offsetof(vision_frame_data, data4) + sizeof(uint32_t)) {
+        memcpy(&latency_us, p_frame + sizeof(vision_frame_header) + offsetof(vision_frame_data, data4),
+               sizeof(uint32_t));
+    }
+    //旧协议帧不带距离,拷贝不会覆盖该字段,先清零
+    if (data_len < sizeof(vision_frame_data)) {
+        global_vision_info.vision_control.distance = 0.0f;
+    }
+    global_vision_info.vision_control.capture_tick = rx_tick - DWT_us_to_tick(latency_us + transfer_us);
+}
+
+/* 视觉协议无命令码,所有帧按命令码0分发,数据段拷贝到vision_control */
+static const frame_cmd_t vision_cmd_table[] = {
+        {0, sizeof(vision_frame_data), &global_vision_info.vision_control, &global_vision_info.vision_control.update_flag,
+         NULL},
+};
+
+static const frame_protocol_t vision_protocol = {
+        .sof = VISION_HEADER_SOF,
+        .header_len = sizeof(vision_frame_header),
+        .len_offset = offsetof(vision_frame_header, data_len),
+        .len_size = 1,
+        .header_crc8 = 0,
+        .cmd_id_size = 0,
+        .max_frame_len = Vision_PROTOCOL_FRAME_MAX_SIZE,
+};
 
 /**
   * @brief          视觉接收任务
@@ -46,7 +156,12 @@ vision_info_t global_vision_info;
 void vision_rx_task(void const *argument) {
     init_vision_struct_data();
     vision_rx_task_local_handler = xTaskGetCurrentTaskHandle();
-    fifo_s_init(&vision_rx_fifo, vision_fifo_rx_buf, VISION_FIFO_BUF_LENGTH);
+    if (spsc_fifo_init(&vision_rx_fifo, vision_fifo_rx_buf, VISION_FIFO_BUF_LENGTH) != 0) {
+        Error_Handler();
+    }
+    frame_parser_init(&vision_parser, &vision_protocol, vision_cmd_table,
+                      sizeof(vision_cmd_table) / sizeof(vision_cmd_table[0]), vision_frame_update,
+                      vision_unpack_obj.protocol_packet);
     usart1_rx_init(usart1_rx_buf[0], usart1_rx_buf[1], USART1_RX_BUF_LENGHT);
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_vision_rx_task);
@@ -66,9 +181,7 @@ void vision_rx_task(void const *argument) {
   */
 void vision_tx_task(void const *argument) {
 //    init_referee_struct_data();
-    fifo_s_init(&vision_tx_len_fifo, vision_fifo_tx_len_buf, VISION_FIFO_BUF_LENGTH);
-    fifo_s_init(&vision_tx_fifo, vision_fifo_tx_buf, VISION_FIFO_BUF_LENGTH);
-    usart1_tx_init(usart1_vision_tx_buf[0], usart1_vision_tx_buf[1], USART1_VISION_TX_BUF_LENGHT);
+    usart1_tx_init();
     TickType_t LoopStartTime;
     while (1) {
         DWT_get_time_interval_us(&global_task_time.tim_vision_tx_task);
@@ -100,98 +213,55 @@ uint32_t get_stack_of_vision_rx_task(void) {
 }
 
 /**
-  * @brief          获取USART1TX_active_task栈大小
-  * @param[in]      none
-  * @retval         USART1TX_active_task_stack:任务堆栈大小
-  */
-uint32_t get_stack_of_USART1TX_active_task(void) {
-    return USART1TX_active_task_stack;
-}
-
-/**
-  * @brief          single byte upacked
+  * @brief          unpack the vision frames in the rx fifo
   * @param[in]      void
   * @retval         none
   */
 /**
-  * @brief          单字节解包
+  * @brief          解析接收队列中的视觉数据帧
   * @param[in]      void
   * @retval         none
   */
 void vision_unpack_fifo_data(void) {
-    uint8_t byte = 0;
-    vision_unpack_data_t *p_obj = &vision_unpack_obj;
-    while (fifo_s_used(&vision_rx_fifo)) {
-        byte = fifo_s_get(&vision_rx_fifo);
-        switch (p_obj->unpack_step) {
-            case VISION_STEP_HEADER_SOF: {
-                if (byte == VISION_HEADER_SOF) {
-//                    SEGGER_RTT_printf(0,"head=%d,sep=%d,end=%d\r\n",p_obj->head_sof_cnt,p_obj->separate_sof_cnt,p_obj->end_sof_cnt);
-                    p_obj->protocol_packet[p_obj->index++] = byte;
-                    if (fifo_s_preread(&vision_rx_fifo, 0) != VISION_HEADER_SOF) {
-                        p_obj->unpack_step = VISION_STEP_LEN;
-                    } else {
-                        p_obj->index = 0;
-                    }
-                } else {
-                    p_obj->index = 0;
-                }
-            }
-                break;
-
-            case VISION_STEP_LEN: {
-//                SEGGER_RTT_WriteString(0, "have_date1\r\n");
-                p_obj->frame.header.data_len = byte;
-                p_obj->protocol_packet[p_obj->index++] = byte;
-                p_obj->unpack_step = VISION_STEP_FRAME_CRC16;
-            }
-                break;
-            case VISION_STEP_FRAME_CRC16: {
-//                SEGGER_RTT_WriteString(0, "have_date2\r\n");
-                if (p_obj->index < (sizeof(vision_sync_struct))) {
-                    p_obj->protocol_packet[p_obj->index++] = byte;
-                }
-                if (p_obj->index >= (sizeof(vision_sync_struct))) {
-                    p_obj->unpack_step = VISION_STEP_HEADER_SOF;
-                    p_obj->index = 0;
-                }
-                if (verify_CRC16_check_sum(p_obj->protocol_packet,
-                                           (sizeof(vision_sync_struct)))) {
-                    vision_update(p_obj->protocol_packet);
-                }
-                break;
-
-                default: {
-                    p_obj->unpack_step = VISION_STEP_HEADER_SOF;
-                    p_obj->index = 0;
-                }
-                break;
-            }
-        }
+    uint32_t last_err_cnt = vision_parser.err_cnt;
+    frame_parser_unpack_fifo(&vision_parser, &vision_rx_fifo);
+    if (vision_parser.err_cnt != last_err_cnt) {
+        vision_unpack_obj.data_valid = false;
     }
 }
 
-void vision_update(uint8_t *rxBuf) {
-    uint8_t res = false;
-    vision_info_t *vision_info = &global_vision_info;
-    vision_info->pack_info = &vision_unpack_obj;
-    if (rxBuf[0] == VISION_HEADER_SOF) {
-        if (verify_CRC16_check_sum(rxBuf, (sizeof(vision_frame_header) + vision_info->pack_info->frame.header.data_len +
-                                           sizeof(vision_frame_tail))) == true) {
-            res = true;
-            memcpy(&global_vision_info.vision_control, (rxBuf + sizeof(vision_frame_header)),
-                   vision_info->pack_info->frame.header.data_len);
-            global_vision_info.vision_control.update_flag = 1;
-        }
-        if (rxBuf[sizeof(vision_sync_struct)] == VISION_HEADER_SOF) {
-            vision_update(&rxBuf[sizeof(vision_sync_struct)]);
-        }
+/**
+  * @brief          direction of the vision target in the world (INS) frame: the attitude at
+  *                 capture time plus the vision offset
+  * @param[out]     capture_tick: capture time, DWT tick
+  * @param[out]     target: yaw, pitch, rad
+  * @retval         1: valid, 0: capture time outside the attitude history
+  */
+/**
+  * @brief          视觉目标在世界(INS)坐标系下的方向:拍摄时刻的姿态加上视觉偏差
+  * @param[out]     capture_tick: 拍摄时刻, DWT计数
+  * @param[out]     target: yaw, pitch, rad
+  * @retval         1:有效, 0:拍摄时刻超出姿态历史
+  */
+bool_t get_vision_target_world(uint32_t *capture_tick, float32_t target[2]) {
+    float32_t capture_angle[3];
+#if VISION_LATENCY_COMPENSATE
+    uint32_t tick = global_vision_info.vision_control.capture_tick;
+#else
+    //不补偿延迟时视为当前时刻拍摄
+    uint32_t tick = DWT_get_tick();
+#endif
 
+    if (get_INS_angle_at(tick, capture_angle) == ATTITUDE_HISTORY_MISS) {
+        global_vision_info.history_miss_cnt++;
+        return 0;
     }
-    vision_info->pack_info->data_valid = res;
+    target[0] = capture_angle[0] + global_vision_info.vision_control.yaw_angle;
+    target[1] = capture_angle[1] + global_vision_info.vision_control.pitch_angle;
+    *capture_tick = tick;
+    return 1;
 }
 
-
 /**
   * @brief          获取视觉数据指针
   * @param[in]      none
@@ -208,6 +278,7 @@ const volatile vision_control_t *get_vision_control_point(void) {
   */
 void init_vision_struct_data(void) {
     memset(&global_vision_info, 0, sizeof(vision_info_t));
+    global_vision_info.pack_info = &vision_unpack_obj;
     global_vision_info.vision_control.fps = 30;
     global_vision_info.state = VISION_ON;
 }
@@ -216,179 +287,6 @@ void clear_vision_update_flag(void) {
     global_vision_info.vision_control.update_flag = 0;
 }
 
-/**
-  * @brief          usart1发送启动任务，由发送时任务通知激活
-  * @param[in]      pvParameters: 空
-  * @retval         none
-  */
-void USART1TX_active_task(void const *pvParameters) {
-    USART1TX_active_task_local_handler = xTaskGetCurrentTaskHandle();
-    while (1) {
-        while (ulTaskNotifyTake(pdFALSE, portMAX_DELAY) != pdPASS) {
-        }
-        vTaskSuspendAll();
-        if (UART1_TARGET_MODE == Vision_MODE) {
-            if (Vision_No_DMA_IRQHandler || Vision_IRQ_Return_Before) {
-                if (fifo_s_used(&vision_tx_fifo)) {
-                    if (fifo_s_used(&vision_tx_len_fifo)) {
-                        if ((huart1.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-//                    SEGGER_RTT_WriteString(0, "ST0DMA_1\r\n");
-                            __HAL_DMA_DISABLE(huart1.hdmatx);
-                            vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                            if (vision_dma_send_data_len > 1) {
-                                Vision_IRQ_Return_Before = 0;
-                            }
-                            memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-                            fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[1], vision_dma_send_data_len);
-                            huart1.hdmatx->Instance->CR |= DMA_SxCR_CT;
-                            __HAL_DMA_SET_COUNTER(huart1.hdmatx, vision_dma_send_data_len);
-                            __HAL_DMA_ENABLE(huart1.hdmatx);
-                            Vision_No_DMA_IRQHandler = 0;
-                            vision_dma_send_data_len = 0;
-                            detect_hook(USART1_TX_TOE);
-                            taskENTER_CRITICAL();
-                            if (!Vision_IRQ_Return_Before) {
-                                if (fifo_s_used(&vision_tx_fifo)) {
-                                    if (fifo_s_used(&vision_tx_len_fifo)) {
-                                        vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                                        memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-                                        fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[0],
-                                                    vision_dma_send_data_len);
-                                    }
-                                } else {
-                                    vision_dma_send_data_len = 0;
-                                    Vision_No_DMA_IRQHandler = 1;
-                                    memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-                                }
-                            }
-                            taskEXIT_CRITICAL();
-                        } else {
-//                    SEGGER_RTT_WriteString(0, "ST0DMA_0\r\n");
-                            __HAL_DMA_DISABLE(huart1.hdmatx);
-                            vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                            if (vision_dma_send_data_len > 1) {
-                                Vision_IRQ_Return_Before = 0;
-                            }
-                            memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-                            fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[0], vision_dma_send_data_len);
-                            huart1.hdmatx->Instance->CR &= ~(DMA_SxCR_CT);
-                            __HAL_DMA_SET_COUNTER(huart1.hdmatx, vision_dma_send_data_len);
-                            __HAL_DMA_ENABLE(huart1.hdmatx);
-                            Vision_No_DMA_IRQHandler = 0;
-                            vision_dma_send_data_len = 0;
-                            detect_hook(USART1_TX_TOE);
-                            taskENTER_CRITICAL();
-                            if (!Vision_IRQ_Return_Before) {
-                                if (fifo_s_used(&vision_tx_fifo)) {
-                                    if (fifo_s_used(&vision_tx_len_fifo)) {
-                                        vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                                        memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-                                        fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[1],
-                                                    vision_dma_send_data_len);
-                                    }
-                                } else {
-                                    vision_dma_send_data_len = 0;
-                                    Vision_No_DMA_IRQHandler = 1;
-                                    memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-                                }
-                            }
-                            taskEXIT_CRITICAL();
-#if INCLUDE_uxTaskGetStackHighWaterMark
-                            USART1TX_active_task_stack = uxTaskGetStackHighWaterMark(NULL);
-#endif
-                        }
-                    }
-                }
-            }
-        } else if (UART1_TARGET_MODE == Matlab_MODE) {
-            if (Matlab_No_DMA_IRQHandler || Matlab_IRQ_Return_Before) {
-                if (fifo_s_used(&matlab_tx_fifo)) {
-                    if (fifo_s_used(&matlab_tx_len_fifo)) {
-                        if ((huart1.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-//                            SEGGER_RTT_WriteString(0, "ST0DMA_1\r\n");
-                            __HAL_DMA_DISABLE(huart1.hdmatx);
-                            matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                            if (matlab_dma_send_data_len > 1) {
-                                Matlab_IRQ_Return_Before = 0;
-                            }
-                            memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                            fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[1], matlab_dma_send_data_len);
-//                            SEGGER_RTT_printf(0, "2len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                            SEGGER_RTT_printf(0, "2fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                            huart1.hdmatx->Instance->CR |= DMA_SxCR_CT;
-                            __HAL_DMA_SET_COUNTER(huart1.hdmatx, matlab_dma_send_data_len);
-                            __HAL_DMA_ENABLE(huart1.hdmatx);
-                            Matlab_No_DMA_IRQHandler = 0;
-                            matlab_dma_send_data_len = 0;
-                            detect_hook(USART1_TX_TOE);
-                            taskENTER_CRITICAL();
-                            if (!Matlab_IRQ_Return_Before) {
-                                if (fifo_s_used(&matlab_tx_fifo)) {
-                                    if (fifo_s_used(&matlab_tx_len_fifo)) {
-//                                        SEGGER_RTT_printf(0, "3len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                                        SEGGER_RTT_printf(0, "3fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                                        matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                                        memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                                        fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[0],
-                                                    matlab_dma_send_data_len);
-                                    }
-                                } else {
-//                                    SEGGER_RTT_WriteString(0, "in_else\r\n");
-                                    matlab_dma_send_data_len = 0;
-                                    Matlab_No_DMA_IRQHandler = 1;
-                                    memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                                }
-                            }
-                            taskEXIT_CRITICAL();
-                        } else {
-//                            SEGGER_RTT_WriteString(0, "ST0DMA_0\r\n");
-                            __HAL_DMA_DISABLE(huart1.hdmatx);
-                            matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                            if (matlab_dma_send_data_len > 1) {
-                                Matlab_IRQ_Return_Before = 0;
-                            }
-                            memset(&usart1_matlab_tx_buf[0], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                            fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[0], matlab_dma_send_data_len);
-//                            SEGGER_RTT_printf(0, "2len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                            SEGGER_RTT_printf(0, "2fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                            huart1.hdmatx->Instance->CR &= ~(DMA_SxCR_CT);
-                            __HAL_DMA_SET_COUNTER(huart1.hdmatx, matlab_dma_send_data_len);
-                            __HAL_DMA_ENABLE(huart1.hdmatx);
-                            Matlab_No_DMA_IRQHandler = 0;
-                            matlab_dma_send_data_len = 0;
-                            detect_hook(USART1_TX_TOE);
-                            taskENTER_CRITICAL();
-//                            SEGGER_RTT_printf(0, "return0=%d\r\n", Matlab_IRQ_Return_Before);
-                            if (!Matlab_IRQ_Return_Before) {
-                                if (fifo_s_used(&matlab_tx_fifo)) {
-                                    if (fifo_s_used(&matlab_tx_len_fifo)) {
-//                                        SEGGER_RTT_printf(0, "3len_fifo=%d\r\n", fifo_s_used(&matlab_tx_len_fifo));
-//                                        SEGGER_RTT_printf(0, "3fifo=%d\r\n", fifo_s_used(&matlab_tx_fifo));
-                                        matlab_dma_send_data_len = fifo_s_get(&matlab_tx_len_fifo);
-                                        memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                                        fifo_s_gets(&matlab_tx_fifo, (char *) usart1_matlab_tx_buf[1],
-                                                    matlab_dma_send_data_len);
-                                    }
-                                } else {
-//                                    SEGGER_RTT_WriteString(0, "in_else\r\n");
-                                    matlab_dma_send_data_len = 0;
-                                    Matlab_No_DMA_IRQHandler = 1;
-                                    memset(&usart1_matlab_tx_buf[1], 0, USART1_MATLAB_TX_BUF_LENGHT);
-                                }
-                            }
-                            taskEXIT_CRITICAL();
-                        }
-                    }
-                }
-            }
-        }
-#if INCLUDE_uxTaskGetStackHighWaterMark
-        USART1TX_active_task_stack = uxTaskGetStackHighWaterMark(NULL);
-#endif
-        xTaskResumeAll();
-    }
-}
-
 /**
   * @brief          视觉串口接收（USART1）回调函数
   * @param[in]      void
@@ -407,7 +305,7 @@ void USART1_IRQHandler(void) {
             huart1.hdmarx->Instance->CR |= DMA_SxCR_CT;
             __HAL_DMA_ENABLE(huart1.hdmarx);
             if (UART1_TARGET_MODE == Vision_MODE) {
-                fifo_s_puts(&vision_rx_fifo, (char *) usart1_rx_buf[0], this_time_rx_len);
+                vision_rx_chunk_put(usart1_rx_buf[0], this_time_rx_len);
                 detect_hook(VISION_RX_TOE);
                 if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
                     static BaseType_t xHigherPriorityTaskWoken;
@@ -430,7 +328,7 @@ void USART1_IRQHandler(void) {
             huart1.hdmarx->Instance->CR &= ~(DMA_SxCR_CT);
             __HAL_DMA_ENABLE(huart1.hdmarx);
             if (UART1_TARGET_MODE == Vision_MODE) {
-                fifo_s_puts(&vision_rx_fifo, (char *) usart1_rx_buf[1], this_time_rx_len);
+                vision_rx_chunk_put(usart1_rx_buf[1], this_time_rx_len);
                 detect_hook(VISION_RX_TOE);
                 if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
                     static BaseType_t xHigherPriorityTaskWoken;
@@ -449,99 +347,3 @@ void USART1_IRQHandler(void) {
         }
     }
 }
-
-/**
-  * @brief          发送串口（USART1）DMA回调函数
-  * @param[in]      void
-  * @retval         none
-  */
-void DMA2_Stream7_IRQHandler(void) {
-    if (UART1_TARGET_MODE == Vision_MODE) {
-        if (__HAL_DMA_GET_FLAG(huart1.hdmatx, DMA_HISR_TCIF7) != RESET) {
-            MY_USART_DMA_Stream7_Vision_TX_IRQHandler();
-        }
-    } else if (UART1_TARGET_MODE == Matlab_MODE) {
-        if (__HAL_DMA_GET_FLAG(huart1.hdmatx, DMA_HISR_TCIF7) != RESET) {
-            MY_USART_DMA_Stream7_Matlab_TX_IRQHandler();
-        }
-    }
-}
-
-
-void MY_USART_DMA_Stream7_Vision_TX_IRQHandler(void) {
-    __HAL_DMA_DISABLE(huart1.hdmatx);
-    while (huart1.hdmatx->Instance->CR & DMA_SxCR_EN) {
-        __HAL_DMA_DISABLE(huart1.hdmatx);
-    }
-    __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_HT_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_TE_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_DME_FLAG_INDEX(huart1.hdmatx));
-    __HAL_DMA_CLEAR_FLAG (huart1.hdmatx, __HAL_DMA_GET_FE_FLAG_INDEX(huart1.hdmatx));
-    if ((!fifo_s_used(&vision_tx_fifo)) || (!fifo_s_used(&vision_tx_len_fifo))) {
-        if ((fifo_s_used(&vision_tx_fifo)) || (fifo_s_used(&vision_tx_len_fifo))) {
-            //should not come in here
-            fifo_s_flush(&vision_tx_fifo);
-            fifo_s_flush(&vision_tx_len_fifo);
-        }
-    }
-    if (vision_dma_send_data_len == 1) {
-        Vision_IRQ_Return_Before = 1;
-    }
-    if (vision_dma_send_data_len) {
-        if ((huart1.hdmatx->Instance->CR & DMA_SxCR_CT) == RESET) {
-            __HAL_DMA_DISABLE(huart1.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-            __HAL_DMA_SET_COUNTER(huart1.hdmatx, vision_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_0");
-            __HAL_DMA_ENABLE(huart1.hdmatx);
-            vision_dma_send_data_len = 0;
-            detect_hook(USART1_TX_TOE);
-            if (!Vision_IRQ_Return_Before) {
-                if (fifo_s_used(&vision_tx_fifo)) {
-                    if (fifo_s_used(&vision_tx_len_fifo)) {
-                        vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                        memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-                        fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[1], vision_dma_send_data_len);
-                    }
-                } else {
-                    vision_dma_send_data_len = 0;
-                    Vision_No_DMA_IRQHandler = 1;
-                    memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-                }
-            }
-        } else {
-            __HAL_DMA_DISABLE(huart1.hdmatx);
-            __HAL_DMA_CLEAR_FLAG(huart1.hdmatx, DMA_HISR_TCIF7);
-            __HAL_DMA_SET_COUNTER(huart1.hdmatx, vision_dma_send_data_len);
-//            SEGGER_RTT_WriteString(0, "ST1DMA_1");
-            __HAL_DMA_ENABLE(huart1.hdmatx);
-            vision_dma_send_data_len = 0;
-            detect_hook(USART1_TX_TOE);
-            if (!Vision_IRQ_Return_Before) {
-                if (fifo_s_used(&vision_tx_fifo)) {
-                    if (fifo_s_used(&vision_tx_len_fifo)) {
-                        vision_dma_send_data_len = fifo_s_get(&vision_tx_len_fifo);
-                        memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-                        fifo_s_gets(&vision_tx_fifo, (char *) usart1_vision_tx_buf[0], vision_dma_send_data_len);
-                    }
-                } else {
-                    vision_dma_send_data_len = 0;
-                    Vision_No_DMA_IRQHandler = 1;
-                    memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-                }
-            }
-        }
-    } else {
-        memset(&usart1_vision_tx_buf[1], 0, USART1_VISION_TX_BUF_LENGHT);
-        memset(&usart1_vision_tx_buf[0], 0, USART1_VISION_TX_BUF_LENGHT);
-        if (!Vision_No_DMA_IRQHandler) {
-            Vision_IRQ_Return_Before = 1;
-            if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
-//                SEGGER_RTT_WriteString(0, "yield\r\n");
-                static BaseType_t xHigherPriorityTaskWoken;
-                vTaskNotifyGiveFromISR(USART1TX_active_task_local_handler, &xHigherPriorityTaskWoken);
-            }
-        }
-    }
-}
\ No newline at end of file
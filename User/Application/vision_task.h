@@ -8,22 +8,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "struct_typedef.h"
-#include "fifo.h"
+#include "spsc_fifo.h"
 #include "cmsis_os.h"
 #include "referee_task.h"
 
 #define USART1_RX_BUF_LENGHT     512
-#define USART1_VISION_TX_BUF_LENGHT     128
 #define VISION_FIFO_BUF_LENGTH 1024
+//接收队列中每个空闲中断片段记录一次接收时刻,需覆盖队列中尚未解析的片段数
+#define VISION_RX_CHUNK_NUM     32
 /*************define for unpack start*********************/
 #define VISION_HEADER_SOF 0x24
 #define Vision_PROTOCOL_FRAME_MAX_SIZE         128
-
-typedef enum {
-    VISION_STEP_HEADER_SOF = 0,
-    VISION_STEP_LEN,
-    VISION_STEP_FRAME_CRC16,
-} vision_unpack_step_e;
+//视觉延迟补偿:用拍摄时刻的姿态把目标偏差换算到世界坐标系
+#define VISION_LATENCY_COMPENSATE   1
+//旧协议帧不带延迟字段时假定的拍摄到发送延迟 us
+#define VISION_DEFAULT_LATENCY_US   0U
 
 
 #pragma pack(push, 1)
@@ -38,6 +37,8 @@ typedef struct {
     float data1;
     float data2;
     uint16_t data3;
+    uint32_t data4;     //相机曝光到开始发送该帧的延迟 us,旧协议无此字段
+    float data5;        //目标距离 m,0为未知,旧协议无此字段
 } vision_frame_data;
 
 typedef struct {
@@ -53,42 +54,36 @@ typedef struct {
 typedef struct {
     bool data_valid;
     vision_sync_struct frame;
-    uint8_t protocol_packet[Vision_PROTOCOL_FRAME_MAX_SIZE];
-    vision_unpack_step_e unpack_step;
-    uint16_t index;
+    uint8_t protocol_packet[Vision_PROTOCOL_FRAME_MAX_SIZE]; //帧跨越接收队列末尾时的拼接缓存
 } vision_unpack_data_t;
 
 typedef volatile struct {
-    float32_t yaw_angle;
+    //前五项与vision_frame_data一一对应,由解析器直接拷贝
+    float32_t yaw_angle;        //相对拍摄时刻姿态的目标偏差 rad
     float32_t pitch_angle;
     uint16_t fps;
+    uint32_t latency_us;
+    float32_t distance;         //m
     volatile bool update_flag;
+    uint32_t capture_tick;      //拍摄时刻的DWT计数,由接收时刻和延迟推算
 } vision_control_t;
 
 typedef volatile struct {
     vision_control_t vision_control;
     vision_unpack_data_t *pack_info;
     vision_state_e state;
+    uint32_t history_miss_cnt;  //拍摄时刻超出姿态历史的帧数(调试时使用)
 } vision_info_t;
 
 #pragma pack(pop)
 /*************define for unpack end*********************/
 
-extern volatile uint8_t Vision_No_DMA_IRQHandler;
-extern volatile uint8_t vision_dma_send_data_len;
-extern volatile uint8_t Vision_IRQ_Return_Before;
-
-extern fifo_s_t vision_rx_fifo;
-extern fifo_s_t vision_tx_len_fifo;
-extern fifo_s_t vision_tx_fifo;
+extern spsc_fifo_t vision_rx_fifo;
 extern uint8_t usart1_rx_buf[2][USART1_RX_BUF_LENGHT];
-extern uint8_t usart1_vision_tx_buf[2][USART1_VISION_TX_BUF_LENGHT];
 extern vision_info_t global_vision_info;
 
 void USART1_IRQHandler(void);
 
-void DMA2_Stream7_IRQHandler(void);
-
 /**
   * @brief          获取vision_tx_task栈大小
   * @param[in]      none
@@ -110,13 +105,6 @@ extern void clear_vision_update_flag(void);
   */
 extern uint32_t get_stack_of_vision_rx_task(void);
 
-/**
-  * @brief          获取USART1TX_active_task栈大小
-  * @param[in]      none
-  * @retval         USART1TX_active_task_stack:任务堆栈大小
-  */
-extern uint32_t get_stack_of_USART1TX_active_task(void);
-
 /**
   * @brief          视觉接收任务
   * @param[in]      pvParameters: NULL
@@ -132,18 +120,31 @@ void vision_rx_task(void const *argument);
 void vision_tx_task(void const *argument);
 
 /**
-  * @brief          single byte upacked
+  * @brief          unpack the vision frames in the rx fifo
   * @param[in]      void
   * @retval         none
   */
 /**
-  * @brief          单字节解包
+  * @brief          解析接收队列中的视觉数据帧
   * @param[in]      void
   * @retval         none
   */
 void vision_unpack_fifo_data(void);
 
-void vision_update(uint8_t *rxBuf);
+/**
+  * @brief          direction of the vision target in the world (INS) frame: the attitude at
+  *                 capture time plus the vision offset
+  * @param[out]     capture_tick: capture time, DWT tick
+  * @param[out]     target: yaw, pitch, rad
+  * @retval         1: valid, 0: capture time outside the attitude history
+  */
+/**
+  * @brief          视觉目标在世界(INS)坐标系下的方向:拍摄时刻的姿态加上视觉偏差
+  * @param[out]     capture_tick: 拍摄时刻, DWT计数
+  * @param[out]     target: yaw, pitch, rad
+  * @retval         1:有效, 0:拍摄时刻超出姿态历史
+  */
+extern bool_t get_vision_target_world(uint32_t *capture_tick, float32_t target[2]);
 
 /**
   * @brief          获取视觉数据指针
@@ -159,16 +160,6 @@ extern const vision_control_t *get_vision_control_point(void);
   */
 void init_vision_struct_data(void);
 
-void MY_USART_DMA_Stream7_Vision_TX_IRQHandler(void);
-
-extern TaskHandle_t USART1TX_active_task_local_handler;
 extern TaskHandle_t vision_rx_task_local_handler;
 
-/**
-  * @brief          usart1发送启动任务，由发送时任务通知激活
-  * @param[in]      pvParameters: 空
-  * @retval         none
-  */
-void USART1TX_active_task(void const *pvParameters);
-
 #endif //ROBOMASTERROBOTCODE_VISION_TASK_H
@@ -1,7 +1,6 @@
 #include "bsp_usart.h"
 #include "main.h"
 #include "detect_task.h"
-#include "referee_task.h"
 #include "SEGGER_RTT.h"
 
 #define USART6_RX_BUF_LEN            200
@@ -13,6 +12,38 @@ extern UART_HandleTypeDef huart6;
 extern DMA_HandleTypeDef hdma_usart6_rx;
 extern DMA_HandleTypeDef hdma_usart6_tx;
 
+uart_tx_port_t usart1_tx_port;
+uart_tx_port_t usart6_tx_port;
+
+static void usart1_tx_start(const uint8_t *data, uint16_t len) {
+    usart1_tx_dma_enable((uint8_t *) data, len);
+    detect_hook(USART1_TX_TOE);
+}
+
+static void usart6_tx_start(const uint8_t *data, uint16_t len) {
+    usart6_tx_dma_enable((uint8_t *) data, len);
+    detect_hook(REFEREE_TX_TOE);
+}
+
+//停止发送DMA并清除完成标志,迟到的完成中断不会误释放下一帧
+static void usart1_tx_abort(void) {
+    __HAL_DMA_DISABLE(&hdma_usart1_tx);
+
+    while (hdma_usart1_tx.Instance->CR & DMA_SxCR_EN) {
+        __HAL_DMA_DISABLE(&hdma_usart1_tx);
+    }
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, DMA_HISR_TCIF7);
+}
+
+static void usart6_tx_abort(void) {
+    __HAL_DMA_DISABLE(&hdma_usart6_tx);
+
+    while (hdma_usart6_tx.Instance->CR & DMA_SxCR_EN) {
+        __HAL_DMA_DISABLE(&hdma_usart6_tx);
+    }
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, DMA_HISR_TCIF6);
+}
+
 
 void usart1_tx_dma_init(void) {
 
@@ -46,6 +77,9 @@ void usart1_tx_dma_enable(uint8_t *data, uint16_t len) {
     }
 
     __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, DMA_HISR_TCIF7);
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, __HAL_DMA_GET_HT_FLAG_INDEX(&hdma_usart1_tx));
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, __HAL_DMA_GET_TE_FLAG_INDEX(&hdma_usart1_tx));
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, __HAL_DMA_GET_FE_FLAG_INDEX(&hdma_usart1_tx));
 
     hdma_usart1_tx.Instance->M0AR = (uint32_t) (data);
     __HAL_DMA_SET_COUNTER(&hdma_usart1_tx, len);
@@ -53,7 +87,7 @@ void usart1_tx_dma_enable(uint8_t *data, uint16_t len) {
     __HAL_DMA_ENABLE(&hdma_usart1_tx);
 }
 
-void usart1_tx_init(uint8_t *tx1_buf, uint8_t *tx2_buf, uint16_t dma_tx_buf_num)
+void usart1_tx_init(void)
 {
     //enable the DMA transfer for the transmit request
     //使能DMA串口发送
@@ -73,24 +107,14 @@ void usart1_tx_init(uint8_t *tx1_buf, uint8_t *tx2_buf, uint16_t dma_tx_buf_num)
     __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, DMA_HISR_TCIF7);
 
     hdma_usart1_tx.Instance->PAR = (uint32_t) &(USART1->DR);
-    //memory buffer 1
-    //内存缓冲区1
-    hdma_usart1_tx.Instance->M0AR = (uint32_t) (tx1_buf);
-    //memory buffer 2
-    //内存缓冲区2
-    hdma_usart1_tx.Instance->M1AR = (uint32_t) (tx2_buf);
-    //data length
-    //数据长度
-    __HAL_DMA_SET_COUNTER(&hdma_usart1_tx, dma_tx_buf_num);
+    hdma_usart1_tx.Instance->M0AR = (uint32_t) (NULL);
+    __HAL_DMA_SET_COUNTER(&hdma_usart1_tx, 0);
 
-    //enable double memory buffer
-    //使能双缓冲区
-    SET_BIT(hdma_usart1_tx.Instance->CR, DMA_SxCR_DBM);
-
-    //enable DMA
-    //使能DMA
-    __HAL_DMA_ENABLE(&hdma_usart1_tx);
+    //single buffer mode, every frame is sent from its own buffer of the scheduler
+    //单缓冲模式,每帧直接从发送调度器的帧缓存发送
+    CLEAR_BIT(hdma_usart1_tx.Instance->CR, DMA_SxCR_DBM);
 
+    uart_tx_init(&usart1_tx_port, usart1_tx_start, usart1_tx_abort, HAL_GetTick);
 }
 
 void usart1_rx_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num)
@@ -130,8 +154,7 @@ void usart1_rx_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num)
     __HAL_DMA_ENABLE(&hdma_usart1_rx);
 }
 
-void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num, uint8_t *tx1_buf, uint8_t *tx2_buf,
-                 uint16_t dma_tx_buf_num) {
+void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num) {
 
     //enable the DMA transfer for the receiver and tramsmit request
     //使能DMA串口接收和发送
@@ -185,22 +208,14 @@ void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num, ui
     __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, DMA_HISR_TCIF6);
 
     hdma_usart6_tx.Instance->PAR = (uint32_t) &(USART6->DR);
-    //memory buffer 1
-    //内存缓冲区1
-    hdma_usart6_tx.Instance->M0AR = (uint32_t) (tx1_buf);
-    //memory buffer 2
-    //内存缓冲区2
-    hdma_usart6_tx.Instance->M1AR = (uint32_t) (tx2_buf);
-    //data length
-    //数据长度
-    __HAL_DMA_SET_COUNTER(&hdma_usart6_tx, dma_tx_buf_num);
-    //enable double memory buffer
-    //使能双缓冲区
-    SET_BIT(hdma_usart6_tx.Instance->CR, DMA_SxCR_DBM);
-    //enable DMA
-    //使能DMA
-    __HAL_DMA_ENABLE(&hdma_usart6_tx);
+    hdma_usart6_tx.Instance->M0AR = (uint32_t) (NULL);
+    __HAL_DMA_SET_COUNTER(&hdma_usart6_tx, 0);
+
+    //single buffer mode, every frame is sent from its own buffer of the scheduler
+    //单缓冲模式,每帧直接从发送调度器的帧缓存发送
+    CLEAR_BIT(hdma_usart6_tx.Instance->CR, DMA_SxCR_DBM);
 
+    uart_tx_init(&usart6_tx_port, usart6_tx_start, usart6_tx_abort, HAL_GetTick);
 }
 
 
@@ -214,9 +229,41 @@ void usart6_tx_dma_enable(uint8_t *data, uint16_t len) {
     }
 
     __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, DMA_HISR_TCIF6);
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, __HAL_DMA_GET_HT_FLAG_INDEX(&hdma_usart6_tx));
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, __HAL_DMA_GET_TE_FLAG_INDEX(&hdma_usart6_tx));
+    __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, __HAL_DMA_GET_FE_FLAG_INDEX(&hdma_usart6_tx));
 
     hdma_usart6_tx.Instance->M0AR = (uint32_t) (data);
     __HAL_DMA_SET_COUNTER(&hdma_usart6_tx, len);
 
     __HAL_DMA_ENABLE(&hdma_usart6_tx);
+}
+
+/**
+  * @brief          usart1 tx dma complete interrupt, starts the next queued frame
+  * @param[in]      void
+  * @retval         none
+  */
+/**
+  * @brief          串口1发送DMA完成中断,启动队列中的下一帧
+  * @param[in]      void
+  * @retval         none
+  */
+void DMA2_Stream7_IRQHandler(void) {
+    if (__HAL_DMA_GET_FLAG(&hdma_usart1_tx, DMA_HISR_TCIF7) != RESET) {
+        __HAL_DMA_CLEAR_FLAG(&hdma_usart1_tx, DMA_HISR_TCIF7);
+        uart_tx_complete_irq(&usart1_tx_port);
+    }
+}
+
+/**
+  * @brief          串口6发送DMA完成中断,启动队列中的下一帧
+  * @param[in]      void
+  * @retval         none
+  */
+void DMA2_Stream6_IRQHandler(void) {
+    if (__HAL_DMA_GET_FLAG(&hdma_usart6_tx, DMA_HISR_TCIF6) != RESET) {
+        __HAL_DMA_CLEAR_FLAG(&hdma_usart6_tx, DMA_HISR_TCIF6);
+        uart_tx_complete_irq(&usart6_tx_port);
+    }
 }
\ No newline at end of file
@@ -2,15 +2,20 @@
 #define BSP_USART_H
 
 #include "struct_typedef.h"
+#include "uart_tx.h"
 
+//串口发送调度器,发送完成中断由本文件处理
+extern uart_tx_port_t usart1_tx_port;
+extern uart_tx_port_t usart6_tx_port;
 
-extern void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num, uint8_t *tx1_buf, uint8_t *tx2_buf,
-                        uint16_t dma_tx_buf_num);
+extern void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num);
 
-extern void usart1_tx_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num);
+extern void usart1_tx_init(void);
 
-extern void usart1_rx_init(uint8_t *tx1_buf, uint8_t *tx2_buf, uint16_t dma_tx_buf_num);
+extern void usart1_rx_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_rx_buf_num);
 
 extern void usart1_tx_dma_enable(uint8_t *data, uint16_t len);
 
+extern void usart6_tx_dma_enable(uint8_t *data, uint16_t len);
+
 #endif
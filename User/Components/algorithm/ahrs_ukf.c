@@ -64,13 +64,13 @@ void UKF_init(UKF_t *UKF_op, matrix_f32_t *XInit, matrix_f32_t *P, matrix_f32_t
  *                the noise as AWGN (and same value for every variable), this is set
  *                to Rv=diag(RvInit,...,RvInit) and Rn=diag(RnInit,...,RnInit).
  */
-    UKF_op->X_Est = *XInit;
-    Matrix_vCopy_f32(&UKF_op->P, P);
-    Matrix_vCopy_f32(&UKF_op->Rv, Rv);
-    Matrix_vCopy_f32(&UKF_op->Rn, Rn);
+    //Matrix_vCopy_f32(源, 目标), 初值复制进滤波器自己的矩阵
+    Matrix_vCopy_f32(XInit, &UKF_op->X_Est);
+    Matrix_vCopy_f32(P, &UKF_op->P);
+    Matrix_vCopy_f32(Rv, &UKF_op->Rv);
+    Matrix_vCopy_f32(Rn, &UKF_op->Rn);
     UKF_op->AHRS_bUpdateNonlinearX = bNonlinearUpdateX;
     UKF_op->AHRS_bUpdateNonlinearY = bNonlinearUpdateY;
-    Matrix_nodata_creat_f32(&UKF_op->X_Est, SS_X_LEN, 1, InitMatWithZero);
     Matrix_nodata_creat_f32(&UKF_op->X_Sigma, SS_X_LEN, (2 * SS_X_LEN + 1), InitMatWithZero);
 
     Matrix_nodata_creat_f32(&UKF_op->Y_Est, SS_Z_LEN, 1, InitMatWithZero);
@@ -126,9 +126,9 @@ bool UKF_bUpdate(UKF_t *UKF_op, matrix_f32_t *Y_matrix, matrix_f32_t *U_matrix,
     matrix_f32_t _temp_T;
     matrix_f32_t _temp_M;
     matrix_f32_t _temp_M2;
-    Matrix_vinit_f32(&_temp_T);
-    Matrix_vinit_f32(&_temp_M);
-    Matrix_vinit_f32(&_temp_M2);
+    Matrix_vinit_static_f32(&_temp_T, &UKF_op->temp_buffer[UKF_TEMP_0]);
+    Matrix_vinit_static_f32(&_temp_M, &UKF_op->temp_buffer[UKF_TEMP_1]);
+    Matrix_vinit_static_f32(&_temp_M2, &UKF_op->temp_buffer[UKF_TEMP_2]);
     /* Run once every sampling time */
     /* XSigma(k-1) = [x(k-1) Xs(k-1)+GPsq Xs(k-1)-GPsq]                     ...{UKF_4}  */
     if (!UKF_bCalculateSigmaPoint(UKF_op)) {
@@ -161,7 +161,7 @@ bool UKF_bUpdate(UKF_t *UKF_op, matrix_f32_t *Y_matrix, matrix_f32_t *U_matrix,
      *  K           = Pxy(k) * (Py(k)^-1)                                   ...{UKF_10}
      */
     matrix_f32_t PyInv;
-    Matrix_vinit_f32(&PyInv);
+    Matrix_vinit_static_f32(&PyInv, &UKF_op->temp_buffer[UKF_TEMP_3]);
     Matrix_vInverse_nsame_f32(&UKF_op->Py, &PyInv);
     if (!Matrix_bMatrixIsValid_f32(&PyInv)) {
         Matrix_vSetMatrixInvalid_f32(&PyInv);
@@ -179,10 +179,10 @@ bool UKF_bUpdate(UKF_t *UKF_op, matrix_f32_t *Y_matrix, matrix_f32_t *U_matrix,
 
     /* Update the Covariance Matrix:
      *  P(k|k)      = P(k|k-1) - K*Py(k)*K'                                 ...{UKF_12}
+     *              = P(k|k-1) - Pxy(k)*K'      (Py was overwritten by the inverse above)
      */
     Matrix_vTranspose_nsame_f32(&UKF_op->Gain, &_temp_T);
-    Matrix_vmult_nsame_f32(&UKF_op->Gain, &UKF_op->Py, &_temp_M);
-    Matrix_vmult_nsame_f32(&_temp_M, &_temp_T, &_temp_M2);
+    Matrix_vmult_nsame_f32(&UKF_op->Pxy, &_temp_T, &_temp_M2);
     Matrix_vsub_f32(&UKF_op->P, &_temp_M2, &UKF_op->P);
     Matrix_vSetMatrixInvalid_f32(&PyInv);
     Matrix_vSetMatrixInvalid_f32(&_temp_T);
@@ -193,10 +193,10 @@ bool UKF_bUpdate(UKF_t *UKF_op, matrix_f32_t *Y_matrix, matrix_f32_t *U_matrix,
 }
 
 void UKF_vReset(UKF_t *UKF_op, matrix_f32_t *XInit, matrix_f32_t *P, matrix_f32_t *Rv, matrix_f32_t *Rn) {
-    UKF_op->X_Est = *XInit;
-    Matrix_vCopy_f32(&UKF_op->P, P);
-    Matrix_vCopy_f32(&UKF_op->Rv, Rv);
-    Matrix_vCopy_f32(&UKF_op->Rn, Rn);
+    Matrix_vCopy_f32(XInit, &UKF_op->X_Est);
+    Matrix_vCopy_f32(P, &UKF_op->P);
+    Matrix_vCopy_f32(Rv, &UKF_op->Rv);
+    Matrix_vCopy_f32(Rn, &UKF_op->Rn);
 }
 
 bool UKF_bCalculateSigmaPoint(UKF_t *UKF_op) {
@@ -206,7 +206,7 @@ bool UKF_bCalculateSigmaPoint(UKF_t *UKF_op) {
      */
     /* Use Cholesky Decomposition to compute sqrt(P) */
     matrix_f32_t _temp;
-    Matrix_vinit_f32(&_temp);
+    Matrix_vinit_static_f32(&_temp, &UKF_op->temp_buffer[UKF_TEMP_0]);
     Matrix_vCholeskyDec_f32(&UKF_op->P, &UKF_op->P_Chol);
     if (!Matrix_bMatrixIsValid_f32(&UKF_op->P_Chol)) {
         /* System Fail */
@@ -216,7 +216,7 @@ bool UKF_bCalculateSigmaPoint(UKF_t *UKF_op) {
 
     /* Xs(k-1) = [x(k-1) ... x(k-1)]            ; Xs(k-1) = NxN */
     matrix_f32_t Y_;
-    Matrix_nodata_creat_f32(&Y_, SS_X_LEN, SS_X_LEN, InitMatWithZero);
+    Matrix_static_nodata_creat_f32(&Y_, &UKF_op->temp_buffer[UKF_TEMP_1], SS_X_LEN, SS_X_LEN, InitMatWithZero);
     for (int16_t _i = 0; _i < SS_X_LEN; _i++) {
         Matrix_vInsertVector_f32(&Y_, &UKF_op->X_Est, _i, &Y_);
     }
@@ -244,8 +244,8 @@ UKF_bUnscentedTransform(UKF_t *UKF_op, matrix_f32_t *Out, matrix_f32_t *OutSigma
                         matrix_f32_t *_CovNoise, AHRS_t *AHRS_op) {
     matrix_f32_t _temp_T;
     matrix_f32_t _temp_M;
-    Matrix_vinit_f32(&_temp_T);
-    Matrix_vinit_f32(&_temp_M);
+    Matrix_vinit_static_f32(&_temp_T, &UKF_op->temp_buffer[UKF_TEMP_2]);
+    Matrix_vinit_static_f32(&_temp_M, &UKF_op->temp_buffer[UKF_TEMP_3]);
     /* XSigma(k) = f(XSigma(k-1), u(k-1))                                  ...{UKF_5a}  */
     /* x(k|k-1) = sum(Wm(i) * XSigma(k)(i))    ; i = 1 ... (2N+1)          ...{UKF_6a}  */
     Matrix_vSetToZero_f32(Out);
@@ -253,8 +253,10 @@ UKF_bUnscentedTransform(UKF_t *UKF_op, matrix_f32_t *Out, matrix_f32_t *OutSigma
         /* Transform the column submatrix of sigma-points input matrix (InpSigma) */
         matrix_f32_t _AuxSigma1;
         matrix_f32_t _AuxSigma2;
-        Matrix_nodata_creat_f32(&_AuxSigma1, InpSigma->arm_matrix.numRows, 1, InitMatWithZero);
-        Matrix_nodata_creat_f32(&_AuxSigma2, OutSigma->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_static_nodata_creat_f32(&_AuxSigma1, &UKF_op->temp_buffer[UKF_TEMP_0], InpSigma->arm_matrix.numRows, 1,
+                                       InitMatWithZero);
+        Matrix_static_nodata_creat_f32(&_AuxSigma2, &UKF_op->temp_buffer[UKF_TEMP_1], OutSigma->arm_matrix.numRows, 1,
+                                       InitMatWithZero);
         for (int16_t _i = 0; _i < InpSigma->arm_matrix.numRows; _i++) {
             _AuxSigma1.p2Data[_i][0] = InpSigma->p2Data[_i][_j];
         }
@@ -278,7 +280,8 @@ UKF_bUnscentedTransform(UKF_t *UKF_op, matrix_f32_t *Out, matrix_f32_t *OutSigma
     /* DX = XSigma(k)(i) - Xs(k)   ; Xs(k) = [x(k|k-1) ... x(k|k-1)]
      *                             ; Xs(k) = Nx(2N+1)                      ...{UKF_7a}  */
     matrix_f32_t _AuxSigma1;
-    Matrix_nodata_creat_f32(&_AuxSigma1, OutSigma->arm_matrix.numRows, OutSigma->arm_matrix.numCols, InitMatWithZero);
+    Matrix_static_nodata_creat_f32(&_AuxSigma1, &UKF_op->temp_buffer[UKF_TEMP_0], OutSigma->arm_matrix.numRows,
+                                   OutSigma->arm_matrix.numCols, InitMatWithZero);
     for (int16_t _j = 0; _j < OutSigma->arm_matrix.numCols; _j++) {
         Matrix_vInsertVector_f32(&_AuxSigma1, Out, _j, &_AuxSigma1);
     }
@@ -130,6 +130,15 @@ typedef struct {
     matrix_f32_t HARD_IRON_BIAS;
 } AHRS_t;
 
+/* scratch storage of UKF_bUpdate and its helpers, their temporaries are never live at the same time */
+typedef enum {
+    UKF_TEMP_0 = 0,
+    UKF_TEMP_1,
+    UKF_TEMP_2,
+    UKF_TEMP_3,
+    UKF_TEMP_NUM,
+} UKF_temp_e;
+
 typedef struct {
     matrix_f32_t X_Est;
     matrix_f32_t X_Sigma;
@@ -156,6 +165,8 @@ typedef struct {
     matrix_f32_t Gain;
     float32_t Gamma;
 
+    matrix_buffer_f32_t temp_buffer[UKF_TEMP_NUM];
+
     bool (*AHRS_bUpdateNonlinearX)(matrix_f32_t *X_Next, matrix_f32_t *X, matrix_f32_t *U, AHRS_t *AHRS_op);
 
     bool (*AHRS_bUpdateNonlinearY)(matrix_f32_t *Y, matrix_f32_t *X, matrix_f32_t *U, AHRS_t *AHRS_op);
@@ -0,0 +1,87 @@
+/**
+  * @file       attitude_history.c/h
+  * @brief      ring buffer of timestamped euler angles.
+  *             带时间戳的欧拉角环形缓存
+  */
+#include "attitude_history.h"
+#include "macro_mutex.h"
+#include "arm_math.h"
+#include <string.h>
+
+void attitude_history_init(attitude_history_t *p_history) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    memset(p_history, 0, sizeof(attitude_history_t));
+    MUTEX_UNLOCK(mutex);
+}
+
+void attitude_history_push(attitude_history_t *p_history, uint32_t tick, const float32_t angle[3]) {
+    MUTEX_DECLARE(mutex);
+    attitude_sample_t *p_sample;
+
+    MUTEX_LOCK(mutex);
+    p_sample = &p_history->sample[p_history->cnt % ATTITUDE_HISTORY_LEN];
+    p_sample->tick = tick;
+    p_sample->angle[0] = angle[0];
+    p_sample->angle[1] = angle[1];
+    p_sample->angle[2] = angle[2];
+    p_history->cnt++;
+    MUTEX_UNLOCK(mutex);
+}
+
+attitude_history_result_e attitude_history_lookup(attitude_history_t *p_history, uint32_t tick,
+                                                  float32_t angle[3]) {
+    MUTEX_DECLARE(mutex);
+    attitude_sample_t older, newer;
+    uint32_t num, newest, lo, hi, mid, age;
+    float32_t ratio, diff;
+    uint8_t i;
+
+    MUTEX_LOCK(mutex);
+    num = (p_history->cnt < ATTITUDE_HISTORY_LEN) ? p_history->cnt : ATTITUDE_HISTORY_LEN;
+    if (num == 0U) {
+        MUTEX_UNLOCK(mutex);
+        return ATTITUDE_HISTORY_MISS;
+    }
+    newest = p_history->cnt - 1U;
+    newer = p_history->sample[newest % ATTITUDE_HISTORY_LEN];
+    //以最新样本为基准的年龄比较,跨越计数溢出也正确
+    age = newer.tick - tick;
+    if ((int32_t) age <= 0) {
+        MUTEX_UNLOCK(mutex);
+        memcpy(angle, newer.angle, sizeof(newer.angle));
+        return ATTITUDE_HISTORY_NEWEST;
+    }
+    lo = p_history->cnt - num;
+    if (newer.tick - p_history->sample[lo % ATTITUDE_HISTORY_LEN].tick < age) {
+        p_history->miss_cnt++;
+        MUTEX_UNLOCK(mutex);
+        return ATTITUDE_HISTORY_MISS;
+    }
+    //二分查找最后一个不晚于tick的样本,样本年龄随序号单调递减
+    hi = newest;
+    while (hi - lo > 1U) {
+        mid = lo + (hi - lo) / 2U;
+        if (newer.tick - p_history->sample[mid % ATTITUDE_HISTORY_LEN].tick >= age) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    older = p_history->sample[lo % ATTITUDE_HISTORY_LEN];
+    newer = p_history->sample[hi % ATTITUDE_HISTORY_LEN];
+    MUTEX_UNLOCK(mutex);
+
+    ratio = (newer.tick != older.tick) ? (float32_t) (tick - older.tick) / (float32_t) (newer.tick - older.tick) : 0.0f;
+    for (i = 0; i < 3; i++) {
+        diff = newer.angle[i] - older.angle[i];
+        if (diff > PI) {
+            diff -= 2.0f * PI;
+        } else if (diff < -PI) {
+            diff += 2.0f * PI;
+        }
+        angle[i] = older.angle[i] + diff * ratio;
+    }
+    return ATTITUDE_HISTORY_OK;
+}
@@ -0,0 +1,76 @@
+/**
+  * @file       attitude_history.c/h
+  * @brief      ring buffer of timestamped euler angles. Returns the attitude at
+  *             any instant inside the buffered window by linear interpolation,
+  *             used to express a delayed measurement (e.g. a camera frame) in the
+  *             attitude it was taken in.
+  *             带时间戳的欧拉角环形缓存,用线性插值给出缓存时间窗内任意时刻的姿态,
+  *             用于把延迟的测量(如相机帧)换算到拍摄时刻的姿态下
+  * @note       ticks are a free running 32 bit counter (DWT), compared by unsigned
+  *             subtraction so one wrap is handled. Angles are interpolated along the
+  *             shorter arc, a yaw crossing 0/2pi between two samples is correct.
+  *             Push and lookup run in short PRIMASK critical sections, one task
+  *             pushes and any task may look up.
+  *             时间戳为32位自由运行计数(DWT),以无符号减法比较,可跨越一次溢出.角度沿较短
+  *             的弧插值,两样本之间yaw跨越0/2pi也正确.写入与查询在短暂的PRIMASK临界区中
+  *             进行,一个任务写入,任意任务查询
+  */
+#ifndef ATTITUDE_HISTORY_H
+#define ATTITUDE_HISTORY_H
+
+#include "struct_typedef.h"
+
+#define ATTITUDE_HISTORY_LEN 256     //1kHz时约256ms
+
+typedef enum {
+    ATTITUDE_HISTORY_OK = 0,        //两样本之间插值
+    ATTITUDE_HISTORY_NEWEST,        //晚于最新样本,返回最新样本
+    ATTITUDE_HISTORY_MISS,          //早于缓存或缓存为空,未返回数据
+} attitude_history_result_e;
+
+typedef struct {
+    uint32_t tick;
+    float32_t angle[3];
+} attitude_sample_t;
+
+typedef struct {
+    attitude_sample_t sample[ATTITUDE_HISTORY_LEN];
+    uint32_t cnt;                   //写入的样本总数
+    uint32_t miss_cnt;              //查询时刻早于缓存的次数
+} attitude_history_t;
+
+/**
+  * @brief          清空缓存
+  */
+extern void attitude_history_init(attitude_history_t *p_history);
+
+/**
+  * @brief          push one sample, ticks must not go backwards
+  * @param[in]      tick: sample time
+  * @param[in]      angle: yaw, pitch, roll, rad
+  * @retval         none
+  */
+/**
+  * @brief          写入一个样本,时间戳不能倒退
+  * @param[in]      tick: 采样时刻
+  * @param[in]      angle: yaw, pitch, roll, rad
+  * @retval         none
+  */
+extern void attitude_history_push(attitude_history_t *p_history, uint32_t tick, const float32_t angle[3]);
+
+/**
+  * @brief          attitude at tick
+  * @param[in]      tick: query time
+  * @param[out]     angle: yaw, pitch, roll, rad, not wrapped, compare with jump_error
+  * @retval         attitude_history_result_e
+  */
+/**
+  * @brief          查询tick时刻的姿态
+  * @param[in]      tick: 查询时刻
+  * @param[out]     angle: yaw, pitch, roll, rad, 插值结果不限幅,用jump_error求差
+  * @retval         attitude_history_result_e
+  */
+extern attitude_history_result_e attitude_history_lookup(attitude_history_t *p_history, uint32_t tick,
+                                                         float32_t angle[3]);
+
+#endif
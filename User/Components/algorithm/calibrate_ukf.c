@@ -5,6 +5,7 @@
 #include "calibrate_ukf.h"
 #include "matrix.h"
 #include "ahrs_ukf.h"
+#include <string.h>
 
 /*
 TRICAL_init:
@@ -473,19 +474,19 @@ static void matrix_cholesky_decomp_scale_f(unsigned int dim, float L[],
 }
 
 void realtime_mag_cali(matrix_f32_t *quaternion_attitude,TRICAL_instance_t *TRICAL_data) {
-    static matrix_f32_t last_quaternion_attitude;
+    //上次参与校准的姿态
+    static float32_t last_quaternion_attitude[4] = {1.0f, 0.0f, 0.0f, 0.0f};
     static float32_t body_wmm_filed[3];
-    Matrix_vinit(&last_quaternion_attitude);
-    Matrix_vCopy(&last_quaternion_attitude, &last_quaternion_attitude);
     /*
 If the current attitude is too close to the attitude at which this
 TRICAL instance was last updated, skip calibration this time
 */
     float delta_angle = quaternion_quaternion_angle_f(quaternion_attitude->arm_matrix.pData,
-                                                      last_quaternion_attitude.arm_matrix.pData);
+                                                      last_quaternion_attitude);
     if (delta_angle < 3.0 * PI / 180.0) {
         return;
     }
+    memcpy(last_quaternion_attitude, quaternion_attitude->arm_matrix.pData, sizeof(last_quaternion_attitude));
     quaternion_vector3_multiply_f(body_wmm_filed,quaternion_attitude->arm_matrix.pData,IMU_MAG_B0_data);
 
 //    TRICAL_estimate_update(TRICAL_data,INS_m)
@@ -497,7 +498,7 @@ float quaternion_quaternion_angle_f(const float q1[4], const float q2[4]) {
     return acosf(2.0f * qdot - 1.0f);
 }
 
-float quaternion_vector3_multiply_f(float result[3], const float q[4], const float v[3]) {
+void quaternion_vector3_multiply_f(float result[3], const float q[4], const float v[3]) {
     /*
     Multiply a quaternion by a vector (i.e. transform a vectory by a
     quaternion)
@@ -525,17 +526,17 @@ float quaternion_vector3_multiply_f(float result[3], const float q[4], const flo
     rx += q[0] * tx;
     rx += q[2] * tz;
     rx -= q[3] * ty;
-    result[1] = rx;
+    result[0] = rx;
 
     ry = v[1];
     ry += q[0] * ty;
     ry += q[3] * tx;
     ry -= q[1] * tz;
-    result[2] = ry;
+    result[1] = ry;
 
     rz = v[2];
     rz += q[0] * tz;
     rz -= q[2] * tx;
     rz += q[1] * ty;
-    result[3] = rz;
+    result[2] = rz;
 }
\ No newline at end of file
@@ -180,6 +180,6 @@ void _trical_filter_iterate(TRICAL_instance_t *instance,
 static void matrix_cholesky_decomp_scale_f(unsigned int dim, float L[],
                                            const float A[], const float mul);
 extern float quaternion_quaternion_angle_f(const float q1[4],const float q2[4]);
-extern float quaternion_vector3_multiply_f(float result[3], const float q[4], const float v[3]);
+extern void quaternion_vector3_multiply_f(float result[3], const float q[4], const float v[3]);
 
 #endif //ROBOMASTERROBOTCODE_CALIBRATE_UKF_H
@@ -0,0 +1,466 @@
+/**
+  * @file       cascade_tune.c/h
+  * @brief      sequencer that tunes a cascade of PID loops from the inner loop
+  *             outwards.
+  *             串级PID由内环到外环的自动整定
+  */
+#include "cascade_tune.h"
+#include "arm_math.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CASCADE_TUNE_2PI        (2.0f * PI)
+#define CASCADE_TUNE_RAD2DEG    (180.0f / PI)
+
+static const char *const cascade_gain_suffix[3] = {"kp", "ki", "kd"};
+
+//开环在一段频率上的裕度
+typedef struct {
+    float32_t crossover;                        //Hz, 0:没有穿越
+    float32_t phase_margin;                     //deg
+    float32_t gain_margin;                      //dB
+} cascade_margin_t;
+
+static void cascade_tune_start_stage(cascade_tune_t *tune);
+
+/**
+  * @brief          PI在角频率w处的增益和相位
+  */
+static void cascade_tune_pi_response(float32_t kp, float32_t wi, float32_t w, float32_t *gain, float32_t *phase) {
+    float32_t r = wi / w;
+
+    *gain = kp * sqrtf(1.0f + r * r);
+    *phase = -atanf(r);
+}
+
+/**
+  * @brief          检查相邻两个频率点之间的增益穿越和-180度相位穿越, 在对数增益上插值.
+  *                 相位穿越只在开环增益小于1时计入增益裕度
+  */
+static void cascade_tune_crossing(float32_t f0, float32_t g0, float32_t ph0, float32_t f1, float32_t g1,
+                                  float32_t ph1, cascade_margin_t *margin) {
+    float32_t lg0 = logf(g0), lg1 = logf(g1);
+    float32_t t, lg, gm;
+
+    if (lg0 >= 0.0f && lg1 < 0.0f) {
+        float32_t pm;
+        t = lg0 / (lg0 - lg1);
+        pm = 180.0f + (ph0 + t * (ph1 - ph0)) * CASCADE_TUNE_RAD2DEG;
+        margin->crossover = f0 * powf(f1 / f0, t);
+        if (pm < margin->phase_margin) {
+            margin->phase_margin = pm;
+        }
+    }
+    if (ph0 > -PI && ph1 <= -PI) {
+        t = (ph0 + PI) / (ph0 - ph1);
+        lg = lg0 + t * (lg1 - lg0);
+        if (lg < 0.0f) {
+            gm = -20.0f * lg / logf(10.0f);
+            if (gm < margin->gain_margin) {
+                margin->gain_margin = gm;
+            }
+        }
+    }
+}
+
+void cascade_tune_model_margin(const sys_id_fit_t *fit, float32_t kp, float32_t wi, float32_t f_min,
+                               float32_t dt, float32_t *crossover, float32_t *phase_margin,
+                               float32_t *gain_margin) {
+    cascade_margin_t margin = {0.0f, 180.0f, CASCADE_TUNE_GM_INF};
+    float32_t f_max = 0.5f / dt;
+    float32_t ratio = powf(f_max / f_min, 1.0f / (float32_t) (CASCADE_TUNE_GRID_NUM - 1));
+    float32_t f = f_min, last_f = 0.0f, last_g = 0.0f, last_ph = 0.0f;
+    float32_t g, ph, c_g, c_ph;
+    uint16_t i;
+
+    for (i = 0; i < CASCADE_TUNE_GRID_NUM; i++, f *= ratio) {
+        sys_id_model_response(fit, f, &g, &ph);
+        cascade_tune_pi_response(kp, wi, CASCADE_TUNE_2PI * f, &c_g, &c_ph);
+        g *= c_g;
+        ph += c_ph;
+        if (i > 0) {
+            cascade_tune_crossing(last_f, last_g, last_ph, f, g, ph, &margin);
+        }
+        last_f = f;
+        last_g = g;
+        last_ph = ph;
+    }
+    //到奈奎斯特频率仍未穿越,离散后必然不稳定
+    if (last_g >= 1.0f) {
+        margin.crossover = f_max;
+        margin.phase_margin = 0.0f;
+    }
+    *crossover = margin.crossover;
+    *phase_margin = margin.phase_margin;
+    *gain_margin = margin.gain_margin;
+}
+
+void cascade_tune_point_margin(const sys_id_point_t *point, uint8_t num, float32_t min_quality,
+                               float32_t sign, float32_t kp, float32_t wi, float32_t *crossover,
+                               float32_t *phase_margin, float32_t *gain_margin) {
+    cascade_margin_t margin = {0.0f, 180.0f, CASCADE_TUNE_GM_INF};
+    float32_t last_f = 0.0f, last_g = 0.0f, last_ph = 0.0f, shift = 0.0f;
+    float32_t g, ph, c_g, c_ph;
+    uint8_t i, used = 0;
+
+    for (i = 0; i < num; i++) {
+        if (point[i].quality < min_quality || point[i].gain <= 0.0f) {
+            continue;
+        }
+        cascade_tune_pi_response(kp, wi, CASCADE_TUNE_2PI * point[i].freq, &c_g, &c_ph);
+        g = point[i].gain * c_g;
+        ph = point[i].phase + c_ph + ((sign < 0.0f) ? PI : 0.0f);
+        if (used == 0) {
+            //低频相位移到-270~90度之间,积分对象加PI在低频接近-180度
+            shift = -CASCADE_TUNE_2PI * floorf((ph + 1.5f * PI) / CASCADE_TUNE_2PI);
+        } else {
+            cascade_tune_crossing(last_f, last_g, last_ph, point[i].freq, g, ph + shift, &margin);
+        }
+        last_f = point[i].freq;
+        last_g = g;
+        last_ph = ph + shift;
+        used++;
+    }
+    if (used < 2 || last_g >= 1.0f) {
+        margin.crossover = -1.0f;
+    }
+    *crossover = margin.crossover;
+    *phase_margin = margin.phase_margin;
+    *gain_margin = margin.gain_margin;
+}
+
+/**
+  * @brief          所有增益参数的新值都已被控制循环使用
+  */
+static uint8_t cascade_tune_applied(const cascade_tune_t *tune) {
+    uint8_t i;
+
+    for (i = 0; i < tune->id_num; i++) {
+        if (tune->p_reg->pending[tune->id[i]]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief          整定结束,有通过的级时等待保存
+  */
+static void cascade_tune_finish(cascade_tune_t *tune) {
+    tune->state = (tune->accepted > 0) ? CASCADE_TUNE_SAVE : CASCADE_TUNE_FAILED;
+}
+
+/**
+  * @brief          当前级失败,已暂存新增益时暂存原增益并等待生效
+  */
+static void cascade_tune_fail(cascade_tune_t *tune, cascade_tune_error_e error) {
+    const cascade_stage_t *stage = &tune->stage[tune->stage_index];
+
+    if (tune->state == CASCADE_TUNE_IDENTIFY) {
+        sys_id_stop(&tune->sys_id);
+    }
+    if (stage->command != NULL) {
+        *stage->command = stage->offset;
+    }
+    tune->result[tune->stage_index].error = error;
+    tune->error = error;
+    tune->stage_done++;
+    if (tune->staged &&
+        param_registry_stage(tune->p_reg, tune->id, tune->backup, tune->id_num, NULL) == PARAM_OK) {
+        tune->staged = 0;
+        tune->tick = 0;
+        tune->state = CASCADE_TUNE_ROLLBACK;
+        return;
+    }
+    cascade_tune_finish(tune);
+}
+
+/**
+  * @brief          当前级通过,开始下一级
+  */
+static void cascade_tune_accept(cascade_tune_t *tune) {
+    *tune->stage[tune->stage_index].command = tune->stage[tune->stage_index].offset;
+    tune->result[tune->stage_index].error = CASCADE_TUNE_OK;
+    tune->staged = 0;
+    tune->accepted++;
+    tune->stage_done++;
+    tune->stage_index++;
+    if (tune->stage_index >= tune->stage_num) {
+        cascade_tune_finish(tune);
+        return;
+    }
+    cascade_tune_start_stage(tune);
+}
+
+/**
+  * @brief          查找增益参数并备份原值,开始辨识
+  */
+static void cascade_tune_start_stage(cascade_tune_t *tune) {
+    const cascade_stage_t *stage = &tune->stage[tune->stage_index];
+    char name[PARAM_NAME_LEN];
+    uint8_t i, j;
+    int id, len;
+
+    memset(&tune->result[tune->stage_index], 0, sizeof(cascade_stage_result_t));
+    tune->staged = 0;
+    tune->id_num = 0;
+    if (stage->param_num == 0 || stage->param_num > CASCADE_TUNE_MAX_COPY || stage->pid == NULL ||
+        stage->feedback == NULL || stage->command == NULL || stage->step == 0.0f || stage->verify_time <= 0.0f ||
+        (stage->feedback_sign != 1.0f && stage->feedback_sign != -1.0f) || stage->pid->D_First ||
+        stage->pid->P_On_M) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_PARAM);
+        return;
+    }
+    for (i = 0; i < stage->param_num; i++) {
+        for (j = 0; j < 3; j++) {
+            len = snprintf(name, sizeof(name), "%s_%s", stage->param[i], cascade_gain_suffix[j]);
+            id = param_registry_find(tune->p_reg, name);
+            if (len >= (int) sizeof(name) || id < 0) {
+                cascade_tune_fail(tune, CASCADE_TUNE_ERR_PARAM);
+                return;
+            }
+            tune->id[tune->id_num] = (uint8_t) id;
+            param_registry_get(tune->p_reg, (uint8_t) id, &tune->backup[tune->id_num]);
+            tune->id_num++;
+        }
+    }
+    if (sys_id_init(&tune->sys_id, stage->feedback, stage->command, stage->mode, stage->model, stage->offset,
+                    stage->amplitude, stage->f_start, stage->f_end, stage->point_num, stage->input_limit,
+                    tune->dt) != 0) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_PARAM);
+        return;
+    }
+    *tune->tune_type = stage->inject;
+    tune->state = CASCADE_TUNE_IDENTIFY;
+}
+
+/**
+  * @brief          辨识完成,检查模型并确定穿越频率的尝试范围
+  */
+static void cascade_tune_identified(cascade_tune_t *tune) {
+    const cascade_stage_t *stage = &tune->stage[tune->stage_index];
+    const sys_id_t *id = &tune->sys_id;
+    float32_t f_high = 0.0f;
+    uint8_t i;
+
+    if (id->fit.valid != 0) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_FIT);
+        return;
+    }
+    tune->plant = id->fit;
+    tune->plant.gain *= stage->feedback_sign;
+    if (tune->plant.gain <= 0.0f) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_SIGN);
+        return;
+    }
+    tune->f_low = 0.0f;
+    for (i = 0; i < id->point_done; i++) {
+        if (id->point[i].quality < id->min_quality) {
+            continue;
+        }
+        if (tune->f_low == 0.0f) {
+            tune->f_low = id->point[i].freq;
+        }
+        f_high = id->point[i].freq;
+    }
+    tune->wc = CASCADE_TUNE_2PI * f_high * CASCADE_TUNE_WC_START;
+    tune->wc_min = CASCADE_TUNE_2PI * tune->f_low;
+    tune->model_ok = 0;
+    if (tune->wc < tune->wc_min) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_DESIGN);
+        return;
+    }
+    tune->state = CASCADE_TUNE_DESIGN;
+}
+
+/**
+  * @brief          试一个穿越频率,模型和测量点上的裕度都满足时暂存增益
+  */
+static void cascade_tune_design(cascade_tune_t *tune) {
+    const cascade_stage_t *stage = &tune->stage[tune->stage_index];
+    cascade_stage_result_t *result = &tune->result[tune->stage_index];
+    float32_t g, ph, kp, wi, scale, meas_crossover;
+    param_value_t value[CASCADE_TUNE_MAX_COPY * 3];
+    uint8_t i;
+
+    //|C(jwc)| |G(jwc)| = 1, |C(jwc)| = kp sqrt(1 + 1 / pi_ratio^2)
+    sys_id_model_response(&tune->plant, tune->wc / CASCADE_TUNE_2PI, &g, &ph);
+    scale = (stage->pi_ratio > 0.0f) ? sqrtf(1.0f + 1.0f / (stage->pi_ratio * stage->pi_ratio)) : 1.0f;
+    kp = 1.0f / (g * scale);
+    if (stage->kp_max > 0.0f && kp > stage->kp_max) {
+        kp = stage->kp_max;
+    }
+    wi = (stage->pi_ratio > 0.0f) ? tune->wc / stage->pi_ratio : 0.0f;
+
+    result->kp = kp;
+    result->ki = kp * wi * tune->dt;
+    result->kd = 0.0f;
+    cascade_tune_model_margin(&tune->plant, kp, wi, tune->f_low, tune->dt, &result->crossover,
+                              &result->phase_margin, &result->gain_margin);
+    cascade_tune_point_margin(tune->sys_id.point, tune->sys_id.point_done, tune->sys_id.min_quality,
+                              stage->feedback_sign, kp, wi, &meas_crossover, &result->meas_phase_margin,
+                              &result->meas_gain_margin);
+    if (result->phase_margin >= stage->phase_margin && result->gain_margin >= stage->gain_margin) {
+        tune->model_ok = 1;
+        //穿越频率须在测量范围内,测量点上的裕度允许比模型略低
+        if (meas_crossover > 0.0f && result->meas_phase_margin >= stage->phase_margin - CASCADE_TUNE_MARGIN_TOL &&
+            result->meas_gain_margin >= stage->gain_margin - CASCADE_TUNE_MARGIN_TOL) {
+            for (i = 0; i < tune->id_num; i += 3) {
+                value[i].f = result->kp;
+                value[i + 1].f = result->ki;
+                value[i + 2].f = result->kd;
+            }
+            if (param_registry_stage(tune->p_reg, tune->id, value, tune->id_num, NULL) != PARAM_OK) {
+                cascade_tune_fail(tune, CASCADE_TUNE_ERR_APPLY);
+                return;
+            }
+            tune->staged = 1;
+            tune->tick = 0;
+            tune->state = CASCADE_TUNE_APPLY;
+            return;
+        }
+    }
+    tune->wc *= CASCADE_TUNE_WC_STEP;
+    if (tune->wc < tune->wc_min) {
+        cascade_tune_fail(tune, tune->model_ok ? CASCADE_TUNE_ERR_MARGIN : CASCADE_TUNE_ERR_DESIGN);
+    }
+}
+
+/**
+  * @brief          闭环阶跃验证一步:保持, 正阶跃, 负阶跃, 回到原值.速度环正负阶跃后位置基本回到原处.
+  *                 每次阶跃按设定值的变化量归一化计算超调和最后四分之一时间的误差
+  */
+static void cascade_tune_verify(cascade_tune_t *tune) {
+    const cascade_stage_t *stage = &tune->stage[tune->stage_index];
+    cascade_stage_result_t *result = &tune->result[tune->stage_index];
+    uint32_t hold_num = (uint32_t) (CASCADE_TUNE_HOLD_TIME / tune->dt + 0.5f);
+    uint32_t step_num = (uint32_t) (stage->verify_time / tune->dt + 0.5f);
+    float32_t y = stage->feedback_sign * *stage->feedback;
+    float32_t set = tune->y0, from = tune->y0;
+    float32_t e;
+    uint32_t k;
+
+    if (stage->input_limit > 0.0f && fabsf(*stage->feedback) > stage->input_limit) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_LIMIT);
+        return;
+    }
+    if (tune->tick >= hold_num && tune->tick < hold_num + 2U * step_num) {
+        if (tune->tick < hold_num + step_num) {
+            set = tune->y0 + stage->step;
+        } else {
+            from = tune->y0 + stage->step;
+            set = tune->y0 - stage->step;
+        }
+        //阶跃后第一个反馈仍是阶跃前给定的结果
+        k = (tune->tick - hold_num) % step_num;
+        if (k > 0U) {
+            e = (y - from) / (set - from);
+            if (e > tune->peak) {
+                tune->peak = e;
+            }
+            if (k >= step_num - step_num / 4U) {
+                tune->err_sum += fabsf(1.0f - e);
+                tune->err_num++;
+            }
+        }
+    }
+    *stage->command = stage->offset + ALL_PID(stage->pid, y, set);
+    tune->tick++;
+    if (tune->tick < 2U * (hold_num + step_num)) {
+        return;
+    }
+    result->overshoot = (tune->peak > 1.0f) ? tune->peak - 1.0f : 0.0f;
+    result->final_error = (tune->err_num > 0U) ? tune->err_sum / (float32_t) tune->err_num : 1.0f;
+    if (result->overshoot > CASCADE_TUNE_MAX_OVERSHOOT || result->final_error > CASCADE_TUNE_MAX_ERROR) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_RESPONSE);
+        return;
+    }
+    cascade_tune_accept(tune);
+}
+
+int cascade_tune_init(cascade_tune_t *tune, const cascade_stage_t *stage, uint8_t stage_num,
+                      param_registry_t *p_reg, pid_auto_tune_control_e *tune_type, float32_t dt) {
+    if (tune == NULL || stage == NULL || p_reg == NULL || tune_type == NULL || stage_num == 0 ||
+        stage_num > CASCADE_TUNE_MAX_STAGE || dt <= 0.0f) {
+        return -1;
+    }
+    memset(tune, 0, sizeof(cascade_tune_t));
+    tune->stage = stage;
+    tune->stage_num = stage_num;
+    tune->p_reg = p_reg;
+    tune->tune_type = tune_type;
+    tune->dt = dt;
+    tune->state = CASCADE_TUNE_IDLE;
+    return 0;
+}
+
+cascade_tune_state_e cascade_tune_update(cascade_tune_t *tune) {
+    const cascade_stage_t *stage;
+    sys_id_state_e id_state;
+
+    switch (tune->state) {
+        case CASCADE_TUNE_IDLE:
+            tune->stage_index = 0;
+            cascade_tune_start_stage(tune);
+            break;
+        case CASCADE_TUNE_IDENTIFY:
+            id_state = sys_id_update(&tune->sys_id);
+            if (id_state == SYS_ID_ABORT) {
+                cascade_tune_fail(tune, CASCADE_TUNE_ERR_IDENTIFY);
+            } else if (id_state == SYS_ID_DONE) {
+                cascade_tune_identified(tune);
+            }
+            break;
+        case CASCADE_TUNE_DESIGN:
+            cascade_tune_design(tune);
+            break;
+        case CASCADE_TUNE_APPLY:
+            if (cascade_tune_applied(tune)) {
+                stage = &tune->stage[tune->stage_index];
+                PID_clear(stage->pid);
+                tune->y0 = stage->feedback_sign * *stage->feedback;
+                tune->peak = 0.0f;
+                tune->err_sum = 0.0f;
+                tune->err_num = 0;
+                tune->tick = 0;
+                tune->state = CASCADE_TUNE_VERIFY;
+            } else if ((float32_t) (++tune->tick) * tune->dt > CASCADE_TUNE_APPLY_TIMEOUT) {
+                cascade_tune_fail(tune, CASCADE_TUNE_ERR_APPLY);
+            }
+            break;
+        case CASCADE_TUNE_VERIFY:
+            cascade_tune_verify(tune);
+            break;
+        case CASCADE_TUNE_ROLLBACK:
+            //超时也结束,原增益仍在暂存中,控制循环恢复后生效
+            if (cascade_tune_applied(tune) ||
+                (float32_t) (++tune->tick) * tune->dt > CASCADE_TUNE_APPLY_TIMEOUT) {
+                cascade_tune_finish(tune);
+            }
+            break;
+        default:
+            break;
+    }
+    return tune->state;
+}
+
+void cascade_tune_save_done(cascade_tune_t *tune, uint8_t ok) {
+    if (tune->state != CASCADE_TUNE_SAVE) {
+        return;
+    }
+    if (!ok) {
+        tune->error = CASCADE_TUNE_ERR_SAVE;
+    }
+    tune->state = (tune->error == CASCADE_TUNE_OK) ? CASCADE_TUNE_DONE : CASCADE_TUNE_FAILED;
+}
+
+void cascade_tune_stop(cascade_tune_t *tune) {
+    if (tune->state == CASCADE_TUNE_IDENTIFY || tune->state == CASCADE_TUNE_DESIGN ||
+        tune->state == CASCADE_TUNE_APPLY || tune->state == CASCADE_TUNE_VERIFY) {
+        cascade_tune_fail(tune, CASCADE_TUNE_ERR_STOP);
+    }
+    //不等待原增益生效
+    if (tune->state == CASCADE_TUNE_ROLLBACK) {
+        cascade_tune_finish(tune);
+    }
+}
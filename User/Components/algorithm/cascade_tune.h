@@ -0,0 +1,223 @@
+/**
+  * @file       cascade_tune.c/h
+  * @brief      sequencer that tunes a cascade of PID loops from the inner loop
+  *             outwards. Every stage identifies its plant with sys_id, designs a
+  *             PI for the largest crossover that keeps the phase and gain margins
+  *             on the fitted model and checks the margins again on the measured
+  *             points. The gains are applied through the parameter registry and
+  *             the loop is closed for a +step / -step test, so a speed loop ends
+  *             close to where it started. A stage that fails is rolled back and
+  *             ends the run. The next stage is identified with the new inner
+  *             gains in place.
+  *             串级PID由内环到外环的自动整定.每一级用sys_id辨识对象,按拟合模型在满足相位
+  *             裕度和增益裕度的前提下取最大的穿越频率设计PI,再用测量点复核裕度.增益通过
+  *             参数表生效后闭环做正负阶跃验证,速度环验证后位置基本回到原处.失败的一级回滚
+  *             并结束整定.外环辨识时内环已使用新的增益
+  * @note       the PI is Kp (1 + wi / s) with wi = wc / pi_ratio, written as the
+  *             per sample gains of ALL_PID: ki = kp * wi * dt, kd = 0. The
+  *             controlled loops have to run at the same period dt as the
+  *             sequencer. The plant seen by the PID is feedback_sign * G, its
+  *             gain has to be positive.
+  *             The sequencer stops in CASCADE_TUNE_SAVE when at least one stage
+  *             was accepted, the caller saves the parameter set and reports with
+  *             cascade_tune_save_done.
+  *             PI为Kp (1 + wi / s), wi = wc / pi_ratio, 按ALL_PID的每周期增益写入:
+  *             ki = kp * wi * dt, kd = 0.被整定的控制循环周期须与整定周期dt相同.
+  *             PID看到的对象为feedback_sign * G,其增益须为正.
+  *             至少一级通过时停在CASCADE_TUNE_SAVE,由调用者保存参数组后调用
+  *             cascade_tune_save_done
+  */
+#ifndef CASCADE_TUNE_H
+#define CASCADE_TUNE_H
+
+#include "struct_typedef.h"
+#include "sys_id.h"
+#include "pid.h"
+#include "PID_AutoTune.h"
+#include "param_registry.h"
+
+#define CASCADE_TUNE_MAX_STAGE      4
+#define CASCADE_TUNE_MAX_COPY       4           //同一组增益写入的pid数量,例如四个底盘电机
+#define CASCADE_TUNE_MARGIN_TOL     5.0f        //测量点复核裕度时允许比设计值低的量, deg或dB
+#define CASCADE_TUNE_MAX_OVERSHOOT  0.4f        //验证阶跃的最大超调, 相对设定值变化量
+#define CASCADE_TUNE_MAX_ERROR      0.15f       //验证阶跃最后四分之一时间的最大平均误差, 相对设定值变化量
+#define CASCADE_TUNE_APPLY_TIMEOUT  0.2f        //等待控制循环使用新增益的最长时间 s
+#define CASCADE_TUNE_HOLD_TIME      0.3f        //验证阶跃前后保持设定值的时间 s
+#define CASCADE_TUNE_WC_START       0.5f        //第一个尝试的穿越频率, 相对最高测量频率
+#define CASCADE_TUNE_WC_STEP        0.9f        //每次尝试后穿越频率缩小的比例
+#define CASCADE_TUNE_GRID_NUM       120         //模型裕度计算的频率点数
+#define CASCADE_TUNE_GM_INF         100.0f      //相位未到-180度时的增益裕度 dB
+
+typedef enum {
+    CASCADE_TUNE_IDLE = 0,
+    CASCADE_TUNE_IDENTIFY,                      //sys_id辨识对象
+    CASCADE_TUNE_DESIGN,                        //每步试一个穿越频率
+    CASCADE_TUNE_APPLY,                         //等待新增益生效
+    CASCADE_TUNE_VERIFY,                        //闭环阶跃验证
+    CASCADE_TUNE_ROLLBACK,                      //等待原增益恢复
+    CASCADE_TUNE_SAVE,                          //等待调用者保存参数组
+    CASCADE_TUNE_DONE,
+    CASCADE_TUNE_FAILED,
+} cascade_tune_state_e;
+
+typedef enum {
+    CASCADE_TUNE_OK = 0,
+    CASCADE_TUNE_ERR_PARAM,                     //增益不在参数表中, pid开了微分先行或P_On_M, 或参数错误
+    CASCADE_TUNE_ERR_IDENTIFY,                  //辨识中反馈超限或被停止
+    CASCADE_TUNE_ERR_FIT,                       //模型拟合失败
+    CASCADE_TUNE_ERR_SIGN,                      //对象增益为负, 检查feedback_sign
+    CASCADE_TUNE_ERR_DESIGN,                    //没有满足裕度的穿越频率
+    CASCADE_TUNE_ERR_MARGIN,                    //测量点上裕度不足或穿越频率超出测量范围
+    CASCADE_TUNE_ERR_APPLY,                     //参数表拒绝或控制循环未使用新增益
+    CASCADE_TUNE_ERR_LIMIT,                     //验证中反馈超限
+    CASCADE_TUNE_ERR_RESPONSE,                  //验证阶跃超调过大或未稳定
+    CASCADE_TUNE_ERR_SAVE,                      //保存参数组失败
+    CASCADE_TUNE_ERR_STOP,                      //被外部停止
+} cascade_tune_error_e;
+
+typedef struct {
+    //增益参数名前缀,加_kp _ki _kd, 第一个为验证时闭环的pid
+    const char *param[CASCADE_TUNE_MAX_COPY];
+    uint8_t param_num;
+    pid_type_def *pid;                          //param[0]对应的pid
+    const float32_t *feedback;
+    float32_t feedback_sign;                    //pid的反馈为feedback_sign * feedback
+    float32_t *command;                         //激励和验证时pid输出写入的给定, control_list成员
+    pid_auto_tune_control_e inject;             //给定注入的位置
+    //辨识
+    sys_id_mode_e mode;
+    sys_id_model_e model;
+    float32_t offset;
+    float32_t amplitude;
+    float32_t f_start, f_end;                   //Hz
+    uint8_t point_num;
+    float32_t input_limit;                      //反馈绝对值超出时失败, 0不检查
+    //设计
+    float32_t pi_ratio;                         //wc / wi, 0为纯P
+    float32_t phase_margin;                     //最小相位裕度 deg
+    float32_t gain_margin;                      //最小增益裕度 dB
+    float32_t kp_max;
+    //验证
+    float32_t step;                             //设定值先到y0 + step再到y0 - step, 反馈单位
+    float32_t verify_time;                      //正负阶跃各自的保持时间 s
+} cascade_stage_t;
+
+typedef struct {
+    uint8_t error;                              //cascade_tune_error_e
+    float32_t kp, ki, kd;                       //写入的增益
+    float32_t crossover;                        //Hz
+    float32_t phase_margin, gain_margin;        //模型上的裕度 deg dB, 增益裕度100为无穷
+    float32_t meas_phase_margin, meas_gain_margin;  //测量点上的裕度, 增益裕度100为测量范围内未到-180度
+    float32_t overshoot;                        //验证阶跃的最大超调
+    float32_t final_error;                      //验证阶跃最后四分之一时间的平均误差
+} cascade_stage_result_t;
+
+typedef struct {
+    const cascade_stage_t *stage;
+    uint8_t stage_num;
+    param_registry_t *p_reg;
+    pid_auto_tune_control_e *tune_type;         //选择给定注入位置
+    float32_t dt;
+
+    cascade_tune_state_e state;
+    uint8_t stage_index;
+    uint8_t stage_done;                         //已结束的级数,结果在result中
+    uint8_t accepted;                           //通过的级数
+    uint8_t error;                              //结束原因, cascade_tune_error_e
+    sys_id_t sys_id;
+    cascade_stage_result_t result[CASCADE_TUNE_MAX_STAGE];
+
+    //当前级
+    uint8_t id[CASCADE_TUNE_MAX_COPY * 3];      //增益参数编号
+    param_value_t backup[CASCADE_TUNE_MAX_COPY * 3];    //整定前的增益
+    uint8_t id_num;
+    uint8_t staged;                             //新增益已暂存,失败时需要回滚
+    uint8_t model_ok;                           //有穿越频率在模型上满足裕度
+    sys_id_fit_t plant;                         //PID看到的对象模型, 增益为正
+    float32_t f_low;                            //最低有效测量频率 Hz
+    float32_t wc;                               //设计时当前尝试的穿越频率 rad/s
+    float32_t wc_min;
+    uint32_t tick;                              //当前阶段已用的周期数
+    float32_t y0;                               //验证开始时的反馈
+    float32_t peak;                             //验证阶跃中归一化响应的最大值
+    float32_t err_sum;
+    uint32_t err_num;
+} cascade_tune_t;
+
+/**
+  * @brief          init the sequencer, the first stage starts at the next
+  *                 cascade_tune_update
+  * @param[out]     tune: sequencer
+  * @param[in]      stage: stages, inner loop first
+  * @param[in]      stage_num: 1 ~ CASCADE_TUNE_MAX_STAGE
+  * @param[in]      p_reg: registry holding the gains
+  * @param[in]      tune_type: selects where the command is injected
+  * @param[in]      dt: update period, the period of the tuned loops, s
+  * @retval         0: ok, -1: bad argument
+  */
+/**
+  * @brief          初始化整定,下一次调用cascade_tune_update时开始第一级
+  * @param[out]     tune: 整定数据
+  * @param[in]      stage: 各级, 内环在前
+  * @param[in]      stage_num: 1 ~ CASCADE_TUNE_MAX_STAGE
+  * @param[in]      p_reg: 增益所在的参数表
+  * @param[in]      tune_type: 选择给定注入位置
+  * @param[in]      dt: 调用周期, 即被整定循环的周期 s
+  * @retval         0:成功, -1:参数错误
+  */
+extern int cascade_tune_init(cascade_tune_t *tune, const cascade_stage_t *stage, uint8_t stage_num,
+                             param_registry_t *p_reg, pid_auto_tune_control_e *tune_type, float32_t dt);
+
+/**
+  * @brief          运行一步
+  * @retval         cascade_tune_state_e
+  */
+extern cascade_tune_state_e cascade_tune_update(cascade_tune_t *tune);
+
+/**
+  * @brief          参数组保存完成后调用
+  * @param[in]      ok: 1保存成功
+  */
+extern void cascade_tune_save_done(cascade_tune_t *tune, uint8_t ok);
+
+/**
+  * @brief          停止整定,当前级回滚
+  */
+extern void cascade_tune_stop(cascade_tune_t *tune);
+
+/**
+  * @brief          margins of a PI around the fitted model, evaluated from f_min
+  *                 up to 1 / (2 dt)
+  * @param[in]      fit: model of the plant seen by the PID, gain positive
+  * @param[in]      kp: proportional gain
+  * @param[in]      wi: PI zero, rad/s, 0 for P
+  * @param[out]     crossover: Hz, 0 when the gain is below 1 at f_min
+  * @param[out]     phase_margin: deg
+  * @param[out]     gain_margin: dB, 100 when the phase stays above -180
+  * @retval         none
+  */
+/**
+  * @brief          PI与拟合模型组成的开环的裕度,频率范围f_min到1 / (2 dt)
+  * @param[in]      fit: PID看到的对象模型, 增益为正
+  * @param[in]      kp: 比例增益
+  * @param[in]      wi: PI零点 rad/s, 0为纯P
+  * @param[out]     crossover: 穿越频率 Hz, f_min处增益已小于1时为0
+  * @param[out]     phase_margin: 相位裕度 deg
+  * @param[out]     gain_margin: 增益裕度 dB, 相位未到-180度时为100
+  * @retval         none
+  */
+extern void cascade_tune_model_margin(const sys_id_fit_t *fit, float32_t kp, float32_t wi, float32_t f_min,
+                                      float32_t dt, float32_t *crossover, float32_t *phase_margin,
+                                      float32_t *gain_margin);
+
+/**
+  * @brief          PI与测量点组成的开环的裕度
+  * @param[in]      sign: 1或-1, PID看到的对象为sign * G
+  * @param[out]     crossover: Hz, 开环增益在最后一个点仍大于1时为-1
+  * @retval         none
+  */
+extern void cascade_tune_point_margin(const sys_id_point_t *point, uint8_t num, float32_t min_quality,
+                                      float32_t sign, float32_t kp, float32_t wi, float32_t *crossover,
+                                      float32_t *phase_margin, float32_t *gain_margin);
+
+#endif
@@ -139,7 +139,7 @@ void second_order_kalman_filter_init(kalman_filter_t *F, kalman_filter_init_t *I
 */
 float32_t *second_order_kalman_filter_calc(kalman_filter_t *F, float32_t signal1, float32_t signal2) {
     matrix_f32_t _temp_M;
-    Matrix_vinit_f32(&_temp_M);
+    Matrix_vinit_static_f32(&_temp_M, &F->temp_buffer);
 
     F->z.arm_matrix.pData[0] = signal1; //z(k)
     F->z.arm_matrix.pData[1] = signal2; //z(k)
@@ -5,7 +5,6 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdint.h>
-#include "stm32f4xx.h"
 #include "arm_math.h"
 #include "matrix.h"
 
@@ -59,6 +58,7 @@ typedef struct {
     float32_t raw_value;
     float32_t filtered_value[2];
     matrix_f32_t xhat, xhatminus, z, A, H, AT, HT, Q, R, P, Pminus, K;
+    matrix_buffer_f32_t temp_buffer; //计算中间量,避免每次滤波都申请堆内存
 } kalman_filter_t;
 
 typedef struct {
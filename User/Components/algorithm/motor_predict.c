@@ -0,0 +1,40 @@
+/**
+  * @file       motor_predict.c/h
+  * @brief      forward prediction of motor feedback.
+  *             电机反馈前向预测
+  */
+#include "motor_predict.h"
+#include <stddef.h>
+
+void motor_predict_init(motor_predict_t *predict, uint8_t enable, float32_t accel_gain, float32_t damping,
+                        float32_t max_dt) {
+    if (predict == NULL) {
+        return;
+    }
+    predict->enable = enable;
+    predict->accel_gain = accel_gain;
+    predict->damping = damping;
+    predict->max_dt = max_dt;
+    predict->dt = 0.0f;
+    predict->angle_delta = 0.0f;
+}
+
+void motor_predict(motor_predict_t *predict, float32_t current, float32_t dt, float32_t *angle, float32_t *speed) {
+    float32_t accel;
+
+    if (predict == NULL || speed == NULL) {
+        return;
+    }
+    predict->dt = dt;
+    predict->angle_delta = 0.0f;
+    if (!predict->enable || dt <= 0.0f || dt > predict->max_dt) {
+        return;
+    }
+    //dt远小于机械时间常数,按匀加速外推
+    accel = predict->accel_gain * current - predict->damping * (*speed);
+    predict->angle_delta = (*speed) * dt + 0.5f * accel * dt * dt;
+    *speed += accel * dt;
+    if (angle != NULL) {
+        *angle += predict->angle_delta;
+    }
+}
@@ -0,0 +1,76 @@
+/**
+  * @file       motor_predict.c/h
+  * @brief      forward prediction of motor feedback. A CAN feedback frame is
+  *             already dt old when the control loop uses it, the angle and speed
+  *             are moved forward by dt with the last applied current and a first
+  *             order motor model: a = accel_gain * current - damping * speed.
+  *             电机反馈前向预测.控制周期使用CAN反馈帧时该帧已经过去dt,用上一次输出的
+  *             电流和一阶电机模型 a = accel_gain * current - damping * speed 把角度和
+  *             速度外推dt,补偿反馈延迟
+  * @note       accel_gain and damping describe the output shaft: accel_gain is the
+  *             acceleration (rad/s^2) per unit of the CAN current command at zero
+  *             speed, damping is the inverse of the mechanical time constant (1/s),
+  *             accel_gain / damping is the steady speed per command unit. Samples
+  *             older than max_dt are used as they are (motor offline or frame lost).
+  *             参数均为输出轴上的值: accel_gain为零速时每单位CAN电流命令产生的角加速度
+  *             (rad/s^2), damping为机械时间常数的倒数(1/s), accel_gain / damping为
+  *             每单位命令的稳态转速.超过max_dt的旧数据(电机离线或丢帧)不做预测
+  */
+#ifndef MOTOR_PREDICT_H
+#define MOTOR_PREDICT_H
+
+#include "struct_typedef.h"
+
+typedef struct {
+    uint8_t enable;
+    float32_t accel_gain;   //rad/s^2 每单位电流命令
+    float32_t damping;      //1/s
+    float32_t max_dt;       //s, 超过不预测
+    //调试
+    float32_t dt;           //最近一次预测的时间
+    float32_t angle_delta;  //最近一次预测的角度增量
+} motor_predict_t;
+
+/**
+  * @brief          init the predictor
+  * @param[out]     predict: predictor
+  * @param[in]      enable: 0 bypass
+  * @param[in]      accel_gain: rad/s^2 per current command unit
+  * @param[in]      damping: 1/s
+  * @param[in]      max_dt: samples older than this are not predicted, s
+  * @retval         none
+  */
+/**
+  * @brief          初始化预测器
+  * @param[out]     predict: 预测器
+  * @param[in]      enable: 0不预测
+  * @param[in]      accel_gain: 每单位电流命令的角加速度, rad/s^2
+  * @param[in]      damping: 阻尼, 1/s
+  * @param[in]      max_dt: 超过该时间的数据不预测, s
+  * @retval         none
+  */
+extern void motor_predict_init(motor_predict_t *predict, uint8_t enable, float32_t accel_gain, float32_t damping,
+                               float32_t max_dt);
+
+/**
+  * @brief          predict angle and speed dt forward
+  * @param[in]      predict: predictor
+  * @param[in]      current: last applied current command, same direction as speed
+  * @param[in]      dt: age of the feedback sample, s
+  * @param[in,out]  angle: angle of the sample, rad, may be NULL
+  * @param[in,out]  speed: speed of the sample, rad/s
+  * @retval         none
+  */
+/**
+  * @brief          把角度和速度向前预测dt
+  * @param[in]      predict: 预测器
+  * @param[in]      current: 上一次输出的电流命令,与速度同向
+  * @param[in]      dt: 反馈数据的年龄, s
+  * @param[in,out]  angle: 数据的角度, rad, 可为NULL
+  * @param[in,out]  speed: 数据的速度, rad/s
+  * @retval         none
+  */
+extern void motor_predict(motor_predict_t *predict, float32_t current, float32_t dt, float32_t *angle,
+                          float32_t *speed);
+
+#endif
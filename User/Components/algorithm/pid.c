@@ -17,8 +17,6 @@
 
 #include "pid.h"
 #include "main.h"
-#include "gimbal_task.h"
-#include "chassis_task.h"
 #include "print_task.h"
 #include "USER_Filter.h"
 #include "SEGGER_RTT.h"
@@ -27,6 +25,8 @@
 
 //#define abs(x) ((x) > 0 ? (x) : (-x))
 
+#define PID_RESET_GAP_MAX   294967295U      //hal_tick与当前时间的间隔超过该值视为hal_tick更晚
+
 /**
   * @brief          pid struct data init
   * @param[out]     pid: PID结构数据指针
@@ -71,7 +71,9 @@ void PID_init(pid_type_def *pid, uint8_t mode, const float32_t PID[3], float32_t
     pid->D_KF = D_KF;
 
     pid->hal_tick = HAL_GetTick();
-
+    pid->wrap = PID_WRAP_NONE;
+    pid->reset_time = PID_RESET_TIME;
+    PID_refresh(pid);
 }
 
 /**
@@ -203,93 +205,79 @@ float ClassisFollow_PID(positionpid_t *pid_t, float target, float measured) {
 /**************************************************/
 
 float ALL_PID(pid_type_def *pid, float32_t ref, float32_t set) {
-    float32_t Dout_temp;
-    if (pid == NULL) {
+    if (pid == NULL || pid->step == NULL) {
         return 0.0f;
     }
-    if ((HAL_GetTick() - pid->hal_tick) > 90 && (HAL_GetTick() - pid->hal_tick) < 294967295) {
+    return pid->step(pid, ref, set);
+}
+
+/**
+  * @brief          长时间未计算时积分从上次输出重新开始
+  */
+static inline void PID_restart(pid_type_def *pid, float32_t ref, uint32_t now) {
+    uint32_t gap = now - pid->hal_tick;
+
+    //间隔过大说明hal_tick晚于当前时间, 不重新开始
+    if (gap > pid->reset_time && gap < PID_RESET_GAP_MAX) {
         pid->last_get = ref;
         pid->Iout = pid->out;
         LimitMax(pid->Iout, pid->max_iout);
     }
+}
+
+/**
+  * @brief          变积分系数, 误差小于Variable_I_Down时为1, 大于Variable_I_UP时为0
+  */
+static inline float32_t PID_variable_i_ratio(const pid_type_def *pid) {
+    if (fabsf(1000.0f * pid->error[0]) < (1000.0f * pid->Variable_I_Down)) {
+        return 1.0f;
+    } else if (fabsf(pid->error[0]) > pid->Variable_I_UP) {
+        return 0.0f;
+    }
+    return ((1000.0f * pid->Variable_I_UP) - fabsf(1000.0f * pid->error[0])) /
+           ((1000.0f * pid->Variable_I_UP) - (1000.0f * pid->Variable_I_Down));
+}
+
+/**
+  * @brief          支持所有功能开关的计算
+  */
+static float32_t PID_step_general(pid_type_def *pid, float32_t ref, float32_t set) {
+    float32_t Dout_temp;
+    float32_t KF_temp;
+    uint32_t now = 0U;
+
+    if (pid->reset_time) {
+        now = HAL_GetTick();
+        PID_restart(pid, ref, now);
+    }
     pid->set = set;
     pid->get = ref;
-    if ((pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid) ||
-        (pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_absolute_angle_pid) ||
-        (pid == &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid) ||
-        (pid == &gimbal_control.gimbal_pitch_motor.gimbal_motor_absolute_angle_pid) ||
-        (pid == &chassis_move.chassis_angle_pid)) {
-//        pid->error[0] = loop_fp32_constrain(set-ref,0,2*PI);
+    if (pid->wrap == PID_WRAP_ANGLE) {
         pid->error[0] = jump_error(pid->set - pid->get, 2 * PI);
-//        SEGGER_RTT_printf(0,"set=%f,ref=%f,err_fun=%f,err=%f\r\n",set,ref,pid->error[0],set-ref);
     } else {
         pid->error[0] = pid->set - pid->get;
     }
-//    if(chassis_mode_change_flag){
-//        if(pid == &chassis_move.chassis_angle_pid){
-//            pid->Iout =;
-//            pid->Pout = 0;
-//            pid->Dout = 0;
-//            chassis_mode_change_flag = 0;
-//        }
-//    }
-//探针
-//    if (pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_absolute_angle_pid) {//for_test
-//        if (chassis_behaviour_mode == CHASSIS_SPIN) {
-//            static uint16_t count = 0;
-//            if (spin_pid_change_flag) {
-//                pid->Kp = 117.039f;
-//                if(count>500){
-//                    spin_pid_change_flag = 0;
-//                    count = 0;
-//                }
-//                count++;
-//            }
-//        } else {
-//            pid->Kp = 11.7039f;
-//        }
-//        SEGGER_RTT_printf(0,"e=%f,set=%f,get=%f\r\n",pid->error[0],pid->set,pid->get);
-//    }
-//    if (pid == &gimbal_control.gimbal_pitch_motor.gimbal_motor_gyro_pid) {//for_test
-//        re_err = pid->error[0];
-//        SEGGER_RTT_SetTerminal(1);
-//        SEGGER_RTT_printf(0,"err=%f\r\n",pid->error[0]);
-//    }
+
     if (pid->Variable_I) {
         if ((pid->Variable_I_Down != 0.0 || pid->Variable_I_UP != 0.0) &&
             (pid->Variable_I_UP - pid->Variable_I_Down > 0)) {
-            if (fabsf(1000.0f * pid->error[0]) < (1000.0f * pid->Variable_I_Down)) {
-                pid->I_ratio = 1.0f;
-            } else if (fabsf(pid->error[0]) > pid->Variable_I_UP) {
-                pid->I_ratio = 0.0f;
-            } else {
-                pid->I_ratio = ((1000.0f * pid->Variable_I_UP) - fabsf(1000.0f * pid->error[0])) /
-                               ((1000.0f * pid->Variable_I_UP) - (1000.0f * pid->Variable_I_Down));
-            }
+            pid->I_ratio = PID_variable_i_ratio(pid);
         } else {
             pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
         }
         pid->Iout += pid->I_ratio * pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
     } else {
-        pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f; //pid->Iout += pid->Ki * pid->error[0];
+        pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
     }
 
-    if ((pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid) ||
-        (pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_absolute_angle_pid) ||
-        (pid == &gimbal_control.gimbal_pitch_motor.gimbal_motor_relative_angle_pid) ||
-        (pid == &gimbal_control.gimbal_pitch_motor.gimbal_motor_absolute_angle_pid) ||
-        (pid == &chassis_move.chassis_angle_pid)) {
-//        pid->error[0] = loop_fp32_constrain(set-ref,0,2*PI);
+    if (pid->wrap == PID_WRAP_ANGLE) {
         pid->Dbuf[0] = jump_error(pid->get - pid->last_get, 2 * PI);
-//        SEGGER_RTT_printf(0,"set=%f,ref=%f,err_fun=%f,err=%f\r\n",set,ref,pid->error[0],set-ref);
     } else {
         pid->Dbuf[0] = pid->get - pid->last_get;
     }
-//    pid->Dbuf[0] = (pid->error[0] - pid->error[1]);
     pid->Dbuf[2] = pid->Dbuf[1];
     pid->Dbuf[1] = pid->Dbuf[0];
 
-
     if (pid->D_First && !pid->NF_D) {
         float32_t D_operator = pid->D_Filter_Ratio * pid->Kd + pid->Kp;
         pid->D3 = pid->Kd / D_operator;
@@ -308,12 +296,11 @@ float ALL_PID(pid_type_def *pid, float32_t ref, float32_t set) {
         Filter_IIRLPF(Dout_temp, &pid->Dout, 1.0f);
     }
 
-    float32_t KF_temp;
     if (pid->D_Kalman.A == 1) {
         KF_temp = KalmanFilter(&pid->D_Kalman, pid->Dout);
-    }
-    if (pid->D_Kalman.A == 1 && pid->D_KF) {
-        pid->Dout = KF_temp;
+        if (pid->D_KF) {
+            pid->Dout = KF_temp;
+        }
     }
 
     if (pid->P_On_M) {
@@ -323,13 +310,6 @@ float ALL_PID(pid_type_def *pid, float32_t ref, float32_t set) {
         pid->Pout = pid->Kp * pid->error[0];
     }
 
-
-//for_test
-//    pid_out_probe += pid->out;
-//    pid_pout_probe += pid->Pout;
-//    pid_iout_probe += pid->Iout;
-//    pid_dout_probe += pid->Dout;
-
     //积分限幅
     LimitMax(pid->Iout, pid->max_iout); //积分输出的限幅。
 
@@ -343,28 +323,148 @@ float ALL_PID(pid_type_def *pid, float32_t ref, float32_t set) {
     //输出限幅
     LimitMax(pid->out, pid->max_out);
 
-    ////for_test
-//    if (pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_gyro_pid) {
-//        Dout1_test = pid->Dout;
-//        KF_Dout1_test = KalmanFilter(&pid->D_Kalman, pid->Dout);
-//    }
-//    if (pid == &gimbal_control.gimbal_yaw_motor.gimbal_motor_relative_angle_pid) {
-//        Dout2_test = pid->Dout;
-//        KF_Dout2_test = KalmanFilter(&pid->D_Kalman, pid->Dout);
-//        RTT_PrintWave_np(2,
-//                         Dout2_test,
-//                         KF_Dout2_test);
-//    }
-
-
     pid->last_get = pid->get;
 
     pid->error[2] = pid->error[1];
     pid->error[1] = pid->error[0];
 
     pid->Dout_Last = pid->Dout;
-    pid->hal_tick = HAL_GetTick();
+    if (pid->reset_time) {
+        pid->hal_tick = now;
+    }
     return pid->out;
 }
-/***********************************************************************/
 
+/**
+  * @brief          普通微分、梯形积分或变积分的计算, wrap和variable_i为常量, 编译时去掉不用的分支
+  */
+static inline float32_t PID_step_plain(pid_type_def *pid, float32_t ref, float32_t set, const bool wrap,
+                                       const bool variable_i) {
+    uint32_t now = 0U;
+
+    if (pid->reset_time) {
+        now = HAL_GetTick();
+        PID_restart(pid, ref, now);
+    }
+    pid->set = set;
+    pid->get = ref;
+    pid->error[0] = set - ref;
+    pid->Dbuf[0] = ref - pid->last_get;
+    if (wrap) {
+        pid->error[0] = jump_error(pid->error[0], 2 * PI);
+        pid->Dbuf[0] = jump_error(pid->Dbuf[0], 2 * PI);
+    }
+
+    if (variable_i) {
+        pid->I_ratio = PID_variable_i_ratio(pid);
+        pid->Iout += pid->I_ratio * pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
+    } else {
+        pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
+    }
+
+    pid->Dbuf[2] = pid->Dbuf[1];
+    pid->Dbuf[1] = pid->Dbuf[0];
+    //与系数为1的一阶滤波相同的写法, 结果与PID_step_general逐位相同
+    pid->Dout += pid->Kd * pid->Dbuf[0] - pid->Dout;
+    pid->Pout = pid->Kp * pid->error[0];
+
+    LimitMax(pid->Iout, pid->max_iout);
+    if (fabsf(pid->error[0]) <= pid->Integral_Separation) {
+        pid->Iout = 0;
+        pid->out = (pid->Pout - pid->Dout);
+    } else {
+        pid->out = (pid->Pout + pid->Iout - pid->Dout);
+    }
+    LimitMax(pid->out, pid->max_out);
+
+    pid->last_get = pid->get;
+    pid->error[2] = pid->error[1];
+    pid->error[1] = pid->error[0];
+    pid->Dout_Last = pid->Dout;
+    if (pid->reset_time) {
+        pid->hal_tick = now;
+    }
+    return pid->out;
+}
+
+static float32_t PID_step_trapezoid(pid_type_def *pid, float32_t ref, float32_t set) {
+    return PID_step_plain(pid, ref, set, false, false);
+}
+
+static float32_t PID_step_trapezoid_wrap(pid_type_def *pid, float32_t ref, float32_t set) {
+    return PID_step_plain(pid, ref, set, true, false);
+}
+
+static float32_t PID_step_variable(pid_type_def *pid, float32_t ref, float32_t set) {
+    return PID_step_plain(pid, ref, set, false, true);
+}
+
+static float32_t PID_step_variable_wrap(pid_type_def *pid, float32_t ref, float32_t set) {
+    return PID_step_plain(pid, ref, set, true, true);
+}
+
+void PID_refresh(pid_type_def *pid) {
+    bool wrap = (pid->wrap == PID_WRAP_ANGLE);
+
+    //卡尔曼可能在初始化之后才创建, 开启时总是使用通用计算
+    if (pid->D_First || pid->NF_D || pid->D_Low_Pass || pid->D_KF || pid->P_On_M ||
+        (pid->Variable_I && !(pid->Variable_I_UP - pid->Variable_I_Down > 0))) {
+        pid->step = PID_step_general;
+    } else if (pid->Variable_I) {
+        pid->step = wrap ? PID_step_variable_wrap : PID_step_variable;
+    } else {
+        pid->step = wrap ? PID_step_trapezoid_wrap : PID_step_trapezoid;
+    }
+}
+
+int PID_build(pid_type_def *pid, const float32_t PID[3], const pid_config_t *config) {
+    if (pid == NULL || PID == NULL || config == NULL) {
+        return -1;
+    }
+    if (config->mode > PID_DELTA || config->wrap > PID_WRAP_ANGLE || config->integral > PID_INTEGRAL_VARIABLE ||
+        config->derivative > PID_D_INCOMPLETE || config->max_out < 0.0f || config->max_iout < 0.0f) {
+        return -1;
+    }
+    if (config->integral == PID_INTEGRAL_VARIABLE && !(config->variable_i_up > config->variable_i_down)) {
+        return -1;
+    }
+    //微分先行的分母为d_filter_ratio * kd + kp
+    if (config->derivative == PID_D_FIRST && config->d_filter_ratio * PID[2] + PID[0] == 0.0f) {
+        return -1;
+    }
+    if ((config->derivative == PID_D_INCOMPLETE && (config->d_alpha < 0.0f || config->d_alpha > 1.0f)) ||
+        (config->d_low_pass && (config->d_filter_ratio <= 0.0f || config->d_filter_ratio > 1.0f)) ||
+        (config->p_on_m && (config->p_on_m_ratio < 0.0f || config->p_on_m_ratio > 1.0f))) {
+        return -1;
+    }
+
+    pid->mode = config->mode;
+    pid->Kp = PID[0];
+    pid->Ki = PID[1];
+    pid->Kd = PID[2];
+    pid->max_out = config->max_out;
+    pid->max_iout = config->max_iout;
+    pid->Integral_Separation = config->integral_separation;
+    pid->Variable_I = (config->integral == PID_INTEGRAL_VARIABLE);
+    pid->Variable_I_Down = config->variable_i_down;
+    pid->Variable_I_UP = config->variable_i_up;
+    pid->D_First = (config->derivative == PID_D_FIRST);
+    pid->NF_D = (config->derivative == PID_D_INCOMPLETE);
+    pid->D_Filter_Ratio = config->d_filter_ratio;
+    pid->D_Alpha = config->d_alpha;
+    pid->D_Low_Pass = config->d_low_pass;
+    pid->D_KF = config->d_kalman;
+    pid->P_On_M = config->p_on_m;
+    pid->P_On_M_Ratio = config->p_on_m_ratio;
+    pid->wrap = config->wrap;
+    pid->reset_time = config->reset_time;
+
+    pid->set = pid->get = pid->out = pid->Pout = pid->P_On_M_out = pid->Iout = pid->Dout = 0.0f;
+    pid->Dbuf[0] = pid->Dbuf[1] = pid->Dbuf[2] = 0.0f;
+    pid->error[0] = pid->error[1] = pid->error[2] = 0.0f;
+    pid->last_get = pid->D1 = pid->D2 = pid->D3 = pid->Dout_Last = pid->I_ratio = 0.0f;
+    pid->hal_tick = HAL_GetTick();
+    PID_refresh(pid);
+    return 0;
+}
+/***********************************************************************/
@@ -23,12 +23,31 @@
 #include <math.h>
 #include "struct_typedef.h"
 
+#define PID_RESET_TIME 90   //PID_init的默认值, 超过该时间(ms)未计算时积分从输出重新开始
+
 enum PID_MODE {
     PID_POSITION = 0,
     PID_DELTA,
 };
 
-typedef struct {
+//误差和微分的回绕
+enum PID_WRAP {
+    PID_WRAP_NONE = 0,
+    PID_WRAP_ANGLE,     //按2pi回绕, 角度环
+};
+
+enum PID_INTEGRAL {
+    PID_INTEGRAL_TRAPEZOID = 0,     //梯形积分
+    PID_INTEGRAL_VARIABLE,          //变积分
+};
+
+enum PID_DERIVATIVE {
+    PID_D_NORMAL = 0,   //反馈的差分
+    PID_D_FIRST,        //微分先行
+    PID_D_INCOMPLETE,   //不完全微分
+};
+
+typedef struct pid_type_def {
     uint8_t mode;
     //PID 三参数
     float32_t Kp;
@@ -75,9 +94,33 @@ typedef struct {
     bool P_On_M; //Proportional on Measurement
     float32_t P_On_M_Ratio; //0-1
 
-    uint32_t hal_tick
+    uint32_t hal_tick;
+    uint8_t wrap;           //PID_WRAP_NONE, PID_WRAP_ANGLE
+    uint32_t reset_time;    //超过该时间(ms)未计算时积分从输出重新开始, 0不检查
+    //ALL_PID调用的计算函数,由PID_init或PID_build按功能开关选择
+    float32_t (*step)(struct pid_type_def *pid, float32_t ref, float32_t set);
 } pid_type_def;
 
+//PID_build的配置,增益另外给出
+typedef struct {
+    uint8_t mode;                   //PID_POSITION, PID_DELTA, 只用于PID_calc
+    float32_t max_out;
+    float32_t max_iout;
+    float32_t integral_separation;  //误差绝对值不大于该值时积分清零且不计入输出
+    uint8_t wrap;                   //PID_WRAP_NONE, PID_WRAP_ANGLE
+    uint8_t integral;               //PID_INTEGRAL_TRAPEZOID, PID_INTEGRAL_VARIABLE
+    float32_t variable_i_down;      //变积分: 误差小于down时全部积分, 大于up时不积分
+    float32_t variable_i_up;
+    uint8_t derivative;             //PID_D_NORMAL, PID_D_FIRST, PID_D_INCOMPLETE
+    float32_t d_filter_ratio;       //微分先行系数, 同时为微分低通系数
+    float32_t d_alpha;              //不完全微分系数 0~1
+    bool d_low_pass;                //微分低通滤波
+    bool d_kalman;                  //微分卡尔曼滤波, D_Kalman由KalmanCreate创建后生效
+    bool p_on_m;
+    float32_t p_on_m_ratio;         //0~1
+    uint32_t reset_time;            //ms, 0不检查, 通常为PID_RESET_TIME
+} pid_config_t;
+
 /**
   * @brief          pid struct data init
   * @param[out]     pid: PID struct data point
@@ -97,12 +140,43 @@ typedef struct {
   * @param[in]      max_out: pid最大输出
   * @param[in]      max_iout: pid最大积分输出
   * @retval         none
+  * @note           不回绕, 重新开始时间为PID_RESET_TIME, P_On_M参数不写入.角度环等需要回绕的pid用PID_build
   */
 extern void PID_init(pid_type_def *pid, uint8_t mode, const float32_t PID[3], float32_t max_out, float32_t max_iout,
                      float32_t Integral, bool Variable_I_Switch, float32_t Variable_I_Down, float32_t Variable_I_UP,
                      bool D_First, float32_t D_Filter_Ratio, bool D_Low_Pass, float32_t D_Low_Pass_Factor, bool NF_D,
                      float32_t D_Alpha, bool D_KF, bool P_On_M, float32_t P_On_M_Ratio);
 
+/**
+  * @brief          check a configuration once and set up the pid for ALL_PID.
+  *                 The step function is chosen here from the switches, the
+  *                 common cases (trapezoidal or variable integral, plain
+  *                 derivative, with or without wrapping) get a step without
+  *                 the unused branches. Switches written directly later take
+  *                 effect after PID_refresh, gains and limits at once.
+  * @param[out]     pid: PID struct data point
+  * @param[in]      PID: 0: kp, 1: ki, 2:kd
+  * @param[in]      config: switches, limits and filter parameters
+  * @retval         0: ok, -1: bad configuration, pid unchanged
+  */
+/**
+  * @brief          检查一次配置并为ALL_PID初始化pid.计算函数在此按功能开关选择,常用的
+  *                 组合(梯形积分或变积分、普通微分、回绕与否)使用没有多余分支的计算函数.
+  *                 之后直接改变功能开关须调用PID_refresh,增益和限幅立即生效
+  * @param[out]     pid: PID结构数据指针
+  * @param[in]      PID: 0: kp, 1: ki, 2:kd
+  * @param[in]      config: 功能开关、限幅和滤波参数
+  * @retval         0:成功, -1:配置错误, pid不变
+  */
+extern int PID_build(pid_type_def *pid, const float32_t PID[3], const pid_config_t *config);
+
+/**
+  * @brief          功能开关被直接修改后(例如param_registry_apply写入后)重新选择计算函数
+  * @param[out]     pid: PID结构数据指针
+  * @retval         none
+  */
+extern void PID_refresh(pid_type_def *pid);
+
 /**
   * @brief          pid calculate 
   * @param[out]     pid: PID struct data point
@@ -169,6 +243,14 @@ typedef struct positionpid_t {
     float IntegralLimit;       //积分限幅
 } positionpid_t;
 
+/**
+  * @brief          pid计算,使用PID_init或PID_build选择的计算函数.回绕和重新开始时间由
+  *                 pid的wrap和reset_time决定
+  * @param[out]     pid: PID结构数据指针
+  * @param[in]      ref: 反馈数据
+  * @param[in]      set: 设定值
+  * @retval         pid输出, 未初始化时为0
+  */
 extern float ALL_PID(pid_type_def *pid, float32_t ref, float32_t set);
 
 
@@ -0,0 +1,177 @@
+/**
+  * @file       pid_batch.c/h
+  * @brief      several PID loops of the same configuration computed together.
+  *             多个相同配置的PID合并计算
+  */
+#include "pid_batch.h"
+#include "main.h"
+#include "arm_math.h"
+#include <string.h>
+
+/**
+  * @brief          微分低通系数, ALL_PID不滤波时系数为1
+  */
+static float32_t pid_batch_d_filter(const pid_type_def *pid) {
+    return pid->D_Low_Pass ? pid->D_Filter_Ratio : 1.0f;
+}
+
+/**
+  * @brief          检查pid的功能开关是否与该批相同且受支持
+  */
+static int pid_batch_check(const pid_batch_t *batch, const pid_type_def *pid) {
+    if (pid == NULL || pid->mode != PID_POSITION || pid->D_First || pid->P_On_M ||
+        (pid->D_KF && pid->D_Kalman.A == 1)) {
+        return -1;
+    }
+    if ((uint8_t) pid->Variable_I != batch->variable_i || (uint8_t) pid->NF_D != batch->nf_d ||
+        pid_batch_d_filter(pid) != batch->d_filter || (pid->wrap == PID_WRAP_ANGLE) != batch->wrap ||
+        pid->reset_time != batch->reset_time) {
+        return -1;
+    }
+    if (batch->variable_i &&
+        (pid->Variable_I_Down != batch->variable_i_down || pid->Variable_I_UP != batch->variable_i_up)) {
+        return -1;
+    }
+    if (batch->nf_d && pid->D_Alpha != batch->d_alpha) {
+        return -1;
+    }
+    return 0;
+}
+
+int pid_batch_init(pid_batch_t *batch, const pid_type_def *const pid[], uint8_t lane_num) {
+    uint8_t i;
+
+    if (batch == NULL || pid == NULL || pid[0] == NULL || lane_num == 0U || lane_num > PID_BATCH_MAX_LANE) {
+        return -1;
+    }
+    memset(batch, 0, sizeof(pid_batch_t));
+    batch->lane_num = lane_num;
+    batch->wrap = (pid[0]->wrap == PID_WRAP_ANGLE);
+    batch->reset_time = pid[0]->reset_time;
+    batch->variable_i = (uint8_t) pid[0]->Variable_I;
+    batch->variable_i_down = pid[0]->Variable_I_Down;
+    batch->variable_i_up = pid[0]->Variable_I_UP;
+    batch->nf_d = (uint8_t) pid[0]->NF_D;
+    batch->d_alpha = pid[0]->D_Alpha;
+    batch->d_filter = pid_batch_d_filter(pid[0]);
+    //ALL_PID在上下限无效时积分累加两次,不支持
+    if (batch->variable_i && !(batch->variable_i_up - batch->variable_i_down > 0.0f)) {
+        return -1;
+    }
+    for (i = 0; i < lane_num; i++) {
+        if (pid_batch_load(batch, i, pid[i]) != 0) {
+            return -1;
+        }
+    }
+    batch->hal_tick = HAL_GetTick();
+    return 0;
+}
+
+int pid_batch_load(pid_batch_t *batch, uint8_t lane, const pid_type_def *pid) {
+    if (lane >= batch->lane_num || pid_batch_check(batch, pid) != 0) {
+        return -1;
+    }
+    batch->kp[lane] = pid->Kp;
+    batch->ki[lane] = pid->Ki;
+    batch->kd[lane] = pid->Kd;
+    batch->max_out[lane] = pid->max_out;
+    batch->max_iout[lane] = pid->max_iout;
+    batch->separation[lane] = pid->Integral_Separation;
+    return 0;
+}
+
+const float32_t *pid_batch_calc(pid_batch_t *batch, const float32_t *get, const float32_t *set) {
+    uint32_t n = batch->lane_num;
+    uint32_t now = 0U;
+    uint32_t gap;
+    float32_t temp[PID_BATCH_MAX_LANE];
+    float32_t d_temp[PID_BATCH_MAX_LANE];
+    float32_t e;
+    uint8_t i;
+
+    //长时间未计算, 积分从上次输出重新开始
+    if (batch->reset_time) {
+        now = HAL_GetTick();
+        gap = now - batch->hal_tick;
+        if (gap > batch->reset_time && gap < 294967295U) {
+            for (i = 0; i < n; i++) {
+                batch->last_get[i] = get[i];
+                batch->iout[i] = batch->out[i];
+                LimitMax(batch->iout[i], batch->max_iout[i]);
+            }
+        }
+    }
+
+    arm_sub_f32(set, get, batch->error, n);
+    arm_sub_f32(get, batch->last_get, batch->dbuf, n);
+    if (batch->wrap) {
+        for (i = 0; i < n; i++) {
+            batch->error[i] = jump_error(batch->error[i], 2 * PI);
+            batch->dbuf[i] = jump_error(batch->dbuf[i], 2 * PI);
+        }
+    }
+
+    //梯形积分 ki * (e0 + e1) / 2
+    arm_add_f32(batch->error, batch->last_error, temp, n);
+    if (batch->variable_i) {
+        for (i = 0; i < n; i++) {
+            e = batch->error[i];
+            if (fabsf(1000.0f * e) < (1000.0f * batch->variable_i_down)) {
+                batch->i_ratio[i] = 1.0f;
+            } else if (fabsf(e) > batch->variable_i_up) {
+                batch->i_ratio[i] = 0.0f;
+            } else {
+                batch->i_ratio[i] = ((1000.0f * batch->variable_i_up) - fabsf(1000.0f * e)) /
+                                    ((1000.0f * batch->variable_i_up) - (1000.0f * batch->variable_i_down));
+            }
+        }
+        arm_mult_f32(batch->i_ratio, batch->ki, d_temp, n);
+        arm_mult_f32(d_temp, temp, temp, n);
+    } else {
+        arm_mult_f32(batch->ki, temp, temp, n);
+    }
+    arm_scale_f32(temp, 0.5f, temp, n);
+    arm_add_f32(batch->iout, temp, batch->iout, n);
+
+    //微分在反馈上, dout保存的是上次微分输出
+    if (batch->nf_d) {
+        arm_scale_f32(batch->kd, 1.0f - batch->d_alpha, d_temp, n);
+        arm_mult_f32(d_temp, batch->dbuf, d_temp, n);
+        arm_scale_f32(batch->dout, batch->d_alpha, temp, n);
+        arm_add_f32(d_temp, temp, d_temp, n);
+    } else {
+        arm_mult_f32(batch->kd, batch->dbuf, d_temp, n);
+    }
+    arm_sub_f32(d_temp, batch->dout, temp, n);
+    arm_scale_f32(temp, batch->d_filter, temp, n);
+    arm_add_f32(batch->dout, temp, batch->dout, n);
+
+    arm_mult_f32(batch->kp, batch->error, batch->pout, n);
+
+    //各通道限幅和积分分离
+    for (i = 0; i < n; i++) {
+        batch->limit[i] = 0U;
+        if (fabsf(batch->iout[i]) > batch->max_iout[i]) {
+            LimitMax(batch->iout[i], batch->max_iout[i]);
+            batch->limit[i] |= PID_BATCH_IOUT_LIMIT;
+        }
+        if (fabsf(batch->error[i]) <= batch->separation[i]) {
+            batch->iout[i] = 0.0f;
+            batch->out[i] = batch->pout[i] - batch->dout[i];
+            batch->limit[i] |= PID_BATCH_I_SEPARATE;
+        } else {
+            batch->out[i] = batch->pout[i] + batch->iout[i] - batch->dout[i];
+        }
+        if (fabsf(batch->out[i]) > batch->max_out[i]) {
+            LimitMax(batch->out[i], batch->max_out[i]);
+            batch->limit[i] |= PID_BATCH_OUT_LIMIT;
+        }
+    }
+
+    arm_copy_f32(get, batch->last_get, n);
+    arm_copy_f32(batch->error, batch->last_error, n);
+    if (batch->reset_time) {
+        batch->hal_tick = now;
+    }
+    return batch->out;
+}
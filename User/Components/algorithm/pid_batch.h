@@ -0,0 +1,110 @@
+/**
+  * @file       pid_batch.c/h
+  * @brief      several PID loops of the same configuration, e.g. the four wheel
+  *             speed loops, computed together. The gains and the state of every
+  *             loop (lane) are stored as arrays, one array per field, and the
+  *             lanes are computed field by field with CMSIS-DSP vector functions.
+  *             Every lane goes through the same operations in the same order as
+  *             ALL_PID.
+  *             多个相同配置的PID合并计算,例如四个底盘电机速度环.各环(通道)的增益和状态
+  *             按字段存为数组,用CMSIS-DSP向量函数逐字段计算所有通道,每个通道的运算及其
+  *             顺序与ALL_PID相同
+  * @note       the lanes are loaded from pid_type_def set up by PID_init or
+  *             PID_build, which stays the place of the gains: reload a lane with
+  *             pid_batch_load after its gains change, e.g. when
+  *             param_registry_apply writes them. The feature switches, the wrap
+  *             mode and the restart time are checked once in pid_batch_init,
+  *             D_First, P_On_M, the derivative Kalman filter and PID_DELTA are
+  *             not supported. The restart of ALL_PID is checked once per batch.
+  *             通道由PID_init或PID_build初始化的pid_type_def加载,增益仍保存在其中:增益
+  *             改变后(例如param_registry_apply写入后)用pid_batch_load重新加载.功能开关、
+  *             回绕和重新开始时间只在pid_batch_init中检查一次,不支持微分先行、P_On_M、
+  *             微分卡尔曼滤波和PID_DELTA.ALL_PID的重新开始每批检查一次
+  */
+#ifndef PID_BATCH_H
+#define PID_BATCH_H
+
+#include "struct_typedef.h"
+#include "pid.h"
+
+#define PID_BATCH_MAX_LANE      4
+
+//limit中的标志
+#define PID_BATCH_OUT_LIMIT     0x01        //输出限幅
+#define PID_BATCH_IOUT_LIMIT    0x02        //积分限幅
+#define PID_BATCH_I_SEPARATE    0x04        //误差不大于Integral_Separation, 积分清零
+
+typedef struct {
+    uint8_t lane_num;
+    //所有通道相同的配置
+    uint8_t wrap;                               //误差和微分按2pi回绕, 角度环
+    uint8_t variable_i;
+    float32_t variable_i_down, variable_i_up;
+    uint8_t nf_d;                               //不完全微分
+    float32_t d_alpha;
+    float32_t d_filter;                         //微分低通系数, 不滤波为1
+    uint32_t reset_time;                        //超过该时间未计算时积分从输出重新开始 ms, 0不检查
+    uint32_t hal_tick;                          //上次计算的时间 ms
+
+    //各通道参数
+    float32_t kp[PID_BATCH_MAX_LANE];
+    float32_t ki[PID_BATCH_MAX_LANE];
+    float32_t kd[PID_BATCH_MAX_LANE];
+    float32_t max_out[PID_BATCH_MAX_LANE];
+    float32_t max_iout[PID_BATCH_MAX_LANE];
+    float32_t separation[PID_BATCH_MAX_LANE];   //Integral_Separation
+
+    //各通道状态
+    float32_t error[PID_BATCH_MAX_LANE];
+    float32_t last_error[PID_BATCH_MAX_LANE];
+    float32_t last_get[PID_BATCH_MAX_LANE];
+    float32_t dbuf[PID_BATCH_MAX_LANE];         //反馈变化量, 即ALL_PID的Dbuf[0]
+    float32_t i_ratio[PID_BATCH_MAX_LANE];      //变积分系数
+    float32_t pout[PID_BATCH_MAX_LANE];
+    float32_t iout[PID_BATCH_MAX_LANE];
+    float32_t dout[PID_BATCH_MAX_LANE];
+    float32_t out[PID_BATCH_MAX_LANE];
+    uint8_t limit[PID_BATCH_MAX_LANE];          //本次计算的限幅标志, PID_BATCH_OUT_LIMIT等
+} pid_batch_t;
+
+/**
+  * @brief          init a batch from pids set up by PID_init or PID_build, their
+  *                 gains and limits are copied and the state starts from zero
+  * @param[out]     batch: batch data
+  * @param[in]      pid: one pid per lane, all with the same feature switches,
+  *                 wrap mode and restart time
+  * @param[in]      lane_num: 1 ~ PID_BATCH_MAX_LANE
+  * @retval         0: ok, -1: bad argument, different or unsupported switches
+  */
+/**
+  * @brief          由PID_init或PID_build初始化的pid初始化一批,复制增益和限幅,状态从零开始
+  * @param[out]     batch: 合并计算的数据
+  * @param[in]      pid: 每个通道一个pid, 功能开关、回绕和重新开始时间须相同
+  * @param[in]      lane_num: 1 ~ PID_BATCH_MAX_LANE
+  * @retval         0:成功, -1:参数错误, 功能开关不同或不支持
+  */
+extern int pid_batch_init(pid_batch_t *batch, const pid_type_def *const pid[], uint8_t lane_num);
+
+/**
+  * @brief          重新加载一个通道的增益和限幅, 状态不变
+  * @retval         0:成功, -1:通道不存在或功能开关与该批不同
+  */
+extern int pid_batch_load(pid_batch_t *batch, uint8_t lane, const pid_type_def *pid);
+
+/**
+  * @brief          compute all lanes, the outputs are left in batch->out
+  * @param[in]      batch: batch data
+  * @param[in]      get: feedback of every lane
+  * @param[in]      set: set point of every lane
+  * @retval         batch->out
+  */
+/**
+  * @brief          计算所有通道,输出在batch->out中
+  * @param[in]      batch: 合并计算的数据
+  * @param[in]      get: 各通道反馈
+  * @param[in]      set: 各通道设定值
+  * @retval         batch->out
+  */
+extern const float32_t *pid_batch_calc(pid_batch_t *batch, const float32_t *get, const float32_t *set);
+
+#endif
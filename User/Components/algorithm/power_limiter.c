@@ -0,0 +1,136 @@
+/**
+  * @file       power_limiter.c/h
+  * @brief      model predictive power limiter for current driven motors.
+  *             电流驱动电机的模型预测功率限制
+  */
+#include "power_limiter.h"
+#include "arm_math.h"
+#include <string.h>
+
+//平均预测功率低于该值时静态功率占主导,不校正模型
+#define POWER_LIMITER_CORRECT_MIN_POWER 5.0f
+//模型校正系数的低通系数
+#define POWER_LIMITER_CORRECT_RATE      0.2f
+
+void power_limiter_init(power_limiter_t *limiter, const power_limiter_param_t *param) {
+    if (limiter == NULL || param == NULL) {
+        return;
+    }
+    memset(limiter, 0, sizeof(power_limiter_t));
+    limiter->param = *param;
+    limiter->correction = 1.0f;
+    limiter->buffer = param->buffer_max;
+    limiter->scale = 1.0f;
+}
+
+void power_limiter_referee_update(power_limiter_t *limiter, float32_t power, float32_t buffer) {
+    float32_t mean, ratio;
+
+    if (limiter->power_num > 0U) {
+        mean = limiter->power_sum / (float32_t) limiter->power_num;
+        if (mean > POWER_LIMITER_CORRECT_MIN_POWER) {
+            ratio = power / mean;
+            limiter->correction += POWER_LIMITER_CORRECT_RATE * (ratio - limiter->correction);
+            if (limiter->correction < limiter->param.correction_min) {
+                limiter->correction = limiter->param.correction_min;
+            } else if (limiter->correction > limiter->param.correction_max) {
+                limiter->correction = limiter->param.correction_max;
+            }
+        }
+    }
+    limiter->power_sum = 0.0f;
+    limiter->power_num = 0U;
+    limiter->buffer = buffer;
+}
+
+float32_t power_limiter_budget(power_limiter_t *limiter, float32_t power_limit, float32_t cap_energy) {
+    float32_t extra = limiter->buffer - limiter->param.buffer_reserve;
+
+    //缓冲能量高于保留值时在spend_time内用完,低于时在recover_time内补回
+    if (extra > 0.0f) {
+        extra /= limiter->param.spend_time;
+    } else {
+        extra /= limiter->param.recover_time;
+    }
+    limiter->cap_power = 0.0f;
+    if (cap_energy > 0.0f) {
+        limiter->cap_power = cap_energy / limiter->param.cap_spend_time;
+        if (limiter->cap_power > limiter->param.cap_power_max) {
+            limiter->cap_power = limiter->param.cap_power_max;
+        }
+    }
+    limiter->budget = power_limit + extra + limiter->cap_power;
+    if (limiter->budget < 0.0f) {
+        limiter->budget = 0.0f;
+    }
+    return limiter->budget;
+}
+
+float32_t power_limiter_apply(power_limiter_t *limiter, float32_t current[], const float32_t speed[],
+                              uint8_t num, float32_t referee_limit, float32_t dt) {
+    const power_limiter_param_t *param = &limiter->param;
+    float32_t a, b, c;
+    float32_t drive_a = 0.0f, drive_b = 0.0f;       //加速电机的二次项,一次项
+    float32_t fixed = param->static_power;          //不随缩放变化的功率
+    float32_t target, request, raw, root, scale = 1.0f;
+    float32_t buffer, upper;
+    uint8_t drive[POWER_LIMITER_MAX_MOTOR];
+    uint8_t i;
+
+    if (num > POWER_LIMITER_MAX_MOTOR) {
+        num = POWER_LIMITER_MAX_MOTOR;
+    }
+    //按缩放系数s展开 P(s) = fixed + drive_a*s^2 + drive_b*s
+    for (i = 0; i < num; i++) {
+        a = param->resistance * current[i] * current[i];
+        b = param->torque_constant * current[i] * speed[i];
+        c = param->speed_loss * speed[i] * speed[i];
+        drive[i] = (b > 0.0f);
+        fixed += c;
+        if (drive[i]) {
+            drive_a += a;
+            drive_b += b;
+        } else {
+            fixed += a + b;
+        }
+    }
+    raw = fixed + drive_a + drive_b;
+    request = limiter->correction * raw;
+    limiter->power_request = request;
+
+    if (request > limiter->budget) {
+        target = limiter->budget / limiter->correction;
+        if (target <= fixed || drive_a + drive_b <= 0.0f) {
+            scale = 0.0f;
+        } else {
+            //drive_a*s^2 + drive_b*s = target - fixed 的正根,写成不怕drive_a为0的形式
+            arm_sqrt_f32(drive_b * drive_b + 4.0f * drive_a * (target - fixed), &root);
+            scale = 2.0f * (target - fixed) / (drive_b + root);
+            if (scale > 1.0f) {
+                scale = 1.0f;
+            }
+        }
+        for (i = 0; i < num; i++) {
+            if (drive[i]) {
+                current[i] *= scale;
+            }
+        }
+        raw = fixed + (drive_a * scale + drive_b) * scale;
+        limiter->limit_cnt++;
+    }
+    limiter->scale = scale;
+    limiter->power = limiter->correction * raw;
+    limiter->power_sum += raw;
+    limiter->power_num++;
+
+    //超过裁判功率上限的部分消耗缓冲能量,低于上限时恢复,超级电容放电的部分不经过裁判系统
+    upper = (limiter->buffer > param->buffer_max) ? limiter->buffer : param->buffer_max;
+    buffer = limiter->buffer + (referee_limit + limiter->cap_power - limiter->power) * dt;
+    if (buffer < 0.0f) {
+        buffer = 0.0f;
+    } else if (buffer > upper) {
+        buffer = upper;
+    }
+    limiter->buffer = buffer;
+    return scale;
+}
@@ -0,0 +1,129 @@
+/**
+  * @file       power_limiter.c/h
+  * @brief      model predictive power limiter for current driven motors. The
+  *             electrical power of every motor is predicted each control cycle
+  *             from its current command and speed,
+  *                 P = kt * i * w + R * i^2 + kw * w^2 (+ static power),
+  *             the energy of the referee buffer is integrated between referee
+  *             packets, and the current commands are scaled to the largest value
+  *             whose predicted power fits the budget given by the power limit and
+  *             the stored energy.
+  *             电流驱动电机的模型预测功率限制.每个控制周期由电流指令和转速预测各电机
+  *             的电功率 P = kt*i*w + R*i^2 + kw*w^2 (+静态功率),在两次裁判数据之间积分
+  *             缓冲能量,再把电流指令缩放到预测功率刚好不超过预算的最大值,预算由功率上限
+  *             和储存的能量给出
+  * @note       only the motors that draw power (i * w > 0) are scaled, braking motors
+  *             return energy and keep their full current, so the budget goes to the
+  *             wheels that accelerate. The model is corrected online by the ratio of
+  *             the referee power to the mean predicted power between two packets,
+  *             and the buffer estimate is reset to every referee value.
+  *             只缩放消耗功率(i*w>0)的电机,制动的电机回馈能量,保持原电流,预算全部用于
+  *             加速的轮子.模型由两次裁判数据之间裁判功率与平均预测功率之比在线校正,
+  *             缓冲能量估计在每次收到裁判数据时重置
+  */
+#ifndef POWER_LIMITER_H
+#define POWER_LIMITER_H
+
+#include "struct_typedef.h"
+
+#define POWER_LIMITER_MAX_MOTOR 4
+
+typedef struct {
+    float32_t torque_constant;      //转子侧转矩常数 N*m/A
+    float32_t resistance;           //等效铜损电阻 ohm
+    float32_t speed_loss;           //与转速平方成正比的损耗 W/(rad/s)^2
+    float32_t static_power;         //静态功率 W
+    float32_t buffer_max;           //缓冲能量上限 J
+    float32_t buffer_reserve;       //保留的缓冲能量 J
+    float32_t spend_time;           //用完可用缓冲能量的时间 s
+    float32_t recover_time;         //恢复到保留能量的时间 s
+    float32_t cap_spend_time;       //用完超级电容可用能量的时间 s
+    float32_t cap_power_max;        //超级电容最大放电功率 W
+    float32_t correction_min;       //模型校正系数的范围
+    float32_t correction_max;
+} power_limiter_param_t;
+
+typedef struct {
+    power_limiter_param_t param;
+    float32_t correction;           //裁判功率/模型功率
+    float32_t buffer;               //缓冲能量估计 J
+    float32_t budget;               //本周期允许的功率 W
+    float32_t cap_power;            //预算中由超级电容提供的功率 W
+    float32_t power_request;        //按原电流指令预测的功率 W
+    float32_t power;                //按限制后电流预测的功率 W
+    float32_t scale;                //加速电机的电流缩放系数
+    float32_t power_sum;            //两次裁判数据之间未校正的预测功率累计
+    uint32_t power_num;
+    uint32_t limit_cnt;             //电流被缩放的周期数
+} power_limiter_t;
+
+/**
+  * @brief          init the limiter, the buffer estimate starts full
+  * @param[out]     limiter: limiter
+  * @param[in]      param: model and energy parameters, copied
+  * @retval         none
+  */
+/**
+  * @brief          初始化,缓冲能量估计从满开始
+  * @param[out]     limiter: 限制器
+  * @param[in]      param: 模型和能量参数,会被复制
+  * @retval         none
+  */
+extern void power_limiter_init(power_limiter_t *limiter, const power_limiter_param_t *param);
+
+/**
+  * @brief          a new referee packet, corrects the model and resets the buffer estimate
+  * @param[in]      limiter: limiter
+  * @param[in]      power: referee chassis power, W
+  * @param[in]      buffer: referee buffer energy, J
+  * @retval         none
+  */
+/**
+  * @brief          收到新的裁判数据,校正模型并重置缓冲能量估计
+  * @param[in]      limiter: 限制器
+  * @param[in]      power: 裁判系统底盘功率, W
+  * @param[in]      buffer: 裁判系统缓冲能量, J
+  * @retval         none
+  */
+extern void power_limiter_referee_update(power_limiter_t *limiter, float32_t power, float32_t buffer);
+
+/**
+  * @brief          power budget of this cycle
+  * @param[in]      limiter: limiter
+  * @param[in]      power_limit: sustained power, W
+  * @param[in]      cap_energy: usable super capacitor energy, J, 0 when not used
+  * @retval         budget, W
+  */
+/**
+  * @brief          计算本周期的功率预算
+  * @param[in]      limiter: 限制器
+  * @param[in]      power_limit: 可持续的功率, W
+  * @param[in]      cap_energy: 超级电容可用能量, J, 不使用时为0
+  * @retval         功率预算, W
+  */
+extern float32_t power_limiter_budget(power_limiter_t *limiter, float32_t power_limit, float32_t cap_energy);
+
+/**
+  * @brief          scale the currents to the budget and integrate the buffer estimate
+  * @param[in]      limiter: limiter
+  * @param[in,out]  current: motor currents, A
+  * @param[in]      speed: motor speeds at the rotor, rad/s
+  * @param[in]      num: motor number, at most POWER_LIMITER_MAX_MOTOR
+  * @param[in]      referee_limit: referee power limit that drains the buffer, W
+  * @param[in]      dt: control period, s
+  * @retval         scale of the accelerating motors, 1 means not limited
+  */
+/**
+  * @brief          把电流缩放到预算之内,并积分缓冲能量估计
+  * @param[in]      limiter: 限制器
+  * @param[in,out]  current: 电机电流, A
+  * @param[in]      speed: 转子侧电机转速, rad/s
+  * @param[in]      num: 电机数量,不超过POWER_LIMITER_MAX_MOTOR
+  * @param[in]      referee_limit: 消耗缓冲能量的裁判功率上限, W
+  * @param[in]      dt: 控制周期, s
+  * @retval         加速电机的缩放系数, 1为未限制
+  */
+extern float32_t power_limiter_apply(power_limiter_t *limiter, float32_t current[], const float32_t speed[],
+                                     uint8_t num, float32_t referee_limit, float32_t dt);
+
+#endif
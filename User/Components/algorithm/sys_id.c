@@ -0,0 +1,434 @@
+/**
+  * @file       sys_id.c/h
+  * @brief      frequency response identification of one motor loop.
+  *             单个电机环的频率响应辨识
+  */
+#include "sys_id.h"
+#include "arm_math.h"
+#include <string.h>
+
+#define SYS_ID_2PI      (2.0f * PI)
+
+/**
+  * @brief          对数均匀分布的第index个频率点
+  */
+static float32_t sys_id_point_freq(const sys_id_t *id, uint8_t index) {
+    return id->f_start * powf(id->ratio, (float32_t) index);
+}
+
+/**
+  * @brief          清零当前频率点的累加和
+  */
+static void sys_id_clear_sum(sys_id_t *id) {
+    id->sum_f = id->sum_c = id->sum_s = 0.0f;
+    id->sum_u = id->sum_uc = id->sum_us = 0.0f;
+    id->sum_y = id->sum_yc = id->sum_ys = id->sum_yy = 0.0f;
+    id->n = 0;
+}
+
+/**
+  * @brief          开始一个频率点的等待阶段,步进时调整频率使测量周期为整数个采样
+  */
+static void sys_id_start_point(sys_id_t *id) {
+    float32_t samples;
+
+    id->state = SYS_ID_SETTLE;
+    id->sample = 0;
+    if (id->mode == SYS_ID_CHIRP) {
+        //扫频从第一个点的下边界开始,之后频率连续变化
+        id->freq = id->f_start / sqrtf(id->ratio);
+        id->sample_num = (uint32_t) (id->settle_cycles / (id->freq * id->dt) + 0.5f);
+        return;
+    }
+    samples = (float32_t) (uint32_t) (id->measure_cycles / (sys_id_point_freq(id, id->point_done) * id->dt) + 0.5f);
+    if (samples < 1.0f) {
+        samples = 1.0f;
+    }
+    id->freq = id->measure_cycles / (samples * id->dt);
+    id->sample_num = (uint32_t) (id->settle_cycles / (id->freq * id->dt) + 0.5f);
+}
+
+/**
+  * @brief          由累加和计算一个频率点, H = Y / U, 均值由累加和扣除
+  */
+static void sys_id_finish_point(sys_id_t *id) {
+    sys_id_point_t *point = &id->point[id->point_done];
+    float32_t n = (float32_t) id->n;
+    float32_t mean_u, mean_y, u_re, u_im, y_re, y_im, den, h_re, h_im, var;
+
+    mean_u = id->sum_u / n;
+    mean_y = id->sum_y / n;
+    //X = sum((x - mean) * e^(-j phase))
+    u_re = id->sum_uc - mean_u * id->sum_c;
+    u_im = -(id->sum_us - mean_u * id->sum_s);
+    y_re = id->sum_yc - mean_y * id->sum_c;
+    y_im = -(id->sum_ys - mean_y * id->sum_s);
+    den = u_re * u_re + u_im * u_im;
+    if (den > 0.0f) {
+        h_re = (y_re * u_re + y_im * u_im) / den;
+        h_im = (y_im * u_re - y_re * u_im) / den;
+    } else {
+        h_re = h_im = 0.0f;
+    }
+
+    point->freq = id->sum_f / n;
+    point->gain = sqrtf(h_re * h_re + h_im * h_im);
+    point->phase = atan2f(h_im, h_re);
+    //相位按频率顺序展开
+    if (id->point_done > 0) {
+        float32_t last = id->point[id->point_done - 1].phase;
+        while (point->phase - last > PI) {
+            point->phase -= SYS_ID_2PI;
+        }
+        while (point->phase - last < -PI) {
+            point->phase += SYS_ID_2PI;
+        }
+    }
+    //正弦幅值a = 2|Y|/n, 能量a^2/2与方差之比
+    var = id->sum_yy / n - mean_y * mean_y;
+    if (var > 0.0f) {
+        point->quality = 2.0f * (y_re * y_re + y_im * y_im) / (n * n * var);
+        if (point->quality > 1.0f) {
+            point->quality = 1.0f;
+        }
+    } else {
+        point->quality = 0.0f;
+    }
+    id->point_done++;
+}
+
+int sys_id_init(sys_id_t *id, const float32_t *input, float32_t *output, sys_id_mode_e mode,
+                sys_id_model_e model, float32_t offset, float32_t amplitude, float32_t f_start,
+                float32_t f_end, uint8_t point_num, float32_t input_limit, float32_t dt) {
+    float32_t f_max;
+
+    if (id == NULL || input == NULL || output == NULL || amplitude == 0.0f || dt <= 0.0f || f_start <= 0.0f ||
+        f_end <= f_start || point_num < 2 || point_num > SYS_ID_MAX_POINT) {
+        return -1;
+    }
+    memset(id, 0, sizeof(sys_id_t));
+    id->input = input;
+    id->output = output;
+    id->mode = mode;
+    id->model = model;
+    id->offset = offset;
+    id->amplitude = amplitude;
+    id->input_limit = input_limit;
+    id->f_start = f_start;
+    id->f_end = f_end;
+    id->point_num = point_num;
+    id->ratio = powf(f_end / f_start, 1.0f / (float32_t) (point_num - 1));
+    id->min_quality = SYS_ID_MIN_QUALITY;
+    id->dt = dt;
+    sys_id_set_cycles(id, SYS_ID_SETTLE_CYCLES, SYS_ID_MEASURE_CYCLES);
+    id->fit.valid = -1;
+    id->state = SYS_ID_IDLE;
+
+    //扫频的最高频率为最后一个点的上边界
+    f_max = mode == SYS_ID_CHIRP ? f_end * sqrtf(id->ratio) : f_end;
+    if (f_max * dt * 4.0f > 1.0f) {
+        return -1;
+    }
+    return 0;
+}
+
+void sys_id_set_cycles(sys_id_t *id, float32_t settle_cycles, float32_t measure_cycles) {
+    if (id == NULL || settle_cycles < 0.0f || measure_cycles < 1.0f) {
+        return;
+    }
+    id->settle_cycles = settle_cycles;
+    id->measure_cycles = measure_cycles;
+    //每个点的周期数固定: d(ln f)/d(周期) = ln(ratio) / measure_cycles
+    id->sweep_rate = logf(id->ratio) / measure_cycles;
+}
+
+sys_id_state_e sys_id_update(sys_id_t *id) {
+    float32_t y, u;
+
+    if (id == NULL) {
+        return SYS_ID_ABORT;
+    }
+    if (id->state == SYS_ID_DONE || id->state == SYS_ID_ABORT) {
+        return id->state;
+    }
+    y = *id->input;
+    if (id->input_limit > 0.0f && fabsf(y) > id->input_limit) {
+        sys_id_stop(id);
+        return id->state;
+    }
+
+    if (id->state == SYS_ID_IDLE) {
+        id->phase = 0.0f;
+        id->last_sin = 0.0f;
+        id->last_cos = 1.0f;
+        sys_id_start_point(id);
+    } else {
+        //反馈对应上一次写入的给定
+        if (id->state == SYS_ID_MEASURE) {
+            if (id->n == 0) {
+                id->y_ref = y;
+            }
+            y -= id->y_ref;
+            u = id->amplitude * id->last_sin;
+            id->sum_f += id->freq;
+            id->sum_c += id->last_cos;
+            id->sum_s += id->last_sin;
+            id->sum_u += u;
+            id->sum_uc += u * id->last_cos;
+            id->sum_us += u * id->last_sin;
+            id->sum_y += y;
+            id->sum_yc += y * id->last_cos;
+            id->sum_ys += y * id->last_sin;
+            id->sum_yy += y * y;
+            id->n++;
+        }
+        id->sample++;
+
+        if (id->state == SYS_ID_SETTLE) {
+            if (id->sample >= id->sample_num) {
+                id->state = SYS_ID_MEASURE;
+                id->sample = 0;
+                id->sample_num = (uint32_t) (id->measure_cycles / (id->freq * id->dt) + 0.5f);
+                sys_id_clear_sum(id);
+            }
+        } else if (id->mode == SYS_ID_CHIRP) {
+            //df/dt = sweep_rate * f^2, 越过当前点的上边界时结束该点
+            id->freq += id->sweep_rate * id->freq * id->freq * id->dt;
+            if (id->freq >= sys_id_point_freq(id, id->point_done) * sqrtf(id->ratio)) {
+                sys_id_finish_point(id);
+                sys_id_clear_sum(id);
+            }
+        } else if (id->sample >= id->sample_num) {
+            sys_id_finish_point(id);
+            if (id->point_done < id->point_num) {
+                sys_id_start_point(id);
+            }
+        }
+
+        if (id->point_done >= id->point_num) {
+            *id->output = id->offset;
+            sys_id_fit(id->point, id->point_num, id->model, id->min_quality, &id->fit);
+            id->state = SYS_ID_DONE;
+            return id->state;
+        }
+    }
+
+    id->phase += SYS_ID_2PI * id->freq * id->dt;
+    if (id->phase >= SYS_ID_2PI) {
+        id->phase -= SYS_ID_2PI;
+    }
+    id->last_sin = arm_sin_f32(id->phase);
+    id->last_cos = arm_cos_f32(id->phase);
+    *id->output = id->offset + id->amplitude * id->last_sin;
+    return id->state;
+}
+
+void sys_id_stop(sys_id_t *id) {
+    if (id == NULL) {
+        return;
+    }
+    *id->output = id->offset;
+    if (id->state != SYS_ID_DONE) {
+        id->state = SYS_ID_ABORT;
+    }
+}
+
+void sys_id_model_response(const sys_id_fit_t *fit, float32_t freq, float32_t *gain, float32_t *phase) {
+    float32_t w = SYS_ID_2PI * freq;
+    float32_t g, ph;
+
+    if (fit == NULL || gain == NULL || phase == NULL) {
+        return;
+    }
+    if (fit->model == SYS_ID_FIRST_ORDER || fit->model == SYS_ID_INTEGRATOR_FIRST_ORDER) {
+        g = 1.0f / sqrtf(1.0f + w * w * fit->time_const * fit->time_const);
+        ph = -atanf(w * fit->time_const);
+    } else {
+        float32_t re = fit->wn * fit->wn - w * w;
+        float32_t im = 2.0f * fit->zeta * fit->wn * w;
+        g = fit->wn * fit->wn / sqrtf(re * re + im * im);
+        ph = -atan2f(im, re);
+    }
+    if (fit->model == SYS_ID_INTEGRATOR_FIRST_ORDER || fit->model == SYS_ID_INTEGRATOR_SECOND_ORDER) {
+        g /= w;
+        ph -= 0.5f * PI;
+    }
+    if (fit->gain < 0.0f) {
+        ph -= PI;
+    }
+    *gain = fabsf(fit->gain) * g;
+    *phase = ph - w * fit->delay;
+}
+
+/**
+  * @brief          由测量增益求-3dB带宽和谐振峰,积分模型按w|G|计算
+  */
+static void sys_id_measured_bandwidth(const sys_id_point_t *point, uint8_t num, uint8_t integrator,
+                                      float32_t min_quality, sys_id_fit_t *fit) {
+    float32_t ref = 0.0f, last_db = 0.0f, last_f = 0.0f;
+    uint8_t i, first = 1;
+
+    for (i = 0; i < num; i++) {
+        float32_t g, db;
+        if (point[i].quality < min_quality || point[i].gain <= 0.0f) {
+            continue;
+        }
+        g = point[i].gain * (integrator ? SYS_ID_2PI * point[i].freq : 1.0f);
+        if (first) {
+            ref = g;
+            first = 0;
+            fit->peak_freq = point[i].freq;
+            fit->peak_db = 0.0f;
+            last_db = 0.0f;
+            last_f = point[i].freq;
+            continue;
+        }
+        db = 20.0f * log10f(g / ref);
+        if (db > fit->peak_db) {
+            fit->peak_db = db;
+            fit->peak_freq = point[i].freq;
+        }
+        //对数频率上插值
+        if (fit->bandwidth == 0.0f && db < -3.0103f) {
+            float32_t k = (-3.0103f - last_db) / (db - last_db);
+            fit->bandwidth = last_f * powf(point[i].freq / last_f, k);
+        }
+        last_db = db;
+        last_f = point[i].freq;
+    }
+}
+
+int sys_id_fit(const sys_id_point_t *point, uint8_t num, sys_id_model_e model, float32_t min_quality,
+               sys_id_fit_t *fit) {
+    //一次性计算,使用double避免w^4的量级差
+    double ata[3][3] = {{0.0}}, atb[3] = {0.0}, p[3] = {0.0};
+    double x_ref = 0.0, m_ref = 0.0, a, b, c, sum_wr = 0.0, sum_ww = 0.0, sum_err = 0.0;
+    uint8_t integrator = model == SYS_ID_INTEGRATOR_FIRST_ORDER || model == SYS_ID_INTEGRATOR_SECOND_ORDER;
+    uint8_t order = (model == SYS_ID_FIRST_ORDER || model == SYS_ID_INTEGRATOR_FIRST_ORDER) ? 1 : 2;
+    uint8_t i, j, k, used = 0, first = 0xFF;
+    int32_t turn = 0;
+
+    if (point == NULL || fit == NULL) {
+        return -1;
+    }
+    memset(fit, 0, sizeof(sys_id_fit_t));
+    fit->valid = -1;
+    fit->model = model;
+    sys_id_measured_bandwidth(point, num, integrator, min_quality, fit);
+
+    //归一化: x = w^2 / x_ref, m = |G|^2 (积分模型乘w^2) / m_ref
+    for (i = 0; i < num; i++) {
+        double w = 2.0 * PI * point[i].freq, m;
+        if (point[i].quality < min_quality || point[i].gain <= 0.0f) {
+            continue;
+        }
+        m = (double) point[i].gain * point[i].gain * (integrator ? w * w : 1.0);
+        x_ref = w * w > x_ref ? w * w : x_ref;
+        m_ref = m > m_ref ? m : m_ref;
+        if (first == 0xFF) {
+            first = i;
+        }
+        used++;
+    }
+    fit->point_used = used;
+    if (used < order + 2) {
+        return -1;
+    }
+
+    //最小化 sum((m (a + b x + c x^2) - 1)^2), 即1/|G|^2的相对误差
+    for (i = 0; i < num; i++) {
+        double w = 2.0 * PI * point[i].freq, x, m, row[3];
+        if (point[i].quality < min_quality || point[i].gain <= 0.0f) {
+            continue;
+        }
+        x = w * w / x_ref;
+        m = (double) point[i].gain * point[i].gain * (integrator ? w * w : 1.0) / m_ref;
+        row[0] = m;
+        row[1] = m * x;
+        row[2] = m * x * x;
+        for (j = 0; j <= order; j++) {
+            for (k = 0; k <= order; k++) {
+                ata[j][k] += row[j] * row[k];
+            }
+            atb[j] += row[j];
+        }
+    }
+    //高斯消元,列主元
+    for (j = 0; j <= order; j++) {
+        uint8_t pivot = j;
+        double t;
+        for (k = j + 1; k <= order; k++) {
+            if (fabs(ata[k][j]) > fabs(ata[pivot][j])) {
+                pivot = k;
+            }
+        }
+        if (fabs(ata[pivot][j]) < 1e-12) {
+            return -1;
+        }
+        if (pivot != j) {
+            for (k = 0; k <= order; k++) {
+                t = ata[j][k];
+                ata[j][k] = ata[pivot][k];
+                ata[pivot][k] = t;
+            }
+            t = atb[j];
+            atb[j] = atb[pivot];
+            atb[pivot] = t;
+        }
+        for (k = j + 1; k <= order; k++) {
+            double f = ata[k][j] / ata[j][j];
+            for (i = j; i <= order; i++) {
+                ata[k][i] -= f * ata[j][i];
+            }
+            atb[k] -= f * atb[j];
+        }
+    }
+    for (j = order + 1; j-- > 0;) {
+        double s = atb[j];
+        for (k = j + 1; k <= order; k++) {
+            s -= ata[j][k] * p[k];
+        }
+        p[j] = s / ata[j][j];
+    }
+    a = p[0] / m_ref;
+    b = p[1] / (m_ref * x_ref);
+    c = p[2] / (m_ref * x_ref * x_ref);
+    if (a <= 0.0) {
+        return -1;
+    }
+    fit->gain = (float32_t) (1.0 / sqrt(a));
+    if (order == 1) {
+        fit->time_const = b > 0.0 ? (float32_t) sqrt(b / a) : 0.0f;
+    } else {
+        double z2;
+        if (c <= 0.0) {
+            return -1;
+        }
+        fit->wn = (float32_t) sqrt(sqrt(a / c));
+        //b / sqrt(ac) = 4 zeta^2 - 2
+        z2 = (b / sqrt(a * c) + 2.0) / 4.0;
+        fit->zeta = z2 > 0.0 ? (float32_t) sqrt(z2) : 0.0f;
+    }
+
+    //第一个点的相位与模型相差pi的奇数倍时为反向电机,剩余相位为延迟 w * delay
+    for (i = first; i < num; i++) {
+        float32_t w = SYS_ID_2PI * point[i].freq, g, ph;
+        if (point[i].quality < min_quality || point[i].gain <= 0.0f) {
+            continue;
+        }
+        sys_id_model_response(fit, point[i].freq, &g, &ph);
+        if (i == first) {
+            turn = (int32_t) roundf((ph - point[i].phase) / PI);
+        }
+        sum_wr += (double) w * (ph - (point[i].phase + (float32_t) turn * PI));
+        sum_ww += (double) w * w;
+        sum_err += ((double) g / point[i].gain - 1.0) * ((double) g / point[i].gain - 1.0);
+    }
+    if (turn & 1) {
+        fit->gain = -fit->gain;
+    }
+    fit->delay = (float32_t) (sum_wr / sum_ww);
+    fit->fit_error = (float32_t) sqrt(sum_err / used);
+    fit->valid = 0;
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+  * @file       sys_id.c/h
+  * @brief      frequency response identification of one motor loop. A sine is
+  *             added to the current or speed command, either stepped from point
+  *             to point or swept as a chirp, and input and output are
+  *             correlated with the excitation phase to get gain and phase at
+  *             each frequency. A plant model is fitted to the points for the
+  *             gain, time constant or natural frequency and damping, and delay.
+  *             单个电机环的频率响应辨识.在电流或速度给定上叠加正弦,逐点步进或连续扫频,
+  *             输入输出与激励相位做相关得到各频率点的增益和相位,再拟合对象模型得到增益、
+  *             时间常数或固有频率和阻尼比、延迟
+  * @note       the correlation is a single bin DFT at the excitation phase, the
+  *             same result as Goertzel but valid while the chirp frequency moves.
+  *             Means are removed with running sums, so offsets such as the pitch
+  *             gravity current do not leak into the bin. A stepped point snaps
+  *             its frequency so the measured cycles span a whole number of
+  *             samples. The chirp sweeps with a constant number of cycles per
+  *             point, so 1/f falls linearly with time. It is faster than the
+  *             stepped sine but less accurate around a sharp resonance.
+  *             The fit minimises the relative gain error of 1/|G|^2, a polynomial
+  *             in w^2, then takes the delay from the phase left over.
+  *             相关计算为激励相位上的单点DFT,结果与Goertzel相同,且扫频时频率变化也适用.
+  *             均值由累加和扣除,pitch重力补偿电流等偏置不会进入结果.步进时调整频率使测量
+  *             的周期数正好为整数个采样.扫频时每个频率点的周期数相同,1/f随时间线性减小,
+  *             比步进快,但在尖锐谐振附近误差较大.
+  *             拟合以1/|G|^2为w^2的多项式,最小化增益相对误差,剩余相位用于求延迟
+  */
+#ifndef SYS_ID_H
+#define SYS_ID_H
+
+#include "struct_typedef.h"
+
+#define SYS_ID_MAX_POINT        40
+#define SYS_ID_SETTLE_CYCLES    3.0f        //每个频率点测量前等待的周期数
+#define SYS_ID_MEASURE_CYCLES   5.0f        //每个频率点测量的周期数
+#define SYS_ID_MIN_QUALITY      0.5f        //参与拟合的最小正弦能量占比
+
+typedef enum {
+    SYS_ID_STEPPED_SINE = 0,                //逐点步进正弦
+    SYS_ID_CHIRP,                           //连续扫频
+} sys_id_mode_e;
+
+typedef enum {
+    SYS_ID_FIRST_ORDER = 0,                 //K / (Ts + 1), 电流到速度
+    SYS_ID_SECOND_ORDER,                    //K wn^2 / (s^2 + 2 zeta wn s + wn^2), 带谐振
+    SYS_ID_INTEGRATOR_FIRST_ORDER,          //K / (s (Ts + 1)), 速度环闭环后到角度
+    SYS_ID_INTEGRATOR_SECOND_ORDER,         //K wn^2 / (s (s^2 + 2 zeta wn s + wn^2))
+} sys_id_model_e;
+
+typedef enum {
+    SYS_ID_IDLE = 0,
+    SYS_ID_SETTLE,                          //等待过渡过程结束
+    SYS_ID_MEASURE,
+    SYS_ID_DONE,
+    SYS_ID_ABORT,                           //反馈超出限制
+} sys_id_state_e;
+
+typedef struct {
+    float32_t freq;                         //Hz
+    float32_t gain;                         //输出幅值 / 输入幅值
+    float32_t phase;                        //rad, 按频率顺序展开
+    float32_t quality;                      //输出中激励频率正弦的能量占比, 0~1
+} sys_id_point_t;
+
+typedef struct {
+    int8_t valid;                           //0:拟合成功, -1:有效点不足或模型不符
+    sys_id_model_e model;
+    float32_t gain;                         //K, 反向的电机为负
+    float32_t time_const;                   //T s, 一阶模型
+    float32_t wn;                           //rad/s, 二阶模型
+    float32_t zeta;                         //二阶模型
+    float32_t delay;                        //s, 反馈采样相对给定的延迟
+    float32_t bandwidth;                    //Hz, 测量数据-3dB, 积分模型按w|G|计算, 0:未下降到-3dB
+    float32_t peak_freq;                    //Hz, 测量数据最大增益
+    float32_t peak_db;                      //相对第一个点的增益
+    float32_t fit_error;                    //增益相对误差均方根
+    uint8_t point_used;                     //参与拟合的点数
+} sys_id_fit_t;
+
+typedef struct {
+    const float32_t *input;                 //被测环反馈
+    float32_t *output;                      //激励写入的给定值
+    sys_id_mode_e mode;
+    sys_id_model_e model;
+    float32_t offset;                       //给定值的中心
+    float32_t amplitude;
+    float32_t input_limit;                  //反馈绝对值超出时停止, 0:不检查
+    float32_t f_start, f_end;               //Hz
+    float32_t ratio;                        //相邻频率点之比
+    float32_t sweep_rate;                   //扫频 df/dt = sweep_rate * f^2
+    float32_t settle_cycles;
+    float32_t measure_cycles;
+    float32_t min_quality;
+    float32_t dt;                           //调用周期 s
+
+    sys_id_state_e state;
+    uint8_t point_num;
+    uint8_t point_done;                     //已完成的频率点数
+    float32_t freq;                         //当前激励频率 Hz
+    float32_t phase;                        //激励相位 rad, 0~2pi
+    float32_t last_sin, last_cos;           //上一次输出对应的相位
+    uint32_t sample;                        //当前阶段已用的采样数
+    uint32_t sample_num;                    //当前阶段的采样数, 扫频时不使用
+
+    //当前频率点的累加和, 反馈以该点第一个采样为基准, 避免大偏置损失精度
+    float32_t y_ref;
+    float32_t sum_f, sum_c, sum_s;
+    float32_t sum_u, sum_uc, sum_us;
+    float32_t sum_y, sum_yc, sum_ys, sum_yy;
+    uint32_t n;
+
+    sys_id_point_t point[SYS_ID_MAX_POINT];
+    sys_id_fit_t fit;
+} sys_id_t;
+
+/**
+  * @brief          init an identification run, the excitation starts at the next
+  *                 sys_id_update
+  * @param[out]     id: identification data
+  * @param[in]      input: loop feedback
+  * @param[in]      output: command the excitation is written to
+  * @param[in]      mode: stepped sine or chirp
+  * @param[in]      model: plant model to fit
+  * @param[in]      offset: command center, e.g. the gravity current of pitch
+  * @param[in]      amplitude: excitation amplitude
+  * @param[in]      f_start: first frequency, Hz
+  * @param[in]      f_end: last frequency, Hz, below 1 / (4 dt)
+  * @param[in]      point_num: number of log spaced points, 2 ~ SYS_ID_MAX_POINT
+  * @param[in]      input_limit: abort when |input| exceeds it, 0 no check
+  * @param[in]      dt: update period, s
+  * @retval         0: ok, -1: bad argument
+  */
+/**
+  * @brief          初始化一次辨识,下一次调用sys_id_update时开始激励
+  * @param[out]     id: 辨识数据
+  * @param[in]      input: 被测环反馈
+  * @param[in]      output: 激励写入的给定值
+  * @param[in]      mode: 步进正弦或扫频
+  * @param[in]      model: 拟合的对象模型
+  * @param[in]      offset: 给定值的中心, 例如pitch的重力补偿电流
+  * @param[in]      amplitude: 激励幅值
+  * @param[in]      f_start: 起始频率 Hz
+  * @param[in]      f_end: 结束频率 Hz, 小于1 / (4 dt)
+  * @param[in]      point_num: 对数均匀分布的频率点数, 2 ~ SYS_ID_MAX_POINT
+  * @param[in]      input_limit: 反馈绝对值超出时停止, 0不检查
+  * @param[in]      dt: 调用周期 s
+  * @retval         0:成功, -1:参数错误
+  */
+extern int sys_id_init(sys_id_t *id, const float32_t *input, float32_t *output, sys_id_mode_e mode,
+                       sys_id_model_e model, float32_t offset, float32_t amplitude, float32_t f_start,
+                       float32_t f_end, uint8_t point_num, float32_t input_limit, float32_t dt);
+
+/**
+  * @brief          设置每个频率点等待和测量的周期数,在sys_id_init之后、开始之前调用
+  */
+extern void sys_id_set_cycles(sys_id_t *id, float32_t settle_cycles, float32_t measure_cycles);
+
+/**
+  * @brief          one step: take the feedback of the last command, then write
+  *                 the next command. The fit runs in the step that finishes the
+  *                 last point.
+  * @param[in]      id: identification data
+  * @retval         sys_id_state_e
+  */
+/**
+  * @brief          运行一步:读取上一次给定对应的反馈,再写入下一次给定.完成最后一个频率点
+  *                 的那一步中进行拟合
+  * @param[in]      id: 辨识数据
+  * @retval         sys_id_state_e
+  */
+extern sys_id_state_e sys_id_update(sys_id_t *id);
+
+/**
+  * @brief          停止激励,给定值回到中心
+  */
+extern void sys_id_stop(sys_id_t *id);
+
+/**
+  * @brief          fit a plant model to the measured points and get bandwidth
+  *                 and peak from the measured gains
+  * @param[in]      point: measured points, ascending frequency
+  * @param[in]      num: number of points
+  * @param[in]      model: plant model
+  * @param[in]      min_quality: points below it are not fitted
+  * @param[out]     fit: result
+  * @retval         0: ok, -1: too few points or the model does not match
+  */
+/**
+  * @brief          用测量点拟合对象模型,并由测量增益得到带宽和谐振峰
+  * @param[in]      point: 测量点, 频率升序
+  * @param[in]      num: 点数
+  * @param[in]      model: 对象模型
+  * @param[in]      min_quality: 低于该值的点不参与拟合
+  * @param[out]     fit: 结果
+  * @retval         0:成功, -1:有效点不足或模型不符
+  */
+extern int sys_id_fit(const sys_id_point_t *point, uint8_t num, sys_id_model_e model, float32_t min_quality,
+                      sys_id_fit_t *fit);
+
+/**
+  * @brief          拟合模型在频率freq(Hz)处的增益和相位(rad)
+  */
+extern void sys_id_model_response(const sys_id_fit_t *fit, float32_t freq, float32_t *gain, float32_t *phase);
+
+#endif
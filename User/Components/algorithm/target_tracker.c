@@ -0,0 +1,229 @@
+/**
+  * @file       target_tracker.c/h
+  * @brief      Kalman filter tracker of a target direction in the world frame.
+  *             世界坐标系下目标方向的卡尔曼跟踪器
+  */
+#include "target_tracker.h"
+#include "arm_math.h"
+#include <string.h>
+
+/**
+  * @brief          状态转移矩阵F,只填写前n阶
+  */
+static void target_tracker_transition(float32_t F[TARGET_TRACKER_MAX_STATE][TARGET_TRACKER_MAX_STATE], float32_t dt) {
+    memset(F, 0, sizeof(float32_t) * TARGET_TRACKER_MAX_STATE * TARGET_TRACKER_MAX_STATE);
+    F[0][0] = F[1][1] = F[2][2] = 1.0f;
+    F[0][1] = F[1][2] = dt;
+    F[0][2] = 0.5f * dt * dt;
+}
+
+/**
+  * @brief          把状态外推dt,不计算协方差
+  */
+static void target_tracker_extrapolate(const target_tracker_t *tracker, const target_tracker_axis_t *axis,
+                                       float32_t dt, float32_t *angle) {
+    *angle = axis->x[0] + axis->x[1] * dt;
+    if (tracker->model == TARGET_TRACKER_CA) {
+        *angle += 0.5f * axis->x[2] * dt * dt;
+    }
+}
+
+/**
+  * @brief          一个轴的时间更新 x = F x, P = F P F' + Q, Q为最高阶状态白噪声的离散化
+  */
+static void target_tracker_axis_predict(const target_tracker_t *tracker, target_tracker_axis_t *axis, float32_t q,
+                                        float32_t dt) {
+    float32_t F[TARGET_TRACKER_MAX_STATE][TARGET_TRACKER_MAX_STATE];
+    float32_t FP[TARGET_TRACKER_MAX_STATE][TARGET_TRACKER_MAX_STATE];
+    float32_t x[TARGET_TRACKER_MAX_STATE];
+    float32_t dt2 = dt * dt, dt3 = dt2 * dt;
+    uint8_t n = (uint8_t) tracker->model;
+    uint8_t i, j, k;
+
+    target_tracker_transition(F, dt);
+    for (i = 0; i < n; i++) {
+        x[i] = 0.0f;
+        for (k = 0; k < n; k++) {
+            x[i] += F[i][k] * axis->x[k];
+        }
+    }
+    memcpy(axis->x, x, sizeof(float32_t) * n);
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            FP[i][j] = 0.0f;
+            for (k = 0; k < n; k++) {
+                FP[i][j] += F[i][k] * axis->P[k][j];
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            axis->P[i][j] = 0.0f;
+            for (k = 0; k < n; k++) {
+                axis->P[i][j] += FP[i][k] * F[j][k];
+            }
+        }
+    }
+
+    if (tracker->model == TARGET_TRACKER_CA) {
+        axis->P[0][0] += q * dt3 * dt2 / 20.0f;
+        axis->P[0][1] += q * dt2 * dt2 / 8.0f;
+        axis->P[0][2] += q * dt3 / 6.0f;
+        axis->P[1][1] += q * dt3 / 3.0f;
+        axis->P[1][2] += q * dt2 / 2.0f;
+        axis->P[2][2] += q * dt;
+        axis->P[1][0] = axis->P[0][1];
+        axis->P[2][0] = axis->P[0][2];
+        axis->P[2][1] = axis->P[1][2];
+    } else {
+        axis->P[0][0] += q * dt3 / 3.0f;
+        axis->P[0][1] += q * dt2 / 2.0f;
+        axis->P[1][1] += q * dt;
+        axis->P[1][0] = axis->P[0][1];
+    }
+}
+
+/**
+  * @brief          一个轴的测量更新,H = [1 0 0]
+  */
+static void target_tracker_axis_correct(const target_tracker_t *tracker, target_tracker_axis_t *axis) {
+    float32_t K[TARGET_TRACKER_MAX_STATE];
+    float32_t P0[TARGET_TRACKER_MAX_STATE];
+    float32_t s = axis->P[0][0] + tracker->r;
+    uint8_t n = (uint8_t) tracker->model;
+    uint8_t i, j;
+
+    for (i = 0; i < n; i++) {
+        K[i] = axis->P[i][0] / s;
+        P0[i] = axis->P[0][i];
+    }
+    for (i = 0; i < n; i++) {
+        axis->x[i] += K[i] * axis->innovation;
+        for (j = 0; j < n; j++) {
+            axis->P[i][j] -= K[i] * P0[j];
+        }
+    }
+}
+
+static void target_tracker_start(target_tracker_t *tracker, uint32_t tick,
+                                 const float32_t measure[TARGET_TRACKER_AXIS_NUM]) {
+    uint8_t i;
+
+    memset(tracker->axis, 0, sizeof(tracker->axis));
+    for (i = 0; i < TARGET_TRACKER_AXIS_NUM; i++) {
+        tracker->axis[i].x[0] = measure[i];
+        tracker->axis[i].P[0][0] = tracker->r;
+        tracker->axis[i].P[1][1] = tracker->speed_std * tracker->speed_std;
+        tracker->axis[i].P[2][2] = tracker->accel_std * tracker->accel_std;
+    }
+    tracker->tracking = 1;
+    tracker->reject_num = 0;
+    tracker->state_tick = tick;
+    tracker->start_cnt++;
+}
+
+void target_tracker_init(target_tracker_t *tracker, target_tracker_model_e model,
+                         const float32_t q[TARGET_TRACKER_AXIS_NUM], float32_t r, float32_t speed_std,
+                         float32_t accel_std, float32_t gate, float32_t timeout, float32_t tick_hz) {
+    if (tracker == NULL) {
+        return;
+    }
+    memset(tracker, 0, sizeof(target_tracker_t));
+    tracker->model = (model == TARGET_TRACKER_CA) ? TARGET_TRACKER_CA : TARGET_TRACKER_CV;
+    tracker->q[TARGET_TRACKER_YAW] = q[TARGET_TRACKER_YAW];
+    tracker->q[TARGET_TRACKER_PITCH] = q[TARGET_TRACKER_PITCH];
+    tracker->r = r;
+    tracker->speed_std = speed_std;
+    tracker->accel_std = accel_std;
+    tracker->gate = gate;
+    tracker->timeout = timeout;
+    tracker->tick_hz = tick_hz;
+}
+
+void target_tracker_reset(target_tracker_t *tracker) {
+    if (tracker == NULL) {
+        return;
+    }
+    tracker->tracking = 0;
+    tracker->reject_num = 0;
+}
+
+target_tracker_result_e target_tracker_update(target_tracker_t *tracker, uint32_t tick,
+                                              const float32_t measure[TARGET_TRACKER_AXIS_NUM]) {
+    target_tracker_axis_t axis[TARGET_TRACKER_AXIS_NUM];
+    float32_t dt, innovation;
+    uint8_t i, reject = 0;
+
+    if (!tracker->tracking) {
+        target_tracker_start(tracker, tick, measure);
+        return TARGET_TRACKER_STARTED;
+    }
+    if ((int32_t) (tick - tracker->state_tick) < 0) {
+        tracker->stale_cnt++;
+        return TARGET_TRACKER_STALE;
+    }
+    dt = (float32_t) (tick - tracker->state_tick) / tracker->tick_hz;
+    if (dt > tracker->timeout) {
+        target_tracker_start(tracker, tick, measure);
+        return TARGET_TRACKER_STARTED;
+    }
+
+    //在副本上预测并检查门限,被拒绝的测量不改变滤波状态
+    memcpy(axis, tracker->axis, sizeof(axis));
+    for (i = 0; i < TARGET_TRACKER_AXIS_NUM; i++) {
+        target_tracker_axis_predict(tracker, &axis[i], tracker->q[i], dt);
+        innovation = measure[i] - axis[i].x[0];
+        //yaw沿较短的弧求新息
+        if (i == TARGET_TRACKER_YAW) {
+            innovation = innovation - 2.0f * PI * floorf(innovation / (2.0f * PI) + 0.5f);
+        }
+        axis[i].innovation = innovation;
+        if (innovation * innovation > tracker->gate * tracker->gate * (axis[i].P[0][0] + tracker->r)) {
+            reject = 1;
+        }
+    }
+    if (reject) {
+        tracker->reject_cnt++;
+        if (++tracker->reject_num >= TARGET_TRACKER_MAX_REJECT) {
+            target_tracker_start(tracker, tick, measure);
+            return TARGET_TRACKER_STARTED;
+        }
+        return TARGET_TRACKER_REJECTED;
+    }
+
+    for (i = 0; i < TARGET_TRACKER_AXIS_NUM; i++) {
+        target_tracker_axis_correct(tracker, &axis[i]);
+    }
+    memcpy(tracker->axis, axis, sizeof(axis));
+    tracker->state_tick = tick;
+    tracker->reject_num = 0;
+    tracker->update_cnt++;
+    return TARGET_TRACKER_UPDATED;
+}
+
+bool_t target_tracker_predict(target_tracker_t *tracker, uint32_t tick, float32_t lead,
+                              float32_t aim[TARGET_TRACKER_AXIS_NUM]) {
+    float32_t dt;
+    uint8_t i;
+
+    if (!tracker->tracking) {
+        return 0;
+    }
+    dt = (float32_t) (int32_t) (tick - tracker->state_tick) / tracker->tick_hz;
+    if (dt > tracker->timeout) {
+        tracker->tracking = 0;
+        return 0;
+    }
+    //射速或距离异常时提前量可能为inf或NaN
+    if (!(lead > 0.0f)) {
+        lead = 0.0f;
+    } else if (lead > TARGET_TRACKER_MAX_LEAD) {
+        lead = TARGET_TRACKER_MAX_LEAD;
+    }
+    for (i = 0; i < TARGET_TRACKER_AXIS_NUM; i++) {
+        target_tracker_extrapolate(tracker, &tracker->axis[i], dt + lead, &tracker->aim[i]);
+        aim[i] = tracker->aim[i];
+    }
+    return 1;
+}
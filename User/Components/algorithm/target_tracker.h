@@ -0,0 +1,152 @@
+/**
+  * @file       target_tracker.c/h
+  * @brief      Kalman filter tracker of a target direction (yaw, pitch) in the
+  *             world frame. Each axis is an independent constant velocity or
+  *             constant acceleration filter, fed with delayed measurements at
+  *             their capture time and extrapolated to any later instant, so the
+  *             gimbal gets a smooth aim point at its own rate with a lead for the
+  *             bullet time of flight.
+  *             世界坐标系下目标方向(yaw, pitch)的卡尔曼跟踪器.每个轴为独立的匀速或匀加速
+  *             模型,延迟的测量按拍摄时刻融合,可外推到之后任意时刻,云台按自身频率得到
+  *             平滑的瞄准点,并可加上弹丸飞行时间的提前量
+  * @note       the filter state stays at the capture time of the last measurement,
+  *             prediction does not change it. Measurements older than the state are
+  *             dropped. An innovation beyond gate sigma is rejected, after
+  *             TARGET_TRACKER_MAX_REJECT rejections in a row the filter restarts on
+  *             the new target. Without a measurement for timeout the track is lost.
+  *             Yaw innovations are taken along the shorter arc, the yaw state itself
+  *             is continuous and not wrapped.
+  *             滤波状态停留在最后一次测量的拍摄时刻,预测不改变状态.早于状态的测量被丢弃.
+  *             新息超过gate倍标准差时拒绝,连续拒绝TARGET_TRACKER_MAX_REJECT次后在新目标
+  *             上重新开始.超过timeout无测量时丢失目标.yaw新息取较短的弧,yaw状态连续不限幅
+  */
+#ifndef TARGET_TRACKER_H
+#define TARGET_TRACKER_H
+
+#include "struct_typedef.h"
+
+#define TARGET_TRACKER_MAX_STATE    3
+#define TARGET_TRACKER_MAX_REJECT   3
+//提前量上限 s,超过时截断,NaN或负值按0处理
+#define TARGET_TRACKER_MAX_LEAD     1.0f
+
+typedef enum {
+    TARGET_TRACKER_CV = 2,          //匀速模型,状态为角度,角速度
+    TARGET_TRACKER_CA = 3,          //匀加速模型,状态为角度,角速度,角加速度
+} target_tracker_model_e;
+
+typedef enum {
+    TARGET_TRACKER_YAW = 0,
+    TARGET_TRACKER_PITCH,
+    TARGET_TRACKER_AXIS_NUM,
+} target_tracker_axis_e;
+
+typedef enum {
+    TARGET_TRACKER_UPDATED = 0,     //测量已融合
+    TARGET_TRACKER_STARTED,         //以该测量开始新的跟踪
+    TARGET_TRACKER_REJECTED,        //新息超出门限被拒绝
+    TARGET_TRACKER_STALE,           //测量早于滤波状态被丢弃
+} target_tracker_result_e;
+
+typedef struct {
+    float32_t x[TARGET_TRACKER_MAX_STATE];          //角度rad, 角速度rad/s, 角加速度rad/s^2
+    float32_t P[TARGET_TRACKER_MAX_STATE][TARGET_TRACKER_MAX_STATE];
+    float32_t innovation;                           //最近一次测量的新息 rad
+} target_tracker_axis_t;
+
+typedef struct {
+    target_tracker_model_e model;
+    float32_t q[TARGET_TRACKER_AXIS_NUM];           //各轴最高阶状态的过程噪声谱密度
+    float32_t r;                    //测量方差 rad^2
+    float32_t speed_std;            //开始跟踪时角速度的标准差 rad/s
+    float32_t accel_std;            //开始跟踪时角加速度的标准差 rad/s^2
+    float32_t gate;                 //新息门限,标准差的倍数
+    float32_t timeout;              //无测量超过该时间丢失目标 s
+    float32_t tick_hz;              //时间戳计数频率
+
+    uint8_t tracking;
+    uint8_t reject_num;             //连续拒绝次数
+    uint32_t state_tick;            //滤波状态对应的时刻
+    target_tracker_axis_t axis[TARGET_TRACKER_AXIS_NUM];
+    float32_t aim[TARGET_TRACKER_AXIS_NUM];         //最近一次预测的瞄准角 rad
+    //统计(调试时使用)
+    uint32_t update_cnt;
+    uint32_t start_cnt;
+    uint32_t reject_cnt;
+    uint32_t stale_cnt;
+} target_tracker_t;
+
+/**
+  * @brief          init the tracker
+  * @param[out]     tracker: tracker
+  * @param[in]      model: constant velocity or constant acceleration
+  * @param[in]      q: process noise spectral density of the highest order state, per axis
+  * @param[in]      r: measurement variance, rad^2
+  * @param[in]      speed_std: initial speed std, rad/s
+  * @param[in]      accel_std: initial acceleration std, rad/s^2
+  * @param[in]      gate: innovation gate in sigma
+  * @param[in]      timeout: track lost after this time without a measurement, s
+  * @param[in]      tick_hz: frequency of the timestamps
+  * @retval         none
+  */
+/**
+  * @brief          初始化跟踪器
+  * @param[out]     tracker: 跟踪器
+  * @param[in]      model: 匀速或匀加速模型
+  * @param[in]      q: 各轴最高阶状态的过程噪声谱密度
+  * @param[in]      r: 测量方差, rad^2
+  * @param[in]      speed_std: 开始跟踪时角速度的标准差, rad/s
+  * @param[in]      accel_std: 开始跟踪时角加速度的标准差, rad/s^2
+  * @param[in]      gate: 新息门限,标准差的倍数
+  * @param[in]      timeout: 超过该时间无测量丢失目标, s
+  * @param[in]      tick_hz: 时间戳计数频率
+  * @retval         none
+  */
+extern void target_tracker_init(target_tracker_t *tracker, target_tracker_model_e model,
+                                const float32_t q[TARGET_TRACKER_AXIS_NUM], float32_t r,
+                                float32_t speed_std, float32_t accel_std, float32_t gate, float32_t timeout,
+                                float32_t tick_hz);
+
+/**
+  * @brief          fuse one measurement taken at tick
+  * @param[in]      tracker: tracker
+  * @param[in]      tick: capture time
+  * @param[in]      measure: world frame yaw and pitch, rad
+  * @retval         target_tracker_result_e
+  */
+/**
+  * @brief          融合一次在tick时刻拍摄的测量
+  * @param[in]      tracker: 跟踪器
+  * @param[in]      tick: 拍摄时刻
+  * @param[in]      measure: 世界坐标系下的yaw, pitch, rad
+  * @retval         target_tracker_result_e
+  */
+extern target_tracker_result_e target_tracker_update(target_tracker_t *tracker, uint32_t tick,
+                                                     const float32_t measure[TARGET_TRACKER_AXIS_NUM]);
+
+/**
+  * @brief          aim angles at tick plus lead, the filter state is not changed
+  * @param[in]      tracker: tracker
+  * @param[in]      tick: now
+  * @param[in]      lead: extra prediction time, e.g. bullet time of flight, s,
+  *                 clamped to [0, TARGET_TRACKER_MAX_LEAD], NaN counts as 0
+  * @param[out]     aim: yaw and pitch, rad, yaw not wrapped
+  * @retval         1: tracking, 0: no target, aim unchanged
+  */
+/**
+  * @brief          tick时刻再提前lead的瞄准角,不改变滤波状态
+  * @param[in]      tracker: 跟踪器
+  * @param[in]      tick: 当前时刻
+  * @param[in]      lead: 额外的预测时间,如弹丸飞行时间, s, 限制在[0, TARGET_TRACKER_MAX_LEAD], NaN按0处理
+  * @param[out]     aim: yaw, pitch, rad, yaw不限幅
+  * @retval         1:跟踪中, 0:无目标, aim不变
+  */
+extern bool_t target_tracker_predict(target_tracker_t *tracker, uint32_t tick, float32_t lead,
+                                     float32_t aim[TARGET_TRACKER_AXIS_NUM]);
+
+/**
+  * @brief          丢弃当前目标
+  */
+extern void target_tracker_reset(target_tracker_t *tracker);
+
+#endif
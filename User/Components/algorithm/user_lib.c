@@ -1,7 +1,6 @@
 #include "user_lib.h"
 #include "arm_math.h"
 #include "arm_const_structs.h"
-#include "SEGGER_RTT.h"
 
 //快速指数
 float32_t invpow(float32_t x, float32_t n) {
@@ -13,7 +12,7 @@ float32_t invpow(float32_t x, float32_t n) {
 float32_t invSqrt(float32_t num) {
     float32_t halfnum = 0.5f * num;
     float32_t y = num;
-    long i = *(long *) &y;
+    int32_t i = *(int32_t *) &y;
     i = 0x5f3759df - (i >> 1);
     y = *(float32_t *) &i;
     y = y * (1.5f - (halfnum * y * y));
@@ -31,3 +31,20 @@ void DWT_get_time_interval_us(time_record_struct *task_time) {
         task_time->last_time = DWT_get_tick();
 }
 
+/**
+  * @brief          DWT计数差值转换为us,差值由无符号减法得到,CYCCNT溢出一次以内均正确
+  * @param[in]      tick: DWT计数差值
+  * @retval         us
+  */
+uint32_t DWT_tick_to_us(uint32_t tick) {
+    return tick / (HAL_RCC_GetHCLKFreq() / 1000000U);
+}
+
+/**
+  * @brief          us转换为DWT计数差值
+  * @param[in]      us: 时间,不超过一次CYCCNT溢出(168MHz时约25s)
+  * @retval         DWT计数差值
+  */
+uint32_t DWT_us_to_tick(uint32_t us) {
+    return us * (HAL_RCC_GetHCLKFreq() / 1000000U);
+}
@@ -7,7 +7,7 @@
 #include <stdint.h>
 typedef struct {
     uint32_t last_time;
-    uint16_t time;
+    uint32_t time;  //us
 } time_record_struct;
 
 typedef struct {
@@ -20,8 +20,6 @@ typedef struct {
     time_record_struct tim_vision_rx_task;
     time_record_struct tim_servo_task;
     time_record_struct tim_referee_rx_task;
-    time_record_struct tim_USART6TX_active_task;
-    time_record_struct tim_USART1TX_active_task;
     time_record_struct tim_referee_tx_task;
     time_record_struct tim_vision_tx_task;
     time_record_struct tim_matlab_sync_task;
@@ -49,4 +47,8 @@ extern uint32_t DWT_get_tick(void);
 
 extern void DWT_get_time_interval_us(time_record_struct *task_time);
 
+extern uint32_t DWT_tick_to_us(uint32_t tick);
+
+extern uint32_t DWT_us_to_tick(uint32_t us);
+
 #endif //ROBOMASTERROBOTCODE_DWT_H
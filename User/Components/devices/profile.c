@@ -0,0 +1,171 @@
+/**
+  * @file       profile.c/h
+  * @brief      per-task and per-ISR timing profiler in raw DWT cycles.
+  *             以DWT原始计数统计各任务和中断的执行时间与激活抖动
+  * @note       updates run in a short PRIMASK critical section so a snapshot
+  *             taken from another task is always consistent.
+  *             更新在短暂的PRIMASK临界区中进行,其他任务取得的快照总是一致的
+  */
+#include "profile.h"
+#include "DWT.h"
+#include "main.h"
+#include "macro_mutex.h"
+#include <string.h>
+
+#define PROFILE_OVERHEAD_TRY_NUM 16
+
+profile_point_t global_profile[PROFILE_NUM];
+uint32_t profile_overhead_cycles;
+
+//统计点名称和标称周期(us)
+static const struct {
+    const char *name;
+    uint32_t period_us;
+} profile_config[PROFILE_NUM] = {
+        [PROFILE_GIMBAL_TASK] = {"gimbal_task", 1000},
+        [PROFILE_CHASSIS_TASK] = {"chassis_task", 1000},
+        [PROFILE_INS_TASK] = {"INS_task", 0},
+        [PROFILE_IMU_EXTI_ISR] = {"imu_exti_isr", 0},
+        [PROFILE_IMU_SPI_DMA_ISR] = {"imu_spi_dma_isr", 0},
+        [PROFILE_CAN_RX_ISR] = {"can_rx_isr", 0},
+        [PROFILE_CHASSIS_PID] = {"chassis_pid", 0},
+};
+
+static void profile_hist_clear(profile_hist_t *p_hist) {
+    memset(p_hist, 0, sizeof(profile_hist_t));
+    p_hist->min = 0xFFFFFFFFU;
+}
+
+static void profile_point_clear(profile_point_t *p_point) {
+    p_point->started = 0;
+    profile_hist_clear(&p_point->exec);
+    profile_hist_clear(&p_point->jitter);
+}
+
+uint8_t profile_hist_bucket(uint32_t value) {
+    if (value < 2U) {
+        return 0;
+    }
+    return (uint8_t) (31 - __builtin_clz(value));
+}
+
+void profile_hist_add(profile_hist_t *p_hist, uint32_t value) {
+    p_hist->cnt++;
+    p_hist->sum += value;
+    if (value < p_hist->min) {
+        p_hist->min = value;
+    }
+    if (value > p_hist->max) {
+        p_hist->max = value;
+    }
+    p_hist->bucket[profile_hist_bucket(value)]++;
+}
+
+uint32_t profile_hist_mean(const profile_hist_t *p_hist) {
+    if (p_hist->cnt == 0U) {
+        return 0;
+    }
+    return (uint32_t) (p_hist->sum / p_hist->cnt);
+}
+
+uint32_t profile_hist_percentile(const profile_hist_t *p_hist, uint16_t permille) {
+    uint64_t target;
+    uint32_t acc = 0;
+    uint8_t i;
+
+    if (p_hist->cnt == 0U) {
+        return 0;
+    }
+    //至少覆盖cnt*permille/1000个样本,向上取整
+    target = ((uint64_t) p_hist->cnt * permille + 999U) / 1000U;
+    for (i = 0; i < PROFILE_BUCKET_NUM; i++) {
+        acc += p_hist->bucket[i];
+        if (acc >= target) {
+            break;
+        }
+    }
+    if (i >= PROFILE_BUCKET_NUM - 1) {
+        return p_hist->max;
+    }
+    //格的上界不超过实际最大值
+    return ((2U << i) - 1U < p_hist->max) ? (2U << i) - 1U : p_hist->max;
+}
+
+void profile_begin(profile_id_e id) {
+    MUTEX_DECLARE(mutex);
+    profile_point_t *p_point = &global_profile[id];
+    uint32_t now = DWT_get_tick();
+    uint32_t interval;
+
+    MUTEX_LOCK(mutex);
+    if (p_point->started) {
+        interval = now - p_point->last_start_tick;
+        if (p_point->period) {
+            interval = (interval > p_point->period) ? interval - p_point->period : p_point->period - interval;
+        }
+        profile_hist_add(&p_point->jitter, interval);
+    }
+    p_point->started = 1;
+    p_point->last_start_tick = now;
+    p_point->start_tick = now;
+    MUTEX_UNLOCK(mutex);
+}
+
+void profile_end(profile_id_e id) {
+    MUTEX_DECLARE(mutex);
+    profile_point_t *p_point = &global_profile[id];
+    uint32_t now = DWT_get_tick();
+
+    MUTEX_LOCK(mutex);
+    //复位后尚未begin的end不计入
+    if (p_point->started) {
+        profile_hist_add(&p_point->exec, now - p_point->start_tick);
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+void profile_snapshot(profile_id_e id, profile_point_t *p_out) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    *p_out = global_profile[id];
+    MUTEX_UNLOCK(mutex);
+}
+
+void profile_reset(profile_id_e id) {
+    MUTEX_DECLARE(mutex);
+    uint8_t i;
+
+    MUTEX_LOCK(mutex);
+    for (i = 0; i < PROFILE_NUM; i++) {
+        if (id == PROFILE_NUM || id == i) {
+            profile_point_clear(&global_profile[i]);
+        }
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+void profile_init(void) {
+    uint32_t cycles_per_us = HAL_RCC_GetHCLKFreq() / 1000000U;
+    uint32_t start, cost;
+    uint8_t i;
+
+    for (i = 0; i < PROFILE_NUM; i++) {
+        global_profile[i].name = profile_config[i].name;
+        global_profile[i].period = profile_config[i].period_us * cycles_per_us;
+        profile_point_clear(&global_profile[i]);
+    }
+
+    //用第一个统计点实测一对begin/end的开销,取最小值排除中断干扰
+    profile_overhead_cycles = 0xFFFFFFFFU;
+    for (i = 0; i < PROFILE_OVERHEAD_TRY_NUM; i++) {
+        start = DWT_get_tick();
+        profile_begin(PROFILE_GIMBAL_TASK);
+        profile_end(PROFILE_GIMBAL_TASK);
+        cost = DWT_get_tick() - start;
+        if (cost < profile_overhead_cycles) {
+            profile_overhead_cycles = cost;
+        }
+    }
+    profile_point_clear(&global_profile[PROFILE_GIMBAL_TASK]);
+}
@@ -0,0 +1,112 @@
+/**
+  * @file       profile.c/h
+  * @brief      per-task and per-ISR timing profiler in raw DWT cycles. Every
+  *             profiling point keeps min/max/mean and a log2 histogram of its
+  *             execution time and of its activation jitter.
+  *             以DWT原始计数统计各任务和中断的执行时间与激活抖动,每个统计点记录
+  *             最小/最大/平均值和以2为底的对数直方图
+  * @note       execution time is measured from profile_begin to profile_end, so
+  *             time spent in preempting tasks and interrupts is included (response
+  *             time). Jitter is |interval - period| between two profile_begin calls,
+  *             with period 0 the raw activation interval is recorded instead.
+  *             Histogram bucket k counts values in [2^k, 2^(k+1)), bucket 0 also
+  *             counts 0. The cost of one begin/end pair is measured at boot by
+  *             profile_init into profile_overhead_cycles and printed with the report.
+  *             执行时间为begin到end的间隔,包含被抢占的时间(即响应时间).抖动为两次
+  *             begin间隔与标称周期之差的绝对值,周期为0时记录原始激活间隔.
+  *             直方图第k格统计[2^k, 2^(k+1)),第0格同时统计0.一对begin/end的开销在
+  *             profile_init中实测,存于profile_overhead_cycles并随报告输出
+  */
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "struct_typedef.h"
+
+#define PROFILE_BUCKET_NUM 32
+
+typedef enum {
+    PROFILE_GIMBAL_TASK = 0,
+    PROFILE_CHASSIS_TASK,
+    PROFILE_INS_TASK,
+    PROFILE_IMU_EXTI_ISR,
+    PROFILE_IMU_SPI_DMA_ISR,
+    PROFILE_CAN_RX_ISR,
+    PROFILE_CHASSIS_PID,        //四个底盘电机速度环, 在chassis_task中
+    PROFILE_NUM,
+} profile_id_e;
+
+typedef struct {
+    uint32_t cnt;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bucket[PROFILE_BUCKET_NUM];
+} profile_hist_t;
+
+typedef struct {
+    const char *name;
+    uint32_t period;            //标称激活周期(DWT计数),0为非周期
+    uint32_t start_tick;
+    uint32_t last_start_tick;
+    uint8_t started;            //已记录过激活时间
+    profile_hist_t exec;        //执行时间
+    profile_hist_t jitter;      //激活抖动,period为0时为激活间隔
+} profile_point_t;
+
+extern profile_point_t global_profile[PROFILE_NUM];
+extern uint32_t profile_overhead_cycles;
+
+/**
+  * @brief          init all profiling points and measure the profiler overhead, call after DWT_init
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          初始化所有统计点并实测统计开销,在DWT_init之后调用
+  * @param[in]      none
+  * @retval         none
+  */
+extern void profile_init(void);
+
+/**
+  * @brief          加入一个样本
+  */
+extern void profile_hist_add(profile_hist_t *p_hist, uint32_t value);
+
+/**
+  * @brief          直方图格号
+  */
+extern uint8_t profile_hist_bucket(uint32_t value);
+
+/**
+  * @brief          平均值
+  */
+extern uint32_t profile_hist_mean(const profile_hist_t *p_hist);
+
+/**
+  * @brief          估计分位数,返回该分位所在格的上界
+  * @param[in]      permille: 千分位,如990为p99
+  */
+extern uint32_t profile_hist_percentile(const profile_hist_t *p_hist, uint16_t permille);
+
+/**
+  * @brief          任务循环或中断开始时调用
+  */
+extern void profile_begin(profile_id_e id);
+
+/**
+  * @brief          任务循环或中断结束时调用
+  */
+extern void profile_end(profile_id_e id);
+
+/**
+  * @brief          复制统计点的一致快照
+  */
+extern void profile_snapshot(profile_id_e id, profile_point_t *p_out);
+
+/**
+  * @brief          清空统计点,PROFILE_NUM清空所有统计点
+  */
+extern void profile_reset(profile_id_e id);
+
+#endif
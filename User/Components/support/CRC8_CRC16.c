@@ -16,6 +16,7 @@
   ****************************(C) COPYRIGHT 2019 DJI****************************
   */
 #include "CRC8_CRC16.h"
+#include <stddef.h>
 
 //crc8 generator polynomial:G(x)=x8+x5+x4+1
 const uint8_t CRC8_INIT = 0xff;
@@ -75,6 +76,36 @@ const uint16_t wCRC_table[256] = {
 
 
 
+#if CRC_SLICE_BY > 1
+//slice-by-N扩展表,CRCx_slice_table[k]对应在数据后再追加k+1个0字节的CRC
+static uint8_t CRC8_slice_table[CRC_SLICE_BY - 1][256];
+static uint16_t wCRC_slice_table[CRC_SLICE_BY - 1][256];
+static volatile uint8_t crc_slice_table_ready = 0;
+
+/**
+  * @brief          由基础表生成slice-by-N扩展表,多任务同时进入时写入的值相同,无需互斥
+  * @param[in]      none
+  * @retval         none
+  */
+static void crc_slice_table_init(void) {
+    uint16_t i;
+    uint8_t k;
+    uint8_t crc8;
+    uint16_t crc16;
+    for (i = 0; i < 256; i++) {
+        crc8 = CRC8_table[i];
+        crc16 = wCRC_table[i];
+        for (k = 0; k < CRC_SLICE_BY - 1; k++) {
+            crc8 = CRC8_table[crc8];
+            crc16 = (crc16 >> 8) ^ wCRC_table[crc16 & 0x00ff];
+            CRC8_slice_table[k][i] = crc8;
+            wCRC_slice_table[k][i] = crc16;
+        }
+    }
+    crc_slice_table_ready = 1;
+}
+#endif
+
 /**
   * @brief          计算CRC8
   * @param[in]      pch_message: 数据
@@ -84,6 +115,25 @@ const uint16_t wCRC_table[256] = {
   */
 uint8_t get_CRC8_check_sum(unsigned char *pch_message, unsigned int dw_length, unsigned char ucCRC8) {
     unsigned char uc_index;
+#if CRC_SLICE_BY > 1
+    if (!crc_slice_table_ready) {
+        crc_slice_table_init();
+    }
+    while (dw_length >= CRC_SLICE_BY) {
+        ucCRC8 ^= pch_message[0];
+#if CRC_SLICE_BY == 8
+        ucCRC8 = CRC8_slice_table[6][ucCRC8] ^ CRC8_slice_table[5][pch_message[1]] ^
+                 CRC8_slice_table[4][pch_message[2]] ^ CRC8_slice_table[3][pch_message[3]] ^
+                 CRC8_slice_table[2][pch_message[4]] ^ CRC8_slice_table[1][pch_message[5]] ^
+                 CRC8_slice_table[0][pch_message[6]] ^ CRC8_table[pch_message[7]];
+#else
+        ucCRC8 = CRC8_slice_table[2][ucCRC8] ^ CRC8_slice_table[1][pch_message[1]] ^
+                 CRC8_slice_table[0][pch_message[2]] ^ CRC8_table[pch_message[3]];
+#endif
+        pch_message += CRC_SLICE_BY;
+        dw_length -= CRC_SLICE_BY;
+    }
+#endif
     while (dw_length--) {
         uc_index = ucCRC8 ^ (*pch_message++);
         ucCRC8 = CRC8_table[uc_index];
@@ -148,6 +198,25 @@ uint16_t get_CRC16_check_sum(uint8_t *pch_message, uint32_t dw_length, uint16_t
     if (pch_message == NULL) {
         return 0xFFFF;
     }
+#if CRC_SLICE_BY > 1
+    if (!crc_slice_table_ready) {
+        crc_slice_table_init();
+    }
+    while (dw_length >= CRC_SLICE_BY) {
+        wCRC ^= (uint16_t) (pch_message[0] | (pch_message[1] << 8));
+#if CRC_SLICE_BY == 8
+        wCRC = wCRC_slice_table[6][wCRC & 0x00ff] ^ wCRC_slice_table[5][wCRC >> 8] ^
+               wCRC_slice_table[4][pch_message[2]] ^ wCRC_slice_table[3][pch_message[3]] ^
+               wCRC_slice_table[2][pch_message[4]] ^ wCRC_slice_table[1][pch_message[5]] ^
+               wCRC_slice_table[0][pch_message[6]] ^ wCRC_table[pch_message[7]];
+#else
+        wCRC = wCRC_slice_table[2][wCRC & 0x00ff] ^ wCRC_slice_table[1][wCRC >> 8] ^
+               wCRC_slice_table[0][pch_message[2]] ^ wCRC_table[pch_message[3]];
+#endif
+        pch_message += CRC_SLICE_BY;
+        dw_length -= CRC_SLICE_BY;
+    }
+#endif
     while (dw_length--) {
         chData = *pch_message++;
         (wCRC) = ((uint16_t) (wCRC) >> 8) ^ wCRC_table[((uint16_t) (wCRC) ^ (uint16_t) (chData)) & 0x00ff];
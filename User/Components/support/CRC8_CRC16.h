@@ -18,7 +18,18 @@
 #ifndef CRC8_CRC16_H
 #define CRC8_CRC16_H
 
-#include "main.h"
+#include "struct_typedef.h"
+
+/* CRC8/CRC16查表方式,编译时选择,结果完全一致:
+ * 1:逐字节查表
+ * 4/8:slice-by-4/8,每次处理4/8字节,扩展表在首次计算时由基础表生成(RAM占用约(N-1)*768字节) */
+#ifndef CRC_SLICE_BY
+#define CRC_SLICE_BY 4
+#endif
+
+#if (CRC_SLICE_BY != 1) && (CRC_SLICE_BY != 4) && (CRC_SLICE_BY != 8)
+#error "CRC_SLICE_BY must be 1, 4 or 8"
+#endif
 
 /**
   * @brief          calculate the crc8  
@@ -0,0 +1,235 @@
+/**
+  * @file       can_tx.c/h
+  * @brief      CAN transmit scheduler with per-ID latest-value slots.
+  *             按ID保存最新值的CAN发送调度器
+  * @note       a slot is in at most one mailbox at a time, a newer value written
+  *             while the old one is still in a mailbox stays pending and follows
+  *             it, so frames of one ID never overtake each other.
+  *             一个槽同一时刻最多占用一个邮箱,旧值仍在邮箱中时写入的新值保持待发送,
+  *             在旧值之后发出,同一ID的帧不会乱序
+  */
+#include "can_tx.h"
+#include "macro_mutex.h"
+#include <string.h>
+#include <stddef.h>
+
+uint32_t can_tx_frame_bits(uint8_t dlc) {
+    //SOF到CRC共34+8*dlc位参与位填充,最坏每4位插入一位;再加CRC界定符,ACK,EOF和帧间隔13位
+    uint32_t stuffed_bits = 34U + 8U * dlc;
+    return stuffed_bits + (stuffed_bits - 1U) / 4U + 13U;
+}
+
+/**
+  * @brief          查找std_id的槽,不存在时创建,在临界区内调用
+  * @retval         槽,槽已满时返回NULL
+  */
+static can_tx_slot_t *can_tx_get_slot(can_tx_port_t *p_port, uint16_t std_id) {
+    can_tx_slot_t *p_slot;
+    uint8_t i;
+    for (i = 0; i < p_port->slot_num; i++) {
+        if (p_port->slot[i].std_id == std_id) {
+            return &p_port->slot[i];
+        }
+    }
+    if (p_port->slot_num >= CAN_TX_SLOT_NUM) {
+        p_port->slot_full_cnt++;
+        return NULL;
+    }
+    p_slot = &p_port->slot[p_port->slot_num++];
+    memset(p_slot, 0, sizeof(can_tx_slot_t));
+    p_slot->std_id = std_id;
+    return p_slot;
+}
+
+static uint8_t can_tx_slot_in_mailbox(const can_tx_port_t *p_port, uint8_t slot) {
+    uint8_t i;
+    for (i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if (p_port->mailbox[i].busy && p_port->mailbox[i].slot == slot) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+  * @brief          取消超时的邮箱,再按等待时间从长到短把待发送的槽写入空闲邮箱,在临界区内调用
+  */
+static void can_tx_fill(can_tx_port_t *p_port) {
+    uint32_t now = p_port->get_tick();
+    can_tx_slot_t *p_slot;
+    int oldest, mailbox;
+    uint8_t i;
+
+    for (i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        //只在该槽已有新值时取消,邮箱中的值就是最新值时取消只会丢失它
+        if (p_port->mailbox[i].busy && p_port->slot[p_port->mailbox[i].slot].pending &&
+            now - p_port->mailbox[i].write_tick > CAN_TX_STALL_US * p_port->tick_per_us) {
+            //取消完成中断中释放邮箱,避免重复取消
+            p_port->mailbox[i].write_tick = now;
+            p_port->abort_cnt++;
+            p_port->abort(i);
+        }
+    }
+
+    while (1) {
+        oldest = -1;
+        for (i = 0; i < p_port->slot_num; i++) {
+            p_slot = &p_port->slot[i];
+            if (p_slot->pending && !can_tx_slot_in_mailbox(p_port, i) &&
+                (p_slot->sent_cnt == 0U || now - p_slot->write_tick >= p_slot->min_interval_tick) &&
+                (oldest < 0 || (int32_t) (p_slot->pending_tick - p_port->slot[oldest].pending_tick) < 0)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return;
+        }
+        p_slot = &p_port->slot[oldest];
+        mailbox = p_port->write(p_slot->std_id, p_slot->data, p_slot->dlc);
+        if (mailbox < 0 || mailbox >= CAN_TX_MAILBOX_NUM) {
+            p_port->mailbox_full_cnt++;
+            return;
+        }
+        p_slot->pending = 0;
+        p_slot->write_tick = now;
+        p_port->mailbox[mailbox].busy = 1;
+        p_port->mailbox[mailbox].slot = (uint8_t) oldest;
+        p_port->mailbox[mailbox].pending_tick = p_slot->pending_tick;
+        p_port->mailbox[mailbox].write_tick = now;
+    }
+}
+
+void can_tx_init(can_tx_port_t *p_port, can_tx_write_f write, can_tx_abort_f abort, can_tx_tick_f get_tick,
+                 uint32_t tick_per_us, uint32_t bitrate) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    memset(p_port, 0, sizeof(can_tx_port_t));
+    p_port->write = write;
+    p_port->abort = abort;
+    p_port->get_tick = get_tick;
+    p_port->tick_per_us = (tick_per_us != 0U) ? tick_per_us : 1U;
+    p_port->bitrate = bitrate;
+    p_port->load_tick_last = get_tick();
+    MUTEX_UNLOCK(mutex);
+}
+
+int can_tx_slot_config(can_tx_port_t *p_port, uint16_t std_id, uint8_t dlc, uint32_t min_interval_us) {
+    MUTEX_DECLARE(mutex);
+    can_tx_slot_t *p_slot;
+
+    if (dlc > 8U) {
+        return -1;
+    }
+    MUTEX_LOCK(mutex);
+    p_slot = can_tx_get_slot(p_port, std_id);
+    if (p_slot != NULL) {
+        p_slot->dlc = dlc;
+        p_slot->min_interval_tick = min_interval_us * p_port->tick_per_us;
+    }
+    MUTEX_UNLOCK(mutex);
+    return (p_slot != NULL) ? 0 : -1;
+}
+
+int can_tx_update(can_tx_port_t *p_port, uint16_t std_id, uint8_t dlc, uint8_t offset,
+                  const uint8_t *p_data, uint8_t len) {
+    MUTEX_DECLARE(mutex);
+    can_tx_slot_t *p_slot;
+    int ret = 0;
+
+    if (p_data == NULL || dlc > 8U || offset + len > dlc) {
+        return -1;
+    }
+    MUTEX_LOCK(mutex);
+    p_slot = can_tx_get_slot(p_port, std_id);
+    if (p_slot != NULL) {
+        if (p_slot->pending) {
+            p_slot->overwrite_cnt++;
+            p_port->overwrite_cnt++;
+        } else {
+            p_slot->pending = 1;
+            p_slot->pending_tick = p_port->get_tick();
+        }
+        p_slot->dlc = dlc;
+        memcpy(&p_slot->data[offset], p_data, len);
+    } else {
+        ret = -1;
+    }
+    MUTEX_UNLOCK(mutex);
+    return ret;
+}
+
+void can_tx_flush(can_tx_port_t *p_port) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    can_tx_fill(p_port);
+    MUTEX_UNLOCK(mutex);
+}
+
+void can_tx_complete_irq(can_tx_port_t *p_port, uint8_t mailbox) {
+    MUTEX_DECLARE(mutex);
+    can_tx_mailbox_t *p_mailbox;
+    can_tx_slot_t *p_slot;
+
+    if (mailbox >= CAN_TX_MAILBOX_NUM) {
+        return;
+    }
+    MUTEX_LOCK(mutex);
+    p_mailbox = &p_port->mailbox[mailbox];
+    if (p_mailbox->busy) {
+        p_slot = &p_port->slot[p_mailbox->slot];
+        p_slot->sent_cnt++;
+        p_port->sent_cnt++;
+        p_port->bus_bits += can_tx_frame_bits(p_slot->dlc);
+        p_port->latency_us_last = (p_port->get_tick() - p_mailbox->pending_tick) / p_port->tick_per_us;
+        if (p_port->latency_us_last > p_port->latency_us_max) {
+            p_port->latency_us_max = p_port->latency_us_last;
+        }
+        p_mailbox->busy = 0;
+    }
+    can_tx_fill(p_port);
+    MUTEX_UNLOCK(mutex);
+}
+
+void can_tx_fail_irq(can_tx_port_t *p_port, uint8_t mailbox) {
+    MUTEX_DECLARE(mutex);
+
+    if (mailbox >= CAN_TX_MAILBOX_NUM) {
+        return;
+    }
+    MUTEX_LOCK(mutex);
+    if (p_port->mailbox[mailbox].busy) {
+        p_port->fail_cnt++;
+        p_port->mailbox[mailbox].busy = 0;
+    }
+    can_tx_fill(p_port);
+    MUTEX_UNLOCK(mutex);
+}
+
+void can_tx_rx_account(can_tx_port_t *p_port, uint8_t dlc) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    p_port->bus_bits += can_tx_frame_bits(dlc);
+    MUTEX_UNLOCK(mutex);
+}
+
+uint16_t can_tx_load_permille(can_tx_port_t *p_port) {
+    MUTEX_DECLARE(mutex);
+    uint32_t now, bits, us;
+
+    MUTEX_LOCK(mutex);
+    now = p_port->get_tick();
+    bits = p_port->bus_bits - p_port->load_bits_last;
+    us = (now - p_port->load_tick_last) / p_port->tick_per_us;
+    p_port->load_bits_last = p_port->bus_bits;
+    p_port->load_tick_last = now;
+    MUTEX_UNLOCK(mutex);
+
+    if (us == 0U || p_port->bitrate == 0U) {
+        return 0;
+    }
+    //bits / (bitrate * us / 1e6) * 1000
+    return (uint16_t) ((uint64_t) bits * 1000000000ULL / ((uint64_t) p_port->bitrate * us));
+}
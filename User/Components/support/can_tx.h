@@ -0,0 +1,192 @@
+/**
+  * @file       can_tx.c/h
+  * @brief      CAN transmit scheduler. Every standard ID owns one slot holding the
+  *             latest frame, a newer command overwrites the unsent one, so several
+  *             updates (from one or several tasks) leave as a single frame. Slots
+  *             are moved into the three bxCAN mailboxes when a mailbox is free, the
+  *             mailbox empty interrupt refills them, nothing is dropped when the
+  *             mailboxes are busy.
+  *             CAN发送调度器:每个标准ID占用一个槽,槽中只保存最新的一帧,未发出的旧命令
+  *             被新命令覆盖,同一周期内(来自一个或多个任务)的多次更新只发出一帧.有空闲
+  *             邮箱时把槽中的帧写入bxCAN的三个发送邮箱,邮箱空中断继续补充,邮箱忙时
+  *             不再丢帧
+  * @note       slot operations are guarded by short PRIMASK critical sections and
+  *             can be called from tasks and interrupts. The oldest pending slot is
+  *             sent first. A failed frame (no ACK with automatic retransmission
+  *             off) is not retried, the next update of its slot replaces it. A
+  *             mailbox that is not done within CAN_TX_STALL_US while its slot
+  *             already holds a newer value is aborted so the newest values go out
+  *             instead of stale ones.
+  *             槽操作由短暂的PRIMASK临界区保护,任务和中断中均可调用.等待最久的槽先发送.
+  *             发送失败的帧(关闭自动重传时无应答)不重发,由该槽的下一次更新代替.邮箱超过
+  *             CAN_TX_STALL_US仍未完成且该槽已有新值时取消发送,发出的总是最新的值而不是过时的值
+  */
+#ifndef CAN_TX_H
+#define CAN_TX_H
+
+#include "struct_typedef.h"
+
+#define CAN_TX_SLOT_NUM         8
+#define CAN_TX_MAILBOX_NUM      3
+#define CAN_TX_STALL_US         5000U
+
+/**
+  * @brief          写入一个空闲发送邮箱,在临界区内调用
+  * @retval         邮箱号0~2, -1:没有空闲邮箱
+  */
+typedef int (*can_tx_write_f)(uint16_t std_id, const uint8_t *p_data, uint8_t dlc);
+
+/**
+  * @brief          取消一个邮箱的发送,在临界区内调用
+  */
+typedef void (*can_tx_abort_f)(uint8_t mailbox);
+
+/**
+  * @brief          自由运行的计数时间源,如DWT
+  */
+typedef uint32_t (*can_tx_tick_f)(void);
+
+typedef struct {
+    uint16_t std_id;
+    uint8_t dlc;
+    uint8_t pending;                //有未写入邮箱的新值
+    uint8_t data[8];
+    uint32_t pending_tick;          //第一次未发送的更新时刻
+    uint32_t min_interval_tick;     //两次写入邮箱的最小间隔,0不限制
+    uint32_t write_tick;            //上次写入邮箱的时刻
+    uint32_t sent_cnt;
+    uint32_t overwrite_cnt;         //未发出就被新值覆盖的次数
+} can_tx_slot_t;
+
+typedef struct {
+    uint8_t busy;
+    uint8_t slot;
+    uint32_t pending_tick;          //邮箱中的帧对应的更新时刻
+    uint32_t write_tick;            //写入邮箱的时刻
+} can_tx_mailbox_t;
+
+typedef struct {
+    can_tx_write_f write;
+    can_tx_abort_f abort;
+    can_tx_tick_f get_tick;
+    uint32_t tick_per_us;
+    uint32_t bitrate;
+    can_tx_slot_t slot[CAN_TX_SLOT_NUM];
+    uint8_t slot_num;
+    can_tx_mailbox_t mailbox[CAN_TX_MAILBOX_NUM];
+    //统计(调试时使用)
+    uint32_t sent_cnt;              //已发出帧数
+    uint32_t overwrite_cnt;         //被覆盖的旧命令数
+    uint32_t mailbox_full_cnt;      //有待发送的槽但邮箱全忙的次数
+    uint32_t abort_cnt;             //超时取消的邮箱数
+    uint32_t fail_cnt;              //发送失败的帧数(无应答,仲裁失败,被取消)
+    uint32_t slot_full_cnt;         //ID槽不足导致的丢帧
+    uint32_t bus_bits;              //总线上累计的位数(发送+接收)
+    uint32_t latency_us_max;        //更新到发出的最大延迟
+    uint32_t latency_us_last;
+    //负载统计窗口
+    uint32_t load_bits_last;
+    uint32_t load_tick_last;
+} can_tx_port_t;
+
+/**
+  * @brief          init a port
+  * @param[out]     p_port: port
+  * @param[in]      write: writes one frame into a free mailbox
+  * @param[in]      abort: aborts one mailbox
+  * @param[in]      get_tick: free running tick source
+  * @param[in]      tick_per_us: ticks per microsecond
+  * @param[in]      bitrate: bus bitrate, bit/s
+  * @retval         none
+  */
+/**
+  * @brief          初始化端口
+  * @param[out]     p_port: 端口
+  * @param[in]      write: 把一帧写入空闲邮箱
+  * @param[in]      abort: 取消一个邮箱的发送
+  * @param[in]      get_tick: 自由运行的计数时间源
+  * @param[in]      tick_per_us: 每微秒的计数
+  * @param[in]      bitrate: 总线波特率,bit/s
+  * @retval         none
+  */
+extern void can_tx_init(can_tx_port_t *p_port, can_tx_write_f write, can_tx_abort_f abort, can_tx_tick_f get_tick,
+                        uint32_t tick_per_us, uint32_t bitrate);
+
+/**
+  * @brief          create the slot of std_id and limit its rate, updates arriving within
+  *                 min_interval_us of the last frame are merged into the next one
+  * @param[in]      p_port: port
+  * @param[in]      std_id: standard ID
+  * @param[in]      dlc: frame length
+  * @param[in]      min_interval_us: minimum interval between two frames, 0 no limit
+  * @retval         0: ok, -1: no free slot
+  */
+/**
+  * @brief          创建std_id的槽并限制其发送频率,距上一帧不足min_interval_us的更新合并到下一帧.
+  *                 被限制的帧在下一次can_tx_flush或邮箱中断时发出
+  * @param[in]      p_port: 端口
+  * @param[in]      std_id: 标准ID
+  * @param[in]      dlc: 帧长度
+  * @param[in]      min_interval_us: 两帧的最小间隔,0不限制
+  * @retval         0:成功, -1:槽已满
+  */
+extern int can_tx_slot_config(can_tx_port_t *p_port, uint16_t std_id, uint8_t dlc, uint32_t min_interval_us);
+
+/**
+  * @brief          update part of the frame of std_id, the slot is created on first use
+  * @param[in]      p_port: port
+  * @param[in]      std_id: standard ID
+  * @param[in]      dlc: frame length
+  * @param[in]      offset: first byte to update
+  * @param[in]      p_data: new bytes
+  * @param[in]      len: number of bytes, offset + len <= dlc
+  * @retval         0: ok, -1: no free slot or bad length
+  */
+/**
+  * @brief          更新std_id帧中的部分字节,第一次使用时创建槽.只更新不发送,
+  *                 多个任务各自更新同一帧的不同字节后由can_tx_flush合并为一帧发出
+  * @param[in]      p_port: 端口
+  * @param[in]      std_id: 标准ID
+  * @param[in]      dlc: 帧长度
+  * @param[in]      offset: 更新的起始字节
+  * @param[in]      p_data: 新数据
+  * @param[in]      len: 字节数, offset + len <= dlc
+  * @retval         0:成功, -1:槽已满或长度错误
+  */
+extern int can_tx_update(can_tx_port_t *p_port, uint16_t std_id, uint8_t dlc, uint8_t offset,
+                         const uint8_t *p_data, uint8_t len);
+
+/**
+  * @brief          把待发送的槽写入空闲邮箱,并取消超时的邮箱
+  */
+extern void can_tx_flush(can_tx_port_t *p_port);
+
+/**
+  * @brief          邮箱发送完成中断中调用,统计后继续补充邮箱
+  * @param[in]      mailbox: 邮箱号0~2
+  */
+extern void can_tx_complete_irq(can_tx_port_t *p_port, uint8_t mailbox);
+
+/**
+  * @brief          邮箱发送失败(无应答,仲裁失败,被取消)时在中断中调用,该帧不重发
+  * @param[in]      mailbox: 邮箱号0~2
+  */
+extern void can_tx_fail_irq(can_tx_port_t *p_port, uint8_t mailbox);
+
+/**
+  * @brief          接收中断中调用,把接收帧计入总线负载
+  */
+extern void can_tx_rx_account(can_tx_port_t *p_port, uint8_t dlc);
+
+/**
+  * @brief          一帧标准数据帧在总线上的位数,按最坏情况的填充位计算
+  */
+extern uint32_t can_tx_frame_bits(uint8_t dlc);
+
+/**
+  * @brief          距上次调用以来的总线负载
+  * @retval         负载,千分比
+  */
+extern uint16_t can_tx_load_permille(can_tx_port_t *p_port);
+
+#endif
@@ -0,0 +1,296 @@
+/**
+  * @file       flash_kv.c/h
+  * @brief      log structured key/value store on two flash sectors.
+  *             两个flash扇区上的日志结构键值存储
+  */
+#include "flash_kv.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+#define FLASH_KV_SECTOR_MAGIC   0x4B565331U     //"KVS1"
+#define FLASH_KV_RECORD_MAGIC   0xCA1BU
+#define FLASH_KV_HEADER_SIZE    16U             //扇区头 magic, seq, ~seq, 保留
+#define FLASH_KV_ERASED         0xFFFFFFFFU
+#define FLASH_KV_CHUNK          8U              //分块读写,不占用大块栈空间
+#define FLASH_KV_CRC_INIT       0xFFFFU
+
+#define FLASH_KV_RECORD_SIZE(len)   (((uint32_t) (len) + 3U) * 4U)
+
+static uint32_t flash_kv_record_head(uint8_t key, uint8_t len) {
+    return (FLASH_KV_RECORD_MAGIC << 16) | ((uint32_t) key << 8) | len;
+}
+
+/**
+  * @brief          从address开始读len个字并累计CRC16
+  */
+static uint16_t flash_kv_crc(const flash_kv_t *p_kv, uint32_t address, uint32_t len, uint16_t crc) {
+    uint32_t chunk[FLASH_KV_CHUNK];
+    uint32_t n;
+
+    while (len > 0U) {
+        n = (len > FLASH_KV_CHUNK) ? FLASH_KV_CHUNK : len;
+        p_kv->p_ops->read(address, chunk, n);
+        crc = get_CRC16_check_sum((uint8_t *) chunk, n * 4U, crc);
+        address += n * 4U;
+        len -= n;
+    }
+    return crc;
+}
+
+/**
+  * @brief          检查address处的记录, 0:完整, -1:crc错误
+  */
+static int flash_kv_record_check(const flash_kv_t *p_kv, uint32_t address, uint8_t len) {
+    uint32_t crc_word;
+    uint16_t crc = flash_kv_crc(p_kv, address, (uint32_t) len + 2U, FLASH_KV_CRC_INIT);
+
+    p_kv->p_ops->read(address + ((uint32_t) len + 2U) * 4U, &crc_word, 1);
+    return (crc_word == (uint32_t) crc) ? 0 : -1;
+}
+
+static bool_t flash_kv_sector_blank(const flash_kv_t *p_kv, uint32_t address) {
+    uint32_t chunk[FLASH_KV_CHUNK];
+    uint32_t offset, i;
+
+    for (offset = 0; offset < p_kv->sector_size; offset += sizeof(chunk)) {
+        p_kv->p_ops->read(address + offset, chunk, FLASH_KV_CHUNK);
+        for (i = 0; i < FLASH_KV_CHUNK; i++) {
+            if (chunk[i] != FLASH_KV_ERASED) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief          读扇区头, 0:有效, -1:无效
+  */
+static int flash_kv_sector_seq(const flash_kv_t *p_kv, uint8_t sector, uint32_t *p_seq) {
+    uint32_t head[3];
+
+    p_kv->p_ops->read(p_kv->sector_addr[sector], head, 3);
+    if (head[0] != FLASH_KV_SECTOR_MAGIC || head[1] != ~head[2]) {
+        return -1;
+    }
+    *p_seq = head[1];
+    return 0;
+}
+
+static int flash_kv_program(flash_kv_t *p_kv, uint32_t address, const uint32_t *buf, uint32_t len) {
+    p_kv->program_words += len;
+    return (p_kv->p_ops->program(address, buf, len) == 0) ? 0 : -1;
+}
+
+static int flash_kv_sector_format(flash_kv_t *p_kv, uint8_t sector, uint32_t seq) {
+    uint32_t head[3] = {FLASH_KV_SECTOR_MAGIC, seq, ~seq};
+
+    return flash_kv_program(p_kv, p_kv->sector_addr[sector], head, 3);
+}
+
+/**
+  * @brief          追加一条记录,crc字最后写入作为提交
+  */
+static int flash_kv_record_append(flash_kv_t *p_kv, uint32_t address, uint8_t key, uint32_t version,
+                                  const uint32_t *buf, uint8_t len) {
+    uint32_t head[2];
+    uint32_t crc_word;
+    uint16_t crc;
+
+    head[0] = flash_kv_record_head(key, len);
+    head[1] = version;
+    crc = get_CRC16_check_sum((uint8_t *) head, sizeof(head), FLASH_KV_CRC_INIT);
+    crc = get_CRC16_check_sum((uint8_t *) buf, (uint32_t) len * 4U, crc);
+    crc_word = crc;
+    if (flash_kv_program(p_kv, address, head, 2) != 0 ||
+        flash_kv_program(p_kv, address + 8U, buf, len) != 0 ||
+        flash_kv_program(p_kv, address + 8U + (uint32_t) len * 4U, &crc_word, 1) != 0) {
+        return -1;
+    }
+    return flash_kv_record_check(p_kv, address, len);
+}
+
+/**
+  * @brief          把src处的整条记录原样复制到dst
+  */
+static int flash_kv_record_copy(flash_kv_t *p_kv, uint32_t dst, uint32_t src, uint8_t len) {
+    uint32_t chunk[FLASH_KV_CHUNK];
+    uint32_t words = (uint32_t) len + 3U;
+    uint32_t n;
+
+    while (words > 0U) {
+        n = (words > FLASH_KV_CHUNK) ? FLASH_KV_CHUNK : words;
+        p_kv->p_ops->read(src, chunk, n);
+        if (flash_kv_program(p_kv, dst, chunk, n) != 0) {
+            return -1;
+        }
+        src += n * 4U;
+        dst += n * 4U;
+        words -= n;
+    }
+    return 0;
+}
+
+/**
+  * @brief          扫描当前扇区,建立各键最新记录的索引和写入位置
+  */
+static void flash_kv_scan(flash_kv_t *p_kv) {
+    uint32_t base = p_kv->sector_addr[p_kv->active];
+    uint32_t offset = FLASH_KV_HEADER_SIZE;
+    uint32_t head[2];
+    uint8_t key, len;
+
+    memset(p_kv->record_offset, 0, sizeof(p_kv->record_offset));
+    memset(p_kv->record_version, 0, sizeof(p_kv->record_version));
+    memset(p_kv->record_len, 0, sizeof(p_kv->record_len));
+    while (offset + FLASH_KV_RECORD_SIZE(0) <= p_kv->sector_size) {
+        p_kv->p_ops->read(base + offset, head, 2);
+        if (head[0] == FLASH_KV_ERASED) {
+            break;
+        }
+        key = (uint8_t) (head[0] >> 8);
+        len = (uint8_t) head[0];
+        if ((head[0] >> 16) != FLASH_KV_RECORD_MAGIC || len == 0U || len > FLASH_KV_MAX_LEN ||
+            offset + FLASH_KV_RECORD_SIZE(len) > p_kv->sector_size) {
+            //记录头本身损坏,无法确定后面的位置,下次写入时整理
+            p_kv->corrupt_cnt++;
+            offset = p_kv->sector_size;
+            break;
+        }
+        if (key < FLASH_KV_KEY_NUM && flash_kv_record_check(p_kv, base + offset, len) == 0) {
+            if (p_kv->record_offset[key] == 0U || (int32_t) (head[1] - p_kv->record_version[key]) > 0) {
+                p_kv->record_offset[key] = offset;
+                p_kv->record_version[key] = head[1];
+                p_kv->record_len[key] = len;
+            }
+            if ((int32_t) (head[1] - p_kv->version) > 0) {
+                p_kv->version = head[1];
+            }
+        } else {
+            p_kv->corrupt_cnt++;
+        }
+        offset += FLASH_KV_RECORD_SIZE(len);
+    }
+    p_kv->write_offset = offset;
+}
+
+/**
+  * @brief          把各键的最新记录和新记录写入另一个扇区,最后写扇区头并切换
+  */
+static int flash_kv_collect(flash_kv_t *p_kv, uint8_t key, const uint32_t *buf, uint8_t len) {
+    uint8_t spare = (uint8_t) (p_kv->active ^ 1U);
+    uint32_t base = p_kv->sector_addr[spare];
+    uint32_t offset = FLASH_KV_HEADER_SIZE;
+    uint8_t i;
+
+    if (!flash_kv_sector_blank(p_kv, base)) {
+        p_kv->erase_cnt++;
+        if (p_kv->p_ops->erase(base) != 0) {
+            return -1;
+        }
+    }
+    for (i = 0; i < FLASH_KV_KEY_NUM; i++) {
+        if (i == key || p_kv->record_offset[i] == 0U) {
+            continue;
+        }
+        if (offset + FLASH_KV_RECORD_SIZE(p_kv->record_len[i]) > p_kv->sector_size ||
+            flash_kv_record_copy(p_kv, base + offset, p_kv->sector_addr[p_kv->active] + p_kv->record_offset[i],
+                                 p_kv->record_len[i]) != 0) {
+            return -1;
+        }
+        offset += FLASH_KV_RECORD_SIZE(p_kv->record_len[i]);
+    }
+    if (offset + FLASH_KV_RECORD_SIZE(len) > p_kv->sector_size ||
+        flash_kv_record_append(p_kv, base + offset, key, p_kv->version + 1U, buf, len) != 0) {
+        return -1;
+    }
+    //扇区头写入后新扇区才生效,之前掉电旧扇区仍然完整
+    if (flash_kv_sector_format(p_kv, spare, p_kv->seq + 1U) != 0) {
+        return -1;
+    }
+    p_kv->active = spare;
+    p_kv->seq++;
+    p_kv->gc_cnt++;
+    flash_kv_scan(p_kv);
+    return 0;
+}
+
+int flash_kv_mount(flash_kv_t *p_kv, const flash_kv_ops_t *p_ops, uint32_t addr_a, uint32_t addr_b,
+                   uint32_t sector_size) {
+    uint32_t seq[2];
+    int valid[2];
+
+    memset(p_kv, 0, sizeof(flash_kv_t));
+    p_kv->p_ops = p_ops;
+    p_kv->sector_addr[0] = addr_a;
+    p_kv->sector_addr[1] = addr_b;
+    p_kv->sector_size = sector_size;
+
+    valid[0] = (flash_kv_sector_seq(p_kv, 0, &seq[0]) == 0);
+    valid[1] = (flash_kv_sector_seq(p_kv, 1, &seq[1]) == 0);
+    if (valid[0] && valid[1]) {
+        p_kv->active = ((int32_t) (seq[1] - seq[0]) > 0) ? 1U : 0U;
+    } else if (valid[0] || valid[1]) {
+        p_kv->active = valid[1] ? 1U : 0U;
+    } else {
+        //首次使用
+        if (!flash_kv_sector_blank(p_kv, addr_a)) {
+            p_kv->erase_cnt++;
+            if (p_ops->erase(addr_a) != 0) {
+                return -1;
+            }
+        }
+        seq[0] = 1U;
+        if (flash_kv_sector_format(p_kv, 0, seq[0]) != 0) {
+            return -1;
+        }
+        p_kv->active = 0U;
+    }
+    p_kv->seq = seq[p_kv->active];
+    flash_kv_scan(p_kv);
+    return 0;
+}
+
+int flash_kv_read(const flash_kv_t *p_kv, uint8_t key, uint32_t *buf, uint8_t len) {
+    if (key >= FLASH_KV_KEY_NUM || p_kv->record_offset[key] == 0U || p_kv->record_len[key] != len) {
+        return -1;
+    }
+    p_kv->p_ops->read(p_kv->sector_addr[p_kv->active] + p_kv->record_offset[key] + 8U, buf, len);
+    return 0;
+}
+
+int flash_kv_write(flash_kv_t *p_kv, uint8_t key, const uint32_t *buf, uint8_t len) {
+    uint32_t address;
+    int ret;
+
+    if (key >= FLASH_KV_KEY_NUM || len == 0U || len > FLASH_KV_MAX_LEN) {
+        return -1;
+    }
+    p_kv->user_words += len;
+    if (p_kv->write_offset + FLASH_KV_RECORD_SIZE(len) > p_kv->sector_size) {
+        return flash_kv_collect(p_kv, key, buf, len);
+    }
+    address = p_kv->sector_addr[p_kv->active] + p_kv->write_offset;
+    ret = flash_kv_record_append(p_kv, address, key, p_kv->version + 1U, buf, len);
+    //写失败的区域已不是擦除状态,同样跳过
+    p_kv->write_offset += FLASH_KV_RECORD_SIZE(len);
+    if (ret != 0) {
+        return -1;
+    }
+    p_kv->version++;
+    p_kv->record_offset[key] = (uint32_t) (address - p_kv->sector_addr[p_kv->active]);
+    p_kv->record_version[key] = p_kv->version;
+    p_kv->record_len[key] = len;
+    return 0;
+}
+
+bool_t flash_kv_is_empty(const flash_kv_t *p_kv) {
+    uint8_t i;
+
+    for (i = 0; i < FLASH_KV_KEY_NUM; i++) {
+        if (p_kv->record_offset[i] != 0U) {
+            return 0;
+        }
+    }
+    return 1;
+}
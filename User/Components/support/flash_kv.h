@@ -0,0 +1,119 @@
+/**
+  * @file       flash_kv.c/h
+  * @brief      log structured key/value store on two flash sectors. Every write
+  *             appends a versioned, CRC protected record to the active sector, a
+  *             sector is erased only when the active one is full, then the latest
+  *             record of every key is copied into the other sector.
+  *             两个flash扇区上的日志结构键值存储.每次写入在当前扇区末尾追加一条带版本号
+  *             和CRC的记录,只有当前扇区写满时才擦除另一个扇区,并把每个键的最新记录复制
+  *             过去
+  * @note       record: [0xCA1B | key | len] [version] [data * len] [crc16 | 0x0000]
+  *             the crc word is programmed last and commits the record, a record torn
+  *             by a power cut has a wrong crc and is skipped. The sector header
+  *             [magic] [seq] [~seq] of the new sector is programmed after all copied
+  *             records, so until it exists the old sector stays the valid one. On
+  *             mount the valid sector with the higher seq is active and the record
+  *             with the highest version of each key wins.
+  *             The flash is accessed through flash_kv_ops_t only, so the store runs
+  *             the same on a host with a simulated flash.
+  *             记录格式见上,crc字最后写入,作为记录的提交,掉电中断的记录crc错误被跳过.
+  *             新扇区的扇区头在所有复制的记录之后写入,写入前旧扇区一直有效.挂载时seq较大
+  *             的有效扇区为当前扇区,每个键取版本号最大的记录.
+  *             只通过flash_kv_ops_t访问flash,可在主机上用模拟flash运行
+  */
+#ifndef FLASH_KV_H
+#define FLASH_KV_H
+
+#include "struct_typedef.h"
+
+#define FLASH_KV_KEY_NUM        8       //键的数量,键为0~FLASH_KV_KEY_NUM-1
+#define FLASH_KV_MAX_LEN        64      //一条记录的最大数据长度,单位字
+
+typedef struct {
+    int8_t (*erase)(uint32_t address);                                  //擦除address开始的扇区
+    int8_t (*program)(uint32_t address, const uint32_t *buf, uint32_t len);  //按字写入, 0:成功
+    void (*read)(uint32_t address, uint32_t *buf, uint32_t len);        //按字读取
+} flash_kv_ops_t;
+
+typedef struct {
+    const flash_kv_ops_t *p_ops;
+    uint32_t sector_addr[2];
+    uint32_t sector_size;                           //单个扇区字节数
+    uint8_t active;                                 //当前扇区 0/1
+    uint32_t seq;                                   //当前扇区序号
+    uint32_t write_offset;                          //下一条记录在当前扇区内的偏移
+    uint32_t version;                               //已使用的最大版本号
+    uint32_t record_offset[FLASH_KV_KEY_NUM];       //各键最新记录的偏移, 0为无记录
+    uint32_t record_version[FLASH_KV_KEY_NUM];
+    uint8_t record_len[FLASH_KV_KEY_NUM];
+    //统计
+    uint32_t user_words;                            //调用者写入的数据字数
+    uint32_t program_words;                         //实际写入flash的字数,含记录头和搬移
+    uint32_t erase_cnt;
+    uint32_t gc_cnt;
+    uint32_t corrupt_cnt;                           //挂载时跳过的损坏记录数
+} flash_kv_t;
+
+/**
+  * @brief          mount the store, formats the first sector when no sector is valid
+  * @param[out]     p_kv: store
+  * @param[in]      p_ops: flash access functions
+  * @param[in]      addr_a: first sector address
+  * @param[in]      addr_b: second sector address
+  * @param[in]      sector_size: bytes of one sector, both sectors the same
+  * @retval         0: ok, -1: flash error
+  */
+/**
+  * @brief          挂载存储,没有有效扇区时格式化第一个扇区
+  * @param[out]     p_kv: 存储
+  * @param[in]      p_ops: flash访问函数
+  * @param[in]      addr_a: 第一个扇区地址
+  * @param[in]      addr_b: 第二个扇区地址
+  * @param[in]      sector_size: 单个扇区字节数,两个扇区相同
+  * @retval         0:成功, -1:flash错误
+  */
+extern int flash_kv_mount(flash_kv_t *p_kv, const flash_kv_ops_t *p_ops, uint32_t addr_a, uint32_t addr_b,
+                          uint32_t sector_size);
+
+/**
+  * @brief          read the latest value of key
+  * @param[in]      p_kv: store
+  * @param[in]      key: key
+  * @param[out]     buf: value
+  * @param[in]      len: value length in words, must equal the stored length
+  * @retval         0: ok, -1: no record or another length
+  */
+/**
+  * @brief          读取键的最新值
+  * @param[in]      p_kv: 存储
+  * @param[in]      key: 键
+  * @param[out]     buf: 值
+  * @param[in]      len: 值的长度,单位字,必须与存储的长度相同
+  * @retval         0:成功, -1:无记录或长度不同
+  */
+extern int flash_kv_read(const flash_kv_t *p_kv, uint8_t key, uint32_t *buf, uint8_t len);
+
+/**
+  * @brief          append a new value of key, erases a sector only when full
+  * @param[in]      p_kv: store
+  * @param[in]      key: key
+  * @param[in]      buf: value
+  * @param[in]      len: value length in words, 1 ~ FLASH_KV_MAX_LEN
+  * @retval         0: ok, -1: flash error or bad argument
+  */
+/**
+  * @brief          追加键的新值,只在扇区写满时擦除
+  * @param[in]      p_kv: 存储
+  * @param[in]      key: 键
+  * @param[in]      buf: 值
+  * @param[in]      len: 值的长度,单位字, 1 ~ FLASH_KV_MAX_LEN
+  * @retval         0:成功, -1:flash错误或参数错误
+  */
+extern int flash_kv_write(flash_kv_t *p_kv, uint8_t key, const uint32_t *buf, uint8_t len);
+
+/**
+  * @brief          是否有任意键的记录
+  */
+extern bool_t flash_kv_is_empty(const flash_kv_t *p_kv);
+
+#endif
@@ -0,0 +1,248 @@
+/**
+  * @file       flight_recorder.c/h
+  * @brief      flight recorder, two banks in the no-init CCM RAM.
+  *             CCM RAM中不初始化的两个记录区的飞行记录仪
+  */
+#include "flight_recorder.h"
+#include "main.h"
+#include "macro_mutex.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+#define FLIGHT_RECORDER_MASK        (FLIGHT_RECORDER_RECORD_NUM - 1U)
+#define FLIGHT_RECORDER_CRC_INIT    0xFFFFU
+
+#if (FLIGHT_RECORDER_RECORD_NUM & FLIGHT_RECORDER_MASK) != 0
+#error "FLIGHT_RECORDER_RECORD_NUM must be a power of two"
+#endif
+
+typedef enum {
+    FLIGHT_RECORDER_STOP = 0,
+    FLIGHT_RECORDER_RUNNING,
+} flight_recorder_state_e;
+
+typedef enum {
+    FLIGHT_DUMP_HEAD = 0,
+    FLIGHT_DUMP_RECORD,
+    FLIGHT_DUMP_TAIL,
+} flight_dump_stage_e;
+
+//记录区头部,复位后保留,链接脚本中的.ram_noinit段不从flash加载也不清零
+typedef struct {
+    uint32_t magic;
+    uint32_t check;                         //头部其余字段的校验
+    uint32_t boot_cnt;
+    uint32_t reset_flags;
+    uint32_t end_reset_flags;               //结束该次运行的复位标志,冻结时写入
+    uint32_t tick_hz;
+    uint32_t frozen;                        //1:保存上一次运行的记录,等待输出
+    volatile uint32_t head;                 //写入的记录总数,位置为head & MASK
+} flight_recorder_bank_t;
+
+static flight_recorder_bank_t flight_recorder_bank[FLIGHT_RECORDER_BANK_NUM] __attribute__((section(".ram_noinit")));
+//记录放在CCM RAM的.ccm_noinit段,每个记录区32KB
+static flight_record_t flight_recorder_record[FLIGHT_RECORDER_BANK_NUM][FLIGHT_RECORDER_RECORD_NUM]
+        __attribute__((section(".ccm_noinit")));
+
+static volatile uint8_t flight_recorder_state = FLIGHT_RECORDER_STOP;
+static flight_recorder_bank_t *flight_recorder_live;        //本次运行写入的记录区
+static flight_record_t *flight_recorder_live_record;
+static volatile int8_t flight_recorder_frozen = -1;         //冻结的记录区,没有时为-1
+
+static struct {
+    uint8_t stage;
+    uint32_t start;                         //最早一条记录的序号
+    uint32_t index;                         //已输出的记录数
+    uint16_t crc;
+    flight_recorder_dump_head_t head;
+    uint8_t tail[4];
+} flight_recorder_dump_state;
+
+static uint32_t flight_recorder_check(const flight_recorder_bank_t *p_bank) {
+    return ~(p_bank->magic ^ p_bank->boot_cnt ^ p_bank->reset_flags ^ p_bank->end_reset_flags ^
+             p_bank->tick_hz ^ p_bank->frozen);
+}
+
+static bool_t flight_recorder_bank_valid(const flight_recorder_bank_t *p_bank) {
+    return p_bank->magic == FLIGHT_RECORDER_MAGIC && p_bank->check == flight_recorder_check(p_bank);
+}
+
+//先清除magic再改写头部,改写中途复位时记录区无效
+static void flight_recorder_bank_seal(flight_recorder_bank_t *p_bank) {
+    p_bank->magic = FLIGHT_RECORDER_MAGIC;
+    p_bank->check = flight_recorder_check(p_bank);
+}
+
+void flight_recorder_init(uint32_t reset_flags, uint32_t tick_hz) {
+    flight_recorder_bank_t *p_bank;
+    int8_t frozen = -1, newest = -1;
+    uint32_t boot_cnt = 0U;
+    uint8_t i, live;
+
+    flight_recorder_state = FLIGHT_RECORDER_STOP;
+    for (i = 0; i < FLIGHT_RECORDER_BANK_NUM; i++) {
+        p_bank = &flight_recorder_bank[i];
+        if (!flight_recorder_bank_valid(p_bank)) {
+            continue;
+        }
+        if (newest < 0 || (int32_t) (p_bank->boot_cnt - flight_recorder_bank[newest].boot_cnt) > 0) {
+            newest = (int8_t) i;
+        }
+        if (p_bank->frozen) {
+            frozen = (int8_t) i;
+        }
+    }
+    if (newest >= 0) {
+        boot_cnt = flight_recorder_bank[newest].boot_cnt + 1U;
+    }
+    //已冻结且未输出的记录保留到输出完成或清除,期间的运行被覆盖;否则冻结上一次运行的记录
+    if (frozen < 0 && newest >= 0 && flight_recorder_bank[newest].head != 0U) {
+        frozen = newest;
+        p_bank = &flight_recorder_bank[frozen];
+        p_bank->magic = 0U;
+        p_bank->end_reset_flags = reset_flags;
+        p_bank->frozen = 1U;
+        flight_recorder_bank_seal(p_bank);
+    }
+    memset(&flight_recorder_dump_state, 0, sizeof(flight_recorder_dump_state));
+    flight_recorder_frozen = frozen;
+
+    //本次运行写入另一个记录区,从启动开始记录
+    live = (frozen == 0) ? 1U : 0U;
+    p_bank = &flight_recorder_bank[live];
+    p_bank->magic = 0U;
+    p_bank->boot_cnt = boot_cnt;
+    p_bank->reset_flags = reset_flags;
+    p_bank->end_reset_flags = 0U;
+    p_bank->tick_hz = tick_hz;
+    p_bank->frozen = 0U;
+    p_bank->head = 0U;
+    flight_recorder_bank_seal(p_bank);
+    flight_recorder_live = p_bank;
+    flight_recorder_live_record = flight_recorder_record[live];
+    flight_recorder_state = FLIGHT_RECORDER_RUNNING;
+    flight_recorder_log(FLIGHT_RECORD_BOOT, 0, 0, reset_flags, boot_cnt);
+}
+
+void flight_recorder_clear(void) {
+    int8_t frozen = flight_recorder_frozen;
+
+    if (frozen < 0) {
+        return;
+    }
+    flight_recorder_frozen = -1;
+    flight_recorder_bank[frozen].magic = 0U;
+    memset(&flight_recorder_dump_state, 0, sizeof(flight_recorder_dump_state));
+}
+
+void flight_recorder_log(uint8_t type, uint8_t id, int16_t v0, uint32_t v1, uint32_t v2) {
+    MUTEX_DECLARE(mutex);
+    volatile uint32_t *p_word;
+    uint32_t slot, tick;
+
+    if (flight_recorder_state != FLIGHT_RECORDER_RUNNING) {
+        return;
+    }
+    //时间戳与位置一起取得,记录按位置顺序时时间戳也单调
+    MUTEX_LOCK(mutex);
+    slot = flight_recorder_live->head++;
+    tick = DWT->CYCCNT;
+    MUTEX_UNLOCK(mutex);
+
+    p_word = (volatile uint32_t *) &flight_recorder_live_record[slot & FLIGHT_RECORDER_MASK];
+    p_word[1] = 0U;
+    p_word[0] = tick;
+    p_word[2] = v1;
+    p_word[3] = v2;
+    p_word[1] = (uint32_t) type | ((uint32_t) id << 8) | ((uint32_t) (uint16_t) v0 << 16);
+}
+
+void flight_recorder_log_f(uint8_t type, uint8_t id, int16_t v0, float32_t v1, float32_t v2) {
+    union {
+        float32_t f;
+        uint32_t u;
+    } f1, f2;
+
+    f1.f = v1;
+    f2.f = v2;
+    flight_recorder_log(type, id, v0, f1.u, f2.u);
+}
+
+bool_t flight_recorder_dump_pending(void) {
+    return flight_recorder_frozen >= 0;
+}
+
+int flight_recorder_dump(flight_recorder_write_f write, uint16_t chunk_len) {
+    int8_t frozen = flight_recorder_frozen;
+    const flight_recorder_bank_t *p_bank;
+    const flight_record_t *p_record;
+    flight_recorder_dump_head_t *p_head = &flight_recorder_dump_state.head;
+    uint32_t slot, num, max_num;
+
+    if (frozen < 0 || write == NULL) {
+        return -1;
+    }
+    p_bank = &flight_recorder_bank[frozen];
+    p_record = flight_recorder_record[frozen];
+    switch (flight_recorder_dump_state.stage) {
+        case FLIGHT_DUMP_HEAD:
+            p_head->magic = FLIGHT_RECORDER_DUMP_MAGIC;
+            p_head->version = FLIGHT_RECORDER_VERSION;
+            p_head->record_size = sizeof(flight_record_t);
+            p_head->tick_hz = p_bank->tick_hz;
+            p_head->boot_cnt = p_bank->boot_cnt;
+            p_head->reset_flags = p_bank->reset_flags;
+            p_head->end_reset_flags = p_bank->end_reset_flags;
+            p_head->head = p_bank->head;
+            p_head->count = (p_head->head < FLIGHT_RECORDER_RECORD_NUM) ? p_head->head : FLIGHT_RECORDER_RECORD_NUM;
+            if (write((const uint8_t *) p_head, sizeof(flight_recorder_dump_head_t)) != 0) {
+                return 0;
+            }
+            flight_recorder_dump_state.crc = get_CRC16_check_sum((uint8_t *) p_head,
+                                                                 sizeof(flight_recorder_dump_head_t),
+                                                                 FLIGHT_RECORDER_CRC_INIT);
+            flight_recorder_dump_state.start = p_head->head - p_head->count;
+            flight_recorder_dump_state.index = 0U;
+            flight_recorder_dump_state.stage = FLIGHT_DUMP_RECORD;
+            return 0;
+        case FLIGHT_DUMP_RECORD:
+            if (flight_recorder_dump_state.index < p_head->count) {
+                //一次写入不跨过缓存末尾
+                slot = (flight_recorder_dump_state.start + flight_recorder_dump_state.index) & FLIGHT_RECORDER_MASK;
+                num = p_head->count - flight_recorder_dump_state.index;
+                max_num = chunk_len / sizeof(flight_record_t);
+                if (max_num == 0U) {
+                    max_num = 1U;
+                }
+                if (num > max_num) {
+                    num = max_num;
+                }
+                if (num > FLIGHT_RECORDER_RECORD_NUM - slot) {
+                    num = FLIGHT_RECORDER_RECORD_NUM - slot;
+                }
+                if (write((const uint8_t *) &p_record[slot], (uint16_t) (num * sizeof(flight_record_t))) != 0) {
+                    return 0;
+                }
+                flight_recorder_dump_state.crc = get_CRC16_check_sum((uint8_t *) &p_record[slot],
+                                                                     num * sizeof(flight_record_t),
+                                                                     flight_recorder_dump_state.crc);
+                flight_recorder_dump_state.index += num;
+                return 0;
+            }
+            flight_recorder_dump_state.tail[0] = (uint8_t) (flight_recorder_dump_state.crc & 0xFFU);
+            flight_recorder_dump_state.tail[1] = (uint8_t) (flight_recorder_dump_state.crc >> 8);
+            flight_recorder_dump_state.tail[2] = 0U;
+            flight_recorder_dump_state.tail[3] = 0U;
+            flight_recorder_dump_state.stage = FLIGHT_DUMP_TAIL;
+            return 0;
+        case FLIGHT_DUMP_TAIL:
+            if (write(flight_recorder_dump_state.tail, sizeof(flight_recorder_dump_state.tail)) != 0) {
+                return 0;
+            }
+            //尾部被接收后才释放冻结的记录区
+            flight_recorder_clear();
+            return 1;
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,157 @@
+/**
+  * @file       flight_recorder.c/h
+  * @brief      flight recorder, compact timestamped records are logged without
+  *             stop into a ring in the no-init CCM RAM. The ring survives a warm
+  *             reset, so after a reset or a HardFault the last seconds before it
+  *             are dumped on the next boot.
+  *             飞行记录仪,把带时间戳的紧凑记录不停地写入CCM RAM中不初始化的环形缓存.
+  *             热复位后缓存仍然保留,复位或HardFault之后在下一次启动时输出之前最后几秒
+  *             的记录
+  * @note       logging a record claims a slot with interrupts disabled for a few
+  *             instructions, the first word of the slot is cleared, the other words
+  *             are written, and the word with the type is written last, so a record
+  *             torn by a fault has type FLIGHT_RECORD_NONE and is skipped.
+  *             The ring is split into two banks. On boot a bank with a valid header
+  *             holds the previous session, it is frozen and this session logs into
+  *             the other bank from the start. The frozen bank is kept over further
+  *             warm resets until a complete dump or flight_recorder_clear.
+  *             Dump stream (little endian):
+  *               header  flight_recorder_dump_head_t
+  *               records flight_record_t * count, oldest first
+  *               tail    crc16 over header and records, 0x0000
+  *             decoded by Matlab/flight_recorder_decode.py.
+  *             写一条记录时关中断几条指令占用一个位置,先清除第一个字,再写其余的字,最后写
+  *             入含类型的字,被故障打断的记录类型为FLIGHT_RECORD_NONE,解码时跳过.
+  *             缓存分为两个记录区,启动时头部有效的记录区保存的是上一次运行的记录,该记录区被冻结,
+  *             本次运行从启动开始写入另一个记录区.冻结的记录区在之后的热复位中保留,直到完整输出或
+  *             flight_recorder_clear.
+  *             输出格式见上,由Matlab/flight_recorder_decode.py解码
+  */
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "struct_typedef.h"
+
+#define FLIGHT_RECORDER_RECORD_NUM      2048                //每个记录区的记录条数,必须为2的幂, 每条16字节
+#define FLIGHT_RECORDER_BANK_NUM        2                   //记录区数量, 上一次运行和本次运行, 共64KB CCM
+#define FLIGHT_RECORDER_MAGIC           0x31524446U         //"FDR1" 缓存头部
+#define FLIGHT_RECORDER_DUMP_MAGIC      0x504D4446U         //"FDMP" 输出头部
+#define FLIGHT_RECORDER_VERSION         1
+
+typedef enum {
+    FLIGHT_RECORD_NONE = 0,         //未写完的记录
+    FLIGHT_RECORD_BOOT,             //v1:复位标志RCC_CSR, v2:启动次数
+    FLIGHT_RECORD_GIMBAL,           //id:0 yaw 1 pitch, v0:电流, v1:角度设定 f, v2:角度 f
+    FLIGHT_RECORD_INS,              //v0:roll mrad, v1:yaw f, v2:pitch f
+    FLIGHT_RECORD_MOTOR,            //id:底盘电机, v0:电流, v1:速度设定 f, v2:速度 f
+    FLIGHT_RECORD_POWER,            //v0:电流缩放系数*1000, v1:裁判功率 f, v2:缓冲能量 f
+    FLIGHT_RECORD_TASK_TIME,        //id:profile_id_e, v0:激活次数, v1:平均执行时间, v2:最大执行时间, DWT计数
+    FLIGHT_RECORD_DETECT,           //id:toe, v0:flight_detect_event_e, v1:系统时间 ms
+    FLIGHT_RECORD_FAULT,            //id:0 v0:EXC_RETURN v1:PC v2:LR, id:1 v1:CFSR v2:HFSR, id:2 v1:MMFAR v2:BFAR
+    FLIGHT_RECORD_TYPE_NUM,
+} flight_record_type_e;
+
+typedef enum {
+    FLIGHT_DETECT_ONLINE = 0,
+    FLIGHT_DETECT_LOST,
+    FLIGHT_DETECT_DATA_ERROR,
+} flight_detect_event_e;
+
+typedef struct {
+    uint32_t tick;                  //DWT计数
+    uint8_t type;                   //flight_record_type_e,最后写入
+    uint8_t id;
+    int16_t v0;
+    uint32_t v1;                    //整数或浮点数的位,由类型决定
+    uint32_t v2;
+} flight_record_t;
+
+typedef struct {
+    uint32_t magic;                 //FLIGHT_RECORDER_DUMP_MAGIC
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t tick_hz;               //DWT计数频率
+    uint32_t boot_cnt;              //该次运行的启动序号
+    uint32_t reset_flags;           //该次运行开始时的复位标志
+    uint32_t end_reset_flags;       //结束该次运行的复位标志
+    uint32_t head;                  //该次运行写入的记录总数
+    uint32_t count;                 //输出的记录数
+} flight_recorder_dump_head_t;
+
+typedef int (*flight_recorder_write_f)(const uint8_t *p_data, uint16_t len);
+
+/**
+  * @brief          init after DWT_init, freezes the bank of the previous session
+  *                 unless a frozen bank is still waiting for its dump, and starts
+  *                 logging this session into the other bank
+  * @param[in]      reset_flags: reset flags of this boot, RCC_CSR
+  * @param[in]      tick_hz: DWT tick frequency
+  * @retval         none
+  */
+/**
+  * @brief          在DWT_init之后初始化,没有等待输出的冻结记录区时冻结上一次运行的记录区,
+  *                 本次运行写入另一个记录区
+  * @param[in]      reset_flags: 本次启动的复位标志, RCC_CSR
+  * @param[in]      tick_hz: DWT计数频率
+  * @retval         none
+  */
+extern void flight_recorder_init(uint32_t reset_flags, uint32_t tick_hz);
+
+/**
+  * @brief          drop the frozen bank without dumping it
+  * @param[in]      none
+  * @retval         none
+  */
+/**
+  * @brief          不输出,直接丢弃冻结的记录区
+  * @param[in]      none
+  * @retval         none
+  */
+extern void flight_recorder_clear(void);
+
+/**
+  * @brief          log a record, can be called from tasks and interrupts
+  * @param[in]      type: flight_record_type_e
+  * @param[in]      id: id
+  * @param[in]      v0: value 0
+  * @param[in]      v1: value 1
+  * @param[in]      v2: value 2
+  * @retval         none
+  */
+/**
+  * @brief          写入一条记录,任务和中断中均可调用
+  * @param[in]      type: flight_record_type_e
+  * @param[in]      id: 编号
+  * @param[in]      v0: 值0
+  * @param[in]      v1: 值1
+  * @param[in]      v2: 值2
+  * @retval         none
+  */
+extern void flight_recorder_log(uint8_t type, uint8_t id, int16_t v0, uint32_t v1, uint32_t v2);
+
+/**
+  * @brief          写入一条v1,v2为浮点数的记录
+  */
+extern void flight_recorder_log_f(uint8_t type, uint8_t id, int16_t v0, float32_t v1, float32_t v2);
+
+/**
+  * @brief          是否有等待输出的上一次运行的记录
+  */
+extern bool_t flight_recorder_dump_pending(void);
+
+/**
+  * @brief          write the next part of the frozen session, call until it returns 1,
+  *                 the bank is released once the tail is taken
+  * @param[in]      write: writer, returns 0 when the whole block is taken
+  * @param[in]      chunk_len: max bytes of one write
+  * @retval         1: dump done, 0: in progress, -1: nothing to dump
+  */
+/**
+  * @brief          输出冻结记录的下一部分,反复调用直到返回1,尾部被接收后释放该记录区
+  * @param[in]      write: 发送函数,整块接收时返回0
+  * @param[in]      chunk_len: 单次发送的最大字节数
+  * @retval         1:输出完成, 0:输出中, -1:没有需要输出的记录
+  */
+extern int flight_recorder_dump(flight_recorder_write_f write, uint16_t chunk_len);
+
+#endif
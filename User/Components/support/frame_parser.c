@@ -0,0 +1,141 @@
+/**
+  * @file       frame_parser.c/h
+  * @brief      frame scanner shared by the serial protocols.
+  *             串口协议共用的帧解析器
+  * @note       frames are verified in place inside the fifo buffer, only a frame
+  *             wrapping the buffer end is copied into p_frame_buf. On a bad header or
+  *             CRC only the SOF byte is dropped so a real frame starting inside the
+  *             rejected bytes is still found.
+  *             帧直接在队列缓存中校验,只有跨越缓存末尾的帧才拷贝到拼接缓存.帧头或校验
+  *             错误时只丢弃SOF一个字节,保证藏在错误数据中的真实帧仍能被找到
+  */
+#include "frame_parser.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+#include <stddef.h>
+
+/**
+  * @brief          在未读数据片段中查找字节
+  * @retval         相对未读数据起点的偏移,未找到时返回未读数据总长度
+  */
+static uint32_t frame_span_find(const spsc_fifo_span_t *p_span, uint8_t byte) {
+    const uint8_t *p_find = memchr(p_span->p_data[0], byte, p_span->len[0]);
+    if (p_find != NULL) {
+        return (uint32_t) (p_find - p_span->p_data[0]);
+    }
+    p_find = memchr(p_span->p_data[1], byte, p_span->len[1]);
+    if (p_find != NULL) {
+        return p_span->len[0] + (uint32_t) (p_find - p_span->p_data[1]);
+    }
+    return p_span->len[0] + p_span->len[1];
+}
+
+/**
+  * @brief          获取未读数据前len字节的连续地址,跨越缓存末尾时拼接到p_buf
+  */
+static const uint8_t *frame_span_linear(const spsc_fifo_span_t *p_span, uint32_t len, uint8_t *p_buf) {
+    if (p_span->len[0] >= len) {
+        return p_span->p_data[0];
+    }
+    memcpy(p_buf, p_span->p_data[0], p_span->len[0]);
+    memcpy(p_buf + p_span->len[0], p_span->p_data[1], len - p_span->len[0]);
+    return p_buf;
+}
+
+static void frame_parser_dispatch(frame_parser_t *p_parser, const uint8_t *p_frame, uint16_t frame_len) {
+    const frame_protocol_t *p_protocol = p_parser->p_protocol;
+    const frame_cmd_t *p_cmd;
+    uint16_t cmd_id = 0;
+    uint16_t data_offset = p_protocol->header_len + p_protocol->cmd_id_size;
+    uint16_t data_len = frame_len - data_offset - FRAME_PARSER_CRC16_SIZE;
+    uint16_t i;
+
+    if (p_protocol->cmd_id_size) {
+        cmd_id = (uint16_t) (p_frame[p_protocol->header_len] | (p_frame[p_protocol->header_len + 1] << 8));
+    }
+    p_parser->frame_cnt++;
+    if (p_parser->frame_callback != NULL) {
+        p_parser->frame_callback(p_frame, frame_len, cmd_id);
+    }
+    for (i = 0; i < p_parser->cmd_num; i++) {
+        p_cmd = &p_parser->p_cmd_table[i];
+        if (p_cmd->cmd_id != cmd_id) {
+            continue;
+        }
+        if (p_cmd->p_dest != NULL) {
+            memcpy((void *) p_cmd->p_dest, p_frame + data_offset,
+                   (p_cmd->data_len < data_len) ? p_cmd->data_len : data_len);
+        }
+        if (p_cmd->p_update_flag != NULL) {
+            *p_cmd->p_update_flag = true;
+        }
+        if (p_cmd->callback != NULL) {
+            p_cmd->callback(p_frame, frame_len, cmd_id);
+        }
+        return;
+    }
+    p_parser->unknown_cmd_cnt++;
+}
+
+void frame_parser_init(frame_parser_t *p_parser, const frame_protocol_t *p_protocol,
+                       const frame_cmd_t *p_cmd_table, uint16_t cmd_num, frame_callback_f frame_callback,
+                       uint8_t *p_frame_buf) {
+    memset(p_parser, 0, sizeof(frame_parser_t));
+    p_parser->p_protocol = p_protocol;
+    p_parser->p_cmd_table = p_cmd_table;
+    p_parser->cmd_num = cmd_num;
+    p_parser->frame_callback = frame_callback;
+    p_parser->p_frame_buf = p_frame_buf;
+}
+
+uint32_t frame_parser_unpack_fifo(frame_parser_t *p_parser, spsc_fifo_t *p_fifo) {
+    const frame_protocol_t *p_protocol = p_parser->p_protocol;
+    spsc_fifo_span_t span;
+    const uint8_t *p_frame;
+    uint32_t used_num, sof_offset, data_len, frame_len;
+    uint32_t dispatch_cnt = 0;
+
+    while ((used_num = spsc_fifo_peek(p_fifo, &span)) != 0U) {
+        //丢弃帧头之前的数据
+        sof_offset = frame_span_find(&span, p_protocol->sof);
+        if (sof_offset != 0U) {
+            p_parser->skip_byte_cnt += spsc_fifo_discard(p_fifo, sof_offset);
+            continue;
+        }
+        if (used_num < p_protocol->header_len) {
+            break;
+        }
+
+        p_frame = frame_span_linear(&span, p_protocol->header_len, p_parser->p_frame_buf);
+        if (p_protocol->header_crc8 && !verify_CRC8_check_sum((uint8_t *) p_frame, p_protocol->header_len)) {
+            p_parser->err_cnt++;
+            spsc_fifo_discard(p_fifo, 1U);
+            continue;
+        }
+        data_len = p_frame[p_protocol->len_offset];
+        if (p_protocol->len_size == 2U) {
+            data_len |= (uint32_t) p_frame[p_protocol->len_offset + 1] << 8;
+        }
+        frame_len = p_protocol->header_len + p_protocol->cmd_id_size + data_len + FRAME_PARSER_CRC16_SIZE;
+        if (frame_len > p_protocol->max_frame_len) {
+            p_parser->err_cnt++;
+            spsc_fifo_discard(p_fifo, 1U);
+            continue;
+        }
+        //帧未收全,等待后续数据
+        if (used_num < frame_len) {
+            break;
+        }
+
+        p_frame = frame_span_linear(&span, frame_len, p_parser->p_frame_buf);
+        if (!verify_CRC16_check_sum((uint8_t *) p_frame, frame_len)) {
+            p_parser->err_cnt++;
+            spsc_fifo_discard(p_fifo, 1U);
+            continue;
+        }
+        frame_parser_dispatch(p_parser, p_frame, (uint16_t) frame_len);
+        spsc_fifo_discard(p_fifo, frame_len);
+        dispatch_cnt++;
+    }
+    return dispatch_cnt;
+}
@@ -0,0 +1,98 @@
+/**
+  * @file       frame_parser.c/h
+  * @brief      frame scanner shared by the serial protocols. It searches the unread
+  *             spans of an spsc_fifo for the SOF, checks the header CRC8 and the
+  *             full-frame CRC16 once per frame, then dispatches the frame by cmd_id
+  *             through a registration table.
+  *             串口协议共用的帧解析器:在spsc_fifo未读数据片段中搜索帧头,每帧只做一次
+  *             帧头CRC8和整帧CRC16校验,再通过注册表按命令码分发
+  * @note       frame layout: header(SOF ... [CRC8]) + [cmd_id] + data + CRC16
+  *             帧格式:帧头(SOF ... [CRC8]) + [命令码] + 数据段 + CRC16
+  */
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include <stdbool.h>
+#include "struct_typedef.h"
+#include "spsc_fifo.h"
+
+#define FRAME_PARSER_CRC16_SIZE 2
+
+/**
+  * @brief          帧回调
+  * @param[in]      p_frame: 完整帧首地址(含帧头和CRC16)
+  * @param[in]      frame_len: 帧长度
+  * @param[in]      cmd_id: 命令码,协议无命令码时为0
+  */
+typedef void (*frame_callback_f)(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id);
+
+typedef struct {
+    uint8_t sof;
+    uint8_t header_len;     //帧头长度,含SOF和帧头CRC8
+    uint8_t len_offset;     //数据段长度字段在帧头中的偏移
+    uint8_t len_size;       //数据段长度字段字节数,1或2,小端
+    uint8_t header_crc8;    //帧头最后一字节是否为CRC8
+    uint8_t cmd_id_size;    //命令码字节数,0或2,紧跟帧头
+    uint16_t max_frame_len; //最大帧长
+} frame_protocol_t;
+
+typedef struct {
+    uint16_t cmd_id;
+    uint16_t data_len;            //拷贝长度,实际数据段更短时按实际长度拷贝
+    volatile void *p_dest;        //数据段拷贝目标,NULL不拷贝
+    volatile bool *p_update_flag; //拷贝后置位,可为NULL
+    frame_callback_f callback;    //拷贝后调用,可为NULL
+} frame_cmd_t;
+
+typedef struct {
+    const frame_protocol_t *p_protocol;
+    const frame_cmd_t *p_cmd_table;
+    uint16_t cmd_num;
+    frame_callback_f frame_callback; //每个校验通过的帧在分发前调用,可为NULL
+    uint8_t *p_frame_buf;            //帧跨越队列缓存末尾时的拼接缓存,长度不小于max_frame_len
+    uint32_t frame_cnt;              //校验通过帧数
+    uint32_t err_cnt;                //校验失败或长度非法的帧数
+    uint32_t unknown_cmd_cnt;        //未注册命令码帧数
+    uint32_t skip_byte_cnt;          //搜索帧头时丢弃的字节数
+} frame_parser_t;
+
+/**
+  * @brief          init the parser
+  * @param[out]     p_parser: parser
+  * @param[in]      p_protocol: frame layout
+  * @param[in]      p_cmd_table: cmd_id registration table
+  * @param[in]      cmd_num: entries of the table
+  * @param[in]      frame_callback: called for every valid frame, can be NULL
+  * @param[in]      p_frame_buf: buffer of max_frame_len for frames wrapping the fifo end
+  * @retval         none
+  */
+/**
+  * @brief          初始化解析器
+  * @param[out]     p_parser: 解析器
+  * @param[in]      p_protocol: 帧格式
+  * @param[in]      p_cmd_table: 命令码注册表
+  * @param[in]      cmd_num: 注册表项数
+  * @param[in]      frame_callback: 每个有效帧的回调,可为NULL
+  * @param[in]      p_frame_buf: 帧跨越队列末尾时的拼接缓存,长度不小于max_frame_len
+  * @retval         none
+  */
+extern void frame_parser_init(frame_parser_t *p_parser, const frame_protocol_t *p_protocol,
+                              const frame_cmd_t *p_cmd_table, uint16_t cmd_num, frame_callback_f frame_callback,
+                              uint8_t *p_frame_buf);
+
+/**
+  * @brief          unpack every complete frame in the fifo, an incomplete tail stays in
+  *                 the fifo until more bytes arrive
+  * @param[in]      p_parser: parser
+  * @param[in]      p_fifo: rx fifo, the parser is its consumer
+  * @retval         frames dispatched
+  */
+/**
+  * @brief          解析队列中所有完整帧,不完整的帧尾留在队列中等待后续数据
+  * @param[in]      p_parser: 解析器
+  * @param[in]      p_fifo: 接收队列,解析器为其消费者
+  * @retval         本次分发的帧数
+  */
+extern uint32_t frame_parser_unpack_fifo(frame_parser_t *p_parser, spsc_fifo_t *p_fifo);
+
+#endif
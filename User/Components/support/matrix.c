@@ -4,17 +4,29 @@
 #include "arm_math.h"
 #include "matrix.h"
 #include <stdlib.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "SEGGER_RTT.h"
 #include "printf.h"
 
-void Matrix_nodata_creat_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+/* bind row table and data of the matrix either to its fixed-capacity buffer or to a fresh heap block */
+static void Matrix_vAllocate_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
     matrix_op->arm_matrix.numRows = _i16row;
     matrix_op->arm_matrix.numCols = _i16col;
     matrix_op->is_valid = false;
-    matrix_op->p2Data = (float32_t **) pvPortMalloc(
-            sizeof(float32_t *) * _i16row + sizeof(float32_t) * _i16col * _i16row);
-    matrix_op->arm_matrix.pData = (float32_t *) (matrix_op->p2Data + _i16row);
+    if (matrix_op->buffer != NULL) {
+        if ((_i16row > MATRIX_MAXIMUM_SIZE) || (_i16col > MATRIX_MAXIMUM_SIZE)) {
+            matrix_op->p2Data = NULL;
+            matrix_op->arm_matrix.pData = NULL;
+            return;
+        }
+        matrix_op->p2Data = matrix_op->buffer->p2Data;
+        matrix_op->arm_matrix.pData = matrix_op->buffer->data;
+    } else {
+        matrix_op->p2Data = (float32_t **) pvPortMalloc(
+                sizeof(float32_t *) * _i16row + sizeof(float32_t) * _i16col * _i16row);
+        matrix_op->arm_matrix.pData = (float32_t *) (matrix_op->p2Data + _i16row);
+    }
     if (matrix_op->p2Data != NULL) {
         for (uint16_t i = 0; i < _i16row; i++) {
             matrix_op->p2Data[i] = (matrix_op->arm_matrix.pData + _i16col * i);
@@ -25,13 +37,23 @@ void Matrix_nodata_creat_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, co
         Matrix_vSetHomogen_f32(matrix_op, 0.0f);
     }
 }
-void Matrix_nodata_creat_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+static void Matrix_vAllocate_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
     matrix_op->arm_matrix.numRows = _i16row;
     matrix_op->arm_matrix.numCols = _i16col;
     matrix_op->is_valid = false;
-    matrix_op->p2Data = (float64_t **) pvPortMalloc(
-            sizeof(float64_t *) * _i16row + sizeof(float64_t) * _i16col * _i16row);
-    matrix_op->arm_matrix.pData = (float64_t *) (matrix_op->p2Data + _i16row);
+    if (matrix_op->buffer != NULL) {
+        if ((_i16row > MATRIX_MAXIMUM_SIZE) || (_i16col > MATRIX_MAXIMUM_SIZE)) {
+            matrix_op->p2Data = NULL;
+            matrix_op->arm_matrix.pData = NULL;
+            return;
+        }
+        matrix_op->p2Data = matrix_op->buffer->p2Data;
+        matrix_op->arm_matrix.pData = matrix_op->buffer->data;
+    } else {
+        matrix_op->p2Data = (float64_t **) pvPortMalloc(
+                sizeof(float64_t *) * _i16row + sizeof(float64_t) * _i16col * _i16row);
+        matrix_op->arm_matrix.pData = (float64_t *) (matrix_op->p2Data + _i16row);
+    }
     if (matrix_op->p2Data != NULL) {
         for (uint16_t i = 0; i < _i16row; i++) {
             matrix_op->p2Data[i] = (matrix_op->arm_matrix.pData + _i16col * i);
@@ -43,52 +65,77 @@ void Matrix_nodata_creat_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, co
     }
 }
 
-void Matrix_data_creat_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, float32_t *initData,
-                           InitZero _init) {
-    matrix_op->arm_matrix.numRows = _i16row;
-    matrix_op->arm_matrix.numCols = _i16col;
-    matrix_op->is_valid = false;
-    matrix_op->p2Data = (float32_t **) pvPortMalloc(
-            sizeof(float32_t *) * _i16row + sizeof(float32_t) * _i16col * _i16row);
-    matrix_op->arm_matrix.pData = (float32_t *) (matrix_op->p2Data + _i16row);
-    if (matrix_op->p2Data != NULL) {
-        for (uint16_t i = 0; i < _i16row; i++) {
-            matrix_op->p2Data[i] = (matrix_op->arm_matrix.pData + _i16col * i);
+/* keep the storage of an already valid result when the shape matches, otherwise drop it and allocate again */
+static void Matrix_vReshape_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+    if (Matrix_bMatrixIsValid_f32(matrix_op) && (matrix_op->arm_matrix.numRows == _i16row) &&
+        (matrix_op->arm_matrix.numCols == _i16col)) {
+        if (_init == InitMatWithZero) {
+            Matrix_vSetHomogen_f32(matrix_op, 0.0f);
         }
-        matrix_op->is_valid = true;
-    }
-    if (_init == InitMatWithZero) {
-        Matrix_vSetHomogen_f32(matrix_op, 0.0f);
+        return;
     }
-    for (uint16_t _i = 0; _i < matrix_op->arm_matrix.numRows; _i++) {
-        for (uint16_t _j = 0; _j < matrix_op->arm_matrix.numCols; _j++) {
-            (matrix_op->p2Data)[_i][_j] = *initData;
-            initData++;
+    Matrix_vSetMatrixInvalid_f32(matrix_op);
+    Matrix_vAllocate_f32(matrix_op, _i16row, _i16col, _init);
+}
+static void Matrix_vReshape_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+    if (Matrix_bMatrixIsValid_f64(matrix_op) && (matrix_op->arm_matrix.numRows == _i16row) &&
+        (matrix_op->arm_matrix.numCols == _i16col)) {
+        if (_init == InitMatWithZero) {
+            Matrix_vSetHomogen_f64(matrix_op, 0.0);
         }
+        return;
+    }
+    Matrix_vSetMatrixInvalid_f64(matrix_op);
+    Matrix_vAllocate_f64(matrix_op, _i16row, _i16col, _init);
+}
+
+void Matrix_nodata_creat_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+    matrix_op->buffer = NULL;
+    Matrix_vAllocate_f32(matrix_op, _i16row, _i16col, _init);
+}
+void Matrix_nodata_creat_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, InitZero _init) {
+    matrix_op->buffer = NULL;
+    Matrix_vAllocate_f64(matrix_op, _i16row, _i16col, _init);
+}
+
+void Matrix_data_creat_f32(matrix_f32_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, float32_t *initData,
+                           InitZero _init) {
+    Matrix_nodata_creat_f32(matrix_op, _i16row, _i16col, _init);
+    if (matrix_op->is_valid) {
+        memcpy(matrix_op->arm_matrix.pData, initData, sizeof(float32_t) * _i16row * _i16col);
     }
 }
 void Matrix_data_creat_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, float64_t *initData,
                            InitZero _init) {
-    matrix_op->arm_matrix.numRows = _i16row;
-    matrix_op->arm_matrix.numCols = _i16col;
-    matrix_op->is_valid = false;
-    matrix_op->p2Data = (float64_t **) pvPortMalloc(
-            sizeof(float64_t *) * _i16row + sizeof(float64_t) * _i16col * _i16row);
-    matrix_op->arm_matrix.pData = (float64_t *) (matrix_op->p2Data + _i16row);
-    if (matrix_op->p2Data != NULL) {
-        for (uint16_t i = 0; i < _i16row; i++) {
-            matrix_op->p2Data[i] = (matrix_op->arm_matrix.pData + _i16col * i);
-        }
-        matrix_op->is_valid = true;
+    Matrix_nodata_creat_f64(matrix_op, _i16row, _i16col, _init);
+    if (matrix_op->is_valid) {
+        memcpy(matrix_op->arm_matrix.pData, initData, sizeof(float64_t) * _i16row * _i16col);
     }
-    if (_init == InitMatWithZero) {
-        Matrix_vSetHomogen_f64(matrix_op, 0.0);
+}
+
+void Matrix_static_nodata_creat_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer, const uint16_t _i16row,
+                                    const uint16_t _i16col, InitZero _init) {
+    matrix_op->buffer = buffer;
+    Matrix_vAllocate_f32(matrix_op, _i16row, _i16col, _init);
+}
+void Matrix_static_nodata_creat_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer, const uint16_t _i16row,
+                                    const uint16_t _i16col, InitZero _init) {
+    matrix_op->buffer = buffer;
+    Matrix_vAllocate_f64(matrix_op, _i16row, _i16col, _init);
+}
+
+void Matrix_static_data_creat_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer, const uint16_t _i16row,
+                                  const uint16_t _i16col, float32_t *initData, InitZero _init) {
+    Matrix_static_nodata_creat_f32(matrix_op, buffer, _i16row, _i16col, _init);
+    if (matrix_op->is_valid) {
+        memcpy(matrix_op->arm_matrix.pData, initData, sizeof(float32_t) * _i16row * _i16col);
     }
-    for (uint16_t _i = 0; _i < matrix_op->arm_matrix.numRows; _i++) {
-        for (uint16_t _j = 0; _j < matrix_op->arm_matrix.numCols; _j++) {
-            (matrix_op->p2Data)[_i][_j] = *initData;
-            initData++;
-        }
+}
+void Matrix_static_data_creat_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer, const uint16_t _i16row,
+                                  const uint16_t _i16col, float64_t *initData, InitZero _init) {
+    Matrix_static_nodata_creat_f64(matrix_op, buffer, _i16row, _i16col, _init);
+    if (matrix_op->is_valid) {
+        memcpy(matrix_op->arm_matrix.pData, initData, sizeof(float64_t) * _i16row * _i16col);
     }
 }
 
@@ -116,7 +163,7 @@ bool Matrix_bMatrixIsValid_f64(matrix_f64_t *matrix_op) {
 void Matrix_vSetMatrixInvalid_f32(matrix_f32_t *matrix_op) {
     matrix_op->arm_matrix.numRows = -1;
     matrix_op->arm_matrix.numCols = -1;
-    if (matrix_op->is_valid) {
+    if (matrix_op->is_valid && (matrix_op->buffer == NULL)) {
         vPortFree(matrix_op->p2Data);
     }
     matrix_op->is_valid = false;
@@ -126,7 +173,7 @@ void Matrix_vSetMatrixInvalid_f32(matrix_f32_t *matrix_op) {
 void Matrix_vSetMatrixInvalid_f64(matrix_f64_t *matrix_op) {
     matrix_op->arm_matrix.numRows = -1;
     matrix_op->arm_matrix.numCols = -1;
-    if (matrix_op->is_valid) {
+    if (matrix_op->is_valid && (matrix_op->buffer == NULL)) {
         vPortFree(matrix_op->p2Data);
     }
     matrix_op->is_valid = false;
@@ -208,14 +255,14 @@ bool Matrix_bMatrixIsEqual_f64(matrix_f64_t *matrix_L, matrix_f64_t *matrix_R) {
 void Matrix_vadd_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matrix_f32_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f32(matrix_L) && Matrix_bMatrixIsValid_f32(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_L->arm_matrix.numCols) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f32(matrix_result);
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
@@ -230,14 +277,14 @@ void Matrix_vadd_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matrix_f32_
 void Matrix_vadd_f64(matrix_f64_t *matrix_L, matrix_f64_t *matrix_R, matrix_f64_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f64(matrix_L) && Matrix_bMatrixIsValid_f64(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_L->arm_matrix.numCols) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f64(matrix_result);
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
@@ -253,14 +300,14 @@ void Matrix_vadd_f64(matrix_f64_t *matrix_L, matrix_f64_t *matrix_R, matrix_f64_
 extern void Matrix_vsub_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matrix_f32_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f32(matrix_L) && Matrix_bMatrixIsValid_f32(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_L->arm_matrix.numCols) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f32(matrix_result);
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
@@ -275,14 +322,14 @@ extern void Matrix_vsub_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matr
 extern void Matrix_vsub_f64(matrix_f64_t *matrix_L, matrix_f64_t *matrix_R, matrix_f64_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f64(matrix_L) && Matrix_bMatrixIsValid_f64(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_L->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_L->arm_matrix.numCols) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f64(matrix_result);
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numRows != matrix_R->arm_matrix.numRows) ||
@@ -309,12 +356,12 @@ void Matrix_vGetNegative_f64(matrix_f64_t *matrix_op) {
 void Matrix_vmult_nsame_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matrix_f32_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f32(matrix_L) && Matrix_bMatrixIsValid_f32(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f32(matrix_result);
-            Matrix_nodata_creat_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f32(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numCols != matrix_R->arm_matrix.numRows) ||
@@ -330,12 +377,12 @@ void Matrix_vmult_nsame_f32(matrix_f32_t *matrix_L, matrix_f32_t *matrix_R, matr
 void Matrix_vmult_nsame_f64(matrix_f64_t *matrix_L, matrix_f64_t *matrix_R, matrix_f64_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f64(matrix_L) && Matrix_bMatrixIsValid_f64(matrix_R)) {
         if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         } else if ((matrix_result->arm_matrix.numRows != matrix_L->arm_matrix.numRows) ||
                    (matrix_result->arm_matrix.numCols != matrix_R->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f64(matrix_result);
-            Matrix_nodata_creat_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
+            Matrix_vAllocate_f64(matrix_result, matrix_L->arm_matrix.numRows, matrix_R->arm_matrix.numCols,
                                     InitMatWithZero);
         }
         if ((matrix_L->arm_matrix.numCols != matrix_R->arm_matrix.numRows) ||
@@ -633,27 +680,13 @@ void Matrix_vInsertPartSubMatrix_unstuck_f64(matrix_f64_t *matrix_op, matrix_f64
 }
 
 void Matrix_vTranspose_nsame_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f32(matrix_result)) {
-        Matrix_vSetMatrixInvalid_f32(matrix_result);
-        Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows,
-                                InitMatWithZero);
-    } else {
-        Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows,
-                                InitMatWithZero);
-    }
+    Matrix_vReshape_f32(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows, InitMatWithZero);
     if (Matrix_bMatrixIsValid_f32(matrix_op) && Matrix_bMatrixIsValid_f32(matrix_result)) {
         arm_mat_trans_f32(&matrix_op->arm_matrix, &matrix_result->arm_matrix);
     }
 }
 void Matrix_vTranspose_nsame_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f64(matrix_result)) {
-        Matrix_vSetMatrixInvalid_f64(matrix_result);
-        Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows,
-                                InitMatWithZero);
-    } else {
-        Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows,
-                                InitMatWithZero);
-    }
+    Matrix_vReshape_f64(matrix_result, matrix_op->arm_matrix.numCols, matrix_op->arm_matrix.numRows, InitMatWithZero);
     if (Matrix_bMatrixIsValid_f64(matrix_op) && Matrix_bMatrixIsValid_f64(matrix_result)) {
         arm_mat_trans_f64(&matrix_op->arm_matrix, &matrix_result->arm_matrix);
     }
@@ -715,37 +748,30 @@ bool Matrix_bNormVector_f64(matrix_f64_t *matrix_op) {
 }
 
 void Matrix_vInverse_nsame_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
-    if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-        Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                InitMatWithZero);
-    } else {
-        Matrix_vSetMatrixInvalid_f32(matrix_result);
-        Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                InitMatWithZero);
-    }
+    Matrix_vReshape_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols, InitMatWithZero);
     if (Matrix_bMatrixIsValid_f32(matrix_op) && Matrix_bMatrixIsValid_f32(matrix_result)) {
-        arm_mat_inverse_f32(&matrix_op->arm_matrix, &matrix_result->arm_matrix);
+        //奇异矩阵的结果无效
+        if (arm_mat_inverse_f32(&matrix_op->arm_matrix, &matrix_result->arm_matrix) != ARM_MATH_SUCCESS) {
+            Matrix_vSetMatrixInvalid_f32(matrix_result);
+        }
     }
 }
 void Matrix_vInverse_nsame_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
-    if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-        Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                InitMatWithZero);
-    } else {
-        Matrix_vSetMatrixInvalid_f64(matrix_result);
-        Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                InitMatWithZero);
-    }
+    Matrix_vReshape_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols, InitMatWithZero);
     if (Matrix_bMatrixIsValid_f64(matrix_op) && Matrix_bMatrixIsValid_f64(matrix_result)) {
-        arm_mat_inverse_f64(&matrix_op->arm_matrix, &matrix_result->arm_matrix);
+        //奇异矩阵的结果无效
+        if (arm_mat_inverse_f64(&matrix_op->arm_matrix, &matrix_result->arm_matrix) != ARM_MATH_SUCCESS) {
+            Matrix_vSetMatrixInvalid_f64(matrix_result);
+        }
     }
 }
 
-bool Matrix_bMatrixIsPositiveDefinite_f32(matrix_f32_t *matrix_op, bool checkPosSemidefinite) {
+bool Matrix_bMatrixIsPositiveDefinite_f32(matrix_f32_t *matrix_op, bool checkPosSemidefinite,
+                                          matrix_buffer_f32_t *scratch) {
     if (Matrix_bMatrixIsValid_f32(matrix_op)) {
         bool _posDef, _posSemiDef;
         matrix_f32_t _temp;
-        Matrix_vinit_f32(&_temp);
+        Matrix_vinit_static_f32(&_temp, scratch);
         Matrix_vCopy_f32(matrix_op, &_temp);
 
         /* Gauss Elimination... */
@@ -792,11 +818,12 @@ bool Matrix_bMatrixIsPositiveDefinite_f32(matrix_f32_t *matrix_op, bool checkPos
         return false;
     }
 }
-bool Matrix_bMatrixIsPositiveDefinite_f64(matrix_f64_t *matrix_op, bool checkPosSemidefinite) {
+bool Matrix_bMatrixIsPositiveDefinite_f64(matrix_f64_t *matrix_op, bool checkPosSemidefinite,
+                                          matrix_buffer_f64_t *scratch) {
     if (Matrix_bMatrixIsValid_f64(matrix_op)) {
         bool _posDef, _posSemiDef;
         matrix_f64_t _temp;
-        Matrix_vinit_f64(&_temp);
+        Matrix_vinit_static_f64(&_temp, scratch);
         Matrix_vCopy_f64(matrix_op, &_temp);
 
         /* Gauss Elimination... */
@@ -846,12 +873,7 @@ bool Matrix_bMatrixIsPositiveDefinite_f64(matrix_f64_t *matrix_op, bool checkPos
 
 void Matrix_vGetDiagonalEntries_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f32(matrix_op)) {
-        if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
-        } else {
-            Matrix_vSetMatrixInvalid_f32(matrix_result);
-            Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
-        }
+        Matrix_vReshape_f32(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
         if (matrix_op->arm_matrix.numRows != matrix_op->arm_matrix.numCols) {
             Matrix_vSetMatrixInvalid_f32(matrix_result);
         }
@@ -864,12 +886,7 @@ void Matrix_vGetDiagonalEntries_f32(matrix_f32_t *matrix_op, matrix_f32_t *matri
 }
 void Matrix_vGetDiagonalEntries_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
     if (Matrix_bMatrixIsValid_f64(matrix_op)) {
-        if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
-        } else {
-            Matrix_vSetMatrixInvalid_f64(matrix_result);
-            Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
-        }
+        Matrix_vReshape_f64(matrix_result, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
         if (matrix_op->arm_matrix.numRows != matrix_op->arm_matrix.numCols) {
             Matrix_vSetMatrixInvalid_f64(matrix_result);
         }
@@ -883,7 +900,7 @@ void Matrix_vGetDiagonalEntries_f64(matrix_f64_t *matrix_op, matrix_f64_t *matri
 
 void Matrix_vCholeskyDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-        Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
+        Matrix_vAllocate_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
                                 InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f32(matrix_op) && Matrix_bMatrixIsValid_f32(matrix_result)) {
@@ -892,7 +909,7 @@ void Matrix_vCholeskyDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_resul
 }
 void Matrix_vCholeskyDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-        Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
+        Matrix_vAllocate_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
                                 InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f64(matrix_op) && Matrix_bMatrixIsValid_f64(matrix_result)) {
@@ -902,7 +919,7 @@ void Matrix_vCholeskyDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_resul
 
 void
 Matrix_vHouseholderTransformQR_f32(matrix_f32_t *matrix_op, const uint16_t _rowTransform, const uint16_t _columnTransform,
-                                   matrix_f32_t *matrix_result) {
+                                   matrix_f32_t *matrix_result, matrix_buffer_f32_t *scratch) {
     if (Matrix_bMatrixIsValid_f32(matrix_op)) {
         float32_t _tempFloat;
         float32_t _xLen;
@@ -911,12 +928,11 @@ Matrix_vHouseholderTransformQR_f32(matrix_f32_t *matrix_op, const uint16_t _rowT
         float32_t _vLen2;
 
         if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_nodata_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numRows,
+            Matrix_vAllocate_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numRows,
                                     InitMatWithZero);
         }
         matrix_f32_t _vectTemp;
-        Matrix_vinit_f32(&_vectTemp);
-        Matrix_nodata_creat_f32(&_vectTemp, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_static_nodata_creat_f32(&_vectTemp, scratch, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
         if ((_rowTransform >= matrix_op->arm_matrix.numRows) ||
             (_columnTransform >= matrix_op->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f32(matrix_result);
@@ -957,7 +973,8 @@ Matrix_vHouseholderTransformQR_f32(matrix_f32_t *matrix_op, const uint16_t _rowT
             Matrix_vSetIdentity_f32(matrix_result);
         } else {
             if (Matrix_bMatrixIsValid_f32(matrix_result)) {
-                /* P = -2*(u1*u1')/v_len2 + I */
+                /* P = -2*(u1*u1')/v_len2 + I, only the non-zero entries of u are written below */
+                Matrix_vSetToZero_f32(matrix_result);
                 /* PR TODO: We can do many optimization here */
                 for (uint16_t _i = 0; _i < matrix_op->arm_matrix.numRows; _i++) {
                     _tempFloat = _vectTemp.p2Data[_i][0];
@@ -978,7 +995,7 @@ Matrix_vHouseholderTransformQR_f32(matrix_f32_t *matrix_op, const uint16_t _rowT
 }
 void
 Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowTransform, const uint16_t _columnTransform,
-                                   matrix_f64_t *matrix_result) {
+                                   matrix_f64_t *matrix_result, matrix_buffer_f64_t *scratch) {
     if (Matrix_bMatrixIsValid_f64(matrix_op)) {
         float64_t _tempFloat;
         float64_t _xLen;
@@ -987,12 +1004,11 @@ Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowT
         float64_t _vLen2;
 
         if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_nodata_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numRows,
+            Matrix_vAllocate_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numRows,
                                     InitMatWithZero);
         }
         matrix_f64_t _vectTemp;
-        Matrix_vinit_f64(&_vectTemp);
-        Matrix_nodata_creat_f64(&_vectTemp, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_static_nodata_creat_f64(&_vectTemp, scratch, matrix_op->arm_matrix.numRows, 1, InitMatWithZero);
         if ((_rowTransform >= matrix_op->arm_matrix.numRows) ||
             (_columnTransform >= matrix_op->arm_matrix.numCols)) {
             Matrix_vSetMatrixInvalid_f64(matrix_result);
@@ -1033,7 +1049,8 @@ Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowT
             Matrix_vSetIdentity_f64(matrix_result);
         } else {
             if (Matrix_bMatrixIsValid_f64(matrix_result)) {
-                /* P = -2*(u1*u1')/v_len2 + I */
+                /* P = -2*(u1*u1')/v_len2 + I, only the non-zero entries of u are written below */
+                Matrix_vSetToZero_f64(matrix_result);
                 /* PR TODO: We can do many optimization here */
                 for (uint16_t _i = 0; _i < matrix_op->arm_matrix.numRows; _i++) {
                     _tempFloat = _vectTemp.p2Data[_i][0];
@@ -1053,12 +1070,14 @@ Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowT
     }
 }
 
-bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *R) {
+bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *R,
+                       matrix_buffer_f32_t scratch[MATRIX_QR_SCRATCH_NUM]) {
     if (Matrix_bMatrixIsValid_f32(matrix_op) && Matrix_bMatrixIsValid_f32(Qt)) {
         matrix_f32_t Qn;
         matrix_f32_t _temp;
-        Matrix_vinit_f32(&_temp);
-        Matrix_nodata_creat_f32(&Qn, Qt->arm_matrix.numRows, Qt->arm_matrix.numCols, InitMatWithZero);
+        Matrix_vinit_static_f32(&_temp, &scratch[0]);
+        Matrix_static_nodata_creat_f32(&Qn, &scratch[1], Qt->arm_matrix.numRows, Qt->arm_matrix.numCols,
+                                       InitMatWithZero);
         if ((matrix_op->arm_matrix.numRows < matrix_op->arm_matrix.numCols) || (!Matrix_bMatrixIsSquare_f32(Qt)) ||
             (Qt->arm_matrix.numRows != matrix_op->arm_matrix.numRows) ||
             (R->arm_matrix.numRows != Qt->arm_matrix.numRows) ||
@@ -1071,7 +1090,7 @@ bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *
         Matrix_vSetIdentity_f32(Qt);
         for (uint16_t _i = 0;
              (_i < (matrix_op->arm_matrix.numRows - 1)) && (_i < matrix_op->arm_matrix.numCols - 1); _i++) {
-            Matrix_vHouseholderTransformQR_f32(R, _i, _i, &Qn);
+            Matrix_vHouseholderTransformQR_f32(R, _i, _i, &Qn, &scratch[2]);
             if (!Matrix_bMatrixIsValid_f32(&Qn)) {
                 Matrix_vSetMatrixInvalid_f32(Qt);
                 Matrix_vSetMatrixInvalid_f32(R);
@@ -1089,12 +1108,14 @@ bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *
         return false;
     }
 }
-bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *R) {
+bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *R,
+                       matrix_buffer_f64_t scratch[MATRIX_QR_SCRATCH_NUM]) {
     if (Matrix_bMatrixIsValid_f64(matrix_op) && Matrix_bMatrixIsValid_f64(Qt)) {
         matrix_f64_t Qn;
         matrix_f64_t _temp;
-        Matrix_vinit_f64(&_temp);
-        Matrix_nodata_creat_f64(&Qn, Qt->arm_matrix.numRows, Qt->arm_matrix.numCols, InitMatWithZero);
+        Matrix_vinit_static_f64(&_temp, &scratch[0]);
+        Matrix_static_nodata_creat_f64(&Qn, &scratch[1], Qt->arm_matrix.numRows, Qt->arm_matrix.numCols,
+                                       InitMatWithZero);
         if ((matrix_op->arm_matrix.numRows < matrix_op->arm_matrix.numCols) || (!Matrix_bMatrixIsSquare_f64(Qt)) ||
             (Qt->arm_matrix.numRows != matrix_op->arm_matrix.numRows) ||
             (R->arm_matrix.numRows != Qt->arm_matrix.numRows) ||
@@ -1107,7 +1128,7 @@ bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *
         Matrix_vSetIdentity_f64(Qt);
         for (uint16_t _i = 0;
              (_i < (matrix_op->arm_matrix.numRows - 1)) && (_i < matrix_op->arm_matrix.numCols - 1); _i++) {
-            Matrix_vHouseholderTransformQR_f64(R, _i, _i, &Qn);
+            Matrix_vHouseholderTransformQR_f64(R, _i, _i, &Qn, &scratch[2]);
             if (!Matrix_bMatrixIsValid_f64(&Qn)) {
                 Matrix_vSetMatrixInvalid_f64(Qt);
                 Matrix_vSetMatrixInvalid_f64(R);
@@ -1128,7 +1149,7 @@ bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *
 
 void Matrix_vBackSubtitution_f32(matrix_f32_t *upper_tri_A, matrix_f32_t *matrix_B, matrix_f32_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-        Matrix_nodata_creat_f32(matrix_result, upper_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_vAllocate_f32(matrix_result, upper_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f32(upper_tri_A) && Matrix_bMatrixIsValid_f32(matrix_B) &&
         Matrix_bMatrixIsValid_f32(matrix_result)) {
@@ -1138,7 +1159,7 @@ void Matrix_vBackSubtitution_f32(matrix_f32_t *upper_tri_A, matrix_f32_t *matrix
 }
 void Matrix_vBackSubtitution_f64(matrix_f64_t *upper_tri_A, matrix_f64_t *matrix_B, matrix_f64_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-        Matrix_nodata_creat_f64(matrix_result, upper_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_vAllocate_f64(matrix_result, upper_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f64(upper_tri_A) && Matrix_bMatrixIsValid_f64(matrix_B) &&
         Matrix_bMatrixIsValid_f64(matrix_result)) {
@@ -1149,7 +1170,7 @@ void Matrix_vBackSubtitution_f64(matrix_f64_t *upper_tri_A, matrix_f64_t *matrix
 
 void Matrix_vForwardSubtitution_f32(matrix_f32_t *lower_tri_A, matrix_f32_t *matrix_B, matrix_f32_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f32(matrix_result)) {
-        Matrix_nodata_creat_f32(matrix_result, lower_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_vAllocate_f32(matrix_result, lower_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f32(lower_tri_A) && Matrix_bMatrixIsValid_f32(matrix_B) &&
         Matrix_bMatrixIsValid_f32(matrix_result)) {
@@ -1159,7 +1180,7 @@ void Matrix_vForwardSubtitution_f32(matrix_f32_t *lower_tri_A, matrix_f32_t *mat
 }
 void Matrix_vForwardSubtitution_f64(matrix_f64_t *lower_tri_A, matrix_f64_t *matrix_B, matrix_f64_t *matrix_result) {
     if (!Matrix_bMatrixIsValid_f64(matrix_result)) {
-        Matrix_nodata_creat_f64(matrix_result, lower_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
+        Matrix_vAllocate_f64(matrix_result, lower_tri_A->arm_matrix.numRows, 1, InitMatWithZero);
     }
     if (Matrix_bMatrixIsValid_f64(lower_tri_A) && Matrix_bMatrixIsValid_f64(matrix_B) &&
         Matrix_bMatrixIsValid_f64(matrix_result)) {
@@ -1234,47 +1255,33 @@ void Matrix_vRoundingsub_f64(matrix_f64_t *matrix_op, const float64_t _val, bool
 }
 
 void Matrix_vCopy_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f32(matrix_op)) {
-        if (Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_vSetMatrixInvalid_f32(matrix_result);
-            Matrix_data_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                  matrix_op->arm_matrix.pData, NoInitMatZero);
-        } else {
-            Matrix_data_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                  matrix_op->arm_matrix.pData, NoInitMatZero);
+    if (Matrix_bMatrixIsValid_f32(matrix_op) && (matrix_result != matrix_op)) {
+        Matrix_vReshape_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols, NoInitMatZero);
+        if (matrix_result->is_valid) {
+            memcpy(matrix_result->arm_matrix.pData, matrix_op->arm_matrix.pData,
+                   sizeof(float32_t) * matrix_op->arm_matrix.numRows * matrix_op->arm_matrix.numCols);
         }
     }
 }
 void Matrix_vCopy_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f64(matrix_op)) {
-        if (Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_vSetMatrixInvalid_f64(matrix_result);
-            Matrix_data_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                  matrix_op->arm_matrix.pData, NoInitMatZero);
-        } else {
-            Matrix_data_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                                  matrix_op->arm_matrix.pData, NoInitMatZero);
+    if (Matrix_bMatrixIsValid_f64(matrix_op) && (matrix_result != matrix_op)) {
+        Matrix_vReshape_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols, NoInitMatZero);
+        if (matrix_result->is_valid) {
+            memcpy(matrix_result->arm_matrix.pData, matrix_op->arm_matrix.pData,
+                   sizeof(float64_t) * matrix_op->arm_matrix.numRows * matrix_op->arm_matrix.numCols);
         }
     }
 }
 
 void Matrix_vMove_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f32(matrix_op)) {
-        if (Matrix_bMatrixIsValid_f32(matrix_result)) {
-            Matrix_vSetMatrixInvalid_f32(matrix_result);
-        }
-        Matrix_data_creat_f32(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                              matrix_op->arm_matrix.pData, NoInitMatZero);
+    if (Matrix_bMatrixIsValid_f32(matrix_op) && (matrix_result != matrix_op)) {
+        Matrix_vCopy_f32(matrix_op, matrix_result);
         Matrix_vSetMatrixInvalid_f32(matrix_op);
     }
 }
 void Matrix_vMove_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result) {
-    if (Matrix_bMatrixIsValid_f64(matrix_op)) {
-        if (Matrix_bMatrixIsValid_f64(matrix_result)) {
-            Matrix_vSetMatrixInvalid_f64(matrix_result);
-        }
-        Matrix_data_creat_f64(matrix_result, matrix_op->arm_matrix.numRows, matrix_op->arm_matrix.numCols,
-                              matrix_op->arm_matrix.pData, NoInitMatZero);
+    if (Matrix_bMatrixIsValid_f64(matrix_op) && (matrix_result != matrix_op)) {
+        Matrix_vCopy_f64(matrix_op, matrix_result);
         Matrix_vSetMatrixInvalid_f64(matrix_op);
     }
 }
@@ -1359,11 +1366,22 @@ void Matrix_vinit_f32(matrix_f32_t *matrix_op) {
     matrix_op->is_valid = false;
     matrix_op->arm_matrix.pData = NULL;
     matrix_op->p2Data = NULL;
+    matrix_op->buffer = NULL;
 }
 void Matrix_vinit_f64(matrix_f64_t *matrix_op) {
     matrix_op->is_valid = false;
     matrix_op->arm_matrix.pData = NULL;
     matrix_op->p2Data = NULL;
+    matrix_op->buffer = NULL;
+}
+
+void Matrix_vinit_static_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer) {
+    Matrix_vinit_f32(matrix_op);
+    matrix_op->buffer = buffer;
+}
+void Matrix_vinit_static_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer) {
+    Matrix_vinit_f64(matrix_op);
+    matrix_op->buffer = buffer;
 }
 
 
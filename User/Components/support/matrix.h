@@ -38,16 +38,32 @@ typedef enum {
     Linear_2D,
 } PrintWay;
 
+/* Fixed-capacity backing store, lets a matrix live in static/stack/struct memory instead of the FreeRTOS heap */
+typedef struct {
+    float32_t *p2Data[MATRIX_MAXIMUM_SIZE];
+    float32_t data[MATRIX_MAXIMUM_SIZE * MATRIX_MAXIMUM_SIZE];
+} matrix_buffer_f32_t;
+
+typedef struct {
+    float64_t *p2Data[MATRIX_MAXIMUM_SIZE];
+    float64_t data[MATRIX_MAXIMUM_SIZE * MATRIX_MAXIMUM_SIZE];
+} matrix_buffer_f64_t;
+
+/* Scratch buffers Matrix_bQRDec needs: Qn, the row temporary and the Householder vector */
+#define MATRIX_QR_SCRATCH_NUM   (3)
+
 typedef struct {
     arm_matrix_instance_f32 arm_matrix;
     float32_t **p2Data;
     bool is_valid;
+    matrix_buffer_f32_t *buffer;    /* NULL: heap backed, else every (re)creation reuses this buffer */
 } matrix_f32_t;
 
 typedef struct {
     arm_matrix_instance_f64 arm_matrix;
     float64_t **p2Data;
     bool is_valid;
+    matrix_buffer_f64_t *buffer;    /* NULL: heap backed, else every (re)creation reuses this buffer */
 } matrix_f64_t;
 
 extern void
@@ -65,6 +81,29 @@ extern void
 Matrix_data_creat_f64(matrix_f64_t *matrix_op, const uint16_t _i16row, const uint16_t _i16col, float64_t *initData,
                       InitZero _init);
 
+/**
+  * @brief          create a matrix on a fixed-capacity buffer, it and every later result written into it never touch
+  *                 the heap. rows and cols must not exceed MATRIX_MAXIMUM_SIZE, otherwise the matrix is left invalid.
+  * @param[out]     matrix_op:矩阵指针
+  * @param[in]      buffer:backing store, must outlive the matrix
+  * @retval         none
+  */
+extern void
+Matrix_static_nodata_creat_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer, const uint16_t _i16row,
+                               const uint16_t _i16col, InitZero _init);
+
+extern void
+Matrix_static_nodata_creat_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer, const uint16_t _i16row,
+                               const uint16_t _i16col, InitZero _init);
+
+extern void
+Matrix_static_data_creat_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer, const uint16_t _i16row,
+                             const uint16_t _i16col, float32_t *initData, InitZero _init);
+
+extern void
+Matrix_static_data_creat_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer, const uint16_t _i16row,
+                             const uint16_t _i16col, float64_t *initData, InitZero _init);
+
 extern void Matrix_vSetHomogen_f32(matrix_f32_t *matrix_op, const float32_t _val);
 
 extern void Matrix_vSetHomogen_f64(matrix_f64_t *matrix_op, const float64_t _val);
@@ -247,7 +286,8 @@ extern bool Matrix_bNormVector_f32(matrix_f32_t *matrix_op);
 
 extern bool Matrix_bNormVector_f64(matrix_f64_t *matrix_op);
 
-/* Invers operation using Gauss-Jordan algorithm */
+/* Invers operation using Gauss-Jordan algorithm.
+ * CAUTION! arm_mat_inverse overwrites matrix_op, the result is invalid if matrix_op is singular */
 extern void Matrix_vInverse_nsame_f32(matrix_f32_t *matrix_op, matrix_f32_t *matrix_result);
 
 extern void Matrix_vInverse_nsame_f64(matrix_f64_t *matrix_op, matrix_f64_t *matrix_result);
@@ -255,10 +295,13 @@ extern void Matrix_vInverse_nsame_f64(matrix_f64_t *matrix_op, matrix_f64_t *mat
 /* Use elemtary row operation to reduce the matrix into upper triangular form (like in the first phase of gauss-jordan algorithm).
  *
  * Useful if we want to check the matrix as positive definite or not (can be used before calling CholeskyDec function).
+ * scratch holds the reduced copy of matrix_op, supplied by the caller so the buffer never lands on a task stack.
  */
-extern bool Matrix_bMatrixIsPositiveDefinite_f32(matrix_f32_t *matrix_op, bool checkPosSemidefinite);
+extern bool Matrix_bMatrixIsPositiveDefinite_f32(matrix_f32_t *matrix_op, bool checkPosSemidefinite,
+                                                 matrix_buffer_f32_t *scratch);
 
-extern bool Matrix_bMatrixIsPositiveDefinite_f64(matrix_f64_t *matrix_op, bool checkPosSemidefinite);
+extern bool Matrix_bMatrixIsPositiveDefinite_f64(matrix_f64_t *matrix_op, bool checkPosSemidefinite,
+                                                 matrix_buffer_f64_t *scratch);
 
 /* For square matrix 'this' with size MxM, return vector Mx1 with entries corresponding with diagonal entries of 'this'.
  *  Example:    this = [a11 a12 a13]
@@ -293,14 +336,15 @@ extern void Matrix_vCholeskyDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *matri
 
 /* Do the Householder Transformation for QR Decomposition operation.
  *              out = HouseholderTransformQR(A, i, j)
+ * scratch holds the Householder vector, supplied by the caller.
  */
 extern void
 Matrix_vHouseholderTransformQR_f32(matrix_f32_t *matrix_op, const uint16_t _rowTransform, const uint16_t _columnTransform,
-                                   matrix_f32_t *matrix_result);
+                                   matrix_f32_t *matrix_result, matrix_buffer_f32_t *scratch);
 
 extern void
 Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowTransform, const uint16_t _columnTransform,
-                                   matrix_f64_t *matrix_result);
+                                   matrix_f64_t *matrix_result, matrix_buffer_f64_t *scratch);
 
 /* Do the QR Decomposition for matrix using Householder Transformation.
  *                      A = Q*R
@@ -313,10 +357,15 @@ Matrix_vHouseholderTransformQR_f64(matrix_f64_t *matrix_op, const uint16_t _rowT
  *                      Ax = b
  *                   (QR)x = b
  *                      Rx = Q'b    --> Afterward use back-subtitution to solve x
+ *
+ * scratch[MATRIX_QR_SCRATCH_NUM] holds the temporaries, supplied by the caller (a static or a struct member, like
+ *  UKF_t.temp_buffer) so a ~2 KB (f32) / ~4 KB (f64) block never lands on a task stack.
  */
-extern bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *R);
+extern bool Matrix_bQRDec_f32(matrix_f32_t *matrix_op, matrix_f32_t *Qt, matrix_f32_t *R,
+                              matrix_buffer_f32_t scratch[MATRIX_QR_SCRATCH_NUM]);
 
-extern bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *R);
+extern bool Matrix_bQRDec_f64(matrix_f64_t *matrix_op, matrix_f64_t *Qt, matrix_f64_t *R,
+                              matrix_buffer_f64_t scratch[MATRIX_QR_SCRATCH_NUM]);
 
 /* Do the back-subtitution opeartion for upper triangular matrix A & column matrix B to solve x:
  *                      Ax = B
@@ -377,6 +426,17 @@ extern void Matrix_vinit_f32(matrix_f32_t *matrix_op);
 
 extern void Matrix_vinit_f64(matrix_f64_t *matrix_op);
 
+/**
+  * @brief          init an empty matrix bound to a fixed-capacity buffer, use it for temporaries / results of the
+  *                 Matrix_v* operations so that they are shaped inside the buffer instead of allocated.
+  * @param[out]     matrix_op:矩阵指针
+  * @param[in]      buffer:backing store, must outlive the matrix
+  * @retval         none
+  */
+extern void Matrix_vinit_static_f32(matrix_f32_t *matrix_op, matrix_buffer_f32_t *buffer);
+
+extern void Matrix_vinit_static_f64(matrix_f64_t *matrix_op, matrix_buffer_f64_t *buffer);
+
 /* self add arm matrix calculation for the future replacement*/
 arm_status arm_mat_add_f64(
         const arm_matrix_instance_f64 *pSrcA,
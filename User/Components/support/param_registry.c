@@ -0,0 +1,363 @@
+/**
+  * @file       param_registry.c/h
+  * @brief      typed parameter registry for live tuning.
+  *             在线调参的类型化参数表
+  * @note       staging and applying are done with interrupts disabled, the
+  *             owning loop copies all pending values of its parameters in one
+  *             critical section, so a batch is never seen half applied.
+  *             暂存和生效都在关中断下进行,所属循环在同一个临界区内写入全部暂存值,
+  *             不会看到只生效了一半的批次
+  */
+#include "param_registry.h"
+#include "CRC8_CRC16.h"
+#include "macro_mutex.h"
+#include <string.h>
+#include <math.h>
+
+#define PARAM_INFO_REPLY_LEN    (17U + PARAM_NAME_LEN)
+#define PARAM_VALUE_SIZE        4U
+#define PARAM_SIGNATURE_SEED    2166136261U     //FNV-1a
+#define PARAM_SIGNATURE_PRIME   16777619U
+
+const frame_protocol_t param_frame_protocol = {
+        .sof = PARAM_FRAME_SOF,
+        .header_len = PARAM_FRAME_HEAD_SIZE,
+        .len_offset = 1,
+        .len_size = 2,
+        .header_crc8 = 1,
+        .cmd_id_size = PARAM_FRAME_CMD_SIZE,
+        .max_frame_len = PARAM_FRAME_MAX_LEN,
+};
+
+static param_value_t param_read(const param_entry_t *p_entry) {
+    param_value_t value;
+
+    switch (p_entry->type) {
+        case PARAM_FLOAT:
+            value.f = *(volatile float32_t *) p_entry->p_addr;
+            break;
+        case PARAM_INT32:
+            value.i = *(volatile int32_t *) p_entry->p_addr;
+            break;
+        case PARAM_UINT32:
+            value.u = *(volatile uint32_t *) p_entry->p_addr;
+            break;
+        case PARAM_INT16:
+            value.i = *(volatile int16_t *) p_entry->p_addr;
+            break;
+        case PARAM_UINT16:
+            value.i = *(volatile uint16_t *) p_entry->p_addr;
+            break;
+        case PARAM_UINT8:
+            value.i = *(volatile uint8_t *) p_entry->p_addr;
+            break;
+        default:
+            value.i = *(volatile bool *) p_entry->p_addr ? 1 : 0;
+            break;
+    }
+    return value;
+}
+
+static void param_write(const param_entry_t *p_entry, param_value_t value) {
+    switch (p_entry->type) {
+        case PARAM_FLOAT:
+            *(volatile float32_t *) p_entry->p_addr = value.f;
+            break;
+        case PARAM_INT32:
+            *(volatile int32_t *) p_entry->p_addr = value.i;
+            break;
+        case PARAM_UINT32:
+            *(volatile uint32_t *) p_entry->p_addr = value.u;
+            break;
+        case PARAM_INT16:
+            *(volatile int16_t *) p_entry->p_addr = (int16_t) value.i;
+            break;
+        case PARAM_UINT16:
+            *(volatile uint16_t *) p_entry->p_addr = (uint16_t) value.i;
+            break;
+        case PARAM_UINT8:
+            *(volatile uint8_t *) p_entry->p_addr = (uint8_t) value.i;
+            break;
+        default:
+            *(volatile bool *) p_entry->p_addr = (value.i != 0);
+            break;
+    }
+}
+
+/**
+  * @brief          检查参数值是否在范围内,浮点数NaN视为超出范围
+  */
+static bool_t param_in_range(const param_entry_t *p_entry, param_value_t value) {
+    float32_t check;
+
+    if (p_entry->type == PARAM_FLOAT) {
+        check = value.f;
+    } else if (p_entry->type == PARAM_UINT32) {
+        check = (float32_t) value.u;
+    } else {
+        check = (float32_t) value.i;
+    }
+    return (check >= p_entry->min && check <= p_entry->max);
+}
+
+int param_registry_add(param_registry_t *p_reg, const char *name, volatile void *p_addr, param_type_e type,
+                       uint8_t owner, float32_t min, float32_t max) {
+    MUTEX_DECLARE(mutex);
+    param_entry_t *p_entry;
+    int id = -1;
+
+    if (p_addr == NULL || type >= PARAM_TYPE_NUM || !(min <= max) ||
+        (owner >= PARAM_OWNER_MAX_NUM && owner != PARAM_OWNER_NONE)) {
+        return -1;
+    }
+    if (type == PARAM_BOOL) {
+        min = 0.0f;
+        max = 1.0f;
+    }
+    MUTEX_LOCK(mutex);
+    if (p_reg->num < PARAM_REGISTRY_MAX_NUM) {
+        id = p_reg->num;
+        p_entry = &p_reg->entry[id];
+        memset(p_entry->name, 0, PARAM_NAME_LEN);
+        strncpy(p_entry->name, name, PARAM_NAME_LEN - 1);
+        p_entry->p_addr = p_addr;
+        p_entry->type = (uint8_t) type;
+        p_entry->owner = owner;
+        p_entry->min = min;
+        p_entry->max = max;
+        p_reg->pending[id] = 0;
+        p_reg->num++;
+    }
+    MUTEX_UNLOCK(mutex);
+    return id;
+}
+
+int param_registry_find(const param_registry_t *p_reg, const char *name) {
+    uint8_t i;
+
+    for (i = 0; i < p_reg->num; i++) {
+        if (strncmp(p_reg->entry[i].name, name, PARAM_NAME_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int param_registry_get(const param_registry_t *p_reg, uint8_t id, param_value_t *p_value) {
+    if (id >= p_reg->num) {
+        return -1;
+    }
+    *p_value = param_read(&p_reg->entry[id]);
+    return 0;
+}
+
+int param_registry_from_float(const param_registry_t *p_reg, uint8_t id, float32_t value, param_value_t *p_value) {
+    uint8_t type;
+
+    if (id >= p_reg->num) {
+        return -1;
+    }
+    type = p_reg->entry[id].type;
+    if (type == PARAM_FLOAT) {
+        p_value->f = value;
+    } else if (type == PARAM_UINT32 && value >= 2147483648.0f) {
+        p_value->u = (uint32_t) lroundf(value);
+    } else {
+        p_value->i = (int32_t) lroundf(value);
+    }
+    return 0;
+}
+
+uint8_t param_registry_stage(param_registry_t *p_reg, const uint8_t *p_id, const param_value_t *p_value,
+                             uint8_t num, uint8_t *p_bad_index) {
+    MUTEX_DECLARE(mutex);
+    const param_entry_t *p_entry;
+    uint8_t status = PARAM_OK;
+    uint8_t i;
+
+    //先检查整批,任何一个出错都不暂存
+    for (i = 0; i < num; i++) {
+        if (p_id[i] >= p_reg->num) {
+            status = PARAM_ERR_ID;
+            break;
+        }
+        if (!param_in_range(&p_reg->entry[p_id[i]], p_value[i])) {
+            status = PARAM_ERR_RANGE;
+            break;
+        }
+    }
+    if (p_bad_index != NULL) {
+        *p_bad_index = i;
+    }
+    if (status != PARAM_OK) {
+        p_reg->reject_cnt++;
+        return status;
+    }
+
+    MUTEX_LOCK(mutex);
+    for (i = 0; i < num; i++) {
+        p_entry = &p_reg->entry[p_id[i]];
+        if (p_entry->owner == PARAM_OWNER_NONE) {
+            param_write(p_entry, p_value[i]);
+            continue;
+        }
+        p_reg->staged[p_id[i]] = p_value[i];
+        p_reg->pending[p_id[i]] = 1;
+        p_reg->owner_pending[p_entry->owner] = 1;
+    }
+    p_reg->batch_cnt++;
+    MUTEX_UNLOCK(mutex);
+    return PARAM_OK;
+}
+
+uint8_t param_registry_apply(param_registry_t *p_reg, uint8_t owner) {
+    MUTEX_DECLARE(mutex);
+    uint8_t apply_num = 0;
+    uint8_t i;
+
+    if (owner >= PARAM_OWNER_MAX_NUM || !p_reg->owner_pending[owner]) {
+        return 0;
+    }
+    MUTEX_LOCK(mutex);
+    for (i = 0; i < p_reg->num; i++) {
+        if (p_reg->pending[i] && p_reg->entry[i].owner == owner) {
+            param_write(&p_reg->entry[i], p_reg->staged[i]);
+            p_reg->pending[i] = 0;
+            apply_num++;
+        }
+    }
+    p_reg->owner_pending[owner] = 0;
+    p_reg->apply_cnt[owner]++;
+    MUTEX_UNLOCK(mutex);
+    return apply_num;
+}
+
+uint32_t param_registry_signature(const param_registry_t *p_reg) {
+    uint32_t hash = PARAM_SIGNATURE_SEED;
+    const param_entry_t *p_entry;
+    uint8_t i, j;
+
+    for (i = 0; i < p_reg->num; i++) {
+        p_entry = &p_reg->entry[i];
+        for (j = 0; j < PARAM_NAME_LEN && p_entry->name[j] != '\0'; j++) {
+            hash = (hash ^ (uint8_t) p_entry->name[j]) * PARAM_SIGNATURE_PRIME;
+        }
+        hash = (hash ^ p_entry->type) * PARAM_SIGNATURE_PRIME;
+        hash = (hash ^ p_entry->owner) * PARAM_SIGNATURE_PRIME;
+    }
+    return hash;
+}
+
+uint8_t param_registry_export(const param_registry_t *p_reg, uint32_t *p_buf) {
+    MUTEX_DECLARE(mutex);
+    param_value_t value;
+    uint8_t i;
+
+    p_buf[0] = param_registry_signature(p_reg);
+    p_buf[1] = p_reg->num;
+    for (i = 0; i < p_reg->num; i++) {
+        MUTEX_LOCK(mutex);
+        value = p_reg->pending[i] ? p_reg->staged[i] : param_read(&p_reg->entry[i]);
+        MUTEX_UNLOCK(mutex);
+        p_buf[2 + i] = value.u;
+    }
+    return (uint8_t) PARAM_SET_WORD_NUM(p_reg->num);
+}
+
+uint8_t param_registry_import(param_registry_t *p_reg, const uint32_t *p_buf, uint8_t len) {
+    uint8_t id[PARAM_REGISTRY_MAX_NUM];
+    uint8_t i;
+
+    if (len != PARAM_SET_WORD_NUM(p_reg->num) || p_buf[1] != p_reg->num) {
+        return PARAM_ERR_LEN;
+    }
+    if (p_buf[0] != param_registry_signature(p_reg)) {
+        return PARAM_ERR_SIGNATURE;
+    }
+    for (i = 0; i < p_reg->num; i++) {
+        id[i] = i;
+    }
+    return param_registry_stage(p_reg, id, (const param_value_t *) &p_buf[2], p_reg->num, NULL);
+}
+
+int param_registry_handle(param_registry_t *p_reg, uint16_t cmd_id, const uint8_t *p_data, uint16_t len,
+                          uint8_t *p_reply) {
+    uint8_t id[PARAM_BATCH_MAX_NUM];
+    param_value_t value[PARAM_BATCH_MAX_NUM];
+    const param_entry_t *p_entry;
+    uint8_t num, i;
+
+    switch (cmd_id) {
+        case PARAM_CMD_INFO:
+            if (len != 1U) {
+                p_reply[0] = PARAM_ERR_LEN;
+                return 1;
+            }
+            //编号超出时仍返回参数数量,上位机据此遍历参数表
+            p_reply[0] = (p_data[0] < p_reg->num) ? PARAM_OK : PARAM_ERR_ID;
+            p_reply[1] = p_reg->num;
+            p_reply[2] = p_data[0];
+            if (p_data[0] >= p_reg->num) {
+                return 3;
+            }
+            p_entry = &p_reg->entry[p_data[0]];
+            value[0] = param_read(p_entry);
+            p_reply[3] = p_entry->type;
+            p_reply[4] = p_entry->owner;
+            memcpy(&p_reply[5], &p_entry->min, 4);
+            memcpy(&p_reply[9], &p_entry->max, 4);
+            memcpy(&p_reply[13], &value[0], 4);
+            memcpy(&p_reply[17], p_entry->name, PARAM_NAME_LEN);
+            return PARAM_INFO_REPLY_LEN;
+        case PARAM_CMD_GET:
+            if (len == 0U || len > PARAM_BATCH_MAX_NUM) {
+                p_reply[0] = PARAM_ERR_LEN;
+                return 1;
+            }
+            for (i = 0; i < len; i++) {
+                if (p_data[i] >= p_reg->num) {
+                    p_reply[0] = PARAM_ERR_ID;
+                    p_reply[1] = i;
+                    return 2;
+                }
+            }
+            p_reply[0] = PARAM_OK;
+            p_reply[1] = (uint8_t) len;
+            for (i = 0; i < len; i++) {
+                value[0] = param_read(&p_reg->entry[p_data[i]]);
+                p_reply[2 + i * 5] = p_data[i];
+                memcpy(&p_reply[3 + i * 5], &value[0], 4);
+            }
+            return 2 + len * 5;
+        case PARAM_CMD_SET:
+            num = (uint8_t) (len / (1U + PARAM_VALUE_SIZE));
+            if (num == 0U || num > PARAM_BATCH_MAX_NUM || len != num * (1U + PARAM_VALUE_SIZE)) {
+                p_reply[0] = PARAM_ERR_LEN;
+                p_reply[1] = 0;
+                return 2;
+            }
+            for (i = 0; i < num; i++) {
+                id[i] = p_data[i * 5];
+                memcpy(&value[i], &p_data[i * 5 + 1], 4);
+            }
+            p_reply[0] = param_registry_stage(p_reg, id, value, num, &p_reply[1]);
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+uint16_t param_frame_pack(uint8_t *p_frame, uint16_t cmd_id, uint8_t seq, const uint8_t *p_data, uint16_t len) {
+    uint16_t frame_len = PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE + len + 2U;
+
+    p_frame[0] = PARAM_FRAME_SOF;
+    p_frame[1] = (uint8_t) len;
+    p_frame[2] = (uint8_t) (len >> 8);
+    p_frame[3] = seq;
+    append_CRC8_check_sum(p_frame, PARAM_FRAME_HEAD_SIZE);
+    p_frame[5] = (uint8_t) cmd_id;
+    p_frame[6] = (uint8_t) (cmd_id >> 8);
+    memcpy(&p_frame[PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE], p_data, len);
+    append_CRC16_check_sum(p_frame, frame_len);
+    return frame_len;
+}
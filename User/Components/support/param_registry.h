@@ -0,0 +1,236 @@
+/**
+  * @file       param_registry.c/h
+  * @brief      typed parameter registry for live tuning. Every parameter is
+  *             registered once with name, address, type, range and the control
+  *             loop that owns it. A set request is range checked as a whole and
+  *             staged, the owning loop applies all staged values of a batch at
+  *             once at the start of its cycle, so a loop never runs with half of
+  *             a gain set.
+  *             在线调参的类型化参数表:每个参数注册一次名字、地址、类型、范围和所属控制循环.
+  *             一次设置请求整体检查范围后暂存,所属循环在周期开始时一次性使用同一批的全部
+  *             暂存值,控制循环不会在只改了一半参数的情况下运行
+  * @note       frame: SOF(0xA7) len(u16) seq CRC8 cmd_id(u16) data CRC16, little
+  *             endian, same layout and CRC as the referee protocol, parsed by
+  *             frame_parser. A reply has cmd_id | PARAM_REPLY_FLAG and the seq of
+  *             the request, the first data byte is param_status_e.
+  *             A value is 4 bytes on the wire: float bits, or the integer value
+  *             sign extended to 32 bits. Host tool: Matlab/param_tool.py
+  *             帧格式与裁判系统相同,SOF为0xA7,由frame_parser解析.应答的cmd_id为请求的
+  *             cmd_id | PARAM_REPLY_FLAG,序号与请求相同,数据第一个字节为param_status_e.
+  *             参数值在帧中固定4字节:浮点数的位或扩展到32位的整数
+  */
+#ifndef PARAM_REGISTRY_H
+#define PARAM_REGISTRY_H
+
+#include "struct_typedef.h"
+#include "frame_parser.h"
+
+#define PARAM_REGISTRY_MAX_NUM      60          //参数最大数量,保存的参数组须能放进一条flash记录
+#define PARAM_NAME_LEN              16          //参数名长度,含结束符
+#define PARAM_OWNER_MAX_NUM         4           //所属循环最大数量
+#define PARAM_OWNER_NONE            0xFFU       //不属于任何循环,设置后立即生效
+#define PARAM_SET_WORD_NUM(num)     ((num) + 2U)    //保存的参数组长度,单位字: 签名 数量 参数值
+
+#define PARAM_FRAME_SOF             0xA7
+#define PARAM_FRAME_HEAD_SIZE       5           //SOF len(u16) seq CRC8
+#define PARAM_FRAME_CMD_SIZE        2
+#define PARAM_FRAME_MAX_DATA        128
+#define PARAM_FRAME_MAX_LEN         (PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE + PARAM_FRAME_MAX_DATA + 2)
+#define PARAM_BATCH_MAX_NUM         24          //一帧读写的最大参数数量
+#define PARAM_REPLY_FLAG            0x8000U
+
+typedef enum {
+    PARAM_FLOAT = 0,
+    PARAM_INT32,
+    PARAM_UINT32,
+    PARAM_INT16,
+    PARAM_UINT16,
+    PARAM_UINT8,
+    PARAM_BOOL,                                 //bool,写入时非0为true
+    PARAM_TYPE_NUM,
+} param_type_e;
+
+typedef enum {
+    //data: id(u8)
+    //reply: status num id type owner min(f32) max(f32) value name[PARAM_NAME_LEN]
+    PARAM_CMD_INFO = 0x0101,
+    //data: id(u8)*n, reply: status n {id value}*n
+    PARAM_CMD_GET = 0x0102,
+    //data: {id(u8) value}*n, 整批暂存或整批拒绝, reply: status 出错的序号
+    PARAM_CMD_SET = 0x0103,
+    //data: set(u8), reply: status set, 由应用层处理
+    PARAM_CMD_SAVE = 0x0104,
+    PARAM_CMD_LOAD = 0x0105,
+} param_cmd_e;
+
+typedef enum {
+    PARAM_OK = 0,
+    PARAM_ERR_ID,                               //参数或参数组编号不存在
+    PARAM_ERR_RANGE,                            //超出范围
+    PARAM_ERR_LEN,                              //数据长度错误
+    PARAM_ERR_CMD,                              //未知命令
+    PARAM_ERR_BUSY,                             //上一次保存或读取尚未完成
+    PARAM_ERR_STORE,                            //flash读写失败或没有保存的参数组
+    PARAM_ERR_SIGNATURE,                        //保存的参数组与当前参数表不一致
+} param_status_e;
+
+typedef union {
+    float32_t f;
+    int32_t i;
+    uint32_t u;
+} param_value_t;
+
+typedef struct {
+    char name[PARAM_NAME_LEN];
+    volatile void *p_addr;
+    uint8_t type;                               //param_type_e
+    uint8_t owner;                              //所属循环,PARAM_OWNER_NONE为立即生效
+    float32_t min;
+    float32_t max;
+} param_entry_t;
+
+typedef struct {
+    param_entry_t entry[PARAM_REGISTRY_MAX_NUM];
+    param_value_t staged[PARAM_REGISTRY_MAX_NUM];
+    volatile uint8_t pending[PARAM_REGISTRY_MAX_NUM];       //有等待生效的暂存值
+    volatile uint8_t owner_pending[PARAM_OWNER_MAX_NUM];    //该循环有等待生效的暂存值
+    uint8_t num;
+    //统计(调试时使用)
+    uint32_t batch_cnt;                         //已暂存的批次数
+    uint32_t reject_cnt;                        //被拒绝的批次数
+    uint32_t apply_cnt[PARAM_OWNER_MAX_NUM];    //每个循环生效的次数
+} param_registry_t;
+
+extern const frame_protocol_t param_frame_protocol;
+
+/**
+  * @brief          register a parameter, can be called while the loops are running
+  * @param[in]      name: name, truncated to PARAM_NAME_LEN - 1
+  * @param[in]      p_addr: address, aligned to the type
+  * @param[in]      type: param_type_e
+  * @param[in]      owner: owning loop, below PARAM_OWNER_MAX_NUM, or PARAM_OWNER_NONE
+  * @param[in]      min: min value
+  * @param[in]      max: max value
+  * @retval         id, -1: registry full or bad argument
+  */
+/**
+  * @brief          注册参数,控制循环运行时也可以调用
+  * @param[in]      name: 参数名,超出PARAM_NAME_LEN - 1截断
+  * @param[in]      p_addr: 参数地址,需按类型对齐
+  * @param[in]      type: param_type_e
+  * @param[in]      owner: 所属循环,小于PARAM_OWNER_MAX_NUM,或PARAM_OWNER_NONE
+  * @param[in]      min: 最小值
+  * @param[in]      max: 最大值
+  * @retval         参数编号, -1:参数表已满或参数错误
+  */
+extern int param_registry_add(param_registry_t *p_reg, const char *name, volatile void *p_addr, param_type_e type,
+                              uint8_t owner, float32_t min, float32_t max);
+
+/**
+  * @brief          按名字查找参数
+  * @retval         参数编号, -1:不存在
+  */
+extern int param_registry_find(const param_registry_t *p_reg, const char *name);
+
+/**
+  * @brief          读取参数当前值
+  * @retval         0:成功, -1:编号不存在
+  */
+extern int param_registry_get(const param_registry_t *p_reg, uint8_t id, param_value_t *p_value);
+
+/**
+  * @brief          把浮点数转换为参数类型的值,整数类型四舍五入,用于文本命令
+  * @retval         0:成功, -1:编号不存在
+  */
+extern int param_registry_from_float(const param_registry_t *p_reg, uint8_t id, float32_t value,
+                                     param_value_t *p_value);
+
+/**
+  * @brief          check a batch and stage it as a whole, values of loop owned
+  *                 parameters take effect at the next param_registry_apply of
+  *                 their loop, the others at once. A parameter staged again
+  *                 before it is applied keeps the newest value.
+  * @param[in]      p_id: parameter ids
+  * @param[in]      p_value: values
+  * @param[in]      num: batch size
+  * @param[out]     p_bad_index: index of the first rejected entry, can be NULL
+  * @retval         param_status_e, nothing is staged unless PARAM_OK
+  */
+/**
+  * @brief          检查一批参数并整批暂存,属于控制循环的参数在该循环下一次调用
+  *                 param_registry_apply时生效,其余参数立即生效.生效前再次设置的参数
+  *                 使用最新的值
+  * @param[in]      p_id: 参数编号
+  * @param[in]      p_value: 参数值
+  * @param[in]      num: 参数数量
+  * @param[out]     p_bad_index: 第一个被拒绝的参数的序号,可以为NULL
+  * @retval         param_status_e, 不为PARAM_OK时不暂存任何参数
+  */
+extern uint8_t param_registry_stage(param_registry_t *p_reg, const uint8_t *p_id, const param_value_t *p_value,
+                                    uint8_t num, uint8_t *p_bad_index);
+
+/**
+  * @brief          apply the staged values of a loop, called by the loop at the
+  *                 start of its cycle
+  * @param[in]      owner: owning loop
+  * @retval         number of parameters written
+  */
+/**
+  * @brief          写入一个循环的暂存值,由该循环在周期开始时调用
+  * @param[in]      owner: 所属循环
+  * @retval         写入的参数数量
+  */
+extern uint8_t param_registry_apply(param_registry_t *p_reg, uint8_t owner);
+
+/**
+  * @brief          参数表签名,由参数名、类型和所属循环计算,参数表改变后保存的参数组失效
+  */
+extern uint32_t param_registry_signature(const param_registry_t *p_reg);
+
+/**
+  * @brief          export all values for the flash, staged values are taken when
+  *                 they are not applied yet
+  * @param[out]     p_buf: PARAM_SET_WORD_NUM(num) words
+  * @retval         length in words
+  */
+/**
+  * @brief          导出全部参数值用于保存,尚未生效的参数取暂存值
+  * @param[out]     p_buf: PARAM_SET_WORD_NUM(num)个字
+  * @retval         长度,单位字
+  */
+extern uint8_t param_registry_export(const param_registry_t *p_reg, uint32_t *p_buf);
+
+/**
+  * @brief          检查导出的参数组的签名并整批暂存
+  * @retval         param_status_e
+  */
+extern uint8_t param_registry_import(param_registry_t *p_reg, const uint32_t *p_buf, uint8_t len);
+
+/**
+  * @brief          handle INFO, GET and SET requests
+  * @param[in]      cmd_id: param_cmd_e
+  * @param[in]      p_data: request data
+  * @param[in]      len: request data length
+  * @param[out]     p_reply: reply data, PARAM_FRAME_MAX_DATA bytes
+  * @retval         reply data length, -1: not handled here
+  */
+/**
+  * @brief          处理INFO, GET和SET请求
+  * @param[in]      cmd_id: param_cmd_e
+  * @param[in]      p_data: 请求数据
+  * @param[in]      len: 请求数据长度
+  * @param[out]     p_reply: 应答数据, PARAM_FRAME_MAX_DATA字节
+  * @retval         应答数据长度, -1:不在此处理
+  */
+extern int param_registry_handle(param_registry_t *p_reg, uint16_t cmd_id, const uint8_t *p_data, uint16_t len,
+                                 uint8_t *p_reply);
+
+/**
+  * @brief          打包一帧
+  * @param[out]     p_frame: PARAM_FRAME_MAX_LEN字节
+  * @retval         帧长度
+  */
+extern uint16_t param_frame_pack(uint8_t *p_frame, uint16_t cmd_id, uint8_t seq, const uint8_t *p_data,
+                                 uint16_t len);
+
+#endif
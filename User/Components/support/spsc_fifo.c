@@ -0,0 +1,143 @@
+/**
+  * @file       spsc_fifo.c/h
+  * @brief      lock-free single-producer/single-consumer byte fifo.
+  *             无锁单生产者单消费者字节队列
+  * @note       head/tail are free-running counters, used = head - tail stays correct
+  *             across uint32 overflow because the size is a power of two. The
+  *             producer publishes head with release order after copying data in,
+  *             the consumer publishes tail with release order after copying data
+  *             out, so each side only needs acquire loads of the other index.
+  */
+#include "spsc_fifo.h"
+#include <string.h>
+#include <stddef.h>
+
+#define SPSC_LOAD_ACQUIRE(p)       __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(p, val) __atomic_store_n((p), (val), __ATOMIC_RELEASE)
+
+int spsc_fifo_init(spsc_fifo_t *p_fifo, uint8_t *p_buf, uint32_t size) {
+    if (p_fifo == NULL || p_buf == NULL || size == 0U || (size & (size - 1U)) != 0U) {
+        return -1;
+    }
+    p_fifo->p_buf = p_buf;
+    p_fifo->mask = size - 1U;
+    p_fifo->head = 0U;
+    p_fifo->tail = 0U;
+    return 0;
+}
+
+uint32_t spsc_fifo_used(const spsc_fifo_t *p_fifo) {
+    uint32_t tail = SPSC_LOAD_ACQUIRE(&p_fifo->tail);
+    return SPSC_LOAD_ACQUIRE(&p_fifo->head) - tail;
+}
+
+uint32_t spsc_fifo_free(const spsc_fifo_t *p_fifo) {
+    return p_fifo->mask + 1U - spsc_fifo_used(p_fifo);
+}
+
+int spsc_fifo_put(spsc_fifo_t *p_fifo, uint8_t element) {
+    uint32_t head = p_fifo->head;
+    if (head - SPSC_LOAD_ACQUIRE(&p_fifo->tail) > p_fifo->mask) {
+        return -1;
+    }
+    p_fifo->p_buf[head & p_fifo->mask] = element;
+    SPSC_STORE_RELEASE(&p_fifo->head, head + 1U);
+    return 0;
+}
+
+uint32_t spsc_fifo_puts(spsc_fifo_t *p_fifo, const uint8_t *p_source, uint32_t len) {
+    uint32_t head = p_fifo->head;
+    uint32_t free_num = p_fifo->mask + 1U - (head - SPSC_LOAD_ACQUIRE(&p_fifo->tail));
+    uint32_t offset, len_to_end;
+
+    if (p_source == NULL) {
+        return 0U;
+    }
+    if (len > free_num) {
+        len = free_num;
+    }
+    offset = head & p_fifo->mask;
+    len_to_end = p_fifo->mask + 1U - offset;
+    if (len_to_end >= len) {
+        memcpy(p_fifo->p_buf + offset, p_source, len);
+    } else {
+        memcpy(p_fifo->p_buf + offset, p_source, len_to_end);
+        memcpy(p_fifo->p_buf, p_source + len_to_end, len - len_to_end);
+    }
+    SPSC_STORE_RELEASE(&p_fifo->head, head + len);
+    return len;
+}
+
+uint8_t spsc_fifo_get(spsc_fifo_t *p_fifo) {
+    uint32_t tail = p_fifo->tail;
+    uint8_t element;
+    if (SPSC_LOAD_ACQUIRE(&p_fifo->head) == tail) {
+        return 0U;
+    }
+    element = p_fifo->p_buf[tail & p_fifo->mask];
+    SPSC_STORE_RELEASE(&p_fifo->tail, tail + 1U);
+    return element;
+}
+
+uint32_t spsc_fifo_gets(spsc_fifo_t *p_fifo, uint8_t *p_dest, uint32_t len) {
+    uint32_t tail = p_fifo->tail;
+    uint32_t used_num = SPSC_LOAD_ACQUIRE(&p_fifo->head) - tail;
+    uint32_t offset, len_to_end;
+
+    if (p_dest == NULL) {
+        return 0U;
+    }
+    if (len > used_num) {
+        len = used_num;
+    }
+    offset = tail & p_fifo->mask;
+    len_to_end = p_fifo->mask + 1U - offset;
+    if (len_to_end >= len) {
+        memcpy(p_dest, p_fifo->p_buf + offset, len);
+    } else {
+        memcpy(p_dest, p_fifo->p_buf + offset, len_to_end);
+        memcpy(p_dest + len_to_end, p_fifo->p_buf, len - len_to_end);
+    }
+    SPSC_STORE_RELEASE(&p_fifo->tail, tail + len);
+    return len;
+}
+
+uint8_t spsc_fifo_preread(const spsc_fifo_t *p_fifo, uint32_t offset) {
+    uint32_t tail = p_fifo->tail;
+    if (offset >= SPSC_LOAD_ACQUIRE(&p_fifo->head) - tail) {
+        return 0U;
+    }
+    return p_fifo->p_buf[(tail + offset) & p_fifo->mask];
+}
+
+uint32_t spsc_fifo_peek(const spsc_fifo_t *p_fifo, spsc_fifo_span_t *p_span) {
+    uint32_t tail = p_fifo->tail;
+    uint32_t used_num = SPSC_LOAD_ACQUIRE(&p_fifo->head) - tail;
+    uint32_t offset = tail & p_fifo->mask;
+    uint32_t len_to_end = p_fifo->mask + 1U - offset;
+
+    p_span->p_data[0] = p_fifo->p_buf + offset;
+    p_span->p_data[1] = p_fifo->p_buf;
+    if (len_to_end >= used_num) {
+        p_span->len[0] = used_num;
+        p_span->len[1] = 0U;
+    } else {
+        p_span->len[0] = len_to_end;
+        p_span->len[1] = used_num - len_to_end;
+    }
+    return used_num;
+}
+
+uint32_t spsc_fifo_discard(spsc_fifo_t *p_fifo, uint32_t len) {
+    uint32_t tail = p_fifo->tail;
+    uint32_t used_num = SPSC_LOAD_ACQUIRE(&p_fifo->head) - tail;
+    if (len > used_num) {
+        len = used_num;
+    }
+    SPSC_STORE_RELEASE(&p_fifo->tail, tail + len);
+    return len;
+}
+
+void spsc_fifo_flush(spsc_fifo_t *p_fifo) {
+    SPSC_STORE_RELEASE(&p_fifo->tail, SPSC_LOAD_ACQUIRE(&p_fifo->head));
+}
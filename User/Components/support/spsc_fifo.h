@@ -0,0 +1,108 @@
+/**
+  * @file       spsc_fifo.c/h
+  * @brief      lock-free single-producer/single-consumer byte fifo. head is only
+  *             written by the producer, tail only by the consumer, so neither side
+  *             has to disable interrupts. size must be a power of two.
+  *             无锁单生产者单消费者字节队列,head仅由生产者修改,tail仅由消费者修改,
+  *             两端均无需关中断.缓存长度必须为2的幂
+  * @note       put/puts are producer-side, get/gets/preread/peek/discard/flush are
+  *             consumer-side. used/free can be called by either side.
+  */
+#ifndef SPSC_FIFO_H
+#define SPSC_FIFO_H
+
+#include "struct_typedef.h"
+
+typedef struct {
+    uint8_t *p_buf;
+    uint32_t mask;          //缓存长度-1
+    volatile uint32_t head; //累计写入字节数,仅生产者修改
+    volatile uint32_t tail; //累计读出字节数,仅消费者修改
+} spsc_fifo_t;
+
+//队列中未读数据的连续内存片段,数据在缓存末尾回绕时分为两段
+typedef struct {
+    const uint8_t *p_data[2];
+    uint32_t len[2];
+} spsc_fifo_span_t;
+
+/**
+  * @brief          init the fifo on a user buffer
+  * @param[out]     p_fifo: fifo
+  * @param[in]      p_buf: buffer
+  * @param[in]      size: buffer size, must be a power of two
+  * @retval         0: ok, -1: size is not a power of two
+  */
+/**
+  * @brief          在用户缓存上初始化队列
+  * @param[out]     p_fifo: 队列
+  * @param[in]      p_buf: 缓存
+  * @param[in]      size: 缓存长度,必须为2的幂
+  * @retval         0:成功, -1:长度不是2的幂
+  */
+extern int spsc_fifo_init(spsc_fifo_t *p_fifo, uint8_t *p_buf, uint32_t size);
+
+/**
+  * @brief          队列中未读字节数
+  */
+extern uint32_t spsc_fifo_used(const spsc_fifo_t *p_fifo);
+
+/**
+  * @brief          队列剩余可写字节数
+  */
+extern uint32_t spsc_fifo_free(const spsc_fifo_t *p_fifo);
+
+/**
+  * @brief          写入一个字节(生产者)
+  * @retval         0:成功, -1:队列已满
+  */
+extern int spsc_fifo_put(spsc_fifo_t *p_fifo, uint8_t element);
+
+/**
+  * @brief          写入多个字节(生产者),空间不足时只写入能放下的部分
+  * @param[in]      p_source: 数据
+  * @param[in]      len: 数据长度
+  * @retval         实际写入的字节数
+  */
+extern uint32_t spsc_fifo_puts(spsc_fifo_t *p_fifo, const uint8_t *p_source, uint32_t len);
+
+/**
+  * @brief          读出一个字节(消费者)
+  * @retval         读出的字节,队列为空时返回0
+  */
+extern uint8_t spsc_fifo_get(spsc_fifo_t *p_fifo);
+
+/**
+  * @brief          读出多个字节(消费者)
+  * @param[out]     p_dest: 目标缓存
+  * @param[in]      len: 期望读出的长度
+  * @retval         实际读出的字节数
+  */
+extern uint32_t spsc_fifo_gets(spsc_fifo_t *p_fifo, uint8_t *p_dest, uint32_t len);
+
+/**
+  * @brief          预读第offset个未读字节,不移动读指针(消费者)
+  * @retval         该字节,offset超出未读数据时返回0
+  */
+extern uint8_t spsc_fifo_preread(const spsc_fifo_t *p_fifo, uint32_t offset);
+
+/**
+  * @brief          获取全部未读数据所在的内存片段,不拷贝不移动读指针(消费者),
+  *                 处理完后用spsc_fifo_discard释放
+  * @param[out]     p_span: 数据片段
+  * @retval         未读数据总长度
+  */
+extern uint32_t spsc_fifo_peek(const spsc_fifo_t *p_fifo, spsc_fifo_span_t *p_span);
+
+/**
+  * @brief          丢弃len个未读字节(消费者)
+  * @retval         实际丢弃的字节数
+  */
+extern uint32_t spsc_fifo_discard(spsc_fifo_t *p_fifo, uint32_t len);
+
+/**
+  * @brief          清空队列(消费者)
+  */
+extern void spsc_fifo_flush(spsc_fifo_t *p_fifo);
+
+#endif
@@ -0,0 +1,213 @@
+/**
+  * @file       telemetry.c/h
+  * @brief      binary telemetry stream.
+  *             二进制遥测数据流
+  * @note       one sample costs a copy of every registered value plus one CRC16
+  *             over the record, about the cost of formatting a single float as
+  *             text. Frames are packed into a double buffer and handed to the
+  *             transport in batches, when the transport stays busy and the
+  *             buffer is full new frames are dropped and counted. Only the
+  *             packing runs with interrupts masked, the transport is called
+  *             outside the critical section.
+  *             一次采样只有变量拷贝和一次CRC16,约等于格式化一个浮点数的开销.帧打包进
+  *             双缓存后批量交给发送端,发送端持续忙且缓存已满时丢弃新帧并计数.
+  *             只有打包时关中断,调用发送端时不在临界区内
+  */
+#include "telemetry.h"
+#include "CRC8_CRC16.h"
+#include "macro_mutex.h"
+#include <string.h>
+#include <stddef.h>
+
+static const uint8_t telemetry_type_size[] = {
+        [TELEMETRY_FLOAT] = 4,
+        [TELEMETRY_INT16] = 2,
+        [TELEMETRY_UINT32] = 4,
+};
+
+/**
+  * @brief          把当前缓存交给发送端,调用时不能持有临界区
+  * @note           发送端只读取前len字节,发送期间其他任务或中断打包的帧追加在其后,
+  *                 发送成功后移到另一个缓存
+  */
+static void telemetry_flush_batch(telemetry_t *p_tm) {
+    MUTEX_DECLARE(mutex);
+    uint16_t len, tail;
+    uint8_t index;
+    int result;
+
+    MUTEX_LOCK(mutex);
+    if (p_tm->flushing || p_tm->batch_len == 0U || p_tm->write == NULL) {
+        MUTEX_UNLOCK(mutex);
+        return;
+    }
+    p_tm->flushing = 1;
+    index = p_tm->batch_index;
+    len = p_tm->batch_len;
+    MUTEX_UNLOCK(mutex);
+
+    result = p_tm->write(p_tm->batch[index], len);
+
+    MUTEX_LOCK(mutex);
+    if (result == 0) {
+        tail = p_tm->batch_len - len;
+        memcpy(p_tm->batch[index ^ 1U], &p_tm->batch[index][len], tail);
+        p_tm->batch_index = index ^ 1U;
+        p_tm->batch_len = tail;
+    }
+    p_tm->flushing = 0;
+    MUTEX_UNLOCK(mutex);
+}
+
+static void telemetry_put_u16(uint8_t *p_buf, uint16_t value) {
+    p_buf[0] = (uint8_t) value;
+    p_buf[1] = (uint8_t) (value >> 8);
+}
+
+static void telemetry_put_u32(uint8_t *p_buf, uint32_t value) {
+    p_buf[0] = (uint8_t) value;
+    p_buf[1] = (uint8_t) (value >> 8);
+    p_buf[2] = (uint8_t) (value >> 16);
+    p_buf[3] = (uint8_t) (value >> 24);
+}
+
+/**
+  * @brief          在批量缓存中申请一帧,在临界区内调用
+  * @retval         帧起始地址,缓存已满时返回NULL
+  */
+static uint8_t *telemetry_frame_begin(telemetry_t *p_tm, uint8_t type, uint16_t payload_len) {
+    uint16_t frame_len = TELEMETRY_FRAME_HEAD_SIZE + payload_len + TELEMETRY_FRAME_TAIL_SIZE;
+    uint8_t *p_frame;
+
+    if (p_tm->batch_len + frame_len > TELEMETRY_BATCH_SIZE) {
+        p_tm->drop_cnt++;
+        return NULL;
+    }
+    p_frame = &p_tm->batch[p_tm->batch_index][p_tm->batch_len];
+    p_frame[0] = TELEMETRY_SOF;
+    p_frame[1] = type;
+    p_frame[2] = p_tm->seq++;
+    telemetry_put_u16(&p_frame[3], payload_len);
+    return p_frame;
+}
+
+static void telemetry_frame_end(telemetry_t *p_tm, uint8_t *p_frame, uint16_t payload_len) {
+    uint16_t frame_len = TELEMETRY_FRAME_HEAD_SIZE + payload_len + TELEMETRY_FRAME_TAIL_SIZE;
+
+    append_CRC16_check_sum(p_frame, frame_len);
+    p_tm->batch_len += frame_len;
+    p_tm->frame_cnt++;
+}
+
+static void telemetry_pack_schema(telemetry_t *p_tm) {
+    uint16_t payload_len = 5 + p_tm->channel_num * (1 + TELEMETRY_NAME_LEN);
+    uint8_t *p_frame = telemetry_frame_begin(p_tm, TELEMETRY_FRAME_SCHEMA, payload_len);
+    uint8_t *p_data;
+    uint8_t i;
+
+    if (p_frame == NULL) {
+        return;
+    }
+    p_data = p_frame + TELEMETRY_FRAME_HEAD_SIZE;
+    telemetry_put_u32(p_data, p_tm->tick_hz);
+    p_data[4] = p_tm->channel_num;
+    p_data += 5;
+    for (i = 0; i < p_tm->channel_num; i++) {
+        p_data[0] = p_tm->channel[i].type;
+        memcpy(&p_data[1], p_tm->channel[i].name, TELEMETRY_NAME_LEN);
+        p_data += 1 + TELEMETRY_NAME_LEN;
+    }
+    telemetry_frame_end(p_tm, p_frame, payload_len);
+    p_tm->schema_dirty = 0;
+    p_tm->schema_cnt = 0;
+}
+
+void telemetry_init(telemetry_t *p_tm, telemetry_write_f write, uint32_t tick_hz, uint16_t flush_len) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    memset(p_tm, 0, sizeof(telemetry_t));
+    p_tm->tick_hz = tick_hz;
+    p_tm->flush_len = (flush_len < TELEMETRY_BATCH_SIZE) ? flush_len : TELEMETRY_BATCH_SIZE;
+    p_tm->schema_dirty = 1;
+    p_tm->write = write;
+    MUTEX_UNLOCK(mutex);
+}
+
+int telemetry_add(telemetry_t *p_tm, const char *name, const volatile void *p_addr, telemetry_type_e type) {
+    MUTEX_DECLARE(mutex);
+    telemetry_channel_t *p_channel;
+    int index = -1;
+
+    if (p_addr == NULL || type >= sizeof(telemetry_type_size)) {
+        return -1;
+    }
+    MUTEX_LOCK(mutex);
+    if (p_tm->channel_num < TELEMETRY_CHANNEL_MAX_NUM) {
+        index = p_tm->channel_num;
+        p_channel = &p_tm->channel[index];
+        p_channel->p_addr = p_addr;
+        p_channel->type = (uint8_t) type;
+        memset(p_channel->name, 0, TELEMETRY_NAME_LEN);
+        strncpy(p_channel->name, name, TELEMETRY_NAME_LEN);
+        p_tm->sample_len += telemetry_type_size[type];
+        p_tm->channel_num++;
+        p_tm->schema_dirty = 1;
+    }
+    MUTEX_UNLOCK(mutex);
+    return index;
+}
+
+void telemetry_sample(telemetry_t *p_tm, uint32_t timestamp) {
+    MUTEX_DECLARE(mutex);
+    const telemetry_channel_t *p_channel;
+    uint16_t payload_len;
+    uint8_t *p_frame;
+    uint8_t *p_data;
+    uint8_t i;
+    bool_t flush;
+
+    if (p_tm->write == NULL || p_tm->channel_num == 0U) {
+        return;
+    }
+    payload_len = 4 + p_tm->sample_len;
+    //放不下这条记录时先发送
+    if (p_tm->batch_len + TELEMETRY_FRAME_HEAD_SIZE + payload_len + TELEMETRY_FRAME_TAIL_SIZE > TELEMETRY_BATCH_SIZE) {
+        telemetry_flush_batch(p_tm);
+    }
+    MUTEX_LOCK(mutex);
+    if (p_tm->schema_dirty || p_tm->schema_cnt >= TELEMETRY_SCHEMA_PERIOD) {
+        telemetry_pack_schema(p_tm);
+    }
+    p_tm->schema_cnt++;
+
+    payload_len = 4 + p_tm->sample_len;
+    p_frame = telemetry_frame_begin(p_tm, TELEMETRY_FRAME_SAMPLE, payload_len);
+    if (p_frame != NULL) {
+        p_data = p_frame + TELEMETRY_FRAME_HEAD_SIZE;
+        telemetry_put_u32(p_data, timestamp);
+        p_data += 4;
+        for (i = 0; i < p_tm->channel_num; i++) {
+            p_channel = &p_tm->channel[i];
+            //按类型整体读取一次,避免读到被中断修改了一半的值
+            if (p_channel->type == TELEMETRY_INT16) {
+                telemetry_put_u16(p_data, (uint16_t) *(const volatile int16_t *) p_channel->p_addr);
+                p_data += 2;
+            } else {
+                telemetry_put_u32(p_data, *(const volatile uint32_t *) p_channel->p_addr);
+                p_data += 4;
+            }
+        }
+        telemetry_frame_end(p_tm, p_frame, payload_len);
+    }
+    flush = (p_tm->batch_len >= p_tm->flush_len);
+    MUTEX_UNLOCK(mutex);
+
+    if (flush) {
+        telemetry_flush_batch(p_tm);
+    }
+}
+
+void telemetry_flush(telemetry_t *p_tm) {
+    telemetry_flush_batch(p_tm);
+}
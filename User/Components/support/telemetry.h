@@ -0,0 +1,114 @@
+/**
+  * @file       telemetry.c/h
+  * @brief      binary telemetry stream. Variables are registered once by address
+  *             and type, every telemetry_sample call packs their raw values into
+  *             one timestamped record, no text formatting is done on the target.
+  *             二进制遥测数据流:变量按地址和类型注册一次,每次telemetry_sample把所有
+  *             变量的原始值打包为一条带时间戳的记录,目标板上不做任何文本格式化
+  * @note       frame: SOF(0xA6) type seq len(u16) payload CRC16, little endian,
+  *             CRC16 is the referee CRC16 over everything before it.
+  *             schema payload: tick_hz(u32) channel_num(u8) {type(u8) name[15]}...
+  *             sample payload: timestamp(u32) values packed in channel order.
+  *             The schema is repeated every TELEMETRY_SCHEMA_PERIOD samples so the
+  *             host can join a running stream. Decoder: Matlab/telemetry_decode.py
+  *             帧格式:SOF(0xA6) 类型 序号 长度(u16) 数据 CRC16,小端,CRC16与裁判系统相同.
+  *             通道表每TELEMETRY_SCHEMA_PERIOD条记录重发一次,上位机可随时接入
+  */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "struct_typedef.h"
+
+#define TELEMETRY_SOF               0xA6
+#define TELEMETRY_CHANNEL_MAX_NUM   24
+#define TELEMETRY_NAME_LEN          15
+#define TELEMETRY_BATCH_SIZE        512
+#define TELEMETRY_SCHEMA_PERIOD     1000U
+
+#define TELEMETRY_FRAME_HEAD_SIZE   5
+#define TELEMETRY_FRAME_TAIL_SIZE   2
+
+typedef enum {
+    TELEMETRY_FRAME_SCHEMA = 0x01,
+    TELEMETRY_FRAME_SAMPLE = 0x02,
+} telemetry_frame_type_e;
+
+typedef enum {
+    TELEMETRY_FLOAT = 0,
+    TELEMETRY_INT16,
+    TELEMETRY_UINT32,
+} telemetry_type_e;
+
+/**
+  * @brief          发送一批数据,只读取前len字节,缓存在下一次调用成功前保持不变.不在临界区内调用
+  * @retval         0:已接收, -1:忙,稍后重试
+  */
+typedef int (*telemetry_write_f)(const uint8_t *p_data, uint16_t len);
+
+typedef struct {
+    const volatile void *p_addr;
+    uint8_t type;
+    char name[TELEMETRY_NAME_LEN];
+} telemetry_channel_t;
+
+typedef struct {
+    telemetry_write_f write;
+    uint32_t tick_hz;                   //时间戳计数频率
+    uint16_t flush_len;                 //批量缓存达到该长度时发送
+    telemetry_channel_t channel[TELEMETRY_CHANNEL_MAX_NUM];
+    uint8_t channel_num;
+    uint8_t sample_len;                 //一条记录中变量值的字节数
+    uint8_t seq;
+    uint8_t schema_dirty;               //通道表变化,下次采样前重发
+    uint16_t schema_cnt;                //距上次发送通道表的记录数
+    //双缓存:一个交给发送端时另一个继续打包
+    uint8_t batch[2][TELEMETRY_BATCH_SIZE];
+    uint16_t batch_len;
+    uint8_t batch_index;
+    uint8_t flushing;                   //正在调用发送端,其他调用者不再发送
+    //统计(调试时使用)
+    uint32_t frame_cnt;                 //已打包帧数
+    uint32_t drop_cnt;                  //发送端忙且缓存已满时丢弃的帧数
+} telemetry_t;
+
+/**
+  * @brief          init the telemetry stream
+  * @param[out]     p_tm: telemetry stream
+  * @param[in]      write: transport, e.g. RTT up-buffer or USB CDC
+  * @param[in]      tick_hz: frequency of the sample timestamps
+  * @param[in]      flush_len: batch length to hand to the transport, 1 sends every frame
+  * @retval         none
+  */
+/**
+  * @brief          初始化遥测数据流
+  * @param[out]     p_tm: 遥测数据流
+  * @param[in]      write: 发送端,如RTT上行缓存或USB CDC
+  * @param[in]      tick_hz: 采样时间戳的计数频率
+  * @param[in]      flush_len: 批量发送长度,1为每帧发送
+  * @retval         none
+  */
+extern void telemetry_init(telemetry_t *p_tm, telemetry_write_f write, uint32_t tick_hz, uint16_t flush_len);
+
+/**
+  * @brief          注册变量,任务和中断中均可调用
+  * @param[in]      name: 通道名,超出TELEMETRY_NAME_LEN截断
+  * @param[in]      p_addr: 变量地址,需按类型对齐
+  * @param[in]      type: telemetry_type_e
+  * @retval         通道号, -1:通道已满
+  */
+extern int telemetry_add(telemetry_t *p_tm, const char *name, const volatile void *p_addr, telemetry_type_e type);
+
+/**
+  * @brief          采样所有通道并打包为一条记录,在被观察的控制循环末尾调用,
+  *                 与控制周期同步.达到flush_len时在临界区外调用发送端
+  * @param[in]      timestamp: 时间戳,单位1/tick_hz秒
+  * @retval         none
+  */
+extern void telemetry_sample(telemetry_t *p_tm, uint32_t timestamp);
+
+/**
+  * @brief          把已打包的数据交给发送端
+  */
+extern void telemetry_flush(telemetry_t *p_tm);
+
+#endif
@@ -0,0 +1,186 @@
+/**
+  * @file       uart_tx.c/h
+  * @brief      uart transmit scheduler with priority queues and frame deadlines.
+  *             带优先级队列和帧截止时间的串口发送调度器
+  * @note       frames are sent straight from the pool buffers in single-buffer dma
+  *             mode, nothing is copied or cleared between frames. Higher priority
+  *             queues are always drained first, frames of the same priority are
+  *             sent in commit order.
+  *             帧直接从缓存池以单缓冲DMA发送,帧间无拷贝和清零.高优先级队列总是先发送,
+  *             同优先级按提交顺序发送
+  */
+#include "uart_tx.h"
+#include "macro_mutex.h"
+#include <string.h>
+#include <stddef.h>
+
+static void uart_tx_free_frame(uart_tx_port_t *p_port, uart_tx_frame_t *p_frame) {
+    p_frame->p_next = p_port->p_free;
+    p_port->p_free = p_frame;
+}
+
+/**
+  * @brief          释放当前帧后启动下一个未过期的最高优先级帧,在临界区内调用
+  */
+static void uart_tx_start_next(uart_tx_port_t *p_port, uint32_t now_ms) {
+    uart_tx_frame_t *p_frame;
+    uint32_t queue_ms;
+    uint8_t i;
+
+    p_port->p_active = NULL;
+    for (i = 0; i < UART_TX_PRIORITY_NUM; i++) {
+        while ((p_frame = p_port->p_head[i]) != NULL) {
+            p_port->p_head[i] = p_frame->p_next;
+            if (p_port->p_head[i] == NULL) {
+                p_port->p_tail[i] = NULL;
+            }
+            if (p_frame->has_deadline && (int32_t) (now_ms - p_frame->deadline_ms) > 0) {
+                p_port->drop_expired_cnt++;
+                uart_tx_free_frame(p_port, p_frame);
+                continue;
+            }
+            queue_ms = now_ms - p_frame->commit_ms;
+            if (queue_ms > p_port->queue_ms_max) {
+                p_port->queue_ms_max = queue_ms;
+            }
+            p_port->p_active = p_frame;
+            p_port->active_start_ms = now_ms;
+            p_port->start(p_frame->data, p_frame->len);
+            return;
+        }
+    }
+}
+
+/**
+  * @brief          发送中的帧超时未完成时停止DMA,回收该帧并启动下一帧,在临界区内调用
+  */
+static void uart_tx_check_stall(uart_tx_port_t *p_port, uint32_t now_ms) {
+    if (p_port->p_active != NULL && now_ms - p_port->active_start_ms > UART_TX_STALL_MS) {
+        //完成中断丢失,先停止DMA再回收当前帧,否则DMA仍在读取已归还的缓存
+        p_port->stall_cnt++;
+        p_port->abort();
+        uart_tx_free_frame(p_port, p_port->p_active);
+        uart_tx_start_next(p_port, now_ms);
+    }
+}
+
+void uart_tx_init(uart_tx_port_t *p_port, uart_tx_start_f start, uart_tx_abort_f abort,
+                  uart_tx_tick_f get_tick) {
+    MUTEX_DECLARE(mutex);
+    uint8_t i;
+
+    MUTEX_LOCK(mutex);
+    memset(p_port, 0, sizeof(uart_tx_port_t));
+    p_port->start = start;
+    p_port->abort = abort;
+    p_port->get_tick = get_tick;
+    for (i = 0; i < UART_TX_FRAME_NUM; i++) {
+        uart_tx_free_frame(p_port, &p_port->frame[i]);
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+uart_tx_frame_t *uart_tx_alloc(uart_tx_port_t *p_port) {
+    MUTEX_DECLARE(mutex);
+    uart_tx_frame_t *p_frame;
+
+    MUTEX_LOCK(mutex);
+    p_frame = p_port->p_free;
+    if (p_frame == NULL) {
+        //帧缓存全部卡在队列中时,提交不会再发生,在此处恢复
+        uart_tx_check_stall(p_port, p_port->get_tick());
+        p_frame = p_port->p_free;
+    }
+    if (p_frame != NULL) {
+        p_port->p_free = p_frame->p_next;
+    } else {
+        p_port->drop_full_cnt++;
+    }
+    MUTEX_UNLOCK(mutex);
+    return p_frame;
+}
+
+void uart_tx_commit(uart_tx_port_t *p_port, uart_tx_frame_t *p_frame, uint16_t len, uint8_t priority,
+                    uint16_t timeout_ms) {
+    MUTEX_DECLARE(mutex);
+    uint32_t now_ms = p_port->get_tick();
+
+    if (priority >= UART_TX_PRIORITY_NUM) {
+        priority = UART_TX_PRIORITY_LOW;
+    }
+    p_frame->p_next = NULL;
+    p_frame->len = (len < UART_TX_FRAME_SIZE) ? len : UART_TX_FRAME_SIZE;
+    p_frame->commit_ms = now_ms;
+    p_frame->deadline_ms = now_ms + timeout_ms;
+    p_frame->has_deadline = (timeout_ms != 0U);
+
+    MUTEX_LOCK(mutex);
+    if (p_port->p_tail[priority] != NULL) {
+        p_port->p_tail[priority]->p_next = p_frame;
+    } else {
+        p_port->p_head[priority] = p_frame;
+    }
+    p_port->p_tail[priority] = p_frame;
+
+    if (p_port->p_active == NULL) {
+        uart_tx_start_next(p_port, now_ms);
+    } else {
+        uart_tx_check_stall(p_port, now_ms);
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+void uart_tx_release(uart_tx_port_t *p_port, uart_tx_frame_t *p_frame) {
+    MUTEX_DECLARE(mutex);
+
+    MUTEX_LOCK(mutex);
+    uart_tx_free_frame(p_port, p_frame);
+    MUTEX_UNLOCK(mutex);
+}
+
+int uart_tx_send(uart_tx_port_t *p_port, const uint8_t *p_data, uint16_t len, uint8_t priority,
+                 uint16_t timeout_ms) {
+    uart_tx_frame_t *p_frame;
+
+    if (p_data == NULL || len > UART_TX_FRAME_SIZE) {
+        return -1;
+    }
+    p_frame = uart_tx_alloc(p_port);
+    if (p_frame == NULL) {
+        return -1;
+    }
+    memcpy(p_frame->data, p_data, len);
+    uart_tx_commit(p_port, p_frame, len, priority, timeout_ms);
+    return 0;
+}
+
+void uart_tx_complete_irq(uart_tx_port_t *p_port) {
+    MUTEX_DECLARE(mutex);
+    uart_tx_frame_t *p_frame;
+
+    MUTEX_LOCK(mutex);
+    p_frame = p_port->p_active;
+    if (p_frame != NULL) {
+        p_port->sent_cnt++;
+        p_port->sent_bytes += p_frame->len;
+        uart_tx_free_frame(p_port, p_frame);
+        uart_tx_start_next(p_port, p_port->get_tick());
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+uint16_t uart_tx_pending(uart_tx_port_t *p_port) {
+    MUTEX_DECLARE(mutex);
+    uart_tx_frame_t *p_frame;
+    uint16_t num = 0;
+    uint8_t i;
+
+    MUTEX_LOCK(mutex);
+    for (i = 0; i < UART_TX_PRIORITY_NUM; i++) {
+        for (p_frame = p_port->p_head[i]; p_frame != NULL; p_frame = p_frame->p_next) {
+            num++;
+        }
+    }
+    MUTEX_UNLOCK(mutex);
+    return num;
+}
@@ -0,0 +1,144 @@
+/**
+  * @file       uart_tx.c/h
+  * @brief      uart transmit scheduler. Each port owns a pool of DMA-ready frame
+  *             buffers and one queue per priority. Producers fill a frame in
+  *             place and commit it, the DMA complete interrupt starts the next
+  *             frame directly, so no tx task and no scheduler suspension are needed.
+  *             串口发送调度器:每个端口持有一组可直接DMA发送的帧缓存和按优先级划分的
+  *             发送队列.生产者在帧缓存中直接组帧后提交,DMA发送完成中断直接启动下一帧,
+  *             无需发送任务,也无需挂起调度器
+  * @note       queue operations are guarded by short PRIMASK critical sections and
+  *             can be called from tasks and interrupts. A frame whose deadline has
+  *             passed when it reaches the head of the queue is dropped.
+  *             队列操作由短暂的PRIMASK临界区保护,任务和中断中均可调用.帧到达队首时
+  *             已超过截止时间则丢弃
+  */
+#ifndef UART_TX_H
+#define UART_TX_H
+
+#include "struct_typedef.h"
+
+#define UART_TX_FRAME_SIZE      128
+#define UART_TX_FRAME_NUM       12
+//发送中的帧超过该时间仍未收到完成中断,视为DMA异常并强制结束
+#define UART_TX_STALL_MS        50U
+
+typedef enum {
+    UART_TX_PRIORITY_HIGH = 0,
+    UART_TX_PRIORITY_NORMAL,
+    UART_TX_PRIORITY_LOW,
+    UART_TX_PRIORITY_NUM,
+} uart_tx_priority_e;
+
+/**
+  * @brief          启动一次DMA发送,在临界区内调用
+  */
+typedef void (*uart_tx_start_f)(const uint8_t *p_data, uint16_t len);
+
+/**
+  * @brief          停止DMA发送并清除完成标志,返回后DMA不再读取帧缓存,在临界区内调用
+  */
+typedef void (*uart_tx_abort_f)(void);
+
+/**
+  * @brief          获取毫秒时间,任务和中断中均可调用
+  */
+typedef uint32_t (*uart_tx_tick_f)(void);
+
+typedef struct uart_tx_frame_t {
+    uint8_t data[UART_TX_FRAME_SIZE];   //DMA直接从此处发送,放在首位保证对齐
+    struct uart_tx_frame_t *p_next;
+    uint32_t commit_ms;                 //提交时间
+    uint32_t deadline_ms;               //截止时间,仅timeout非0时有效
+    uint16_t len;
+    uint8_t has_deadline;
+} uart_tx_frame_t;
+
+typedef struct {
+    uart_tx_start_f start;
+    uart_tx_abort_f abort;
+    uart_tx_tick_f get_tick;
+    uart_tx_frame_t frame[UART_TX_FRAME_NUM];
+    uart_tx_frame_t *p_free;
+    uart_tx_frame_t *p_head[UART_TX_PRIORITY_NUM];
+    uart_tx_frame_t *p_tail[UART_TX_PRIORITY_NUM];
+    uart_tx_frame_t *volatile p_active; //正在发送的帧,NULL表示DMA空闲
+    uint32_t active_start_ms;
+    //统计(调试时使用)
+    uint32_t sent_cnt;                  //已发送帧数
+    uint32_t sent_bytes;                //已发送字节数
+    uint32_t drop_full_cnt;             //帧缓存耗尽导致的丢帧
+    uint32_t drop_expired_cnt;          //超过截止时间导致的丢帧
+    uint32_t stall_cnt;                 //DMA完成中断丢失次数
+    uint32_t queue_ms_max;              //提交到开始发送的最大等待
+} uart_tx_port_t;
+
+/**
+  * @brief          init a port
+  * @param[out]     p_port: port
+  * @param[in]      start: starts one dma transfer
+  * @param[in]      abort: stops the dma, used before a stalled frame is reclaimed
+  * @param[in]      get_tick: millisecond time source
+  * @retval         none
+  */
+/**
+  * @brief          初始化端口
+  * @param[out]     p_port: 端口
+  * @param[in]      start: 启动一次DMA发送
+  * @param[in]      abort: 停止DMA发送,回收卡住的帧之前调用
+  * @param[in]      get_tick: 毫秒时间源
+  * @retval         none
+  */
+extern void uart_tx_init(uart_tx_port_t *p_port, uart_tx_start_f start, uart_tx_abort_f abort,
+                         uart_tx_tick_f get_tick);
+
+/**
+  * @brief          申请一个帧缓存,在frame->data中直接组帧后用uart_tx_commit提交
+  * @retval         帧缓存,耗尽时返回NULL
+  */
+extern uart_tx_frame_t *uart_tx_alloc(uart_tx_port_t *p_port);
+
+/**
+  * @brief          commit a filled frame, starts the dma at once when the port is idle
+  * @param[in]      p_port: port
+  * @param[in]      p_frame: frame from uart_tx_alloc
+  * @param[in]      len: bytes to send
+  * @param[in]      priority: uart_tx_priority_e
+  * @param[in]      timeout_ms: dropped when not started within this time, 0 never expires
+  * @retval         none
+  */
+/**
+  * @brief          提交已组好的帧,端口空闲时立即启动DMA
+  * @param[in]      p_port: 端口
+  * @param[in]      p_frame: uart_tx_alloc申请的帧
+  * @param[in]      len: 发送长度
+  * @param[in]      priority: 优先级uart_tx_priority_e
+  * @param[in]      timeout_ms: 超过该时间仍未开始发送则丢弃,0不过期
+  * @retval         none
+  */
+extern void uart_tx_commit(uart_tx_port_t *p_port, uart_tx_frame_t *p_frame, uint16_t len, uint8_t priority,
+                           uint16_t timeout_ms);
+
+/**
+  * @brief          归还未提交的帧缓存
+  */
+extern void uart_tx_release(uart_tx_port_t *p_port, uart_tx_frame_t *p_frame);
+
+/**
+  * @brief          拷贝数据并提交,用于已在其他缓存中组好的帧
+  * @retval         0:成功, -1:帧缓存耗尽或长度超出
+  */
+extern int uart_tx_send(uart_tx_port_t *p_port, const uint8_t *p_data, uint16_t len, uint8_t priority,
+                        uint16_t timeout_ms);
+
+/**
+  * @brief          DMA发送完成中断中调用,释放当前帧并启动下一帧
+  */
+extern void uart_tx_complete_irq(uart_tx_port_t *p_port);
+
+/**
+  * @brief          队列中等待发送的帧数
+  */
+extern uint16_t uart_tx_pending(uart_tx_port_t *p_port);
+
+#endif
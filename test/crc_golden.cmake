@@ -0,0 +1,19 @@
+# 运行 Others/CRC_tester_and_Vision_RC_generator.c, 把它输出的视觉帧和CRC16写成测试用的头文件
+# 用法: cmake -DTESTER=<tester> -DOUT=<crc_golden.h> -P crc_golden.cmake
+execute_process(COMMAND ${TESTER} OUTPUT_VARIABLE out RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${TESTER} failed: ${result}")
+endif ()
+# 第一行为CRC16, 第二行为帧的各字节
+string(REGEX MATCH "^([0-9a-f]+)\r?\n(( [0-9a-f][0-9a-f])+)" match "${out}")
+if (NOT match)
+    message(FATAL_ERROR "unexpected tester output: ${out}")
+endif ()
+set(crc ${CMAKE_MATCH_1})
+string(STRIP "${CMAKE_MATCH_2}" bytes)
+string(REPLACE " " ", 0x" bytes "${bytes}")
+file(WRITE ${OUT}.tmp
+        "//由 Others/CRC_tester_and_Vision_RC_generator.c 的输出生成, 不要手动修改\n"
+        "#define CRC_GOLDEN_FRAME_CRC16 0x${crc}U\n"
+        "static const uint8_t crc_golden_frame[] = {0x${bytes}};\n")
+configure_file(${OUT}.tmp ${OUT} COPYONLY)
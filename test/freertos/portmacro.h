@@ -0,0 +1,86 @@
+/**
+  * @file       portmacro.h
+  * @brief      FreeRTOS port macros for the host build. Types are sized for
+  *             x86-64 and the critical section and yield go through functions
+  *             so that the unit tests can count them instead of touching
+  *             BASEPRI and PendSV.
+  *             主机编译用的FreeRTOS移植宏.类型按x86-64定义,临界区和任务切换通过函数实现,
+  *             单元测试中只计数,不访问BASEPRI和PendSV
+  */
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define portCHAR        char
+#define portFLOAT       float
+#define portDOUBLE      double
+#define portLONG        long
+#define portSHORT       short
+#define portSTACK_TYPE  unsigned long
+#define portBASE_TYPE   long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if (configUSE_16_BIT_TICKS == 1)
+typedef uint16_t TickType_t;
+#define portMAX_DELAY ( TickType_t ) 0xffff
+#else
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+#endif
+
+#define portSTACK_GROWTH            ( -1 )
+#define portTICK_PERIOD_MS          ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT          8
+
+extern void vPortYield(void);
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+extern void vPortDisableInterrupts(void);
+extern void vPortEnableInterrupts(void);
+extern UBaseType_t uxPortSetInterruptMask(void);
+extern void vPortClearInterruptMask(UBaseType_t mask);
+
+#define portYIELD()                                 vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired)      if( xSwitchRequired != pdFALSE ) portYIELD()
+#define portYIELD_FROM_ISR(x)                       portEND_SWITCHING_ISR( x )
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()           uxPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)        vPortClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS()                    vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()                     vPortEnableInterrupts()
+#define portENTER_CRITICAL()                        vPortEnterCritical()
+#define portEXIT_CRITICAL()                         vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction( void *pvParameters )
+
+#ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
+#endif
+
+#if configUSE_PORT_OPTIMISED_TASK_SELECTION == 1
+#define portRECORD_READY_PRIORITY(uxPriority, uxReadyPriorities) ( uxReadyPriorities ) |= ( 1UL << ( uxPriority ) )
+#define portRESET_READY_PRIORITY(uxPriority, uxReadyPriorities) ( uxReadyPriorities ) &= ~( 1UL << ( uxPriority ) )
+#define portGET_HIGHEST_PRIORITY(uxTopPriority, uxReadyPriorities) \
+    uxTopPriority = ( 63UL - ( UBaseType_t ) __builtin_clzl( ( uxReadyPriorities ) ) )
+#endif
+
+#define portNOP()
+#define portINLINE              __inline
+#define portFORCE_INLINE        inline __attribute__(( always_inline))
+#define portMEMORY_BARRIER()    __asm volatile( "" ::: "memory" )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
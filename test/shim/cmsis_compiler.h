@@ -0,0 +1,7 @@
+/**
+  * @file       cmsis_compiler.h
+  * @brief      host wrapper, see cmsis_host.h.
+  *             主机包装, 见cmsis_host.h
+  */
+#include "cmsis_host.h"
+#include_next "cmsis_compiler.h"
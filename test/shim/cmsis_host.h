@@ -0,0 +1,110 @@
+/**
+  * @file       cmsis_host.h
+  * @brief      the Cortex-M core intrinsics the firmware calls, as plain C on
+  *             the host. cmsis_gcc.h is included once with its inline assembly
+  *             versions renamed out of the way, its include guard then keeps
+  *             core_cm4.h from pulling the originals in again. PRIMASK and IPSR
+  *             are variables the tests can read and set.
+  *             固件调用的Cortex-M内核函数的主机C实现. cmsis_gcc.h的内联汇编版本先改名包含一次,
+  *             之后其头文件保护使core_cm4.h不再包含原版本. PRIMASK和IPSR是测试可以读写的变量
+  */
+#ifndef CMSIS_HOST_H
+#define CMSIS_HOST_H
+
+#include <stdint.h>
+
+#define __enable_irq    cmsis_target_enable_irq
+#define __disable_irq   cmsis_target_disable_irq
+#define __get_PRIMASK   cmsis_target_get_PRIMASK
+#define __set_PRIMASK   cmsis_target_set_PRIMASK
+#define __get_IPSR      cmsis_target_get_IPSR
+#define __get_BASEPRI   cmsis_target_get_BASEPRI
+#define __set_BASEPRI   cmsis_target_set_BASEPRI
+#define __ISB           cmsis_target_ISB
+#define __DSB           cmsis_target_DSB
+#define __DMB           cmsis_target_DMB
+#include "../../Drivers/CMSIS/Include/cmsis_gcc.h"
+#undef __enable_irq
+#undef __disable_irq
+#undef __get_PRIMASK
+#undef __set_PRIMASK
+#undef __get_IPSR
+#undef __get_BASEPRI
+#undef __set_BASEPRI
+#undef __ISB
+#undef __DSB
+#undef __DMB
+//断点在主机上为SIGTRAP
+#undef __BKPT
+#define __BKPT(value)   __builtin_trap()
+
+extern volatile uint32_t host_primask;          //1: 中断被屏蔽
+extern volatile uint32_t host_ipsr;             //非0: 模拟在中断中执行
+extern volatile uint32_t host_basepri;
+extern uint32_t host_irq_disable_count;         //__disable_irq调用次数
+
+#ifdef HOST_SIM
+//主机仿真中屏蔽位的改变是同步点, 见test/sim
+extern void sim_primask_write(uint32_t primask);
+extern void sim_basepri_write(uint32_t basepri);
+
+static inline void __disable_irq(void) {
+    host_irq_disable_count++;
+    sim_primask_write(1U);
+}
+
+static inline void __enable_irq(void) {
+    sim_primask_write(0U);
+}
+
+static inline void __set_PRIMASK(uint32_t priMask) {
+    sim_primask_write(priMask & 1U);
+}
+
+static inline void __set_BASEPRI(uint32_t basePri) {
+    sim_basepri_write(basePri);
+}
+#else
+static inline void __disable_irq(void) {
+    host_primask = 1U;
+    host_irq_disable_count++;
+}
+
+static inline void __enable_irq(void) {
+    host_primask = 0U;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask) {
+    host_primask = priMask & 1U;
+}
+
+static inline void __set_BASEPRI(uint32_t basePri) {
+    host_basepri = basePri;
+}
+#endif
+
+static inline uint32_t __get_PRIMASK(void) {
+    return host_primask;
+}
+
+static inline uint32_t __get_IPSR(void) {
+    return host_ipsr;
+}
+
+static inline uint32_t __get_BASEPRI(void) {
+    return host_basepri;
+}
+
+static inline void __ISB(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __DSB(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __DMB(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+  * @file       host_shim.c/h
+  * @brief      HAL_GetTick, the FreeRTOS heap and critical section for the host
+  *             unit tests.
+  *             主机单元测试用的HAL_GetTick、FreeRTOS堆和临界区
+  */
+#include "host_shim.h"
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "cmsis_host.h"
+
+volatile uint32_t host_tick = 0;
+uint32_t host_malloc_count = 0;
+uint32_t host_free_count = 0;
+int32_t host_critical_nesting = 0;
+uint32_t host_critical_count = 0;
+volatile uint32_t host_primask = 0;
+volatile uint32_t host_ipsr = 0;
+volatile uint32_t host_basepri = 0;
+uint32_t host_irq_disable_count = 0;
+
+uint32_t SystemCoreClock = 168000000U;
+struct _reent *_impure_ptr = NULL;
+
+uint32_t HAL_GetTick(void) {
+    return host_tick;
+}
+
+void *pvPortMalloc(size_t xSize) {
+    host_malloc_count++;
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv) {
+    if (pv != NULL) {
+        host_free_count++;
+    }
+    free(pv);
+}
+
+void vPortEnterCritical(void) {
+    host_critical_nesting++;
+    host_critical_count++;
+}
+
+void vPortExitCritical(void) {
+    host_critical_nesting--;
+}
+
+void vPortDisableInterrupts(void) {
+}
+
+void vPortEnableInterrupts(void) {
+}
+
+UBaseType_t uxPortSetInterruptMask(void) {
+    host_critical_nesting++;
+    return 0;
+}
+
+void vPortClearInterruptMask(UBaseType_t mask) {
+    (void) mask;
+    host_critical_nesting--;
+}
+
+void vPortYield(void) {
+}
@@ -0,0 +1,22 @@
+/**
+  * @file       host_shim.c/h
+  * @brief      what the firmware modules need from the HAL and FreeRTOS when
+  *             they run on the host without a scheduler: HAL_GetTick reads a
+  *             tick the test sets, pvPortMalloc counts the allocations and the
+  *             critical section only counts its nesting.
+  *             无调度器的主机测试中固件模块需要的HAL和FreeRTOS函数: HAL_GetTick读取测试设定的
+  *             时间, pvPortMalloc统计分配次数, 临界区只记录嵌套层数
+  */
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern volatile uint32_t host_tick;         //HAL_GetTick的返回值 ms
+extern uint32_t host_malloc_count;          //pvPortMalloc调用次数
+extern uint32_t host_free_count;
+extern int32_t host_critical_nesting;       //当前临界区嵌套层数
+extern uint32_t host_critical_count;        //进入临界区的次数
+
+#endif
@@ -0,0 +1,18 @@
+/**
+  * @file       reent.h
+  * @brief      stand-in for the newlib reent.h, FreeRTOS.h includes it because
+  *             of configUSE_NEWLIB_REENTRANT and glibc has none
+  *             newlib的reent.h替身,configUSE_NEWLIB_REENTRANT使FreeRTOS.h包含它,glibc中没有
+  */
+#ifndef REENT_H
+#define REENT_H
+
+struct _reent {
+    int _errno;
+};
+
+#define _REENT_INIT_PTR(p)  ((p)->_errno = 0)
+
+extern struct _reent *_impure_ptr;
+
+#endif
@@ -0,0 +1,22 @@
+/**
+  * @file       sin_table_gen.c
+  * @brief      prints sinTable_f32 for arm_sin_f32 / arm_cos_f32. The repo has
+  *             no arm_common_tables.c, the host build generates the table.
+  *             生成arm_sin_f32和arm_cos_f32使用的sinTable_f32,仓库中没有arm_common_tables.c
+  */
+#include <math.h>
+#include <stdio.h>
+
+#define FAST_MATH_TABLE_SIZE 512
+
+int main(void) {
+    int i;
+
+    printf("#include \"arm_math_types.h\"\n\n");
+    printf("const float32_t sinTable_f32[%d] = {\n", FAST_MATH_TABLE_SIZE + 1);
+    for (i = 0; i <= FAST_MATH_TABLE_SIZE; i++) {
+        printf("        %#.9gf,\n", (float) sin(2.0 * M_PI * i / FAST_MATH_TABLE_SIZE));
+    }
+    printf("};\n");
+    return 0;
+}
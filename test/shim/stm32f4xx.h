@@ -0,0 +1,19 @@
+/**
+  * @file       stm32f4xx.h
+  * @brief      host wrapper, installs the host core intrinsics before the
+  *             device header reaches core_cm4.h, see cmsis_host.h.
+  *             主机包装, 在设备头文件包含core_cm4.h之前换上主机版内核函数, 见cmsis_host.h
+  */
+#include "cmsis_host.h"
+#include_next "stm32f4xx.h"
+
+#if defined(HOST_SIM) && !defined(STM32F4XX_HOST_SIM_H)
+#define STM32F4XX_HOST_SIM_H
+//主机仿真中DWT和SysTick的计数值由虚拟时钟给出, 每次访问先同步, 见test/sim
+extern DWT_Type *sim_dwt_sync(void);
+extern SysTick_Type *sim_systick_sync(void);
+#undef DWT
+#define DWT     (sim_dwt_sync())
+#undef SysTick
+#define SysTick (sim_systick_sync())
+#endif
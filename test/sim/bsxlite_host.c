@@ -0,0 +1,103 @@
+/**
+  * @file       bsxlite_host.c
+  * @brief      stand-in for the prebuilt BSXlite fusion library, which only
+  *             exists for the Cortex-M4. A complementary filter integrates the
+  *             gyro and pulls roll and pitch towards the accelerometer, the
+  *             outputs have the units and ranges of the library so INS_task
+  *             runs its normal path. The cost of the real library is not
+  *             modelled, use --exec-add imuTask=us to inject it.
+  *             预编译的BSXlite融合库只有Cortex-M4版本, 这里用互补滤波代替: 积分陀螺仪,
+  *             横滚和俯仰向加速度计收敛, 输出的单位和范围与库相同, INS_task走正常路径.
+  *             不模拟真实库的耗时, 需要时用--exec-add imuTask=us注入
+  */
+#include "bsxlite_interface.h"
+#include <math.h>
+
+#define BSX_HOST_PI             3.14159265358979f
+//加速度计校正的权重, 每步
+#define BSX_HOST_ACCEL_GAIN     0.02f
+//相邻时间戳间隔上限 us
+#define BSX_HOST_MAX_DT_US      100000
+
+typedef struct {
+    int32_t last_time_stamp;
+    uint8_t started;
+    float roll;
+    float pitch;
+    float yaw;
+} bsx_host_t;
+
+static bsx_host_t bsx_host;
+
+void bsxlite_get_version(bsxlite_version *version_p) {
+    version_p->version_major = 0;
+    version_p->version_minor = 0;
+    version_p->bugfix_major = 0;
+}
+
+bsxlite_return_t bsxlite_init(bsxlite_instance_t *instance_p) {
+    (void) instance_p;
+    memset(&bsx_host, 0, sizeof(bsx_host));
+    return BSXLITE_OK;
+}
+
+bsxlite_return_t bsxlite_set_to_default(const bsxlite_instance_t *instance_p) {
+    return bsxlite_init((bsxlite_instance_t *) instance_p);
+}
+
+bsxlite_return_t bsxlite_do_step(const bsxlite_instance_t *instance_p, const int32_t w_time_stamp,
+                                 const vector_3d_t *accel_in_p, const vector_3d_t *gyro_in_p,
+                                 bsxlite_out_t *output_data_p) {
+    float dt;
+    float cr, sr, cp, sp, cy, sy;
+    (void) instance_p;
+
+    if (!bsx_host.started) {
+        bsx_host.started = 1;
+        bsx_host.roll = atan2f(accel_in_p->y, accel_in_p->z);
+        bsx_host.pitch = atan2f(accel_in_p->x, sqrtf(accel_in_p->y * accel_in_p->y + accel_in_p->z * accel_in_p->z));
+        dt = 0.0f;
+    } else {
+        int32_t diff = w_time_stamp - bsx_host.last_time_stamp;
+        if (diff <= 0 || diff > BSX_HOST_MAX_DT_US) {
+            bsx_host.last_time_stamp = w_time_stamp;
+            return BSXLITE_E_DOSTEPS_TSINTRADIFFOUTOFRANGE;
+        }
+        dt = (float) diff * 1e-6f;
+    }
+    bsx_host.last_time_stamp = w_time_stamp;
+
+    bsx_host.roll += gyro_in_p->x * dt;
+    bsx_host.pitch += gyro_in_p->y * dt;
+    bsx_host.yaw += gyro_in_p->z * dt;
+    bsx_host.roll += BSX_HOST_ACCEL_GAIN * (atan2f(accel_in_p->y, accel_in_p->z) - bsx_host.roll);
+    bsx_host.pitch += BSX_HOST_ACCEL_GAIN *
+                      (atan2f(accel_in_p->x, sqrtf(accel_in_p->y * accel_in_p->y + accel_in_p->z * accel_in_p->z)) -
+                       bsx_host.pitch);
+    //库输出的航向在[0, 2pi)
+    bsx_host.yaw = fmodf(bsx_host.yaw, 2.0f * BSX_HOST_PI);
+    if (bsx_host.yaw < 0.0f) {
+        bsx_host.yaw += 2.0f * BSX_HOST_PI;
+    }
+
+    if (output_data_p == NULL) {
+        return BSXLITE_I_DOSTEPS_NOOUTPUTSRETURNABLE;
+    }
+    output_data_p->orientation.roll = bsx_host.roll;
+    output_data_p->orientation.pitch = bsx_host.pitch;
+    output_data_p->orientation.yaw = bsx_host.yaw;
+    output_data_p->orientation.heading = bsx_host.yaw;
+    cr = cosf(bsx_host.roll * 0.5f);
+    sr = sinf(bsx_host.roll * 0.5f);
+    cp = cosf(bsx_host.pitch * 0.5f);
+    sp = sinf(bsx_host.pitch * 0.5f);
+    cy = cosf(bsx_host.yaw * 0.5f);
+    sy = sinf(bsx_host.yaw * 0.5f);
+    output_data_p->rotation_vector.w = cr * cp * cy + sr * sp * sy;
+    output_data_p->rotation_vector.x = sr * cp * cy - cr * sp * sy;
+    output_data_p->rotation_vector.y = cr * sp * cy + sr * cp * sy;
+    output_data_p->rotation_vector.z = cr * cp * sy - sr * sp * cy;
+    output_data_p->accel_calibration_status = 3;
+    output_data_p->gyro_calibration_status = 3;
+    return BSXLITE_OK;
+}
@@ -0,0 +1,38 @@
+/**
+  * @file       FreeRTOSConfig.h
+  * @brief      the firmware configuration with what the host simulation needs
+  *             on top: the idle hook hands the virtual clock to the next event,
+  *             a failed assert ends the run instead of spinning, the heap is
+  *             doubled for the 8 byte stack words and the trace hooks feed the
+  *             response time statistics of sim_port.c.
+  *             固件配置加上主机仿真需要的部分: 空闲钩子把虚拟时钟推进到下一个事件,
+  *             断言失败时结束仿真而不是死循环, 栈元素为8字节所以堆加倍,
+  *             跟踪钩子为sim_port.c提供响应时间统计
+  */
+#ifndef SIM_FREERTOS_CONFIG_H
+#define SIM_FREERTOS_CONFIG_H
+
+#include_next "FreeRTOSConfig.h"
+
+extern void sim_fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+extern void sim_trace_ready(void *p_tcb, unsigned long priority, const char *name);
+extern void sim_trace_switched_out(long still_ready);
+extern void sim_trace_switched_in(void);
+
+#undef configASSERT
+#define configASSERT(x) if ((x) == 0) {sim_fail("configASSERT %s:%d", __FILE__, __LINE__);}
+
+#undef configUSE_IDLE_HOOK
+#define configUSE_IDLE_HOOK         1
+
+#undef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE       ((size_t)(51200 * 2))
+
+//在tasks.c中展开, 切出时仍在就绪列表中为被抢占, 否则为阻塞, 即本次作业完成
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB)   sim_trace_ready(pxTCB, (pxTCB)->uxPriority, (pxTCB)->pcTaskName)
+#define traceTASK_SWITCHED_OUT()                                                \
+    sim_trace_switched_out(listIS_CONTAINED_WITHIN(&(pxReadyTasksLists[pxCurrentTCB->uxPriority]), \
+                                                   &(pxCurrentTCB->xStateListItem)))
+#define traceTASK_SWITCHED_IN()                 sim_trace_switched_in()
+
+#endif
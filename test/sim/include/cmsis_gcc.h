@@ -0,0 +1,7 @@
+/**
+  * @file       cmsis_gcc.h
+  * @brief      cmsis_os.c includes cmsis_gcc.h by name, this takes its place
+  *             in the host simulation so it gets the host intrinsics too.
+  *             cmsis_os.c直接包含cmsis_gcc.h, 主机仿真中由此换成主机版内核函数
+  */
+#include "cmsis_host.h"
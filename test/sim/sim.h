@@ -0,0 +1,179 @@
+/**
+  * @file       sim.h
+  * @brief      host simulation of the board. The firmware runs unchanged on host
+  *             threads, one at a time. The host time spent between two sync
+  *             points (HAL calls, critical sections, register hooks) is scaled
+  *             into CPU cycles of a virtual 168 MHz clock, device models post
+  *             events on that clock and raise interrupts through a simulated
+  *             NVIC, which are taken at the next sync point whose execution
+  *             priority allows them.
+  *             板级主机仿真. 固件不做修改运行在主机线程上, 同一时刻只运行一个线程.
+  *             两个同步点(HAL调用、临界区、寄存器钩子)之间消耗的主机时间按比例
+  *             折算为168MHz虚拟时钟的周期数, 设备模型在该时钟上安排事件并通过
+  *             仿真NVIC挂起中断, 中断在下一个执行优先级允许的同步点响应
+  */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "stm32f4xx.h"
+
+#define SIM_CPU_HZ          168000000U
+#define SIM_US(us)          ((sim_time_t) (us) * (SIM_CPU_HZ / 1000000U))
+#define SIM_MS(ms)          ((sim_time_t) (ms) * (SIM_CPU_HZ / 1000U))
+#define SIM_TO_US(t)        ((double) (t) / (SIM_CPU_HZ / 1000000U))
+
+//NVIC中断号范围, SysTick为-1
+#define SIM_IRQ_MIN         (-1)
+#define SIM_IRQ_NUM         (FPU_IRQn + 1)
+
+typedef uint64_t sim_time_t;        //上电后的CPU周期数
+
+typedef void (*sim_event_f)(void *arg);
+
+typedef struct {
+    sim_time_t time;
+    uint64_t seq;                   //同一时刻按安排顺序执行
+    sim_event_f fn;
+    void *arg;
+    int32_t index;                  //在事件堆中的位置, -1为未排队
+} sim_event_t;
+
+//CPU时间的记账对象: 任务、中断或启动代码
+typedef struct {
+    const char *name;
+    uint64_t busy;                  //独占执行的周期数, 不含嵌套中断
+} sim_account_t;
+
+typedef struct {
+    double cpu_scale;               //目标CPU比主机慢的倍数
+    double segment_max_us;          //两个同步点之间主机时间的上限
+    sim_time_t duration;
+    sim_time_t settle;              //启动阶段, 之前的作业和中断不计入响应时间统计
+    const char *rtt_path;           //RTT通道0输出文件, NULL不输出
+    const char *usb_path;           //USB CDC输出文件, NULL不输出
+    const char *referee_path;       //发往裁判系统的串口6数据, NULL不输出
+    int quiet;
+} sim_option_t;
+
+extern sim_option_t sim_option;
+extern sim_time_t sim_now;
+
+/* ---------------- 事件 ---------------- */
+extern void sim_event_init(sim_event_t *p_event, sim_event_f fn, void *arg);
+extern void sim_event_at(sim_event_t *p_event, sim_time_t time);
+extern void sim_event_cancel(sim_event_t *p_event);
+#define sim_event_queued(p_event)   ((p_event)->index >= 0)
+
+/* ---------------- NVIC ---------------- */
+extern void sim_irq_pend(IRQn_Type irq);
+extern void sim_irq_set_priority(IRQn_Type irq, uint32_t priority);
+extern void sim_irq_enable(IRQn_Type irq, int enable);
+extern int sim_irq_enabled(IRQn_Type irq);
+//中断返回后调用, 用于清除硬件在读寄存器时清除的标志或电平触发的重新挂起
+extern void sim_irq_set_exit_hook(IRQn_Type irq, void (*fn)(void));
+
+/* ---------------- 执行 ---------------- */
+//同步点: 把上一同步点以来的主机时间计入虚拟时钟, 处理到期事件和可响应的中断
+extern void sim_sync(void);
+//当前上下文忙等若干周期, 期间可以响应中断
+extern void sim_busy(sim_time_t cycles);
+//CPU停顿若干周期(Flash擦写时取指停顿), 中断推迟到停顿结束
+extern void sim_stall(sim_time_t cycles);
+//空闲任务中调用, 时钟直接推进到下一个事件
+extern void sim_idle(void);
+//PRIMASK和BASEPRI写入
+extern void sim_primask_write(uint32_t primask);
+extern void sim_basepri_write(uint32_t basepri);
+extern uint32_t sim_in_isr(void);
+
+//执行上下文
+extern void sim_cpu_set_base(sim_account_t *p_account);
+extern void sim_cpu_request_switch(void);
+extern void sim_cpu_start(void);
+extern uint64_t sim_host_ns(void);
+extern void sim_cpu_restart_segment(void);
+extern uint64_t sim_cpu_isr_busy(void);
+
+//调度(sim_port.c)
+extern int sim_port_switch_allowed(void);
+extern void sim_port_switch(void);
+//按任务名设置截止时间和每次阻塞前注入的执行时间
+extern void sim_port_set_deadline(const char *name, double us);
+extern void sim_port_add_exec(const char *name, double us);
+
+/* ---------------- 外设 ---------------- */
+extern void sim_mem_init(void);
+extern void sim_periph_init(void);
+extern void sim_periph_poll(void);
+extern void sim_periph_gpio_write(GPIO_TypeDef *port, uint16_t pin, int state);
+extern int sim_periph_gpio_read(GPIO_TypeDef *port, uint16_t pin);
+extern void sim_periph_exti_raise(uint16_t pin);
+extern void sim_periph_report(FILE *fp);
+
+//DMA流: 设备在传输结束时读写内存并置完成标志
+typedef struct sim_dma_stream sim_dma_stream_t;
+typedef void (*sim_dma_start_f)(sim_dma_stream_t *p_stream);
+struct sim_dma_stream {
+    DMA_TypeDef *dma;
+    DMA_Stream_TypeDef *regs;
+    uint8_t index;
+    IRQn_Type irq;
+    uint8_t enabled;                //仿真看到的EN
+    uint32_t m0ar;                  //启动时锁存
+    uint16_t ndtr;                  //启动时锁存, 也是双缓冲的重装值
+    uint16_t sim_ndtr;              //仿真最后写入NDTR的值
+    sim_dma_start_f start;          //EN 0->1时调用, NULL为接收流
+    sim_event_t done;
+};
+extern sim_dma_stream_t *sim_dma_stream(DMA_TypeDef *dma, uint8_t index);
+extern sim_dma_stream_t *sim_dma_stream_of(const DMA_Stream_TypeDef *regs);
+extern void sim_dma_complete(sim_dma_stream_t *p_stream);
+extern uint16_t sim_dma_receive(sim_dma_stream_t *p_stream, const uint8_t *p_data, uint16_t len);
+
+//串口: 接收帧经DMA写入后一个字符时间置IDLE
+extern void sim_uart_receive(USART_TypeDef *uart, const uint8_t *p_data, uint16_t len);
+extern sim_time_t sim_uart_byte_time(USART_TypeDef *uart);
+typedef void (*sim_uart_sink_f)(const uint8_t *p_data, uint16_t len);
+extern void sim_uart_set_sink(USART_TypeDef *uart, sim_uart_sink_f sink);
+
+//SPI1上的BMI088, 以片选区分加速度计和陀螺仪, 片选拉低后第一个字节为地址
+extern void sim_bmi088_select(int accel_low, int gyro_low);
+extern uint8_t sim_bmi088_transfer(uint8_t tx);
+//I2C3上的IST8310
+extern void sim_ist8310_read(uint8_t reg, uint8_t *p_data, uint16_t len);
+extern void sim_ist8310_write(uint8_t reg, const uint8_t *p_data, uint16_t len);
+
+/* ---------------- HAL ---------------- */
+extern void sim_hal_init(void);
+extern uint32_t sim_hal_pclk1(void);
+extern uint32_t sim_hal_pclk2(void);
+
+/* ---------------- CAN ---------------- */
+typedef struct {
+    uint16_t std_id;
+    uint8_t dlc;
+    uint8_t data[8];
+} sim_can_frame_t;
+typedef void (*sim_can_node_f)(const sim_can_frame_t *p_frame);
+extern void sim_can_init(void);
+//其他节点发送一帧, 参与总线仲裁
+extern void sim_can_node_send(CAN_TypeDef *can, const sim_can_frame_t *p_frame);
+extern void sim_can_set_listener(CAN_TypeDef *can, sim_can_node_f listener);
+extern void sim_can_report(FILE *fp, sim_time_t elapsed);
+
+/* ---------------- 被控对象 ---------------- */
+extern void sim_robot_init(void);
+extern void sim_robot_report(FILE *fp);
+extern uint32_t sim_adc_value(ADC_TypeDef *adc, uint32_t channel);
+extern void sim_usb_init(void);
+extern void sim_usb_report(FILE *fp);
+
+/* ---------------- 报告 ---------------- */
+extern void sim_port_report(FILE *fp, sim_time_t elapsed, int *p_misses);
+extern void sim_cpu_report(FILE *fp, sim_time_t elapsed);
+extern void sim_finish(const char *reason);
+extern void sim_fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+#endif
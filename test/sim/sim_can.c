@@ -0,0 +1,334 @@
+/**
+  * @file       sim_can.c
+  * @brief      the two bxCAN controllers and their buses. A bus sends one frame
+  *             at a time; when it goes idle the lowest identifier among the
+  *             firmware mailboxes and the other nodes wins, the frame takes its
+  *             bit time on the bus, then it completes the mailbox or lands in
+  *             the three frame receive FIFO, which overruns like the hardware.
+  *             HAL_CAN_IRQHandler calls the same callbacks as the real HAL and
+  *             the receive interrupt is level triggered while the FIFO is not
+  *             empty.
+  *             两个bxCAN控制器和总线. 总线一次传一帧, 空闲时在固件邮箱和其他节点中
+  *             标识符最小的获得总线, 按位时间传输后完成邮箱或进入3帧接收FIFO, FIFO
+  *             满时与硬件一样溢出. HAL_CAN_IRQHandler调用与真实HAL相同的回调, FIFO非空
+  *             时接收中断保持挂起
+  */
+#include "sim.h"
+#include "main.h"
+#include <string.h>
+
+#define SIM_CAN_MAILBOX_NUM     3
+#define SIM_CAN_FIFO_LEN        3
+#define SIM_CAN_NODE_QUEUE_LEN  32
+#define SIM_CAN_ON_NODE         SIM_CAN_MAILBOX_NUM
+#define SIM_CAN_IDLE            (-1)
+
+typedef enum {
+    CAN_TX_NONE = 0,
+    CAN_TX_OK,
+    CAN_TX_ABORTED,
+    CAN_TX_LOST,                    //关闭自动重传时仲裁失败
+} sim_can_tx_e;
+
+typedef struct {
+    CAN_TypeDef *can;
+    CAN_HandleTypeDef *hcan;
+    IRQn_Type tx_irq;
+    IRQn_Type rx0_irq;
+    uint8_t started;
+    sim_time_t bit_time;
+    sim_can_frame_t mailbox[SIM_CAN_MAILBOX_NUM];
+    uint8_t mailbox_pending;        //按位
+    uint8_t tx_result[SIM_CAN_MAILBOX_NUM];
+    sim_can_frame_t fifo[SIM_CAN_FIFO_LEN];
+    uint8_t fifo_head;
+    uint8_t fifo_num;
+    sim_can_frame_t node_queue[SIM_CAN_NODE_QUEUE_LEN];
+    uint8_t node_head;
+    uint8_t node_num;
+    int32_t on_bus;
+    sim_event_t done;
+    sim_can_node_f listener;
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+    uint32_t rx_overrun;
+    uint32_t node_dropped;
+    uint64_t bus_busy;
+} sim_can_t;
+
+static sim_can_t can_bus[2];
+
+static sim_can_t *can_get(const CAN_TypeDef *can) {
+    return (can == CAN1) ? &can_bus[0] : &can_bus[1];
+}
+
+//标准帧: 44位帧头帧尾加数据, 3位帧间隔, 平均约每8位一个填充位
+static sim_time_t can_frame_time(const sim_can_t *p_bus, uint8_t dlc) {
+    uint32_t bits = 44U + 8U * dlc;
+    return (sim_time_t) (bits + 3U + (bits - 10U) / 8U) * p_bus->bit_time;
+}
+
+static void can_arbitrate(sim_can_t *p_bus) {
+    int32_t winner = SIM_CAN_IDLE;
+    uint16_t winner_id = 0xFFFFU;
+
+    if (p_bus->on_bus != SIM_CAN_IDLE || !p_bus->started) {
+        return;
+    }
+    //邮箱之间按标识符优先
+    for (int32_t i = 0; i < SIM_CAN_MAILBOX_NUM; i++) {
+        if ((p_bus->mailbox_pending & (1U << i)) && p_bus->mailbox[i].std_id < winner_id) {
+            winner = i;
+            winner_id = p_bus->mailbox[i].std_id;
+        }
+    }
+    if (p_bus->node_num > 0U && p_bus->node_queue[p_bus->node_head].std_id < winner_id) {
+        if (winner != SIM_CAN_IDLE && p_bus->hcan->Init.AutoRetransmission == DISABLE) {
+            p_bus->mailbox_pending &= ~(1U << winner);
+            p_bus->tx_result[winner] = CAN_TX_LOST;
+            if (p_bus->can->IER & CAN_IER_TMEIE) {
+                sim_irq_pend(p_bus->tx_irq);
+            }
+        }
+        winner = SIM_CAN_ON_NODE;
+    }
+    if (winner == SIM_CAN_IDLE) {
+        return;
+    }
+    p_bus->on_bus = winner;
+    sim_time_t time = can_frame_time(p_bus, (winner == SIM_CAN_ON_NODE) ? p_bus->node_queue[p_bus->node_head].dlc
+                                                                        : p_bus->mailbox[winner].dlc);
+    p_bus->bus_busy += time;
+    sim_event_at(&p_bus->done, sim_now + time);
+}
+
+static void can_done_fn(void *arg) {
+    sim_can_t *p_bus = arg;
+    int32_t on_bus = p_bus->on_bus;
+
+    p_bus->on_bus = SIM_CAN_IDLE;
+    if (on_bus == SIM_CAN_ON_NODE) {
+        const sim_can_frame_t *p_frame = &p_bus->node_queue[p_bus->node_head];
+        if (p_bus->fifo_num < SIM_CAN_FIFO_LEN) {
+            p_bus->fifo[(p_bus->fifo_head + p_bus->fifo_num) % SIM_CAN_FIFO_LEN] = *p_frame;
+            p_bus->fifo_num++;
+            p_bus->rx_frames++;
+        } else {
+            p_bus->rx_overrun++;
+        }
+        p_bus->node_head = (uint8_t) ((p_bus->node_head + 1U) % SIM_CAN_NODE_QUEUE_LEN);
+        p_bus->node_num--;
+        if (p_bus->fifo_num > 0U && (p_bus->can->IER & CAN_IER_FMPIE0)) {
+            sim_irq_pend(p_bus->rx0_irq);
+        }
+    } else {
+        p_bus->mailbox_pending &= ~(1U << on_bus);
+        p_bus->tx_result[on_bus] = CAN_TX_OK;
+        p_bus->tx_frames++;
+        if (p_bus->listener != NULL) {
+            p_bus->listener(&p_bus->mailbox[on_bus]);
+        }
+        if (p_bus->can->IER & CAN_IER_TMEIE) {
+            sim_irq_pend(p_bus->tx_irq);
+        }
+    }
+    can_arbitrate(p_bus);
+}
+
+//FIFO非空时接收中断为电平触发
+static void can_rx0_exit(sim_can_t *p_bus) {
+    if (p_bus->fifo_num > 0U && (p_bus->can->IER & CAN_IER_FMPIE0)) {
+        sim_irq_pend(p_bus->rx0_irq);
+    }
+}
+
+static void can1_rx0_exit(void) {
+    can_rx0_exit(&can_bus[0]);
+}
+
+static void can2_rx0_exit(void) {
+    can_rx0_exit(&can_bus[1]);
+}
+
+void sim_can_node_send(CAN_TypeDef *can, const sim_can_frame_t *p_frame) {
+    sim_can_t *p_bus = can_get(can);
+
+    if (!p_bus->started || p_bus->node_num >= SIM_CAN_NODE_QUEUE_LEN) {
+        p_bus->node_dropped++;
+        return;
+    }
+    p_bus->node_queue[(p_bus->node_head + p_bus->node_num) % SIM_CAN_NODE_QUEUE_LEN] = *p_frame;
+    p_bus->node_num++;
+    can_arbitrate(p_bus);
+}
+
+void sim_can_set_listener(CAN_TypeDef *can, sim_can_node_f listener) {
+    can_get(can)->listener = listener;
+}
+
+/* ---------------- HAL ---------------- */
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+    uint32_t tq_num = 1U + ((hcan->Init.TimeSeg1 >> CAN_BTR_TS1_Pos) + 1U) +
+                      ((hcan->Init.TimeSeg2 >> CAN_BTR_TS2_Pos) + 1U);
+
+    if (hcan->State == HAL_CAN_STATE_RESET) {
+        HAL_CAN_MspInit(hcan);
+    }
+    p_bus->hcan = hcan;
+    p_bus->bit_time = (sim_time_t) hcan->Init.Prescaler * tq_num * SystemCoreClock / HAL_RCC_GetPCLK1Freq();
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig) {
+    (void) hcan;
+    (void) sFilterConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+
+    sim_sync();
+    p_bus->started = 1;
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    can_arbitrate(p_bus);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs) {
+    hcan->Instance->IER |= ActiveITs;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+    uint32_t level = 0;
+
+    sim_sync();
+    for (int32_t i = 0; i < SIM_CAN_MAILBOX_NUM; i++) {
+        if (!(p_bus->mailbox_pending & (1U << i))) {
+            level++;
+        }
+    }
+    return level;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[],
+                                       uint32_t *pTxMailbox) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+
+    sim_sync();
+    for (int32_t i = 0; i < SIM_CAN_MAILBOX_NUM; i++) {
+        if (!(p_bus->mailbox_pending & (1U << i))) {
+            p_bus->mailbox[i].std_id = (uint16_t) pHeader->StdId;
+            p_bus->mailbox[i].dlc = (uint8_t) pHeader->DLC;
+            memcpy(p_bus->mailbox[i].data, aData, pHeader->DLC);
+            p_bus->mailbox_pending |= (uint8_t) (1U << i);
+            *pTxMailbox = CAN_TX_MAILBOX0 << i;
+            can_arbitrate(p_bus);
+            return HAL_OK;
+        }
+    }
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+    return HAL_ERROR;
+}
+
+//正在总线上发送的帧不能取消
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+
+    sim_sync();
+    for (int32_t i = 0; i < SIM_CAN_MAILBOX_NUM; i++) {
+        if ((TxMailboxes & (CAN_TX_MAILBOX0 << i)) && (p_bus->mailbox_pending & (1U << i)) && p_bus->on_bus != i) {
+            p_bus->mailbox_pending &= ~(1U << i);
+            p_bus->tx_result[i] = CAN_TX_ABORTED;
+            if (hcan->Instance->IER & CAN_IER_TMEIE) {
+                sim_irq_pend(p_bus->tx_irq);
+            }
+        }
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader,
+                                       uint8_t aData[]) {
+    sim_can_t *p_bus = can_get(hcan->Instance);
+    const sim_can_frame_t *p_frame;
+
+    if (RxFifo != CAN_RX_FIFO0 || p_bus->fifo_num == 0U) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    p_frame = &p_bus->fifo[p_bus->fifo_head];
+    pHeader->StdId = p_frame->std_id;
+    pHeader->ExtId = 0;
+    pHeader->IDE = CAN_ID_STD;
+    pHeader->RTR = CAN_RTR_DATA;
+    pHeader->DLC = p_frame->dlc;
+    pHeader->Timestamp = 0;
+    pHeader->FilterMatchIndex = 0;
+    memcpy(aData, p_frame->data, p_frame->dlc);
+    p_bus->fifo_head = (uint8_t) ((p_bus->fifo_head + 1U) % SIM_CAN_FIFO_LEN);
+    p_bus->fifo_num--;
+    return HAL_OK;
+}
+
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan) {
+    static void (*const complete[SIM_CAN_MAILBOX_NUM])(CAN_HandleTypeDef *) = {
+            HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback,
+            HAL_CAN_TxMailbox2CompleteCallback};
+    static void (*const abort[SIM_CAN_MAILBOX_NUM])(CAN_HandleTypeDef *) = {
+            HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback, HAL_CAN_TxMailbox2AbortCallback};
+    static const uint32_t lost_error[SIM_CAN_MAILBOX_NUM] = {
+            HAL_CAN_ERROR_TX_ALST0, HAL_CAN_ERROR_TX_ALST1, HAL_CAN_ERROR_TX_ALST2};
+    sim_can_t *p_bus = can_get(hcan->Instance);
+
+    if (hcan->Instance->IER & CAN_IER_TMEIE) {
+        for (int32_t i = 0; i < SIM_CAN_MAILBOX_NUM; i++) {
+            uint8_t result = p_bus->tx_result[i];
+            p_bus->tx_result[i] = CAN_TX_NONE;
+            if (result == CAN_TX_OK) {
+                complete[i](hcan);
+            } else if (result == CAN_TX_ABORTED) {
+                abort[i](hcan);
+            } else if (result == CAN_TX_LOST) {
+                hcan->ErrorCode |= lost_error[i];
+            }
+        }
+    }
+    if ((hcan->Instance->IER & CAN_IER_FMPIE0) && p_bus->fifo_num > 0U) {
+        HAL_CAN_RxFifo0MsgPendingCallback(hcan);
+    }
+    if (hcan->ErrorCode != HAL_CAN_ERROR_NONE) {
+        HAL_CAN_ErrorCallback(hcan);
+    }
+}
+
+void sim_can_init(void) {
+    memset(can_bus, 0, sizeof(can_bus));
+    can_bus[0].can = CAN1;
+    can_bus[0].tx_irq = CAN1_TX_IRQn;
+    can_bus[0].rx0_irq = CAN1_RX0_IRQn;
+    can_bus[1].can = CAN2;
+    can_bus[1].tx_irq = CAN2_TX_IRQn;
+    can_bus[1].rx0_irq = CAN2_RX0_IRQn;
+    for (int32_t i = 0; i < 2; i++) {
+        can_bus[i].on_bus = SIM_CAN_IDLE;
+        can_bus[i].bit_time = SIM_US(1);
+        sim_event_init(&can_bus[i].done, can_done_fn, &can_bus[i]);
+    }
+    sim_irq_set_exit_hook(CAN1_RX0_IRQn, can1_rx0_exit);
+    sim_irq_set_exit_hook(CAN2_RX0_IRQn, can2_rx0_exit);
+}
+
+void sim_can_report(FILE *fp, sim_time_t elapsed) {
+    fprintf(fp, "\n%-5s %9s %9s %9s %9s %7s\n", "can", "tx", "rx", "overrun", "dropped", "load%");
+    for (int32_t i = 0; i < 2; i++) {
+        fprintf(fp, "CAN%d  %9u %9u %9u %9u %7.2f\n", i + 1, can_bus[i].tx_frames, can_bus[i].rx_frames,
+                can_bus[i].rx_overrun, can_bus[i].node_dropped, 100.0 * (double) can_bus[i].bus_busy / (double) elapsed);
+    }
+}
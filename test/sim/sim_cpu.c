@@ -0,0 +1,528 @@
+/**
+  * @file       sim_cpu.c
+  * @brief      virtual CPU clock, event queue and NVIC of the host simulation.
+  *             Host time between two sync points is charged to the context
+  *             on top of the execution stack (task, interrupt or boot code). When
+  *             an event inside that time raises an interrupt the clock stops at
+  *             the event, the interrupt or the context switch it causes runs
+  *             first and the interrupted code pays the rest of its time when it
+  *             resumes, so preemption happens at the right virtual time even
+  *             though the host only notices it at the sync point.
+  *             主机仿真的虚拟CPU时钟、事件队列和NVIC. 两个同步点之间的主机时间
+  *             计入执行栈顶的上下文(任务、中断或启动代码). 若这段时间内的事件触发
+  *             中断, 时钟停在事件时刻, 先执行中断或其引起的任务切换, 被打断的代码
+  *             恢复后再补足剩余时间, 因此虽然主机在同步点才发现抢占, 抢占仍发生在
+  *             正确的虚拟时刻
+  */
+#include "sim.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_EVENT_MAX           256
+#define SIM_CTX_MAX             (SIM_IRQ_NUM + 2)
+//同步点本身的最小代价, 保证读寄存器的忙等循环向前推进
+#define SIM_SYNC_CYCLES         12U
+//Cortex-M4异常进入和返回各约12周期
+#define SIM_EXCEPTION_CYCLES    12U
+#define SIM_PRIORITY_NONE       256U
+
+typedef struct {
+    void (*handler)(void);
+    void (*exit_hook)(void);
+    uint8_t priority;
+    uint8_t enabled;
+    uint8_t pending;
+    uint8_t active;
+    sim_time_t pend_time;
+    sim_account_t account;
+    uint32_t count;
+    sim_time_t max_latency;         //挂起到进入
+    sim_time_t max_response;        //挂起到返回, 含嵌套中断
+} sim_irq_t;
+
+typedef struct {
+    sim_account_t *account;
+    uint32_t priority;
+} sim_ctx_t;
+
+sim_time_t sim_now = 0;
+
+volatile uint32_t host_primask = 0;
+volatile uint32_t host_ipsr = 0;
+volatile uint32_t host_basepri = 0;
+uint32_t host_irq_disable_count = 0;
+
+static sim_event_t *event_heap[SIM_EVENT_MAX];
+static int32_t event_num = 0;
+static uint64_t event_seq = 0;
+
+static sim_irq_t irq_table[SIM_IRQ_NUM + 1];
+static sim_ctx_t ctx_stack[SIM_CTX_MAX];
+static int32_t ctx_depth = 0;
+
+static sim_account_t boot_account = {"boot", 0};
+
+static struct {
+    uint64_t seg_start;             //当前段开始时的主机时间
+    uint64_t overhead_ns;           //一次读主机时钟的开销
+    uint64_t cycles_per_us;         //每主机微秒折算的目标周期数
+    uint64_t segment_max_ns;        //一段的上限, 超出部分视为主机噪声
+    uint64_t segment_num;
+    uint64_t segment_clamped;
+    sim_time_t mask_start;          //PRIMASK或BASEPRI开始屏蔽的时刻
+    sim_time_t mask_max;
+    sim_time_t mask_max_at;
+    const char *mask_max_name;
+    uint8_t switch_pending;
+    uint32_t stall;
+} cpu;
+
+//固件中的中断服务函数, 未定义的为NULL
+#define SIM_VECTORS(X)                                      \
+    X(PVD_IRQn, PVD_IRQHandler)                             \
+    X(EXTI0_IRQn, EXTI0_IRQHandler)                         \
+    X(EXTI1_IRQn, EXTI1_IRQHandler)                         \
+    X(EXTI2_IRQn, EXTI2_IRQHandler)                         \
+    X(EXTI3_IRQn, EXTI3_IRQHandler)                         \
+    X(EXTI4_IRQn, EXTI4_IRQHandler)                         \
+    X(EXTI9_5_IRQn, EXTI9_5_IRQHandler)                     \
+    X(EXTI15_10_IRQn, EXTI15_10_IRQHandler)                 \
+    X(DMA1_Stream0_IRQn, DMA1_Stream0_IRQHandler)           \
+    X(DMA1_Stream1_IRQn, DMA1_Stream1_IRQHandler)           \
+    X(DMA1_Stream2_IRQn, DMA1_Stream2_IRQHandler)           \
+    X(DMA1_Stream3_IRQn, DMA1_Stream3_IRQHandler)           \
+    X(DMA1_Stream4_IRQn, DMA1_Stream4_IRQHandler)           \
+    X(DMA1_Stream5_IRQn, DMA1_Stream5_IRQHandler)           \
+    X(DMA1_Stream6_IRQn, DMA1_Stream6_IRQHandler)           \
+    X(DMA1_Stream7_IRQn, DMA1_Stream7_IRQHandler)           \
+    X(DMA2_Stream0_IRQn, DMA2_Stream0_IRQHandler)           \
+    X(DMA2_Stream1_IRQn, DMA2_Stream1_IRQHandler)           \
+    X(DMA2_Stream2_IRQn, DMA2_Stream2_IRQHandler)           \
+    X(DMA2_Stream3_IRQn, DMA2_Stream3_IRQHandler)           \
+    X(DMA2_Stream4_IRQn, DMA2_Stream4_IRQHandler)           \
+    X(DMA2_Stream5_IRQn, DMA2_Stream5_IRQHandler)           \
+    X(DMA2_Stream6_IRQn, DMA2_Stream6_IRQHandler)           \
+    X(DMA2_Stream7_IRQn, DMA2_Stream7_IRQHandler)           \
+    X(CAN1_TX_IRQn, CAN1_TX_IRQHandler)                     \
+    X(CAN1_RX0_IRQn, CAN1_RX0_IRQHandler)                   \
+    X(CAN1_RX1_IRQn, CAN1_RX1_IRQHandler)                   \
+    X(CAN1_SCE_IRQn, CAN1_SCE_IRQHandler)                   \
+    X(CAN2_TX_IRQn, CAN2_TX_IRQHandler)                     \
+    X(CAN2_RX0_IRQn, CAN2_RX0_IRQHandler)                   \
+    X(CAN2_RX1_IRQn, CAN2_RX1_IRQHandler)                   \
+    X(CAN2_SCE_IRQn, CAN2_SCE_IRQHandler)                   \
+    X(TIM1_UP_TIM10_IRQn, TIM1_UP_TIM10_IRQHandler)         \
+    X(TIM2_IRQn, TIM2_IRQHandler)                           \
+    X(TIM3_IRQn, TIM3_IRQHandler)                           \
+    X(TIM4_IRQn, TIM4_IRQHandler)                           \
+    X(TIM5_IRQn, TIM5_IRQHandler)                           \
+    X(TIM6_DAC_IRQn, TIM6_DAC_IRQHandler)                   \
+    X(TIM7_IRQn, TIM7_IRQHandler)                           \
+    X(USART1_IRQn, USART1_IRQHandler)                       \
+    X(USART2_IRQn, USART2_IRQHandler)                       \
+    X(USART3_IRQn, USART3_IRQHandler)                       \
+    X(USART6_IRQn, USART6_IRQHandler)                       \
+    X(SPI1_IRQn, SPI1_IRQHandler)                           \
+    X(I2C3_EV_IRQn, I2C3_EV_IRQHandler)                     \
+    X(OTG_FS_IRQn, OTG_FS_IRQHandler)
+
+#define SIM_VECTOR_DECLARE(irq, fn) extern void fn(void) __attribute__((weak));
+SIM_VECTORS(SIM_VECTOR_DECLARE)
+extern void SysTick_Handler(void);
+
+#define irq_entry(irq) (&irq_table[(irq) + 1])
+
+/* ---------------- 事件堆 ---------------- */
+
+static int event_before(const sim_event_t *a, const sim_event_t *b) {
+    return (a->time < b->time) || (a->time == b->time && a->seq < b->seq);
+}
+
+static void event_place(sim_event_t *p_event, int32_t index) {
+    event_heap[index] = p_event;
+    p_event->index = index;
+}
+
+static void event_sift_up(int32_t index) {
+    sim_event_t *p_event = event_heap[index];
+    while (index > 0) {
+        int32_t parent = (index - 1) / 2;
+        if (!event_before(p_event, event_heap[parent])) {
+            break;
+        }
+        event_place(event_heap[parent], index);
+        index = parent;
+    }
+    event_place(p_event, index);
+}
+
+static void event_sift_down(int32_t index) {
+    sim_event_t *p_event = event_heap[index];
+    for (;;) {
+        int32_t child = index * 2 + 1;
+        if (child >= event_num) {
+            break;
+        }
+        if (child + 1 < event_num && event_before(event_heap[child + 1], event_heap[child])) {
+            child++;
+        }
+        if (!event_before(event_heap[child], p_event)) {
+            break;
+        }
+        event_place(event_heap[child], index);
+        index = child;
+    }
+    event_place(p_event, index);
+}
+
+void sim_event_init(sim_event_t *p_event, sim_event_f fn, void *arg) {
+    p_event->time = 0;
+    p_event->seq = 0;
+    p_event->fn = fn;
+    p_event->arg = arg;
+    p_event->index = -1;
+}
+
+void sim_event_cancel(sim_event_t *p_event) {
+    int32_t index = p_event->index;
+    if (index < 0) {
+        return;
+    }
+    p_event->index = -1;
+    event_num--;
+    if (index == event_num) {
+        return;
+    }
+    sim_event_t *p_last = event_heap[event_num];
+    event_place(p_last, index);
+    event_sift_up(index);
+    event_sift_down(p_last->index);
+}
+
+void sim_event_at(sim_event_t *p_event, sim_time_t time) {
+    sim_event_cancel(p_event);
+    if (event_num >= SIM_EVENT_MAX) {
+        sim_fail("event queue full");
+    }
+    p_event->time = time;
+    p_event->seq = event_seq++;
+    event_place(p_event, event_num++);
+    event_sift_up(p_event->index);
+}
+
+//执行到期的事件, 事件回调只改变设备状态和挂起中断, 不调用固件
+static void event_run_due(void) {
+    while (event_num > 0 && event_heap[0]->time <= sim_now) {
+        sim_event_t *p_event = event_heap[0];
+        sim_event_cancel(p_event);
+        p_event->fn(p_event->arg);
+    }
+}
+
+/* ---------------- NVIC ---------------- */
+
+void sim_irq_pend(IRQn_Type irq) {
+    sim_irq_t *p_irq = irq_entry(irq);
+    if (!p_irq->pending) {
+        p_irq->pending = 1;
+        p_irq->pend_time = sim_now;
+    }
+}
+
+void sim_irq_set_priority(IRQn_Type irq, uint32_t priority) {
+    irq_entry(irq)->priority = (uint8_t) (priority & 0x0FU);
+}
+
+void sim_irq_enable(IRQn_Type irq, int enable) {
+    irq_entry(irq)->enabled = enable ? 1U : 0U;
+}
+
+int sim_irq_enabled(IRQn_Type irq) {
+    return irq_entry(irq)->enabled;
+}
+
+void sim_irq_set_exit_hook(IRQn_Type irq, void (*fn)(void)) {
+    irq_entry(irq)->exit_hook = fn;
+}
+
+//当前执行优先级下可以响应的最高优先级中断, 没有返回SIM_IRQ_NUM
+static int32_t irq_next(void) {
+    uint32_t exec = ctx_stack[ctx_depth].priority;
+    int32_t best = SIM_IRQ_NUM;
+    uint32_t best_priority = SIM_PRIORITY_NONE;
+
+    if (host_primask || cpu.stall) {
+        return SIM_IRQ_NUM;
+    }
+    if (host_basepri != 0U && (host_basepri >> 4) < exec) {
+        exec = host_basepri >> 4;
+    }
+    for (int32_t irq = SIM_IRQ_MIN; irq < SIM_IRQ_NUM; irq++) {
+        const sim_irq_t *p_irq = irq_entry(irq);
+        if (p_irq->pending && p_irq->enabled && p_irq->priority < exec && p_irq->priority < best_priority) {
+            best = irq;
+            best_priority = p_irq->priority;
+        }
+    }
+    return best;
+}
+
+/* ---------------- 执行 ---------------- */
+
+//同一时刻只有一个线程在运行, 单调时钟即为它的执行时间. 线程CPU时间要走系统调用,
+//每次读取约300ns且上下波动100ns, 乘以倍率后淹没短中断本身; 单调时钟在vDSO中读取约35ns
+uint64_t sim_host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void sim_cpu_restart_segment(void) {
+    cpu.seg_start = sim_host_ns();
+}
+
+//上一同步点以来的主机时间折算的周期数
+static sim_time_t cpu_measure(void) {
+    uint64_t now_ns = sim_host_ns();
+    uint64_t elapsed = now_ns - cpu.seg_start;
+
+    elapsed = (elapsed > cpu.overhead_ns) ? elapsed - cpu.overhead_ns : 0U;
+    //主机时钟中断、其他进程抢占使个别段变长, 固件两个同步点之间不会有这么长的代码
+    cpu.segment_num++;
+    if (elapsed > cpu.segment_max_ns) {
+        elapsed = cpu.segment_max_ns;
+        cpu.segment_clamped++;
+    }
+    return elapsed * cpu.cycles_per_us / 1000U + SIM_SYNC_CYCLES;
+}
+
+static void cpu_charge(sim_time_t cycles) {
+    ctx_stack[ctx_depth].account->busy += cycles;
+    sim_now += cycles;
+}
+
+static void cpu_consume(sim_time_t owed);
+
+static void irq_dispatch(int32_t irq) {
+    sim_irq_t *p_irq = irq_entry(irq);
+    uint32_t saved_ipsr = host_ipsr;
+    sim_time_t pend_time = p_irq->pend_time;
+    sim_time_t latency = sim_now - pend_time;
+
+    p_irq->pending = 0;
+    p_irq->active = 1;
+    if (pend_time >= sim_option.settle && latency > p_irq->max_latency) {
+        p_irq->max_latency = latency;
+    }
+    ctx_depth++;
+    ctx_stack[ctx_depth].account = &p_irq->account;
+    ctx_stack[ctx_depth].priority = p_irq->priority;
+    host_ipsr = (uint32_t) (irq + 16);
+
+    cpu_consume(SIM_EXCEPTION_CYCLES);
+    cpu.seg_start = sim_host_ns();
+    if (p_irq->handler != NULL) {
+        p_irq->handler();
+    }
+    cpu_consume(cpu_measure() + SIM_EXCEPTION_CYCLES);
+
+    ctx_depth--;
+    host_ipsr = saved_ipsr;
+    p_irq->active = 0;
+    p_irq->count++;
+    if (pend_time >= sim_option.settle && sim_now - pend_time > p_irq->max_response) {
+        p_irq->max_response = sim_now - pend_time;
+    }
+    if (p_irq->exit_hook != NULL) {
+        p_irq->exit_hook();
+    }
+}
+
+//消耗当前上下文的周期数, 期间依次处理到期事件、可响应的中断和挂起的任务切换
+static void cpu_consume(sim_time_t owed) {
+    for (;;) {
+        int32_t irq;
+
+        event_run_due();
+        sim_periph_poll();
+        irq = irq_next();
+        if (irq != SIM_IRQ_NUM) {
+            irq_dispatch(irq);
+            continue;
+        }
+        if (cpu.switch_pending && ctx_depth == 0 && cpu.stall == 0U && host_primask == 0U &&
+            host_basepri == 0U && sim_port_switch_allowed()) {
+            cpu.switch_pending = 0;
+            sim_port_switch();
+            continue;
+        }
+        if (owed == 0U) {
+            return;
+        }
+        sim_time_t step = owed;
+        if (event_num > 0 && event_heap[0]->time < sim_now + step) {
+            step = (event_heap[0]->time > sim_now) ? event_heap[0]->time - sim_now : 0U;
+        }
+        cpu_charge(step);
+        owed -= step;
+    }
+}
+
+void sim_sync(void) {
+    cpu_consume(cpu_measure());
+    cpu.seg_start = sim_host_ns();
+}
+
+void sim_busy(sim_time_t cycles) {
+    cpu_consume(cpu_measure() + cycles);
+    cpu.seg_start = sim_host_ns();
+}
+
+void sim_stall(sim_time_t cycles) {
+    sim_time_t owed = cpu_measure();
+    cpu_consume(owed);
+    cpu.stall++;
+    cpu_consume(cycles);
+    cpu.stall--;
+    cpu_consume(0);
+    cpu.seg_start = sim_host_ns();
+}
+
+void sim_idle(void) {
+    cpu_consume(cpu_measure());
+    if (!cpu.switch_pending && irq_next() == SIM_IRQ_NUM) {
+        if (event_num == 0) {
+            sim_fail("no pending event while idle");
+        }
+        if (event_heap[0]->time > sim_now) {
+            cpu_charge(event_heap[0]->time - sim_now);
+        }
+        cpu_consume(0);
+    }
+    cpu.seg_start = sim_host_ns();
+}
+
+//记录最长的屏蔽区, 在屏蔽状态改变前后各调用一次
+static void mask_track(uint32_t was_masked) {
+    uint32_t masked = host_primask || host_basepri;
+
+    if (!was_masked && masked) {
+        cpu.mask_start = sim_now;
+    } else if (was_masked && !masked && cpu.mask_start >= sim_option.settle &&
+               sim_now - cpu.mask_start > cpu.mask_max) {
+        cpu.mask_max = sim_now - cpu.mask_start;
+        cpu.mask_max_at = sim_now;
+        cpu.mask_max_name = ctx_stack[ctx_depth].account->name;
+    }
+}
+
+void sim_primask_write(uint32_t primask) {
+    uint32_t was_masked = host_primask || host_basepri;
+
+    if (primask & 1U) {
+        sim_sync();
+        host_primask = 1U;
+        mask_track(was_masked);
+    } else {
+        sim_sync();
+        host_primask = 0U;
+        mask_track(was_masked);
+        sim_sync();
+    }
+}
+
+void sim_basepri_write(uint32_t basepri) {
+    uint32_t was_masked = host_primask || host_basepri;
+
+    if (basepri != 0U && (host_basepri == 0U || basepri < host_basepri)) {
+        sim_sync();
+        host_basepri = basepri & 0xF0U;
+        mask_track(was_masked);
+    } else {
+        sim_sync();
+        host_basepri = basepri & 0xF0U;
+        mask_track(was_masked);
+        sim_sync();
+    }
+}
+
+uint32_t sim_in_isr(void) {
+    return (ctx_depth > 0) ? 1U : 0U;
+}
+
+void sim_cpu_set_base(sim_account_t *p_account) {
+    ctx_stack[0].account = p_account;
+}
+
+void sim_cpu_request_switch(void) {
+    cpu.switch_pending = 1;
+}
+
+void sim_cpu_start(void) {
+    uint64_t start;
+
+    memset(irq_table, 0, sizeof(irq_table));
+#define SIM_VECTOR_SET(irq, fn) irq_entry(irq)->handler = fn; irq_entry(irq)->account.name = #fn;
+    SIM_VECTORS(SIM_VECTOR_SET)
+    irq_entry(SysTick_IRQn)->handler = SysTick_Handler;
+    irq_entry(SysTick_IRQn)->account.name = "SysTick_Handler";
+    irq_entry(SysTick_IRQn)->enabled = 1;
+    irq_entry(SysTick_IRQn)->priority = 15;
+
+    ctx_depth = 0;
+    ctx_stack[0].account = &boot_account;
+    ctx_stack[0].priority = SIM_PRIORITY_NONE;
+    cpu.cycles_per_us = (uint64_t) (sim_option.cpu_scale * (SIM_CPU_HZ / 1000000U) + 0.5);
+    cpu.segment_max_ns = (uint64_t) (sim_option.segment_max_us * 1000.0);
+
+    //读主机时钟本身的开销, 从每段中扣除
+    start = sim_host_ns();
+    for (int32_t i = 0; i < 1000; i++) {
+        (void) sim_host_ns();
+    }
+    cpu.overhead_ns = (sim_host_ns() - start) / 1000U;
+    cpu.seg_start = sim_host_ns();
+}
+
+void sim_cpu_report(FILE *fp, sim_time_t elapsed) {
+    fprintf(fp, "\n%-26s %8s %7s %9s %10s %10s\n", "interrupt", "count", "load%", "mean_us", "max_lat_us",
+            "max_resp_us");
+    for (int32_t irq = SIM_IRQ_MIN; irq < SIM_IRQ_NUM; irq++) {
+        const sim_irq_t *p_irq = irq_entry(irq);
+        if (p_irq->count == 0U) {
+            continue;
+        }
+        fprintf(fp, "%-26s %8u %7.2f %9.2f %10.2f %10.2f\n", p_irq->account.name, p_irq->count,
+                100.0 * (double) p_irq->account.busy / (double) elapsed,
+                SIM_TO_US(p_irq->account.busy) / p_irq->count, SIM_TO_US(p_irq->max_latency),
+                SIM_TO_US(p_irq->max_response));
+    }
+    fprintf(fp, "%-26s %8s %7.2f\n", "boot", "", 100.0 * (double) boot_account.busy / (double) elapsed);
+    if (cpu.mask_max_name != NULL) {
+        fprintf(fp, "longest masked section %.1f us in %s at %.1f ms\n", SIM_TO_US(cpu.mask_max),
+                cpu.mask_max_name, SIM_TO_US(cpu.mask_max_at) / 1000.0);
+    }
+    fprintf(fp, "host segments %llu, %llu clamped to %.1f us\n", (unsigned long long) cpu.segment_num,
+            (unsigned long long) cpu.segment_clamped, (double) cpu.segment_max_ns / 1000.0);
+}
+
+uint64_t sim_cpu_isr_busy(void) {
+    uint64_t busy = 0;
+    for (int32_t irq = SIM_IRQ_MIN; irq < SIM_IRQ_NUM; irq++) {
+        busy += irq_entry(irq)->account.busy;
+    }
+    return busy;
+}
+
+void sim_fail(const char *fmt, ...) {
+    va_list args;
+    fflush(stdout);
+    fprintf(stderr, "sim: %.3f ms: ", SIM_TO_US(sim_now) / 1000.0);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(2);
+}
@@ -0,0 +1,688 @@
+/**
+  * @file       sim_hal.c
+  * @brief      the HAL functions the firmware calls, on top of the simulated
+  *             registers. Init functions write the registers the firmware reads
+  *             back and call the Msp hooks of Core/Src like the real HAL, the
+  *             blocking transfers charge their bus time with sim_busy, flash
+  *             erase and program stall the CPU, timers with an update interrupt
+  *             post events from their PSC and ARR, and the DMA and EXTI
+  *             interrupt handlers call the same callbacks as the real HAL.
+  *             固件调用的HAL函数, 建立在仿真寄存器之上. 初始化函数写入固件会读回的
+  *             寄存器并像真实HAL一样调用Core/Src中的Msp函数, 阻塞传输用sim_busy计入
+  *             总线时间, flash擦写使CPU停顿, 开启更新中断的定时器按PSC和ARR安排事件,
+  *             DMA和EXTI中断处理调用与真实HAL相同的回调
+  */
+#include "sim.h"
+#include "main.h"
+#include <string.h>
+
+#define SIM_TIM_NUM         2
+#define SIM_IST8310_ADDRESS (0x0EU << 1)
+
+typedef struct {
+    TIM_TypeDef *tim;
+    IRQn_Type irq;
+    sim_event_t update;
+} sim_tim_t;
+
+__IO uint32_t uwTick = 0;
+uint32_t uwTickPrio = (1UL << __NVIC_PRIO_BITS);
+HAL_TickFreqTypeDef uwTickFreq = HAL_TICK_FREQ_DEFAULT;
+
+static sim_tim_t tim_table[SIM_TIM_NUM];
+static uint32_t apb1_divider = RCC_HCLK_DIV1;
+static uint32_t apb2_divider = RCC_HCLK_DIV1;
+static uint32_t rng_state = 0x2545F491U;
+static uint8_t i2c3_dma_reg = 0;
+
+extern void HAL_MspInit(void);
+extern void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+/* ---------------- 核心 ---------------- */
+
+HAL_StatusTypeDef HAL_Init(void) {
+    HAL_InitTick(TICK_INT_PRIORITY);
+    HAL_MspInit();
+    return HAL_OK;
+}
+
+void HAL_IncTick(void) {
+    uwTick += uwTickFreq;
+}
+
+uint32_t HAL_GetTick(void) {
+    sim_sync();
+    return uwTick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t wait = Delay;
+
+    if (wait < HAL_MAX_DELAY) {
+        wait += (uint32_t) uwTickFreq;
+    }
+    while ((HAL_GetTick() - tickstart) < wait) {
+        sim_busy(SIM_US(10));
+    }
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void) SubPriority;
+    if (IRQn >= SIM_IRQ_MIN) {
+        sim_irq_set_priority(IRQn, PreemptPriority);
+    }
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    sim_irq_enable(IRQn, 1);
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    sim_irq_enable(IRQn, 0);
+}
+
+/* ---------------- RCC ---------------- */
+
+//PLL: 12MHz / 6 * 168 / 2 = 168MHz
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) {
+    (void) RCC_OscInitStruct;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency) {
+    (void) FLatency;
+    SystemCoreClock = SIM_CPU_HZ;
+    apb1_divider = RCC_ClkInitStruct->APB1CLKDivider;
+    apb2_divider = RCC_ClkInitStruct->APB2CLKDivider;
+    return HAL_InitTick(uwTickPrio);
+}
+
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t *pFLatency) {
+    RCC_ClkInitStruct->ClockType = RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_PCLK1 |
+                                   RCC_CLOCKTYPE_PCLK2;
+    RCC_ClkInitStruct->SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    RCC_ClkInitStruct->AHBCLKDivider = RCC_SYSCLK_DIV1;
+    RCC_ClkInitStruct->APB1CLKDivider = apb1_divider;
+    RCC_ClkInitStruct->APB2CLKDivider = apb2_divider;
+    *pFLatency = FLASH_LATENCY_5;
+}
+
+static uint32_t rcc_apb_divide(uint32_t divider) {
+    switch (divider) {
+        case RCC_HCLK_DIV2:
+            return 2U;
+        case RCC_HCLK_DIV4:
+            return 4U;
+        case RCC_HCLK_DIV8:
+            return 8U;
+        case RCC_HCLK_DIV16:
+            return 16U;
+        default:
+            return 1U;
+    }
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) {
+    return SystemCoreClock / rcc_apb_divide(apb1_divider);
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void) {
+    return SystemCoreClock / rcc_apb_divide(apb2_divider);
+}
+
+uint32_t sim_hal_pclk1(void) {
+    return HAL_RCC_GetPCLK1Freq();
+}
+
+uint32_t sim_hal_pclk2(void) {
+    return HAL_RCC_GetPCLK2Freq();
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit) {
+    (void) PeriphClkInit;
+    return HAL_OK;
+}
+
+void HAL_PWR_PVD_IRQHandler(void) {
+    if (EXTI->PR & PWR_EXTI_LINE_PVD) {
+        HAL_PWR_PVDCallback();
+        EXTI->PR &= ~PWR_EXTI_LINE_PVD;
+    }
+}
+
+/* ---------------- GPIO ---------------- */
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    uint32_t pin = GPIO_Init->Pin;
+
+    if (GPIO_Init->Mode & EXTI_IT) {
+        EXTI->IMR |= pin;
+    }
+    //上拉输入空闲时读到高电平
+    if ((GPIO_Init->Mode == GPIO_MODE_INPUT || (GPIO_Init->Mode & EXTI_MODE)) && GPIO_Init->Pull == GPIO_PULLUP) {
+        GPIOx->IDR |= pin;
+    }
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin) {
+    (void) GPIOx;
+    EXTI->IMR &= ~GPIO_Pin;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    sim_periph_gpio_write(GPIOx, GPIO_Pin, PinState != GPIO_PIN_RESET);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    sim_periph_gpio_write(GPIOx, GPIO_Pin, !(GPIOx->ODR & GPIO_Pin));
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return sim_periph_gpio_read(GPIOx, GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin) {
+    if (EXTI->PR & GPIO_Pin) {
+        EXTI->PR &= ~(uint32_t) GPIO_Pin;
+        HAL_GPIO_EXTI_Callback(GPIO_Pin);
+    }
+}
+
+/* ---------------- TIM ---------------- */
+
+static sim_tim_t *tim_get(TIM_TypeDef *tim) {
+    for (int32_t i = 0; i < SIM_TIM_NUM; i++) {
+        if (tim_table[i].tim == tim) {
+            return &tim_table[i];
+        }
+    }
+    return NULL;
+}
+
+//APB1上的定时器时钟为PCLK1, 分频时为两倍
+static sim_time_t tim_period(TIM_TypeDef *tim) {
+    uint32_t apb2 = (tim == TIM1 || tim == TIM8 || tim == TIM9 || tim == TIM10 || tim == TIM11);
+    uint32_t divider = apb2 ? apb2_divider : apb1_divider;
+    uint32_t clock = apb2 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+
+    if (divider != RCC_HCLK_DIV1) {
+        clock *= 2U;
+    }
+    return (sim_time_t) (tim->PSC + 1U) * (tim->ARR + 1U) * SystemCoreClock / clock;
+}
+
+static void tim_update_fn(void *arg) {
+    sim_tim_t *p_tim = arg;
+
+    if (!(p_tim->tim->CR1 & TIM_CR1_CEN)) {
+        return;
+    }
+    p_tim->tim->SR |= TIM_SR_UIF;
+    if (p_tim->tim->DIER & TIM_DIER_UIE) {
+        sim_irq_pend(p_tim->irq);
+    }
+    sim_event_at(&p_tim->update, p_tim->update.time + tim_period(p_tim->tim));
+}
+
+static void tim_base_set(TIM_HandleTypeDef *htim) {
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    htim->Instance->CR1 = htim->Init.CounterMode | htim->Init.ClockDivision | htim->Init.AutoReloadPreload;
+    htim->State = HAL_TIM_STATE_READY;
+}
+
+__weak void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef *htim) {
+    (void) htim;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) {
+    if (htim->State == HAL_TIM_STATE_RESET) {
+        HAL_TIM_Base_MspInit(htim);
+    }
+    tim_base_set(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) {
+    if (htim->State == HAL_TIM_STATE_RESET) {
+        HAL_TIM_PWM_MspInit(htim);
+    }
+    tim_base_set(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+    sim_tim_t *p_tim = tim_get(htim->Instance);
+
+    htim->Instance->DIER |= TIM_DIER_UIE;
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    if (p_tim != NULL && !sim_event_queued(&p_tim->update)) {
+        sim_sync();
+        sim_event_at(&p_tim->update, sim_now + tim_period(htim->Instance));
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig) {
+    (void) htim;
+    (void) sClockSourceConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel) {
+    __HAL_TIM_SET_COMPARE(htim, Channel, sConfig->Pulse);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    htim->Instance->CCER |= TIM_CCER_CC1E << (Channel & 0x1FU);
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim,
+                                                        TIM_MasterConfigTypeDef *sMasterConfig) {
+    (void) htim;
+    (void) sMasterConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(TIM_HandleTypeDef *htim,
+                                                TIM_BreakDeadTimeConfigTypeDef *sBreakDeadTimeConfig) {
+    (void) sBreakDeadTimeConfig;
+    htim->Instance->BDTR |= TIM_BDTR_MOE;
+    return HAL_OK;
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim) {
+    if ((htim->Instance->SR & TIM_SR_UIF) && (htim->Instance->DIER & TIM_DIER_UIE)) {
+        htim->Instance->SR &= ~TIM_SR_UIF;
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+/* ---------------- DMA ---------------- */
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) {
+    hdma->Instance->CR = hdma->Init.Channel | hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc |
+                         hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment | hdma->Init.Mode |
+                         hdma->Init.Priority;
+    hdma->Instance->FCR = hdma->Init.FIFOMode | hdma->Init.FIFOThreshold;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma) {
+    hdma->Instance->CR = 0;
+    hdma->State = HAL_DMA_STATE_RESET;
+    return HAL_OK;
+}
+
+//只处理传输完成, 双缓冲时按CT区分两个缓冲区的回调
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {
+    sim_dma_stream_t *p_stream = sim_dma_stream_of(hdma->Instance);
+    volatile uint32_t *p_isr = (p_stream->index < 4U) ? &p_stream->dma->LISR : &p_stream->dma->HISR;
+    static const uint8_t shift[4] = {0, 6, 16, 22};
+    uint32_t tc = DMA_FLAG_TCIF0_4 << shift[p_stream->index & 3U];
+
+    if (!(*p_isr & tc) || !(hdma->Instance->CR & DMA_SxCR_TCIE)) {
+        return;
+    }
+    *p_isr &= ~tc;
+    if (hdma->Instance->CR & DMA_SxCR_DBM) {
+        if (!(hdma->Instance->CR & DMA_SxCR_CT)) {
+            if (hdma->XferM1CpltCallback != NULL) {
+                hdma->XferM1CpltCallback(hdma);
+            }
+        } else if (hdma->XferCpltCallback != NULL) {
+            hdma->XferCpltCallback(hdma);
+        }
+        return;
+    }
+    if (!(hdma->Instance->CR & DMA_SxCR_CIRC)) {
+        hdma->Instance->CR &= ~DMA_SxCR_TCIE;
+        hdma->State = HAL_DMA_STATE_READY;
+    }
+    if (hdma->XferCpltCallback != NULL) {
+        hdma->XferCpltCallback(hdma);
+    }
+}
+
+/* ---------------- Flash ---------------- */
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    FLASH->CR &= ~FLASH_CR_LOCK;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+    return HAL_OK;
+}
+
+//只能把1写为0, 字编程约16us, 期间CPU取指停顿
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        return HAL_ERROR;
+    }
+    switch (TypeProgram) {
+        case FLASH_TYPEPROGRAM_BYTE:
+            *(volatile uint8_t *) (uintptr_t) Address &= (uint8_t) Data;
+            break;
+        case FLASH_TYPEPROGRAM_HALFWORD:
+            *(volatile uint16_t *) (uintptr_t) Address &= (uint16_t) Data;
+            break;
+        case FLASH_TYPEPROGRAM_WORD:
+            *(volatile uint32_t *) (uintptr_t) Address &= (uint32_t) Data;
+            break;
+        default:
+            *(volatile uint64_t *) (uintptr_t) Address &= Data;
+            break;
+    }
+    sim_stall(SIM_US(16));
+    return HAL_OK;
+}
+
+//扇区0~3为16KB, 4为64KB, 5~11为128KB, 擦除时间按典型值
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError) {
+    *SectorError = 0xFFFFFFFFU;
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        return HAL_ERROR;
+    }
+    for (uint32_t sector = pEraseInit->Sector; sector < pEraseInit->Sector + pEraseInit->NbSectors; sector++) {
+        uint32_t address;
+        uint32_t size;
+        sim_time_t time;
+
+        if (sector < 4U) {
+            address = FLASH_BASE + sector * 0x4000U;
+            size = 0x4000U;
+            time = SIM_MS(250);
+        } else if (sector == 4U) {
+            address = FLASH_BASE + 0x10000U;
+            size = 0x10000U;
+            time = SIM_MS(550);
+        } else if (sector < 12U) {
+            address = FLASH_BASE + 0x20000U * (sector - 4U);
+            size = 0x20000U;
+            time = SIM_MS(1000);
+        } else {
+            *SectorError = sector;
+            return HAL_ERROR;
+        }
+        memset((void *) (uintptr_t) address, 0xFF, size);
+        sim_stall(time);
+    }
+    return HAL_OK;
+}
+
+/* ---------------- ADC ---------------- */
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc) {
+    if (hadc->State == HAL_ADC_STATE_RESET) {
+        HAL_ADC_MspInit(hadc);
+    }
+    hadc->State = HAL_ADC_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig) {
+    hadc->Instance->SQR3 = sConfig->Channel & ADC_SQR3_SQ1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc) {
+    hadc->Instance->SR &= ~ADC_SR_EOC;
+    return HAL_OK;
+}
+
+//21MHz的ADC时钟下3周期采样加12位转换
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef *hadc, uint32_t Timeout) {
+    (void) Timeout;
+    sim_busy(SIM_US(1));
+    hadc->Instance->DR = sim_adc_value(hadc->Instance, hadc->Instance->SQR3 & ADC_SQR3_SQ1);
+    hadc->Instance->SR |= ADC_SR_EOC;
+    return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc) {
+    hadc->Instance->SR &= ~ADC_SR_EOC;
+    return hadc->Instance->DR;
+}
+
+/* ---------------- I2C ---------------- */
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+    if (hi2c->State == HAL_I2C_STATE_RESET) {
+        HAL_I2C_MspInit(hi2c);
+    }
+    hi2c->Instance->CR1 |= I2C_CR1_PE;
+    hi2c->State = HAL_I2C_STATE_READY;
+    return HAL_OK;
+}
+
+//起始、地址、寄存器、数据和停止位, 每字节9位
+static sim_time_t i2c_time(I2C_HandleTypeDef *hi2c, uint32_t bytes) {
+    uint32_t speed = hi2c->Init.ClockSpeed ? hi2c->Init.ClockSpeed : 100000U;
+    return (sim_time_t) (bytes * 9U + 2U) * SIM_CPU_HZ / speed;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void) MemAddSize;
+    (void) Timeout;
+    sim_busy(i2c_time(hi2c, 2U + Size));
+    if (hi2c->Instance == I2C3 && DevAddress == SIM_IST8310_ADDRESS) {
+        sim_ist8310_write((uint8_t) MemAddress, pData, Size);
+        return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void) MemAddSize;
+    (void) Timeout;
+    sim_busy(i2c_time(hi2c, 3U + Size));
+    if (hi2c->Instance == I2C3 && DevAddress == SIM_IST8310_ADDRESS) {
+        sim_ist8310_read((uint8_t) MemAddress, pData, Size);
+        return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+//OLED等其他I2C设备只计总线时间
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout) {
+    (void) DevAddress;
+    (void) pData;
+    (void) Timeout;
+    sim_busy(i2c_time(hi2c, 1U + Size));
+    return HAL_OK;
+}
+
+static void i2c_dma_rx_cplt(DMA_HandleTypeDef *hdma) {
+    I2C_HandleTypeDef *hi2c = (I2C_HandleTypeDef *) hdma->Parent;
+
+    hi2c->Instance->CR2 &= ~I2C_CR2_DMAEN;
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->Mode = HAL_I2C_MODE_NONE;
+    HAL_I2C_MemRxCpltCallback(hi2c);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size) {
+    (void) MemAddSize;
+    if (hi2c->Instance != I2C3 || DevAddress != SIM_IST8310_ADDRESS || hi2c->hdmarx == NULL) {
+        return HAL_ERROR;
+    }
+    if (hi2c->State != HAL_I2C_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hi2c->State = HAL_I2C_STATE_BUSY_RX;
+    hi2c->Mode = HAL_I2C_MODE_MEM;
+    hi2c->hdmarx->XferCpltCallback = i2c_dma_rx_cplt;
+    i2c3_dma_reg = (uint8_t) MemAddress;
+    hi2c->hdmarx->Instance->M0AR = (uint32_t) (uintptr_t) pData;
+    hi2c->hdmarx->Instance->NDTR = Size;
+    hi2c->hdmarx->Instance->CR |= DMA_SxCR_TCIE | DMA_SxCR_EN;
+    hi2c->Instance->CR2 |= I2C_CR2_DMAEN;
+    sim_sync();
+    return HAL_OK;
+}
+
+__weak void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    (void) hi2c;
+}
+
+//I2C3接收流启动后按总线时间读出IST8310的寄存器
+static void i2c3_rx_start(sim_dma_stream_t *p_stream) {
+    extern I2C_HandleTypeDef hi2c3;
+    sim_event_at(&p_stream->done, sim_now + i2c_time(&hi2c3, 3U + p_stream->ndtr));
+}
+
+static void i2c3_rx_done(void *arg) {
+    sim_dma_stream_t *p_stream = arg;
+    sim_ist8310_read(i2c3_dma_reg, (uint8_t *) (uintptr_t) p_stream->m0ar, p_stream->ndtr);
+    sim_dma_complete(p_stream);
+}
+
+/* ---------------- SPI ---------------- */
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi) {
+    if (hspi->State == HAL_SPI_STATE_RESET) {
+        HAL_SPI_MspInit(hspi);
+    }
+    hspi->Instance->CR1 = hspi->Init.Mode | hspi->Init.Direction | hspi->Init.DataSize | hspi->Init.CLKPolarity |
+                          hspi->Init.CLKPhase | (hspi->Init.NSS & SPI_CR1_SSM) | hspi->Init.BaudRatePrescaler |
+                          hspi->Init.FirstBit;
+    hspi->State = HAL_SPI_STATE_READY;
+    return HAL_OK;
+}
+
+//SPI1在APB2上, 每位为2 << BR个PCLK2周期
+static sim_time_t spi_byte_time(SPI_TypeDef *spi) {
+    uint32_t divider = 2U << ((spi->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos);
+    uint32_t pclk = (spi == SPI1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    return (sim_time_t) 8U * divider * SystemCoreClock / pclk;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size,
+                                          uint32_t Timeout) {
+    (void) Timeout;
+    sim_busy(spi_byte_time(hspi->Instance) * Size);
+    for (uint16_t i = 0; i < Size; i++) {
+        pRxData[i] = (hspi->Instance == SPI1) ? sim_bmi088_transfer(pTxData[i]) : 0xFFU;
+    }
+    return HAL_OK;
+}
+
+//SPI1的DMA由发送流驱动, 传输结束时两个流同时完成
+static void spi1_tx_start(sim_dma_stream_t *p_stream) {
+    sim_event_at(&p_stream->done, sim_now + spi_byte_time(SPI1) * p_stream->ndtr);
+}
+
+static void spi1_tx_done(void *arg) {
+    sim_dma_stream_t *p_tx = arg;
+    sim_dma_stream_t *p_rx = sim_dma_stream(DMA2, 2);
+    const uint8_t *p_out = (const uint8_t *) (uintptr_t) p_tx->m0ar;
+    uint8_t *p_in = (p_rx->enabled) ? (uint8_t *) (uintptr_t) p_rx->m0ar : NULL;
+
+    for (uint16_t i = 0; i < p_tx->ndtr; i++) {
+        uint8_t rx = sim_bmi088_transfer(p_out[i]);
+        if (p_in != NULL && i < p_rx->ndtr) {
+            p_in[i] = rx;
+        }
+    }
+    sim_dma_complete(p_tx);
+    if (p_in != NULL) {
+        sim_dma_complete(p_rx);
+    }
+}
+
+/* ---------------- 其他 ---------------- */
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    uint32_t pclk = (huart->Instance == USART1 || huart->Instance == USART6) ? HAL_RCC_GetPCLK2Freq()
+                                                                               : HAL_RCC_GetPCLK1Freq();
+    if (huart->gState == HAL_UART_STATE_RESET) {
+        HAL_UART_MspInit(huart);
+    }
+    huart->Instance->BRR = (pclk + huart->Init.BaudRate / 2U) / huart->Init.BaudRate;
+    huart->Instance->CR2 = huart->Init.StopBits;
+    huart->Instance->CR1 = USART_CR1_UE | huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode |
+                           huart->Init.OverSampling;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc) {
+    if (hcrc->State == HAL_CRC_STATE_RESET) {
+        HAL_CRC_MspInit(hcrc);
+    }
+    hcrc->State = HAL_CRC_STATE_READY;
+    return HAL_OK;
+}
+
+//STM32的CRC32: 多项式0x04C11DB7, 初值0xFFFFFFFF, 按字高位先行, 不反转
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength) {
+    uint32_t crc = 0xFFFFFFFFU;
+
+    for (uint32_t i = 0; i < BufferLength; i++) {
+        crc ^= pBuffer[i];
+        for (int32_t bit = 0; bit < 32; bit++) {
+            crc = (crc & 0x80000000U) ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+        }
+    }
+    hcrc->Instance->DR = crc;
+    sim_busy(4U * BufferLength);
+    return crc;
+}
+
+HAL_StatusTypeDef HAL_RNG_Init(RNG_HandleTypeDef *hrng) {
+    if (hrng->State == HAL_RNG_STATE_RESET) {
+        HAL_RNG_MspInit(hrng);
+    }
+    hrng->State = HAL_RNG_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RNG_GenerateRandomNumber(RNG_HandleTypeDef *hrng, uint32_t *random32bit) {
+    rng_state = rng_state * 1664525U + 1013904223U;
+    *random32bit = rng_state;
+    hrng->RandomNumber = rng_state;
+    sim_busy(40U);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc) {
+    if (hrtc->State == HAL_RTC_STATE_RESET) {
+        HAL_RTC_MspInit(hrtc);
+    }
+    hrtc->State = HAL_RTC_STATE_READY;
+    return HAL_OK;
+}
+
+void sim_hal_init(void) {
+    tim_table[0] = (sim_tim_t) {TIM6, TIM6_DAC_IRQn};
+    tim_table[1] = (sim_tim_t) {TIM7, TIM7_IRQn};
+    for (int32_t i = 0; i < SIM_TIM_NUM; i++) {
+        sim_event_init(&tim_table[i].update, tim_update_fn, &tim_table[i]);
+    }
+    sim_dma_stream(DMA1, 2)->start = i2c3_rx_start;
+    sim_dma_stream(DMA1, 2)->done.fn = i2c3_rx_done;
+    sim_dma_stream(DMA2, 3)->start = spi1_tx_start;
+    sim_dma_stream(DMA2, 3)->done.fn = spi1_tx_done;
+}
@@ -0,0 +1,256 @@
+/**
+  * @file       sim_main.c
+  * @brief      entry of the host simulation: parses the options, brings up
+  *             the memory map, the CPU, the devices and the plants, then runs
+  *             the firmware main() on a boot thread until the virtual time
+  *             reaches --duration. The report lists the load and the response
+  *             times of every task and interrupt, the exit code is 1 when a
+  *             task missed its deadline or overran its period. Jobs released in
+  *             the first --settle ms are left out of the response statistics:
+  *             INS_task initialises the BMI088 there with 150 us busy waits at
+  *             the highest task priority.
+  *             主机仿真入口: 解析参数, 建立内存映射、CPU、设备和被控对象, 然后在启动
+  *             线程上运行固件的main(), 直到虚拟时间达到--duration. 报告列出每个任务和
+  *             中断的负载与响应时间, 有任务错过截止时间或超出周期时退出码为1. 前--settle ms内
+  *             就绪的作业不计入响应时间统计: INS_task在这段时间以最高任务优先级初始化BMI088,
+  *             其中有多次150us的忙等
+  */
+#include "sim.h"
+#include "SEGGER_RTT.h"
+#include <execinfo.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SIM_BOOT_STACK      (1024U * 1024U)
+//调试器读RTT的间隔
+#define SIM_RTT_POLL        SIM_MS(1)
+
+extern int firmware_main(void);
+
+sim_option_t sim_option = {
+        .cpu_scale = 8.0,
+        .segment_max_us = 10.0,
+        .duration = SIM_MS(3000),
+        .settle = SIM_MS(1500),
+};
+
+static sim_event_t finish_event;
+static sim_event_t rtt_event;
+static FILE *rtt_fp = NULL;
+
+static const char usage[] =
+        "usage: firmware_sim [options]\n"
+        "  --duration MS          virtual run time, default 3000\n"
+        "  --settle MS            start-up time left out of the response statistics, default 1500\n"
+        "  --cpu-scale N          target cycles per host cycle scaled to 168 MHz, default 8\n"
+        "  --segment-max US       host time limit between two sync points, default 10\n"
+        "  --deadline TASK=US     response time limit of a task, default the vTaskDelayUntil period\n"
+        "  --exec-add TASK=US     execution time added to every job of a task\n"
+        "  --rtt FILE             write RTT channel 0 to FILE\n"
+        "  --usb FILE             write the USB CDC output to FILE\n"
+        "  --referee FILE         write the USART6 output to the referee system to FILE\n"
+        "  --quiet                print the summary line only\n";
+
+//TASK=US
+static void option_task_value(const char *arg, void (*set)(const char *name, double us)) {
+    char name[32];
+    const char *p_eq = strchr(arg, '=');
+    size_t len = (p_eq != NULL) ? (size_t) (p_eq - arg) : 0U;
+
+    if (len == 0U || len >= sizeof(name)) {
+        sim_fail("bad task option '%s'", arg);
+    }
+    memcpy(name, arg, len);
+    name[len] = '\0';
+    set(name, atof(p_eq + 1));
+}
+
+static void option_parse(int argc, char **argv) {
+    static const struct option long_option[] = {
+            {"duration",     required_argument, NULL, 'd'},
+            {"settle",       required_argument, NULL, 't'},
+            {"cpu-scale",    required_argument, NULL, 's'},
+            {"segment-max",  required_argument, NULL, 'm'},
+            {"deadline",     required_argument, NULL, 'l'},
+            {"exec-add",     required_argument, NULL, 'e'},
+            {"rtt",          required_argument, NULL, 'r'},
+            {"usb",          required_argument, NULL, 'u'},
+            {"referee",      required_argument, NULL, 'f'},
+            {"quiet",        no_argument,       NULL, 'q'},
+            {"help",         no_argument,       NULL, 'h'},
+            {NULL,           0,                 NULL, 0},
+    };
+    int opt;
+
+    //中断要求快速响应的任务, 没有vTaskDelayUntil周期
+    sim_port_set_deadline("CAN_RX", 1000.0);
+    sim_port_set_deadline("VISION_RX", 5000.0);
+
+    while ((opt = getopt_long(argc, argv, "", long_option, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                sim_option.duration = SIM_US(atof(optarg) * 1000.0);
+                break;
+            case 't':
+                sim_option.settle = SIM_US(atof(optarg) * 1000.0);
+                break;
+            case 's':
+                sim_option.cpu_scale = atof(optarg);
+                break;
+            case 'm':
+                sim_option.segment_max_us = atof(optarg);
+                break;
+            case 'l':
+                option_task_value(optarg, sim_port_set_deadline);
+                break;
+            case 'e':
+                option_task_value(optarg, sim_port_add_exec);
+                break;
+            case 'r':
+                sim_option.rtt_path = optarg;
+                break;
+            case 'u':
+                sim_option.usb_path = optarg;
+                break;
+            case 'f':
+                sim_option.referee_path = optarg;
+                break;
+            case 'q':
+                sim_option.quiet = 1;
+                break;
+            default:
+                fputs(usage, (opt == 'h') ? stdout : stderr);
+                exit((opt == 'h') ? 0 : 2);
+        }
+    }
+    if (sim_option.cpu_scale <= 0.0 || sim_option.segment_max_us <= 0.0 || sim_option.duration <= sim_option.settle) {
+        sim_fail("bad --cpu-scale, --segment-max, --settle or --duration");
+    }
+}
+
+//像调试器一样取走RTT通道0的数据, 不输出文件时丢弃
+static void rtt_fn(void *arg) {
+    SEGGER_RTT_BUFFER_UP *p_up = &_SEGGER_RTT.aUp[0];
+    unsigned wr_off = p_up->WrOff;
+    unsigned rd_off = p_up->RdOff;
+    (void) arg;
+
+    if (p_up->pBuffer != NULL && wr_off != rd_off) {
+        if (rtt_fp != NULL) {
+            if (wr_off < rd_off) {
+                fwrite(p_up->pBuffer + rd_off, 1, p_up->SizeOfBuffer - rd_off, rtt_fp);
+                rd_off = 0;
+            }
+            fwrite(p_up->pBuffer + rd_off, 1, wr_off - rd_off, rtt_fp);
+        }
+        p_up->RdOff = wr_off;
+    }
+    sim_event_at(&rtt_event, rtt_event.time + SIM_RTT_POLL);
+}
+
+void sim_finish(const char *reason) {
+    int misses = 0;
+    FILE *fp = sim_option.quiet ? fopen("/dev/null", "w") : stdout;
+
+    if (fp == NULL) {
+        fp = stdout;
+    }
+    fprintf(fp, "firmware_sim: %s at %.1f ms, cpu scale %.2f\n", reason, SIM_TO_US(sim_now) / 1000.0,
+            sim_option.cpu_scale);
+    sim_port_report(fp, sim_now, &misses);
+    sim_cpu_report(fp, sim_now);
+    sim_periph_report(fp);
+    sim_can_report(fp, sim_now);
+    sim_usb_report(fp);
+    sim_robot_report(fp);
+    fflush(fp);
+    if (rtt_fp != NULL) {
+        rtt_fn(NULL);
+        fflush(rtt_fp);
+    }
+    printf("firmware_sim: %d deadline misses and overruns\n", misses);
+    fflush(stdout);
+    exit(misses ? 1 : 0);
+}
+
+//固件访问非法地址时打印调用栈, 非PIE程序的地址可直接交给addr2line
+static void fault_handler(int sig) {
+    static const char msg[] = "firmware_sim: fault, backtrace:\n";
+    void *frame[32];
+    int depth = backtrace(frame, 32);
+
+    (void) sig;
+    write(STDERR_FILENO, msg, sizeof(msg) - 1U);
+    backtrace_symbols_fd(frame, depth, STDERR_FILENO);
+    _exit(3);
+}
+
+static void fault_install(void) {
+    static uint8_t alt_stack[64 * 1024];
+    stack_t ss = {.ss_sp = alt_stack, .ss_size = sizeof(alt_stack)};
+    struct sigaction sa;
+
+    sigaltstack(&ss, NULL);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = fault_handler;
+    sa.sa_flags = SA_ONSTACK;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sigaction(SIGFPE, &sa, NULL);
+}
+
+static void finish_fn(void *arg) {
+    (void) arg;
+    sim_finish("done");
+}
+
+//固件把栈上缓冲区的地址存入32位寄存器, 启动线程的栈放在低4GB
+static void *boot_main(void *arg) {
+    (void) arg;
+    sim_cpu_restart_segment();
+    firmware_main();
+    sim_fail("main returned");
+}
+
+int main(int argc, char **argv) {
+    pthread_attr_t attr;
+    pthread_t boot;
+    void *stack;
+
+    option_parse(argc, argv);
+    fault_install();
+    sim_mem_init();
+    sim_cpu_start();
+    sim_periph_init();
+    sim_hal_init();
+    sim_can_init();
+    sim_robot_init();
+    sim_usb_init();
+    sim_event_init(&finish_event, finish_fn, NULL);
+    sim_event_at(&finish_event, sim_option.duration);
+    if (sim_option.rtt_path != NULL) {
+        rtt_fp = fopen(sim_option.rtt_path, "wb");
+        if (rtt_fp == NULL) {
+            sim_fail("cannot open %s", sim_option.rtt_path);
+        }
+    }
+    sim_event_init(&rtt_event, rtt_fn, NULL);
+    sim_event_at(&rtt_event, SIM_RTT_POLL);
+
+    stack = mmap(NULL, SIM_BOOT_STACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (stack == MAP_FAILED) {
+        sim_fail("cannot map the boot stack");
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, SIM_BOOT_STACK);
+    if (pthread_create(&boot, &attr, boot_main, NULL) != 0) {
+        sim_fail("cannot start the boot thread");
+    }
+    pthread_join(boot, NULL);
+    return 2;
+}
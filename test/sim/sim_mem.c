@@ -0,0 +1,97 @@
+/**
+  * @file       sim_mem.c
+  * @brief      maps the flash, the CCM RAM, the system memory and the
+  *             peripheral blocks at their STM32F407 addresses, so the firmware
+  *             keeps its absolute register and flash accesses. The registers
+  *             are plain memory with their reset values, the device models and
+  *             the sync point hooks give them their behaviour. A host where the
+  *             addresses cannot be mapped skips the simulation.
+  *             在STM32F407的地址上映射flash、CCM RAM、系统存储区和外设, 固件的绝对地址
+  *             访问保持不变. 寄存器是带复位值的普通内存, 行为由设备模型和同步点钩子给出.
+  *             无法映射这些地址的主机跳过仿真
+  */
+#include "sim.h"
+#include "calibrate_task.h"
+#include "bsp_flash.h"
+#include "global_control_define.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+//ctest中表示跳过
+#define SIM_EXIT_SKIP       77
+
+typedef struct {
+    uintptr_t base;
+    size_t size;
+    uint8_t fill;
+} sim_region_t;
+
+static const sim_region_t sim_region[] = {
+        {FLASH_BASE,        0x100000U, 0xFFU},      //1MB flash, 擦除状态
+        {CCMDATARAM_BASE,   0x10000U,  0x00U},
+        {0x1FFF0000U,       0x10000U,  0xFFU},      //系统存储区, 含UID和flash容量
+        {PERIPH_BASE,       0x80000U,  0x00U},      //APB1, APB2, AHB1
+        {AHB2PERIPH_BASE,   0x61000U,  0x00U},      //USB OTG FS, DCMI, RNG
+        {PERIPH_BB_BASE,    0x2000000U, 0x00U},     //外设位带别名区, 只作为普通内存
+        {0xE0000000U,       0x100000U, 0x00U},      //内核外设
+};
+
+//扇区9的旧格式校准数据, 启动时导入键值存储
+static void mem_legacy_cali(void) {
+    uint32_t *p_word = (uint32_t *) FLASH_USER_ADDR;
+    head_cali_t head = {0};
+    gimbal_cali_t gimbal = {4096, 4096, 1.2f, -1.2f, 0.4f, -0.3f};
+    ahrs_cali_t ahrs = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+    static const char name[CALI_LIST_LENGHT][3] = {"HD", "GIM", "GM"};
+    const void *p_data[CALI_LIST_LENGHT] = {&head, &gimbal, &ahrs};
+    const size_t size[CALI_LIST_LENGHT] = {sizeof(head), sizeof(gimbal), sizeof(ahrs)};
+
+    head.self_id = SELF_ID;
+    head.firmware_version = FIRMWARE_VERSION;
+    head.temperature = 40;
+    for (int32_t i = 0; i < CALI_LIST_LENGHT; i++) {
+        uint8_t flag[4] = {(uint8_t) name[i][0], (uint8_t) name[i][1], (uint8_t) name[i][2], CALIED_FLAG};
+        memcpy(p_word, p_data[i], size[i]);
+        p_word += size[i] / 4U;
+        memcpy(p_word, flag, sizeof(flag));
+        p_word += CALI_SENSOR_HEAD_LEGHT;
+    }
+}
+
+void sim_mem_init(void) {
+    for (size_t i = 0; i < sizeof(sim_region) / sizeof(sim_region[0]); i++) {
+        void *p = mmap((void *) sim_region[i].base, sim_region[i].size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *) sim_region[i].base) {
+            fprintf(stderr, "sim: cannot map 0x%08lx: %s, skipped\n", (unsigned long) sim_region[i].base,
+                    (p == MAP_FAILED) ? strerror(errno) : "address taken");
+            exit(SIM_EXIT_SKIP);
+        }
+        //匿名映射本身为0, 不必逐页写入
+        if (sim_region[i].fill != 0x00U) {
+            memset(p, sim_region[i].fill, sim_region[i].size);
+        }
+    }
+
+    //芯片UID和flash容量(KB)
+    *(volatile uint32_t *) UID_BASE = 0x00330021U;
+    *(volatile uint32_t *) (UID_BASE + 4U) = 0x31385104U;
+    *(volatile uint32_t *) (UID_BASE + 8U) = 0x36343532U;
+    *(volatile uint16_t *) FLASHSIZE_BASE = 1024U;
+
+    //复位值
+    RCC->CSR = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF;
+    USART1->SR = USART_SR_TXE | USART_SR_TC;
+    USART3->SR = USART_SR_TXE | USART_SR_TC;
+    USART6->SR = USART_SR_TXE | USART_SR_TC;
+    SPI1->SR = SPI_SR_TXE;
+    SPI2->SR = SPI_SR_TXE;
+    I2C1->SR1 = 0;
+    mem_legacy_cali();
+}
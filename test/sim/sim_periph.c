@@ -0,0 +1,373 @@
+/**
+  * @file       sim_periph.c
+  * @brief      the register level devices of the host simulation: DMA streams,
+  *             the UART receivers and transmitters behind them, EXTI and the
+  *             DWT cycle counter. The firmware writes the registers as plain
+  *             memory, the changes are picked up at every sync point: an EN bit
+  *             going up starts a transfer, an IFCR write clears its flags, an
+  *             NDTR write to a running receive stream reloads it and a SWIER
+  *             write pends the line.
+  *             主机仿真的寄存器级设备: DMA流、其后的串口收发、EXTI和DWT周期计数器.
+  *             固件把寄存器当普通内存读写, 每个同步点检查变化: EN置位启动传输, 写IFCR
+  *             清除标志, 运行中的接收流被写NDTR时重装, 写SWIER挂起对应中断线
+  */
+#include "sim.h"
+#include "main.h"
+#include <string.h>
+
+#define SIM_DMA_STREAM_NUM  8
+
+typedef struct {
+    USART_TypeDef *uart;
+    sim_dma_stream_t *p_rx;
+    sim_dma_stream_t *p_tx;
+    IRQn_Type irq;
+    uint32_t pclk;
+    sim_uart_sink_f sink;
+    sim_event_t idle;
+    uint32_t rx_bytes;
+    uint32_t rx_dropped;
+    uint32_t tx_bytes;
+} sim_uart_t;
+
+static sim_dma_stream_t dma_stream[2][SIM_DMA_STREAM_NUM];
+
+static const IRQn_Type dma_irq[2][SIM_DMA_STREAM_NUM] = {
+        {DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+                DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn},
+        {DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+                DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn},
+};
+
+//LISR/HISR中每个流的标志位偏移
+static const uint8_t dma_flag_shift[4] = {0, 6, 16, 22};
+#define DMA_FLAG_ALL    0x3DU
+#define DMA_FLAG_TC     0x20U
+
+static sim_uart_t uart_table[3];
+static uint32_t dwt_written = 0;
+static uint8_t dwt_running = 0;
+static sim_time_t dwt_offset = 0;
+
+/* ---------------- DMA ---------------- */
+
+sim_dma_stream_t *sim_dma_stream(DMA_TypeDef *dma, uint8_t index) {
+    return &dma_stream[(dma == DMA2) ? 1 : 0][index];
+}
+
+sim_dma_stream_t *sim_dma_stream_of(const DMA_Stream_TypeDef *regs) {
+    uintptr_t address = (uintptr_t) regs;
+    DMA_TypeDef *dma = (address >= DMA2_BASE) ? DMA2 : DMA1;
+    return sim_dma_stream(dma, (uint8_t) ((address - (uintptr_t) dma - 0x10U) / 0x18U));
+}
+
+static volatile uint32_t *dma_isr(sim_dma_stream_t *p_stream) {
+    return (p_stream->index < 4U) ? &p_stream->dma->LISR : &p_stream->dma->HISR;
+}
+
+static void dma_flag_set(sim_dma_stream_t *p_stream, uint32_t flag) {
+    *dma_isr(p_stream) |= flag << dma_flag_shift[p_stream->index & 3U];
+}
+
+static void dma_flag_clear(sim_dma_stream_t *p_stream) {
+    *dma_isr(p_stream) &= ~(DMA_FLAG_ALL << dma_flag_shift[p_stream->index & 3U]);
+}
+
+//传输完成标志, 使能了TCIE时挂起中断
+static void dma_transfer_complete(sim_dma_stream_t *p_stream) {
+    dma_flag_set(p_stream, DMA_FLAG_TC);
+    if (p_stream->regs->CR & DMA_SxCR_TCIE) {
+        sim_irq_pend(p_stream->irq);
+    }
+}
+
+void sim_dma_complete(sim_dma_stream_t *p_stream) {
+    sim_event_cancel(&p_stream->done);
+    p_stream->regs->NDTR = 0;
+    p_stream->sim_ndtr = 0;
+    p_stream->regs->CR &= ~DMA_SxCR_EN;
+    p_stream->enabled = 0;
+    dma_transfer_complete(p_stream);
+}
+
+//外设到内存的接收, 支持双缓冲和循环模式, 返回写入的字节数
+uint16_t sim_dma_receive(sim_dma_stream_t *p_stream, const uint8_t *p_data, uint16_t len) {
+    DMA_Stream_TypeDef *regs = p_stream->regs;
+    uint16_t done = 0;
+
+    while (done < len && p_stream->enabled && (regs->CR & DMA_SxCR_EN)) {
+        uint32_t address = regs->M0AR;
+        uint16_t ndtr = (uint16_t) regs->NDTR;
+
+        if (ndtr != p_stream->sim_ndtr) {
+            //固件重新设定了长度
+            p_stream->ndtr = ndtr;
+        }
+        if (ndtr == 0U) {
+            break;
+        }
+        if ((regs->CR & DMA_SxCR_DBM) && (regs->CR & DMA_SxCR_CT)) {
+            address = regs->M1AR;
+        }
+        ((uint8_t *) (uintptr_t) address)[p_stream->ndtr - ndtr] = p_data[done++];
+        ndtr--;
+        if (ndtr == 0U) {
+            if (regs->CR & DMA_SxCR_DBM) {
+                regs->CR ^= DMA_SxCR_CT;
+                ndtr = p_stream->ndtr;
+            } else if (regs->CR & DMA_SxCR_CIRC) {
+                ndtr = p_stream->ndtr;
+            } else {
+                sim_dma_complete(p_stream);
+                return done;
+            }
+            regs->NDTR = ndtr;
+            p_stream->sim_ndtr = ndtr;
+            dma_transfer_complete(p_stream);
+            continue;
+        }
+        regs->NDTR = ndtr;
+        p_stream->sim_ndtr = ndtr;
+    }
+    return done;
+}
+
+static void dma_stream_start(sim_dma_stream_t *p_stream) {
+    p_stream->enabled = 1;
+    p_stream->m0ar = p_stream->regs->M0AR;
+    p_stream->ndtr = (uint16_t) p_stream->regs->NDTR;
+    p_stream->sim_ndtr = p_stream->ndtr;
+    dma_flag_clear(p_stream);
+    if (p_stream->start != NULL) {
+        p_stream->start(p_stream);
+    }
+}
+
+static void dma_poll(void) {
+    for (int32_t d = 0; d < 2; d++) {
+        DMA_TypeDef *dma = dma_stream[d][0].dma;
+
+        //写1清除
+        if (dma->LIFCR) {
+            dma->LISR &= ~dma->LIFCR;
+            dma->LIFCR = 0;
+        }
+        if (dma->HIFCR) {
+            dma->HISR &= ~dma->HIFCR;
+            dma->HIFCR = 0;
+        }
+        for (int32_t s = 0; s < SIM_DMA_STREAM_NUM; s++) {
+            sim_dma_stream_t *p_stream = &dma_stream[d][s];
+            uint32_t en = p_stream->regs->CR & DMA_SxCR_EN;
+
+            if (en && !p_stream->enabled) {
+                dma_stream_start(p_stream);
+            } else if (!en && p_stream->enabled) {
+                //固件中止传输
+                p_stream->enabled = 0;
+                sim_event_cancel(&p_stream->done);
+            } else if (en && p_stream->start != NULL && p_stream->regs->NDTR != p_stream->sim_ndtr) {
+                //两个同步点之间关闭又重新启动
+                sim_event_cancel(&p_stream->done);
+                dma_stream_start(p_stream);
+            }
+        }
+    }
+}
+
+/* ---------------- 串口 ---------------- */
+
+static sim_uart_t *uart_get(USART_TypeDef *uart) {
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        if (uart_table[i].uart == uart) {
+            return &uart_table[i];
+        }
+    }
+    sim_fail("no model for the uart at 0x%08lx", (unsigned long) (uintptr_t) uart);
+}
+
+sim_time_t sim_uart_byte_time(USART_TypeDef *uart) {
+    sim_uart_t *p_uart = uart_get(uart);
+    uint32_t bits = 10U;
+
+    if (uart->BRR == 0U) {
+        return SIM_US(100);
+    }
+    if (uart->CR1 & USART_CR1_PCE) {
+        bits++;
+    }
+    if ((uart->CR2 & USART_CR2_STOP) == USART_CR2_STOP_1) {
+        bits++;
+    }
+    //BRR = PCLK / 波特率
+    return (sim_time_t) bits * uart->BRR * (SIM_CPU_HZ / p_uart->pclk);
+}
+
+static void uart_idle_fn(void *arg) {
+    sim_uart_t *p_uart = arg;
+
+    p_uart->uart->SR |= USART_SR_IDLE;
+    if (p_uart->uart->CR1 & USART_CR1_IDLEIE) {
+        sim_irq_pend(p_uart->irq);
+    }
+}
+
+//读SR再读DR清除IDLE, 在中断返回时完成
+static void uart_exit_hook(void) {
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        uart_table[i].uart->SR &= ~(USART_SR_IDLE | USART_SR_RXNE | USART_SR_ORE);
+    }
+}
+
+void sim_uart_receive(USART_TypeDef *uart, const uint8_t *p_data, uint16_t len) {
+    sim_uart_t *p_uart = uart_get(uart);
+    uint16_t done = 0;
+
+    if ((uart->CR1 & USART_CR1_UE) && (uart->CR3 & USART_CR3_DMAR) && p_uart->p_rx != NULL) {
+        done = sim_dma_receive(p_uart->p_rx, p_data, len);
+    }
+    p_uart->rx_bytes += done;
+    p_uart->rx_dropped += len - done;
+    sim_event_at(&p_uart->idle, sim_now + sim_uart_byte_time(uart));
+}
+
+void sim_uart_set_sink(USART_TypeDef *uart, sim_uart_sink_f sink) {
+    uart_get(uart)->sink = sink;
+}
+
+static void uart_tx_done(void *arg) {
+    sim_dma_stream_t *p_stream = arg;
+
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        sim_uart_t *p_uart = &uart_table[i];
+        if (p_uart->p_tx == p_stream) {
+            p_uart->tx_bytes += p_stream->ndtr;
+            if (p_uart->sink != NULL && p_stream->ndtr != 0U) {
+                p_uart->sink((const uint8_t *) (uintptr_t) p_stream->m0ar, p_stream->ndtr);
+            }
+        }
+    }
+    sim_dma_complete(p_stream);
+}
+
+//发送流启动, 数据在最后一个字节发出时交给接收方
+static void uart_tx_start(sim_dma_stream_t *p_stream) {
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        if (uart_table[i].p_tx == p_stream) {
+            sim_event_at(&p_stream->done, sim_now + p_stream->ndtr * sim_uart_byte_time(uart_table[i].uart));
+        }
+    }
+}
+
+/* ---------------- EXTI ---------------- */
+
+static IRQn_Type exti_irq(uint32_t line) {
+    static const IRQn_Type low[5] = {EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn};
+    if (line < 5U) {
+        return low[line];
+    }
+    return (line < 10U) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+}
+
+void sim_periph_exti_raise(uint16_t pin) {
+    uint32_t line = (uint32_t) __builtin_ctz(pin);
+
+    if (EXTI->IMR & pin) {
+        EXTI->PR |= pin;
+        sim_irq_pend(exti_irq(line));
+    }
+}
+
+static void exti_poll(void) {
+    uint32_t swier = EXTI->SWIER & 0xFFFFU;
+
+    if (swier == 0U) {
+        return;
+    }
+    EXTI->SWIER &= ~swier;
+    for (uint32_t line = 0; line < 16U; line++) {
+        if (swier & (1U << line)) {
+            EXTI->PR |= 1U << line;
+            sim_irq_pend(exti_irq(line));
+        }
+    }
+}
+
+/* ---------------- GPIO ---------------- */
+
+void sim_periph_gpio_write(GPIO_TypeDef *port, uint16_t pin, int state) {
+    if (state) {
+        port->ODR |= pin;
+    } else {
+        port->ODR &= ~(uint32_t) pin;
+    }
+    if (port == CS1_ACCEL_GPIO_Port || port == CS1_GYRO_GPIO_Port) {
+        sim_bmi088_select(!(CS1_ACCEL_GPIO_Port->ODR & CS1_ACCEL_Pin), !(CS1_GYRO_GPIO_Port->ODR & CS1_GYRO_Pin));
+    }
+}
+
+int sim_periph_gpio_read(GPIO_TypeDef *port, uint16_t pin) {
+    return (port->IDR & pin) ? 1 : 0;
+}
+
+/* ---------------- DWT ---------------- */
+
+//CYCCNT = 虚拟时钟 - 偏移, 固件写CYCCNT或开关计数时重新计算偏移
+DWT_Type *sim_dwt_sync(void) {
+    DWT_Type *dwt = (DWT_Type *) DWT_BASE;
+    uint8_t running = (dwt->CTRL & DWT_CTRL_CYCCNTENA_Msk) && (CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+
+    sim_sync();
+    if (dwt->CYCCNT != dwt_written || running != dwt_running) {
+        dwt_offset = sim_now - dwt->CYCCNT;
+        dwt_running = running;
+    }
+    if (running) {
+        dwt->CYCCNT = (uint32_t) (sim_now - dwt_offset);
+    }
+    dwt_written = dwt->CYCCNT;
+    return dwt;
+}
+
+/* ---------------- 初始化和轮询 ---------------- */
+
+void sim_periph_init(void) {
+    for (int32_t d = 0; d < 2; d++) {
+        for (int32_t s = 0; s < SIM_DMA_STREAM_NUM; s++) {
+            sim_dma_stream_t *p_stream = &dma_stream[d][s];
+            memset(p_stream, 0, sizeof(*p_stream));
+            p_stream->dma = d ? DMA2 : DMA1;
+            p_stream->regs = (DMA_Stream_TypeDef *) ((uintptr_t) p_stream->dma + 0x10U + 0x18U * (uint32_t) s);
+            p_stream->index = (uint8_t) s;
+            p_stream->irq = dma_irq[d][s];
+            sim_event_init(&p_stream->done, NULL, p_stream);
+        }
+    }
+
+    uart_table[0] = (sim_uart_t) {USART1, sim_dma_stream(DMA2, 5), sim_dma_stream(DMA2, 7), USART1_IRQn, 84000000U};
+    uart_table[1] = (sim_uart_t) {USART3, sim_dma_stream(DMA1, 1), NULL, USART3_IRQn, 42000000U};
+    uart_table[2] = (sim_uart_t) {USART6, sim_dma_stream(DMA2, 1), sim_dma_stream(DMA2, 6), USART6_IRQn, 84000000U};
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        sim_uart_t *p_uart = &uart_table[i];
+        sim_event_init(&p_uart->idle, uart_idle_fn, p_uart);
+        sim_irq_set_exit_hook(p_uart->irq, uart_exit_hook);
+        if (p_uart->p_tx != NULL) {
+            p_uart->p_tx->start = uart_tx_start;
+            p_uart->p_tx->done.fn = uart_tx_done;
+        }
+    }
+}
+
+void sim_periph_poll(void) {
+    dma_poll();
+    exti_poll();
+}
+
+void sim_periph_report(FILE *fp) {
+    static const char *name[3] = {"USART1", "USART3", "USART6"};
+    fprintf(fp, "\n%-8s %10s %10s %10s\n", "uart", "rx_bytes", "rx_lost", "tx_bytes");
+    for (size_t i = 0; i < sizeof(uart_table) / sizeof(uart_table[0]); i++) {
+        fprintf(fp, "%-8s %10u %10u %10u\n", name[i], uart_table[i].rx_bytes, uart_table[i].rx_dropped,
+                uart_table[i].tx_bytes);
+    }
+}
@@ -0,0 +1,470 @@
+/**
+  * @file       sim_port.c
+  * @brief      FreeRTOS port of the host simulation. Every task runs on its own
+  *             host thread and exactly one of them holds the CPU, the context
+  *             switch hands the CPU over with a semaphore pair. BASEPRI, the
+  *             critical nesting and the SysTick follow the Cortex-M4 port, so
+  *             the kernel, the interrupt masking and the preemption points are
+  *             the ones of the target. The trace hooks turn the ready and block
+  *             transitions into jobs for the per task response time and
+  *             deadline statistics.
+  *             主机仿真的FreeRTOS移植. 每个任务运行在一个主机线程上, 同一时刻只有一个
+  *             线程占有CPU, 任务切换用一对信号量交出CPU. BASEPRI、临界区嵌套和SysTick
+  *             与Cortex-M4移植一致, 因此内核、中断屏蔽和抢占点都与目标板相同.
+  *             跟踪钩子把就绪和阻塞转换为作业, 统计每个任务的响应时间和截止时间
+  */
+#include "sim.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SIM_THREAD_STACK    (256U * 1024U)
+#define SIM_TASK_MAX        32
+#define SIM_TASK_RULE_MAX   32
+#define SIM_TICK_CYCLES     (SIM_CPU_HZ / configTICK_RATE_HZ)
+//与tasks.c的默认值一致
+#ifndef configIDLE_TASK_NAME
+#define configIDLE_TASK_NAME "IDLE"
+#endif
+
+typedef struct sim_thread {
+    sim_account_t account;
+    char name[configMAX_TASK_NAME_LEN];
+    pthread_t thread;
+    sem_t run;
+    TaskFunction_t code;
+    void *param;
+    void *tcb;
+    UBaseType_t priority;
+
+    uint8_t job_active;             //已就绪且尚未阻塞
+    uint8_t job_started;            //本次作业已开始执行
+    sim_time_t release;
+    uint32_t block_count;
+    uint32_t job_seen;              //含被忽略的第一次作业
+    sim_time_t deadline;            //0为不检查
+    uint8_t deadline_fixed;         //由命令行或默认值给定, 不随周期改变
+    sim_time_t period;              //vTaskDelayUntil的周期
+    sim_time_t exec_add;            //每次阻塞前额外注入的执行时间
+
+    uint32_t *response;             //每次作业的响应时间, 周期数
+    uint32_t response_num;
+    uint32_t response_cap;
+    sim_time_t response_sum;
+    sim_time_t response_max;
+    sim_time_t response_max_at;     //最长响应时间的作业结束时刻
+    sim_time_t start_max;           //就绪到开始执行
+    uint32_t misses;
+    uint32_t overruns;              //vTaskDelayUntil没有阻塞
+} sim_thread_t;
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    double deadline_us;
+    double exec_add_us;
+} sim_task_rule_t;
+
+extern void * volatile pxCurrentTCB;
+
+struct _reent *_impure_ptr = NULL;
+
+static UBaseType_t uxCriticalNesting = 0xaaaaaaaaUL;
+static sim_thread_t *thread_list[SIM_TASK_MAX];
+static int32_t thread_num = 0;
+static sim_thread_t *current_thread = NULL;
+static sem_t boot_sem;
+static uint8_t scheduler_running = 0;
+static uint64_t switch_count = 0;
+
+static sim_task_rule_t task_rule[SIM_TASK_RULE_MAX];
+static int32_t task_rule_num = 0;
+
+static sim_event_t tick_event;
+static sim_time_t tick_base = 0;
+
+//任务控制块的第一个成员是栈顶, 线程指针保存在栈顶
+#define thread_of(p_tcb) (*(sim_thread_t **) (*(StackType_t **) (p_tcb)))
+
+static sim_task_rule_t *task_rule_get(const char *name) {
+    for (int32_t i = 0; i < task_rule_num; i++) {
+        if (strncmp(task_rule[i].name, name, sizeof(task_rule[i].name) - 1U) == 0) {
+            return &task_rule[i];
+        }
+    }
+    if (task_rule_num >= SIM_TASK_RULE_MAX) {
+        sim_fail("too many task options");
+    }
+    memset(&task_rule[task_rule_num], 0, sizeof(task_rule[0]));
+    strncpy(task_rule[task_rule_num].name, name, sizeof(task_rule[0].name) - 1U);
+    return &task_rule[task_rule_num++];
+}
+
+void sim_port_set_deadline(const char *name, double us) {
+    task_rule_get(name)->deadline_us = us;
+}
+
+void sim_port_add_exec(const char *name, double us) {
+    task_rule_get(name)->exec_add_us = us;
+}
+
+static void thread_wait(sim_thread_t *p_thread) {
+    while (sem_wait(&p_thread->run) != 0) {
+        if (errno != EINTR) {
+            sim_fail("sem_wait: %s", strerror(errno));
+        }
+    }
+}
+
+static void *thread_main(void *arg) {
+    sim_thread_t *p_thread = arg;
+
+    thread_wait(p_thread);
+    sim_cpu_restart_segment();
+    p_thread->code(p_thread->param);
+    sim_fail("task %s returned", p_thread->name);
+}
+
+//第一次就绪时任务名已经写入控制块, 在tasks.c中读取, 不调用内核接口
+static void thread_name(sim_thread_t *p_thread, void *p_tcb, const char *name) {
+    if (p_thread->tcb != NULL) {
+        return;
+    }
+    p_thread->tcb = p_tcb;
+    strncpy(p_thread->name, name, sizeof(p_thread->name) - 1U);
+    p_thread->account.name = p_thread->name;
+    for (int32_t i = 0; i < task_rule_num; i++) {
+        if (strcmp(task_rule[i].name, p_thread->name) == 0) {
+            if (task_rule[i].deadline_us > 0.0) {
+                p_thread->deadline = (sim_time_t) (task_rule[i].deadline_us * (SIM_CPU_HZ / 1000000U));
+                p_thread->deadline_fixed = 1;
+            }
+            p_thread->exec_add = (sim_time_t) (task_rule[i].exec_add_us * (SIM_CPU_HZ / 1000000U));
+        }
+    }
+}
+
+/* ---------------- 移植接口 ---------------- */
+
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters) {
+    sim_thread_t *p_thread;
+    pthread_attr_t attr;
+    void *stack;
+
+    if (thread_num >= SIM_TASK_MAX) {
+        sim_fail("too many tasks");
+    }
+    p_thread = calloc(1, sizeof(sim_thread_t));
+    //固件会把栈上缓冲区的地址转为32位写入DMA寄存器
+    stack = mmap(NULL, SIM_THREAD_STACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (p_thread == NULL || stack == MAP_FAILED) {
+        sim_fail("no memory for a task thread");
+    }
+    p_thread->code = pxCode;
+    p_thread->param = pvParameters;
+    p_thread->account.name = "?";
+    sem_init(&p_thread->run, 0, 0);
+
+    sim_sync();
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, SIM_THREAD_STACK);
+    if (pthread_create(&p_thread->thread, &attr, thread_main, p_thread) != 0) {
+        sim_fail("pthread_create failed");
+    }
+    pthread_attr_destroy(&attr);
+    sim_cpu_restart_segment();
+
+    thread_list[thread_num++] = p_thread;
+    *(sim_thread_t **) pxTopOfStack = p_thread;
+    return pxTopOfStack;
+}
+
+static void tick_event_fn(void *arg) {
+    const SysTick_Type *systick = (SysTick_Type *) SysTick_BASE;
+    (void) arg;
+    tick_base += (sim_time_t) systick->LOAD + 1U;
+    sim_irq_pend(SysTick_IRQn);
+    sim_event_at(&tick_event, tick_base + systick->LOAD + 1U);
+}
+
+BaseType_t xPortStartScheduler(void) {
+    SysTick_Type *systick = (SysTick_Type *) SysTick_BASE;
+    sim_thread_t *p_first;
+
+    sim_irq_set_priority(SysTick_IRQn, configKERNEL_INTERRUPT_PRIORITY >> 4);
+    systick->LOAD = SIM_TICK_CYCLES - 1UL;
+    systick->VAL = 0;
+    systick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+    sim_sync();
+    tick_base = sim_now;
+    sim_event_init(&tick_event, tick_event_fn, NULL);
+    sim_event_at(&tick_event, tick_base + SIM_TICK_CYCLES);
+
+    uxCriticalNesting = 0;
+    scheduler_running = 1;
+    p_first = thread_of(pxCurrentTCB);
+    p_first->job_started = 1;
+    current_thread = p_first;
+    sim_cpu_set_base(&p_first->account);
+    host_basepri = 0;
+
+    //启动代码的线程交出CPU后不再运行
+    sem_init(&boot_sem, 0, 0);
+    sem_post(&p_first->run);
+    for (;;) {
+        sem_wait(&boot_sem);
+    }
+    return 0;
+}
+
+void vPortEndScheduler(void) {
+    sim_fail("vPortEndScheduler is not supported");
+}
+
+//SysTick_Handler, 与Cortex-M4移植相同
+void xPortSysTickHandler(void) {
+    vPortDisableInterrupts();
+    if (xTaskIncrementTick() != pdFALSE) {
+        sim_cpu_request_switch();
+    }
+    vPortEnableInterrupts();
+}
+
+void vPortYield(void) {
+    sim_cpu_request_switch();
+    sim_sync();
+}
+
+void vPortEnterCritical(void) {
+    sim_basepri_write(configMAX_SYSCALL_INTERRUPT_PRIORITY);
+    uxCriticalNesting++;
+}
+
+void vPortExitCritical(void) {
+    uxCriticalNesting--;
+    if (uxCriticalNesting == 0U) {
+        sim_basepri_write(0);
+    }
+}
+
+void vPortDisableInterrupts(void) {
+    sim_basepri_write(configMAX_SYSCALL_INTERRUPT_PRIORITY);
+}
+
+void vPortEnableInterrupts(void) {
+    sim_basepri_write(0);
+}
+
+UBaseType_t uxPortSetInterruptMask(void) {
+    UBaseType_t mask = host_basepri;
+    sim_basepri_write(configMAX_SYSCALL_INTERRUPT_PRIORITY);
+    return mask;
+}
+
+void vPortClearInterruptMask(UBaseType_t mask) {
+    sim_basepri_write((uint32_t) mask);
+}
+
+void _reclaim_reent(struct _reent *p_reent) {
+    (void) p_reent;
+}
+
+void vApplicationIdleHook(void) {
+    sim_idle();
+}
+
+/* ---------------- 任务切换 ---------------- */
+
+int sim_port_switch_allowed(void) {
+    return scheduler_running;
+}
+
+void sim_port_switch(void) {
+    sim_thread_t *p_from = current_thread;
+    sim_thread_t *p_to;
+
+    vTaskSwitchContext();
+    p_to = thread_of(pxCurrentTCB);
+    if (p_to == p_from) {
+        return;
+    }
+    switch_count++;
+    current_thread = p_to;
+    sim_cpu_set_base(&p_to->account);
+    sem_post(&p_to->run);
+    thread_wait(p_from);
+    //被切换回来时由切换方设置了记账对象
+}
+
+/* ---------------- 作业统计 ---------------- */
+
+static void job_end(sim_thread_t *p_thread) {
+    sim_time_t response;
+
+    if (!p_thread->job_active) {
+        return;
+    }
+    p_thread->job_active = 0;
+    //第一次作业包含初始化, 启动阶段的作业也不统计
+    if (p_thread->job_seen++ == 0U || p_thread->release < sim_option.settle) {
+        return;
+    }
+    response = sim_now - p_thread->release;
+    if (p_thread->response_num == p_thread->response_cap) {
+        p_thread->response_cap = p_thread->response_cap ? p_thread->response_cap * 2U : 1024U;
+        p_thread->response = realloc(p_thread->response, p_thread->response_cap * sizeof(uint32_t));
+        if (p_thread->response == NULL) {
+            sim_fail("no memory for the response times");
+        }
+    }
+    p_thread->response[p_thread->response_num++] = (response > UINT32_MAX) ? UINT32_MAX : (uint32_t) response;
+    p_thread->response_sum += response;
+    if (response > p_thread->response_max) {
+        p_thread->response_max = response;
+        p_thread->response_max_at = sim_now;
+    }
+    if (p_thread->deadline != 0U && response > p_thread->deadline) {
+        p_thread->misses++;
+    }
+}
+
+void sim_trace_ready(void *p_tcb, unsigned long priority, const char *name) {
+    sim_thread_t *p_thread = thread_of(p_tcb);
+
+    thread_name(p_thread, p_tcb, name);
+    p_thread->priority = priority;
+    if (!p_thread->job_active) {
+        p_thread->job_active = 1;
+        p_thread->job_started = 0;
+        p_thread->release = sim_now;
+    }
+}
+
+void sim_trace_switched_out(long still_ready) {
+    sim_thread_t *p_thread = thread_of(pxCurrentTCB);
+
+    if (!still_ready) {
+        p_thread->block_count++;
+        job_end(p_thread);
+    }
+}
+
+void sim_trace_switched_in(void) {
+    sim_thread_t *p_thread = thread_of(pxCurrentTCB);
+
+    if (p_thread->job_active && !p_thread->job_started) {
+        p_thread->job_started = 1;
+        if (p_thread->job_seen > 0U && p_thread->release >= sim_option.settle &&
+            sim_now - p_thread->release > p_thread->start_max) {
+            p_thread->start_max = sim_now - p_thread->release;
+        }
+    }
+}
+
+/* ---------------- 阻塞调用的包装, 链接时--wrap ---------------- */
+
+extern void __real_vTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement);
+extern uint32_t __real_ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+extern void __real_vTaskDelay(const TickType_t xTicksToDelay);
+
+static void exec_add(void) {
+    if (current_thread != NULL && current_thread->exec_add != 0U && !sim_in_isr()) {
+        sim_busy(current_thread->exec_add);
+    }
+}
+
+void __wrap_vTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement) {
+    sim_thread_t *p_thread = current_thread;
+    uint32_t block_count;
+
+    exec_add();
+    p_thread->period = (sim_time_t) xTimeIncrement * SIM_TICK_CYCLES;
+    if (!p_thread->deadline_fixed) {
+        p_thread->deadline = p_thread->period;
+    }
+    block_count = p_thread->block_count;
+    __real_vTaskDelayUntil(pxPreviousWakeTime, xTimeIncrement);
+    //唤醒时刻已过, 本周期超时
+    if (p_thread->block_count == block_count && p_thread->job_seen > 0U && sim_now >= sim_option.settle) {
+        p_thread->overruns++;
+    }
+}
+
+uint32_t __wrap_ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    exec_add();
+    return __real_ulTaskNotifyTake(xClearCountOnExit, xTicksToWait);
+}
+
+void __wrap_vTaskDelay(const TickType_t xTicksToDelay) {
+    exec_add();
+    __real_vTaskDelay(xTicksToDelay);
+}
+
+/* ---------------- 报告 ---------------- */
+
+static int response_compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int thread_compare(const void *a, const void *b) {
+    const sim_thread_t *x = *(sim_thread_t *const *) a, *y = *(sim_thread_t *const *) b;
+    if (x->priority != y->priority) {
+        return (x->priority < y->priority) ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+void sim_port_report(FILE *fp, sim_time_t elapsed, int *p_misses) {
+    sim_thread_t *sorted[SIM_TASK_MAX];
+    double idle = 0.0;
+
+    memcpy(sorted, thread_list, sizeof(sorted[0]) * (size_t) thread_num);
+    qsort(sorted, (size_t) thread_num, sizeof(sorted[0]), thread_compare);
+    *p_misses = 0;
+    fprintf(fp, "\n%-16s %4s %7s %7s %9s %9s %9s %9s %9s %9s %9s %6s %7s\n", "task", "prio", "load%", "jobs",
+            "mean_us", "p99_us", "max_us", "max_at_ms", "start_us", "period_us", "dl_us", "miss", "overrun");
+    for (int32_t i = 0; i < thread_num; i++) {
+        sim_thread_t *p_thread = sorted[i];
+        double p99 = 0.0, mean = 0.0;
+
+        //结束时仍未完成且已超过截止时间的作业, 例如被高优先级任务饿死
+        if (p_thread->job_active && p_thread->job_seen > 0U && p_thread->release >= sim_option.settle &&
+            p_thread->deadline != 0U && elapsed - p_thread->release > p_thread->deadline) {
+            p_thread->misses++;
+        }
+        if (p_thread->response_num > 0U) {
+            qsort(p_thread->response, p_thread->response_num, sizeof(uint32_t), response_compare);
+            p99 = SIM_TO_US(p_thread->response[(p_thread->response_num * 99U + 99U) / 100U - 1U]);
+            mean = SIM_TO_US(p_thread->response_sum) / p_thread->response_num;
+        }
+        if (strcmp(p_thread->name, configIDLE_TASK_NAME) == 0) {
+            idle = 100.0 * (double) p_thread->account.busy / (double) elapsed;
+        }
+        fprintf(fp, "%-16s %4lu %7.2f %7u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %6u %7u\n", p_thread->name,
+                (unsigned long) p_thread->priority, 100.0 * (double) p_thread->account.busy / (double) elapsed,
+                p_thread->response_num, mean, p99, SIM_TO_US(p_thread->response_max),
+                SIM_TO_US(p_thread->response_max_at) / 1000.0,
+                SIM_TO_US(p_thread->start_max), SIM_TO_US(p_thread->period), SIM_TO_US(p_thread->deadline),
+                p_thread->misses, p_thread->overruns);
+        *p_misses += (int) (p_thread->misses + p_thread->overruns);
+    }
+    fprintf(fp, "cpu load %.2f%%, context switches %lu\n", 100.0 - idle, (unsigned long) switch_count);
+}
+
+/* ---------------- SysTick寄存器 ---------------- */
+
+//VAL按虚拟时钟计算, bsp_delay的忙等循环读它
+SysTick_Type *sim_systick_sync(void) {
+    SysTick_Type *systick = (SysTick_Type *) SysTick_BASE;
+
+    sim_sync();
+    if (scheduler_running && (systick->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+        systick->VAL = (uint32_t) (systick->LOAD - (sim_now - tick_base) % ((sim_time_t) systick->LOAD + 1U));
+    }
+    return systick;
+}
@@ -0,0 +1,697 @@
+/**
+  * @file       sim_robot.c
+  * @brief      the devices around the board: the BMI088 and IST8310 register
+  *             models with their data ready lines, the DJI motors and the
+  *             super capacitor on the two CAN buses, the remote control,
+  *             referee and vision frames on the serial ports, the ADC inputs
+  *             and the IMU heater. The motors are first order plants driven by
+  *             the current frames of the firmware, the gimbal pose of the
+  *             yaw and pitch motors feeds the IMU, so the control loops run on
+  *             closed feedback.
+  *             板子周围的设备: 带数据就绪引脚的BMI088和IST8310寄存器模型、两路CAN上的
+  *             大疆电机和超级电容、串口上的遥控器、裁判系统和视觉帧、ADC输入和IMU加热.
+  *             电机为由固件电流帧驱动的一阶对象, 云台yaw和pitch电机的姿态送给IMU,
+  *             控制回路在闭环反馈下运行
+  */
+#include "sim.h"
+#include "main.h"
+#include "BMI088reg.h"
+#include "ist8310driver.h"
+#include "CAN_receive.h"
+#include "remote_control.h"
+#include "referee_task.h"
+#include "vision_task.h"
+#include "CRC8_CRC16.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_G                   9.80665f
+#define SIM_PI                  3.14159265358979f
+#define SIM_ROBOT_STEP          SIM_MS(1)
+#define SIM_ROBOT_DT            0.001f
+
+#define SIM_MOTOR_NUM           7
+#define SIM_MOTOR_FEEDBACK      SIM_MS(1)
+#define SIM_CAP_FEEDBACK        SIM_MS(10)
+#define SIM_RC_PERIOD           SIM_MS(14)
+#define SIM_VISION_PERIOD       SIM_MS(10)
+#define SIM_REFEREE_STATUS      SIM_MS(100)
+#define SIM_REFEREE_POWER       SIM_MS(20)
+#define SIM_IST8310_PERIOD      SIM_MS(5)
+#define SIM_IST8310_WHO_AM_I    0x10
+//交叉轴矩阵对角元素, 与驱动中的OTPsensitivity相同时逆矩阵为单位阵
+#define SIM_IST8310_DIAG        330
+
+//云台机械限位, 与sim_mem.c中的校准数据一致
+#define SIM_PITCH_OFFSET_ECD    4096
+#define SIM_PITCH_MAX           0.45f
+#define SIM_PITCH_MIN           (-0.35f)
+
+//加热: 满占空比时比环境高45度, 时间常数30s
+#define SIM_AMBIENT_TEMP        25.0f
+#define SIM_HEATER_RISE         45.0f
+#define SIM_HEATER_TAU          30.0f
+
+typedef enum {
+    SIM_MOTOR_3508 = 0,
+    SIM_MOTOR_6020,
+    SIM_MOTOR_2006,
+} sim_motor_type_e;
+
+typedef struct {
+    const char *name;
+    CAN_TypeDef *can;
+    uint16_t feedback_id;
+    uint16_t cmd_id;
+    uint8_t slot;                   //命令帧中的位置
+    sim_motor_type_e type;
+    float gain;                     //稳态转速/命令, rpm
+    float tau;                      //s
+    float max_rpm;
+    int16_t cmd;
+    float rpm;
+    float angle;                    //转子角度 rad
+    uint32_t cmd_frames;
+    sim_event_t feedback;
+} sim_motor_t;
+
+typedef struct {
+    uint8_t acc_reg[128];
+    uint8_t gyro_reg[64];
+    uint8_t accel_cs;
+    uint8_t gyro_cs;
+    uint8_t index;                  //片选拉低后的字节序号
+    uint8_t addr;
+    uint8_t read;
+    sim_event_t accel_drdy;
+    sim_event_t gyro_drdy;
+    uint32_t accel_samples;
+    uint32_t gyro_samples;
+} sim_bmi088_t;
+
+typedef struct {
+    uint8_t reg[256];
+    sim_event_t drdy;
+    uint32_t samples;
+} sim_ist8310_t;
+
+typedef struct {
+    sim_motor_t motor[SIM_MOTOR_NUM];
+    sim_event_t step;
+    sim_event_t cap_feedback;
+    sim_event_t rc;
+    sim_event_t vision;
+    sim_event_t referee_status;
+    sim_event_t referee_power;
+    uint16_t cap_power;             //固件发给超级电容的功率, 0.01W
+    uint32_t cap_cmd_frames;
+    float chassis_power;
+    float power_buffer;
+    float imu_temp;
+    uint16_t vision_seq;
+    uint8_t referee_seq;
+    uint32_t rc_frames;
+    uint32_t vision_frames;
+    uint32_t referee_frames;
+    uint64_t referee_tx_bytes;
+    FILE *referee_fp;
+    uint32_t rand_state;
+} sim_robot_t;
+
+static sim_robot_t robot;
+static sim_bmi088_t bmi088;
+static sim_ist8310_t ist8310;
+
+static const sim_motor_t motor_init[SIM_MOTOR_NUM] = {
+        {"chassis1", CAN1, CAN_3508_M1_ID,     CAN_IDENTIFIER_0X200, 0, SIM_MOTOR_3508, 0.6f,   0.08f, 9000.0f},
+        {"chassis2", CAN1, CAN_3508_M2_ID,     CAN_IDENTIFIER_0X200, 1, SIM_MOTOR_3508, 0.6f,   0.08f, 9000.0f},
+        {"chassis3", CAN1, CAN_3508_M3_ID,     CAN_IDENTIFIER_0X200, 2, SIM_MOTOR_3508, 0.6f,   0.08f, 9000.0f},
+        {"chassis4", CAN1, CAN_3508_M4_ID,     CAN_IDENTIFIER_0X200, 3, SIM_MOTOR_3508, 0.6f,   0.08f, 9000.0f},
+        {"yaw",      CAN1, CAN_YAW_MOTOR_ID,   CAN_IDENTIFIER_0X1FF,  0, SIM_MOTOR_6020, 0.011f, 0.03f, 320.0f},
+        {"pitch",    CAN2, CAN_PITCH_MOTOR_ID, CAN_IDENTIFIER_0X1FF,  0, SIM_MOTOR_6020, 0.011f, 0.03f, 320.0f},
+        {"trigger",  CAN2, CAN_TRIGGER_MOTOR_ID, CAN_IDENTIFIER_0X1FF, 2, SIM_MOTOR_2006, 1.5f,  0.05f, 16000.0f},
+};
+
+//摩擦轮占用CAN2的0x201和0x204
+static const sim_motor_t fric_init[2] = {
+        {"fric1", CAN2, CAN_3508_M1_ID, CAN_IDENTIFIER_0X200, 0, SIM_MOTOR_3508, 0.6f, 0.08f, 9000.0f},
+        {"fric2", CAN2, CAN_3508_M4_ID, CAN_IDENTIFIER_0X200, 3, SIM_MOTOR_3508, 0.6f, 0.08f, 9000.0f},
+};
+
+static sim_motor_t fric[2];
+
+#define robot_motor_each(p_motor, body)                         \
+    for (int32_t motor_i = 0; motor_i < SIM_MOTOR_NUM + 2; motor_i++) { \
+        sim_motor_t *p_motor = (motor_i < SIM_MOTOR_NUM) ? &robot.motor[motor_i] : &fric[motor_i - SIM_MOTOR_NUM]; \
+        body                                                    \
+    }
+
+//传感器噪声, 均匀分布
+static float robot_noise(float amplitude) {
+    robot.rand_state = robot.rand_state * 1103515245U + 12345U;
+    return amplitude * ((float) ((robot.rand_state >> 8) & 0xFFFFU) / 32768.0f - 1.0f);
+}
+
+static float motor_rad_per_s(const sim_motor_t *p_motor) {
+    return p_motor->rpm * 2.0f * SIM_PI / 60.0f;
+}
+
+static float pitch_angle(void) {
+    return robot.motor[5].angle - (float) SIM_PITCH_OFFSET_ECD * 2.0f * SIM_PI / 8192.0f;
+}
+
+/* ---------------- 被控对象 ---------------- */
+
+static void motor_step(sim_motor_t *p_motor) {
+    float target = p_motor->gain * p_motor->cmd;
+
+    if (target > p_motor->max_rpm) {
+        target = p_motor->max_rpm;
+    } else if (target < -p_motor->max_rpm) {
+        target = -p_motor->max_rpm;
+    }
+    p_motor->rpm += (target - p_motor->rpm) * SIM_ROBOT_DT / p_motor->tau;
+    p_motor->angle += motor_rad_per_s(p_motor) * SIM_ROBOT_DT;
+    p_motor->angle = fmodf(p_motor->angle, 2.0f * SIM_PI);
+    if (p_motor->angle < 0.0f) {
+        p_motor->angle += 2.0f * SIM_PI;
+    }
+}
+
+//1kHz推进电机、pitch限位、底盘功率和加热
+static void robot_step_fn(void *arg) {
+    (void) arg;
+    float power = 2.0f;
+    float duty = 0.0f;
+
+    robot_motor_each(p_motor, {
+        motor_step(p_motor);
+    })
+    if (pitch_angle() > SIM_PITCH_MAX || pitch_angle() < SIM_PITCH_MIN) {
+        float limit = (pitch_angle() > SIM_PITCH_MAX) ? SIM_PITCH_MAX : SIM_PITCH_MIN;
+        robot.motor[5].angle += limit - pitch_angle();
+        robot.motor[5].rpm = 0.0f;
+    }
+
+    //底盘功率: 24V母线, 电流命令16384对应20A
+    for (int32_t i = 0; i < 4; i++) {
+        power += 24.0f * fabsf((float) robot.motor[i].cmd) * 20.0f / 16384.0f * 0.3f;
+    }
+    robot.chassis_power = power;
+    robot.power_buffer += (60.0f - power) * SIM_ROBOT_DT;
+    if (robot.power_buffer > 60.0f) {
+        robot.power_buffer = 60.0f;
+    } else if (robot.power_buffer < 0.0f) {
+        robot.power_buffer = 0.0f;
+    }
+
+    if ((TIM10->CR1 & TIM_CR1_CEN) && (TIM10->CCER & TIM_CCER_CC1E)) {
+        duty = (float) TIM10->CCR1 / (float) (TIM10->ARR + 1U);
+        if (duty > 1.0f) {
+            duty = 1.0f;
+        }
+    }
+    robot.imu_temp += (SIM_AMBIENT_TEMP + duty * SIM_HEATER_RISE - robot.imu_temp) * SIM_ROBOT_DT / SIM_HEATER_TAU;
+
+    sim_event_at(&robot.step, robot.step.time + SIM_ROBOT_STEP);
+}
+
+/* ---------------- CAN节点 ---------------- */
+
+static void motor_feedback_fn(void *arg) {
+    sim_motor_t *p_motor = arg;
+    sim_can_frame_t frame = {p_motor->feedback_id, 8, {0}};
+    uint16_t ecd = (uint16_t) (p_motor->angle / (2.0f * SIM_PI) * 8192.0f) & 0x1FFFU;
+    int16_t rpm = (int16_t) lrintf(p_motor->rpm);
+
+    frame.data[0] = (uint8_t) (ecd >> 8);
+    frame.data[1] = (uint8_t) ecd;
+    frame.data[2] = (uint8_t) ((uint16_t) rpm >> 8);
+    frame.data[3] = (uint8_t) rpm;
+    frame.data[4] = (uint8_t) ((uint16_t) p_motor->cmd >> 8);
+    frame.data[5] = (uint8_t) p_motor->cmd;
+    frame.data[6] = 35;
+    sim_can_node_send(p_motor->can, &frame);
+    sim_event_at(&p_motor->feedback, p_motor->feedback.time + SIM_MOTOR_FEEDBACK);
+}
+
+static void cap_feedback_fn(void *arg) {
+    (void) arg;
+    sim_can_frame_t frame = {CAN_SUPER_CAPACITANCE_RECEIVE_ID, 8, {0}};
+    uint16_t value[4] = {2400, 2000, (uint16_t) (robot.chassis_power / 24.0f * 100.0f),
+                         robot.cap_power};
+
+    for (int32_t i = 0; i < 4; i++) {
+        frame.data[2 * i] = (uint8_t) value[i];
+        frame.data[2 * i + 1] = (uint8_t) (value[i] >> 8);
+    }
+    sim_can_node_send(CAN1, &frame);
+    sim_event_at(&robot.cap_feedback, robot.cap_feedback.time + SIM_CAP_FEEDBACK);
+}
+
+//命令帧为4个大端int16
+static void robot_can_listener(CAN_TypeDef *can, const sim_can_frame_t *p_frame) {
+    if (can == CAN1 && p_frame->std_id == CAN_SUPER_CAPACITANCE_SENT_ID) {
+        robot.cap_power = (uint16_t) (p_frame->data[0] << 8 | p_frame->data[1]);
+        robot.cap_cmd_frames++;
+        return;
+    }
+    robot_motor_each(p_motor, {
+        if (p_motor->can == can && p_motor->cmd_id == p_frame->std_id) {
+            p_motor->cmd = (int16_t) (p_frame->data[2 * p_motor->slot] << 8 | p_frame->data[2 * p_motor->slot + 1]);
+            p_motor->cmd_frames++;
+        }
+    })
+}
+
+static void robot_can1_listener(const sim_can_frame_t *p_frame) {
+    robot_can_listener(CAN1, p_frame);
+}
+
+static void robot_can2_listener(const sim_can_frame_t *p_frame) {
+    robot_can_listener(CAN2, p_frame);
+}
+
+/* ---------------- BMI088 ---------------- */
+
+static void bmi088_accel_default(void) {
+    memset(bmi088.acc_reg, 0, sizeof(bmi088.acc_reg));
+    bmi088.acc_reg[BMI088_ACC_CHIP_ID] = BMI088_ACC_CHIP_ID_VALUE;
+    bmi088.acc_reg[BMI088_ACC_CONF] = 0xA8;
+    bmi088.acc_reg[BMI088_ACC_RANGE] = 0x01;
+    bmi088.acc_reg[BMI088_ACC_PWR_CONF] = 0x03;
+}
+
+static void bmi088_gyro_default(void) {
+    memset(bmi088.gyro_reg, 0, sizeof(bmi088.gyro_reg));
+    bmi088.gyro_reg[BMI088_GYRO_CHIP_ID] = BMI088_GYRO_CHIP_ID_VALUE;
+    bmi088.gyro_reg[BMI088_GYRO_BANDWIDTH] = BMI088_GYRO_BANDWIDTH_MUST_Set;
+    bmi088.gyro_reg[BMI088_GYRO_INT3_INT4_IO_CONF] = 0x0F;
+}
+
+static void reg_put16(uint8_t *p_reg, float value) {
+    int32_t raw = (int32_t) lrintf(value);
+    if (raw > 32767) {
+        raw = 32767;
+    } else if (raw < -32768) {
+        raw = -32768;
+    }
+    p_reg[0] = (uint8_t) raw;
+    p_reg[1] = (uint8_t) ((uint32_t) raw >> 8);
+}
+
+//锁存一次加速度计输出: 重力随pitch转动, 自检时叠加±1g
+static void bmi088_accel_latch(void) {
+    uint8_t range = bmi088.acc_reg[BMI088_ACC_RANGE] & 0x03U;
+    float lsb_per_ms2 = 32768.0f / (1.5f * (float) (2U << range) * SIM_G);
+    float accel[3] = {SIM_G * sinf(pitch_angle()), 0.0f, SIM_G * cosf(pitch_angle())};
+    uint8_t self_test = bmi088.acc_reg[BMI088_ACC_SELF_TEST];
+    uint32_t sensor_time = (uint32_t) (SIM_TO_US(sim_now) / 39.0625);
+    int16_t temp_raw = (int16_t) lrintf((robot.imu_temp - 23.0f) / 0.125f);
+
+    for (int32_t i = 0; i < 3; i++) {
+        accel[i] += robot_noise(0.02f);
+        if (self_test == BMI088_ACC_SELF_TEST_POSITIVE_SIGNAL) {
+            accel[i] += SIM_G;
+        } else if (self_test == BMI088_ACC_SELF_TEST_NEGATIVE_SIGNAL) {
+            accel[i] -= SIM_G;
+        }
+        reg_put16(&bmi088.acc_reg[BMI088_ACCEL_XOUT_L + 2 * i], accel[i] * lsb_per_ms2);
+    }
+    bmi088.acc_reg[BMI088_SENSORTIME_DATA_L] = (uint8_t) sensor_time;
+    bmi088.acc_reg[BMI088_SENSORTIME_DATA_M] = (uint8_t) (sensor_time >> 8);
+    bmi088.acc_reg[BMI088_SENSORTIME_DATA_H] = (uint8_t) (sensor_time >> 16);
+    bmi088.acc_reg[BMI088_TEMP_M] = (uint8_t) ((uint16_t) temp_raw >> 3);
+    bmi088.acc_reg[BMI088_TEMP_L] = (uint8_t) ((temp_raw & 0x07) << 5);
+}
+
+//云台坐标系: pitch绕y, yaw绕世界z, 在pitch后的机体系中分解
+static void bmi088_gyro_latch(void) {
+    static const float full_scale[5] = {2000.0f, 1000.0f, 500.0f, 250.0f, 125.0f};
+    uint8_t range = bmi088.gyro_reg[BMI088_GYRO_RANGE] & 0x07U;
+    float lsb_per_rad = 32768.0f / (full_scale[range < 5U ? range : 0U] * SIM_PI / 180.0f);
+    float yaw_rate = motor_rad_per_s(&robot.motor[4]);
+    float gyro[3] = {-yaw_rate * sinf(pitch_angle()), motor_rad_per_s(&robot.motor[5]),
+                     yaw_rate * cosf(pitch_angle())};
+
+    for (int32_t i = 0; i < 3; i++) {
+        reg_put16(&bmi088.gyro_reg[BMI088_GYRO_X_L + 2 * i], (gyro[i] + robot_noise(0.002f)) * lsb_per_rad);
+    }
+}
+
+static sim_time_t bmi088_accel_period(void) {
+    uint8_t odr = bmi088.acc_reg[BMI088_ACC_CONF] & 0x0FU;
+    if (odr < 0x05U) {
+        odr = 0x05U;
+    }
+    //0x05为12.5Hz, 每级加倍
+    return (sim_time_t) (SIM_CPU_HZ / 12.5) >> (odr - 0x05U);
+}
+
+static sim_time_t bmi088_gyro_period(void) {
+    static const uint32_t odr_hz[8] = {2000, 2000, 1000, 400, 200, 100, 200, 100};
+    return SIM_CPU_HZ / odr_hz[bmi088.gyro_reg[BMI088_GYRO_BANDWIDTH] & 0x07U];
+}
+
+static int bmi088_accel_active(void) {
+    return bmi088.acc_reg[BMI088_ACC_PWR_CTRL] == BMI088_ACC_ENABLE_ACC_ON &&
+           bmi088.acc_reg[BMI088_ACC_PWR_CONF] == BMI088_ACC_PWR_ACTIVE_MODE;
+}
+
+static void bmi088_accel_drdy_fn(void *arg) {
+    (void) arg;
+    if (bmi088_accel_active()) {
+        bmi088_accel_latch();
+        bmi088.accel_samples++;
+        if ((bmi088.acc_reg[BMI088_INT1_IO_CTRL] & BMI088_ACC_INT1_IO_ENABLE) &&
+            (bmi088.acc_reg[BMI088_INT_MAP_DATA] & BMI088_ACC_INT1_DRDY_INTERRUPT)) {
+            sim_periph_exti_raise(INT1_ACCEL_Pin);
+        }
+    }
+    sim_event_at(&bmi088.accel_drdy, bmi088.accel_drdy.time + bmi088_accel_period());
+}
+
+static void bmi088_gyro_drdy_fn(void *arg) {
+    (void) arg;
+    bmi088_gyro_latch();
+    bmi088.gyro_samples++;
+    if ((bmi088.gyro_reg[BMI088_GYRO_CTRL] & BMI088_DRDY_ON) &&
+        (bmi088.gyro_reg[BMI088_GYRO_INT3_INT4_IO_MAP] & BMI088_GYRO_DRDY_IO_INT3)) {
+        sim_periph_exti_raise(INT1_GYRO_Pin);
+    }
+    sim_event_at(&bmi088.gyro_drdy, bmi088.gyro_drdy.time + bmi088_gyro_period());
+}
+
+static void bmi088_accel_write(uint8_t reg, uint8_t value) {
+    if (reg == BMI088_ACC_SOFTRESET) {
+        if (value == BMI088_ACC_SOFTRESET_VALUE) {
+            bmi088_accel_default();
+        }
+        return;
+    }
+    if (reg != BMI088_ACC_CHIP_ID) {
+        bmi088.acc_reg[reg & 0x7FU] = value;
+    }
+    if (reg == BMI088_ACC_SELF_TEST) {
+        bmi088_accel_latch();
+    }
+}
+
+static void bmi088_gyro_write(uint8_t reg, uint8_t value) {
+    if (reg == BMI088_GYRO_SOFTRESET) {
+        if (value == BMI088_GYRO_SOFTRESET_VALUE) {
+            bmi088_gyro_default();
+        }
+        return;
+    }
+    if (reg == BMI088_GYRO_SELF_TEST) {
+        //自检立即完成且通过
+        if (value & BMI088_GYRO_TRIG_BIST) {
+            bmi088.gyro_reg[reg] = BMI088_GYRO_BIST_RDY;
+        }
+        return;
+    }
+    if (reg != BMI088_GYRO_CHIP_ID && reg < sizeof(bmi088.gyro_reg)) {
+        bmi088.gyro_reg[reg] = value;
+    }
+}
+
+void sim_bmi088_select(int accel_low, int gyro_low) {
+    if ((accel_low && !bmi088.accel_cs) || (gyro_low && !bmi088.gyro_cs)) {
+        bmi088.index = 0;
+    }
+    bmi088.accel_cs = (uint8_t) accel_low;
+    bmi088.gyro_cs = (uint8_t) gyro_low;
+}
+
+//加速度计读时地址后跟一个空字节, 多字节读写地址自增
+uint8_t sim_bmi088_transfer(uint8_t tx) {
+    uint8_t index = bmi088.index++;
+    uint8_t rx = 0xFFU;
+
+    if (bmi088.accel_cs == bmi088.gyro_cs) {
+        return rx;
+    }
+    if (index == 0U) {
+        bmi088.addr = tx & 0x7FU;
+        bmi088.read = (tx & 0x80U) != 0U;
+        return rx;
+    }
+    if (bmi088.accel_cs) {
+        if (bmi088.read) {
+            if (index >= 2U) {
+                rx = bmi088.acc_reg[(bmi088.addr + index - 2U) & 0x7FU];
+            }
+        } else {
+            bmi088_accel_write((uint8_t) (bmi088.addr + index - 1U), tx);
+        }
+    } else {
+        uint8_t reg = (uint8_t) ((bmi088.addr + index - 1U) & 0x3FU);
+        if (bmi088.read) {
+            rx = bmi088.gyro_reg[reg];
+        } else {
+            bmi088_gyro_write(reg, tx);
+        }
+    }
+    return rx;
+}
+
+/* ---------------- IST8310 ---------------- */
+
+static void ist8310_default(void) {
+    static const uint8_t diag[3] = {IST8310_REG_XX_CROSS_L, IST8310_REG_YY_CROSS_L, IST8310_REG_ZZ_CROSS_L};
+
+    memset(ist8310.reg, 0, sizeof(ist8310.reg));
+    ist8310.reg[IST8310_REG_WIA] = SIM_IST8310_WHO_AM_I;
+    //出厂交叉轴矩阵为对角阵
+    for (int32_t i = 0; i < 3; i++) {
+        ist8310.reg[diag[i]] = (uint8_t) SIM_IST8310_DIAG;
+        ist8310.reg[diag[i] + 1] = (uint8_t) (SIM_IST8310_DIAG >> 8);
+    }
+}
+
+//地磁场随云台的世界yaw转动, 0.3uT/LSB
+static void ist8310_drdy_fn(void *arg) {
+    (void) arg;
+    float yaw = robot.motor[4].angle;
+    float field[3] = {30.0f * cosf(yaw), -30.0f * sinf(yaw), -40.0f};
+
+    if (ist8310.reg[IST8310_REG_CNTRL1] == 0x0BU) {
+        for (int32_t i = 0; i < 3; i++) {
+            reg_put16(&ist8310.reg[IST8310_REG_DATAX + 2 * i], (field[i] + robot_noise(0.3f)) / 0.3f);
+        }
+        ist8310.reg[IST8310_REG_STAT1] |= 0x01U;
+        ist8310.samples++;
+        if (ist8310.reg[IST8310_REG_CNTRL2] & 0x08U) {
+            sim_periph_exti_raise(DRDY_IST8310_Pin);
+        }
+    }
+    sim_event_at(&ist8310.drdy, ist8310.drdy.time + SIM_IST8310_PERIOD);
+}
+
+void sim_ist8310_read(uint8_t reg, uint8_t *p_data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        p_data[i] = ist8310.reg[(uint8_t) (reg + i)];
+    }
+    if (reg <= IST8310_REG_DATAZ + 1U && reg + len > IST8310_REG_DATAX) {
+        ist8310.reg[IST8310_REG_STAT1] &= (uint8_t) ~0x01U;
+    }
+}
+
+void sim_ist8310_write(uint8_t reg, const uint8_t *p_data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        uint8_t addr = (uint8_t) (reg + i);
+        if (addr != IST8310_REG_WIA) {
+            ist8310.reg[addr] = p_data[i];
+        }
+    }
+}
+
+/* ---------------- 串口数据源 ---------------- */
+
+//DBUS帧: 4个11位摇杆通道, 两个拨杆, 鼠标键盘, 拨轮; 拨杆都在中间, 摇杆缓慢摆动
+static void rc_fn(void *arg) {
+    (void) arg;
+    double t = SIM_TO_US(sim_now) / 1e6;
+    uint16_t ch[5] = {RC_CH_VALUE_OFFSET, (uint16_t) (RC_CH_VALUE_OFFSET + 200.0 * sin(2.0 * M_PI * t / 5.0)),
+                      (uint16_t) (RC_CH_VALUE_OFFSET + 300.0 * sin(2.0 * M_PI * t / 4.0)),
+                      (uint16_t) (RC_CH_VALUE_OFFSET + 150.0 * sin(2.0 * M_PI * t / 3.0)), RC_CH_VALUE_OFFSET};
+    uint8_t buf[RC_FRAME_LENGTH] = {0};
+
+    buf[0] = (uint8_t) ch[0];
+    buf[1] = (uint8_t) ((ch[0] >> 8) | (ch[1] << 3));
+    buf[2] = (uint8_t) ((ch[1] >> 5) | (ch[2] << 6));
+    buf[3] = (uint8_t) (ch[2] >> 2);
+    buf[4] = (uint8_t) ((ch[2] >> 10) | (ch[3] << 1));
+    buf[5] = (uint8_t) ((ch[3] >> 7) | (RC_SW_MID << 4) | (RC_SW_MID << 6));
+    buf[16] = (uint8_t) ch[4];
+    buf[17] = (uint8_t) (ch[4] >> 8);
+    sim_uart_receive(USART3, buf, sizeof(buf));
+    robot.rc_frames++;
+    sim_event_at(&robot.rc, robot.rc.time + SIM_RC_PERIOD);
+}
+
+//视觉帧: 目标在小幅摆动, 拍摄到发送的延迟8ms
+static void vision_fn(void *arg) {
+    (void) arg;
+    double t = SIM_TO_US(sim_now) / 1e6;
+    vision_sync_struct frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.header.sof = VISION_HEADER_SOF;
+    frame.header.data_len = sizeof(vision_frame_data);
+    frame.data.data1 = (float) (0.05 * sin(2.0 * M_PI * t / 2.0));
+    frame.data.data2 = (float) (0.02 * sin(2.0 * M_PI * t / 3.0));
+    frame.data.data3 = robot.vision_seq++;
+    frame.data.data4 = 8000U;
+    frame.data.data5 = 3.0f;
+    append_CRC16_check_sum((uint8_t *) &frame, sizeof(frame));
+    sim_uart_receive(USART1, (const uint8_t *) &frame, sizeof(frame));
+    robot.vision_frames++;
+    sim_event_at(&robot.vision, robot.vision.time + SIM_VISION_PERIOD);
+}
+
+static void referee_send(uint16_t cmd_id, const void *p_data, uint16_t len) {
+    uint8_t buf[REF_PROTOCOL_FRAME_MAX_SIZE];
+    uint16_t frame_len = REF_HEADER_CRC_CMDID_LEN + len;
+
+    buf[0] = HEADER_SOF;
+    buf[1] = (uint8_t) len;
+    buf[2] = (uint8_t) (len >> 8);
+    buf[3] = robot.referee_seq++;
+    append_CRC8_check_sum(buf, REF_PROTOCOL_HEADER_SIZE);
+    buf[5] = (uint8_t) cmd_id;
+    buf[6] = (uint8_t) (cmd_id >> 8);
+    memcpy(&buf[REF_HEADER_CMDID_LEN], p_data, len);
+    append_CRC16_check_sum(buf, frame_len);
+    sim_uart_receive(USART6, buf, frame_len);
+    robot.referee_frames++;
+}
+
+static void referee_status_fn(void *arg) {
+    (void) arg;
+    ext_game_robot_status_t status;
+
+    memset(&status, 0, sizeof(status));
+    status.robot_id = infantry3_red;
+    status.robot_level = 1;
+    status.remain_HP = 200;
+    status.max_HP = 200;
+    status.shooter_id1_17mm_cooling_rate = 40;
+    status.shooter_id1_17mm_cooling_limit = 240;
+    status.shooter_id1_17mm_speed_limit = 30;
+    status.chassis_power_limit = 60;
+    status.mains_power_gimbal_output = 1;
+    status.mains_power_chassis_output = 1;
+    status.mains_power_shooter_output = 1;
+    referee_send(0x0201, &status, sizeof(status));
+    sim_event_at(&robot.referee_status, robot.referee_status.time + SIM_REFEREE_STATUS);
+}
+
+static void referee_power_fn(void *arg) {
+    (void) arg;
+    ext_power_heat_data_t power;
+
+    memset(&power, 0, sizeof(power));
+    power.chassis_volt = 24000;
+    power.chassis_current = (uint16_t) (robot.chassis_power / 24.0f * 1000.0f);
+    power.chassis_power = robot.chassis_power;
+    power.chassis_power_buffer = (uint16_t) robot.power_buffer;
+    referee_send(0x0202, &power, sizeof(power));
+    sim_event_at(&robot.referee_power, robot.referee_power.time + SIM_REFEREE_POWER);
+}
+
+static void referee_sink(const uint8_t *p_data, uint16_t len) {
+    robot.referee_tx_bytes += len;
+    if (robot.referee_fp != NULL) {
+        fwrite(p_data, 1, len, robot.referee_fp);
+    }
+}
+
+/* ---------------- ADC ---------------- */
+
+//VREFINT 1.21V, 内部温度传感器0.76V@25度 2.5mV/度, 电池24V经10.09分压, 3.3V参考
+uint32_t sim_adc_value(ADC_TypeDef *adc, uint32_t channel) {
+    float volt = 0.0f;
+
+    if (adc == ADC1 && channel == ADC_CHANNEL_VREFINT) {
+        volt = 1.21f;
+    } else if (adc == ADC1 && channel == ADC_CHANNEL_TEMPSENSOR) {
+        volt = 0.76f + (robot.imu_temp - 25.0f) * 0.0025f;
+    } else if (adc == ADC3 && channel == ADC_CHANNEL_8) {
+        volt = 24.0f / 10.09f;
+    }
+    return (uint32_t) lrintf(volt / 3.3f * 4096.0f + robot_noise(2.0f)) & 0x0FFFU;
+}
+
+/* ---------------- 初始化和报告 ---------------- */
+
+void sim_robot_init(void) {
+    memset(&robot, 0, sizeof(robot));
+    memset(&bmi088, 0, sizeof(bmi088));
+    memset(&ist8310, 0, sizeof(ist8310));
+    robot.rand_state = 1U;
+    robot.imu_temp = SIM_AMBIENT_TEMP;
+    robot.power_buffer = 60.0f;
+
+    memcpy(robot.motor, motor_init, sizeof(robot.motor));
+    memcpy(fric, fric_init, sizeof(fric));
+    robot.motor[4].angle = (float) 4096 * 2.0f * SIM_PI / 8192.0f;
+    robot.motor[5].angle = (float) SIM_PITCH_OFFSET_ECD * 2.0f * SIM_PI / 8192.0f;
+    //各电机的反馈相位错开
+    robot_motor_each(p_motor, {
+        sim_event_init(&p_motor->feedback, motor_feedback_fn, p_motor);
+        sim_event_at(&p_motor->feedback, SIM_MS(1) + SIM_US(97) * (sim_time_t) motor_i);
+    })
+    sim_can_set_listener(CAN1, robot_can1_listener);
+    sim_can_set_listener(CAN2, robot_can2_listener);
+
+    sim_event_init(&robot.step, robot_step_fn, NULL);
+    sim_event_init(&robot.cap_feedback, cap_feedback_fn, NULL);
+    sim_event_init(&robot.rc, rc_fn, NULL);
+    sim_event_init(&robot.vision, vision_fn, NULL);
+    sim_event_init(&robot.referee_status, referee_status_fn, NULL);
+    sim_event_init(&robot.referee_power, referee_power_fn, NULL);
+    sim_event_at(&robot.step, SIM_ROBOT_STEP);
+    sim_event_at(&robot.cap_feedback, SIM_MS(3));
+    sim_event_at(&robot.rc, SIM_MS(7));
+    sim_event_at(&robot.vision, SIM_MS(5));
+    sim_event_at(&robot.referee_status, SIM_MS(11));
+    sim_event_at(&robot.referee_power, SIM_MS(13));
+
+    bmi088_accel_default();
+    bmi088_gyro_default();
+    sim_event_init(&bmi088.accel_drdy, bmi088_accel_drdy_fn, NULL);
+    sim_event_init(&bmi088.gyro_drdy, bmi088_gyro_drdy_fn, NULL);
+    sim_event_at(&bmi088.accel_drdy, SIM_US(311));
+    sim_event_at(&bmi088.gyro_drdy, SIM_US(173));
+    ist8310_default();
+    sim_event_init(&ist8310.drdy, ist8310_drdy_fn, NULL);
+    sim_event_at(&ist8310.drdy, SIM_US(1531));
+
+    sim_uart_set_sink(USART6, referee_sink);
+    if (sim_option.referee_path != NULL) {
+        robot.referee_fp = fopen(sim_option.referee_path, "wb");
+        if (robot.referee_fp == NULL) {
+            sim_fail("cannot open %s", sim_option.referee_path);
+        }
+    }
+}
+
+void sim_robot_report(FILE *fp) {
+    fprintf(fp, "\n%-9s %8s %10s %10s\n", "motor", "cmd", "rpm", "cmd_frames");
+    robot_motor_each(p_motor, {
+        fprintf(fp, "%-9s %8d %10.1f %10u\n", p_motor->name, p_motor->cmd, p_motor->rpm, p_motor->cmd_frames);
+    })
+    fprintf(fp, "gimbal: yaw %.3f rad, pitch %.3f rad; imu %.1f C; chassis %.1f W, buffer %.1f J\n",
+            robot.motor[4].angle, pitch_angle(), robot.imu_temp, robot.chassis_power, robot.power_buffer);
+    fprintf(fp, "sensors: accel %u, gyro %u, mag %u samples\n", bmi088.accel_samples, bmi088.gyro_samples,
+            ist8310.samples);
+    fprintf(fp, "sources: rc %u, vision %u, referee %u frames; referee tx %llu bytes; supercap %u cmds\n",
+            robot.rc_frames, robot.vision_frames, robot.referee_frames, (unsigned long long) robot.referee_tx_bytes,
+            robot.cap_cmd_frames);
+    if (robot.referee_fp != NULL) {
+        fflush(robot.referee_fp);
+    }
+}
@@ -0,0 +1,250 @@
+/**
+  * @file       sim_usb.c
+  * @brief      the USB OTG FS device controller with a host that enumerates
+  *             the board right after HAL_PCD_Start: bus reset, SET_ADDRESS,
+  *             SET_CONFIGURATION and SET_CONTROL_LINE_STATE, one per frame. IN
+  *             transfers complete after their time on the 12 Mbit/s bus and the
+  *             data of the CDC endpoint is written to the --usb file. All work
+  *             is done in HAL_PCD_IRQHandler through the callbacks of
+  *             usbd_conf.c, like the real interrupt.
+  *             USB OTG FS设备控制器和一个在HAL_PCD_Start后立即枚举的主机: 总线复位、
+  *             SET_ADDRESS、SET_CONFIGURATION和SET_CONTROL_LINE_STATE, 每帧一个. IN传输
+  *             在12Mbit/s总线上传完后完成, CDC端点的数据写入--usb文件. 与真实中断一样,
+  *             所有处理在HAL_PCD_IRQHandler中通过usbd_conf.c的回调完成
+  */
+#include "sim.h"
+#include "main.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_USB_EP_NUM          4
+#define SIM_USB_SETUP_NUM       4
+#define SIM_USB_FRAME           SIM_MS(1)
+
+typedef struct {
+    PCD_HandleTypeDef *hpcd;
+    sim_event_t enumerate;
+    uint8_t step;
+    uint8_t reset;
+    uint8_t setup[SIM_USB_SETUP_NUM][8];
+    uint8_t setup_num;
+    uint8_t in_done;                //按端点
+    sim_event_t in_event[SIM_USB_EP_NUM];
+    FILE *fp;
+    uint8_t configured;
+    uint64_t in_bytes;
+    uint32_t in_transfers;
+} sim_usb_t;
+
+static sim_usb_t usb;
+
+static void usb_setup_queue(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint16_t length) {
+    uint8_t *p_setup = usb.setup[usb.setup_num++];
+
+    p_setup[0] = type;
+    p_setup[1] = request;
+    p_setup[2] = (uint8_t) value;
+    p_setup[3] = (uint8_t) (value >> 8);
+    p_setup[4] = (uint8_t) index;
+    p_setup[5] = (uint8_t) (index >> 8);
+    p_setup[6] = (uint8_t) length;
+    p_setup[7] = (uint8_t) (length >> 8);
+}
+
+//主机每帧发一步枚举
+static void usb_enumerate_fn(void *arg) {
+    (void) arg;
+    switch (usb.step++) {
+        case 0:
+            usb.reset = 1;
+            break;
+        case 1:
+            usb_setup_queue(0x00, 0x05, 1, 0, 0);       //SET_ADDRESS 1
+            break;
+        case 2:
+            usb_setup_queue(0x00, 0x09, 1, 0, 0);       //SET_CONFIGURATION 1
+            break;
+        case 3:
+            usb_setup_queue(0x21, 0x22, 0x0003, 0, 0);  //SET_CONTROL_LINE_STATE DTR|RTS
+            usb.configured = 1;
+            break;
+        default:
+            return;
+    }
+    sim_irq_pend(OTG_FS_IRQn);
+    sim_event_at(&usb.enumerate, sim_now + SIM_USB_FRAME);
+}
+
+static void usb_in_fn(void *arg) {
+    uint8_t ep = (uint8_t) (uintptr_t) arg;
+    PCD_EPTypeDef *p_ep = &usb.hpcd->IN_ep[ep];
+
+    if (ep != 0U && p_ep->xfer_len > 0U) {
+        usb.in_bytes += p_ep->xfer_len;
+        usb.in_transfers++;
+        if (usb.fp != NULL) {
+            fwrite(p_ep->xfer_buff, 1, p_ep->xfer_len, usb.fp);
+        }
+    }
+    p_ep->xfer_count = p_ep->xfer_len;
+    usb.in_done |= (uint8_t) (1U << ep);
+    sim_irq_pend(OTG_FS_IRQn);
+}
+
+/* ---------------- HAL ---------------- */
+
+HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd) {
+    if (hpcd->State == HAL_PCD_STATE_RESET) {
+        hpcd->Lock = HAL_UNLOCKED;
+        HAL_PCD_MspInit(hpcd);
+    }
+    for (uint8_t i = 0; i < SIM_USB_EP_NUM; i++) {
+        hpcd->IN_ep[i].is_in = 1U;
+        hpcd->IN_ep[i].num = i;
+        hpcd->OUT_ep[i].is_in = 0U;
+        hpcd->OUT_ep[i].num = i;
+    }
+    usb.hpcd = hpcd;
+    hpcd->USB_Address = 0U;
+    hpcd->State = HAL_PCD_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_DeInit(PCD_HandleTypeDef *hpcd) {
+    hpcd->State = HAL_PCD_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd) {
+    (void) hpcd;
+    sim_sync();
+    usb.step = 0;
+    sim_event_at(&usb.enumerate, sim_now + SIM_USB_FRAME);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd) {
+    (void) hpcd;
+    sim_event_cancel(&usb.enumerate);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd, uint8_t address) {
+    hpcd->USB_Address = address;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint16_t ep_mps, uint8_t ep_type) {
+    PCD_EPTypeDef *p_ep = (ep_addr & 0x80U) ? &hpcd->IN_ep[ep_addr & 0x0FU] : &hpcd->OUT_ep[ep_addr & 0x0FU];
+
+    p_ep->maxpacket = ep_mps;
+    p_ep->type = ep_type;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    (void) hpcd;
+    (void) ep_addr;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    (void) hpcd;
+    (void) ep_addr;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    (void) hpcd;
+    (void) ep_addr;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    (void) hpcd;
+    (void) ep_addr;
+    return HAL_OK;
+}
+
+//12Mbit/s, 每个64字节包约加上20字节的协议开销
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len) {
+    uint8_t ep = ep_addr & 0x0FU;
+    uint32_t bytes = len + 20U * (len / 64U + 1U);
+
+    if (ep >= SIM_USB_EP_NUM) {
+        return HAL_ERROR;
+    }
+    sim_sync();
+    hpcd->IN_ep[ep].xfer_buff = pBuf;
+    hpcd->IN_ep[ep].xfer_len = len;
+    hpcd->IN_ep[ep].xfer_count = 0U;
+    sim_event_at(&usb.in_event[ep], sim_now + (sim_time_t) bytes * 8U * SIM_CPU_HZ / 12000000U);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len) {
+    PCD_EPTypeDef *p_ep = &hpcd->OUT_ep[ep_addr & 0x0FU];
+
+    p_ep->xfer_buff = pBuf;
+    p_ep->xfer_len = len;
+    p_ep->xfer_count = 0U;
+    return HAL_OK;
+}
+
+uint32_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    return hpcd->OUT_ep[ep_addr & 0x0FU].xfer_count;
+}
+
+HAL_StatusTypeDef HAL_PCDEx_SetTxFiFo(PCD_HandleTypeDef *hpcd, uint8_t fifo, uint16_t size) {
+    (void) hpcd;
+    (void) fifo;
+    (void) size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCDEx_SetRxFiFo(PCD_HandleTypeDef *hpcd, uint16_t size) {
+    (void) hpcd;
+    (void) size;
+    return HAL_OK;
+}
+
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd) {
+    if (usb.reset) {
+        usb.reset = 0;
+        HAL_PCD_ResetCallback(hpcd);
+    }
+    for (uint8_t i = 0; i < usb.setup_num; i++) {
+        memcpy(hpcd->Setup, usb.setup[i], 8);
+        HAL_PCD_SetupStageCallback(hpcd);
+    }
+    usb.setup_num = 0;
+    for (uint8_t ep = 0; ep < SIM_USB_EP_NUM; ep++) {
+        if (usb.in_done & (1U << ep)) {
+            usb.in_done &= (uint8_t) ~(1U << ep);
+            HAL_PCD_DataInStageCallback(hpcd, ep);
+        }
+    }
+}
+
+void sim_usb_init(void) {
+    memset(&usb, 0, sizeof(usb));
+    sim_event_init(&usb.enumerate, usb_enumerate_fn, NULL);
+    for (uintptr_t ep = 0; ep < SIM_USB_EP_NUM; ep++) {
+        sim_event_init(&usb.in_event[ep], usb_in_fn, (void *) ep);
+    }
+    if (sim_option.usb_path != NULL) {
+        usb.fp = fopen(sim_option.usb_path, "wb");
+        if (usb.fp == NULL) {
+            sim_fail("cannot open %s", sim_option.usb_path);
+        }
+    }
+}
+
+void sim_usb_report(FILE *fp) {
+    fprintf(fp, "\nusb: %s, %u IN transfers, %llu bytes\n",
+            (usb.hpcd == NULL) ? "not started by the firmware" : (usb.configured ? "configured" : "not configured"),
+            usb.in_transfers, (unsigned long long) usb.in_bytes);
+    if (usb.fp != NULL) {
+        fflush(usb.fp);
+    }
+}
@@ -0,0 +1,100 @@
+/**
+  * @file       test_ahrs_ukf.c
+  * @brief      the attitude UKF converges from level to a tilted static
+  *             attitude and follows a constant yaw rate, with measurements
+  *             generated by its own measurement model and no heap use per update.
+  *             姿态UKF从水平收敛到倾斜的静止姿态并跟随恒定偏航角速度, 测量值由其测量模型生成, 每次更新不申请堆内存
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "ahrs_ukf.h"
+#include "matrix.h"
+
+//INS_task.c中的全局量, 主机测试不编译INS_task.c
+float32_t INS_quat[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+float32_t INS_accel_cali[3];
+float32_t INS_mag_cali[3];
+
+static AHRS_t ahrs;
+
+//两个四元数表示的姿态之间的转角 rad, q与-q相同, 更新后的估计值未归一化
+static float32_t quat_angle(const float32_t *a, const float32_t *b) {
+    float32_t dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    float32_t norm = sqrtf((a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3]) *
+                           (b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]));
+    return 2.0f * acosf(fminf(fabsf(dot) / norm, 1.0f));
+}
+
+static void quat_from_axis(float32_t q[4], float32_t x, float32_t y, float32_t z, float32_t angle) {
+    float32_t s = sinf(angle / 2.0f);
+    q[0] = cosf(angle / 2.0f);
+    q[1] = x * s;
+    q[2] = y * s;
+    q[3] = z * s;
+}
+
+static void measure(matrix_f32_t *y, float32_t q[4]) {
+    matrix_f32_t truth;
+    Matrix_data_creat_f32(&truth, SS_X_LEN, 1, q, NoInitMatZero);
+    AHRS_bUpdateNonlinearY(y, &truth, &U, &ahrs);
+    Matrix_vSetMatrixInvalid_f32(&truth);
+}
+
+static void test_static_tilt(void) {
+    float32_t truth[4];
+    quat_from_axis(truth, 0.6f, 0.8f, 0.0f, 0.35f);
+
+    INS_quat[0] = 1.0f;
+    INS_quat[1] = INS_quat[2] = INS_quat[3] = 0.0f;
+    NEWAHRS_init(&ahrs);
+    Matrix_vSetToZero_f32(&U);
+    measure(&Y, truth);
+
+    uint32_t malloc_before = host_malloc_count;
+    bool ok = true;
+    for (int i = 0; i < 400 && ok; i++) {
+        ok = UKF_bUpdate(&UKF_IMU, &Y, &U, &ahrs);
+    }
+    TEST_ASSERT(ok);
+    TEST_ASSERT(host_malloc_count == malloc_before);
+    TEST_ASSERT(quat_angle(truth, UKF_IMU.X_Est.arm_matrix.pData) < 0.01f);
+}
+
+static void test_constant_yaw_rate(void) {
+    //真值用同一个状态方程积分, 角速度绕z轴1rad/s
+    float32_t truth[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+    matrix_f32_t x, x_next;
+    Matrix_data_creat_f32(&x, SS_X_LEN, 1, truth, NoInitMatZero);
+    Matrix_nodata_creat_f32(&x_next, SS_X_LEN, 1, InitMatWithZero);
+
+    INS_quat[0] = 1.0f;
+    INS_quat[1] = INS_quat[2] = INS_quat[3] = 0.0f;
+    NEWAHRS_init(&ahrs);
+    Matrix_vSetToZero_f32(&U);
+    U.p2Data[2][0] = 1.0f;
+
+    bool ok = true;
+    float32_t worst = 0.0f;
+    for (int i = 0; i < 1000 && ok; i++) {
+        AHRS_bUpdateNonlinearX(&x_next, &x, &U, &ahrs);
+        Matrix_vCopy_f32(&x_next, &x);
+        measure(&Y, x.arm_matrix.pData);
+        ok = UKF_bUpdate(&UKF_IMU, &Y, &U, &ahrs);
+        if (i > 100) {
+            worst = fmaxf(worst, quat_angle(x.arm_matrix.pData, UKF_IMU.X_Est.arm_matrix.pData));
+        }
+    }
+    TEST_ASSERT(ok);
+    TEST_ASSERT(worst < 0.01f);
+    //5s转过5rad, 偏航角变化确实发生
+    TEST_ASSERT(fabsf(x.p2Data[0][0] - 1.0f) > 0.1f);
+
+    Matrix_vSetMatrixInvalid_f32(&x);
+    Matrix_vSetMatrixInvalid_f32(&x_next);
+}
+
+int main(void) {
+    RUN_TEST(test_static_tilt);
+    RUN_TEST(test_constant_yaw_rate);
+    return unit_test_result();
+}
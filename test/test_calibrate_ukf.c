@@ -0,0 +1,79 @@
+/**
+  * @file       test_calibrate_ukf.c
+  * @brief      TRICAL magnetometer calibration recovers a known hard iron
+  *             bias and soft iron scale from readings over many attitudes,
+  *             and the quaternion helpers rotate vectors correctly.
+  *             TRICAL磁力计校准从多个姿态的读数中恢复已知的硬铁偏置和软铁比例, 以及四元数辅助函数的向量旋转
+  */
+#include "unit_test.h"
+#include "calibrate_ukf.h"
+
+//ahrs_ukf.c引用的INS_task.c全局量
+float32_t INS_quat[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+float32_t INS_accel_cali[3];
+float32_t INS_mag_cali[3];
+
+static uint32_t lcg_state = 4242U;
+
+static float uniform(void) {
+    lcg_state = lcg_state * 1664525U + 1013904223U;
+    return (float) (lcg_state >> 8) / 16777216.0f;
+}
+
+static void test_quaternion_helpers(void) {
+    //绕z轴转90度, x轴转到y轴
+    const float q[4] = {cosf(PI / 4.0f), 0.0f, 0.0f, sinf(PI / 4.0f)};
+    const float v[3] = {1.0f, 0.0f, 0.0f};
+    float r[3] = {9.0f, 9.0f, 9.0f};
+    quaternion_vector3_multiply_f(r, q, v);
+    TEST_ASSERT_NEAR(0.0f, r[0], 1e-6f);
+    TEST_ASSERT_NEAR(1.0f, r[1], 1e-6f);
+    TEST_ASSERT_NEAR(0.0f, r[2], 1e-6f);
+
+    const float identity[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+    TEST_ASSERT_NEAR(0.0f, quaternion_quaternion_angle_f(identity, identity), 1e-3f);
+}
+
+static void test_bias_and_scale(void) {
+    //真实的偏置和比例误差, 读数 = (I+D)^-1 * 场 + b
+    const float bias[3] = {0.12f, -0.08f, 0.05f};
+    const float gain[3] = {1.0f / 1.05f, 1.0f / 0.96f, 1.0f / 1.02f};
+    TRICAL_instance_t cal;
+    TRICAL_init(&cal);
+    TRICAL_norm_set(&cal, 1.0f);
+    TRICAL_noise_set(&cal, 1e-3f);
+
+    for (int i = 0; i < 4000; i++) {
+        //均匀分布在球面上的场方向
+        float z = 2.0f * uniform() - 1.0f;
+        float a = 2.0f * PI * uniform();
+        float field[3] = {sqrtf(1.0f - z * z) * cosf(a), sqrtf(1.0f - z * z) * sinf(a), z};
+        float reading[3];
+        for (int k = 0; k < 3; k++) {
+            reading[k] = gain[k] * field[k] + bias[k];
+        }
+        TRICAL_estimate_update(&cal, reading, field);
+    }
+    TEST_ASSERT(TRICAL_measurement_count_get(&cal) == 4000U);
+
+    float est_bias[3], est_scale[9];
+    TRICAL_estimate_get(&cal, est_bias, est_scale);
+    for (int k = 0; k < 3; k++) {
+        TEST_ASSERT_NEAR(bias[k], est_bias[k], 0.01f);
+        TEST_ASSERT_NEAR(1.0f / gain[k] - 1.0f, est_scale[4 * k], 0.01f);
+    }
+
+    //校准后的读数回到单位球上
+    float reading[3] = {gain[0] * 0.6f + bias[0], gain[1] * 0.8f + bias[1], bias[2]};
+    float calibrated[3];
+    TRICAL_measurement_calibrate(&cal, reading, calibrated);
+    TEST_ASSERT_NEAR(0.6f, calibrated[0], 0.01f);
+    TEST_ASSERT_NEAR(0.8f, calibrated[1], 0.01f);
+    TEST_ASSERT_NEAR(0.0f, calibrated[2], 0.01f);
+}
+
+int main(void) {
+    RUN_TEST(test_quaternion_helpers);
+    RUN_TEST(test_bias_and_scale);
+    return unit_test_result();
+}
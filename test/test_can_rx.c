@@ -0,0 +1,311 @@
+/**
+  * @file       test_can_rx.c
+  * @brief      replays a CAN trace through the rx interrupt, the fifo and the
+  *             deferred decoder, with the decoder running late in random
+  *             batches, and compares every motor with the inline decoder it
+  *             replaced. Also the sample age, fifo overflow, and a reader thread
+  *             that must never see a torn snapshot.
+  *             CAN记录回放: 经接收中断、队列和延后解码(解码随机成批滞后), 每个电机与被替换的中断内解码比较.
+  *             另外测试数据年龄、队列溢出, 以及读取线程不会读到撕裂的快照
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+//直接包含源文件, 测试中代替can_rx_task取出静态队列中的帧
+#include "../User/Application/CAN_receive.c"
+#include <pthread.h>
+#include <string.h>
+
+#define CYCLES_PER_US   168U
+
+CAN_HandleTypeDef hcan1 = {.Instance = CAN1};
+CAN_HandleTypeDef hcan2 = {.Instance = CAN2};
+uint32_t id_test;
+static uint32_t now_tick;
+static uint32_t hook_cnt[ERROR_LIST_LENGHT + 1];
+static uint32_t notify_cnt;
+static uint32_t error_cnt;
+
+//当前接收邮箱中的帧
+static CAN_RxHeaderTypeDef rx_header;
+static uint8_t rx_data[8];
+
+uint32_t DWT_get_tick(void) {
+    return now_tick;
+}
+
+uint32_t DWT_tick_to_us(uint32_t tick) {
+    return tick / CYCLES_PER_US;
+}
+
+void detect_hook(uint8_t toe) {
+    hook_cnt[toe]++;
+}
+
+void profile_begin(profile_id_e id) {
+    (void) id;
+}
+
+void profile_end(profile_id_e id) {
+    (void) id;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader,
+                                       uint8_t aData[]) {
+    (void) hcan;
+    (void) RxFifo;
+    *pHeader = rx_header;
+    memcpy(aData, rx_data, 8);
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+    return 3;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[],
+                                       uint32_t *pTxMailbox) {
+    (void) hcan;
+    (void) pHeader;
+    (void) aData;
+    *pTxMailbox = CAN_TX_MAILBOX0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes) {
+    (void) hcan;
+    (void) TxMailboxes;
+    return HAL_OK;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) {
+    return 42000000U;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return 168000000U;
+}
+
+void Error_Handler(void) {
+    error_cnt++;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return NULL;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    (void) xTaskToNotify;
+    (void) pxHigherPriorityTaskWoken;
+    notify_cnt++;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    (void) xClearCountOnExit;
+    (void) xTicksToWait;
+    return 0;
+}
+
+//被替换的中断内解码, 作为参考
+#define REF_MEASURE(ptr, data)                                                              \
+    {                                                                                       \
+        (ptr)->last_ecd = (ptr)->ecd;                                                       \
+        (ptr)->ecd = (uint16_t) ((data)[0] << 8 | (data)[1]);                               \
+        (ptr)->speed_rpm = (uint16_t) ((data)[2] << 8 | (data)[3]);                         \
+        (ptr)->given_current = (uint16_t) ((data)[4] << 8 | (data)[5]);                     \
+        (ptr)->temperate = (data)[6];                                                       \
+        if (((ptr)->ecd - (ptr)->last_ecd < -6500) && ((ptr)->init_flag == 1)) {            \
+            (ptr)->turnCount++;                                                             \
+        }                                                                                   \
+        if (((ptr)->last_ecd - (ptr)->ecd < -6500) && ((ptr)->init_flag == 1)) {            \
+            (ptr)->turnCount--;                                                             \
+        }                                                                                   \
+        (ptr)->total_ecd = (ptr)->ecd + (8192 * (ptr)->turnCount);                          \
+        if ((ptr)->init_flag == 0) {                                                        \
+            (ptr)->init_flag = 1;                                                           \
+        }                                                                                   \
+    }
+
+static motor_measure_t ref_motor[CAN_MOTOR_NUM];
+static uint32_t ref_tick[CAN_MOTOR_NUM];
+
+static void ref_decode(uint8_t bus, uint16_t std_id, const uint8_t *p_data, uint32_t tick) {
+    int motor = -1;
+    if (bus == CAN_RX_BUS_1 && std_id >= CAN_3508_M1_ID && std_id <= CAN_YAW_MOTOR_ID) {
+        motor = CAN_MOTOR_CHASSIS_1 + std_id - CAN_3508_M1_ID;
+    } else if (bus == CAN_RX_BUS_2) {
+        switch (std_id) {
+            case CAN_PITCH_MOTOR_ID:
+                motor = CAN_MOTOR_PITCH;
+                break;
+            case CAN_TRIGGER_MOTOR_ID:
+                motor = CAN_MOTOR_TRIGGER;
+                break;
+            case CAN_3508_M1_ID:
+                motor = CAN_MOTOR_FRIC_1;
+                break;
+            case CAN_3508_M4_ID:
+                motor = CAN_MOTOR_FRIC_2;
+                break;
+            default:
+                break;
+        }
+    }
+    if (motor >= 0) {
+        REF_MEASURE(&ref_motor[motor], p_data);
+        ref_tick[motor] = tick;
+    }
+}
+
+static bool measure_equal(const motor_measure_t *p_a, const motor_measure_t *p_b) {
+    return p_a->ecd == p_b->ecd && p_a->speed_rpm == p_b->speed_rpm && p_a->given_current == p_b->given_current &&
+           p_a->temperate == p_b->temperate && p_a->turnCount == p_b->turnCount &&
+           p_a->total_ecd == p_b->total_ecd && p_a->init_flag == p_b->init_flag;
+}
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+//模拟接收中断
+static void rx_irq(uint8_t bus, uint16_t std_id, const uint8_t *p_data) {
+    rx_header.StdId = std_id;
+    rx_header.DLC = 8;
+    memcpy(rx_data, p_data, 8);
+    HAL_CAN_RxFifo0MsgPendingCallback(bus == CAN_RX_BUS_1 ? &hcan1 : &hcan2);
+}
+
+//can_rx_task的一轮: 取空队列并解码
+static void rx_task_drain(void) {
+    can_rx_frame_t frame;
+    while (spsc_fifo_gets(&can_rx_fifo, (uint8_t *) &frame, sizeof(frame)) == sizeof(frame)) {
+        can_rx_decode(&frame);
+    }
+}
+
+static void test_trace_replay(void) {
+    FILE *p_file = fopen(CAN_RX_TRACE, "r");
+    TEST_ASSERT(p_file != NULL);
+    if (p_file == NULL) {
+        return;
+    }
+    char line[128];
+    uint32_t frames = 0, batches = 0, pending = 0, max_pending = 0;
+    while (fgets(line, sizeof(line), p_file) != NULL) {
+        unsigned tick, std_id, bus, byte[8];
+        if (line[0] == '#' || sscanf(line, "%u %x %u %x %x %x %x %x %x %x %x", &tick, &std_id, &bus, &byte[0],
+                                     &byte[1], &byte[2], &byte[3], &byte[4], &byte[5], &byte[6], &byte[7]) != 11) {
+            continue;
+        }
+        uint8_t data[8];
+        for (int i = 0; i < 8; i++) {
+            data[i] = (uint8_t) byte[i];
+        }
+        now_tick = tick;
+        rx_irq((uint8_t) bus, (uint16_t) std_id, data);
+        ref_decode((uint8_t) bus, (uint16_t) std_id, data, tick);
+        frames++;
+        pending++;
+        //解码任务被推迟, 随机成批解码
+        if (pending >= 20 || rnd(4) == 0) {
+            max_pending = pending > max_pending ? pending : max_pending;
+            rx_task_drain();
+            pending = 0;
+            batches++;
+        }
+    }
+    fclose(p_file);
+    rx_task_drain();
+    TEST_ASSERT(frames > 1000 && can_rx_drop_cnt == 0);
+
+    for (int m = 0; m < CAN_MOTOR_NUM; m++) {
+        motor_snapshot_t snapshot;
+        TEST_ASSERT(can_motor_snapshot((can_motor_e) m, &snapshot));
+        TEST_ASSERT(measure_equal(&snapshot.measure, &ref_motor[m]));
+        //接收时刻来自中断, 与解码时刻无关
+        TEST_ASSERT(snapshot.rx_tick == ref_tick[m]);
+    }
+    TEST_ASSERT(measure_equal(get_yaw_gimbal_motor_measure_point(), &ref_motor[CAN_MOTOR_YAW]));
+    TEST_ASSERT(measure_equal(get_pitch_gimbal_motor_measure_point(), &ref_motor[CAN_MOTOR_PITCH]));
+    TEST_ASSERT(measure_equal(get_trigger_motor_measure_point(), &ref_motor[CAN_MOTOR_TRIGGER]));
+    TEST_ASSERT(measure_equal(get_chassis_motor_measure_point(2), &ref_motor[CAN_MOTOR_CHASSIS_3]));
+    //yaw在记录中持续正转, 圈数累计正确
+    TEST_ASSERT(ref_motor[CAN_MOTOR_YAW].turnCount > 10);
+    TEST_ASSERT(hook_cnt[YAW_GIMBAL_MOTOR_TOE] > 0 && hook_cnt[SUPER_CAPACITANCE_TOE] > 0);
+    printf("%u frames in %u decode batches (max %u queued), yaw %d turns\n", frames, batches, max_pending,
+           ref_motor[CAN_MOTOR_YAW].turnCount);
+}
+
+static void test_age_and_overflow(void) {
+    motor_snapshot_t snapshot;
+    can_motor_snapshot(CAN_MOTOR_YAW, &snapshot);
+    //跨过DWT回绕
+    now_tick = snapshot.rx_tick + 250U * CYCLES_PER_US;
+    TEST_ASSERT(can_motor_snapshot_age_us(&snapshot) == 250U);
+
+    //队列满时丢弃整帧并计数, 之后仍能恢复
+    uint8_t data[8] = {0x10, 0x00};
+    for (int i = 0; i < CAN_RX_FIFO_FRAME_NUM + 6; i++) {
+        rx_irq(CAN_RX_BUS_1, CAN_3508_M2_ID, data);
+    }
+    TEST_ASSERT(can_rx_drop_cnt == 6);
+    TEST_ASSERT(spsc_fifo_used(&can_rx_fifo) == CAN_RX_FIFO_FRAME_NUM * sizeof(can_rx_frame_t));
+    rx_task_drain();
+    TEST_ASSERT(spsc_fifo_used(&can_rx_fifo) == 0);
+    can_motor_snapshot(CAN_MOTOR_CHASSIS_2, &snapshot);
+    TEST_ASSERT(snapshot.measure.ecd == 0x1000 && snapshot.rx_tick == now_tick);
+}
+
+//读取线程: 快照内的ecd、圈数和total_ecd必须属于同一帧
+static volatile bool reader_stop;
+static uint32_t torn_cnt, read_cnt;
+
+static void *snapshot_reader(void *arg) {
+    (void) arg;
+    while (!__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE)) {
+        motor_snapshot_t snapshot;
+        if (can_motor_snapshot(CAN_MOTOR_YAW, &snapshot)) {
+            const motor_measure_t *p = &snapshot.measure;
+            torn_cnt += p->total_ecd != p->ecd + 8192 * p->turnCount || p->speed_rpm != (int16_t) p->ecd ||
+                        snapshot.rx_tick != (uint32_t) p->ecd * 3U;
+            read_cnt++;
+        }
+    }
+    return NULL;
+}
+
+static void test_snapshot_consistency(void) {
+    pthread_t thread;
+    can_rx_frame_t frame = {.bus = CAN_RX_BUS_1, .std_id = CAN_YAW_MOTOR_ID, .dlc = 8};
+    //先发布一帧满足检查条件的数据, 替换回放留下的快照
+    can_rx_decode(&frame);
+    reader_stop = false;
+    pthread_create(&thread, NULL, snapshot_reader, NULL);
+    for (uint32_t i = 0; i < 2000000U; i++) {
+        uint16_t ecd = (uint16_t) ((i * 700U) % 8192U);
+        frame.data[0] = (uint8_t) (ecd >> 8);
+        frame.data[1] = (uint8_t) ecd;
+        frame.data[2] = (uint8_t) (ecd >> 8);
+        frame.data[3] = (uint8_t) ecd;
+        frame.rx_tick = (uint32_t) ecd * 3U;
+        can_rx_decode(&frame);
+    }
+    __atomic_store_n(&reader_stop, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    TEST_ASSERT(torn_cnt == 0 && read_cnt > 0);
+    printf("%u snapshot reads during 2M publishes, %u torn\n", read_cnt, torn_cnt);
+}
+
+int main(void) {
+    can_rx_init();
+    //接收队列大小为2的幂, 初始化成功
+    TEST_ASSERT(error_cnt == 0U);
+    RUN_TEST(test_trace_replay);
+    RUN_TEST(test_age_and_overflow);
+    RUN_TEST(test_snapshot_consistency);
+    return unit_test_result();
+}
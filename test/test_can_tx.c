@@ -0,0 +1,417 @@
+/**
+  * @file       test_can_tx.c
+  * @brief      can_tx slot semantics (latest value wins, partial updates merge
+  *             into one frame, one ID never overtakes itself, rate limit, stall
+  *             abort), then a simulation of the three bxCAN mailboxes on a 1 Mbps
+  *             bus shared with motor feedback: bus utilisation, latency from
+  *             setpoint to wire and lost commands, against the direct
+  *             HAL_CAN_AddTxMessage calls it replaced.
+  *             can_tx槽语义(最新值覆盖, 部分更新合并为一帧, 同一ID不乱序, 频率限制, 超时取消),
+  *             以及bxCAN三个发送邮箱在与电机反馈共用的1Mbps总线上的仿真: 总线负载、设定值到总线的延迟和
+  *             丢失的命令, 与被替换的直接调用HAL_CAN_AddTxMessage比较
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "can_tx.h"
+#include <string.h>
+
+#define SIM_END_US      2000000U
+#define NODE_NUM        5
+//结束前停止发送命令, 留出时间让总线清空
+#define SIM_CMD_END_US  (SIM_END_US - 10000U)
+#define ID_NUM          0x800
+
+static can_tx_port_t port;
+static uint32_t now_us;
+
+static uint32_t get_tick(void) {
+    return now_us;
+}
+
+static uint32_t lcg_state = 3U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+//bxCAN发送邮箱
+typedef struct {
+    bool busy;
+    bool abort_req;
+    uint16_t std_id;
+    uint8_t dlc;
+    uint8_t data[8];
+    uint32_t cmd_us;            //直接发送时的命令时刻
+} sim_mailbox_t;
+
+static sim_mailbox_t mailbox[CAN_TX_MAILBOX_NUM];
+static uint32_t write_cnt, abort_req_cnt;
+
+static int sim_write(uint16_t std_id, const uint8_t *p_data, uint8_t dlc) {
+    for (int i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if (!mailbox[i].busy) {
+            mailbox[i].busy = true;
+            mailbox[i].abort_req = false;
+            mailbox[i].std_id = std_id;
+            mailbox[i].dlc = dlc;
+            memcpy(mailbox[i].data, p_data, dlc);
+            mailbox[i].cmd_us = now_us;
+            write_cnt++;
+            return i;
+        }
+    }
+    return -1;
+}
+
+//取消请求在下一个仿真步中生效, 和硬件一样由中断通知
+static void sim_abort(uint8_t i) {
+    mailbox[i].abort_req = true;
+    abort_req_cnt++;
+}
+
+static void sim_reset(void) {
+    memset(mailbox, 0, sizeof(mailbox));
+    write_cnt = abort_req_cnt = 0;
+    now_us = 1000U;
+    can_tx_init(&port, sim_write, sim_abort, get_tick, 1, 1000000U);
+}
+
+//把邮箱按ID仲裁后依次发出, 不模拟总线时间
+static uint8_t wire[64][8];
+static uint16_t wire_id[64];
+static uint32_t wire_num;
+
+static void sim_drain(void) {
+    while (1) {
+        int best = -1;
+        for (int i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+            if (mailbox[i].busy && (best < 0 || mailbox[i].std_id < mailbox[best].std_id)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            return;
+        }
+        memcpy(wire[wire_num % 64], mailbox[best].data, 8);
+        wire_id[wire_num % 64] = mailbox[best].std_id;
+        wire_num++;
+        mailbox[best].busy = false;
+        can_tx_complete_irq(&port, (uint8_t) best);
+    }
+}
+
+static void test_frame_bits(void) {
+    //8字节标准帧: 98位参与填充, 最多24个填充位, 加13位
+    TEST_ASSERT(can_tx_frame_bits(8) == 135U);
+    TEST_ASSERT(can_tx_frame_bits(0) == 34U + 8U + 13U);
+}
+
+static void test_latest_value_and_merge(void) {
+    sim_reset();
+    wire_num = 0;
+    uint8_t value[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+    //邮箱全忙时更新只留在槽中, 不丢帧
+    for (int i = 0; i < 3; i++) {
+        sim_write((uint16_t) (0x100 + i), value, 8);
+    }
+    for (uint8_t v = 1; v <= 5; v++) {
+        memset(value, v, 8);
+        TEST_ASSERT(can_tx_update(&port, 0x200, 8, 0, value, 8) == 0);
+        can_tx_flush(&port);
+    }
+    TEST_ASSERT(port.overwrite_cnt == 4 && port.mailbox_full_cnt == 5);
+
+    //两个任务分别更新0x1FF的前后半帧, 合并为一帧
+    uint8_t yaw[2] = {0x12, 0x34}, pitch[2] = {0x56, 0x78};
+    can_tx_update(&port, 0x1FF, 8, 0, yaw, 2);
+    can_tx_update(&port, 0x1FF, 8, 2, pitch, 2);
+    TEST_ASSERT(can_tx_update(&port, 0x1FF, 8, 7, yaw, 2) == -1);
+    TEST_ASSERT(can_tx_update(&port, 0x1FF, 9, 0, yaw, 2) == -1);
+    //外部占用的邮箱发完后由中断补充
+    for (int i = 0; i < 3; i++) {
+        mailbox[i].busy = false;
+    }
+    can_tx_flush(&port);
+    sim_drain();
+    TEST_ASSERT(wire_num == 2);
+    //ID小的先仲裁
+    TEST_ASSERT(wire_id[0] == 0x1FF && wire[0][0] == 0x12 && wire[0][1] == 0x34 && wire[0][2] == 0x56 &&
+                wire[0][3] == 0x78);
+    TEST_ASSERT(wire_id[1] == 0x200 && wire[1][0] == 5);
+    TEST_ASSERT(port.sent_cnt == 2);
+
+    //槽用尽
+    for (uint16_t id = 0x300; id < 0x300 + CAN_TX_SLOT_NUM; id++) {
+        can_tx_update(&port, id, 8, 0, value, 1);
+    }
+    TEST_ASSERT(port.slot_full_cnt == 2U);
+    TEST_ASSERT(host_primask == 0U);
+}
+
+static void test_no_overtake(void) {
+    sim_reset();
+    wire_num = 0;
+    uint8_t value[8] = {0};
+    //同一ID的新值在旧值仍在邮箱中时不占用第二个邮箱
+    value[0] = 1;
+    can_tx_update(&port, 0x200, 8, 0, value, 8);
+    can_tx_flush(&port);
+    value[0] = 2;
+    can_tx_update(&port, 0x200, 8, 0, value, 8);
+    can_tx_flush(&port);
+    TEST_ASSERT(write_cnt == 1);
+    sim_drain();
+    TEST_ASSERT(wire_num == 2 && wire[0][0] == 1 && wire[1][0] == 2);
+}
+
+static void test_rate_limit_and_stall(void) {
+    sim_reset();
+    wire_num = 0;
+    uint8_t value[8] = {0};
+    can_tx_slot_config(&port, 0x200, 8, 500U);
+    //500us内的更新合并到下一帧
+    for (uint32_t t = 0; t < 2000U; t += 100U) {
+        now_us += 100U;
+        value[0] = (uint8_t) t;
+        can_tx_update(&port, 0x200, 8, 0, value, 8);
+        can_tx_flush(&port);
+        sim_drain();
+    }
+    TEST_ASSERT(wire_num == 4);
+
+    //总线无应答, 邮箱超过CAN_TX_STALL_US且有新值时被取消, 之后发出最新值
+    sim_reset();
+    wire_num = 0;
+    value[0] = 0xAA;
+    can_tx_update(&port, 0x1FF, 8, 0, value, 8);
+    can_tx_flush(&port);
+    now_us += CAN_TX_STALL_US;
+    can_tx_flush(&port);
+    TEST_ASSERT(abort_req_cnt == 0);
+    //超时但邮箱中已是最新值, 不取消
+    now_us += 1000U;
+    can_tx_flush(&port);
+    TEST_ASSERT(abort_req_cnt == 0);
+    value[0] = 0xBB;
+    can_tx_update(&port, 0x1FF, 8, 0, value, 8);
+    can_tx_flush(&port);
+    TEST_ASSERT(abort_req_cnt == 1 && port.abort_cnt == 1);
+    //重复flush不重复取消
+    can_tx_flush(&port);
+    TEST_ASSERT(abort_req_cnt == 1);
+    //取消完成中断
+    mailbox[0].busy = false;
+    can_tx_fail_irq(&port, 0);
+    TEST_ASSERT(port.fail_cnt == 1);
+    sim_drain();
+    TEST_ASSERT(wire_num == 1 && wire[0][0] == 0xBB);
+}
+
+//带总线时间的仿真
+typedef struct {
+    const char *name;
+    bool direct;                //被替换的直接写邮箱方式
+    uint32_t period_us;         //控制周期
+    bool dual_gimbal_writer;    //两个任务各写一半0x1FF
+} sim_config_t;
+
+typedef struct {
+    uint32_t tx_frames;
+    uint32_t lost_cmd;          //最终值没有到达总线的命令
+    uint32_t direct_drop;
+    uint32_t reorder;           //同一ID旧值在新值之后发出
+    uint32_t latency_max;
+    double latency_sum;
+    uint32_t latency_num;
+    uint32_t busy_us;
+    uint16_t load_permille;
+} sim_result_t;
+
+//CAN1上的四个底盘电机和yaw电机反馈, 各1kHz
+static const uint16_t node_id[NODE_NUM] = {0x201, 0x202, 0x203, 0x204, 0x205};
+
+static sim_result_t run_bus(const sim_config_t *p_config) {
+    static uint32_t cmd_us[ID_NUM];
+    static uint16_t cmd_seq[ID_NUM], wire_seq[ID_NUM];
+    sim_result_t result;
+    memset(&result, 0, sizeof(result));
+    memset(cmd_us, 0, sizeof(cmd_us));
+    memset(cmd_seq, 0, sizeof(cmd_seq));
+    memset(wire_seq, 0, sizeof(wire_seq));
+    sim_reset();
+    now_us = 0;
+    can_tx_init(&port, sim_write, sim_abort, get_tick, 1, 1000000U);
+    can_tx_load_permille(&port);
+
+    uint32_t node_next[NODE_NUM];
+    bool node_pending[NODE_NUM] = {0};
+    for (int n = 0; n < NODE_NUM; n++) {
+        node_next[n] = rnd(1000);
+    }
+    uint32_t next_chassis = 100U, next_gimbal = 130U, next_cap = 500U;
+    uint32_t bus_free_us = 0;
+    int bus_owner = -1;         //0~2邮箱, 10+n其他节点
+
+    for (now_us = 0; now_us < SIM_END_US; now_us++) {
+        //取消请求: 不在总线上的邮箱立即清空, 由中断通知
+        for (int i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+            if (mailbox[i].busy && mailbox[i].abort_req && bus_owner != i) {
+                mailbox[i].busy = false;
+                can_tx_fail_irq(&port, (uint8_t) i);
+            }
+        }
+        for (int n = 0; n < NODE_NUM; n++) {
+            if (now_us >= node_next[n]) {
+                node_pending[n] = true;
+                node_next[n] += 1000U;
+            }
+        }
+
+        //控制任务的命令, 第0、1字节写入序号
+        uint16_t cmd_id[3];
+        int cmd_num = 0;
+        if (now_us >= SIM_CMD_END_US) {
+            next_chassis = next_gimbal = next_cap = UINT32_MAX;
+        }
+        if (now_us >= next_chassis) {
+            cmd_id[cmd_num++] = 0x200;
+            next_chassis += p_config->period_us + rnd(41) - 20U;
+        }
+        if (now_us >= next_gimbal) {
+            cmd_id[cmd_num++] = 0x1FF;
+            next_gimbal += p_config->period_us + rnd(41) - 20U;
+        }
+        if (now_us >= next_cap) {
+            cmd_id[cmd_num++] = 0x210;
+            next_cap += 100000U;
+        }
+        for (int k = 0; k < cmd_num; k++) {
+            uint16_t id = cmd_id[k];
+            uint8_t data[8] = {0};
+            cmd_seq[id]++;
+            cmd_us[id] = now_us;
+            data[0] = (uint8_t) (cmd_seq[id] >> 8);
+            data[1] = (uint8_t) cmd_seq[id];
+            if (p_config->direct) {
+                int writes = (id == 0x1FF && p_config->dual_gimbal_writer) ? 2 : 1;
+                for (int w = 0; w < writes; w++) {
+                    if (sim_write(id, data, 8) < 0) {
+                        result.direct_drop++;
+                    }
+                }
+            } else if (id == 0x1FF && p_config->dual_gimbal_writer) {
+                can_tx_update(&port, id, 8, 0, data, 2);
+                can_tx_flush(&port);
+                can_tx_update(&port, id, 8, 4, data, 2);
+                can_tx_flush(&port);
+            } else {
+                can_tx_update(&port, id, 8, 0, data, 8);
+                can_tx_flush(&port);
+            }
+        }
+
+        //总线: 一帧结束后按ID仲裁下一帧
+        if (bus_owner >= 0 && now_us >= bus_free_us) {
+            if (bus_owner < 10) {
+                sim_mailbox_t *p_mailbox = &mailbox[bus_owner];
+                uint16_t id = p_mailbox->std_id;
+                uint16_t seq = (uint16_t) (p_mailbox->data[0] << 8 | p_mailbox->data[1]);
+                //调度器中同一ID不乱序, 直接写邮箱时同ID的两帧按邮箱号仲裁可能乱序
+                if ((int16_t) (seq - wire_seq[id]) < 0) {
+                    result.reorder++;
+                }
+                wire_seq[id] = seq;
+                result.tx_frames++;
+                //电机命令的延迟, 0x210在过载总线上被所有反馈帧抢先, 不计入
+                if (seq == cmd_seq[id] && id != 0x210) {
+                    uint32_t latency = now_us - cmd_us[id];
+                    result.latency_sum += latency;
+                    result.latency_num++;
+                    result.latency_max = latency > result.latency_max ? latency : result.latency_max;
+                }
+                p_mailbox->busy = false;
+                if (!p_config->direct) {
+                    can_tx_complete_irq(&port, (uint8_t) bus_owner);
+                }
+            } else if (!p_config->direct) {
+                can_tx_rx_account(&port, 8);
+            }
+            bus_owner = -1;
+        }
+        if (bus_owner < 0) {
+            int best = -1;
+            uint16_t best_id = 0xFFFF;
+            for (int i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+                if (mailbox[i].busy && mailbox[i].std_id < best_id) {
+                    best = i;
+                    best_id = mailbox[i].std_id;
+                }
+            }
+            for (int n = 0; n < NODE_NUM; n++) {
+                if (node_pending[n] && node_id[n] < best_id) {
+                    best = 10 + n;
+                    best_id = node_id[n];
+                }
+            }
+            if (best >= 0) {
+                //标称111位加随机填充位
+                uint32_t len = 111U + rnd(25);
+                bus_owner = best;
+                bus_free_us = now_us + len;
+                result.busy_us += len;
+                if (best >= 10) {
+                    node_pending[best - 10] = false;
+                }
+            }
+        }
+    }
+    if (!p_config->direct) {
+        result.load_permille = can_tx_load_permille(&port);
+    }
+    //每个ID最后一次命令的值必须到达总线
+    const uint16_t ids[3] = {0x200, 0x1FF, 0x210};
+    for (int k = 0; k < 3; k++) {
+        result.lost_cmd += wire_seq[ids[k]] != cmd_seq[ids[k]];
+    }
+    return result;
+}
+
+static void test_bus_simulation(void) {
+    const sim_config_t config[] = {
+            {"direct 1kHz", true, 1000U, false},
+            {"can_tx 1kHz", false, 1000U, false},
+            {"direct 4kHz 2 writers", true, 250U, true},
+            {"can_tx 4kHz 2 writers", false, 250U, true},
+    };
+    sim_result_t result[4];
+    for (int i = 0; i < 4; i++) {
+        result[i] = run_bus(&config[i]);
+        printf("%-24s %6u frames, load %5.1f%% (estimate %4.1f%%), latency mean %6.1f max %5u us, "
+               "%u lost, %u dropped, %u reordered, %u overwritten\n", config[i].name, result[i].tx_frames,
+               result[i].busy_us * 100.0 / SIM_END_US, result[i].load_permille / 10.0,
+               result[i].latency_num ? result[i].latency_sum / result[i].latency_num : 0.0, result[i].latency_max,
+               result[i].lost_cmd, result[i].direct_drop, result[i].reorder, config[i].direct ? 0U : port.overwrite_cnt);
+    }
+    //调度器从不丢失最新值, 延迟有上界
+    TEST_ASSERT(result[1].lost_cmd == 0 && result[3].lost_cmd == 0);
+    TEST_ASSERT(result[1].reorder == 0 && result[3].reorder == 0);
+    TEST_ASSERT(result[1].latency_max < 1000U && result[3].latency_max < 1000U);
+    //总线过载时直接写邮箱会丢帧
+    TEST_ASSERT(result[2].direct_drop > 0);
+    //两个任务的半帧合并为一帧, 帧数少于直接写
+    TEST_ASSERT(result[3].tx_frames < result[2].tx_frames + result[2].direct_drop);
+    //按最坏填充位估计的负载不低于实际负载
+    double actual = result[1].busy_us * 1000.0 / SIM_END_US;
+    TEST_ASSERT(result[1].load_permille >= actual && result[1].load_permille < actual * 1.3);
+}
+
+int main(void) {
+    RUN_TEST(test_frame_bits);
+    RUN_TEST(test_latest_value_and_merge);
+    RUN_TEST(test_no_overtake);
+    RUN_TEST(test_rate_limit_and_stall);
+    RUN_TEST(test_bus_simulation);
+    return unit_test_result();
+}
@@ -0,0 +1,504 @@
+/**
+  * @file       test_cascade_tune.c
+  * @brief      cascade_tune on a simulated yaw: current to speed is a first
+  *             order lag with delay on a reversed motor, the angle integrates
+  *             the speed. The control loop of the simulation applies the staged
+  *             gains and closes the inner loop when the speed setpoint is
+  *             tuned, as gimbal_task does. Covered are a full run of both
+  *             stages with the speed gain checked against the true plant, the
+  *             rollback of a failing outer stage, the wrong feedback sign, an
+  *             unknown parameter, a pid with derivative first, a loop that
+  *             never applies the gains, a stop during verify, a failed save
+  *             and the model margins on textbook loops.
+  *             cascade_tune与模拟的yaw: 电流到速度为带延迟的一阶惯性且电机反向, 角度为速度的积分.
+  *             模拟的控制循环使用暂存的增益, 整定速度给定时闭合内环, 与gimbal_task相同.
+  *             覆盖两级完整整定并按真实对象检查速度环增益、外环失败回滚、反馈方向错误、参数不存在、
+  *             微分先行的pid、控制循环不使用新增益、验证中停止、保存失败以及典型开环的模型裕度
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cascade_tune.h"
+#include <string.h>
+
+#define DT              0.001f
+#define SUB_STEP        10          //每个采样周期内的积分步数
+#define DELAY           2           //反馈延迟的采样数
+#define MOTOR_K         (-0.002)    //稳态速度 / 电流, 电机反向
+#define MOTOR_T         0.02        //s
+#define OWNER_GIMBAL    0U
+#define RUN_MAX         200000U
+#define PI_D            3.14159265358979
+
+//模拟的yaw, 反馈为motor_speed和relative_angle
+typedef struct {
+    double speed, angle;
+    float32_t speed_history[DELAY + 1];
+    float32_t angle_history[DELAY + 1];
+    float32_t motor_speed;
+    float32_t relative_angle;
+    uint8_t apply;                  //控制循环使用暂存的增益
+} yaw_sim_t;
+
+static yaw_sim_t yaw;
+static param_registry_t reg;
+static pid_type_def spd_pid, rel_pid;
+static pid_auto_tune_control_e tune_type;
+static float32_t control_value;     //control_list.yaw_control_value
+static cascade_tune_t tune;
+
+static const float32_t spd_gain[3] = {1000.0f, 5.0f, 0.0f};
+static const float32_t rel_gain[3] = {8.0f, 0.0f, 0.0f};
+
+static cascade_stage_t stage[2];
+
+static void yaw_sim_step(double current) {
+    double h = DT / SUB_STEP;
+
+    //一阶惯性有解析解, 角度按速度的梯形积分
+    for (int s = 0; s < SUB_STEP; s++) {
+        double last = yaw.speed;
+        yaw.speed = MOTOR_K * current + (yaw.speed - MOTOR_K * current) * exp(-h / MOTOR_T);
+        yaw.angle -= 0.5 * h * (last + yaw.speed);
+    }
+    memmove(&yaw.speed_history[1], &yaw.speed_history[0], DELAY * sizeof(float32_t));
+    memmove(&yaw.angle_history[1], &yaw.angle_history[0], DELAY * sizeof(float32_t));
+    yaw.speed_history[0] = (float32_t) yaw.speed;
+    yaw.angle_history[0] = (float32_t) yaw.angle;
+    yaw.motor_speed = yaw.speed_history[DELAY];
+    yaw.relative_angle = yaw.angle_history[DELAY];
+}
+
+/**
+  * @brief          模拟gimbal_task的一个周期: 使用新增益, 按tune_type计算电流, 对象前进一个周期
+  */
+static void control_loop(void) {
+    double current;
+
+    if (yaw.apply) {
+        param_registry_apply(&reg, OWNER_GIMBAL);
+    }
+    if (tune_type == ANGLE_TO_SPEED) {
+        current = ALL_PID(&spd_pid, -yaw.motor_speed, control_value);
+    } else {
+        current = control_value;
+    }
+    yaw_sim_step(current);
+    host_tick++;
+}
+
+static void pid_setup(pid_type_def *pid, const float32_t gain[3], float32_t max_out, float32_t max_iout) {
+    pid_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.mode = PID_POSITION;
+    config.max_out = max_out;
+    config.max_iout = max_iout;
+    config.reset_time = PID_RESET_TIME;
+    TEST_ASSERT(PID_build(pid, gain, &config) == 0);
+}
+
+static void add_gain(const char *prefix, pid_type_def *pid) {
+    char name[PARAM_NAME_LEN];
+
+    snprintf(name, sizeof(name), "%s_kp", prefix);
+    TEST_ASSERT(param_registry_add(&reg, name, &pid->Kp, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 100000.0f) >= 0);
+    snprintf(name, sizeof(name), "%s_ki", prefix);
+    TEST_ASSERT(param_registry_add(&reg, name, &pid->Ki, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 100000.0f) >= 0);
+    snprintf(name, sizeof(name), "%s_kd", prefix);
+    TEST_ASSERT(param_registry_add(&reg, name, &pid->Kd, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 100000.0f) >= 0);
+}
+
+//与pid_auto_tune_task.c中yaw_cascade_stage相同的两级
+static void setup(void) {
+    memset(&yaw, 0, sizeof(yaw));
+    yaw.apply = 1;
+    memset(&reg, 0, sizeof(reg));
+    pid_setup(&spd_pid, spd_gain, 30000.0f, 10000.0f);
+    pid_setup(&rel_pid, rel_gain, 10.0f, 0.0f);
+    add_gain("yaw_spd", &spd_pid);
+    add_gain("yaw_rel", &rel_pid);
+    control_value = 0.0f;
+    tune_type = SPEED_TO_CURRENT;
+
+    memset(stage, 0, sizeof(stage));
+    stage[0].param[0] = "yaw_spd";
+    stage[0].param_num = 1;
+    stage[0].pid = &spd_pid;
+    stage[0].feedback = &yaw.motor_speed;
+    stage[0].feedback_sign = -1.0f;
+    stage[0].command = &control_value;
+    stage[0].inject = SPEED_TO_CURRENT;
+    stage[0].mode = SYS_ID_STEPPED_SINE;
+    stage[0].model = SYS_ID_FIRST_ORDER;
+    stage[0].amplitude = 3000.0f;
+    stage[0].f_start = 0.5f;
+    stage[0].f_end = 80.0f;
+    stage[0].point_num = 20;
+    stage[0].input_limit = 20.0f;
+    stage[0].pi_ratio = 4.0f;
+    stage[0].phase_margin = 50.0f;
+    stage[0].gain_margin = 8.0f;
+    stage[0].step = 3.0f;
+    stage[0].verify_time = 0.2f;
+
+    stage[1].param[0] = "yaw_rel";
+    stage[1].param_num = 1;
+    stage[1].pid = &rel_pid;
+    stage[1].feedback = &yaw.relative_angle;
+    stage[1].feedback_sign = 1.0f;
+    stage[1].command = &control_value;
+    stage[1].inject = ANGLE_TO_SPEED;
+    stage[1].mode = SYS_ID_STEPPED_SINE;
+    stage[1].model = SYS_ID_INTEGRATOR_FIRST_ORDER;
+    stage[1].amplitude = 1.5f;
+    stage[1].f_start = 1.0f;
+    stage[1].f_end = 60.0f;
+    stage[1].point_num = 16;
+    stage[1].input_limit = 1.5f;
+    stage[1].phase_margin = 60.0f;
+    stage[1].gain_margin = 10.0f;
+    stage[1].step = 0.3f;
+    stage[1].verify_time = 0.8f;
+}
+
+//速度级的快速辨识, 用于只关心失败路径的测试
+static void fast_speed_stage(void) {
+    stage[0].f_start = 5.0f;
+    stage[0].point_num = 10;
+}
+
+/**
+  * @brief          运行到等待保存、结束或进入stop_at状态, 返回最后的状态
+  */
+static cascade_tune_state_e run(cascade_tune_state_e stop_at) {
+    cascade_tune_state_e state = CASCADE_TUNE_IDLE;
+
+    for (uint32_t n = 0; n < RUN_MAX; n++) {
+        state = cascade_tune_update(&tune);
+        if (state == stop_at || state == CASCADE_TUNE_SAVE || state == CASCADE_TUNE_DONE ||
+            state == CASCADE_TUNE_FAILED) {
+            return state;
+        }
+        control_loop();
+    }
+    return state;
+}
+
+//控制循环再运行几个周期, 使暂存值生效
+static void settle_loop(void) {
+    for (int i = 0; i < 5; i++) {
+        control_loop();
+    }
+}
+
+static void report(const char *name, const cascade_stage_result_t *r) {
+    printf("%-8s err %2d  kp %9.3f ki %8.4f  wc %6.2f Hz  pm %5.1f gm %5.1f  meas pm %5.1f gm %5.1f  "
+           "overshoot %5.3f error %5.3f\n", name, r->error, r->kp, r->ki, r->crossover, r->phase_margin,
+           r->gain_margin, r->meas_phase_margin, r->meas_gain_margin, r->overshoot, r->final_error);
+}
+
+/**
+  * @brief          真实对象在w处的增益和相位, 零阶保持与延迟合计(DELAY - 0.5)个周期, 不含反向
+  */
+static void true_speed_plant(double w, double *gain, double *phase) {
+    *gain = fabs(MOTOR_K) / sqrt(1.0 + w * w * MOTOR_T * MOTOR_T);
+    *phase = -atan(w * MOTOR_T) - w * (DELAY - 0.5) * DT;
+}
+
+static void test_full_run(void) {
+    const cascade_stage_result_t *r0 = &tune.result[0], *r1 = &tune.result[1];
+    double w, g, ph, kp, pm;
+
+    setup();
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 2, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(run(CASCADE_TUNE_DONE) == CASCADE_TUNE_SAVE);
+    report("yaw_spd", r0);
+    report("yaw_rel", r1);
+    TEST_ASSERT(tune.accepted == 2 && tune.stage_done == 2 && tune.error == CASCADE_TUNE_OK);
+    TEST_ASSERT(r0->error == CASCADE_TUNE_OK && r1->error == CASCADE_TUNE_OK);
+
+    //速度级: 按真实对象在设计的穿越频率上求kp, 相位裕度满足设计值
+    w = 2.0 * PI_D * r0->crossover;
+    true_speed_plant(w, &g, &ph);
+    kp = 1.0 / (g * sqrt(1.0 + 1.0 / (4.0 * 4.0)));
+    pm = 180.0 + (ph - atan(0.25)) * 180.0 / PI_D;
+    TEST_ASSERT(fabs(r0->kp - kp) <= 0.05 * kp);
+    TEST_ASSERT(pm >= 50.0 - CASCADE_TUNE_MARGIN_TOL);
+    TEST_ASSERT(r0->phase_margin >= 50.0f && r0->gain_margin >= 8.0f);
+    TEST_ASSERT_NEAR(r0->ki, r0->kp * (float32_t) w / 4.0f * DT, 0.02f * r0->ki);
+    TEST_ASSERT(r0->kd == 0.0f);
+    TEST_ASSERT(r0->overshoot <= CASCADE_TUNE_MAX_OVERSHOOT && r0->final_error <= CASCADE_TUNE_MAX_ERROR);
+
+    //角度级: 纯P, 相位裕度60度
+    TEST_ASSERT(r1->kp > 0.0f && r1->ki == 0.0f && r1->kd == 0.0f);
+    TEST_ASSERT(r1->phase_margin >= 60.0f && r1->gain_margin >= 10.0f);
+    TEST_ASSERT(r1->overshoot <= CASCADE_TUNE_MAX_OVERSHOOT && r1->final_error <= CASCADE_TUNE_MAX_ERROR);
+
+    //增益已写入pid, 没有等待生效的暂存值, 给定回到offset
+    TEST_ASSERT(spd_pid.Kp == r0->kp && spd_pid.Ki == r0->ki && spd_pid.Kd == 0.0f);
+    TEST_ASSERT(rel_pid.Kp == r1->kp && rel_pid.Ki == 0.0f);
+    TEST_ASSERT(reg.owner_pending[OWNER_GIMBAL] == 0U);
+    TEST_ASSERT(control_value == 0.0f);
+    TEST_ASSERT(tune_type == ANGLE_TO_SPEED);
+
+    //保存完成
+    cascade_tune_save_done(&tune, 1);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_DONE);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_DONE);
+}
+
+static void test_rollback(void) {
+    float32_t spd_kp;
+
+    //外环阶跃超出input_limit, 验证中失败
+    setup();
+    stage[1].step = 2.0f;
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 2, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(run(CASCADE_TUNE_DONE) == CASCADE_TUNE_SAVE);
+    report("rollback", &tune.result[1]);
+    TEST_ASSERT(tune.accepted == 1 && tune.stage_done == 2);
+    TEST_ASSERT(tune.result[0].error == CASCADE_TUNE_OK);
+    TEST_ASSERT(tune.result[1].error == CASCADE_TUNE_ERR_LIMIT && tune.error == CASCADE_TUNE_ERR_LIMIT);
+    TEST_ASSERT(control_value == 0.0f);
+
+    //内环保留新增益, 外环恢复原增益
+    settle_loop();
+    spd_kp = tune.result[0].kp;
+    TEST_ASSERT(spd_pid.Kp == spd_kp && spd_pid.Kp != spd_gain[0]);
+    TEST_ASSERT(rel_pid.Kp == rel_gain[0] && rel_pid.Ki == rel_gain[1] && rel_pid.Kd == rel_gain[2]);
+    TEST_ASSERT(reg.owner_pending[OWNER_GIMBAL] == 0U);
+
+    //保存通过的内环后仍报告失败
+    cascade_tune_save_done(&tune, 1);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_FAILED && tune.error == CASCADE_TUNE_ERR_LIMIT);
+}
+
+static void test_wrong_sign(void) {
+    setup();
+    fast_speed_stage();
+    stage[0].feedback_sign = 1.0f;
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(run(CASCADE_TUNE_DONE) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_SIGN && tune.accepted == 0);
+    //未暂存任何增益
+    TEST_ASSERT(reg.owner_pending[OWNER_GIMBAL] == 0U && reg.batch_cnt == 0U);
+    TEST_ASSERT(spd_pid.Kp == spd_gain[0] && spd_pid.Ki == spd_gain[1]);
+    TEST_ASSERT(control_value == 0.0f);
+}
+
+static void test_param_checks(void) {
+    pid_type_def d_first_pid;
+    pid_config_t config;
+
+    //参数表中没有该增益
+    setup();
+    stage[0].param[0] = "yaw_xyz";
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_PARAM && tune.result[0].error == CASCADE_TUNE_ERR_PARAM);
+
+    //增益参数名过长
+    setup();
+    stage[0].param[0] = "yaw_relative_angle";
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_PARAM);
+
+    //微分先行的pid
+    setup();
+    memset(&config, 0, sizeof(config));
+    config.max_out = 30000.0f;
+    config.max_iout = 10000.0f;
+    config.derivative = PID_D_FIRST;
+    config.d_filter_ratio = 0.1f;
+    TEST_ASSERT(PID_build(&d_first_pid, spd_gain, &config) == 0);
+    stage[0].pid = &d_first_pid;
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_PARAM);
+
+    //P_On_M
+    config.derivative = PID_D_NORMAL;
+    config.p_on_m = 1;
+    config.p_on_m_ratio = 0.5f;
+    TEST_ASSERT(PID_build(&d_first_pid, spd_gain, &config) == 0);
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_PARAM);
+
+    //验证阶跃为0, 反馈方向不是正负1
+    setup();
+    stage[0].step = 0.0f;
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED && tune.error == CASCADE_TUNE_ERR_PARAM);
+    setup();
+    stage[0].feedback_sign = 0.5f;
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED && tune.error == CASCADE_TUNE_ERR_PARAM);
+
+    //init的参数检查
+    setup();
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 0, &reg, &tune_type, DT) == -1);
+    TEST_ASSERT(cascade_tune_init(&tune, stage, CASCADE_TUNE_MAX_STAGE + 1, &reg, &tune_type, DT) == -1);
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, NULL, &tune_type, DT) == -1);
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, NULL, DT) == -1);
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, 0.0f) == -1);
+}
+
+static void test_apply_timeout(void) {
+    uint32_t n = 0U;
+
+    setup();
+    fast_speed_stage();
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(run(CASCADE_TUNE_APPLY) == CASCADE_TUNE_APPLY);
+    //控制循环停止使用新增益
+    yaw.apply = 0;
+    while (cascade_tune_update(&tune) == CASCADE_TUNE_APPLY) {
+        control_loop();
+        n++;
+    }
+    TEST_ASSERT(tune.state == CASCADE_TUNE_ROLLBACK);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_ERR_APPLY);
+    TEST_ASSERT(n >= (uint32_t) (CASCADE_TUNE_APPLY_TIMEOUT / DT) - 1U &&
+                n <= (uint32_t) (CASCADE_TUNE_APPLY_TIMEOUT / DT) + 1U);
+    //回滚同样超时后结束, 原增益仍在暂存中
+    TEST_ASSERT(run(CASCADE_TUNE_DONE) == CASCADE_TUNE_FAILED);
+    TEST_ASSERT(reg.owner_pending[OWNER_GIMBAL] == 1U);
+    TEST_ASSERT(spd_pid.Kp == spd_gain[0] && spd_pid.Ki == spd_gain[1]);
+    //控制循环恢复后生效的是原增益
+    yaw.apply = 1;
+    settle_loop();
+    TEST_ASSERT(spd_pid.Kp == spd_gain[0] && spd_pid.Ki == spd_gain[1] && spd_pid.Kd == spd_gain[2]);
+    TEST_ASSERT(reg.owner_pending[OWNER_GIMBAL] == 0U);
+}
+
+static void test_stop_in_verify(void) {
+    setup();
+    fast_speed_stage();
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    TEST_ASSERT(run(CASCADE_TUNE_VERIFY) == CASCADE_TUNE_VERIFY);
+    //新增益已生效, 进入正阶跃
+    TEST_ASSERT(spd_pid.Kp == tune.result[0].kp);
+    for (int i = 0; i < 400; i++) {
+        cascade_tune_update(&tune);
+        control_loop();
+    }
+    TEST_ASSERT(tune.state == CASCADE_TUNE_VERIFY && control_value != 0.0f);
+    cascade_tune_stop(&tune);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_FAILED && tune.error == CASCADE_TUNE_ERR_STOP);
+    TEST_ASSERT(control_value == 0.0f);
+    //停止后不再变化
+    TEST_ASSERT(cascade_tune_update(&tune) == CASCADE_TUNE_FAILED);
+    cascade_tune_stop(&tune);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_FAILED);
+    settle_loop();
+    TEST_ASSERT(spd_pid.Kp == spd_gain[0] && spd_pid.Ki == spd_gain[1]);
+}
+
+static void test_save_failed(void) {
+    setup();
+    fast_speed_stage();
+    TEST_ASSERT(cascade_tune_init(&tune, stage, 1, &reg, &tune_type, DT) == 0);
+    //保存前的save_done不起作用
+    cascade_tune_save_done(&tune, 1);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_IDLE);
+    TEST_ASSERT(run(CASCADE_TUNE_DONE) == CASCADE_TUNE_SAVE);
+    report("fast", &tune.result[0]);
+    TEST_ASSERT(tune.error == CASCADE_TUNE_OK && tune.accepted == 1);
+    cascade_tune_save_done(&tune, 0);
+    TEST_ASSERT(tune.state == CASCADE_TUNE_FAILED && tune.error == CASCADE_TUNE_ERR_SAVE);
+    //增益留在ram中, 由调用者决定是否恢复
+    TEST_ASSERT(spd_pid.Kp == tune.result[0].kp);
+}
+
+/**
+  * @brief          开环裕度的解析值: K / (s (T s + 1))的P控制, 一阶加延迟的PI控制
+  */
+static void test_model_margin(void) {
+    sys_id_fit_t fit;
+    sys_id_point_t point[40];
+    float32_t crossover, pm, gm;
+    double w, lo, hi, g, ph, wc, w180, gm_expect, pm_expect;
+
+    //K=10, T=0.1, kp=1: w^2 (1 + 0.01 w^2) = 100, pm = 90 - atan(0.1 w), 相位不到-180度
+    memset(&fit, 0, sizeof(fit));
+    fit.model = SYS_ID_INTEGRATOR_FIRST_ORDER;
+    fit.gain = 10.0f;
+    fit.time_const = 0.1f;
+    wc = sqrt((-1.0 + sqrt(5.0)) / 0.02);
+    cascade_tune_model_margin(&fit, 1.0f, 0.0f, 0.1f, DT, &crossover, &pm, &gm);
+    TEST_ASSERT_NEAR(crossover, wc / (2.0 * PI_D), 0.01 * wc / (2.0 * PI_D));
+    TEST_ASSERT_NEAR(pm, 90.0 - atan(0.1 * wc) * 180.0 / PI_D, 0.5f);
+    TEST_ASSERT(gm == CASCADE_TUNE_GM_INF);
+
+    //K=2, T=0.05, delay=5ms, kp=3, wi=20: 二分求穿越频率和-180度频率
+    fit.model = SYS_ID_FIRST_ORDER;
+    fit.gain = 2.0f;
+    fit.time_const = 0.05f;
+    fit.delay = 0.005f;
+#define OPEN_LOOP(w, g, ph) do { \
+        (g) = 3.0 * sqrt(1.0 + 400.0 / ((w) * (w))) * 2.0 / sqrt(1.0 + 0.0025 * (w) * (w)); \
+        (ph) = -atan(20.0 / (w)) - atan(0.05 * (w)) - 0.005 * (w); \
+    } while (0)
+    for (lo = 1.0, hi = 3000.0; hi - lo > 1e-6;) {
+        w = 0.5 * (lo + hi);
+        OPEN_LOOP(w, g, ph);
+        if (g > 1.0) lo = w; else hi = w;
+    }
+    wc = lo;
+    OPEN_LOOP(wc, g, ph);
+    pm_expect = 180.0 + ph * 180.0 / PI_D;
+    for (lo = 1.0, hi = 3000.0; hi - lo > 1e-6;) {
+        w = 0.5 * (lo + hi);
+        OPEN_LOOP(w, g, ph);
+        if (ph > -PI_D) lo = w; else hi = w;
+    }
+    w180 = lo;
+    OPEN_LOOP(w180, g, ph);
+    gm_expect = -20.0 * log10(g);
+#undef OPEN_LOOP
+    cascade_tune_model_margin(&fit, 3.0f, 20.0f, 0.1f, DT, &crossover, &pm, &gm);
+    printf("model   wc %6.2f Hz (%6.2f)  pm %5.2f (%5.2f)  gm %5.2f (%5.2f) w180 %6.2f Hz\n", crossover,
+           wc / (2.0 * PI_D), pm, pm_expect, gm, gm_expect, w180 / (2.0 * PI_D));
+    TEST_ASSERT_NEAR(crossover, wc / (2.0 * PI_D), 0.01 * wc / (2.0 * PI_D));
+    TEST_ASSERT_NEAR(pm, pm_expect, 0.5f);
+    TEST_ASSERT_NEAR(gm, gm_expect, 0.2f);
+
+    //测量点为同一模型, 方向反向, 裕度与模型相同
+    for (int i = 0; i < 40; i++) {
+        point[i].freq = 0.5f * powf(1.15f, (float32_t) i);
+        sys_id_model_response(&fit, point[i].freq, &point[i].gain, &point[i].phase);
+        point[i].phase -= PI;
+        point[i].quality = 1.0f;
+    }
+    cascade_tune_point_margin(point, 40, 0.5f, -1.0f, 3.0f, 20.0f, &crossover, &pm, &gm);
+    TEST_ASSERT_NEAR(crossover, wc / (2.0 * PI_D), 0.02 * wc / (2.0 * PI_D));
+    TEST_ASSERT_NEAR(pm, pm_expect, 1.0f);
+    TEST_ASSERT_NEAR(gm, gm_expect, 0.5f);
+    //低质量的点不参与, 最后一个点仍大于1时没有穿越
+    cascade_tune_point_margin(point, 10, 0.5f, -1.0f, 3.0f, 20.0f, &crossover, &pm, &gm);
+    TEST_ASSERT(crossover == -1.0f);
+    for (int i = 0; i < 40; i++) {
+        point[i].quality = 0.1f;
+    }
+    cascade_tune_point_margin(point, 40, 0.5f, -1.0f, 3.0f, 20.0f, &crossover, &pm, &gm);
+    TEST_ASSERT(crossover == -1.0f);
+
+    //到奈奎斯特频率仍未穿越
+    fit.delay = 0.0f;
+    cascade_tune_model_margin(&fit, 1000.0f, 0.0f, 0.1f, DT, &crossover, &pm, &gm);
+    TEST_ASSERT(crossover == 0.5f / DT && pm == 0.0f);
+}
+
+int main(void) {
+    RUN_TEST(test_model_margin);
+    RUN_TEST(test_param_checks);
+    RUN_TEST(test_full_run);
+    RUN_TEST(test_rollback);
+    RUN_TEST(test_wrong_sign);
+    RUN_TEST(test_apply_timeout);
+    RUN_TEST(test_stop_in_verify);
+    RUN_TEST(test_save_failed);
+    return unit_test_result();
+}
@@ -0,0 +1,134 @@
+/**
+  * @file       test_crc.c
+  * @brief      referee CRC8/CRC16 against a bitwise reference for every
+  *             length and alignment, the standard check values, the
+  *             append/verify helpers on a referee frame header and the
+  *             throughput. The golden vision frame comes from running
+  *             Others/CRC_tester_and_Vision_RC_generator.c at build time.
+  *             Built once per CRC_SLICE_BY variant.
+  *             裁判系统CRC8/CRC16与逐位计算的参考值比较(所有长度和对齐), 标准校验值, 帧头的添加和校验以及吞吐.
+  *             黄金向量为编译时运行Others/CRC_tester_and_Vision_RC_generator.c输出的视觉帧.每种CRC_SLICE_BY各编译一次
+  */
+#include "unit_test.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+#include "crc_golden.h"
+
+//CRC-8/MAXIM多项式反射0x8C, 初值0xFF
+static uint8_t crc8_bitwise(const uint8_t *data, uint32_t len, uint8_t crc) {
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1U) ? (uint8_t) ((crc >> 1) ^ 0x8CU) : (uint8_t) (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+//CRC-16/MCRF4XX多项式反射0x8408, 初值0xFFFF
+static uint16_t crc16_bitwise(const uint8_t *data, uint32_t len, uint16_t crc) {
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1U) ? (uint16_t) ((crc >> 1) ^ 0x8408U) : (uint16_t) (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void test_check_values(void) {
+    uint8_t check[] = "123456789";
+    TEST_ASSERT(get_CRC16_check_sum(check, 9, 0xFFFF) == 0x6F91);
+    TEST_ASSERT(get_CRC8_check_sum(check, 9, 0xFF) == crc8_bitwise(check, 9, 0xFF));
+    TEST_ASSERT(get_CRC8_check_sum(check, 0, 0xFF) == 0xFF);
+    TEST_ASSERT(get_CRC16_check_sum(check, 0, 0xFFFF) == 0xFFFF);
+}
+
+//CRC测试程序输出的视觉帧: '$', data_len, 两个float和一个uint16, 其后是帧尾CRC16
+static void test_golden_frame(void) {
+    uint8_t frame[sizeof(crc_golden_frame) + 2];
+
+    TEST_ASSERT(sizeof(crc_golden_frame) == 12U && crc_golden_frame[0] == '$');
+    TEST_ASSERT(get_CRC16_check_sum((uint8_t *) crc_golden_frame, sizeof(crc_golden_frame), 0xFFFF) ==
+                CRC_GOLDEN_FRAME_CRC16);
+    TEST_ASSERT(crc16_bitwise(crc_golden_frame, sizeof(crc_golden_frame), 0xFFFF) == CRC_GOLDEN_FRAME_CRC16);
+    memcpy(frame, crc_golden_frame, sizeof(crc_golden_frame));
+    append_CRC16_check_sum(frame, sizeof(frame));
+    TEST_ASSERT(frame[12] == (uint8_t) CRC_GOLDEN_FRAME_CRC16 && frame[13] == (uint8_t) (CRC_GOLDEN_FRAME_CRC16 >> 8));
+    TEST_ASSERT(verify_CRC16_check_sum(frame, sizeof(frame)));
+}
+
+static void test_against_bitwise(void) {
+    //覆盖按字切片的每种长度和起始对齐
+    uint8_t buffer[300];
+    uint32_t seed = 1U;
+    for (unsigned i = 0; i < sizeof(buffer); i++) {
+        seed = seed * 1103515245U + 12345U;
+        buffer[i] = (uint8_t) (seed >> 16);
+    }
+    for (uint32_t offset = 0; offset < 8; offset++) {
+        for (uint32_t len = 0; len < 280; len++) {
+            uint8_t c8 = get_CRC8_check_sum(buffer + offset, len, 0xFF);
+            uint16_t c16 = get_CRC16_check_sum(buffer + offset, len, 0xFFFF);
+            if (c8 != crc8_bitwise(buffer + offset, len, 0xFF) ||
+                c16 != crc16_bitwise(buffer + offset, len, 0xFFFF)) {
+                printf("offset %u len %u\n", offset, len);
+                TEST_ASSERT(0);
+                return;
+            }
+        }
+    }
+}
+
+static void test_append_verify(void) {
+    //裁判系统帧: SOF, data_length(2), seq, CRC8, cmd_id(2), data, CRC16
+    uint8_t frame[5 + 2 + 6 + 2] = {0xA5, 6, 0, 7};
+    frame[5] = 0x01;
+    frame[6] = 0x02;
+    memcpy(&frame[7], "\x11\x22\x33\x44\x55\x66", 6);
+    append_CRC8_check_sum(frame, 5);
+    append_CRC16_check_sum(frame, sizeof(frame));
+    TEST_ASSERT(verify_CRC8_check_sum(frame, 5));
+    TEST_ASSERT(verify_CRC16_check_sum(frame, sizeof(frame)));
+
+    frame[9] ^= 0x10;
+    TEST_ASSERT(verify_CRC8_check_sum(frame, 5));
+    TEST_ASSERT(!verify_CRC16_check_sum(frame, sizeof(frame)));
+    frame[2] ^= 0x01;
+    TEST_ASSERT(!verify_CRC8_check_sum(frame, 5));
+
+    //长度不足或空指针
+    TEST_ASSERT(!verify_CRC8_check_sum(NULL, 5));
+    TEST_ASSERT(!verify_CRC16_check_sum(frame, 2));
+}
+
+static void test_throughput(void) {
+    static uint8_t buffer[1024];
+    const int rounds = 20000;
+    volatile uint32_t sink = 0;
+    for (unsigned i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t) (i * 31U);
+    }
+    uint64_t start = unit_test_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        sink += get_CRC16_check_sum(buffer, sizeof(buffer), 0xFFFF);
+    }
+    uint64_t crc16_ns = unit_test_now_ns() - start;
+    start = unit_test_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        sink += get_CRC8_check_sum(buffer, sizeof(buffer), 0xFF);
+    }
+    uint64_t crc8_ns = unit_test_now_ns() - start;
+    (void) sink;
+    printf("slice-by-%d: CRC16 %.3f ns/byte, CRC8 %.3f ns/byte\n", CRC_SLICE_BY,
+           (double) crc16_ns / rounds / sizeof(buffer), (double) crc8_ns / rounds / sizeof(buffer));
+}
+
+int main(void) {
+    RUN_TEST(test_check_values);
+    RUN_TEST(test_golden_frame);
+    RUN_TEST(test_against_bitwise);
+    RUN_TEST(test_append_verify);
+    RUN_TEST(test_throughput);
+    return unit_test_result();
+}
@@ -0,0 +1,312 @@
+/**
+  * @file       test_flash_kv.c
+  * @brief      flash_kv on a flash simulator with sector erase and AND-program
+  *             semantics: basic read/write/remount, wear and write amplification
+  *             against the erase-and-rewrite-all layout it replaced, and power
+  *             cuts injected at every program word and erase of a run that
+  *             spans garbage collection, plus a random cut/remount fuzz. A cut
+  *             leaves a torn word or a half erased sector. After each cut every
+  *             key must read its old or its new value.
+  *             基于扇区擦除和按位与写入语义的flash模拟器测试flash_kv: 基本读写和重新挂载, 与被替换的
+  *             整扇区擦除重写比较磨损和写放大, 以及在跨越垃圾回收的一段写入中每个写入字和擦除处断电,
+  *             再加随机断电/重新挂载的模糊测试.断电留下写了一半的字或擦了一半的扇区, 之后每个键必须读到旧值或新值
+  */
+#include "unit_test.h"
+#include "flash_kv.h"
+#include <setjmp.h>
+#include <string.h>
+
+#define SECTOR_A        0x080C0000U
+#define SECTOR_B        0x080E0000U
+#define SECTOR_MAX      (128U * 1024U)
+//F407 128KB扇区擦除的典型时间 s, 期间flash读取停顿
+#define ERASE_STALL_S   1.0
+#define KEY_NUM         4
+
+//按calibrate_task中各传感器记录的数量级
+static const uint8_t key_len[KEY_NUM] = {3, 7, 13, 5};
+
+static uint32_t flash[2][SECTOR_MAX / 4];
+static uint32_t sector_size = SECTOR_MAX;
+static uint32_t erase_cnt, program_cnt, overprogram_cnt;
+//断电注入: 第cut_at次写入或擦除时断电
+static long cut_at = -1, step_cnt;
+static jmp_buf cut_jmp;
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+static uint32_t *flash_word(uint32_t address) {
+    int s = address >= SECTOR_B;
+    return &flash[s][(address - (s ? SECTOR_B : SECTOR_A)) / 4U];
+}
+
+static bool power_cut(void) {
+    return cut_at >= 0 && step_cnt++ >= cut_at;
+}
+
+static int8_t sim_erase(uint32_t address) {
+    int s = address >= SECTOR_B;
+    if (power_cut()) {
+        //擦了一半
+        memset(flash[s], 0xFF, sector_size / 2U);
+        longjmp(cut_jmp, 1);
+    }
+    memset(flash[s], 0xFF, sector_size);
+    erase_cnt++;
+    return 0;
+}
+
+static int8_t sim_program(uint32_t address, const uint32_t *buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t *p_word = flash_word(address + 4U * i);
+        if (power_cut()) {
+            //写了一半的字
+            *p_word &= buf[i] | (rnd(0x10000U) << 16 | rnd(0x10000U));
+            longjmp(cut_jmp, 1);
+        }
+        //flash只能把1写成0, 写入未擦除的字是错误用法
+        if (*p_word != 0xFFFFFFFFU) {
+            overprogram_cnt++;
+        }
+        *p_word &= buf[i];
+        program_cnt++;
+    }
+    return 0;
+}
+
+static void sim_read(uint32_t address, uint32_t *buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = *flash_word(address + 4U * i);
+    }
+}
+
+static const flash_kv_ops_t sim_ops = {sim_erase, sim_program, sim_read};
+
+static void flash_reset(uint32_t size) {
+    sector_size = size;
+    memset(flash, 0xFF, sizeof(flash));
+    erase_cnt = program_cnt = overprogram_cnt = 0;
+    cut_at = -1;
+}
+
+static void make_value(uint32_t *buf, int key, uint32_t gen) {
+    for (int i = 0; i < key_len[key]; i++) {
+        buf[i] = gen * 2654435761U + (uint32_t) key * 977U + (uint32_t) i;
+    }
+}
+
+static bool value_is(const flash_kv_t *p_kv, int key, uint32_t gen) {
+    uint32_t expect[FLASH_KV_MAX_LEN], value[FLASH_KV_MAX_LEN];
+    if (flash_kv_read(p_kv, (uint8_t) key, value, key_len[key]) != 0) {
+        return gen == 0;
+    }
+    make_value(expect, key, gen);
+    return gen != 0 && memcmp(value, expect, key_len[key] * 4U) == 0;
+}
+
+static void test_basic(void) {
+    flash_kv_t kv;
+    uint32_t value[FLASH_KV_MAX_LEN];
+    flash_reset(4096U);
+    TEST_ASSERT(flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size) == 0);
+    TEST_ASSERT(flash_kv_is_empty(&kv));
+    TEST_ASSERT(flash_kv_read(&kv, 0, value, key_len[0]) == -1);
+
+    make_value(value, 1, 1);
+    TEST_ASSERT(flash_kv_write(&kv, 1, value, key_len[1]) == 0);
+    TEST_ASSERT(!flash_kv_is_empty(&kv) && value_is(&kv, 1, 1));
+    //长度必须与存储的相同
+    TEST_ASSERT(flash_kv_read(&kv, 1, value, key_len[1] - 1U) == -1);
+    //非法参数
+    TEST_ASSERT(flash_kv_write(&kv, FLASH_KV_KEY_NUM, value, 1) == -1);
+    TEST_ASSERT(flash_kv_write(&kv, 0, value, 0) == -1);
+    TEST_ASSERT(flash_kv_write(&kv, 0, value, FLASH_KV_MAX_LEN + 1) == -1);
+
+    //只更新一个键, 其他键不变, 重新挂载后仍是最新值
+    make_value(value, 2, 1);
+    flash_kv_write(&kv, 2, value, key_len[2]);
+    make_value(value, 1, 2);
+    flash_kv_write(&kv, 1, value, key_len[1]);
+    flash_kv_t kv2;
+    TEST_ASSERT(flash_kv_mount(&kv2, &sim_ops, SECTOR_A, SECTOR_B, sector_size) == 0);
+    TEST_ASSERT(value_is(&kv2, 1, 2) && value_is(&kv2, 2, 1) && value_is(&kv2, 0, 0));
+    TEST_ASSERT(kv2.write_offset == kv.write_offset && kv2.corrupt_cnt == 0);
+    //长度改变的记录
+    make_value(value, 1, 3);
+    TEST_ASSERT(flash_kv_write(&kv2, 1, value, 2) == 0 && flash_kv_read(&kv2, 1, value, key_len[1]) == -1);
+    TEST_ASSERT(overprogram_cnt == 0);
+}
+
+static void test_wear(void) {
+    flash_kv_t kv;
+    uint32_t gen[KEY_NUM] = {0}, value[FLASH_KV_MAX_LEN];
+    const uint32_t saves = 20000U;
+    flash_reset(SECTOR_MAX);
+    flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+    uint32_t mount_erase = erase_cnt;
+    //每次保存一个传感器
+    for (uint32_t n = 0; n < saves; n++) {
+        int key = (int) rnd(KEY_NUM);
+        make_value(value, key, ++gen[key]);
+        if (flash_kv_write(&kv, (uint8_t) key, value, key_len[key]) != 0) {
+            TEST_ASSERT(0);
+            return;
+        }
+    }
+    for (int key = 0; key < KEY_NUM; key++) {
+        TEST_ASSERT(value_is(&kv, key, gen[key]));
+    }
+    TEST_ASSERT(overprogram_cnt == 0 && kv.erase_cnt == erase_cnt);
+
+    //被替换的做法: 每次保存擦除扇区, 重写所有传感器(数据加名称/标志字)
+    uint32_t legacy_words = 0, user_words = (uint32_t) kv.user_words;
+    for (int key = 0; key < KEY_NUM; key++) {
+        legacy_words += key_len[key] + 1U;
+    }
+    double amplification = (double) kv.program_words / user_words;
+    double legacy_amplification = (double) legacy_words * saves / user_words;
+    TEST_ASSERT(erase_cnt - mount_erase <= 10U);
+    TEST_ASSERT(amplification < 1.6 && amplification < 0.5 * legacy_amplification);
+    printf("%u single sensor saves: %u erases (%.0f s of flash stall) vs %u (%.0f s), write amplification %.2f vs %.2f, "
+           "%u gc\n", saves, erase_cnt - mount_erase, (erase_cnt - mount_erase) * ERASE_STALL_S, saves,
+           saves * ERASE_STALL_S, amplification, legacy_amplification, kv.gc_cnt);
+}
+
+//在一段跨越垃圾回收的写入中, 断电点依次取每个写入字和擦除
+static void test_power_cut_every_step(void) {
+    static uint32_t snapshot[2][SECTOR_MAX / 4];
+    //longjmp之后仍要使用的变量不能放在寄存器中
+    static flash_kv_t kv;
+    static uint32_t gen[KEY_NUM], gc_seen;
+    uint32_t snapshot_gen[KEY_NUM], value[FLASH_KV_MAX_LEN];
+    flash_reset(2048U);
+    flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+    for (int key = 0; key < KEY_NUM; key++) {
+        gen[key] = 1;
+        make_value(value, key, 1);
+        flash_kv_write(&kv, (uint8_t) key, value, key_len[key]);
+    }
+    //写到扇区接近满, 之后的写入会触发回收
+    for (int n = 0; kv.write_offset + 4U * (key_len[2] + 3U) * 2U < sector_size; n++) {
+        int key = n % KEY_NUM;
+        make_value(value, key, ++gen[key]);
+        flash_kv_write(&kv, (uint8_t) key, value, key_len[key]);
+    }
+    memcpy(snapshot, flash, sizeof(flash));
+    memcpy(snapshot_gen, gen, sizeof(gen));
+
+    uint32_t trials = 0, torn = 0, damaged = 0, dead = 0;
+    for (long cut = 0;; cut++) {
+        memcpy(flash, snapshot, sizeof(flash));
+        memcpy(gen, snapshot_gen, sizeof(gen));
+        cut_at = -1;
+        flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+        volatile int pending = -1;
+        volatile uint32_t pending_gen = 0;
+        volatile bool finished = false;
+        step_cnt = 0;
+        cut_at = cut;
+        if (setjmp(cut_jmp) == 0) {
+            for (int s = 0; s < 3 * KEY_NUM; s++) {
+                int key = s % KEY_NUM;
+                pending = key;
+                pending_gen = gen[key] + 1U;
+                make_value(value, key, pending_gen);
+                flash_kv_write(&kv, (uint8_t) key, value, key_len[key]);
+                gen[key] = pending_gen;
+                pending = -1;
+            }
+            finished = true;
+            gc_seen = kv.gc_cnt;
+        }
+        cut_at = -1;
+        trials++;
+
+        //重新上电
+        flash_kv_t remount;
+        flash_kv_mount(&remount, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+        for (int key = 0; key < KEY_NUM; key++) {
+            if (value_is(&remount, key, gen[key])) {
+                continue;
+            }
+            if (key == pending) {
+                torn += !value_is(&remount, key, pending_gen);
+            } else {
+                damaged++;
+            }
+        }
+        //恢复后仍可写入
+        make_value(value, 0, 1000U);
+        if (flash_kv_write(&remount, 0, value, key_len[0]) != 0 || !value_is(&remount, 0, 1000U)) {
+            dead++;
+        }
+        if (finished) {
+            break;
+        }
+    }
+    TEST_ASSERT(gc_seen >= 1U);
+    TEST_ASSERT(torn == 0 && damaged == 0 && dead == 0);
+    printf("power cut at each of %u steps (%d saves incl. %u gc): %u torn, %u other keys damaged, %u unusable\n",
+           trials - 1U, 3 * KEY_NUM, gc_seen, torn, damaged, dead);
+}
+
+//随机写入, 随机断电并重新挂载
+static void test_power_cut_fuzz(void) {
+    //longjmp之后仍要使用的变量不能放在寄存器中
+    static flash_kv_t kv;
+    static uint32_t gen[KEY_NUM], next_gen = 1, writes;
+    uint32_t value[FLASH_KV_MAX_LEN];
+    uint32_t cuts = 0, bad = 0, corrupt = 0, gc_total = 0;
+    flash_reset(1024U);
+    flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+    for (int round = 0; round < 3000; round++) {
+        volatile int pending = -1;
+        volatile uint32_t pending_gen = 0;
+        step_cnt = 0;
+        cut_at = (long) rnd(200);
+        if (setjmp(cut_jmp) == 0) {
+            for (;;) {
+                int key = (int) rnd(KEY_NUM);
+                pending = key;
+                pending_gen = next_gen++;
+                make_value(value, key, pending_gen);
+                flash_kv_write(&kv, (uint8_t) key, value, key_len[key]);
+                gen[key] = pending_gen;
+                pending = -1;
+                writes++;
+            }
+        }
+        cut_at = -1;
+        cuts++;
+        gc_total += kv.gc_cnt;
+        flash_kv_mount(&kv, &sim_ops, SECTOR_A, SECTOR_B, sector_size);
+        corrupt += kv.corrupt_cnt;
+        for (int key = 0; key < KEY_NUM; key++) {
+            if (value_is(&kv, key, gen[key])) {
+                continue;
+            }
+            //断电时正在写的键可能已经提交
+            if (key == pending && value_is(&kv, key, pending_gen)) {
+                gen[key] = pending_gen;
+                continue;
+            }
+            bad++;
+        }
+    }
+    TEST_ASSERT(bad == 0 && gc_total > 100U);
+    printf("%u power cuts over %u writes and %u gc: %u keys lost, %u torn records skipped over all mounts\n", cuts, writes,
+           gc_total, bad, corrupt);
+}
+
+int main(void) {
+    RUN_TEST(test_basic);
+    RUN_TEST(test_wear);
+    RUN_TEST(test_power_cut_every_step);
+    RUN_TEST(test_power_cut_fuzz);
+    return unit_test_result();
+}
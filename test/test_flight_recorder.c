@@ -0,0 +1,288 @@
+/**
+  * @file       test_flight_recorder.c
+  * @brief      the flight recorder record codec and banks: record layout and
+  *             float/sign packing, cold boot on random content, 5000 records
+  *             through a 2048 entry bank across a DWT wrap, a record torn by a
+  *             fault, freezing on a warm reset while the new session logs into
+  *             the other bank during the dump, the dump through a busy writer
+  *             checked against its own decoder (order, timestamps, CRC), a frozen
+  *             bank kept over a reset without host, the clear command, and the
+  *             logging cost. The dumps are also written to a file for the Python
+  *             decoder.
+  *             飞行记录仪的记录编码和记录区: 记录布局和浮点/符号打包, 随机内容冷启动, 5000条记录跨DWT回绕经过
+  *             2048条的记录区, 被故障打断的记录, 热复位冻结且输出期间新的运行写入另一个记录区, 经忙碌的发送函数
+  *             输出并由测试中的解码检查(顺序、时间戳、CRC), 没有上位机时冻结的记录区在复位后保留, 清除命令, 以及
+  *             记录开销.输出同时写入文件供Python解码工具测试
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "main.h"
+//DWT换成测试中的变量
+static DWT_Type sim_dwt;
+#undef DWT
+#define DWT (&sim_dwt)
+//直接包含源文件, 测试中代替复位操作缓存和状态
+#include "../User/Components/support/flight_recorder.c"
+#include <stddef.h>
+#include <stdio.h>
+
+#define TICK_HZ         168000000U
+#define RESET_POR_PIN   0x0C000000U
+#define RESET_SFT_PIN   0x14000000U
+#define RESET_IWDG      0x20000000U
+#define DUMP_MAX        (sizeof(flight_recorder_dump_head_t) + sizeof(flight_recorder_record[0]) + 4U)
+
+static uint8_t dump_buf[DUMP_MAX];
+static uint32_t dump_len, busy_percent, write_calls, busy_calls;
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+//USB/RTT发送: 按比例忙碌, 只接受整块
+static int dump_write(const uint8_t *p_data, uint16_t len) {
+    write_calls++;
+    if (rnd(100) < busy_percent) {
+        busy_calls++;
+        return -1;
+    }
+    if (dump_len + len > DUMP_MAX) {
+        return -1;
+    }
+    memcpy(dump_buf + dump_len, p_data, len);
+    dump_len += len;
+    return 0;
+}
+
+//输出全部, 每次调用之间写入log_num条新的记录
+static int dump_all(uint16_t chunk_len, uint32_t log_num) {
+    int ret, calls = 0;
+    uint32_t logged = 0;
+    dump_len = 0;
+    while ((ret = flight_recorder_dump(dump_write, chunk_len)) == 0 && calls++ < 100000) {
+        if (logged < log_num) {
+            flight_recorder_log(FLIGHT_RECORD_DETECT, 3, (int16_t) (logged & 1U), logged, 0);
+            logged++;
+        }
+    }
+    return ret;
+}
+
+//上电和热复位: 记录区保留, 模块静态变量重新初始化
+static void warm_reset(uint32_t reset_flags) {
+    flight_recorder_state = FLIGHT_RECORDER_STOP;
+    flight_recorder_live = NULL;
+    flight_recorder_live_record = NULL;
+    flight_recorder_frozen = -1;
+    memset(&flight_recorder_dump_state, 0xEE, sizeof(flight_recorder_dump_state));
+    flight_recorder_init(reset_flags, TICK_HZ);
+}
+
+static void dump_to_file(const char *mode) {
+#ifdef FLIGHT_RECORDER_DUMP_FILE
+    FILE *file = fopen(FLIGHT_RECORDER_DUMP_FILE, mode);
+    TEST_ASSERT(file != NULL);
+    if (file != NULL) {
+        fwrite(dump_buf, 1, dump_len, file);
+        fclose(file);
+    }
+#else
+    (void) mode;
+#endif
+}
+
+static void test_record_codec(void) {
+    TEST_ASSERT(sizeof(flight_record_t) == 16);
+    TEST_ASSERT(offsetof(flight_record_t, type) == 4 && offsetof(flight_record_t, v0) == 6);
+    TEST_ASSERT(sizeof(flight_recorder_dump_head_t) == 32);
+
+    memset(flight_recorder_bank, 0, sizeof(flight_recorder_bank));
+    memset(flight_recorder_record, 0, sizeof(flight_recorder_record));
+    sim_dwt.CYCCNT = 1234U;
+    warm_reset(RESET_POR_PIN);
+    TEST_ASSERT(flight_recorder_state == FLIGHT_RECORDER_RUNNING && flight_recorder_live == &flight_recorder_bank[0]);
+    TEST_ASSERT(flight_recorder_bank[0].head == 1U && !flight_recorder_dump_pending());
+    flight_recorder_log_f(FLIGHT_RECORD_GIMBAL, 1, -300, 0.5f, -1.25f);
+    flight_recorder_log(FLIGHT_RECORD_DETECT, 7, FLIGHT_DETECT_LOST, 0xDEADBEEFU, 0);
+
+    //第一个字为时间戳, 第二个字为类型|编号|v0, 小端
+    const uint32_t *p_word = (const uint32_t *) &flight_recorder_record[0][1];
+    TEST_ASSERT(p_word[0] == 1234U);
+    TEST_ASSERT(p_word[1] == (FLIGHT_RECORD_GIMBAL | 1U << 8 | (uint32_t) (uint16_t) -300 << 16));
+    float32_t f1, f2;
+    memcpy(&f1, &p_word[2], 4);
+    memcpy(&f2, &p_word[3], 4);
+    TEST_ASSERT(f1 == 0.5f && f2 == -1.25f);
+    const flight_record_t *p_rec = &flight_recorder_record[0][2];
+    TEST_ASSERT(p_rec->type == FLIGHT_RECORD_DETECT && p_rec->id == 7 && p_rec->v0 == FLIGHT_DETECT_LOST);
+    TEST_ASSERT(p_rec->v1 == 0xDEADBEEFU);
+    //启动记录
+    p_rec = &flight_recorder_record[0][0];
+    TEST_ASSERT(p_rec->type == FLIGHT_RECORD_BOOT && p_rec->v1 == RESET_POR_PIN && p_rec->v2 == 0U);
+    //记录时短暂关中断
+    TEST_ASSERT(host_primask == 0U);
+}
+
+//解码一次输出, 检查CRC, 返回记录数, 失败返回-1
+static int decode_dump(flight_recorder_dump_head_t *p_head, const flight_record_t **pp_record) {
+    if (dump_len < sizeof(*p_head) + 4U) {
+        return -1;
+    }
+    memcpy(p_head, dump_buf, sizeof(*p_head));
+    uint32_t body_len = sizeof(*p_head) + p_head->count * sizeof(flight_record_t);
+    if (p_head->magic != FLIGHT_RECORDER_DUMP_MAGIC || p_head->record_size != sizeof(flight_record_t) ||
+        dump_len != body_len + 4U) {
+        return -1;
+    }
+    uint16_t crc = get_CRC16_check_sum(dump_buf, body_len, FLIGHT_RECORDER_CRC_INIT);
+    if (dump_buf[body_len] != (uint8_t) crc || dump_buf[body_len + 1U] != (uint8_t) (crc >> 8) ||
+        dump_buf[body_len + 2U] != 0U || dump_buf[body_len + 3U] != 0U) {
+        return -1;
+    }
+    *pp_record = (const flight_record_t *) (dump_buf + sizeof(*p_head));
+    return (int) p_head->count;
+}
+
+static void test_wraparound_and_dump(void) {
+    //上电时RAM为随机内容
+    for (uint32_t i = 0; i < sizeof(flight_recorder_bank); i++) {
+        ((uint8_t *) flight_recorder_bank)[i] = (uint8_t) rnd(256);
+    }
+    for (uint32_t i = 0; i < sizeof(flight_recorder_record); i++) {
+        ((uint8_t *) flight_recorder_record)[i] = (uint8_t) rnd(256);
+    }
+    //DWT在最后2048条记录中间回绕
+    sim_dwt.CYCCNT = 0U - 168500U * 4000U;
+    warm_reset(RESET_POR_PIN);
+    TEST_ASSERT(flight_recorder_state == FLIGHT_RECORDER_RUNNING && !flight_recorder_dump_pending());
+    TEST_ASSERT(flight_recorder_live->boot_cnt == 0U);
+
+    //5000条1kHz左右的记录, DWT中途回绕
+    const uint32_t logged = 5000U;
+    for (uint32_t i = 0; i < logged; i++) {
+        sim_dwt.CYCCNT += 168000U + rnd(1000);
+        flight_recorder_log(FLIGHT_RECORD_TASK_TIME, (uint8_t) (i & 3U), (int16_t) (i - 2500U), i, ~i);
+    }
+    flight_recorder_log_f(FLIGHT_RECORD_INS, 0, -12, 3.0f, -0.25f);
+    //故障打断的最后一条记录: 已占用位置, 类型字还是0
+    uint32_t slot = flight_recorder_live->head++ & FLIGHT_RECORDER_MASK;
+    ((volatile uint32_t *) &flight_recorder_live_record[slot])[1] = 0U;
+    flight_recorder_bank_t *p_old = flight_recorder_live;
+    uint32_t session_head = p_old->head;
+    TEST_ASSERT(session_head == logged + 3U);
+
+    //看门狗/软件复位后冻结, 本次运行从启动开始写入另一个记录区
+    warm_reset(RESET_SFT_PIN);
+    TEST_ASSERT(flight_recorder_dump_pending() && flight_recorder_live != p_old && p_old->head == session_head);
+    TEST_ASSERT(flight_recorder_live->boot_cnt == 1U && flight_recorder_live->head == 1U);
+
+    //输出期间继续记录
+    busy_percent = 30U;
+    write_calls = busy_calls = 0;
+    TEST_ASSERT(dump_all(200, 10U) == 1);
+    TEST_ASSERT(busy_calls > 0U && !flight_recorder_dump_pending());
+    TEST_ASSERT(flight_recorder_live->head == 11U && flight_recorder_dump(dump_write, 200) == -1);
+
+    flight_recorder_dump_head_t head;
+    const flight_record_t *p_record;
+    int count = decode_dump(&head, &p_record);
+    TEST_ASSERT(count == FLIGHT_RECORDER_RECORD_NUM);
+    TEST_ASSERT(head.head == session_head && head.boot_cnt == 0U && head.tick_hz == TICK_HZ);
+    TEST_ASSERT(head.reset_flags == RESET_POR_PIN && head.end_reset_flags == RESET_SFT_PIN);
+    if (count != FLIGHT_RECORDER_RECORD_NUM) {
+        return;
+    }
+    //最早的在前: 最后2048条, 时间戳按无符号差值单调
+    uint32_t first = session_head - FLIGHT_RECORDER_RECORD_NUM - 1U, order_err = 0, tick_err = 0;
+    for (int i = 0; i < count - 2; i++) {
+        uint32_t seq = first + (uint32_t) i;
+        const flight_record_t *p_rec = &p_record[i];
+        order_err += p_rec->type != FLIGHT_RECORD_TASK_TIME || p_rec->v1 != seq || p_rec->v2 != ~seq ||
+                     p_rec->v0 != (int16_t) (seq - 2500U) || p_rec->id != (seq & 3U);
+        if (i > 0) {
+            uint32_t delta = p_rec->tick - p_record[i - 1].tick;
+            tick_err += delta < 168000U || delta >= 169000U;
+        }
+    }
+    TEST_ASSERT(order_err == 0 && tick_err == 0);
+    TEST_ASSERT(p_record[count - 2].type == FLIGHT_RECORD_INS && p_record[count - 2].v0 == -12);
+    TEST_ASSERT(p_record[count - 1].type == FLIGHT_RECORD_NONE);
+    //DWT回绕在输出的窗口内
+    TEST_ASSERT(p_record[0].tick > p_record[count - 2].tick);
+    //两次运行的输出连在一起, 与RTT记录的文件相同
+    dump_to_file("wb");
+
+    //没有上位机: 输出一直忙, 之后再次复位, 冻结的记录区保留, 中间的运行被覆盖
+    warm_reset(RESET_IWDG);
+    flight_recorder_bank_t *p_frozen = &flight_recorder_bank[flight_recorder_frozen];
+    busy_percent = 100U;
+    for (uint32_t i = 0; i < 100U; i++) {
+        TEST_ASSERT(flight_recorder_dump(dump_write, 64) == 0);
+    }
+    TEST_ASSERT(flight_recorder_dump_pending() && p_frozen->boot_cnt == 1U);
+    flight_recorder_log(FLIGHT_RECORD_DETECT, 0, 0, 0, 0);
+    warm_reset(RESET_SFT_PIN);
+    TEST_ASSERT(flight_recorder_dump_pending() && &flight_recorder_bank[flight_recorder_frozen] == p_frozen);
+    TEST_ASSERT(flight_recorder_live != p_frozen && flight_recorder_live->boot_cnt == 3U);
+    TEST_ASSERT(flight_recorder_live->head == 1U && p_frozen->head == 11U);
+
+    //未回绕的短记录, 单条发送
+    busy_percent = 0U;
+    TEST_ASSERT(dump_all(16, 0U) == 1);
+    TEST_ASSERT(flight_recorder_dump(dump_write, 16) == -1);
+    count = decode_dump(&head, &p_record);
+    TEST_ASSERT(count == 11 && head.boot_cnt == 1U && head.end_reset_flags == RESET_IWDG);
+    TEST_ASSERT(p_record[0].type == FLIGHT_RECORD_BOOT && p_record[0].v2 == 1U);
+    TEST_ASSERT(p_record[10].type == FLIGHT_RECORD_DETECT && p_record[10].v1 == 9U);
+    dump_to_file("ab");
+}
+
+static void test_clear(void) {
+    //清除命令丢弃冻结的记录区, 下一次复位冻结本次运行
+    flight_recorder_log(FLIGHT_RECORD_DETECT, 0, 0, 0, 0);
+    warm_reset(RESET_SFT_PIN);
+    TEST_ASSERT(flight_recorder_dump_pending());
+    flight_recorder_clear();
+    TEST_ASSERT(!flight_recorder_dump_pending() && flight_recorder_dump(dump_write, 64) == -1);
+    flight_recorder_bank_t *p_live = flight_recorder_live;
+    warm_reset(RESET_SFT_PIN);
+    TEST_ASSERT(flight_recorder_dump_pending() && &flight_recorder_bank[flight_recorder_frozen] == p_live);
+    TEST_ASSERT(p_live->head == 1U && flight_recorder_live->boot_cnt == p_live->boot_cnt + 1U);
+    flight_recorder_clear();
+}
+
+static void test_invalid_header(void) {
+    //头部损坏时不冻结, 从0开始新的记录
+    memset(flight_recorder_bank, 0, sizeof(flight_recorder_bank));
+    warm_reset(RESET_POR_PIN);
+    flight_recorder_log(FLIGHT_RECORD_DETECT, 0, 0, 0, 0);
+    flight_recorder_live->boot_cnt ^= 0x10U;
+    warm_reset(RESET_POR_PIN);
+    TEST_ASSERT(!flight_recorder_dump_pending() && flight_recorder_state == FLIGHT_RECORDER_RUNNING);
+    TEST_ASSERT(flight_recorder_live->boot_cnt == 0U && flight_recorder_live->head == 1U);
+    TEST_ASSERT(flight_recorder_dump(dump_write, 64) == -1);
+}
+
+static void test_log_cost(void) {
+    warm_reset(RESET_POR_PIN);
+    const uint32_t rounds = 2000000U;
+    uint64_t start = unit_test_now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        flight_recorder_log(FLIGHT_RECORD_MOTOR, (uint8_t) (i & 3U), (int16_t) i, i, i);
+    }
+    uint64_t ns = unit_test_now_ns() - start;
+    TEST_ASSERT(flight_recorder_live->head == rounds + 1U);
+    printf("flight_recorder_log: %.1f ns per record on the host\n", (double) ns / rounds);
+}
+
+int main(void) {
+    RUN_TEST(test_record_codec);
+    RUN_TEST(test_wraparound_and_dump);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_invalid_header);
+    RUN_TEST(test_log_cost);
+    return unit_test_result();
+}
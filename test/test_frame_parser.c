@@ -0,0 +1,219 @@
+/**
+  * @file       test_frame_parser.c
+  * @brief      frame_parser on the referee layout: a dispatch table check, and a
+  *             fuzz run where valid, corrupted and noise frames arrive in random
+  *             chunks through a small fifo, every valid frame must be dispatched
+  *             exactly once and in order. Also the header-only layout of the
+  *             vision link, and the parsing throughput.
+  *             裁判系统帧格式下的frame_parser: 分发表检查, 以及有效帧、损坏帧和噪声以随机分块经小队列到达的模糊测试,
+  *             每个有效帧必须按顺序恰好分发一次. 另外测试视觉链路的无CRC8帧头格式和解析吞吐
+  */
+#include "unit_test.h"
+#include "frame_parser.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+#define MAX_FRAME       128
+#define EXPECT_NUM      256
+
+//裁判系统: SOF(1) + data_length(2) + seq(1) + CRC8(1) + cmd_id(2) + data + CRC16(2)
+static const frame_protocol_t referee_layout = {0xA5, 5, 1, 2, 1, 2, MAX_FRAME};
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+//待核对的有效帧
+static uint8_t expect_frame[EXPECT_NUM][MAX_FRAME];
+static uint16_t expect_len[EXPECT_NUM];
+static uint32_t expect_head, expect_tail, mismatch;
+
+static void check_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    (void) cmd_id;
+    uint32_t i = expect_tail % EXPECT_NUM;
+    if (expect_tail == expect_head || expect_len[i] != frame_len || memcmp(expect_frame[i], p_frame, frame_len) != 0) {
+        mismatch++;
+        return;
+    }
+    expect_tail++;
+}
+
+static uint16_t make_frame(uint8_t *p_frame, uint16_t cmd_id, uint16_t data_len, uint8_t seq) {
+    p_frame[0] = 0xA5;
+    p_frame[1] = (uint8_t) data_len;
+    p_frame[2] = (uint8_t) (data_len >> 8);
+    p_frame[3] = seq;
+    append_CRC8_check_sum(p_frame, 5);
+    p_frame[5] = (uint8_t) cmd_id;
+    p_frame[6] = (uint8_t) (cmd_id >> 8);
+    for (uint16_t i = 0; i < data_len; i++) {
+        //负载中也会出现SOF
+        p_frame[7 + i] = rnd(8) == 0 ? 0xA5 : (uint8_t) rnd(256);
+    }
+    append_CRC16_check_sum(p_frame, 9 + data_len);
+    return (uint16_t) (9 + data_len);
+}
+
+static void test_dispatch_table(void) {
+    static uint8_t buf[256], frame_buf[MAX_FRAME];
+    static uint8_t dest[4];
+    static volatile bool flag;
+    spsc_fifo_t fifo;
+    frame_parser_t parser;
+    const frame_cmd_t table[] = {
+            {0x0201, sizeof(dest), dest, &flag, NULL},
+            {0x0202, 0, NULL, NULL, check_frame},
+    };
+    spsc_fifo_init(&fifo, buf, sizeof(buf));
+    frame_parser_init(&parser, &referee_layout, table, 2, NULL, frame_buf);
+
+    uint8_t frame[MAX_FRAME];
+    //数据段长于注册长度时只拷贝注册长度
+    uint16_t len = make_frame(frame, 0x0201, 6, 0);
+    spsc_fifo_puts(&fifo, frame, len);
+    TEST_ASSERT(frame_parser_unpack_fifo(&parser, &fifo) == 1);
+    TEST_ASSERT(flag && memcmp(dest, &frame[7], sizeof(dest)) == 0);
+
+    expect_head = expect_tail = mismatch = 0;
+    len = make_frame(expect_frame[0], 0x0202, 3, 1);
+    expect_len[0] = len;
+    expect_head = 1;
+    spsc_fifo_puts(&fifo, expect_frame[0], len);
+    len = make_frame(frame, 0x0301, 2, 2);
+    spsc_fifo_puts(&fifo, frame, len);
+    TEST_ASSERT(frame_parser_unpack_fifo(&parser, &fifo) == 2);
+    TEST_ASSERT(expect_tail == 1 && mismatch == 0);
+    TEST_ASSERT(parser.frame_cnt == 3 && parser.unknown_cmd_cnt == 1 && parser.err_cnt == 0);
+
+    //超过最大帧长的长度字段
+    uint8_t header[5] = {0xA5, MAX_FRAME, 0, 3};
+    append_CRC8_check_sum(header, sizeof(header));
+    spsc_fifo_puts(&fifo, header, sizeof(header));
+    TEST_ASSERT(frame_parser_unpack_fifo(&parser, &fifo) == 0);
+    TEST_ASSERT(parser.err_cnt == 1 && spsc_fifo_used(&fifo) == 0);
+}
+
+static void test_fuzz_chunked_stream(void) {
+    static uint8_t buf[512], frame_buf[MAX_FRAME];
+    spsc_fifo_t fifo;
+    frame_parser_t parser;
+    spsc_fifo_init(&fifo, buf, sizeof(buf));
+    frame_parser_init(&parser, &referee_layout, NULL, 0, check_frame, frame_buf);
+    expect_head = expect_tail = mismatch = 0;
+
+    uint32_t sent_ok = 0, corrupted = 0;
+    uint8_t stream[MAX_FRAME + 64];
+    for (uint32_t it = 0; it < 100000U; it++) {
+        uint32_t len = 0;
+        uint32_t mode = rnd(10);
+        //噪声
+        if (mode == 1) {
+            uint32_t n = rnd(24);
+            for (uint32_t i = 0; i < n; i++) {
+                stream[len++] = rnd(4) == 0 ? 0xA5 : (uint8_t) rnd(256);
+            }
+        }
+        uint8_t *p_frame = &stream[len];
+        uint16_t frame_len = make_frame(p_frame, (uint16_t) rnd(0x400), (uint16_t) rnd(MAX_FRAME - 9 + 1), (uint8_t) it);
+        len += frame_len;
+        if (mode == 0) {
+            //单字节损坏, CRC必然能发现
+            p_frame[rnd(frame_len)] ^= (uint8_t) (1 + rnd(255));
+            corrupted++;
+        } else {
+            uint32_t i = expect_head % EXPECT_NUM;
+            memcpy(expect_frame[i], p_frame, frame_len);
+            expect_len[i] = frame_len;
+            expect_head++;
+            sent_ok++;
+        }
+
+        uint32_t k = 0;
+        while (k < len) {
+            uint32_t chunk = 1 + rnd(40);
+            if (chunk > len - k) {
+                chunk = len - k;
+            }
+            uint32_t written = spsc_fifo_puts(&fifo, stream + k, chunk);
+            k += written;
+            if (written < chunk || rnd(3) == 0) {
+                frame_parser_unpack_fifo(&parser, &fifo);
+            }
+        }
+    }
+    //用非SOF的填充字节冲出队列尾部等待中的假帧头
+    uint8_t pad[MAX_FRAME];
+    memset(pad, 0, sizeof(pad));
+    spsc_fifo_puts(&fifo, pad, sizeof(pad));
+    frame_parser_unpack_fifo(&parser, &fifo);
+
+    TEST_ASSERT(mismatch == 0);
+    TEST_ASSERT(expect_tail == expect_head);
+    TEST_ASSERT(parser.frame_cnt == sent_ok);
+    TEST_ASSERT(parser.err_cnt >= corrupted);
+    printf("%u frames ok, %u corrupted, %u rejected headers/frames, %u bytes skipped\n", sent_ok, corrupted,
+           parser.err_cnt, parser.skip_byte_cnt);
+}
+
+static void test_vision_layout(void) {
+    //视觉: SOF(1) + data_len(1) + data + CRC16(2), 帧头无CRC8, 无命令码
+    static const frame_protocol_t vision_layout = {0x24, 2, 1, 1, 0, 0, 64};
+    static uint8_t buf[64], frame_buf[64];
+    static uint8_t dest[8];
+    static volatile bool flag;
+    const frame_cmd_t table[] = {{0, sizeof(dest), dest, &flag, NULL}};
+    spsc_fifo_t fifo;
+    frame_parser_t parser;
+    spsc_fifo_init(&fifo, buf, sizeof(buf));
+    frame_parser_init(&parser, &vision_layout, table, 1, NULL, frame_buf);
+
+    uint8_t frame[12] = {0x24, 8, 1, 2, 3, 4, 5, 6, 7, 8};
+    append_CRC16_check_sum(frame, sizeof(frame));
+    //长度非法的假帧头在前, 多轮后帧跨越缓存末尾
+    for (int round = 0; round < 10; round++) {
+        flag = false;
+        memset(dest, 0, sizeof(dest));
+        spsc_fifo_puts(&fifo, (uint8_t *) "\x24\x7F", 2);
+        spsc_fifo_puts(&fifo, frame, sizeof(frame));
+        frame_parser_unpack_fifo(&parser, &fifo);
+        TEST_ASSERT(flag && memcmp(dest, &frame[2], sizeof(dest)) == 0);
+    }
+    TEST_ASSERT(parser.frame_cnt == 10 && spsc_fifo_used(&fifo) == 0);
+}
+
+static void test_throughput(void) {
+    static uint8_t buf[4096], frame_buf[MAX_FRAME];
+    static uint8_t dest[64];
+    const frame_cmd_t table[] = {{0x0201, sizeof(dest), dest, NULL, NULL}};
+    spsc_fifo_t fifo;
+    frame_parser_t parser;
+    spsc_fifo_init(&fifo, buf, sizeof(buf));
+    frame_parser_init(&parser, &referee_layout, table, 1, NULL, frame_buf);
+
+    uint8_t frame[MAX_FRAME];
+    uint16_t len = make_frame(frame, 0x0201, 27, 0);
+    const uint32_t rounds = 200000U;
+    uint64_t start = unit_test_now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        spsc_fifo_puts(&fifo, frame, len);
+        if ((i & 31U) == 31U) {
+            frame_parser_unpack_fifo(&parser, &fifo);
+        }
+    }
+    frame_parser_unpack_fifo(&parser, &fifo);
+    uint64_t ns = unit_test_now_ns() - start;
+    TEST_ASSERT(parser.frame_cnt == rounds && parser.err_cnt == 0);
+    printf("%u byte frames: %.1f ns/frame, %.1f MB/s\n", len, (double) ns / rounds,
+           (double) len * rounds * 1000.0 / (double) ns);
+}
+
+int main(void) {
+    RUN_TEST(test_dispatch_table);
+    RUN_TEST(test_fuzz_chunked_stream);
+    RUN_TEST(test_vision_layout);
+    RUN_TEST(test_throughput);
+    return unit_test_result();
+}
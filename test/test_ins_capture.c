@@ -0,0 +1,391 @@
+/**
+  * @file       test_ins_capture.c
+  * @brief      the INS capture link of matlab_sync_task with INS_CAPTURE on:
+  *             sample and calibration frames are checked byte by byte (header,
+  *             length, type, CRC16 over type and payload), the calibration is
+  *             resent every INS_CAPTURE_CALI_PERIOD_MS, and when the uart_tx
+  *             frame pool runs out the samples stay in mag_data_tx_fifo in
+  *             order. A synthetic capture of a board mounted on its side,
+  *             turning at a known yaw rate, is then written for ins_replay.py,
+  *             with one sample missing, one corrupted frame and a DWT wrap.
+  *             A second capture has a jittered data-ready period and a varying
+  *             yaw rate, for comparing the fixed and data-ready fusion steps.
+  *             INS_CAPTURE为ON时matlab_sync_task的录制链路: 逐字节检查样本帧和校准帧(帧头、长度、类型、
+  *             覆盖类型和数据的CRC16), 每INS_CAPTURE_CALI_PERIOD_MS重发校准参数, uart_tx帧缓存耗尽时
+  *             样本按顺序留在mag_data_tx_fifo中.然后写出一段侧装板子以已知角速度转动的合成录制供ins_replay.py
+  *             回放, 其中缺一个样本、有一帧损坏并经过DWT回绕.第二段录制的数据就绪周期有抖动、角速度变化,
+  *             用于比较固定融合步长和数据就绪时刻步长的姿态误差
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "global_control_define.h"
+//测试录制链路, 与固件的开关组合无关
+#undef INS_CAPTURE
+#define INS_CAPTURE ON
+#undef UART1_TARGET_MODE
+#define UART1_TARGET_MODE Matlab_MODE
+#undef UART1_BAUD_RATE
+#define UART1_BAUD_RATE 921600U
+//直接包含源文件, 测试中代替matlab_sync_task和串口1
+#include "../User/Application/matlab_sync_task.c"
+#include <string.h>
+
+#define TICK_HZ         168000000U
+#define STEP_US         9000U
+#define STEP_NUM        2000U
+#define YAW_RATE        0.1         //rad/s
+#define GRAVITY         9.8f
+#define MISSING_STEP    1200U       //INS_task丢弃的样本
+#define CORRUPT_STEP    700U        //传输中损坏的样本
+#define JITTER_MEAN_US  9600U       //INS_task实际周期与名义步长不同
+#define JITTER_US       3000U       //数据就绪时刻在均值上下抖动的范围
+#define JITTER_LATE_US  20000U      //偶尔晚到的样本
+#define JITTER_LATE_STEP 97U
+#define SAMPLE_FRAME_LEN    (sizeof(INS_capture_sample_t) + 5U)
+#define CALI_FRAME_LEN      (sizeof(INS_capture_cali_t) + 5U)
+
+fifo_s_t mag_data_tx_fifo;
+uint8_t mag_data_tx_buf[MAG_FIFO_BUF_LENGTH];
+IMU_MAG_Cali_t gyro_cali_data;
+IMU_MAG_Cali_t accel_cali_data;
+IMU_MAG_Cali_t mag_cali_data;
+uart_tx_port_t usart1_tx_port;
+task_time_record_t global_task_time;
+
+//模拟串口1 DMA, 线上的字节写入wire
+static const uint8_t *dma_p;
+static uint16_t dma_len;
+static bool dma_busy;
+static uint8_t wire[STEP_NUM * SAMPLE_FRAME_LEN + 64U * CALI_FRAME_LEN];
+static uint32_t wire_len;
+static uint32_t corrupt_tick;
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return TICK_HZ;
+}
+
+void DWT_get_time_interval_us(time_record_struct *task_time) {
+    (void) task_time;
+}
+
+void usart1_tx_init(void) {
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return NULL;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    (void) xClearCountOnExit;
+    (void) xTicksToWait;
+    return pdPASS;
+}
+
+static void dma_start(const uint8_t *p_data, uint16_t len) {
+    dma_busy = true;
+    dma_p = p_data;
+    dma_len = len;
+}
+
+static void dma_abort(void) {
+    dma_busy = false;
+}
+
+static uint32_t get_tick(void) {
+    return host_tick;
+}
+
+//DMA发送完一帧, 选中的样本帧在线上损坏一个字节
+static void dma_finish(void) {
+    uint32_t tick;
+
+    if (wire_len + dma_len <= sizeof(wire)) {
+        memcpy(&wire[wire_len], dma_p, dma_len);
+        if (corrupt_tick != 0U && dma_len == SAMPLE_FRAME_LEN && dma_p[2] == INS_CAPTURE_FRAME_SAMPLE) {
+            memcpy(&tick, &dma_p[3], sizeof(tick));
+            if (tick == corrupt_tick) {
+                wire[wire_len + 10U] ^= 0x5AU;
+            }
+        }
+        wire_len += dma_len;
+    }
+    dma_busy = false;
+    uart_tx_complete_irq(&usart1_tx_port);
+}
+
+static void dma_drain(void) {
+    while (dma_busy) {
+        dma_finish();
+    }
+}
+
+static void link_reset(void) {
+    fifo_s_init(&mag_data_tx_fifo, mag_data_tx_buf, MAG_FIFO_BUF_LENGTH);
+    uart_tx_init(&usart1_tx_port, dma_start, dma_abort, get_tick);
+    dma_busy = false;
+    wire_len = 0U;
+    corrupt_tick = 0U;
+}
+
+static void cali_set(IMU_MAG_Cali_t *p_cali, const float32_t rotation[3][3], float32_t scale) {
+    memset(p_cali, 0, sizeof(IMU_MAG_Cali_t));
+    memcpy(p_cali->rotation_factor, rotation, sizeof(p_cali->rotation_factor));
+    for (int i = 0; i < 3; i++) {
+        p_cali->scale[i] = scale;
+        p_cali->offset[i] = 0.01f * (float32_t) (i + 1);
+    }
+}
+
+//第step步的样本: 板子侧装, 原始x轴朝上, 绕竖直轴以YAW_RATE转动, 陀螺仪比例系数为2
+static void sample_make(INS_capture_sample_t *p_sample, uint32_t tick0, uint32_t step) {
+    double t = (double) step * STEP_US * 1e-6;
+    double yaw = fmod(YAW_RATE * t + M_PI, 2.0 * M_PI) - M_PI;
+
+    memset(p_sample, 0, sizeof(INS_capture_sample_t));
+    p_sample->gyro_tick = tick0 + step * (STEP_US * (TICK_HZ / 1000000U));
+    p_sample->accel_tick = p_sample->gyro_tick - 100U;
+    p_sample->mag_tick = p_sample->gyro_tick - 2000U;
+    p_sample->gyro[0] = (float32_t) (YAW_RATE / 2.0);
+    p_sample->accel[0] = GRAVITY;
+    p_sample->mag[1] = 30.0f;
+    p_sample->temp = 40.0f;
+    p_sample->angle[0] = (float32_t) yaw;
+}
+
+//逐帧检查线上数据, 返回样本帧数, 样本依次写入p_samples
+static uint32_t wire_parse(INS_capture_sample_t *p_samples, uint32_t max, uint32_t *p_cali_cnt) {
+    uint32_t pos = 0U;
+    uint32_t n = 0U;
+
+    *p_cali_cnt = 0U;
+    while (pos < wire_len) {
+        const uint8_t *p = &wire[pos];
+        TEST_ASSERT(p[0] == '$');
+        if (p[0] != '$' || wire_len - pos < 5U || wire_len - pos < p[1] + 4U) {
+            return n;
+        }
+        TEST_ASSERT(verify_CRC16_check_sum((uint8_t *) &p[2], p[1] + 2U));
+        if (p[2] == INS_CAPTURE_FRAME_SAMPLE) {
+            TEST_ASSERT(p[1] == sizeof(INS_capture_sample_t) + 1U);
+            if (n < max) {
+                memcpy(&p_samples[n], &p[3], sizeof(INS_capture_sample_t));
+            }
+            n++;
+        } else {
+            TEST_ASSERT(p[2] == INS_CAPTURE_FRAME_CALI);
+            TEST_ASSERT(p[1] == sizeof(INS_capture_cali_t) + 1U);
+            INS_capture_cali_t cali;
+            memcpy(&cali, &p[3], sizeof(cali));
+            TEST_ASSERT(cali.id == *p_cali_cnt % 3U && cali.tick_hz == TICK_HZ);
+            const IMU_MAG_Cali_t *p_expect[3] = {&gyro_cali_data, &accel_cali_data, &mag_cali_data};
+            TEST_ASSERT(memcmp(&cali.cali, p_expect[cali.id % 3U], sizeof(IMU_MAG_Cali_t)) == 0);
+            (*p_cali_cnt)++;
+        }
+        pos += p[1] + 4U;
+    }
+    return n;
+}
+
+static void test_layout(void) {
+    //上位机按 '<III3f3f3ff3f' 和 '<BI9f3f3f' 解码
+    TEST_ASSERT(sizeof(INS_capture_sample_t) == 64U);
+    TEST_ASSERT(sizeof(INS_capture_cali_t) == 65U);
+    TEST_ASSERT(SAMPLE_FRAME_LEN <= UART_TX_FRAME_SIZE && CALI_FRAME_LEN <= sizeof(matlab_transmit_pack));
+}
+
+static void test_frames_and_cali_period(void) {
+    static const float32_t identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    INS_capture_sample_t sample, got[4];
+    uint32_t cali_cnt;
+
+    link_reset();
+    cali_set(&gyro_cali_data, identity, 1.0f);
+    cali_set(&accel_cali_data, identity, 1.01f);
+    cali_set(&mag_cali_data, identity, 0.5f);
+    for (uint32_t i = 0; i < 4U; i++) {
+        sample_make(&sample, 0x1000U, i);
+        fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample));
+    }
+    INS_capture_sync();
+    dma_drain();
+    //首次调用先发三帧校准参数, 然后每个样本一帧
+    TEST_ASSERT(wire_len == 3U * CALI_FRAME_LEN + 4U * SAMPLE_FRAME_LEN);
+    TEST_ASSERT(wire_parse(got, 4U, &cali_cnt) == 4U && cali_cnt == 3U);
+    for (uint32_t i = 0; i < 4U; i++) {
+        sample_make(&sample, 0x1000U, i);
+        TEST_ASSERT(memcmp(&got[i], &sample, sizeof(sample)) == 0);
+    }
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == 0);
+
+    //校准参数按周期重发, 不足一个样本时不发送
+    wire_len = 0U;
+    fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample) - 1U);
+    host_tick += INS_CAPTURE_CALI_PERIOD_MS - 1U;
+    INS_capture_sync();
+    dma_drain();
+    TEST_ASSERT(wire_len == 0U);
+    host_tick += 1U;
+    INS_capture_sync();
+    dma_drain();
+    TEST_ASSERT(wire_parse(got, 4U, &cali_cnt) == 0U && cali_cnt == 3U);
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == (int) sizeof(sample) - 1);
+}
+
+static void test_pool_exhaustion_keeps_samples(void) {
+    enum { FIFO_SAMPLES = MAG_FIFO_BUF_LENGTH / sizeof(INS_capture_sample_t) };
+    INS_capture_sample_t sample, got[FIFO_SAMPLES];
+    uint32_t cali_cnt;
+
+    link_reset();
+    //先发出到期的校准参数
+    INS_capture_sync();
+    dma_drain();
+    wire_len = 0U;
+    for (uint32_t i = 0; i < FIFO_SAMPLES; i++) {
+        sample_make(&sample, 0x2000U, i);
+        TEST_ASSERT(fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample)) == (int) sizeof(sample));
+    }
+    TEST_ASSERT(fifo_s_free(&mag_data_tx_fifo) < (int) sizeof(sample));
+
+    //DMA不完成时只能发出帧缓存数量的样本, 其余留在fifo中
+    INS_capture_sync();
+    uint32_t queued = uart_tx_pending(&usart1_tx_port) + (dma_busy ? 1U : 0U);
+    TEST_ASSERT(queued == UART_TX_FRAME_NUM);
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == (int) ((FIFO_SAMPLES - UART_TX_FRAME_NUM) * sizeof(sample)));
+    //uart_tx记一次分配失败, 但样本没有从fifo中取出
+    TEST_ASSERT(usart1_tx_port.drop_full_cnt == 1U);
+
+    dma_drain();
+    INS_capture_sync();
+    dma_drain();
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == 0);
+    TEST_ASSERT(wire_parse(got, FIFO_SAMPLES, &cali_cnt) == FIFO_SAMPLES);
+    for (uint32_t i = 0; i < FIFO_SAMPLES; i++) {
+        sample_make(&sample, 0x2000U, i);
+        TEST_ASSERT(memcmp(&got[i], &sample, sizeof(sample)) == 0);
+    }
+    TEST_ASSERT(host_primask == 0U);
+}
+
+//侧装板子的合成录制: 原始x轴朝上, 旋转矩阵把它转到z轴, 回放必须使用录制的校准参数才能跟上航向
+static void test_write_capture(void) {
+    static const float32_t side[3][3] = {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}};
+    static const float32_t identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    //DWT在录制中回绕
+    const uint32_t tick0 = 0xFFFFFFFFU - (STEP_NUM / 2U) * STEP_US * (TICK_HZ / 1000000U);
+    //录制开始时校准参数到期
+    const uint32_t ms0 = host_tick + INS_CAPTURE_CALI_PERIOD_MS;
+    INS_capture_sample_t sample;
+
+    link_reset();
+    host_tick = ms0;
+    cali_set(&gyro_cali_data, side, 2.0f);
+    cali_set(&accel_cali_data, side, 1.0f);
+    cali_set(&mag_cali_data, identity, 1.0f);
+    sample_make(&sample, tick0, CORRUPT_STEP);
+    corrupt_tick = sample.gyro_tick;
+    for (uint32_t step = 0; step < STEP_NUM; step++) {
+        if (step != MISSING_STEP) {
+            sample_make(&sample, tick0, step);
+            TEST_ASSERT(fifo_s_free(&mag_data_tx_fifo) >= (int) sizeof(sample));
+            fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample));
+        }
+        //上位机每4步发送一次'$'
+        if (step % 4U == 3U) {
+            INS_capture_sync();
+            dma_drain();
+        }
+        host_tick = ms0 + step * STEP_US / 1000U;
+    }
+    INS_capture_sync();
+    dma_drain();
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == 0);
+
+    FILE *f = fopen(INS_CAPTURE_FILE, "wb");
+    TEST_ASSERT(f != NULL);
+    if (f != NULL) {
+        TEST_ASSERT(fwrite(wire, 1, wire_len, f) == wire_len);
+        fclose(f);
+    }
+    printf("capture: %u bytes, %u samples written\n", (unsigned) wire_len, STEP_NUM - 1U);
+}
+
+//航向角速度 1+0.5sin(0.7t) rad/s, 真值为其积分
+static double jitter_rate(double t) {
+    return 1.0 + 0.5 * sin(0.7 * t);
+}
+
+static double jitter_yaw(double t) {
+    double yaw = t + 0.5 / 0.7 * (1.0 - cos(0.7 * t));
+    return fmod(yaw + M_PI, 2.0 * M_PI) - M_PI;
+}
+
+//水平安装的板子, 数据就绪间隔在JITTER_MEAN_US上下随机抖动, 偶尔晚到JITTER_LATE_US,
+//样本里的陀螺仪是就绪时刻的角速度, 固件输出为真值, 回放的误差只来自融合步长
+static void test_write_jitter_capture(void) {
+    static const float32_t identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    const uint32_t us_tick = TICK_HZ / 1000000U;
+    const uint32_t ms0 = host_tick + INS_CAPTURE_CALI_PERIOD_MS;
+    //DWT在录制中回绕
+    uint32_t tick = 0xFFFFFFFFU - (STEP_NUM / 2U) * JITTER_MEAN_US * us_tick;
+    uint32_t lcg_state = 12345U;
+    uint32_t us = 0U;
+    INS_capture_sample_t sample;
+
+    link_reset();
+    host_tick = ms0;
+    cali_set(&gyro_cali_data, identity, 1.0f);
+    cali_set(&accel_cali_data, identity, 1.0f);
+    cali_set(&mag_cali_data, identity, 1.0f);
+    for (uint32_t step = 0; step < STEP_NUM; step++) {
+        double t = (double) us * 1e-6;
+
+        memset(&sample, 0, sizeof(sample));
+        sample.gyro_tick = tick;
+        sample.accel_tick = tick - 100U;
+        sample.mag_tick = tick - 2000U;
+        sample.gyro[2] = (float32_t) jitter_rate(t);
+        sample.accel[2] = GRAVITY;
+        sample.mag[0] = 30.0f;
+        sample.temp = 40.0f;
+        sample.angle[0] = (float32_t) jitter_yaw(t);
+        TEST_ASSERT(fifo_s_free(&mag_data_tx_fifo) >= (int) sizeof(sample));
+        fifo_s_puts(&mag_data_tx_fifo, (char *) &sample, sizeof(sample));
+        if (step % 4U == 3U) {
+            INS_capture_sync();
+            dma_drain();
+        }
+
+        uint32_t interval_us = JITTER_MEAN_US - JITTER_US;
+        lcg_state = lcg_state * 1103515245U + 12345U;
+        interval_us += (lcg_state >> 8) % (2U * JITTER_US + 1U);
+        if (step % JITTER_LATE_STEP == JITTER_LATE_STEP - 1U) {
+            interval_us = JITTER_LATE_US;
+        }
+        us += interval_us;
+        tick += interval_us * us_tick;
+        host_tick = ms0 + us / 1000U;
+    }
+    INS_capture_sync();
+    dma_drain();
+    TEST_ASSERT(fifo_s_used(&mag_data_tx_fifo) == 0);
+
+    FILE *f = fopen(INS_JITTER_CAPTURE_FILE, "wb");
+    TEST_ASSERT(f != NULL);
+    if (f != NULL) {
+        TEST_ASSERT(fwrite(wire, 1, wire_len, f) == wire_len);
+        fclose(f);
+    }
+    printf("jitter capture: %u bytes, %u samples, %.1f s\n", (unsigned) wire_len, STEP_NUM, (double) us * 1e-6);
+}
+
+int main(void) {
+    host_tick = 1000U;
+    RUN_TEST(test_layout);
+    RUN_TEST(test_frames_and_cali_period);
+    RUN_TEST(test_pool_exhaustion_keeps_samples);
+    RUN_TEST(test_write_capture);
+    RUN_TEST(test_write_jitter_capture);
+    return unit_test_result();
+}
@@ -0,0 +1,68 @@
+/**
+  * @file       test_kalman_filter.c
+  * @brief      first order kalman on a noisy constant, second order kalman
+  *             tracking a constant speed target without heap use per step.
+  *             一阶卡尔曼滤波带噪声的常数, 二阶卡尔曼跟踪匀速目标且每次计算不申请堆内存
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "kalman_filter.h"
+
+static uint32_t lcg_state = 12345U;
+
+//[-1, 1)的伪随机数, 结果可重复
+static float32_t noise(void) {
+    lcg_state = lcg_state * 1664525U + 1013904223U;
+    return (float32_t) (lcg_state >> 8) / 8388608.0f - 1.0f;
+}
+
+static void test_first_order_converges(void) {
+    extKalman_t kf;
+    KalmanCreate(&kf, 1e-4f, 0.5f);
+    float32_t out = 0.0f, sum_in = 0.0f, sum_out = 0.0f;
+    for (int i = 0; i < 2000; i++) {
+        float32_t in = 3.0f + 0.5f * noise();
+        out = KalmanFilter(&kf, in);
+        if (i >= 1000) {
+            sum_in += (in - 3.0f) * (in - 3.0f);
+            sum_out += (out - 3.0f) * (out - 3.0f);
+        }
+    }
+    TEST_ASSERT_NEAR(3.0f, out, 0.05f);
+    //稳态时输出方差远小于输入
+    TEST_ASSERT(sum_out < 0.05f * sum_in);
+    TEST_ASSERT(kf.P_now > 0.0f && kf.kg > 0.0f && kf.kg < 1.0f);
+}
+
+static void test_second_order_tracks(void) {
+    const float32_t dt = 0.01f;
+    kalman_filter_t filter;
+    kalman_filter_init_t init = {
+            .xhat_data = {0.0f, 0.0f},
+            .P_data = {1.0f, 0.0f, 0.0f, 1.0f},
+            .A_data = {1.0f, dt, 0.0f, 1.0f},
+            .H_data = {1.0f, 0.0f, 0.0f, 1.0f},
+            //计算中用Q-KH代替I-KH, Q须为单位阵
+            .Q_data = {1.0f, 0.0f, 0.0f, 1.0f},
+            .R_data = {200.0f, 0.0f, 0.0f, 400.0f},
+    };
+    //与固件中的全局变量一样从全零开始, AT和HT由转置生成
+    memset(&filter, 0, sizeof(filter));
+    second_order_kalman_filter_init(&filter, &init);
+
+    uint32_t malloc_before = host_malloc_count;
+    float32_t *out = NULL;
+    for (int i = 0; i < 3000; i++) {
+        float32_t t = (float32_t) i * dt;
+        out = second_order_kalman_filter_calc(&filter, 5.0f + 2.0f * t + 0.2f * noise(), 2.0f + 0.5f * noise());
+    }
+    TEST_ASSERT(host_malloc_count == malloc_before);
+    TEST_ASSERT_NEAR(5.0f + 2.0f * 2999 * dt, out[0], 0.2f);
+    TEST_ASSERT_NEAR(2.0f, out[1], 0.2f);
+}
+
+int main(void) {
+    RUN_TEST(test_first_order_converges);
+    RUN_TEST(test_second_order_tracks);
+    return unit_test_result();
+}
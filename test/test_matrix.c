@@ -0,0 +1,192 @@
+/**
+  * @file       test_matrix.c
+  * @brief      heap backed matrix operations against hand computed values and
+  *             their reconstructions: multiply, transpose, inverse, cholesky,
+  *             QR and back substitution, every allocation released again.
+  *             堆矩阵运算与手算值和重构结果比较: 乘法、转置、求逆、cholesky、QR和回代, 所有分配都被释放
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "matrix.h"
+#include <string.h>
+
+//对称正定矩阵
+static float32_t spd_data[9] = {4.0f, 1.0f, 0.5f,
+                                1.0f, 3.0f, 0.2f,
+                                0.5f, 0.2f, 2.0f};
+
+//分解用的暂存区由调用者提供
+static matrix_buffer_f32_t scratch[MATRIX_QR_SCRATCH_NUM];
+
+static float32_t max_diff_f32(matrix_f32_t *a, matrix_f32_t *b) {
+    float32_t diff = 0.0f;
+    for (int i = 0; i < a->arm_matrix.numRows; i++) {
+        for (int j = 0; j < a->arm_matrix.numCols; j++) {
+            diff = fmaxf(diff, fabsf(a->p2Data[i][j] - b->p2Data[i][j]));
+        }
+    }
+    return diff;
+}
+
+static void test_mult_transpose(void) {
+    float32_t a_data[6] = {1, 2, 3,
+                           4, 5, 6};
+    float32_t b_data[6] = {7, 8,
+                           9, 10,
+                           11, 12};
+    matrix_f32_t a, b, c, t;
+    Matrix_data_creat_f32(&a, 2, 3, a_data, NoInitMatZero);
+    Matrix_data_creat_f32(&b, 3, 2, b_data, NoInitMatZero);
+    Matrix_vinit_f32(&c);
+    Matrix_vinit_f32(&t);
+
+    Matrix_vmult_nsame_f32(&a, &b, &c);
+    TEST_ASSERT(c.arm_matrix.numRows == 2 && c.arm_matrix.numCols == 2);
+    TEST_ASSERT(c.p2Data[0][0] == 58.0f && c.p2Data[0][1] == 64.0f);
+    TEST_ASSERT(c.p2Data[1][0] == 139.0f && c.p2Data[1][1] == 154.0f);
+
+    Matrix_vTranspose_nsame_f32(&a, &t);
+    TEST_ASSERT(t.arm_matrix.numRows == 3 && t.p2Data[2][1] == 6.0f && t.p2Data[1][0] == 2.0f);
+
+    //维度不匹配时结果无效
+    Matrix_vmult_nsame_f32(&a, &a, &c);
+    TEST_ASSERT(!Matrix_bMatrixIsValid_f32(&c));
+
+    Matrix_vSetMatrixInvalid_f32(&a);
+    Matrix_vSetMatrixInvalid_f32(&b);
+    Matrix_vSetMatrixInvalid_f32(&c);
+    Matrix_vSetMatrixInvalid_f32(&t);
+}
+
+static void test_inverse(void) {
+    matrix_f32_t a, inv, prod, eye;
+    Matrix_data_creat_f32(&a, 3, 3, spd_data, NoInitMatZero);
+    Matrix_nodata_creat_f32(&eye, 3, 3, InitMatWithZero);
+    Matrix_vSetIdentity_f32(&eye);
+    Matrix_vinit_f32(&inv);
+    Matrix_vinit_f32(&prod);
+
+    //求逆会改写输入, 用原数据重新生成
+    Matrix_vInverse_nsame_f32(&a, &inv);
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&inv));
+    memcpy(a.arm_matrix.pData, spd_data, sizeof(spd_data));
+    Matrix_vmult_nsame_f32(&a, &inv, &prod);
+    TEST_ASSERT(max_diff_f32(&prod, &eye) < 1e-5f);
+
+    //奇异矩阵求逆结果无效(arm_mat_inverse只在未换行时能发现奇异)
+    float32_t singular_data[4] = {2.0f, 4.0f, 1.0f, 2.0f};
+    matrix_f32_t s, s_inv;
+    Matrix_data_creat_f32(&s, 2, 2, singular_data, NoInitMatZero);
+    Matrix_vinit_f32(&s_inv);
+    Matrix_vInverse_nsame_f32(&s, &s_inv);
+    TEST_ASSERT(!Matrix_bMatrixIsValid_f32(&s_inv));
+
+    //双精度
+    float64_t a64_data[9];
+    for (int i = 0; i < 9; i++) {
+        a64_data[i] = spd_data[i];
+    }
+    matrix_f64_t a64, inv64;
+    Matrix_data_creat_f64(&a64, 3, 3, a64_data, NoInitMatZero);
+    Matrix_vinit_f64(&inv64);
+    Matrix_vInverse_nsame_f64(&a64, &inv64);
+    TEST_ASSERT_NEAR(inv.p2Data[0][0], inv64.p2Data[0][0], 1e-6);
+    TEST_ASSERT_NEAR(inv.p2Data[2][1], inv64.p2Data[2][1], 1e-6);
+
+    Matrix_vSetMatrixInvalid_f32(&a);
+    Matrix_vSetMatrixInvalid_f32(&inv);
+    Matrix_vSetMatrixInvalid_f32(&prod);
+    Matrix_vSetMatrixInvalid_f32(&eye);
+    Matrix_vSetMatrixInvalid_f32(&s);
+    Matrix_vSetMatrixInvalid_f32(&s_inv);
+    Matrix_vSetMatrixInvalid_f64(&a64);
+    Matrix_vSetMatrixInvalid_f64(&inv64);
+}
+
+static void test_cholesky(void) {
+    matrix_f32_t a, l, lt, prod;
+    Matrix_data_creat_f32(&a, 3, 3, spd_data, NoInitMatZero);
+    Matrix_vinit_f32(&l);
+    Matrix_vinit_f32(&lt);
+    Matrix_vinit_f32(&prod);
+
+    TEST_ASSERT(Matrix_bMatrixIsPositiveDefinite_f32(&a, false, &scratch[0]));
+    Matrix_vCholeskyDec_f32(&a, &l);
+    TEST_ASSERT_NEAR(2.0f, l.p2Data[0][0], 1e-6f);
+    TEST_ASSERT(l.p2Data[0][1] == 0.0f && l.p2Data[0][2] == 0.0f && l.p2Data[1][2] == 0.0f);
+    Matrix_vTranspose_nsame_f32(&l, &lt);
+    Matrix_vmult_nsame_f32(&l, &lt, &prod);
+    TEST_ASSERT(max_diff_f32(&prod, &a) < 1e-5f);
+
+    //不定矩阵
+    float32_t indefinite_data[4] = {1.0f, 2.0f, 2.0f, 1.0f};
+    matrix_f32_t b;
+    Matrix_data_creat_f32(&b, 2, 2, indefinite_data, NoInitMatZero);
+    TEST_ASSERT(!Matrix_bMatrixIsPositiveDefinite_f32(&b, false, &scratch[0]));
+
+    Matrix_vSetMatrixInvalid_f32(&a);
+    Matrix_vSetMatrixInvalid_f32(&b);
+    Matrix_vSetMatrixInvalid_f32(&l);
+    Matrix_vSetMatrixInvalid_f32(&lt);
+    Matrix_vSetMatrixInvalid_f32(&prod);
+}
+
+static void test_qr_back_substitution(void) {
+    //A = Q*R, 用Rx = Q'b解Ax = b
+    float32_t b_data[3] = {1.0f, -2.0f, 0.5f};
+    matrix_f32_t a, qt, r, q, prod, b, qtb, x, ax;
+    Matrix_data_creat_f32(&a, 3, 3, spd_data, NoInitMatZero);
+    Matrix_data_creat_f32(&b, 3, 1, b_data, NoInitMatZero);
+    Matrix_nodata_creat_f32(&qt, 3, 3, InitMatWithZero);
+    Matrix_nodata_creat_f32(&r, 3, 3, InitMatWithZero);
+    Matrix_vinit_f32(&q);
+    Matrix_vinit_f32(&prod);
+    Matrix_vinit_f32(&qtb);
+    Matrix_vinit_f32(&x);
+    Matrix_vinit_f32(&ax);
+
+    //Qt和R须预先分配, R的结果写回输入矩阵
+    TEST_ASSERT(Matrix_bQRDec_f32(&a, &qt, &r, scratch));
+    Matrix_vCopy_f32(&a, &r);
+    memcpy(a.arm_matrix.pData, spd_data, sizeof(spd_data));
+    TEST_ASSERT(fabsf(r.p2Data[1][0]) < 1e-5f && fabsf(r.p2Data[2][0]) < 1e-5f && fabsf(r.p2Data[2][1]) < 1e-5f);
+    Matrix_vTranspose_nsame_f32(&qt, &q);
+    Matrix_vmult_nsame_f32(&q, &r, &prod);
+    TEST_ASSERT(max_diff_f32(&prod, &a) < 1e-5f);
+
+    Matrix_vmult_nsame_f32(&qt, &b, &qtb);
+    Matrix_vBackSubtitution_f32(&r, &qtb, &x);
+    Matrix_vmult_nsame_f32(&a, &x, &ax);
+    TEST_ASSERT(max_diff_f32(&ax, &b) < 1e-5f);
+
+    Matrix_vSetMatrixInvalid_f32(&a);
+    Matrix_vSetMatrixInvalid_f32(&b);
+    Matrix_vSetMatrixInvalid_f32(&qt);
+    Matrix_vSetMatrixInvalid_f32(&r);
+    Matrix_vSetMatrixInvalid_f32(&q);
+    Matrix_vSetMatrixInvalid_f32(&prod);
+    Matrix_vSetMatrixInvalid_f32(&qtb);
+    Matrix_vSetMatrixInvalid_f32(&x);
+    Matrix_vSetMatrixInvalid_f32(&ax);
+}
+
+static void test_norm_vector(void) {
+    float32_t v_data[4] = {1.0f, 2.0f, 2.0f, 4.0f};
+    matrix_f32_t v;
+    Matrix_data_creat_f32(&v, 4, 1, v_data, NoInitMatZero);
+    TEST_ASSERT(Matrix_bNormVector_f32(&v));
+    TEST_ASSERT_NEAR(0.2f, v.p2Data[0][0], 1e-6f);
+    TEST_ASSERT_NEAR(0.8f, v.p2Data[3][0], 1e-6f);
+    Matrix_vSetMatrixInvalid_f32(&v);
+}
+
+int main(void) {
+    RUN_TEST(test_mult_transpose);
+    RUN_TEST(test_inverse);
+    RUN_TEST(test_cholesky);
+    RUN_TEST(test_qr_back_substitution);
+    RUN_TEST(test_norm_vector);
+    //所有申请的堆内存都已释放
+    TEST_ASSERT(host_malloc_count == host_free_count);
+    return unit_test_result();
+}
@@ -0,0 +1,292 @@
+/**
+  * @file       test_matrix_static.c
+  * @brief      matrices bound to a matrix_buffer give bitwise the same results
+  *             as heap backed ones for every operation the filters use, never
+  *             call the heap, and a UKF-sized predict/update step is timed both ways.
+  *             绑定matrix_buffer的矩阵在滤波器用到的所有运算上与堆矩阵结果逐位相同, 不调用堆, 并比较UKF规模的预测/更新耗时
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "matrix.h"
+#include <string.h>
+
+#define N   SS_X_LEN
+#define M   SS_Z_LEN
+
+static matrix_buffer_f32_t buffers[16];
+static matrix_buffer_f32_t scratch[MATRIX_QR_SCRATCH_NUM];
+
+static uint32_t lcg_state = 2024U;
+
+//静态矩阵上的运算不得调用堆
+#define NO_HEAP(call)                                           \
+    do {                                                        \
+        uint32_t _malloc_before = host_malloc_count;            \
+        call;                                                   \
+        TEST_ASSERT(host_malloc_count == _malloc_before);       \
+    } while (0)
+
+//[-1, 1)的伪随机数, 结果可重复
+static float32_t noise(void) {
+    lcg_state = lcg_state * 1664525U + 1013904223U;
+    return (float32_t) (lcg_state >> 8) / 8388608.0f - 1.0f;
+}
+
+//对称正定: B*B' + n*I
+static void fill_spd(float32_t *data, int n) {
+    float32_t b[MATRIX_MAXIMUM_SIZE * MATRIX_MAXIMUM_SIZE];
+    for (int i = 0; i < n * n; i++) {
+        b[i] = noise();
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            float32_t sum = (i == j) ? (float32_t) n : 0.0f;
+            for (int k = 0; k < n; k++) {
+                sum += b[i * n + k] * b[j * n + k];
+            }
+            data[i * n + j] = sum;
+        }
+    }
+}
+
+static bool same_f32(matrix_f32_t *a, matrix_f32_t *b) {
+    if (a->is_valid != b->is_valid) {
+        return false;
+    }
+    if (!a->is_valid) {
+        return true;
+    }
+    return a->arm_matrix.numRows == b->arm_matrix.numRows && a->arm_matrix.numCols == b->arm_matrix.numCols &&
+           memcmp(a->arm_matrix.pData, b->arm_matrix.pData,
+                  sizeof(float32_t) * a->arm_matrix.numRows * a->arm_matrix.numCols) == 0;
+}
+
+//同一份数据分别生成堆矩阵和静态矩阵
+static void pair_creat(matrix_f32_t *heap, matrix_f32_t *stat, matrix_buffer_f32_t *buffer, uint16_t rows,
+                       uint16_t cols, float32_t *data) {
+    Matrix_data_creat_f32(heap, rows, cols, data, NoInitMatZero);
+    Matrix_static_data_creat_f32(stat, buffer, rows, cols, data, NoInitMatZero);
+}
+
+static void test_static_creat(void) {
+    float32_t data[6] = {1, 2, 3, 4, 5, 6};
+    matrix_f32_t a;
+    uint32_t malloc_before = host_malloc_count;
+    Matrix_static_data_creat_f32(&a, &buffers[0], 2, 3, data, NoInitMatZero);
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&a) && a.p2Data[1][2] == 6.0f);
+    TEST_ASSERT(a.arm_matrix.pData == buffers[0].data);
+
+    //同一缓冲区上重新生成不同维度
+    Matrix_static_nodata_creat_f32(&a, &buffers[0], 3, 2, InitMatWithZero);
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&a) && a.p2Data[2][1] == 0.0f && a.p2Data[1] == &buffers[0].data[2]);
+
+    //超出容量时无效
+    Matrix_static_nodata_creat_f32(&a, &buffers[0], MATRIX_MAXIMUM_SIZE + 1, 1, InitMatWithZero);
+    TEST_ASSERT(!Matrix_bMatrixIsValid_f32(&a));
+    TEST_ASSERT(host_malloc_count == malloc_before);
+}
+
+static void test_elementwise_equivalence(void) {
+    float32_t l_data[M * N], r_data[M * N];
+    for (int i = 0; i < M * N; i++) {
+        l_data[i] = noise();
+        r_data[i] = noise();
+    }
+    matrix_f32_t hl, hr, hres, hT, hsub, sl, sr, sres, sT, ssub;
+    pair_creat(&hl, &sl, &buffers[0], M, N, l_data);
+    pair_creat(&hr, &sr, &buffers[1], M, N, r_data);
+    pair_creat(&hsub, &ssub, &buffers[4], 2, 3, r_data);
+    Matrix_vinit_f32(&hres);
+    Matrix_vinit_f32(&hT);
+    Matrix_vinit_static_f32(&sres, &buffers[2]);
+    Matrix_vinit_static_f32(&sT, &buffers[3]);
+
+    Matrix_vadd_f32(&hl, &hr, &hres);
+    NO_HEAP(Matrix_vadd_f32(&sl, &sr, &sres));
+    TEST_ASSERT(same_f32(&hres, &sres));
+    Matrix_vsub_f32(&hl, &hr, &hres);
+    NO_HEAP(Matrix_vsub_f32(&sl, &sr, &sres));
+    TEST_ASSERT(same_f32(&hres, &sres));
+    Matrix_vTranspose_nsame_f32(&hl, &hT);
+    NO_HEAP(Matrix_vTranspose_nsame_f32(&sl, &sT));
+    TEST_ASSERT(same_f32(&hT, &sT));
+    //维度改变时结果重新生成
+    Matrix_vmult_nsame_f32(&hT, &hr, &hres);
+    NO_HEAP(Matrix_vmult_nsame_f32(&sT, &sr, &sres));
+    TEST_ASSERT(same_f32(&hres, &sres) && sres.arm_matrix.numRows == N);
+    Matrix_vscale_f32(&hres, 0.25f);
+    NO_HEAP(Matrix_vscale_f32(&sres, 0.25f));
+    TEST_ASSERT(same_f32(&hres, &sres));
+    Matrix_vCopy_f32(&hl, &hres);
+    NO_HEAP(Matrix_vCopy_f32(&sl, &sres));
+    TEST_ASSERT(same_f32(&hres, &sres));
+    Matrix_vInsertAllSubMatrix_f32(&hres, &hsub, 1, 1, &hres);
+    NO_HEAP(Matrix_vInsertAllSubMatrix_f32(&sres, &ssub, 1, 1, &sres));
+    TEST_ASSERT(same_f32(&hres, &sres));
+    //维度不匹配时两种都无效
+    Matrix_vmult_nsame_f32(&hl, &hr, &hres);
+    NO_HEAP(Matrix_vmult_nsame_f32(&sl, &sr, &sres));
+    TEST_ASSERT(!Matrix_bMatrixIsValid_f32(&hres) && same_f32(&hres, &sres));
+
+    Matrix_vSetMatrixInvalid_f32(&hl);
+    Matrix_vSetMatrixInvalid_f32(&hr);
+    Matrix_vSetMatrixInvalid_f32(&hres);
+    Matrix_vSetMatrixInvalid_f32(&hT);
+    Matrix_vSetMatrixInvalid_f32(&hsub);
+}
+
+static void test_decomposition_equivalence(void) {
+    float32_t a_data[M * M], b_data[M];
+    fill_spd(a_data, M);
+    for (int i = 0; i < M; i++) {
+        b_data[i] = noise();
+    }
+    matrix_f32_t ha, hb, hinv, hl, hqt, hr, hx, sa, sb, sinv, sl, sqt, sr, sx;
+    pair_creat(&ha, &sa, &buffers[0], M, M, a_data);
+    pair_creat(&hb, &sb, &buffers[1], M, 1, b_data);
+    Matrix_vinit_f32(&hinv);
+    Matrix_vinit_f32(&hl);
+    Matrix_vinit_f32(&hx);
+    Matrix_nodata_creat_f32(&hqt, M, M, InitMatWithZero);
+    Matrix_nodata_creat_f32(&hr, M, M, InitMatWithZero);
+    Matrix_vinit_static_f32(&sinv, &buffers[2]);
+    Matrix_vinit_static_f32(&sl, &buffers[3]);
+    Matrix_vinit_static_f32(&sx, &buffers[4]);
+    Matrix_static_nodata_creat_f32(&sqt, &buffers[5], M, M, InitMatWithZero);
+    Matrix_static_nodata_creat_f32(&sr, &buffers[6], M, M, InitMatWithZero);
+
+    NO_HEAP(TEST_ASSERT(Matrix_bMatrixIsPositiveDefinite_f32(&sa, false, &scratch[0])));
+    Matrix_vCholeskyDec_f32(&ha, &hl);
+    NO_HEAP(Matrix_vCholeskyDec_f32(&sa, &sl));
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&sl) && same_f32(&hl, &sl));
+
+    //QR的R写回输入, 求逆改写输入, 所以先做回代再求逆
+    TEST_ASSERT(Matrix_bQRDec_f32(&ha, &hqt, &hr, scratch));
+    NO_HEAP(TEST_ASSERT(Matrix_bQRDec_f32(&sa, &sqt, &sr, scratch)));
+    TEST_ASSERT(same_f32(&hqt, &sqt) && same_f32(&ha, &sa));
+    Matrix_vBackSubtitution_f32(&ha, &hb, &hx);
+    NO_HEAP(Matrix_vBackSubtitution_f32(&sa, &sb, &sx));
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&sx) && same_f32(&hx, &sx));
+
+    memcpy(ha.arm_matrix.pData, a_data, sizeof(a_data));
+    memcpy(sa.arm_matrix.pData, a_data, sizeof(a_data));
+    Matrix_vInverse_nsame_f32(&ha, &hinv);
+    NO_HEAP(Matrix_vInverse_nsame_f32(&sa, &sinv));
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&sinv) && same_f32(&hinv, &sinv));
+
+    Matrix_vSetMatrixInvalid_f32(&ha);
+    Matrix_vSetMatrixInvalid_f32(&hb);
+    Matrix_vSetMatrixInvalid_f32(&hinv);
+    Matrix_vSetMatrixInvalid_f32(&hl);
+    Matrix_vSetMatrixInvalid_f32(&hqt);
+    Matrix_vSetMatrixInvalid_f32(&hr);
+    Matrix_vSetMatrixInvalid_f32(&hx);
+}
+
+typedef struct {
+    matrix_f32_t A, P, Q, H, R, AT, HT, AP, HP, S, Sinv, PHT, K, KHP;
+} ukf_step_t;
+
+static float32_t step_data[4][M * M];
+
+static void step_init(ukf_step_t *s, bool use_static) {
+    matrix_f32_t *m = &s->A;
+    for (unsigned i = 0; i < sizeof(ukf_step_t) / sizeof(matrix_f32_t); i++) {
+        if (use_static) {
+            Matrix_vinit_static_f32(&m[i], &buffers[i]);
+        } else {
+            Matrix_vinit_f32(&m[i]);
+        }
+    }
+    if (use_static) {
+        Matrix_static_data_creat_f32(&s->A, &buffers[0], N, N, step_data[0], NoInitMatZero);
+        Matrix_static_data_creat_f32(&s->P, &buffers[1], N, N, step_data[1], NoInitMatZero);
+        Matrix_static_data_creat_f32(&s->Q, &buffers[2], N, N, step_data[1], NoInitMatZero);
+        Matrix_static_data_creat_f32(&s->H, &buffers[3], M, N, step_data[2], NoInitMatZero);
+        Matrix_static_data_creat_f32(&s->R, &buffers[4], M, M, step_data[3], NoInitMatZero);
+    } else {
+        Matrix_data_creat_f32(&s->A, N, N, step_data[0], NoInitMatZero);
+        Matrix_data_creat_f32(&s->P, N, N, step_data[1], NoInitMatZero);
+        Matrix_data_creat_f32(&s->Q, N, N, step_data[1], NoInitMatZero);
+        Matrix_data_creat_f32(&s->H, M, N, step_data[2], NoInitMatZero);
+        Matrix_data_creat_f32(&s->R, M, M, step_data[3], NoInitMatZero);
+    }
+}
+
+//P = A*P*A' + Q, S = H*P*H' + R, K = P*H'*S^-1, P = P - K*H*P; 堆版本的临时矩阵每步申请和释放, 与改动前的滤波器相同
+static void step_run(ukf_step_t *s, bool use_static) {
+    if (!use_static) {
+        matrix_f32_t *m = &s->AT;
+        for (unsigned i = 0; i < sizeof(ukf_step_t) / sizeof(matrix_f32_t) - 5; i++) {
+            Matrix_vinit_f32(&m[i]);
+        }
+    }
+    Matrix_vTranspose_nsame_f32(&s->A, &s->AT);
+    Matrix_vTranspose_nsame_f32(&s->H, &s->HT);
+    Matrix_vmult_nsame_f32(&s->A, &s->P, &s->AP);
+    Matrix_vmult_nsame_f32(&s->AP, &s->AT, &s->P);
+    Matrix_vadd_f32(&s->P, &s->Q, &s->P);
+    Matrix_vmult_nsame_f32(&s->H, &s->P, &s->HP);
+    Matrix_vmult_nsame_f32(&s->HP, &s->HT, &s->S);
+    Matrix_vadd_f32(&s->S, &s->R, &s->S);
+    Matrix_vInverse_nsame_f32(&s->S, &s->Sinv);
+    Matrix_vmult_nsame_f32(&s->P, &s->HT, &s->PHT);
+    Matrix_vmult_nsame_f32(&s->PHT, &s->Sinv, &s->K);
+    Matrix_vmult_nsame_f32(&s->K, &s->HP, &s->KHP);
+    Matrix_vsub_f32(&s->P, &s->KHP, &s->P);
+    if (!use_static) {
+        matrix_f32_t *m = &s->AT;
+        for (unsigned i = 0; i < sizeof(ukf_step_t) / sizeof(matrix_f32_t) - 5; i++) {
+            Matrix_vSetMatrixInvalid_f32(&m[i]);
+        }
+    }
+}
+
+static void test_ukf_step_benchmark(void) {
+    const int iterations = 20000;
+    for (int i = 0; i < N * N; i++) {
+        step_data[0][i] = (i % (N + 1) == 0 ? 1.0f : 0.0f) + 0.01f * noise();
+    }
+    fill_spd(step_data[1], N);
+    for (int i = 0; i < M * N; i++) {
+        step_data[2][i] = noise();
+    }
+    fill_spd(step_data[3], M);
+
+    ukf_step_t heap, stat;
+    step_init(&heap, false);
+    step_init(&stat, true);
+
+    uint64_t start = unit_test_now_ns();
+    for (int i = 0; i < iterations; i++) {
+        step_run(&heap, false);
+    }
+    uint64_t heap_ns = unit_test_now_ns() - start;
+
+    uint32_t malloc_before = host_malloc_count;
+    start = unit_test_now_ns();
+    for (int i = 0; i < iterations; i++) {
+        step_run(&stat, true);
+    }
+    uint64_t static_ns = unit_test_now_ns() - start;
+    TEST_ASSERT(host_malloc_count == malloc_before);
+    //两种存储的迭代结果逐位相同
+    TEST_ASSERT(Matrix_bMatrixIsValid_f32(&stat.P) && same_f32(&heap.P, &stat.P));
+
+    printf("ukf step %dx%d: heap %.1f ns, static %.1f ns per iteration (x%.2f)\n", N, M,
+           (double) heap_ns / iterations, (double) static_ns / iterations, (double) heap_ns / (double) static_ns);
+
+    matrix_f32_t *m = &heap.A;
+    for (unsigned i = 0; i < sizeof(ukf_step_t) / sizeof(matrix_f32_t); i++) {
+        Matrix_vSetMatrixInvalid_f32(&m[i]);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_static_creat);
+    RUN_TEST(test_elementwise_equivalence);
+    RUN_TEST(test_decomposition_equivalence);
+    RUN_TEST(test_ukf_step_benchmark);
+    TEST_ASSERT(host_malloc_count == host_free_count);
+    return unit_test_result();
+}
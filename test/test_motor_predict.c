@@ -0,0 +1,187 @@
+/**
+  * @file       test_motor_predict.c
+  * @brief      motor_predict against the exact solution of its first order
+  *             model, and a closed-loop simulation of the yaw speed loop with the
+  *             firmware gains: the feedback is dt old, the phase margin is
+  *             measured from the simulated plant, delay and predictor, with and
+  *             without prediction, together with the step overshoot.
+  *             motor_predict与其一阶模型精确解比较, 以及用固件参数的yaw速度环闭环仿真: 反馈延迟dt,
+  *             由仿真的对象、延迟和预测器测出有无预测时的相位裕度和阶跃超调
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "motor_predict.h"
+#include <complex.h>
+#include <string.h>
+
+#define CTRL_T          1e-3        //控制周期 s
+#define SUB_STEP        10          //对象仿真步数/控制周期
+#define PLANT_K         0.0223      //rad/s^2 每单位电流命令
+#define PLANT_B         20.0        //1/s
+#define SPEED_KP        1107.7814   //gimbal_task.c Yaw_speed_pid
+#define SPEED_KI        295.4083
+#define HIST_LEN        200000
+
+static void test_model(void) {
+    motor_predict_t predict;
+    float32_t angle = 1.0f, speed = 2.0f;
+
+    //关闭、dt非正或超过max_dt时不修改
+    motor_predict_init(&predict, 0, PLANT_K, PLANT_B, 0.005f);
+    motor_predict(&predict, 1000.0f, 0.002f, &angle, &speed);
+    TEST_ASSERT(angle == 1.0f && speed == 2.0f && predict.angle_delta == 0.0f);
+    motor_predict_init(&predict, 1, PLANT_K, PLANT_B, 0.005f);
+    motor_predict(&predict, 1000.0f, 0.0f, &angle, &speed);
+    motor_predict(&predict, 1000.0f, 0.006f, &angle, &speed);
+    TEST_ASSERT(angle == 1.0f && speed == 2.0f && predict.dt == 0.006f);
+
+    //与 w' = K*u - B*w 的精确解比较, dt远小于1/B时误差为O((B*dt)^2)
+    const double u = 5000.0, w0 = 30.0;
+    const double w_inf = PLANT_K * u / PLANT_B;
+    for (double dt = 0.0005; dt <= 0.005; dt += 0.0005) {
+        double e = exp(-PLANT_B * dt);
+        double speed_exact = w_inf + (w0 - w_inf) * e;
+        double angle_exact = w_inf * dt + (w0 - w_inf) * (1.0 - e) / PLANT_B;
+        angle = 0.0f;
+        speed = (float32_t) w0;
+        motor_predict(&predict, (float32_t) u, (float32_t) dt, &angle, &speed);
+        double bdt = PLANT_B * dt;
+        TEST_ASSERT_NEAR(speed_exact, speed, fabs(w0 - w_inf) * bdt * bdt + 1e-4);
+        TEST_ASSERT_NEAR(angle_exact, angle, fabs(w0 - w_inf) * dt * bdt * bdt + 1e-6);
+        TEST_ASSERT(angle == predict.angle_delta);
+    }
+    //角度可为NULL
+    speed = 0.0f;
+    motor_predict(&predict, 1000.0f, 0.001f, NULL, &speed);
+    TEST_ASSERT_NEAR(PLANT_K * 1000.0 * 0.001, speed, 1e-6);
+}
+
+//对象加反馈延迟加预测器: 输入控制周期的电流序列, 输出控制时刻的速度反馈
+typedef struct {
+    double speed;
+    double hist[HIST_LEN];
+    int n;
+    int delay_sub;              //反馈年龄, 对象仿真步数
+    motor_predict_t predict;
+} feedback_sim_t;
+
+static void feedback_init(feedback_sim_t *p_sim, double delay, int compensate) {
+    p_sim->speed = 0.0;
+    p_sim->n = 0;
+    p_sim->delay_sub = (int) (delay / (CTRL_T / SUB_STEP) + 0.5);
+    motor_predict_init(&p_sim->predict, (uint8_t) compensate, (float32_t) PLANT_K, (float32_t) PLANT_B, 0.005f);
+}
+
+//电流u保持一个控制周期(零阶保持), 返回下一控制时刻的反馈
+static double feedback_step(feedback_sim_t *p_sim, double u) {
+    const double h = CTRL_T / SUB_STEP;
+    for (int s = 0; s < SUB_STEP; s++) {
+        p_sim->speed += h * (PLANT_K * u - PLANT_B * p_sim->speed);
+        p_sim->hist[p_sim->n % HIST_LEN] = p_sim->speed;
+        p_sim->n++;
+    }
+    int k = p_sim->n - 1 - p_sim->delay_sub;
+    float32_t speed = (float32_t) (k >= 0 ? p_sim->hist[k % HIST_LEN] : 0.0);
+    //固件中given_current即该周期正在输出的电流
+    motor_predict(&p_sim->predict, (float32_t) u, (float32_t) (p_sim->delay_sub * h), NULL, &speed);
+    return speed;
+}
+
+//仿真测得从电流到反馈的频率响应
+static double complex feedback_response(double w, double delay, int compensate) {
+    static feedback_sim_t sim;
+    feedback_init(&sim, delay, compensate);
+    //先经过10个机械时间常数, 再按整数个周期相关
+    int settle = (int) (10.0 / PLANT_B / CTRL_T);
+    int periods = (int) ceil(w * 0.2 / (2.0 * M_PI));
+    periods = periods < 4 ? 4 : periods;
+    int len = (int) (periods * 2.0 * M_PI / (w * CTRL_T) + 0.5);
+    double complex in = 0.0, out = 0.0;
+    for (int k = 0; k < settle + len; k++) {
+        double u = sin(w * k * CTRL_T);
+        double y = feedback_step(&sim, u);
+        if (k >= settle) {
+            //输出属于下一时刻
+            double complex e = cexp(-I * w * (k + 1) * CTRL_T);
+            in += cexp(-I * w * k * CTRL_T) * u;
+            out += e * y;
+        }
+    }
+    return out / in;
+}
+
+//离散PI: kp + ki / (1 - z^-1)
+static double complex open_loop(double w, double delay, int compensate) {
+    double complex z = cexp(I * w * CTRL_T);
+    double complex c = SPEED_KP + SPEED_KI / (1.0 - 1.0 / z);
+    //反馈响应已包含电流输出到下一控制时刻的一个周期
+    return c * feedback_response(w, delay, compensate);
+}
+
+static double phase_margin(double delay, int compensate, double *p_wc) {
+    //对数扫频找到|L|穿越1, 再二分
+    double lo = 1.0, hi = 0.0;
+    for (double lw = 0.0; lw < log10(M_PI / CTRL_T); lw += 0.05) {
+        double w = pow(10.0, lw);
+        if (cabs(open_loop(w, delay, compensate)) < 1.0) {
+            hi = w;
+            break;
+        }
+        lo = w;
+    }
+    for (int i = 0; i < 30; i++) {
+        double w = sqrt(lo * hi);
+        if (cabs(open_loop(w, delay, compensate)) < 1.0) {
+            hi = w;
+        } else {
+            lo = w;
+        }
+    }
+    *p_wc = hi;
+    return 180.0 + carg(open_loop(hi, delay, compensate)) * 180.0 / M_PI;
+}
+
+//速度阶跃10rad/s的超调, %
+static double step_overshoot(double delay, int compensate) {
+    static feedback_sim_t sim;
+    feedback_init(&sim, delay, compensate);
+    double u = 0.0, sum = 0.0, peak = 0.0, y = 0.0;
+    for (int k = 0; k < 600; k++) {
+        double e = 10.0 - y;
+        sum += e;
+        u = SPEED_KP * e + SPEED_KI * sum;
+        u = u > 30000.0 ? 30000.0 : (u < -30000.0 ? -30000.0 : u);
+        y = feedback_step(&sim, u);
+        peak = sim.speed > peak ? sim.speed : peak;
+    }
+    return (peak - 10.0) / 10.0 * 100.0;
+}
+
+static void test_closed_loop_phase_margin(void) {
+    const double delays[] = {0.5e-3, 1e-3, 2e-3, 3e-3};
+    double pm[4][2], overshoot[4][2];
+    for (int i = 0; i < 4; i++) {
+        for (int c = 0; c < 2; c++) {
+            double wc;
+            pm[i][c] = phase_margin(delays[i], c, &wc);
+            overshoot[i][c] = step_overshoot(delays[i], c);
+            if (c == 1) {
+                printf("age %.1f ms: phase margin %5.1f -> %5.1f deg, overshoot %5.1f -> %5.1f %%\n",
+                       delays[i] * 1e3, pm[i][0], pm[i][1], overshoot[i][0], overshoot[i][1]);
+            }
+        }
+    }
+    for (int i = 1; i < 4; i++) {
+        //延迟越大, 不预测时相位裕度越小; 预测后基本不随延迟变化
+        TEST_ASSERT(pm[i][0] < pm[i - 1][0]);
+        TEST_ASSERT(fabs(pm[i][1] - pm[0][1]) < 3.0);
+        TEST_ASSERT(pm[i][1] > pm[i][0] + 3.0);
+        TEST_ASSERT(overshoot[i][1] < overshoot[i][0]);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_model);
+    RUN_TEST(test_closed_loop_phase_margin);
+    return unit_test_result();
+}
@@ -0,0 +1,408 @@
+/**
+  * @file       test_param_registry.c
+  * @brief      param_registry: registration checks, a batch that is rejected as
+  *             a whole, owner isolation, a parameter staged again before its
+  *             loop applies it, the conversions of every type, export and
+  *             import with the signature check, and the INFO/GET/SET protocol
+  *             through frame_parser in both directions, with requests split
+  *             into random chunks and corrupted frames between them.
+  *             param_registry: 注册检查, 整批拒绝, 不同循环的参数互不影响, 生效前再次暂存,
+  *             各类型的转换, 导出导入和签名检查, 以及经frame_parser双向传输的INFO/GET/SET协议,
+  *             请求随机分块到达并夹杂损坏帧
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "param_registry.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+#define OWNER_GIMBAL    0U
+#define OWNER_CHASSIS   1U
+
+static param_registry_t reg;
+
+//被调参数
+static float32_t kp, ki, kd;
+static float32_t follow_kp;
+static int32_t offset_i32;
+static uint32_t mask_u32;
+static int16_t ecd_i16;
+static uint16_t max_out_u16;
+static uint8_t mode_u8;
+static bool_t enable_bool;
+static float32_t log_gain;
+
+static int id_kp, id_ki, id_kd, id_follow, id_i32, id_u32, id_i16, id_u16, id_u8, id_bool, id_log;
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+static param_value_t value_f(float32_t f) {
+    param_value_t value;
+    value.f = f;
+    return value;
+}
+
+static param_value_t value_i(int32_t i) {
+    param_value_t value;
+    value.i = i;
+    return value;
+}
+
+static void registry_setup(void) {
+    memset(&reg, 0, sizeof(reg));
+    kp = 1.0f;
+    ki = 0.1f;
+    kd = 0.0f;
+    follow_kp = 5.0f;
+    offset_i32 = 0;
+    mask_u32 = 0U;
+    ecd_i16 = 0;
+    max_out_u16 = 1000U;
+    mode_u8 = 0U;
+    enable_bool = 0;
+    log_gain = 1.0f;
+    id_kp = param_registry_add(&reg, "yaw_spd_kp", &kp, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 100.0f);
+    id_ki = param_registry_add(&reg, "yaw_spd_ki", &ki, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 10.0f);
+    id_kd = param_registry_add(&reg, "yaw_spd_kd", &kd, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 10.0f);
+    id_follow = param_registry_add(&reg, "follow_kp", &follow_kp, PARAM_FLOAT, OWNER_CHASSIS, 0.0f, 50.0f);
+    id_i32 = param_registry_add(&reg, "offset", &offset_i32, PARAM_INT32, OWNER_GIMBAL, -100000.0f, 100000.0f);
+    id_u32 = param_registry_add(&reg, "mask", &mask_u32, PARAM_UINT32, OWNER_GIMBAL, 0.0f, 4294967295.0f);
+    id_i16 = param_registry_add(&reg, "ecd", &ecd_i16, PARAM_INT16, OWNER_GIMBAL, -8192.0f, 8191.0f);
+    id_u16 = param_registry_add(&reg, "max_out", &max_out_u16, PARAM_UINT16, OWNER_CHASSIS, 0.0f, 65535.0f);
+    id_u8 = param_registry_add(&reg, "mode", &mode_u8, PARAM_UINT8, OWNER_CHASSIS, 0.0f, 3.0f);
+    //bool的范围固定为0到1
+    id_bool = param_registry_add(&reg, "enable", &enable_bool, PARAM_BOOL, OWNER_GIMBAL, -5.0f, 5.0f);
+    id_log = param_registry_add(&reg, "log_gain", &log_gain, PARAM_FLOAT, PARAM_OWNER_NONE, 0.0f, 2.0f);
+}
+
+static void test_add(void) {
+    static float32_t spare;
+
+    registry_setup();
+    TEST_ASSERT(id_kp == 0 && id_log == 10 && reg.num == 11U);
+    TEST_ASSERT(reg.entry[id_bool].min == 0.0f && reg.entry[id_bool].max == 1.0f);
+    TEST_ASSERT(param_registry_find(&reg, "follow_kp") == id_follow);
+    TEST_ASSERT(param_registry_find(&reg, "follow") == -1);
+
+    //参数错误
+    TEST_ASSERT(param_registry_add(&reg, "x", NULL, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 1.0f) == -1);
+    TEST_ASSERT(param_registry_add(&reg, "x", &spare, PARAM_TYPE_NUM, OWNER_GIMBAL, 0.0f, 1.0f) == -1);
+    TEST_ASSERT(param_registry_add(&reg, "x", &spare, PARAM_FLOAT, PARAM_OWNER_MAX_NUM, 0.0f, 1.0f) == -1);
+    TEST_ASSERT(param_registry_add(&reg, "x", &spare, PARAM_FLOAT, OWNER_GIMBAL, 1.0f, 0.0f) == -1);
+    TEST_ASSERT(param_registry_add(&reg, "x", &spare, PARAM_FLOAT, OWNER_GIMBAL, NAN, 0.0f) == -1);
+    TEST_ASSERT(reg.num == 11U);
+
+    //名字截断到PARAM_NAME_LEN - 1
+    int id = param_registry_add(&reg, "a_very_long_parameter_name", &spare, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 1.0f);
+    TEST_ASSERT(id == 11 && strlen(reg.entry[id].name) == PARAM_NAME_LEN - 1U);
+    TEST_ASSERT(strncmp(reg.entry[id].name, "a_very_long_par", PARAM_NAME_LEN) == 0);
+
+    //参数表已满
+    while (reg.num < PARAM_REGISTRY_MAX_NUM) {
+        TEST_ASSERT(param_registry_add(&reg, "fill", &spare, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 1.0f) >= 0);
+    }
+    TEST_ASSERT(param_registry_add(&reg, "over", &spare, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 1.0f) == -1);
+    TEST_ASSERT(host_primask == 0U);
+}
+
+static void test_batch_rejected_as_whole(void) {
+    uint8_t bad = 0xFFU;
+
+    registry_setup();
+    //第三个超出范围, 前两个也不暂存
+    uint8_t id[3] = {(uint8_t) id_kp, (uint8_t) id_ki, (uint8_t) id_kd};
+    param_value_t value[3] = {value_f(2.0f), value_f(0.2f), value_f(11.0f)};
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 3, &bad) == PARAM_ERR_RANGE && bad == 2U);
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_GIMBAL) == 0U);
+    TEST_ASSERT(kp == 1.0f && ki == 0.1f && kd == 0.0f);
+
+    //NaN视为超出范围
+    value[2] = value_f(NAN);
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 3, &bad) == PARAM_ERR_RANGE && bad == 2U);
+    //编号不存在
+    id[1] = 200U;
+    value[2] = value_f(1.0f);
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 3, &bad) == PARAM_ERR_ID && bad == 1U);
+    TEST_ASSERT(reg.reject_cnt == 3U && reg.batch_cnt == 0U);
+    for (int i = 0; i < reg.num; i++) {
+        TEST_ASSERT(reg.pending[i] == 0U);
+    }
+
+    //整批通过, 在所属循环下一次apply前不生效
+    id[1] = (uint8_t) id_ki;
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 3, &bad) == PARAM_OK && bad == 3U);
+    TEST_ASSERT(kp == 1.0f && ki == 0.1f && kd == 0.0f);
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_GIMBAL) == 3U);
+    TEST_ASSERT(kp == 2.0f && ki == 0.2f && kd == 1.0f);
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_GIMBAL) == 0U);
+    TEST_ASSERT(reg.batch_cnt == 1U && reg.apply_cnt[OWNER_GIMBAL] == 1U && host_primask == 0U);
+}
+
+static void test_owner_isolation_and_restage(void) {
+    registry_setup();
+    uint8_t id[3] = {(uint8_t) id_kp, (uint8_t) id_follow, (uint8_t) id_log};
+    param_value_t value[3] = {value_f(3.0f), value_f(7.0f), value_f(0.5f)};
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 3, NULL) == PARAM_OK);
+    //不属于任何循环的参数立即生效
+    TEST_ASSERT(log_gain == 0.5f && kp == 1.0f && follow_kp == 5.0f);
+
+    //底盘先生效, 不影响云台的暂存值
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_CHASSIS) == 1U);
+    TEST_ASSERT(follow_kp == 7.0f && kp == 1.0f);
+
+    //生效前再次暂存, 使用最新的值
+    value[0] = value_f(4.0f);
+    TEST_ASSERT(param_registry_stage(&reg, id, value, 1, NULL) == PARAM_OK);
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_GIMBAL) == 1U && kp == 4.0f);
+    //没有暂存值的循环和不存在的循环
+    TEST_ASSERT(param_registry_apply(&reg, OWNER_CHASSIS) == 0U);
+    TEST_ASSERT(param_registry_apply(&reg, 3U) == 0U && param_registry_apply(&reg, PARAM_OWNER_NONE) == 0U);
+}
+
+static void test_types(void) {
+    param_value_t value;
+
+    registry_setup();
+    //文本命令的浮点数转换, 整数四舍五入
+    TEST_ASSERT(param_registry_from_float(&reg, (uint8_t) id_i16, -1234.6f, &value) == 0 && value.i == -1235);
+    TEST_ASSERT(param_registry_from_float(&reg, (uint8_t) id_u32, 3000000000.0f, &value) == 0 &&
+                value.u == 3000000000U);
+    TEST_ASSERT(param_registry_from_float(&reg, (uint8_t) id_kp, 2.5f, &value) == 0 && value.f == 2.5f);
+    TEST_ASSERT(param_registry_from_float(&reg, 200U, 1.0f, &value) == -1);
+
+    uint8_t id[7] = {(uint8_t) id_i32, (uint8_t) id_u32, (uint8_t) id_i16, (uint8_t) id_u16, (uint8_t) id_u8,
+                     (uint8_t) id_bool, (uint8_t) id_kd};
+    param_value_t v[7];
+    v[0] = value_i(-99999);
+    v[1].u = 3000000000U;
+    v[2] = value_i(-8192);
+    v[3] = value_i(65535);
+    v[4] = value_i(3);
+    v[5] = value_i(1);
+    v[6] = value_f(0.25f);
+    TEST_ASSERT(param_registry_stage(&reg, id, v, 7, NULL) == PARAM_OK);
+    param_registry_apply(&reg, OWNER_GIMBAL);
+    param_registry_apply(&reg, OWNER_CHASSIS);
+    TEST_ASSERT(offset_i32 == -99999 && mask_u32 == 3000000000U && ecd_i16 == -8192);
+    TEST_ASSERT(max_out_u16 == 65535U && mode_u8 == 3U && enable_bool == 1 && kd == 0.25f);
+
+    //读回时整数扩展到32位
+    TEST_ASSERT(param_registry_get(&reg, (uint8_t) id_i16, &value) == 0 && value.i == -8192);
+    TEST_ASSERT(param_registry_get(&reg, (uint8_t) id_u16, &value) == 0 && value.i == 65535);
+    TEST_ASSERT(param_registry_get(&reg, (uint8_t) id_u32, &value) == 0 && value.u == 3000000000U);
+    TEST_ASSERT(param_registry_get(&reg, (uint8_t) id_bool, &value) == 0 && value.i == 1);
+    TEST_ASSERT(param_registry_get(&reg, 200U, &value) == -1);
+
+    //超出类型范围的值被拒绝
+    v[0] = value_i(2);
+    TEST_ASSERT(param_registry_stage(&reg, &id[5], v, 1, NULL) == PARAM_ERR_RANGE);
+    v[0] = value_i(4);
+    TEST_ASSERT(param_registry_stage(&reg, &id[4], v, 1, NULL) == PARAM_ERR_RANGE);
+    v[0] = value_i(-8193);
+    TEST_ASSERT(param_registry_stage(&reg, &id[2], v, 1, NULL) == PARAM_ERR_RANGE);
+}
+
+static void test_export_import(void) {
+    uint32_t set[PARAM_SET_WORD_NUM(PARAM_REGISTRY_MAX_NUM)];
+    uint32_t other[PARAM_SET_WORD_NUM(PARAM_REGISTRY_MAX_NUM)];
+    static float32_t spare;
+
+    registry_setup();
+    uint8_t id[2] = {(uint8_t) id_kp, (uint8_t) id_i16};
+    param_value_t value[2] = {value_f(42.0f), value_i(-7)};
+    param_registry_stage(&reg, id, value, 2, NULL);
+    //尚未生效的参数导出暂存值
+    uint8_t len = param_registry_export(&reg, set);
+    TEST_ASSERT(len == PARAM_SET_WORD_NUM(reg.num) && set[1] == reg.num);
+    TEST_ASSERT(set[0] == param_registry_signature(&reg));
+    param_value_t word;
+    memcpy(&word, &set[2 + id_kp], sizeof(word));
+    TEST_ASSERT(word.f == 42.0f);
+    memcpy(&word, &set[2 + id_i16], sizeof(word));
+    TEST_ASSERT(word.i == -7);
+
+    //重新启动后读取参数组, 在各循环的下一个周期生效
+    registry_setup();
+    TEST_ASSERT(param_registry_import(&reg, set, len) == PARAM_OK);
+    TEST_ASSERT(kp == 1.0f);
+    param_registry_apply(&reg, OWNER_GIMBAL);
+    param_registry_apply(&reg, OWNER_CHASSIS);
+    TEST_ASSERT(kp == 42.0f && ecd_i16 == -7 && follow_kp == 5.0f);
+    param_registry_export(&reg, other);
+    TEST_ASSERT(memcmp(set, other, len * sizeof(uint32_t)) == 0);
+
+    //长度不符
+    TEST_ASSERT(param_registry_import(&reg, set, (uint8_t) (len - 1U)) == PARAM_ERR_LEN);
+    //参数表改变后签名不符, 参数不被改动
+    registry_setup();
+    reg.entry[id_ki].type = PARAM_INT32;
+    TEST_ASSERT(param_registry_import(&reg, set, len) == PARAM_ERR_SIGNATURE);
+    registry_setup();
+    param_registry_add(&reg, "new_param", &spare, PARAM_FLOAT, OWNER_GIMBAL, 0.0f, 1.0f);
+    TEST_ASSERT(param_registry_import(&reg, set, len) == PARAM_ERR_LEN);
+    registry_setup();
+    strcpy(reg.entry[id_kd].name, "yaw_spd_kf");
+    TEST_ASSERT(param_registry_import(&reg, set, len) == PARAM_ERR_SIGNATURE);
+    //保存的值超出当前范围时整批拒绝
+    registry_setup();
+    reg.entry[id_kp].max = 10.0f;
+    set[0] = param_registry_signature(&reg);
+    TEST_ASSERT(param_registry_import(&reg, set, len) == PARAM_ERR_RANGE);
+    param_registry_apply(&reg, OWNER_GIMBAL);
+    TEST_ASSERT(kp == 1.0f && ecd_i16 == 0);
+}
+
+//协议: 请求经帧解析器到达固件一侧, 应答经另一个解析器回到上位机一侧
+static spsc_fifo_t request_fifo, reply_fifo;
+static uint8_t request_buf[512], reply_buf[512];
+static uint8_t request_frame_buf[PARAM_FRAME_MAX_LEN], reply_frame_buf[PARAM_FRAME_MAX_LEN];
+static frame_parser_t request_parser, reply_parser;
+static uint8_t reply[PARAM_FRAME_MAX_LEN];
+static uint16_t reply_len, reply_cmd;
+static uint8_t reply_seq;
+static uint32_t reply_cnt;
+
+static void request_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    uint8_t data[PARAM_FRAME_MAX_DATA];
+    uint8_t frame[PARAM_FRAME_MAX_LEN];
+    const uint8_t *p_data = p_frame + PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE;
+    uint16_t len = frame_len - PARAM_FRAME_HEAD_SIZE - PARAM_FRAME_CMD_SIZE - 2U;
+    int n = param_registry_handle(&reg, cmd_id, p_data, len, data);
+
+    if (n < 0) {
+        data[0] = PARAM_ERR_CMD;
+        n = 1;
+    }
+    uint16_t out = param_frame_pack(frame, cmd_id | PARAM_REPLY_FLAG, p_frame[3], data, (uint16_t) n);
+    TEST_ASSERT(spsc_fifo_puts(&reply_fifo, frame, out) == out);
+}
+
+static void reply_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    reply_len = frame_len - PARAM_FRAME_HEAD_SIZE - PARAM_FRAME_CMD_SIZE - 2U;
+    memcpy(reply, p_frame + PARAM_FRAME_HEAD_SIZE + PARAM_FRAME_CMD_SIZE, reply_len);
+    reply_cmd = cmd_id;
+    reply_seq = p_frame[3];
+    reply_cnt++;
+}
+
+//发送一个请求, 前面夹杂噪声和损坏的帧, 按随机分块到达
+static void request(uint16_t cmd_id, const uint8_t *p_data, uint16_t len) {
+    static uint8_t seq;
+    uint8_t frame[PARAM_FRAME_MAX_LEN];
+    uint8_t bytes[2 * PARAM_FRAME_MAX_LEN + 16];
+    uint32_t n = 0U;
+    uint32_t before = reply_cnt;
+
+    seq++;
+    uint16_t frame_len = param_frame_pack(frame, cmd_id, seq, p_data, len);
+    for (uint32_t i = rnd(8); i > 0U; i--) {
+        bytes[n++] = (uint8_t) rnd(256);
+    }
+    if (rnd(2)) {
+        memcpy(&bytes[n], frame, frame_len);
+        bytes[n + PARAM_FRAME_HEAD_SIZE + rnd(frame_len - PARAM_FRAME_HEAD_SIZE)] ^= 0x10U;
+        n += frame_len;
+    }
+    memcpy(&bytes[n], frame, frame_len);
+    n += frame_len;
+    for (uint32_t pos = 0U; pos < n;) {
+        uint32_t chunk = 1U + rnd(24);
+        if (chunk > n - pos) {
+            chunk = n - pos;
+        }
+        spsc_fifo_puts(&request_fifo, &bytes[pos], chunk);
+        frame_parser_unpack_fifo(&request_parser, &request_fifo);
+        pos += chunk;
+    }
+    frame_parser_unpack_fifo(&reply_parser, &reply_fifo);
+    TEST_ASSERT(reply_cnt == before + 1U);
+    TEST_ASSERT(reply_cmd == (cmd_id | PARAM_REPLY_FLAG) && reply_seq == seq);
+}
+
+static void test_protocol(void) {
+    uint8_t data[PARAM_FRAME_MAX_DATA];
+    float32_t f;
+
+    registry_setup();
+    spsc_fifo_init(&request_fifo, request_buf, sizeof(request_buf));
+    spsc_fifo_init(&reply_fifo, reply_buf, sizeof(reply_buf));
+    frame_parser_init(&request_parser, &param_frame_protocol, NULL, 0, request_frame, request_frame_buf);
+    frame_parser_init(&reply_parser, &param_frame_protocol, NULL, 0, reply_frame, reply_frame_buf);
+
+    for (int round = 0; round < 50; round++) {
+        //上位机遍历参数表
+        for (uint8_t id = 0; id <= reg.num; id++) {
+            request(PARAM_CMD_INFO, &id, 1);
+            TEST_ASSERT(reply[1] == reg.num && reply[2] == id);
+            if (id == reg.num) {
+                TEST_ASSERT(reply[0] == PARAM_ERR_ID && reply_len == 3U);
+                continue;
+            }
+            TEST_ASSERT(reply[0] == PARAM_OK && reply_len == 17U + PARAM_NAME_LEN);
+            TEST_ASSERT(reply[3] == reg.entry[id].type && reply[4] == reg.entry[id].owner);
+            TEST_ASSERT(memcmp(&reply[5], &reg.entry[id].min, 4) == 0 && memcmp(&reply[9], &reg.entry[id].max, 4) == 0);
+            TEST_ASSERT(strncmp((const char *) &reply[17], reg.entry[id].name, PARAM_NAME_LEN) == 0);
+        }
+
+        //SET: {id value}*n, 在下一个周期生效
+        f = (float32_t) (round + 1);
+        data[0] = (uint8_t) id_kp;
+        memcpy(&data[1], &f, 4);
+        int32_t ecd = -round * 10;
+        data[5] = (uint8_t) id_i16;
+        memcpy(&data[6], &ecd, 4);
+        request(PARAM_CMD_SET, data, 10);
+        TEST_ASSERT(reply[0] == PARAM_OK && reply_len == 2U && reply[1] == 2U);
+        param_registry_apply(&reg, OWNER_GIMBAL);
+
+        //GET
+        data[0] = (uint8_t) id_i16;
+        data[1] = (uint8_t) id_kp;
+        request(PARAM_CMD_GET, data, 2);
+        TEST_ASSERT(reply[0] == PARAM_OK && reply[1] == 2U && reply_len == 12U);
+        TEST_ASSERT(reply[2] == id_i16 && memcmp(&reply[3], &ecd, 4) == 0);
+        TEST_ASSERT(reply[7] == id_kp && memcmp(&reply[8], &f, 4) == 0);
+    }
+
+    //错误应答
+    //第二个超出范围, kd=0也不暂存
+    f = 1000.0f;
+    memset(data, 0, sizeof(data));
+    data[0] = (uint8_t) id_kd;
+    memcpy(&data[6], &f, 4);
+    data[5] = (uint8_t) id_ki;
+    request(PARAM_CMD_SET, data, 10);
+    TEST_ASSERT(reply[0] == PARAM_ERR_RANGE && reply[1] == 1U);
+    request(PARAM_CMD_SET, data, 9);
+    TEST_ASSERT(reply[0] == PARAM_ERR_LEN && reply_len == 2U);
+    data[0] = 0U;
+    data[1] = 77U;
+    request(PARAM_CMD_GET, data, 2);
+    TEST_ASSERT(reply[0] == PARAM_ERR_ID && reply[1] == 1U);
+    request(PARAM_CMD_GET, data, 0);
+    TEST_ASSERT(reply[0] == PARAM_ERR_LEN);
+    request(PARAM_CMD_INFO, data, 2);
+    TEST_ASSERT(reply[0] == PARAM_ERR_LEN);
+    request(0x0199U, data, 1);
+    TEST_ASSERT(reply[0] == PARAM_ERR_CMD && reply_len == 1U);
+    TEST_ASSERT(kd == 0.0f && ki == 0.1f && reg.reject_cnt == 1U);
+    TEST_ASSERT(request_parser.frame_cnt == reply_cnt && reply_parser.err_cnt == 0U);
+    printf("protocol: %u requests, %u corrupted or noise frames dropped\n", (unsigned) reply_cnt,
+           (unsigned) request_parser.err_cnt);
+}
+
+int main(void) {
+    RUN_TEST(test_add);
+    RUN_TEST(test_batch_rejected_as_whole);
+    RUN_TEST(test_owner_isolation_and_restage);
+    RUN_TEST(test_types);
+    RUN_TEST(test_export_import);
+    RUN_TEST(test_protocol);
+    return unit_test_result();
+}
@@ -0,0 +1,426 @@
+/**
+  * @file       test_pid.c
+  * @brief      PID_calc, ALL_PID through PID_build/PID_init, angle wrapping,
+  *             the integral restart after a pause and PID_build rejects. Every
+  *             feature combination of PID_build is run against a reference
+  *             copy of the ALL_PID body from before the builder, with the
+  *             pointer compares replaced by the wrap mode, and PID_init is run
+  *             against PID_build with the same switches; the state has to be
+  *             bit-identical.
+  *             PID_calc、经PID_build/PID_init的ALL_PID、角度回绕、暂停后积分重新开始和PID_build的配置检查.
+  *             PID_build的每种功能组合与改为按pid计算函数之前的ALL_PID(指针比较换成回绕模式)的参考实现
+  *             比较, PID_init与相同开关的PID_build比较, 状态须逐位相同
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "pid.h"
+#include "user_lib.h"
+#include "USER_Filter.h"
+#include "arm_math.h"
+#include <string.h>
+
+static const float32_t gains[3] = {2.0f, 0.5f, 1.0f};
+
+static uint32_t lcg_state = 1U;
+
+static float32_t rnd(float32_t lo, float32_t hi) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return lo + (hi - lo) * (float32_t) (lcg_state >> 8) / 16777216.0f;
+}
+
+/**
+  * @brief          改为按pid选择计算函数之前的ALL_PID, 回绕由参数给出而不是比较pid指针,
+  *                 reset_time为0时不检查暂停
+  */
+static float32_t ref_all_pid(pid_type_def *pid, float32_t ref, float32_t set, bool wrap, uint32_t reset_time) {
+    float32_t Dout_temp;
+    float32_t KF_temp = 0.0f;
+
+    if (reset_time && (HAL_GetTick() - pid->hal_tick) > reset_time &&
+        (HAL_GetTick() - pid->hal_tick) < 294967295) {
+        pid->last_get = ref;
+        pid->Iout = pid->out;
+        LimitMax(pid->Iout, pid->max_iout);
+    }
+    pid->set = set;
+    pid->get = ref;
+    if (wrap) {
+        pid->error[0] = jump_error(pid->set - pid->get, 2 * PI);
+    } else {
+        pid->error[0] = pid->set - pid->get;
+    }
+    if (pid->Variable_I) {
+        if ((pid->Variable_I_Down != 0.0 || pid->Variable_I_UP != 0.0) &&
+            (pid->Variable_I_UP - pid->Variable_I_Down > 0)) {
+            if (fabsf(1000.0f * pid->error[0]) < (1000.0f * pid->Variable_I_Down)) {
+                pid->I_ratio = 1.0f;
+            } else if (fabsf(pid->error[0]) > pid->Variable_I_UP) {
+                pid->I_ratio = 0.0f;
+            } else {
+                pid->I_ratio = ((1000.0f * pid->Variable_I_UP) - fabsf(1000.0f * pid->error[0])) /
+                               ((1000.0f * pid->Variable_I_UP) - (1000.0f * pid->Variable_I_Down));
+            }
+        } else {
+            pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
+        }
+        pid->Iout += pid->I_ratio * pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
+    } else {
+        pid->Iout += pid->Ki * (pid->error[0] + pid->error[1]) / 2.0f;
+    }
+    if (wrap) {
+        pid->Dbuf[0] = jump_error(pid->get - pid->last_get, 2 * PI);
+    } else {
+        pid->Dbuf[0] = pid->get - pid->last_get;
+    }
+    pid->Dbuf[2] = pid->Dbuf[1];
+    pid->Dbuf[1] = pid->Dbuf[0];
+    if (pid->D_First && !pid->NF_D) {
+        float32_t D_operator = pid->D_Filter_Ratio * pid->Kd + pid->Kp;
+        pid->D3 = pid->Kd / D_operator;
+        pid->D2 = (pid->Kd + pid->Kp) / D_operator;
+        pid->D1 = pid->D_Filter_Ratio * pid->D3;
+        Dout_temp = pid->D1 * pid->Dout_Last + pid->D2 * pid->get + pid->D3 * pid->last_get;
+    } else if (!pid->D_First && pid->NF_D) {
+        Dout_temp = pid->Kd * (1 - pid->D_Alpha) * pid->Dbuf[0] + pid->D_Alpha * pid->Dout_Last;
+    } else {
+        Dout_temp = pid->Kd * pid->Dbuf[0];
+    }
+    if (pid->D_Low_Pass) {
+        Filter_IIRLPF(Dout_temp, &pid->Dout, pid->D_Filter_Ratio);
+    } else {
+        Filter_IIRLPF(Dout_temp, &pid->Dout, 1.0f);
+    }
+    if (pid->D_Kalman.A == 1) {
+        KF_temp = KalmanFilter(&pid->D_Kalman, pid->Dout);
+    }
+    if (pid->D_Kalman.A == 1 && pid->D_KF) {
+        pid->Dout = KF_temp;
+    }
+    if (pid->P_On_M) {
+        pid->P_On_M_out -= pid->P_On_M_Ratio * pid->Kp * pid->Dbuf[0];
+        pid->Pout = (1 - pid->P_On_M_Ratio) * pid->Kp * pid->error[0] + pid->P_On_M_out;
+    } else {
+        pid->Pout = pid->Kp * pid->error[0];
+    }
+    LimitMax(pid->Iout, pid->max_iout);
+    if (fabsf(pid->error[0]) <= pid->Integral_Separation) {
+        pid->Iout = 0;
+        pid->out = (pid->Pout - pid->Dout);
+    } else {
+        pid->out = (pid->Pout + pid->Iout - pid->Dout);
+    }
+    LimitMax(pid->out, pid->max_out);
+    pid->last_get = pid->get;
+    pid->error[2] = pid->error[1];
+    pid->error[1] = pid->error[0];
+    pid->Dout_Last = pid->Dout;
+    pid->hal_tick = HAL_GetTick();
+    return pid->out;
+}
+
+/**
+  * @brief          比较两个pid的输出和状态, 返回不同的字段数
+  */
+static int pid_diff(const pid_type_def *a, const pid_type_def *b) {
+    return (a->out != b->out) + (a->Pout != b->Pout) + (a->Iout != b->Iout) + (a->Dout != b->Dout) +
+           (a->P_On_M_out != b->P_On_M_out) + (a->error[0] != b->error[0]) + (a->error[1] != b->error[1]) +
+           (a->Dbuf[0] != b->Dbuf[0]) + (a->Dbuf[1] != b->Dbuf[1]) + (a->last_get != b->last_get) +
+           (a->Dout_Last != b->Dout_Last);
+}
+
+/**
+  * @brief          设定值阶跃, 反馈跟随并带噪声, 回绕时反馈保持在-pi到pi并经常跨过±pi.
+  *                 偶尔暂停超过reset_time, 偶尔hal_tick晚于当前时间
+  */
+static void next_input(float32_t *ref, float32_t *set, bool wrap, int k) {
+    if (k % 97 == 0) {
+        *set = wrap ? rnd(-PI, PI) : rnd(-3.0f, 3.0f);
+    }
+    *ref += 0.08f * (*set - *ref) + rnd(-0.2f, 0.2f);
+    if (wrap) {
+        *ref = rad_format(*ref);
+    }
+    if (k % 631 == 630) {
+        host_tick += PID_RESET_TIME + 1U + (uint32_t) rnd(0.0f, 100.0f);
+    } else if (k % 877 == 876) {
+        host_tick -= 3U;
+    } else {
+        host_tick++;
+    }
+}
+
+static pid_config_t default_config(void) {
+    pid_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.mode = PID_POSITION;
+    config.max_out = 100.0f;
+    config.max_iout = 10.0f;
+    config.integral_separation = -1.0f;     //不分离
+    config.reset_time = PID_RESET_TIME;
+    return config;
+}
+
+static void test_calc_position(void) {
+    pid_type_def pid;
+    memset(&pid, 0, sizeof(pid));
+    PID_init(&pid, PID_POSITION, gains, 5.0f, 1.2f, 0.0f, false, 0, 0, false, 0, false, 0, false, 0, false, false, 0);
+
+    //P=2, I=0.5, D=1*(1-0)
+    TEST_ASSERT_NEAR(3.5f, PID_calc(&pid, 0.0f, 1.0f), 1e-6f);
+    TEST_ASSERT_NEAR(3.0f, PID_calc(&pid, 0.0f, 1.0f), 1e-6f);
+    //积分限幅1.2, 输出限幅5
+    PID_calc(&pid, 0.0f, 1.0f);
+    TEST_ASSERT_NEAR(1.2f, pid.Iout, 1e-6f);
+    TEST_ASSERT_NEAR(5.0f, PID_calc(&pid, 0.0f, 10.0f), 1e-6f);
+    TEST_ASSERT_NEAR(-5.0f, PID_calc(&pid, 0.0f, -10.0f), 1e-6f);
+
+    PID_clear(&pid);
+    TEST_ASSERT(pid.out == 0.0f && pid.Iout == 0.0f && pid.error[0] == 0.0f);
+}
+
+static void test_calc_delta(void) {
+    pid_type_def pid;
+    memset(&pid, 0, sizeof(pid));
+    PID_init(&pid, PID_DELTA, gains, 100.0f, 100.0f, 0.0f, false, 0, 0, false, 0, false, 0, false, 0, false, false, 0);
+
+    //增量: Kp*(e0-e1) + Ki*e0 + Kd*(e0-2e1+e2), 输出累加
+    TEST_ASSERT_NEAR(3.5f, PID_calc(&pid, 0.0f, 1.0f), 1e-6f);
+    TEST_ASSERT_NEAR(3.5f + 0.5f - 1.0f, PID_calc(&pid, 0.0f, 1.0f), 1e-6f);
+    TEST_ASSERT_NEAR(3.0f + 0.5f, PID_calc(&pid, 0.0f, 1.0f), 1e-6f);
+}
+
+static void test_all_pid_trapezoid(void) {
+    pid_type_def pid;
+    pid_config_t config = default_config();
+    memset(&pid, 0, sizeof(pid));
+    host_tick = 1000U;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == 0);
+
+    //梯形积分 Ki*(e0+e1)/2, 微分为反馈差分且从输出中减去
+    TEST_ASSERT_NEAR(2.0f + 0.25f, ALL_PID(&pid, 0.0f, 1.0f), 1e-6f);
+    host_tick++;
+    TEST_ASSERT_NEAR(2.0f * 0.5f + 0.25f + 0.5f * (0.5f + 1.0f) / 2.0f - 1.0f * 0.5f, ALL_PID(&pid, 0.5f, 1.0f),
+                     1e-6f);
+
+    //误差不大于积分分离值时积分清零
+    config.integral_separation = 0.1f;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == 0);
+    ALL_PID(&pid, 0.95f, 1.0f);
+    TEST_ASSERT(pid.Iout == 0.0f);
+}
+
+static void test_all_pid_matches_general(void) {
+    //普通开关组合的专用计算函数与PID_init得到的通用计算逐位相同
+    pid_type_def fast, general;
+    pid_config_t config = default_config();
+    memset(&fast, 0, sizeof(fast));
+    memset(&general, 0, sizeof(general));
+    config.integral = PID_INTEGRAL_VARIABLE;
+    config.variable_i_down = 0.2f;
+    config.variable_i_up = 1.5f;
+    host_tick = 2000U;
+    TEST_ASSERT(PID_build(&fast, gains, &config) == 0);
+    PID_init(&general, PID_POSITION, gains, 100.0f, 10.0f, -1.0f, true, 0.2f, 1.5f, false, 0, false, 0, false, 0,
+             false, false, 0);
+    //D_First打开后PID_refresh选择通用计算函数, 再关闭得到同样的参数而仍使用通用函数
+    general.D_First = true;
+    PID_refresh(&general);
+    general.D_First = false;
+    for (int i = 0; i < 500; i++) {
+        float32_t ref = 2.0f * arm_sin_f32(0.03f * (float32_t) i);
+        float32_t set = (i / 100) % 2 ? 1.0f : -1.0f;
+        host_tick++;
+        float32_t a = ALL_PID(&fast, ref, set);
+        float32_t b = ALL_PID(&general, ref, set);
+        if (a != b) {
+            TEST_ASSERT(a == b);
+            break;
+        }
+    }
+}
+
+static void test_wrap(void) {
+    pid_type_def pid;
+    pid_config_t config = default_config();
+    memset(&pid, 0, sizeof(pid));
+    config.wrap = PID_WRAP_ANGLE;
+    config.max_iout = 0.0f;
+    TEST_ASSERT(PID_build(&pid, (const float32_t[3]) {1.0f, 0.0f, 0.0f}, &config) == 0);
+
+    //跨过±pi的误差取短的方向
+    TEST_ASSERT_NEAR(-0.2f, ALL_PID(&pid, -PI + 0.1f, PI - 0.1f), 1e-5f);
+    TEST_ASSERT_NEAR(0.2f, ALL_PID(&pid, PI - 0.1f, -PI + 0.1f), 1e-5f);
+}
+
+static void test_restart_after_pause(void) {
+    pid_type_def pid;
+    pid_config_t config = default_config();
+    memset(&pid, 0, sizeof(pid));
+    host_tick = 5000U;
+    TEST_ASSERT(PID_build(&pid, (const float32_t[3]) {1.0f, 1.0f, 0.0f}, &config) == 0);
+    for (int i = 0; i < 20; i++) {
+        host_tick++;
+        ALL_PID(&pid, 0.0f, 0.3f);
+    }
+    float32_t out = pid.out;
+
+    //超过reset_time未计算, 积分从上次输出开始
+    host_tick += PID_RESET_TIME + 1U;
+    ALL_PID(&pid, 0.0f, 0.0f);
+    TEST_ASSERT_NEAR(out + 0.3f / 2.0f, pid.Iout, 1e-5f);
+
+    //hal_tick晚于当前时间(回绕前后)不视为暂停
+    pid.hal_tick = host_tick + 5U;
+    float32_t iout = pid.Iout;
+    ALL_PID(&pid, 0.0f, 0.0f);
+    TEST_ASSERT_NEAR(iout, pid.Iout, 1e-6f);
+}
+
+static void test_build_rejects(void) {
+    pid_type_def pid;
+    pid_config_t config;
+    memset(&pid, 0x5a, sizeof(pid));
+    pid_type_def before = pid;
+
+    config = default_config();
+    config.mode = 7;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == -1);
+    config = default_config();
+    config.integral = PID_INTEGRAL_VARIABLE;
+    config.variable_i_down = 1.0f;
+    config.variable_i_up = 1.0f;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == -1);
+    config = default_config();
+    config.derivative = PID_D_INCOMPLETE;
+    config.d_alpha = 1.5f;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == -1);
+    config = default_config();
+    config.max_out = -1.0f;
+    TEST_ASSERT(PID_build(&pid, gains, &config) == -1);
+    TEST_ASSERT(PID_build(&pid, gains, NULL) == -1);
+    TEST_ASSERT(memcmp(&pid, &before, sizeof(pid)) == 0);
+}
+
+static void test_build_matches_reference(void) {
+    //回绕 x 积分 x 微分 x 低通 x P_On_M x 卡尔曼 x reset_time
+    const pid_config_t base = default_config();
+    float32_t (*general_step)(pid_type_def *, float32_t, float32_t);
+    pid_type_def pid, ref_pid;
+    pid_config_t config;
+    float32_t gain[3];
+    int combo_num = 0, plain_num = 0, diff_combo = 0;
+
+    //D_First总是使用通用计算函数
+    config = base;
+    config.derivative = PID_D_FIRST;
+    config.d_filter_ratio = 0.5f;
+    memset(&pid, 0, sizeof(pid));
+    TEST_ASSERT(PID_build(&pid, gains, &config) == 0);
+    general_step = pid.step;
+
+    host_tick = 10000U;
+    for (int combo = 0; combo < 192; combo++) {
+        int derivative = (combo / 4) % 3;
+        float32_t ref = 0.0f, set = 0.0f;
+        int diff = 0;
+
+        config = base;
+        config.wrap = (combo & 0x01) ? PID_WRAP_ANGLE : PID_WRAP_NONE;
+        config.integral = (combo & 0x02) ? PID_INTEGRAL_VARIABLE : PID_INTEGRAL_TRAPEZOID;
+        config.variable_i_down = 0.1f;
+        config.variable_i_up = 0.8f;
+        config.derivative = (uint8_t) derivative;
+        config.d_filter_ratio = 0.3f;
+        config.d_alpha = 0.6f;
+        config.d_low_pass = (combo / 12) % 2;
+        config.p_on_m = (combo / 24) % 2;
+        config.p_on_m_ratio = 0.4f;
+        config.d_kalman = (combo / 48) % 2;
+        config.reset_time = ((combo / 96) % 2) ? 0U : PID_RESET_TIME;
+        config.integral_separation = (combo % 5 == 0) ? 0.05f : -1.0f;
+        config.max_out = rnd(5.0f, 50.0f);
+        config.max_iout = rnd(1.0f, 10.0f);
+        gain[0] = rnd(0.5f, 10.0f);
+        gain[1] = rnd(0.0f, 1.0f);
+        gain[2] = rnd(0.0f, 3.0f);
+
+        memset(&pid, 0, sizeof(pid));
+        TEST_ASSERT(PID_build(&pid, gain, &config) == 0);
+        if (config.d_kalman) {
+            KalmanCreate(&pid.D_Kalman, 1.0f, 20.0f);
+        }
+        //专用计算函数只用于梯形积分或变积分加普通微分
+        if (derivative == PID_D_NORMAL && !config.d_low_pass && !config.p_on_m && !config.d_kalman) {
+            TEST_ASSERT(pid.step != general_step);
+            plain_num++;
+        } else {
+            TEST_ASSERT(pid.step == general_step);
+        }
+        ref_pid = pid;
+        for (int k = 0; k < 3000; k++) {
+            next_input(&ref, &set, config.wrap == PID_WRAP_ANGLE, k);
+            ALL_PID(&pid, ref, set);
+            ref_all_pid(&ref_pid, ref, set, config.wrap == PID_WRAP_ANGLE, config.reset_time);
+            diff += pid_diff(&pid, &ref_pid);
+        }
+        if (diff != 0) {
+            printf("combo %d: %d fields differ\n", combo, diff);
+            diff_combo++;
+        }
+        combo_num++;
+    }
+    printf("%d combinations, %d on the specialised steps\n", combo_num, plain_num);
+    TEST_ASSERT(diff_combo == 0);
+    TEST_ASSERT(plain_num == 8);
+}
+
+static void test_init_matches_build(void) {
+    //PID_init等于不回绕、reset_time为PID_RESET_TIME的PID_build, 不设置P_On_M
+    pid_type_def a, b;
+    pid_config_t config;
+    int diff = 0;
+
+    host_tick = 20000U;
+    for (int combo = 0; combo < 12; combo++) {
+        float32_t ref = 0.0f, set = 0.0f;
+        bool variable_i = combo & 0x01;
+        int derivative = (combo / 2) % 3;
+        bool low_pass = (combo / 6) % 2;
+
+        config = default_config();
+        config.integral = variable_i ? PID_INTEGRAL_VARIABLE : PID_INTEGRAL_TRAPEZOID;
+        config.variable_i_down = 0.1f;
+        config.variable_i_up = 0.8f;
+        config.derivative = (uint8_t) derivative;
+        config.d_filter_ratio = 0.3f;
+        config.d_alpha = 0.6f;
+        config.d_low_pass = low_pass;
+        memset(&a, 0, sizeof(a));
+        memset(&b, 0, sizeof(b));
+        TEST_ASSERT(PID_build(&a, gains, &config) == 0);
+        PID_init(&b, PID_POSITION, gains, config.max_out, config.max_iout, config.integral_separation, variable_i,
+                 0.1f, 0.8f, derivative == PID_D_FIRST, 0.3f, low_pass, 0.3f, derivative == PID_D_INCOMPLETE, 0.6f,
+                 false, false, 0.0f);
+        TEST_ASSERT(b.wrap == PID_WRAP_NONE && b.reset_time == PID_RESET_TIME);
+        for (int k = 0; k < 2000; k++) {
+            next_input(&ref, &set, false, k);
+            ALL_PID(&a, ref, set);
+            ALL_PID(&b, ref, set);
+            diff += pid_diff(&a, &b);
+        }
+    }
+    TEST_ASSERT(diff == 0);
+}
+
+int main(void) {
+    RUN_TEST(test_calc_position);
+    RUN_TEST(test_calc_delta);
+    RUN_TEST(test_all_pid_trapezoid);
+    RUN_TEST(test_all_pid_matches_general);
+    RUN_TEST(test_wrap);
+    RUN_TEST(test_restart_after_pause);
+    RUN_TEST(test_build_rejects);
+    RUN_TEST(test_build_matches_reference);
+    RUN_TEST(test_init_matches_build);
+    return unit_test_result();
+}
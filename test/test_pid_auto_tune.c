@@ -0,0 +1,93 @@
+/**
+  * @file       test_pid_auto_tune.c
+  * @brief      relay auto tuning on a first order plus dead time plant, the
+  *             gain agrees with the exact relay oscillation and the period
+  *             with the analytic ultimate period.
+  *             一阶惯性加纯滞后对象上的继电自整定, 增益与精确的继电振荡相符, 周期与解析的临界周期相符
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "PID_AutoTune.h"
+#include "arm_math.h"
+#include <string.h>
+
+#define PLANT_TAU       5.0f        //s
+#define PLANT_DELAY_MS  2000        //ms
+#define PLANT_GAIN      1.0f
+
+static float32_t delay_line[PLANT_DELAY_MS];
+
+//atan(w*tau) + w*L = pi 的根, 二分法
+static float32_t ultimate_frequency(void) {
+    float32_t lo = 0.01f, hi = 10.0f;
+    for (int i = 0; i < 60; i++) {
+        float32_t w = 0.5f * (lo + hi);
+        if (atanf(w * PLANT_TAU) + w * PLANT_DELAY_MS / 1000.0f > PI) {
+            hi = w;
+        } else {
+            lo = w;
+        }
+    }
+    return 0.5f * (lo + hi);
+}
+
+static void test_relay_fopdt(void) {
+    const float32_t setpoint = 10.0f;
+    float32_t input = setpoint, output = 0.0f;
+    pid_auto_tune_t tune;
+    memset(&tune, 0, sizeof(tune));
+    host_tick = 1U;
+    //从稳态开始, 2s回看窗口, 250ms采样
+    pid_auto_tune_init(&tune, &input, &output, USE_PID, 0.05f, 2.0f, 2, setpoint, setpoint / PLANT_GAIN,
+                       SPEED_TO_CURRENT, 0);
+    for (int i = 0; i < PLANT_DELAY_MS; i++) {
+        delay_line[i] = setpoint / PLANT_GAIN;
+    }
+
+    bool_t done = 0;
+    uint32_t step;
+    for (step = 0; step < 400000U && !done; step++) {
+        host_tick++;
+        done = pid_auto_tune_runtime(&tune);
+        float32_t delayed = delay_line[step % PLANT_DELAY_MS];
+        delay_line[step % PLANT_DELAY_MS] = output;
+        input += (PLANT_GAIN * delayed - input) * 0.001f / PLANT_TAU;
+    }
+    TEST_ASSERT(done);
+    TEST_ASSERT(!tune.running);
+    TEST_ASSERT(output == 0.0f);
+
+    //继电振荡的精确幅值为K*d*(1-exp(-L/tau)), 自整定按描述函数4d/(pi*a)换算, 回差和250ms采样使幅值略大
+    float32_t amplitude = PLANT_GAIN * 2.0f * (1.0f - expf(-PLANT_DELAY_MS / 1000.0f / PLANT_TAU));
+    float32_t ku_relay = 4.0f * 2.0f / (PI * amplitude);
+    TEST_ASSERT_NEAR(ku_relay, tune.Ku, 0.15f * ku_relay);
+    //与解析的临界增益相比, 描述函数近似在该滞后比下偏小约20%
+    float32_t w = ultimate_frequency();
+    float32_t ku = sqrtf(1.0f + (w * PLANT_TAU) * (w * PLANT_TAU)) / PLANT_GAIN;
+    float32_t pu = 2.0f * PI / w;
+    TEST_ASSERT(tune.Ku < ku && tune.Ku > 0.7f * ku);
+    TEST_ASSERT_NEAR(pu, tune.Pu, 0.2f * pu);
+
+    //Ziegler-Nichols PID
+    TEST_ASSERT_NEAR(0.6f * tune.Ku, pid_auto_tune_getKp(&tune), 1e-6f);
+    TEST_ASSERT_NEAR(1.2f * tune.Ku / tune.Pu, pid_auto_tune_getKi(&tune), 1e-6f);
+    TEST_ASSERT_NEAR(0.075f * tune.Ku * tune.Pu, pid_auto_tune_getKd(&tune), 1e-6f);
+}
+
+static void test_lookback(void) {
+    pid_auto_tune_t tune;
+    memset(&tune, 0, sizeof(tune));
+    pid_auto_tune_setLookbackSec(&tune, 10);
+    TEST_ASSERT(tune.nLookBack == 40 && tune.sampleTime == 250);
+    TEST_ASSERT(pid_auto_tune_getLookbackSec(&tune) == 10);
+    pid_auto_tune_setLookbackSec(&tune, 30);
+    TEST_ASSERT(tune.nLookBack == 100 && tune.sampleTime == 300);
+    pid_auto_tune_setLookbackSec(&tune, 0);
+    TEST_ASSERT(tune.nLookBack == 4);
+}
+
+int main(void) {
+    RUN_TEST(test_relay_fopdt);
+    RUN_TEST(test_lookback);
+    return unit_test_result();
+}
@@ -0,0 +1,336 @@
+/**
+  * @file       test_pid_batch.c
+  * @brief      pid_batch against ALL_PID on the same pids: every combination of
+  *             wrap, variable integral, incomplete derivative and D low pass
+  *             for 1 to 4 lanes, with random gains and integral separation,
+  *             gain reloads, pauses that restart the integral and outputs
+  *             rescaled the way chassis_power_control does. The state of every
+  *             lane has to be bit-identical. Then the limit flags, the rejected
+  *             configurations and a cycle benchmark of the wheel loops.
+  *             pid_batch与对同一组pid调用ALL_PID比较: 回绕、变积分、不完全微分和微分低通的所有组合,
+  *             1到4个通道, 随机增益和积分分离, 重新加载增益、暂停后积分重新开始, 并像
+  *             chassis_power_control一样缩放输出.每个通道的状态须逐位相同.另外检查限幅标志、
+  *             拒绝的配置以及底盘电机速度环的计算时间
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "pid_batch.h"
+#include "arm_math.h"
+#include <string.h>
+
+#define STEP_NUM        4000
+
+static uint32_t lcg_state = 1U;
+
+static float32_t rnd(float32_t lo, float32_t hi) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return lo + (hi - lo) * (float32_t) (lcg_state >> 8) / 16777216.0f;
+}
+
+static uint32_t rnd_int(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+static pid_config_t combo_config(uint8_t combo) {
+    pid_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.mode = PID_POSITION;
+    config.wrap = (combo & 0x01) ? PID_WRAP_ANGLE : PID_WRAP_NONE;
+    config.integral = (combo & 0x02) ? PID_INTEGRAL_VARIABLE : PID_INTEGRAL_TRAPEZOID;
+    config.variable_i_down = 0.2f;
+    config.variable_i_up = 1.2f;
+    config.derivative = (combo & 0x04) ? PID_D_INCOMPLETE : PID_D_NORMAL;
+    config.d_alpha = 0.3f;
+    config.d_low_pass = (combo & 0x08) ? 1 : 0;
+    config.d_filter_ratio = 0.4f;
+    config.reset_time = PID_RESET_TIME;
+    return config;
+}
+
+static void random_gain(pid_type_def *pid) {
+    pid->Kp = rnd(0.0f, 20.0f);
+    pid->Ki = rnd(0.0f, 2.0f);
+    pid->Kd = rnd(0.0f, 5.0f);
+    pid->max_out = rnd(5.0f, 50.0f);
+    pid->max_iout = rnd(1.0f, 20.0f);
+    //一半的通道不分离积分
+    pid->Integral_Separation = (rnd_int(2) == 0U) ? -1.0f : rnd(0.01f, 0.3f);
+}
+
+/**
+  * @brief          比较一个通道与对应pid的状态, 返回不同的字段数
+  */
+static int lane_diff(const pid_batch_t *batch, uint8_t i, const pid_type_def *pid) {
+    return (batch->out[i] != pid->out) + (batch->pout[i] != pid->Pout) + (batch->iout[i] != pid->Iout) +
+           (batch->dout[i] != pid->Dout) + (batch->dbuf[i] != pid->Dbuf[0]) + (batch->error[i] != pid->error[0]) +
+           (batch->last_error[i] != pid->error[1]) + (batch->last_get[i] != pid->last_get);
+}
+
+/**
+  * @brief          限幅标志与计算结果一致
+  */
+static int lane_flag_ok(const pid_batch_t *batch, uint8_t i) {
+    uint8_t limit = batch->limit[i];
+
+    if ((limit & PID_BATCH_OUT_LIMIT) ? fabsf(batch->out[i]) != batch->max_out[i] :
+        fabsf(batch->out[i]) > batch->max_out[i]) {
+        return 0;
+    }
+    if (((limit & PID_BATCH_I_SEPARATE) != 0U) != (fabsf(batch->error[i]) <= batch->separation[i])) {
+        return 0;
+    }
+    if ((limit & PID_BATCH_I_SEPARATE) && batch->iout[i] != 0.0f) {
+        return 0;
+    }
+    if ((limit & PID_BATCH_IOUT_LIMIT) && !(limit & PID_BATCH_I_SEPARATE) &&
+        fabsf(batch->iout[i]) != batch->max_iout[i]) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+  * @brief          一种开关组合和通道数, 返回不同的字段数
+  */
+static int run_combo(uint8_t combo, uint8_t lane_num, uint32_t *flag_bad, uint32_t *restart_num) {
+    pid_config_t config = combo_config(combo);
+    pid_type_def pid[PID_BATCH_MAX_LANE];
+    const pid_type_def *lane[PID_BATCH_MAX_LANE];
+    pid_batch_t batch;
+    float32_t get[PID_BATCH_MAX_LANE], set[PID_BATCH_MAX_LANE];
+    const float32_t gain[3] = {1.0f, 0.1f, 0.0f};
+    float32_t range = (config.wrap == PID_WRAP_ANGLE) ? PI : 3.0f;
+    int diff = 0;
+    uint8_t i;
+
+    for (i = 0; i < lane_num; i++) {
+        TEST_ASSERT(PID_build(&pid[i], gain, &config) == 0);
+        random_gain(&pid[i]);
+        lane[i] = &pid[i];
+        get[i] = 0.0f;
+        set[i] = 0.0f;
+    }
+    TEST_ASSERT(pid_batch_init(&batch, lane, lane_num) == 0);
+
+    for (uint32_t k = 0; k < STEP_NUM; k++) {
+        uint32_t event = rnd_int(200);
+
+        if (event == 0U) {
+            //暂停超过reset_time, 积分从输出重新开始
+            host_tick += PID_RESET_TIME + 1U + rnd_int(200);
+            (*restart_num)++;
+        } else {
+            host_tick++;
+        }
+        if (event == 1U) {
+            //参数表写入新增益后重新加载
+            i = (uint8_t) rnd_int(lane_num);
+            random_gain(&pid[i]);
+            TEST_ASSERT(pid_batch_load(&batch, i, &pid[i]) == 0);
+        }
+        for (i = 0; i < lane_num; i++) {
+            if (rnd_int(50) == 0U) {
+                set[i] = rnd(-range, range);
+            }
+            get[i] += rnd(-0.15f, 0.15f) + 0.05f * (set[i] - get[i]);
+            if (config.wrap == PID_WRAP_ANGLE) {
+                get[i] = rad_format(get[i]);
+            }
+        }
+
+        pid_batch_calc(&batch, get, set);
+        for (i = 0; i < lane_num; i++) {
+            ALL_PID(&pid[i], get[i], set[i]);
+            diff += lane_diff(&batch, i, &pid[i]);
+            if (!lane_flag_ok(&batch, i)) {
+                (*flag_bad)++;
+            }
+        }
+
+        if (event == 2U) {
+            //功率控制按比例缩小输出
+            float32_t scale = rnd(0.2f, 1.0f);
+            for (i = 0; i < lane_num; i++) {
+                batch.out[i] *= scale;
+                pid[i].out *= scale;
+            }
+        }
+    }
+    return diff;
+}
+
+static void test_equivalence(void) {
+    uint32_t flag_bad = 0U, restart_num = 0U, case_num = 0U;
+    int diff;
+
+    host_tick = 1000U;
+    for (uint8_t combo = 0; combo < 16; combo++) {
+        for (uint8_t lane_num = 1; lane_num <= PID_BATCH_MAX_LANE; lane_num++) {
+            diff = run_combo(combo, lane_num, &flag_bad, &restart_num);
+            if (diff != 0) {
+                printf("combo %d (wrap %d variable_i %d nf_d %d low_pass %d) lanes %d: %d fields differ\n", combo,
+                       combo & 1, (combo >> 1) & 1, (combo >> 2) & 1, (combo >> 3) & 1, lane_num, diff);
+            }
+            TEST_ASSERT(diff == 0);
+            case_num++;
+        }
+    }
+    printf("%u cases, %u lane steps, %u restarts\n", case_num, case_num * STEP_NUM * 5U / 2U, restart_num);
+    TEST_ASSERT(flag_bad == 0U);
+    TEST_ASSERT(restart_num > 0U);
+}
+
+static void test_chassis_init(void) {
+    //chassis_init的PID_init配置, 积分分离1000即速度环实际为PD
+    const float32_t motor_speed_pid[3] = {8000.0f, 10.0f, 0.0f};
+    pid_type_def pid[4];
+    const pid_type_def *lane[4] = {&pid[0], &pid[1], &pid[2], &pid[3]};
+    pid_batch_t batch;
+    float32_t get[4] = {0}, set[4] = {0};
+    int diff = 0;
+
+    for (int i = 0; i < 4; i++) {
+        memset(&pid[i], 0, sizeof(pid_type_def));
+        PID_init(&pid[i], PID_POSITION, motor_speed_pid, 16000.0f, 2000.0f, 1000.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                 0);
+    }
+    TEST_ASSERT(pid_batch_init(&batch, lane, 4) == 0);
+    for (int k = 0; k < 2000; k++) {
+        host_tick++;
+        for (int i = 0; i < 4; i++) {
+            set[i] = ((k / 300) % 2) ? 1.5f : -0.5f * (float32_t) i;
+            get[i] += 0.02f * (set[i] - get[i]) + rnd(-0.01f, 0.01f);
+        }
+        pid_batch_calc(&batch, get, set);
+        for (int i = 0; i < 4; i++) {
+            ALL_PID(&pid[i], get[i], set[i]);
+            diff += lane_diff(&batch, (uint8_t) i, &pid[i]);
+        }
+    }
+    TEST_ASSERT(diff == 0);
+}
+
+static void test_rejects(void) {
+    pid_config_t config = combo_config(0);
+    const float32_t gain[3] = {1.0f, 0.1f, 0.2f};
+    pid_type_def a, b;
+    const pid_type_def *lane[2] = {&a, &b};
+    pid_batch_t batch;
+
+    TEST_ASSERT(PID_build(&a, gain, &config) == 0);
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 0) == -1);
+    TEST_ASSERT(pid_batch_init(&batch, lane, PID_BATCH_MAX_LANE + 1) == -1);
+    TEST_ASSERT(pid_batch_init(NULL, lane, 2) == -1);
+    //不存在的通道
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == 0);
+    TEST_ASSERT(pid_batch_load(&batch, 2, &a) == -1);
+
+    //不支持的开关
+    config.derivative = PID_D_FIRST;
+    config.d_filter_ratio = 0.5f;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0);
+    config.p_on_m = 1;
+    config.p_on_m_ratio = 0.5f;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0);
+    config.mode = PID_DELTA;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    //卡尔曼创建后才生效
+    config = combo_config(0);
+    config.d_kalman = 1;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    b.D_Kalman.A = 0.0f;
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == 0);
+    b.D_Kalman.A = 1.0f;
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+
+    //各通道的开关须相同
+    config = combo_config(0x01);
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0);
+    config.reset_time = 0U;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0x08);
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0x02);
+    TEST_ASSERT(PID_build(&a, gain, &config) == 0);
+    config.variable_i_up = 2.0f;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+    config = combo_config(0x04);
+    TEST_ASSERT(PID_build(&a, gain, &config) == 0);
+    config.d_alpha = 0.5f;
+    TEST_ASSERT(PID_build(&b, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 2) == -1);
+
+    //变积分上下限无效时ALL_PID积分累加两次, 不支持
+    a.Variable_I = 1;
+    a.NF_D = 0;
+    a.Variable_I_Down = a.Variable_I_UP = 0.0f;
+    TEST_ASSERT(pid_batch_init(&batch, lane, 1) == -1);
+
+    //加载开关不同的pid被拒绝, 原增益不变
+    config = combo_config(0);
+    TEST_ASSERT(PID_build(&a, gain, &config) == 0);
+    TEST_ASSERT(pid_batch_init(&batch, lane, 1) == 0);
+    config.wrap = PID_WRAP_ANGLE;
+    TEST_ASSERT(PID_build(&b, (const float32_t[3]) {9.0f, 9.0f, 9.0f}, &config) == 0);
+    TEST_ASSERT(pid_batch_load(&batch, 0, &b) == -1);
+    TEST_ASSERT(batch.kp[0] == gain[0] && batch.ki[0] == gain[1] && batch.kd[0] == gain[2]);
+}
+
+static void test_benchmark(void) {
+    //chassis_init的底盘电机速度环, 四个通道
+    const float32_t motor_speed_pid[3] = {8000.0f, 10.0f, 0.0f};
+    pid_type_def pid[4];
+    const pid_type_def *lane[4] = {&pid[0], &pid[1], &pid[2], &pid[3]};
+    pid_batch_t batch;
+    float32_t get[4], set[4] = {0.5f, -0.5f, 0.3f, -0.3f};
+    volatile float32_t sink = 0.0f;
+    const int rounds = 1000000;
+
+    for (int i = 0; i < 4; i++) {
+        memset(&pid[i], 0, sizeof(pid_type_def));
+        PID_init(&pid[i], PID_POSITION, motor_speed_pid, 16000.0f, 2000.0f, 1000.0f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                 0);
+        get[i] = 0.0f;
+    }
+    TEST_ASSERT(pid_batch_init(&batch, lane, 4) == 0);
+
+    uint64_t start = unit_test_now_ns();
+    for (int k = 0; k < rounds; k++) {
+        get[k & 3] += 1e-6f;
+        sink += pid_batch_calc(&batch, get, set)[0];
+    }
+    uint64_t batch_ns = unit_test_now_ns() - start;
+    start = unit_test_now_ns();
+    for (int k = 0; k < rounds; k++) {
+        get[k & 3] += 1e-6f;
+        for (int i = 0; i < 4; i++) {
+            sink += ALL_PID(&pid[i], get[i], set[i]);
+        }
+    }
+    uint64_t all_pid_ns = unit_test_now_ns() - start;
+    (void) sink;
+    printf("4 lanes: pid_batch %.1f ns/cycle, 4x ALL_PID %.1f ns/cycle\n", (double) batch_ns / rounds,
+           (double) all_pid_ns / rounds);
+}
+
+int main(void) {
+    RUN_TEST(test_equivalence);
+    RUN_TEST(test_chassis_init);
+    RUN_TEST(test_rejects);
+    RUN_TEST(test_benchmark);
+    return unit_test_result();
+}
@@ -0,0 +1,329 @@
+/**
+  * @file       test_power_limiter.c
+  * @brief      power_limiter budget and scaling checks, and a 1 ms chassis
+  *             simulation fed from a drive log (test/data/chassis_drive_log.txt)
+  *             with slow, late referee packets and a motor plant that differs
+  *             from the nominal model. The limiter is compared with the total
+  *             current thresholds it replaced on buffer-empty penalty events and
+  *             on wheel speed tracking, also with the super capacitor.
+  *             power_limiter预算和缩放检查, 以及由驾驶记录驱动的1ms底盘仿真: 裁判数据慢且滞后,
+  *             电机与标称模型不同.与被替换的总电流阈值做法比较缓冲能量耗尽的惩罚次数和轮速跟踪,
+  *             以及使用超级电容的情况
+  */
+#include "unit_test.h"
+#include "power_limiter.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define WHEEL_NUM       4
+#define DT              0.001f
+#define LOG_ROW_MAX     4000
+//与chassis_power_control.h相同的参数
+#define CURRENT_TO_A    (20.0f / 16384.0f)
+#define TORQUE_CONSTANT (0.3f * 187.0f / 3591.0f)
+static const power_limiter_param_t chassis_param = {
+        .torque_constant = TORQUE_CONSTANT,
+        .resistance = 0.2f,
+        .speed_loss = 1.0e-5f,
+        .static_power = 3.0f,
+        .buffer_max = 60.0f,
+        .buffer_reserve = 10.0f,
+        .spend_time = 0.2f,
+        .recover_time = 1.0f,
+        .cap_spend_time = 2.0f,
+        .cap_power_max = 200.0f,
+        .correction_min = 0.5f,
+        .correction_max = 2.0f,
+};
+#define CAP_FARAD       6.0f
+#define CAP_MIN_VOLTAGE 12.0f
+
+//实际电机: 铜损、静态功率和转速损耗都比标称模型大
+#define PLANT_RESISTANCE    0.26f
+#define PLANT_SPEED_LOSS    1.3e-5f
+#define PLANT_STATIC_POWER  4.5f
+//转子侧等效转动惯量(含折算的车体质量)和粘滞摩擦
+#define PLANT_INERTIA       5.9e-5f
+#define PLANT_DAMPING       2.0e-5f
+//麦轮半径 m, 减速比, 轮距的一半之和 m
+#define WHEEL_RADIUS        0.076f
+#define GEAR_RATIO          (3591.0f / 187.0f)
+#define WHEEL_BASE          0.4f
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+static float plant_power(const float *current, const float *speed) {
+    float power = PLANT_STATIC_POWER;
+    for (int k = 0; k < WHEEL_NUM; k++) {
+        power += TORQUE_CONSTANT * current[k] * speed[k] + PLANT_RESISTANCE * current[k] * current[k] +
+                 PLANT_SPEED_LOSS * speed[k] * speed[k];
+    }
+    return power;
+}
+
+static float model_power(const float *current, const float *speed) {
+    float power = chassis_param.static_power;
+    for (int k = 0; k < WHEEL_NUM; k++) {
+        power += chassis_param.torque_constant * current[k] * speed[k] +
+                 chassis_param.resistance * current[k] * current[k] + chassis_param.speed_loss * speed[k] * speed[k];
+    }
+    return power;
+}
+
+static void test_budget(void) {
+    power_limiter_t limiter;
+    power_limiter_init(&limiter, &chassis_param);
+    TEST_ASSERT(limiter.buffer == 60.0f && limiter.correction == 1.0f);
+    //满缓冲在spend_time内用到保留值
+    TEST_ASSERT_NEAR(power_limiter_budget(&limiter, 40.0f, 0.0f), 40.0f + 50.0f / 0.2f, 1e-3f);
+    //低于保留值时在recover_time内补回
+    power_limiter_referee_update(&limiter, 40.0f, 4.0f);
+    TEST_ASSERT_NEAR(power_limiter_budget(&limiter, 40.0f, 0.0f), 34.0f, 1e-4f);
+    //超级电容: 可用能量在cap_spend_time内用完, 不超过最大放电功率
+    TEST_ASSERT_NEAR(power_limiter_budget(&limiter, 40.0f, 100.0f), 84.0f, 1e-4f);
+    TEST_ASSERT_NEAR(power_limiter_budget(&limiter, 40.0f, 1000.0f), 234.0f, 1e-4f);
+    TEST_ASSERT(limiter.cap_power == 200.0f);
+    power_limiter_referee_update(&limiter, 40.0f, 0.0f);
+    TEST_ASSERT(power_limiter_budget(&limiter, 0.0f, 0.0f) == 0.0f);
+}
+
+static void test_scaling(void) {
+    power_limiter_t limiter;
+    power_limiter_init(&limiter, &chassis_param);
+    power_limiter_referee_update(&limiter, 40.0f, 10.0f);
+    power_limiter_budget(&limiter, 40.0f, 0.0f);
+
+    //预算足够时不缩放
+    float current[WHEEL_NUM] = {1.0f, -1.0f, 1.0f, -1.0f};
+    float speed[WHEEL_NUM] = {100.0f, -100.0f, 100.0f, -100.0f};
+    TEST_ASSERT(power_limiter_apply(&limiter, current, speed, WHEEL_NUM, 40.0f, DT) == 1.0f);
+    TEST_ASSERT(current[0] == 1.0f && limiter.limit_cnt == 0);
+
+    //两个轮子加速, 两个轮子制动: 只缩放加速的轮子, 缩放后的预测功率等于预算
+    float brake_current = -8.0f;
+    for (int round = 0; round < 50; round++) {
+        float c[WHEEL_NUM] = {15.0f, 12.0f, brake_current, brake_current};
+        float s[WHEEL_NUM] = {300.0f + (float) rnd(400), 300.0f, 500.0f, 200.0f + (float) rnd(300)};
+        float budget = 20.0f + (float) rnd(100);
+        limiter.budget = budget;
+        limiter.correction = 0.8f + 0.01f * (float) rnd(40);
+        float scale = power_limiter_apply(&limiter, c, s, WHEEL_NUM, 40.0f, DT);
+        TEST_ASSERT(c[2] == brake_current && c[3] == brake_current);
+        TEST_ASSERT_NEAR(c[0], 15.0f * scale, 1e-4f);
+        if (scale > 0.0f && scale < 1.0f) {
+            TEST_ASSERT_NEAR(limiter.correction * model_power(c, s), budget, 1e-2f * budget);
+        }
+        TEST_ASSERT_NEAR(limiter.power, limiter.correction * model_power(c, s), 1e-3f * limiter.power + 1e-3f);
+    }
+
+    //制动功率和转速损耗已超过预算时加速的轮子电流为0
+    float c[WHEEL_NUM] = {10.0f, 0.0f, 0.0f, 0.0f};
+    float s[WHEEL_NUM] = {800.0f, 800.0f, 800.0f, 800.0f};
+    limiter.budget = 5.0f;
+    limiter.correction = 1.0f;
+    TEST_ASSERT(power_limiter_apply(&limiter, c, s, WHEEL_NUM, 40.0f, DT) == 0.0f && c[0] == 0.0f);
+}
+
+typedef struct {
+    float vx, vy, wz, limit;
+} drive_row_t;
+
+static drive_row_t drive_log[LOG_ROW_MAX];
+static int drive_log_len;
+
+static int load_drive_log(void) {
+    FILE *file = fopen(CHASSIS_DRIVE_LOG, "r");
+    char line[128];
+    if (file == NULL) {
+        return -1;
+    }
+    drive_log_len = 0;
+    while (fgets(line, sizeof(line), file) != NULL && drive_log_len < LOG_ROW_MAX) {
+        int ms;
+        drive_row_t row;
+        if (line[0] == '#' || sscanf(line, "%d %f %f %f %f", &ms, &row.vx, &row.vy, &row.wz, &row.limit) != 5) {
+            continue;
+        }
+        drive_log[drive_log_len++] = row;
+    }
+    fclose(file);
+    return 0;
+}
+
+typedef enum {
+    LIMIT_LEGACY = 0,
+    LIMIT_MODEL,
+} limit_mode_e;
+
+typedef struct {
+    uint32_t penalty;           //缓冲能量耗尽的次数
+    float buffer_min;
+    double speed_rms;           //轮速跟踪误差 rad/s
+    double mean_power;
+    double model_error;         //校正后模型功率与实际功率的平均相对误差
+    float correction;
+} sim_result_t;
+
+//被替换的做法: 由裁判功率和缓冲能量按固定阈值限制总电流
+static void legacy_limit(float *out, float referee_power, float referee_buffer, float limit) {
+    float total_limit, total = 0.0f;
+    if (referee_buffer < 60.0f) {
+        total_limit = 16000.0f * (referee_buffer > 6.0f ? referee_buffer / 60.0f : 0.1f);
+    } else if (referee_power > limit - 10.0f) {
+        total_limit = 16000.0f + 20000.0f * (referee_power < limit ? (limit - referee_power) / 10.0f : 0.0f);
+    } else {
+        total_limit = 36000.0f;
+    }
+    for (int k = 0; k < WHEEL_NUM; k++) {
+        total += fabsf(out[k]);
+    }
+    if (total > total_limit) {
+        for (int k = 0; k < WHEEL_NUM; k++) {
+            out[k] *= total_limit / total;
+        }
+    }
+}
+
+static void chassis_sim(limit_mode_e mode, uint32_t referee_period_ms, float cap_voltage, sim_result_t *result) {
+    //麦轮逆解的符号
+    static const float sign_x[WHEEL_NUM] = {1.0f, -1.0f, 1.0f, -1.0f};
+    static const float sign_y[WHEEL_NUM] = {1.0f, 1.0f, -1.0f, -1.0f};
+    power_limiter_t limiter;
+    power_limiter_init(&limiter, &chassis_param);
+    lcg_state = 7U;
+
+    float speed[WHEEL_NUM] = {0}, buffer = 60.0f, cap_energy = 0.0f;
+    float referee_power = 0.0f, referee_buffer = 60.0f, pending_power = 0.0f, pending_buffer = 60.0f;
+    double power_acc = 0.0, power_sum = 0.0, err_sum = 0.0, model_err_sum = 0.0;
+    uint32_t power_num = 0, pending_at = 0xFFFFFFFFU, model_err_num = 0;
+    bool in_penalty = false;
+    if (cap_voltage > CAP_MIN_VOLTAGE) {
+        cap_energy = 0.5f * CAP_FARAD * (cap_voltage * cap_voltage - CAP_MIN_VOLTAGE * CAP_MIN_VOLTAGE);
+    }
+    memset(result, 0, sizeof(*result));
+    result->buffer_min = buffer;
+
+    uint32_t duration = (uint32_t) drive_log_len * 10U;
+    for (uint32_t t = 0; t < duration; t++) {
+        const drive_row_t *row = &drive_log[t / 10U];
+        float current[WHEEL_NUM], set[WHEEL_NUM];
+        //底盘速度环: 比例控制到3508电流值
+        for (int k = 0; k < WHEEL_NUM; k++) {
+            set[k] = (sign_x[k] * row->vx + sign_y[k] * row->vy - row->wz * WHEEL_BASE) / WHEEL_RADIUS * GEAR_RATIO;
+            float out = 120.0f * (set[k] - speed[k]);
+            current[k] = fmaxf(-16384.0f, fminf(16384.0f, out));
+        }
+        if (mode == LIMIT_LEGACY) {
+            legacy_limit(current, referee_power, referee_buffer, row->limit);
+            for (int k = 0; k < WHEEL_NUM; k++) {
+                current[k] *= CURRENT_TO_A;
+            }
+        } else {
+            for (int k = 0; k < WHEEL_NUM; k++) {
+                current[k] *= CURRENT_TO_A;
+            }
+            power_limiter_budget(&limiter, row->limit, cap_energy);
+            power_limiter_apply(&limiter, current, speed, WHEEL_NUM, row->limit, DT);
+            if (t > 2000U && limiter.power > 20.0f) {
+                model_err_sum += fabsf(limiter.power - plant_power(current, speed)) / plant_power(current, speed);
+                model_err_num++;
+            }
+        }
+
+        //超级电容供给超过功率上限的部分, 裁判系统只看到其余部分
+        float power = plant_power(current, speed);
+        float cap_out = 0.0f;
+        if (cap_energy > 0.0f && power > row->limit) {
+            cap_out = fminf(fminf(power - row->limit, chassis_param.cap_power_max), cap_energy / DT);
+            cap_energy -= cap_out * DT;
+        }
+        float chassis_power = power - cap_out;
+        for (int k = 0; k < WHEEL_NUM; k++) {
+            speed[k] += (TORQUE_CONSTANT * current[k] - PLANT_DAMPING * speed[k]) / PLANT_INERTIA * DT;
+            err_sum += (set[k] - speed[k]) * (set[k] - speed[k]);
+        }
+
+        //裁判系统缓冲能量, 耗尽时计一次惩罚, 恢复到5J以上后重新计
+        buffer = fminf(60.0f, buffer + (row->limit - chassis_power) * DT);
+        if (buffer <= 0.0f) {
+            buffer = 0.0f;
+            if (!in_penalty) {
+                result->penalty++;
+                in_penalty = true;
+            }
+        } else if (buffer > 5.0f) {
+            in_penalty = false;
+        }
+        if (buffer < result->buffer_min) {
+            result->buffer_min = buffer;
+        }
+        power_sum += chassis_power;
+
+        //裁判数据: 每个周期的平均功率和采样时的缓冲能量, 滞后20~60ms到达
+        power_acc += chassis_power;
+        power_num++;
+        if (t % referee_period_ms == 0U) {
+            pending_power = (float) (power_acc / power_num);
+            pending_buffer = buffer;
+            pending_at = t + 20U + rnd(41);
+            power_acc = 0.0;
+            power_num = 0;
+        }
+        if (t == pending_at) {
+            referee_power = pending_power;
+            referee_buffer = pending_buffer;
+            if (mode == LIMIT_MODEL) {
+                power_limiter_referee_update(&limiter, referee_power, referee_buffer);
+            }
+        }
+    }
+    result->speed_rms = sqrt(err_sum / (duration * WHEEL_NUM));
+    result->mean_power = power_sum / duration;
+    result->model_error = model_err_num ? model_err_sum / model_err_num : 0.0;
+    result->correction = limiter.correction;
+}
+
+static void test_drive_log(void) {
+    TEST_ASSERT(load_drive_log() == 0 && drive_log_len > 1000);
+    const uint32_t periods[] = {100, 200};
+    for (int i = 0; i < 2; i++) {
+        sim_result_t legacy, model;
+        chassis_sim(LIMIT_LEGACY, periods[i], 0.0f, &legacy);
+        chassis_sim(LIMIT_MODEL, periods[i], 0.0f, &model);
+        TEST_ASSERT(model.penalty == 0 && model.penalty <= legacy.penalty);
+        //同样不耗尽缓冲能量, 用足功率, 轮速跟得更紧
+        TEST_ASSERT(model.speed_rms < 0.8 * legacy.speed_rms);
+        TEST_ASSERT(model.mean_power > legacy.mean_power);
+        //实际电机与标称模型的差别不是比例关系, 单一校正系数后仍有误差
+        TEST_ASSERT(model.model_error < 0.2);
+        printf("referee %3u ms: penalties legacy %u model %u, min buffer %.1f / %.1f J, speed rms %.1f / %.1f rad/s, "
+               "mean power %.1f / %.1f W, model error %.1f%%, correction %.2f\n", periods[i], legacy.penalty,
+               model.penalty, legacy.buffer_min, model.buffer_min, legacy.speed_rms, model.speed_rms,
+               legacy.mean_power, model.mean_power, model.model_error * 100.0, model.correction);
+    }
+}
+
+static void test_super_capacitance(void) {
+    sim_result_t plain, cap;
+    chassis_sim(LIMIT_MODEL, 100U, 0.0f, &plain);
+    chassis_sim(LIMIT_MODEL, 100U, 24.0f, &cap);
+    //电容能量用于加速, 不经过缓冲能量
+    TEST_ASSERT(cap.penalty == 0);
+    TEST_ASSERT(cap.speed_rms < plain.speed_rms);
+    printf("super capacitor 24 V: speed rms %.1f rad/s (without %.1f), min buffer %.1f J\n", cap.speed_rms,
+           plain.speed_rms, cap.buffer_min);
+}
+
+int main(void) {
+    RUN_TEST(test_budget);
+    RUN_TEST(test_scaling);
+    RUN_TEST(test_drive_log);
+    RUN_TEST(test_super_capacitance);
+    return unit_test_result();
+}
@@ -0,0 +1,152 @@
+/**
+  * @file       test_profile.c
+  * @brief      profile histogram math (bucket edges, mean, percentile bounds),
+  *             execution time and jitter across the 32-bit DWT counter wrap,
+  *             snapshot/reset, and the measured cost of a begin/end pair.
+  *             profile直方图计算(格边界、均值、分位数上界), DWT 32位计数回绕时的执行时间和抖动,
+  *             快照和复位, 以及一对begin/end的实测开销
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "profile.h"
+#include "DWT.h"
+#include "main.h"
+
+#define CYCLES_PER_MS   168000U
+
+//模拟DWT计数, use_host_clock时读取主机时钟
+static uint32_t fake_tick;
+static bool use_host_clock;
+
+uint32_t DWT_get_tick(void) {
+    if (use_host_clock) {
+        return (uint32_t) unit_test_now_ns();
+    }
+    return fake_tick;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return 168000000U;
+}
+
+static void test_bucket_edges(void) {
+    TEST_ASSERT(profile_hist_bucket(0) == 0 && profile_hist_bucket(1) == 0);
+    //第k格为[2^k, 2^(k+1))
+    for (uint8_t k = 1; k < PROFILE_BUCKET_NUM; k++) {
+        uint32_t low = 1U << k;
+        TEST_ASSERT(profile_hist_bucket(low) == k);
+        TEST_ASSERT(profile_hist_bucket(low - 1U) == k - 1U || k == 1);
+        TEST_ASSERT(profile_hist_bucket(low | (low - 1U)) == k);
+    }
+    TEST_ASSERT(profile_hist_bucket(0xFFFFFFFFU) == 31);
+}
+
+static void test_hist_stats(void) {
+    profile_hist_t hist = {0};
+    hist.min = 0xFFFFFFFFU;
+    TEST_ASSERT(profile_hist_mean(&hist) == 0 && profile_hist_percentile(&hist, 500) == 0);
+
+    for (int i = 0; i < 99; i++) {
+        profile_hist_add(&hist, 100);
+    }
+    profile_hist_add(&hist, 5000);
+    TEST_ASSERT(hist.cnt == 100 && hist.min == 100 && hist.max == 5000);
+    TEST_ASSERT(profile_hist_mean(&hist) == (99U * 100U + 5000U) / 100U);
+    //100在[64,128)格, 分位数返回格上界
+    TEST_ASSERT(profile_hist_percentile(&hist, 500) == 127);
+    TEST_ASSERT(profile_hist_percentile(&hist, 990) == 127);
+    //上界不超过实际最大值
+    TEST_ASSERT(profile_hist_percentile(&hist, 1000) == 5000);
+
+    //和不会溢出32位
+    profile_hist_t big = {0};
+    big.min = 0xFFFFFFFFU;
+    for (int i = 0; i < 1000; i++) {
+        profile_hist_add(&big, 0xF0000000U);
+    }
+    TEST_ASSERT(profile_hist_mean(&big) == 0xF0000000U && big.bucket[31] == 1000);
+    TEST_ASSERT(profile_hist_percentile(&big, 500) == 0xF0000000U);
+
+    //分位数上界总是不小于真实分位数
+    profile_hist_t ramp = {0};
+    ramp.min = 0xFFFFFFFFU;
+    for (uint32_t v = 1; v <= 1000; v++) {
+        profile_hist_add(&ramp, v);
+    }
+    for (uint16_t permille = 100; permille <= 1000; permille += 100) {
+        uint32_t bound = profile_hist_percentile(&ramp, permille);
+        TEST_ASSERT(bound >= permille && bound < 2U * permille);
+    }
+}
+
+static void test_exec_and_jitter(void) {
+    use_host_clock = false;
+    profile_init();
+    profile_point_t snap;
+
+    //执行时间跨过计数回绕
+    fake_tick = 0xFFFFFF00U;
+    profile_begin(PROFILE_GIMBAL_TASK);
+    fake_tick += 300U;
+    profile_end(PROFILE_GIMBAL_TASK);
+    //周期1ms, 晚50个计数, 然后早70个计数
+    fake_tick = 0xFFFFFF00U + CYCLES_PER_MS + 50U;
+    profile_begin(PROFILE_GIMBAL_TASK);
+    fake_tick = 0xFFFFFF00U + 2U * CYCLES_PER_MS - 70U;
+    profile_begin(PROFILE_GIMBAL_TASK);
+    profile_snapshot(PROFILE_GIMBAL_TASK, &snap);
+    TEST_ASSERT(snap.exec.cnt == 1 && snap.exec.max == 300U);
+    TEST_ASSERT(snap.jitter.cnt == 2 && snap.jitter.min == 50U && snap.jitter.max == 120U);
+
+    //非周期统计点记录原始激活间隔, 超过65ms也不截断
+    fake_tick = 1000U;
+    profile_begin(PROFILE_INS_TASK);
+    fake_tick += 100U * CYCLES_PER_MS;
+    profile_begin(PROFILE_INS_TASK);
+    profile_snapshot(PROFILE_INS_TASK, &snap);
+    TEST_ASSERT(snap.jitter.cnt == 1 && snap.jitter.max == 100U * CYCLES_PER_MS);
+
+    //复位后未begin的end不计入
+    profile_reset(PROFILE_INS_TASK);
+    profile_end(PROFILE_INS_TASK);
+    profile_snapshot(PROFILE_INS_TASK, &snap);
+    TEST_ASSERT(snap.exec.cnt == 0 && snap.jitter.cnt == 0 && !snap.started);
+    profile_snapshot(PROFILE_GIMBAL_TASK, &snap);
+    TEST_ASSERT(snap.exec.cnt == 1);
+
+    profile_reset(PROFILE_NUM);
+    for (int i = 0; i < PROFILE_NUM; i++) {
+        profile_snapshot((profile_id_e) i, &snap);
+        TEST_ASSERT(snap.exec.cnt == 0 && snap.exec.min == 0xFFFFFFFFU && !snap.started);
+        TEST_ASSERT(snap.name != NULL);
+    }
+    TEST_ASSERT(host_primask == 0U);
+}
+
+static void test_overhead(void) {
+    //主机时钟下实测一对begin/end的开销, 单位ns
+    use_host_clock = true;
+    profile_init();
+    printf("begin/end pair: %u ns on the host (profile_init minimum of 16)\n", profile_overhead_cycles);
+    const uint32_t rounds = 1000000U;
+    uint64_t start = unit_test_now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        profile_begin(PROFILE_CHASSIS_PID);
+        profile_end(PROFILE_CHASSIS_PID);
+    }
+    uint64_t ns = unit_test_now_ns() - start;
+    profile_point_t snap;
+    profile_snapshot(PROFILE_CHASSIS_PID, &snap);
+    TEST_ASSERT(snap.exec.cnt == rounds && snap.jitter.cnt == rounds - 1U);
+    printf("begin/end pair: %.1f ns mean over %u calls\n", (double) ns / rounds, rounds);
+    use_host_clock = false;
+}
+
+int main(void) {
+    RUN_TEST(test_bucket_edges);
+    RUN_TEST(test_hist_stats);
+    RUN_TEST(test_exec_and_jitter);
+    RUN_TEST(test_overhead);
+    return unit_test_result();
+}
@@ -0,0 +1,302 @@
+/**
+  * @file       test_referee_ui.c
+  * @brief      referee_ui against a model of the client: every frame has a
+  *             legal size and id, only diffs are sent, the screen converges to
+  *             the declared graphics (also when the client drops frames) and the
+  *             byte rate stays inside the budget. A frame the send function
+  *             drops leaves its graphics pending.
+  *             referee_ui与客户端模型比较: 每帧长度和ID合法, 只发送差异, 客户端画面收敛到声明的图形
+  *             (客户端丢帧时也是), 字节速率不超过预算.发送函数丢弃的帧中的图形保持待发送
+  */
+#include "unit_test.h"
+#include "referee_ui.h"
+#include <string.h>
+
+#define CLIENT_MAX      64
+#define BUDGET_BPS      150U
+#define REFRESH_MS      2000U
+
+//客户端模型: 名称 -> 图形
+static graphic_data_struct_t client[CLIENT_MAX];
+static bool client_used[CLIENT_MAX];
+static uint32_t frames, graphics_sent, null_ops, add_ops, modify_ops, delete_ops, bad_frames, bad_ops;
+static uint32_t drop_every;     //每N帧丢一帧, 0不丢
+static bool queue_full;         //帧缓存耗尽, 发送函数丢弃该帧
+static uint16_t first_name_sent;
+
+static int client_find(const uint8_t name[3]) {
+    for (int i = 0; i < CLIENT_MAX; i++) {
+        if (client_used[i] && memcmp(client[i].graphic_name, name, 3) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void client_reset(void) {
+    memset(client_used, 0, sizeof(client_used));
+    frames = graphics_sent = null_ops = add_ops = modify_ops = delete_ops = bad_frames = bad_ops = 0;
+    drop_every = 0;
+    queue_full = false;
+}
+
+static int client_send(uint16_t data_cmd_id, uint8_t *p_data, uint16_t data_len) {
+    static const uint16_t id_of[8] = {0, Drawing_1_ID, Drawing_2_ID, 0, 0, Drawing_5_ID, 0, Drawing_7_ID};
+    uint16_t num = data_len / sizeof(graphic_data_struct_t);
+    if (queue_full) {
+        return -1;
+    }
+    frames++;
+    if (data_len % sizeof(graphic_data_struct_t) != 0 || num > 7 || id_of[num] == 0 || id_of[num] != data_cmd_id) {
+        bad_frames++;
+        return 0;
+    }
+    graphic_data_struct_t *p_graphic = (graphic_data_struct_t *) p_data;
+    first_name_sent = (uint16_t) (p_graphic[0].graphic_name[0] << 8 | p_graphic[0].graphic_name[2]);
+    //已进入发送队列, 在线上丢失
+    if (drop_every && frames % drop_every == 0) {
+        return 0;
+    }
+    for (uint16_t i = 0; i < num; i++) {
+        graphic_data_struct_t g = p_graphic[i];
+        int k = client_find(g.graphic_name);
+        switch (g.operate_type) {
+            case NULL_OPERATION:
+                null_ops++;
+                break;
+            case ADD_PICTURE:
+                add_ops++;
+                graphics_sent++;
+                if (k < 0) {
+                    for (k = 0; k < CLIENT_MAX && client_used[k]; k++) {
+                    }
+                }
+                if (k >= CLIENT_MAX) {
+                    bad_ops++;
+                    break;
+                }
+                client[k] = g;
+                client_used[k] = true;
+                break;
+            case MODIFY_PICTURE:
+                //客户端没有该图形时修改无效
+                modify_ops++;
+                graphics_sent++;
+                if (k >= 0) {
+                    client[k] = g;
+                }
+                break;
+            case CLEAR_PICTURE:
+                delete_ops++;
+                graphics_sent++;
+                if (k >= 0) {
+                    client_used[k] = false;
+                }
+                break;
+            default:
+                bad_ops++;
+                break;
+        }
+    }
+    return 0;
+}
+
+static graphic_data_struct_t make_graphic(char a, char b, char c, uint16_t x) {
+    graphic_data_struct_t g;
+    memset(&g, 0, sizeof(g));
+    g.graphic_name[0] = (uint8_t) a;
+    g.graphic_name[1] = (uint8_t) b;
+    g.graphic_name[2] = (uint8_t) c;
+    g.start_x = x;
+    g.end_x = x + 10U;
+    g.start_y = 500;
+    g.end_y = 520;
+    g.width = 3;
+    return g;
+}
+
+//客户端上的图形与声明一致(忽略operate_type)
+static bool client_matches(const graphic_data_struct_t *p_expect, int num) {
+    int count = 0;
+    for (int i = 0; i < CLIENT_MAX; i++) {
+        count += client_used[i];
+    }
+    if (count != num) {
+        return false;
+    }
+    for (int i = 0; i < num; i++) {
+        int k = client_find(p_expect[i].graphic_name);
+        if (k < 0) {
+            return false;
+        }
+        graphic_data_struct_t a = client[k], b = p_expect[i];
+        a.operate_type = b.operate_type = 0;
+        if (memcmp(&a, &b, sizeof(a)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_frame_layout(void) {
+    TEST_ASSERT(sizeof(graphic_data_struct_t) == 15);
+    referee_ui_t ui;
+    client_reset();
+    referee_ui_init(&ui, client_send, 100000U, 0);
+    //3个图形用0x0103的5图形帧, 空位填空操作
+    for (int i = 0; i < 3; i++) {
+        graphic_data_struct_t g = make_graphic('l', 'y', (char) ('0' + i), (uint16_t) (100 * i));
+        referee_ui_set(&ui, &g, 1);
+    }
+    TEST_ASSERT(referee_ui_flush(&ui, 100) == 1);
+    TEST_ASSERT(frames == 1 && add_ops == 3 && null_ops == 2 && bad_frames == 0);
+    TEST_ASSERT(ui.sent_bytes == REFEREE_UI_FRAME_OVERHEAD + 5 * 15);
+
+    //9个图形分为7个和2个
+    for (int i = 3; i < 12; i++) {
+        graphic_data_struct_t g = make_graphic('l', 'y', (char) ('0' + i), (uint16_t) (100 * i));
+        referee_ui_set(&ui, &g, 1);
+    }
+    TEST_ASSERT(referee_ui_flush(&ui, 200) == 2);
+    TEST_ASSERT(frames == 3 && add_ops == 12 && null_ops == 2 && bad_frames == 0 && bad_ops == 0);
+}
+
+static void test_only_diffs(void) {
+    referee_ui_t ui;
+    graphic_data_struct_t declared[4];
+    client_reset();
+    referee_ui_init(&ui, client_send, 100000U, 0);
+    for (int i = 0; i < 4; i++) {
+        declared[i] = make_graphic('d', 'f', (char) ('0' + i), (uint16_t) (50 * i));
+    }
+    //每周期声明相同内容, 只在第一次发送
+    for (uint32_t t = 0; t < 5000; t += 100) {
+        for (int i = 0; i < 4; i++) {
+            referee_ui_set(&ui, &declared[i], 1);
+        }
+        referee_ui_flush(&ui, t);
+    }
+    TEST_ASSERT(frames == 1 && add_ops == 4);
+
+    //一个图形变化, 只修改它
+    declared[2].start_x = 777;
+    referee_ui_set(&ui, &declared[2], 1);
+    referee_ui_flush(&ui, 5000);
+    TEST_ASSERT(frames == 2 && modify_ops == 1);
+    TEST_ASSERT(client_matches(declared, 4));
+
+    //删除已显示的图形发送删除, 删除未发出的图形不发送
+    referee_ui_remove(&ui, declared[3].graphic_name);
+    graphic_data_struct_t never = make_graphic('n', 'v', 'r', 1);
+    referee_ui_set(&ui, &never, 1);
+    referee_ui_remove(&ui, never.graphic_name);
+    referee_ui_flush(&ui, 5100);
+    TEST_ASSERT(delete_ops == 1 && add_ops == 4);
+    TEST_ASSERT(client_matches(declared, 3));
+}
+
+static void test_priority_order(void) {
+    referee_ui_t ui;
+    client_reset();
+    //预算只够一个7图形帧
+    referee_ui_init(&ui, client_send, 0, 0);
+    ui.budget = 1000U * (REFEREE_UI_FRAME_OVERHEAD + 7 * 15);
+    for (int i = 0; i < 10; i++) {
+        graphic_data_struct_t g = make_graphic('p', 'r', (char) ('0' + i), (uint16_t) i);
+        referee_ui_set(&ui, &g, 5);
+    }
+    graphic_data_struct_t urgent = make_graphic('u', 'r', 'g', 1);
+    referee_ui_set(&ui, &urgent, 0);
+    TEST_ASSERT(referee_ui_flush(&ui, 0) == 1);
+    //高优先级的图形排在第一个
+    TEST_ASSERT(first_name_sent == ('u' << 8 | 'g'));
+    TEST_ASSERT(add_ops == 7);
+    TEST_ASSERT(referee_ui_flush(&ui, 0) == 0);
+}
+
+static void test_budget_and_recovery(void) {
+    referee_ui_t ui;
+    graphic_data_struct_t declared[16];
+    client_reset();
+    referee_ui_init(&ui, client_send, BUDGET_BPS, REFRESH_MS);
+    //客户端每3帧丢1帧
+    drop_every = 3;
+
+    const uint32_t duration_ms = 60000U;
+    for (uint32_t t = 0; t <= duration_ms; t += 100) {
+        for (int i = 0; i < 15; i++) {
+            declared[i] = make_graphic('s', 't', (char) ('A' + i), (uint16_t) (100 + i));
+        }
+        //一个每500ms变化一次的进度条
+        declared[15] = make_graphic('b', 'a', 'r', (uint16_t) ((t / 500U) % 300U));
+        for (int i = 0; i < 16; i++) {
+            referee_ui_set(&ui, &declared[i], i == 15 ? 0 : 1);
+        }
+        referee_ui_flush(&ui, t);
+    }
+    TEST_ASSERT(bad_frames == 0 && bad_ops == 0);
+    //预算之外最多多出令牌桶初始的两个满帧
+    TEST_ASSERT(ui.sent_bytes <= BUDGET_BPS * duration_ms / 1000U + 2U * (REFEREE_UI_FRAME_OVERHEAD + 7 * 15));
+    printf("%u frames, %u bytes (%.1f B/s of %u), %u adds, %u modifies\n", frames, ui.sent_bytes,
+           ui.sent_bytes * 1000.0 / duration_ms, BUDGET_BPS, add_ops, modify_ops);
+
+    //停止丢帧, 经过几个重发周期后客户端与声明一致
+    drop_every = 0;
+    for (uint32_t t = duration_ms + 100U; t <= duration_ms + 5U * REFRESH_MS; t += 100) {
+        for (int i = 0; i < 16; i++) {
+            referee_ui_set(&ui, &declared[i], i == 15 ? 0 : 1);
+        }
+        referee_ui_flush(&ui, t);
+    }
+    TEST_ASSERT(client_matches(declared, 16));
+
+    //客户端重连清空画面后全部重新新增
+    memset(client_used, 0, sizeof(client_used));
+    referee_ui_invalidate(&ui);
+    uint32_t t = duration_ms + 5U * REFRESH_MS + 100U;
+    for (int round = 0; round < 100; round++, t += 100) {
+        referee_ui_flush(&ui, t);
+    }
+    TEST_ASSERT(client_matches(declared, 16));
+}
+
+static void test_dropped_frame_stays_pending(void) {
+    referee_ui_t ui;
+    graphic_data_struct_t declared[3];
+    client_reset();
+    referee_ui_init(&ui, client_send, 100000U, 0);
+    for (int i = 0; i < 3; i++) {
+        declared[i] = make_graphic('q', 'f', (char) ('0' + i), (uint16_t) (20 * i));
+        referee_ui_set(&ui, &declared[i], 1);
+    }
+    //帧缓存耗尽: 不计入发送, 不消耗预算, 图形保持待新增
+    queue_full = true;
+    uint32_t budget = ui.budget;
+    TEST_ASSERT(referee_ui_flush(&ui, 100) == 0);
+    TEST_ASSERT(ui.drop_cnt == 1 && ui.frame_cnt == 0 && ui.sent_bytes == 0);
+    TEST_ASSERT(ui.budget >= budget);
+    for (int i = 0; i < REFEREE_UI_GRAPHIC_MAX_NUM; i++) {
+        TEST_ASSERT(ui.slot[i].state != UI_SLOT_SYNCED);
+    }
+
+    //修改也一样, 恢复后发出最新内容
+    queue_full = false;
+    TEST_ASSERT(referee_ui_flush(&ui, 200) == 1);
+    TEST_ASSERT(client_matches(declared, 3));
+    declared[1].start_x = 999;
+    referee_ui_set(&ui, &declared[1], 1);
+    queue_full = true;
+    TEST_ASSERT(referee_ui_flush(&ui, 300) == 0 && ui.drop_cnt == 2);
+    queue_full = false;
+    TEST_ASSERT(referee_ui_flush(&ui, 400) == 1);
+    TEST_ASSERT(modify_ops == 1 && client_matches(declared, 3));
+}
+
+int main(void) {
+    RUN_TEST(test_frame_layout);
+    RUN_TEST(test_only_diffs);
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_budget_and_recovery);
+    RUN_TEST(test_dropped_frame_stays_pending);
+    return unit_test_result();
+}
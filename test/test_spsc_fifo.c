@@ -0,0 +1,193 @@
+/**
+  * @file       test_spsc_fifo.c
+  * @brief      spsc_fifo single-threaded semantics (full, empty, wraparound of
+  *             the buffer and of the uint32 counters, two-span peek), a two
+  *             thread producer/consumer stress run, and throughput against the
+  *             interrupt-locked fifo_s it replaced.
+  *             spsc_fifo的单线程语义(满、空、缓存回绕和uint32计数回绕、两段peek), 双线程生产者/消费者压力测试,
+  *             以及与被替换的关中断fifo_s的吞吐比较
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "spsc_fifo.h"
+#include "fifo.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define STRESS_BYTES    4000000U
+
+static spsc_fifo_t fifo;
+static uint8_t fifo_buf[1024];
+
+static void test_init(void) {
+    uint8_t buf[24];
+    TEST_ASSERT(spsc_fifo_init(&fifo, buf, 24) == -1);
+    TEST_ASSERT(spsc_fifo_init(&fifo, buf, 0) == -1);
+    TEST_ASSERT(spsc_fifo_init(&fifo, NULL, 16) == -1);
+    TEST_ASSERT(spsc_fifo_init(&fifo, buf, 16) == 0);
+    TEST_ASSERT(spsc_fifo_used(&fifo) == 0 && spsc_fifo_free(&fifo) == 16);
+}
+
+static void test_full_empty(void) {
+    uint8_t buf[8], out[16];
+    spsc_fifo_init(&fifo, buf, 8);
+    TEST_ASSERT(spsc_fifo_get(&fifo) == 0);
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT(spsc_fifo_put(&fifo, (uint8_t) (i + 1)) == 0);
+    }
+    TEST_ASSERT(spsc_fifo_put(&fifo, 9) == -1);
+    TEST_ASSERT(spsc_fifo_puts(&fifo, out, 4) == 0);
+    TEST_ASSERT(spsc_fifo_free(&fifo) == 0);
+    TEST_ASSERT(spsc_fifo_preread(&fifo, 7) == 8 && spsc_fifo_preread(&fifo, 8) == 0);
+    TEST_ASSERT(spsc_fifo_get(&fifo) == 1);
+    //只写入放得下的部分
+    uint8_t src[4] = {10, 11, 12, 13};
+    TEST_ASSERT(spsc_fifo_puts(&fifo, src, 4) == 1);
+    TEST_ASSERT(spsc_fifo_gets(&fifo, out, 16) == 8);
+    TEST_ASSERT(out[0] == 2 && out[6] == 8 && out[7] == 10);
+    TEST_ASSERT(spsc_fifo_used(&fifo) == 0);
+}
+
+static void test_counter_wraparound(void) {
+    //计数器在uint32溢出前后, 已用长度仍正确
+    uint8_t buf[16], out[16];
+    spsc_fifo_init(&fifo, buf, 16);
+    fifo.head = fifo.tail = 0xFFFFFFFAU;
+    uint8_t src[12];
+    for (int i = 0; i < 12; i++) {
+        src[i] = (uint8_t) (0x40 + i);
+    }
+    TEST_ASSERT(spsc_fifo_puts(&fifo, src, 12) == 12);
+    TEST_ASSERT(fifo.head == 6U);
+    TEST_ASSERT(spsc_fifo_used(&fifo) == 12 && spsc_fifo_free(&fifo) == 4);
+
+    //数据跨过缓存末尾, peek分为两段
+    spsc_fifo_span_t span;
+    TEST_ASSERT(spsc_fifo_peek(&fifo, &span) == 12);
+    TEST_ASSERT(span.len[0] == 6 && span.len[1] == 6);
+    TEST_ASSERT(span.p_data[0][0] == 0x40 && span.p_data[1][0] == 0x46);
+    TEST_ASSERT(spsc_fifo_discard(&fifo, 3) == 3);
+    TEST_ASSERT(spsc_fifo_gets(&fifo, out, 16) == 9);
+    TEST_ASSERT(memcmp(out, src + 3, 9) == 0);
+    TEST_ASSERT(spsc_fifo_discard(&fifo, 5) == 0);
+
+    spsc_fifo_puts(&fifo, src, 5);
+    spsc_fifo_flush(&fifo);
+    TEST_ASSERT(spsc_fifo_used(&fifo) == 0 && spsc_fifo_peek(&fifo, &span) == 0 && span.len[0] == 0);
+}
+
+static void *producer(void *arg) {
+    (void) arg;
+    uint8_t chunk[37];
+    uint32_t i = 0;
+    while (i < STRESS_BYTES) {
+        uint32_t n = 0;
+        for (; n < sizeof(chunk) && i + n < STRESS_BYTES; n++) {
+            chunk[n] = (uint8_t) ((i + n) * 7U);
+        }
+        //单字节和多字节写入交替
+        uint32_t written;
+        if ((i & 0x100U) != 0U) {
+            written = spsc_fifo_put(&fifo, chunk[0]) == 0 ? 1U : 0U;
+        } else {
+            written = spsc_fifo_puts(&fifo, chunk, n);
+        }
+        if (written == 0U) {
+            sched_yield();
+        }
+        i += written;
+    }
+    return NULL;
+}
+
+static void test_threaded_stress(void) {
+    spsc_fifo_init(&fifo, fifo_buf, sizeof(fifo_buf));
+    uint32_t irq_before = host_irq_disable_count;
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, NULL);
+
+    uint8_t out[53];
+    uint32_t i = 0, errors = 0;
+    while (i < STRESS_BYTES) {
+        uint32_t n;
+        switch (i % 3U) {
+            case 0: {
+                n = spsc_fifo_gets(&fifo, out, sizeof(out));
+                for (uint32_t k = 0; k < n; k++) {
+                    errors += out[k] != (uint8_t) ((i + k) * 7U);
+                }
+                break;
+            }
+            case 1: {
+                //零拷贝读取
+                spsc_fifo_span_t span;
+                uint32_t k = 0;
+                n = spsc_fifo_peek(&fifo, &span);
+                for (int s = 0; s < 2; s++) {
+                    for (uint32_t j = 0; j < span.len[s]; j++, k++) {
+                        errors += span.p_data[s][j] != (uint8_t) ((i + k) * 7U);
+                    }
+                }
+                spsc_fifo_discard(&fifo, n);
+                break;
+            }
+            default: {
+                n = spsc_fifo_used(&fifo) ? 1U : 0U;
+                if (n) {
+                    errors += spsc_fifo_preread(&fifo, 0) != (uint8_t) (i * 7U);
+                    errors += spsc_fifo_get(&fifo) != (uint8_t) (i * 7U);
+                }
+                break;
+            }
+        }
+        i += n;
+        if (n == 0U) {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    TEST_ASSERT(errors == 0);
+    TEST_ASSERT(spsc_fifo_used(&fifo) == 0);
+    //两端都不关中断
+    TEST_ASSERT(host_irq_disable_count == irq_before);
+}
+
+static void test_throughput(void) {
+    const int rounds = 200000;
+    uint8_t frame[32], out[32];
+    memset(frame, 0x5A, sizeof(frame));
+
+    spsc_fifo_init(&fifo, fifo_buf, sizeof(fifo_buf));
+    uint64_t start = unit_test_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        spsc_fifo_puts(&fifo, frame, sizeof(frame));
+        spsc_fifo_gets(&fifo, out, sizeof(out));
+    }
+    uint64_t spsc_ns = unit_test_now_ns() - start;
+
+    fifo_s_t locked;
+    fifo_s_init(&locked, fifo_buf, sizeof(fifo_buf));
+    uint32_t irq_before = host_irq_disable_count;
+    start = unit_test_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        fifo_s_puts(&locked, (char *) frame, sizeof(frame));
+        fifo_s_gets(&locked, (char *) out, sizeof(out));
+    }
+    uint64_t locked_ns = unit_test_now_ns() - start;
+    TEST_ASSERT(host_irq_disable_count - irq_before == 2U * rounds);
+    TEST_ASSERT(host_primask == 0U);
+
+    printf("32 byte put+get: spsc_fifo %.1f ns, fifo_s %.1f ns\n", (double) spsc_ns / rounds,
+           (double) locked_ns / rounds);
+}
+
+int main(void) {
+    RUN_TEST(test_init);
+    RUN_TEST(test_full_empty);
+    RUN_TEST(test_counter_wraparound);
+    RUN_TEST(test_threaded_stress);
+    RUN_TEST(test_throughput);
+    return unit_test_result();
+}
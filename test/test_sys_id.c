@@ -0,0 +1,347 @@
+/**
+  * @file       test_sys_id.c
+  * @brief      sys_id against simulated plants with known transfer functions:
+  *             the plant is integrated between samples with the command held
+  *             (zero-order hold), the feedback is delayed and noisy. Covered are
+  *             current to speed, a 30 Hz resonance with zeta 0.1, speed to angle
+  *             with a large offset, a reversed motor and an integrator with a
+  *             resonance, stepped and chirp. The fit alone is checked on exact
+  *             model points, then the limit abort and the argument checks. The
+  *             resonance run is written as SYSID lines for sys_id_bode.py.
+  *             sys_id与已知传递函数的模拟对象: 采样之间保持给定积分对象(零阶保持), 反馈带延迟和噪声.
+  *             覆盖电流到速度、zeta 0.1的30Hz谐振、带大偏置的速度到角度、反向电机以及带谐振的积分对象,
+  *             步进和扫频两种方式.单独用精确的模型点检查拟合, 以及超限中止和参数检查.
+  *             谐振的辨识结果以SYSID行写出供sys_id_bode.py解析
+  */
+#include "unit_test.h"
+#include "sys_id.h"
+#include <string.h>
+
+#define DT              0.001f
+#define SUB_STEP        20          //每个采样周期内的积分步数
+#define DELAY_MAX       8
+#define PI_D            3.14159265358979
+
+static uint32_t lcg_state = 1U;
+
+static double rnd_uniform(void) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return ((double) (lcg_state >> 8) + 0.5) / 16777216.0;
+}
+
+static double rnd_gauss(void) {
+    return sqrt(-2.0 * log(rnd_uniform())) * cos(2.0 * PI_D * rnd_uniform());
+}
+
+//模拟对象: 一阶或二阶, 可带积分, 输出延迟delay个采样
+typedef struct {
+    sys_id_model_e model;
+    double k, t, wn, zeta;
+    int delay;
+    double y_offset;        //反馈的固定偏置, 例如绝对角度
+    double noise;           //反馈噪声标准差
+    double x[3];            //状态: 一阶/二阶的输出和导数, 积分输出
+    float32_t history[DELAY_MAX + 1];
+} plant_t;
+
+static void plant_deriv(const plant_t *p, const double *x, double u, double *dx) {
+    double inner;
+
+    if (p->model == SYS_ID_FIRST_ORDER || p->model == SYS_ID_INTEGRATOR_FIRST_ORDER) {
+        dx[0] = (p->k * u - x[0]) / p->t;
+        dx[1] = 0.0;
+    } else {
+        dx[0] = x[1];
+        dx[1] = p->wn * p->wn * (p->k * u - x[0]) - 2.0 * p->zeta * p->wn * x[1];
+    }
+    inner = x[0];
+    dx[2] = inner;
+}
+
+//保持给定u积分一个采样周期, RK4
+static void plant_step(plant_t *p, double u) {
+    double h = DT / SUB_STEP, k1[3], k2[3], k3[3], k4[3], tmp[3];
+
+    for (int s = 0; s < SUB_STEP; s++) {
+        plant_deriv(p, p->x, u, k1);
+        for (int i = 0; i < 3; i++) tmp[i] = p->x[i] + 0.5 * h * k1[i];
+        plant_deriv(p, tmp, u, k2);
+        for (int i = 0; i < 3; i++) tmp[i] = p->x[i] + 0.5 * h * k2[i];
+        plant_deriv(p, tmp, u, k3);
+        for (int i = 0; i < 3; i++) tmp[i] = p->x[i] + h * k3[i];
+        plant_deriv(p, tmp, u, k4);
+        for (int i = 0; i < 3; i++) p->x[i] += h / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+    }
+    memmove(&p->history[1], &p->history[0], DELAY_MAX * sizeof(float32_t));
+    double y = (p->model == SYS_ID_INTEGRATOR_FIRST_ORDER || p->model == SYS_ID_INTEGRATOR_SECOND_ORDER) ?
+               p->x[2] : p->x[0];
+    p->history[0] = (float32_t) (y + p->y_offset + p->noise * rnd_gauss());
+}
+
+static float32_t plant_output(const plant_t *p) {
+    return p->history[p->delay];
+}
+
+static void plant_init(plant_t *p, sys_id_model_e model, double k, double t, double wn, double zeta, int delay,
+                       double y_offset, double noise) {
+    memset(p, 0, sizeof(plant_t));
+    p->model = model;
+    p->k = k;
+    p->t = t;
+    p->wn = wn;
+    p->zeta = zeta;
+    p->delay = delay;
+    p->y_offset = y_offset;
+    p->noise = noise;
+    for (int i = 0; i <= DELAY_MAX; i++) {
+        p->history[i] = (float32_t) y_offset;
+    }
+}
+
+//运行到结束, 返回采样数
+static uint32_t run(sys_id_t *id, plant_t *p, float32_t *feedback, float32_t *command) {
+    uint32_t n = 0U;
+
+    *feedback = plant_output(p);
+    while (sys_id_update(id) != SYS_ID_DONE && id->state != SYS_ID_ABORT && n < 2000000U) {
+        plant_step(p, *command);
+        *feedback = plant_output(p);
+        n++;
+    }
+    return n;
+}
+
+static int rel_near(double expect, double actual, double tol) {
+    return fabs(actual - expect) <= fabs(expect) * tol;
+}
+
+//反馈在给定写入一个周期后读取, 零阶保持滞后半个周期, 相对给定的延迟为(delay - 0.5)个周期
+static double expect_delay(const plant_t *p) {
+    return (p->delay - 0.5) * DT;
+}
+
+#define DELAY_TOL       0.15e-3
+
+static void report(const char *name, const sys_id_t *id, uint32_t n) {
+    const sys_id_fit_t *fit = &id->fit;
+    printf("%-24s %6.2f s  K %8.4f T %7.4f wn %7.2f zeta %6.3f delay %5.2f ms  bw %6.2f Hz  err %5.3f  %d pts\n",
+           name, n * DT, fit->gain, fit->time_const, fit->wn, fit->zeta, fit->delay * 1e3f, fit->bandwidth,
+           fit->fit_error, fit->point_used);
+}
+
+//SYSID行, 与pid_auto_tune_task.c中sys_id_print的格式相同
+static void write_log(const sys_id_t *id, const char *path) {
+    FILE *f = fopen(path, "w");
+    const sys_id_fit_t *fit = &id->fit;
+
+    TEST_ASSERT(f != NULL);
+    if (f == NULL) {
+        return;
+    }
+    fprintf(f, "pid_auto_tune: start\r\n");
+    for (int i = 0; i < id->point_done; i++) {
+        const sys_id_point_t *point = &id->point[i];
+        fprintf(f, "SYSID,P,%d,%.5g,%.6g,%.2f,%.3f\r\n", i, point->freq, point->gain, point->phase * 57.2957795f,
+                point->quality);
+    }
+    fprintf(f, "SYSID,FIT,%d,%d,%.6g,%.5g,%.5g,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g,%d\r\n",
+            fit->valid, fit->model, fit->gain, fit->time_const, fit->wn, fit->zeta, fit->delay, fit->bandwidth,
+            fit->peak_freq, fit->peak_db, fit->fit_error, fit->point_used);
+    fclose(f);
+}
+
+static void test_fit_exact_points(void) {
+    sys_id_point_t point[20];
+    sys_id_fit_t model, fit;
+    const sys_id_model_e models[4] = {SYS_ID_FIRST_ORDER, SYS_ID_SECOND_ORDER, SYS_ID_INTEGRATOR_FIRST_ORDER,
+                                      SYS_ID_INTEGRATOR_SECOND_ORDER};
+
+    for (int m = 0; m < 4; m++) {
+        memset(&model, 0, sizeof(model));
+        model.model = models[m];
+        model.gain = (m & 1) ? -2.5f : 12.0f;
+        model.time_const = 0.02f;
+        model.wn = 2.0f * (float32_t) PI_D * 25.0f;
+        model.zeta = 0.2f;
+        model.delay = 0.003f;
+        for (int i = 0; i < 20; i++) {
+            point[i].freq = 1.0f * powf(100.0f, (float32_t) i / 19.0f);
+            sys_id_model_response(&model, point[i].freq, &point[i].gain, &point[i].phase);
+            point[i].quality = 1.0f;
+        }
+        TEST_ASSERT(sys_id_fit(point, 20, models[m], 0.5f, &fit) == 0 && fit.valid == 0);
+        TEST_ASSERT_NEAR(model.gain, fit.gain, fabsf(model.gain) * 1e-3f);
+        if (m == 0 || m == 2) {
+            TEST_ASSERT_NEAR(model.time_const, fit.time_const, 1e-5f);
+        } else {
+            TEST_ASSERT_NEAR(model.wn, fit.wn, model.wn * 1e-3f);
+            TEST_ASSERT_NEAR(model.zeta, fit.zeta, 1e-3f);
+        }
+        TEST_ASSERT_NEAR(model.delay, fit.delay, 1e-5f);
+        TEST_ASSERT(fit.fit_error < 1e-3f && fit.point_used == 20U);
+    }
+
+    //低质量的点不参与拟合, 有效点不足时失败
+    for (int i = 0; i < 20; i++) {
+        point[i].quality = i < 3 ? 1.0f : 0.2f;
+    }
+    TEST_ASSERT(sys_id_fit(point, 20, SYS_ID_SECOND_ORDER, 0.5f, &fit) == -1 && fit.valid == -1);
+    TEST_ASSERT(fit.point_used == 3U);
+}
+
+static void test_first_order_stepped_and_chirp(void) {
+    static sys_id_t id;
+    plant_t p;
+    float32_t feedback, command;
+
+    for (int mode = 0; mode < 2; mode++) {
+        //电流到速度: K=20 rad/s/A, T=50ms, 反馈延迟2个采样
+        plant_init(&p, SYS_ID_FIRST_ORDER, 20.0, 0.05, 0.0, 0.0, 2, 0.0, 0.2);
+        TEST_ASSERT(sys_id_init(&id, &feedback, &command, (sys_id_mode_e) mode, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                                1.0f, 100.0f, 20, 0.0f, DT) == 0);
+        uint32_t n = run(&id, &p, &feedback, &command);
+        report(mode ? "first order chirp" : "first order stepped", &id, n);
+        TEST_ASSERT(id.state == SYS_ID_DONE && id.fit.valid == 0 && command == 0.0f);
+        TEST_ASSERT(rel_near(20.0, id.fit.gain, 0.05));
+        TEST_ASSERT(rel_near(0.05, id.fit.time_const, mode == SYS_ID_CHIRP ? 0.08 : 0.05));
+        TEST_ASSERT_NEAR(expect_delay(&p), id.fit.delay, DELAY_TOL);
+        //带宽相对第一个点的增益: 1 + (wT)^2 = 2 (1 + (2 pi f_start T)^2)
+        double w_bw = sqrt(2.0 * (1.0 + pow(2.0 * PI_D * id.point[0].freq * 0.05, 2.0)) - 1.0) / 0.05;
+        TEST_ASSERT(rel_near(w_bw / (2.0 * PI_D), id.fit.bandwidth, 0.05));
+        //扫频比步进快
+        if (mode == SYS_ID_CHIRP) {
+            TEST_ASSERT(n * DT < 30.0f);
+        }
+    }
+}
+
+static void test_resonance_stepped_and_chirp(void) {
+    static sys_id_t id;
+    plant_t p;
+    float32_t feedback, command;
+    const double wn = 2.0 * PI_D * 30.0;
+
+    for (int mode = 0; mode < 2; mode++) {
+        plant_init(&p, SYS_ID_SECOND_ORDER, 1.5, 0.0, wn, 0.1, 1, 0.0, 0.02);
+        TEST_ASSERT(sys_id_init(&id, &feedback, &command, (sys_id_mode_e) mode, SYS_ID_SECOND_ORDER, 0.0f, 1.0f,
+                                5.0f, 120.0f, 30, 0.0f, DT) == 0);
+        if (mode == SYS_ID_CHIRP) {
+            //尖锐谐振附近扫频需要更多周期
+            sys_id_set_cycles(&id, 10.0f, 20.0f);
+        }
+        uint32_t n = run(&id, &p, &feedback, &command);
+        report(mode ? "resonance chirp" : "resonance stepped", &id, n);
+        TEST_ASSERT(id.state == SYS_ID_DONE && id.fit.valid == 0);
+        TEST_ASSERT(rel_near(1.5, id.fit.gain, 0.05));
+        TEST_ASSERT(rel_near(wn, id.fit.wn, 0.05));
+        TEST_ASSERT(rel_near(0.1, id.fit.zeta, 0.08));
+        TEST_ASSERT_NEAR(expect_delay(&p), id.fit.delay, DELAY_TOL);
+        //峰值约为1/(2 zeta) = 14dB, 在wn附近
+        TEST_ASSERT(id.fit.peak_db > 12.0f && rel_near(30.0, id.fit.peak_freq, 0.08));
+        if (mode == SYS_ID_STEPPED_SINE) {
+            write_log(&id, SYS_ID_LOG_FILE);
+        }
+    }
+}
+
+static void test_integrator_with_offset(void) {
+    static sys_id_t id;
+    plant_t p;
+    float32_t feedback, command;
+
+    //速度环闭环后到绝对角度, 角度偏置3rad
+    plant_init(&p, SYS_ID_INTEGRATOR_FIRST_ORDER, 1.0, 0.01, 0.0, 0.0, 1, 3.0, 0.0002);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_INTEGRATOR_FIRST_ORDER, 0.0f,
+                            2.0f, 2.0f, 60.0f, 16, 0.0f, DT) == 0);
+    uint32_t n = run(&id, &p, &feedback, &command);
+    report("integrator, offset", &id, n);
+    TEST_ASSERT(id.state == SYS_ID_DONE && id.fit.valid == 0 && command == 0.0f);
+    TEST_ASSERT(rel_near(1.0, id.fit.gain, 0.05));
+    TEST_ASSERT(rel_near(0.01, id.fit.time_const, 0.08));
+    TEST_ASSERT_NEAR(expect_delay(&p), id.fit.delay, DELAY_TOL);
+
+    //带谐振的积分对象
+    plant_init(&p, SYS_ID_INTEGRATOR_SECOND_ORDER, 2.0, 0.0, 2.0 * PI_D * 20.0, 0.3, 2, -1.0, 0.0002);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_INTEGRATOR_SECOND_ORDER, 0.0f,
+                            1.0f, 2.0f, 80.0f, 20, 0.0f, DT) == 0);
+    n = run(&id, &p, &feedback, &command);
+    report("integrator, resonance", &id, n);
+    TEST_ASSERT(id.state == SYS_ID_DONE && id.fit.valid == 0);
+    TEST_ASSERT(rel_near(2.0, id.fit.gain, 0.05));
+    TEST_ASSERT(rel_near(2.0 * PI_D * 20.0, id.fit.wn, 0.05));
+    TEST_ASSERT(rel_near(0.3, id.fit.zeta, 0.08));
+    TEST_ASSERT_NEAR(expect_delay(&p), id.fit.delay, DELAY_TOL);
+}
+
+static void test_reversed_motor(void) {
+    static sys_id_t id;
+    plant_t p;
+    float32_t feedback, command;
+
+    plant_init(&p, SYS_ID_FIRST_ORDER, -8.0, 0.03, 0.0, 0.0, 2, 0.0, 0.05);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 2.0f,
+                            1.0f, 100.0f, 16, 0.0f, DT) == 0);
+    uint32_t n = run(&id, &p, &feedback, &command);
+    report("reversed motor", &id, n);
+    TEST_ASSERT(id.state == SYS_ID_DONE && id.fit.valid == 0);
+    TEST_ASSERT(rel_near(-8.0, id.fit.gain, 0.05));
+    TEST_ASSERT(rel_near(0.03, id.fit.time_const, 0.05));
+    TEST_ASSERT_NEAR(expect_delay(&p), id.fit.delay, DELAY_TOL);
+}
+
+static void test_limit_abort_and_arguments(void) {
+    static sys_id_t id;
+    plant_t p;
+    float32_t feedback, command;
+
+    //反馈超出限制时停止, 给定回到中心, 已测的点保留
+    plant_init(&p, SYS_ID_INTEGRATOR_FIRST_ORDER, 50.0, 0.01, 0.0, 0.0, 1, 0.0, 0.0);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_INTEGRATOR_FIRST_ORDER, 0.2f,
+                            1.0f, 5.0f, 100.0f, 10, 8.0f, DT) == 0);
+    run(&id, &p, &feedback, &command);
+    TEST_ASSERT(id.state == SYS_ID_ABORT && command == 0.2f && id.fit.valid == -1);
+    TEST_ASSERT(sys_id_update(&id) == SYS_ID_ABORT);
+
+    //参数检查和奈奎斯特限制: f_end < 1 / (4 dt), 扫频按最后一个点的上边界
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            1.0f, 250.0f, 10, 0.0f, DT) == 0);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            1.0f, 251.0f, 10, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_CHIRP, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            1.0f, 240.0f, 10, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 0.0f,
+                            1.0f, 100.0f, 10, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            10.0f, 10.0f, 10, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_init(&id, &feedback, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            1.0f, 100.0f, SYS_ID_MAX_POINT + 1, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_init(&id, NULL, &command, SYS_ID_STEPPED_SINE, SYS_ID_FIRST_ORDER, 0.0f, 1.0f,
+                            1.0f, 100.0f, 10, 0.0f, DT) == -1);
+    TEST_ASSERT(sys_id_update(NULL) == SYS_ID_ABORT);
+}
+
+static void test_update_cost(void) {
+    static sys_id_t id;
+    float32_t feedback = 0.0f, command;
+    const uint32_t n = 1000000U;
+
+    sys_id_init(&id, &feedback, &command, SYS_ID_CHIRP, SYS_ID_FIRST_ORDER, 0.0f, 1.0f, 0.01f, 0.1f, 10, 0.0f, DT);
+    uint64_t start = unit_test_now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        feedback = 0.5f * command;
+        sys_id_update(&id);
+    }
+    printf("sys_id_update: %.1f ns per call on this host\n", (double) (unit_test_now_ns() - start) / n);
+    TEST_ASSERT(id.state == SYS_ID_MEASURE || id.state == SYS_ID_SETTLE);
+}
+
+int main(void) {
+    RUN_TEST(test_fit_exact_points);
+    RUN_TEST(test_first_order_stepped_and_chirp);
+    RUN_TEST(test_resonance_stepped_and_chirp);
+    RUN_TEST(test_integrator_with_offset);
+    RUN_TEST(test_reversed_motor);
+    RUN_TEST(test_limit_abort_and_arguments);
+    RUN_TEST(test_update_cost);
+    return unit_test_result();
+}
@@ -0,0 +1,297 @@
+/**
+  * @file       test_target_tracker.c
+  * @brief      target_tracker unit checks (convergence on a constant speed
+  *             target, prediction does not move the state, stale frames, gate
+  *             and restart, timeout, yaw across the 2 pi seam) and a 1 kHz aim
+  *             simulation with noisy, dropped and delayed vision frames against
+  *             the sigmoid trajectory it replaced, with the firmware parameters.
+  *             target_tracker单元测试(匀速目标收敛、预测不改变状态、过期帧、门限和重新开始、超时、yaw跨越2pi),
+  *             以及使用固件参数、带噪声/丢帧/延迟视觉帧的1kHz瞄准仿真, 与被替换的sigmoid轨迹比较
+  */
+#include "unit_test.h"
+#include "target_tracker.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_HZ         168000000.0
+#define PI_D            3.14159265358979
+#define FRAME_MAX       1000
+
+//与gimbal_behaviour.h相同的参数
+static const float32_t firmware_q[TARGET_TRACKER_AXIS_NUM] = {20.0f, 0.5f};
+#define TRACKER_R       (0.0035f * 0.0035f)
+#define TRACKER_SPEED   2.0f
+#define TRACKER_ACCEL   10.0f
+#define TRACKER_GATE    5.0f
+#define TRACKER_TIMEOUT 0.2f
+
+static uint32_t lcg_state = 1U;
+
+static double rnd_uniform(void) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return ((lcg_state >> 8) + 0.5) / 16777216.0;
+}
+
+static double rnd_gauss(void) {
+    return sqrt(-2.0 * log(rnd_uniform())) * cos(2.0 * PI_D * rnd_uniform());
+}
+
+//DWT从回绕前开始计数
+static const uint32_t tick0 = 0xFFFFFFFFU - 168000000U;
+
+static uint32_t tick_at(double t) {
+    return tick0 + (uint32_t) (int64_t) llround(t * TICK_HZ);
+}
+
+static void tracker_init(target_tracker_t *trk, target_tracker_model_e model) {
+    target_tracker_init(trk, model, firmware_q, TRACKER_R, TRACKER_SPEED, TRACKER_ACCEL, TRACKER_GATE,
+                        TRACKER_TIMEOUT, (float32_t) TICK_HZ);
+}
+
+static void test_constant_speed(void) {
+    target_tracker_t trk;
+    target_tracker_model_e models[2] = {TARGET_TRACKER_CV, TARGET_TRACKER_CA};
+    for (int m = 0; m < 2; m++) {
+        tracker_init(&trk, models[m]);
+        float32_t aim[2] = {9.0f, 9.0f};
+        TEST_ASSERT(!target_tracker_predict(&trk, tick_at(0.0), 0.0f, aim) && aim[0] == 9.0f);
+        //yaw 0.8rad/s, pitch -0.1rad/s, 60Hz无噪声
+        for (int k = 0; k < 120; k++) {
+            double t = k / 60.0;
+            float32_t z[2] = {(float32_t) (1.0 + 0.8 * t), (float32_t) (0.05 - 0.1 * t)};
+            target_tracker_result_e res = target_tracker_update(&trk, tick_at(t), z);
+            TEST_ASSERT(res == (k == 0 ? TARGET_TRACKER_STARTED : TARGET_TRACKER_UPDATED));
+        }
+        TEST_ASSERT_NEAR(trk.axis[TARGET_TRACKER_YAW].x[1], 0.8f, 1e-3f);
+        TEST_ASSERT_NEAR(trk.axis[TARGET_TRACKER_PITCH].x[1], -0.1f, 1e-3f);
+
+        //预测到之后的时刻加提前量, 滤波状态不变
+        target_tracker_t before = trk;
+        double t = 119.0 / 60.0 + 0.03;
+        TEST_ASSERT(target_tracker_predict(&trk, tick_at(t), 0.05f, aim));
+        TEST_ASSERT_NEAR(aim[0], 1.0 + 0.8 * (t + 0.05), 1e-3f);
+        TEST_ASSERT_NEAR(aim[1], 0.05 - 0.1 * (t + 0.05), 1e-3f);
+        TEST_ASSERT(memcmp(trk.axis, before.axis, sizeof(trk.axis)) == 0 && trk.state_tick == before.state_tick);
+        TEST_ASSERT(trk.aim[0] == aim[0] && trk.aim[1] == aim[1]);
+
+        //射速为0时提前量为inf, 距离异常时为NaN或负值: 截断到上限或按0处理, 瞄准点保持有限
+        TEST_ASSERT(target_tracker_predict(&trk, tick_at(t), INFINITY, aim));
+        TEST_ASSERT_NEAR(aim[0], 1.0 + 0.8 * (t + TARGET_TRACKER_MAX_LEAD), 1e-3f);
+        TEST_ASSERT(target_tracker_predict(&trk, tick_at(t), NAN, aim));
+        TEST_ASSERT(isfinite(aim[0]) && isfinite(aim[1]));
+        TEST_ASSERT_NEAR(aim[0], 1.0 + 0.8 * t, 1e-3f);
+        TEST_ASSERT(target_tracker_predict(&trk, tick_at(t), -0.2f, aim));
+        TEST_ASSERT_NEAR(aim[0], 1.0 + 0.8 * t, 1e-3f);
+        TEST_ASSERT(memcmp(trk.axis, before.axis, sizeof(trk.axis)) == 0);
+
+        //早于状态的测量被丢弃
+        float32_t old_z[2] = {0.0f, 0.0f};
+        TEST_ASSERT(target_tracker_update(&trk, tick_at(1.0), old_z) == TARGET_TRACKER_STALE);
+        TEST_ASSERT(trk.stale_cnt == 1 && trk.axis[0].x[0] == before.axis[0].x[0]);
+    }
+}
+
+static void test_gate_and_timeout(void) {
+    target_tracker_t trk;
+    tracker_init(&trk, TARGET_TRACKER_CV);
+    double t = 0.0;
+    for (int k = 0; k < 60; k++, t += 1.0 / 60.0) {
+        float32_t z[2] = {1.0f, 0.0f};
+        target_tracker_update(&trk, tick_at(t), z);
+    }
+    //单个野值被拒绝, 不影响状态
+    float32_t far_z[2] = {1.5f, 0.0f};
+    TEST_ASSERT(target_tracker_update(&trk, tick_at(t), far_z) == TARGET_TRACKER_REJECTED);
+    t += 1.0 / 60.0;
+    float32_t z[2] = {1.0f, 0.0f};
+    TEST_ASSERT(target_tracker_update(&trk, tick_at(t), z) == TARGET_TRACKER_UPDATED);
+    TEST_ASSERT_NEAR(trk.axis[0].x[0], 1.0f, 1e-3f);
+
+    //切换到新目标: 第TARGET_TRACKER_MAX_REJECT次连续拒绝时以该测量重新开始
+    target_tracker_result_e res = TARGET_TRACKER_UPDATED;
+    int frames = 0;
+    while (res != TARGET_TRACKER_STARTED && frames < 10) {
+        t += 1.0 / 60.0;
+        res = target_tracker_update(&trk, tick_at(t), far_z);
+        frames++;
+    }
+    TEST_ASSERT(res == TARGET_TRACKER_STARTED && frames == TARGET_TRACKER_MAX_REJECT);
+    TEST_ASSERT(trk.axis[0].x[0] == 1.5f && trk.start_cnt == 2);
+
+    //超过timeout无测量丢失目标
+    float32_t aim[2];
+    TEST_ASSERT(target_tracker_predict(&trk, tick_at(t + 0.9 * TRACKER_TIMEOUT), 0.0f, aim));
+    TEST_ASSERT(!target_tracker_predict(&trk, tick_at(t + 1.1 * TRACKER_TIMEOUT), 0.0f, aim));
+    TEST_ASSERT(target_tracker_update(&trk, tick_at(t + 1.2 * TRACKER_TIMEOUT), z) == TARGET_TRACKER_STARTED);
+    target_tracker_reset(&trk);
+    TEST_ASSERT(!target_tracker_predict(&trk, tick_at(t + 1.3 * TRACKER_TIMEOUT), 0.0f, aim));
+}
+
+static void test_yaw_seam(void) {
+    //目标以1rad/s越过2pi, 视觉给出的世界yaw在[0, 2pi)内
+    target_tracker_t trk;
+    tracker_init(&trk, TARGET_TRACKER_CV);
+    uint32_t rejected = 0;
+    double yaw = 0.0;
+    for (int k = 0; k < 120; k++) {
+        double t = k / 60.0;
+        yaw = 2.0 * PI_D - 1.0 + t;
+        float32_t z[2] = {(float32_t) fmod(yaw, 2.0 * PI_D), 0.0f};
+        rejected += target_tracker_update(&trk, tick_at(t), z) != (k == 0 ? TARGET_TRACKER_STARTED :
+                                                                      TARGET_TRACKER_UPDATED);
+    }
+    TEST_ASSERT(rejected == 0 && trk.start_cnt == 1);
+    TEST_ASSERT_NEAR(trk.axis[0].x[1], 1.0f, 1e-2f);
+    //yaw状态连续, 与真实角相差2pi的整数倍
+    double diff = trk.axis[0].x[0] - yaw;
+    TEST_ASSERT_NEAR(diff - 2.0 * PI_D * round(diff / (2.0 * PI_D)), 0.0, 1e-3);
+}
+
+//被替换的做法: 每帧以偏差的一半生成sigmoid增量轨迹
+static void sigmoid_trajectory(float32_t end, int len, float32_t *p_step) {
+    float32_t step = 12.0f / (float32_t) (len - 1), prev = 0.0f;
+    for (int i = 0; i < len - 1; i++) {
+        float32_t y = end / (1.0f + expf(-(-6.0f + i * step)));
+        p_step[i] = y - prev;
+        prev = y;
+    }
+}
+
+typedef struct {
+    double t_capture;
+    double t_arrive;
+    float32_t z[2];
+} frame_t;
+
+//目标: yaw 平移加小陀螺式的较快摆动, pitch 小幅摆动
+static double target_angle(int axis, double t) {
+    return axis == 0 ? 1.0 + 0.3 * sin(2.0 * PI_D * 0.8 * t) + 0.1 * sin(2.0 * PI_D * 2.5 * t) :
+           0.05 * sin(2.0 * PI_D * 0.5 * t);
+}
+
+static void aim_sim(double drop, double latency_lo, double latency_hi, double rms_tracker[2],
+                    double rms_legacy[2], target_tracker_t *trk) {
+    static frame_t frame[FRAME_MAX];
+    const double lead = 0.05, noise = 0.0035;
+    int frame_num = 0;
+    for (double tc = 0.05; tc < 10.0 && frame_num < FRAME_MAX; tc += 1.0 / 60.0 + 0.002 * rnd_gauss()) {
+        if (rnd_uniform() < drop) {
+            continue;
+        }
+        frame[frame_num].t_capture = tc;
+        frame[frame_num].t_arrive = tc + latency_lo + (latency_hi - latency_lo) * rnd_uniform();
+        for (int a = 0; a < 2; a++) {
+            frame[frame_num].z[a] = (float32_t) (target_angle(a, tc) + noise * rnd_gauss());
+        }
+        frame_num++;
+    }
+    //延迟不同时可能乱序到达
+    for (int i = 1; i < frame_num; i++) {
+        frame_t f = frame[i];
+        int j = i - 1;
+        for (; j >= 0 && frame[j].t_arrive > f.t_arrive; j--) {
+            frame[j + 1] = frame[j];
+        }
+        frame[j + 1] = f;
+    }
+
+    tracker_init(trk, TARGET_TRACKER_CV);
+    //理想云台: 姿态等于设定值
+    float32_t set_legacy[2] = {1.0f, 0.0f}, set_tracker[2] = {1.0f, 0.0f};
+    static float32_t trajectory[2][200];
+    int point = 0, period = 1000 / 60;
+    double sum_legacy[2] = {0}, sum_tracker[2] = {0};
+    int samples = 0, fi = 0;
+    memset(trajectory, 0, sizeof(trajectory));
+    for (int k = 0; k < 10000; k++) {
+        double t = k * 1e-3;
+        while (fi < frame_num && frame[fi].t_arrive <= t) {
+            for (int a = 0; a < 2; a++) {
+                sigmoid_trajectory((frame[fi].z[a] - set_legacy[a]) / 2.0f, period * 2, trajectory[a]);
+            }
+            point = 0;
+            target_tracker_update(trk, tick_at(frame[fi].t_capture), frame[fi].z);
+            fi++;
+        }
+        set_legacy[0] += trajectory[0][point];
+        set_legacy[1] += trajectory[1][point];
+        if (++point > period - 1) {
+            point = 0;
+        }
+        float32_t aim[2];
+        if (target_tracker_predict(trk, tick_at(t), (float32_t) lead, aim)) {
+            set_tracker[0] = aim[0];
+            set_tracker[1] = aim[1];
+        }
+        if (t > 1.0) {
+            for (int a = 0; a < 2; a++) {
+                double e_legacy = target_angle(a, t + lead) - set_legacy[a];
+                double e_tracker = target_angle(a, t + lead) - set_tracker[a];
+                sum_legacy[a] += e_legacy * e_legacy;
+                sum_tracker[a] += e_tracker * e_tracker;
+            }
+            samples++;
+        }
+    }
+    for (int a = 0; a < 2; a++) {
+        rms_legacy[a] = sqrt(sum_legacy[a] / samples);
+        rms_tracker[a] = sqrt(sum_tracker[a] / samples);
+    }
+}
+
+static void test_aim_simulation(void) {
+    const double cases[][3] = {{0.0, 0.02, 0.02}, {0.1, 0.02, 0.04}, {0.3, 0.02, 0.06}};
+    for (int c = 0; c < 3; c++) {
+        target_tracker_t trk;
+        double rms_tracker[2], rms_legacy[2];
+        aim_sim(cases[c][0], cases[c][1], cases[c][2], rms_tracker, rms_legacy, &trk);
+        TEST_ASSERT(rms_tracker[0] < 0.7 * rms_legacy[0]);
+        TEST_ASSERT(rms_tracker[1] < 0.7 * rms_legacy[1]);
+        //整个过程只有一次开始跟踪, 几乎没有拒绝
+        TEST_ASSERT(trk.start_cnt == 1 && trk.reject_cnt * 50U <= trk.update_cnt);
+        printf("drop %2.0f%% latency %2.0f-%2.0f ms: aim rms yaw %.4f (sigmoid %.4f), pitch %.4f (sigmoid %.4f) rad, "
+               "%u updates %u rejects %u stale\n", cases[c][0] * 100.0, cases[c][1] * 1e3, cases[c][2] * 1e3,
+               rms_tracker[0], rms_legacy[0], rms_tracker[1], rms_legacy[1], trk.update_cnt, trk.reject_cnt,
+               trk.stale_cnt);
+    }
+}
+
+static void test_cost(void) {
+    //每帧: 融合一次; 每毫秒: 预测一次. 被替换的做法每帧生成两条轨迹
+    target_tracker_t trk;
+    tracker_init(&trk, TARGET_TRACKER_CV);
+    static float32_t trajectory[200];
+    const int rounds = 100000;
+    float32_t aim[2], sink = 0.0f;
+    uint64_t start = unit_test_now_ns();
+    for (int k = 0; k < rounds; k++) {
+        float32_t z[2] = {(float32_t) (k & 7) * 1e-4f, 0.0f};
+        target_tracker_update(&trk, tick_at(k / 60.0), z);
+    }
+    uint64_t update_ns = unit_test_now_ns() - start;
+    start = unit_test_now_ns();
+    for (int k = 0; k < rounds; k++) {
+        target_tracker_predict(&trk, tick_at((rounds - 1) / 60.0 + k * 1e-6), 0.05f, aim);
+        sink += aim[0];
+    }
+    uint64_t predict_ns = unit_test_now_ns() - start;
+    start = unit_test_now_ns();
+    for (int k = 0; k < rounds; k++) {
+        sigmoid_trajectory((float32_t) (k & 7) * 1e-4f, 34, trajectory);
+        sink += trajectory[5];
+    }
+    uint64_t sigmoid_ns = unit_test_now_ns() - start;
+    TEST_ASSERT(isfinite(sink));
+    printf("update %.1f ns, predict %.1f ns, 34 point sigmoid trajectory %.1f ns\n", (double) update_ns / rounds,
+           (double) predict_ns / rounds, (double) sigmoid_ns / rounds);
+}
+
+int main(void) {
+    RUN_TEST(test_constant_speed);
+    RUN_TEST(test_gate_and_timeout);
+    RUN_TEST(test_yaw_seam);
+    RUN_TEST(test_aim_simulation);
+    RUN_TEST(test_cost);
+    return unit_test_result();
+}
@@ -0,0 +1,245 @@
+/**
+  * @file       test_telemetry.c
+  * @brief      the telemetry frame codec byte by byte (SOF, type, seq, length,
+  *             CRC16, schema and sample payloads), the schema repeat period,
+  *             the transport called with interrupts enabled while a sample taken
+  *             during the write is kept, drops while the transport stays busy,
+  *             and a 1 kHz stream across a DWT wrap written for
+  *             telemetry_decode.py.
+  *             逐字节检查遥测帧编码(SOF、类型、序号、长度、CRC16、通道表和采样数据), 通道表重发周期,
+  *             调用发送端时中断未屏蔽且发送期间的采样不丢失, 发送端持续忙时丢帧, 以及写出一段
+  *             跨DWT回绕的1kHz数据流供telemetry_decode.py解码
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "telemetry.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+#define TICK_HZ         168000000U
+#define STREAM_NUM      2000U
+
+static telemetry_t tm;
+static float sine;
+static int16_t ramp;
+static uint32_t count;
+
+//发送端模型, 收到的字节写入wire
+static uint8_t wire[STREAM_NUM * 32U];
+static uint32_t wire_len;
+static bool write_busy;
+static uint32_t write_cnt, write_masked_cnt;
+static bool sample_in_write;    //在发送期间采样一次, 模拟更高优先级的任务
+
+static int wire_write(const uint8_t *p_data, uint16_t len) {
+    write_cnt++;
+    if (host_primask != 0U) {
+        write_masked_cnt++;
+    }
+    if (write_busy) {
+        return -1;
+    }
+    if (sample_in_write) {
+        sample_in_write = false;
+        count++;
+        telemetry_sample(&tm, count);
+    }
+    if (wire_len + len <= sizeof(wire)) {
+        memcpy(&wire[wire_len], p_data, len);
+        wire_len += len;
+    }
+    return 0;
+}
+
+static void wire_reset(uint16_t flush_len) {
+    wire_len = 0U;
+    write_busy = false;
+    write_cnt = write_masked_cnt = 0U;
+    sample_in_write = false;
+    telemetry_init(&tm, wire_write, TICK_HZ, flush_len);
+    telemetry_add(&tm, "sine", &sine, TELEMETRY_FLOAT);
+    telemetry_add(&tm, "ramp", &ramp, TELEMETRY_INT16);
+    telemetry_add(&tm, "count", &count, TELEMETRY_UINT32);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+typedef struct {
+    uint32_t schema_num;
+    uint32_t sample_num;
+    uint32_t timestamp[64];
+    uint32_t count[64];
+} wire_frames_t;
+
+//逐帧检查线上数据: 帧头、序号连续、CRC16、通道表内容和采样长度
+static void wire_parse(wire_frames_t *p_out) {
+    uint32_t pos = 0U;
+    int last_seq = -1;
+
+    memset(p_out, 0, sizeof(wire_frames_t));
+    while (pos < wire_len) {
+        const uint8_t *p = &wire[pos];
+        uint16_t len = get_u16(&p[3]);
+        uint32_t frame_len = TELEMETRY_FRAME_HEAD_SIZE + len + TELEMETRY_FRAME_TAIL_SIZE;
+        TEST_ASSERT(p[0] == TELEMETRY_SOF && pos + frame_len <= wire_len);
+        if (p[0] != TELEMETRY_SOF || pos + frame_len > wire_len) {
+            return;
+        }
+        TEST_ASSERT(verify_CRC16_check_sum((uint8_t *) p, frame_len));
+        TEST_ASSERT(last_seq < 0 || p[2] == (uint8_t) (last_seq + 1));
+        last_seq = p[2];
+        const uint8_t *p_data = p + TELEMETRY_FRAME_HEAD_SIZE;
+        if (p[1] == TELEMETRY_FRAME_SCHEMA) {
+            TEST_ASSERT(len == 5U + 3U * (1U + TELEMETRY_NAME_LEN));
+            TEST_ASSERT(get_u32(p_data) == TICK_HZ && p_data[4] == 3U);
+            TEST_ASSERT(p_data[5] == TELEMETRY_FLOAT && strcmp((const char *) &p_data[6], "sine") == 0);
+            TEST_ASSERT(p_data[21] == TELEMETRY_INT16 && strcmp((const char *) &p_data[22], "ramp") == 0);
+            TEST_ASSERT(p_data[37] == TELEMETRY_UINT32 && strcmp((const char *) &p_data[38], "count") == 0);
+            p_out->schema_num++;
+        } else {
+            TEST_ASSERT(p[1] == TELEMETRY_FRAME_SAMPLE);
+            TEST_ASSERT(len == 4U + 4U + 2U + 4U);
+            if (p_out->sample_num < 64U) {
+                p_out->timestamp[p_out->sample_num] = get_u32(p_data);
+                p_out->count[p_out->sample_num] = get_u32(&p_data[10]);
+            }
+            p_out->sample_num++;
+        }
+        pos += frame_len;
+    }
+}
+
+static void test_frame_codec(void) {
+    wire_frames_t frames;
+
+    wire_reset(1U);
+    sine = -1.5f;
+    ramp = -1234;
+    count = 0xA1B2C3D4U;
+    telemetry_sample(&tm, 0x01020304U);
+    //首次采样先发通道表, 每帧立即发送
+    wire_parse(&frames);
+    TEST_ASSERT(frames.schema_num == 1U && frames.sample_num == 1U);
+    TEST_ASSERT(tm.frame_cnt == 2U && tm.drop_cnt == 0U && write_cnt == 1U);
+
+    //采样帧: 时间戳和各通道值小端紧密排列
+    const uint8_t *p = &wire[TELEMETRY_FRAME_HEAD_SIZE + 5U + 3U * 16U + TELEMETRY_FRAME_TAIL_SIZE];
+    static const uint8_t expect[] = {TELEMETRY_SOF, TELEMETRY_FRAME_SAMPLE, 1, 14, 0,
+                                     0x04, 0x03, 0x02, 0x01,
+                                     0x00, 0x00, 0xC0, 0xBF,
+                                     0x2E, 0xFB,
+                                     0xD4, 0xC3, 0xB2, 0xA1};
+    TEST_ASSERT(memcmp(p, expect, sizeof(expect)) == 0);
+    TEST_ASSERT(get_u16(&p[sizeof(expect)]) == get_CRC16_check_sum((uint8_t *) p, sizeof(expect), 0xFFFF));
+    TEST_ASSERT(host_primask == 0U && write_masked_cnt == 0U);
+}
+
+static void test_schema_period(void) {
+    wire_frames_t frames;
+
+    wire_reset(1U);
+    for (uint32_t i = 0; i < 2U * TELEMETRY_SCHEMA_PERIOD + 1U; i++) {
+        telemetry_sample(&tm, i);
+    }
+    wire_parse(&frames);
+    TEST_ASSERT(frames.schema_num == 3U && frames.sample_num == 2U * TELEMETRY_SCHEMA_PERIOD + 1U);
+
+    //新注册通道后先重发通道表
+    static float extra;
+    wire_len = 0U;
+    telemetry_add(&tm, "extra", &extra, TELEMETRY_FLOAT);
+    telemetry_sample(&tm, 0U);
+    TEST_ASSERT(wire[0] == TELEMETRY_SOF && wire[1] == TELEMETRY_FRAME_SCHEMA && wire[TELEMETRY_FRAME_HEAD_SIZE + 4] == 4U);
+}
+
+//发送端在临界区外调用, 发送期间打包的帧追加在已交出的数据之后, 发送成功后移到另一个缓存
+static void test_sample_during_write(void) {
+    wire_frames_t frames;
+
+    wire_reset(120U);
+    count = 0U;
+    telemetry_sample(&tm, count);
+    count = 1U;
+    telemetry_sample(&tm, count);
+    //通道表60字节+3条21字节的采样超过120字节时发送, 发送期间采样的第4条留在缓存中
+    count = 2U;
+    sample_in_write = true;
+    telemetry_sample(&tm, count);
+    TEST_ASSERT(write_cnt == 1U && write_masked_cnt == 0U && count == 3U);
+    TEST_ASSERT(tm.batch_len == TELEMETRY_FRAME_HEAD_SIZE + 14U + TELEMETRY_FRAME_TAIL_SIZE);
+    TEST_ASSERT(wire_len == 60U + 3U * 21U);
+    telemetry_flush(&tm);
+    wire_parse(&frames);
+    TEST_ASSERT(frames.schema_num == 1U && frames.sample_num == 4U);
+    for (uint32_t i = 0; i < 4U; i++) {
+        TEST_ASSERT(frames.count[i] == i);
+    }
+    TEST_ASSERT(tm.batch_len == 0U && tm.drop_cnt == 0U && host_primask == 0U);
+}
+
+static void test_busy_drop_and_recover(void) {
+    wire_frames_t frames;
+    const uint32_t frame_len = TELEMETRY_FRAME_HEAD_SIZE + 14U + TELEMETRY_FRAME_TAIL_SIZE;
+
+    wire_reset(1U);
+    write_busy = true;
+    for (count = 0; count < 100U; count++) {
+        telemetry_sample(&tm, count);
+    }
+    //缓存满后丢弃新帧, 每次采样都重试发送
+    TEST_ASSERT(tm.drop_cnt > 0U && tm.batch_len + frame_len > TELEMETRY_BATCH_SIZE);
+    TEST_ASSERT(write_cnt >= 100U && write_masked_cnt == 0U && wire_len == 0U);
+    uint32_t packed = tm.frame_cnt;
+
+    write_busy = false;
+    telemetry_sample(&tm, count);
+    wire_parse(&frames);
+    //缓存中的帧和本次采样全部发出, 序号连续
+    TEST_ASSERT(frames.schema_num + frames.sample_num == packed + 1U);
+    TEST_ASSERT(frames.count[0] == 0U && tm.batch_len == 0U);
+}
+
+//1kHz采样, 时间戳跨DWT回绕, USB方式批量发送, 偶尔发送端忙
+static void test_write_stream(void) {
+    const uint32_t tick_per_ms = TICK_HZ / 1000U;
+    uint32_t timestamp = 0xFFFFFFFFU - (STREAM_NUM / 2U) * tick_per_ms;
+    wire_frames_t frames;
+
+    wire_reset(256U);
+    for (count = 0; count < STREAM_NUM; count++) {
+        sine = sinf((float) count * 0.01f);
+        ramp = (int16_t) (count * 16U);
+        write_busy = (count % 50U) < 3U;
+        telemetry_sample(&tm, timestamp);
+        timestamp += tick_per_ms;
+    }
+    write_busy = false;
+    telemetry_flush(&tm);
+    wire_parse(&frames);
+    TEST_ASSERT(tm.drop_cnt == 0U && write_masked_cnt == 0U);
+    TEST_ASSERT(frames.sample_num == STREAM_NUM && frames.schema_num == STREAM_NUM / TELEMETRY_SCHEMA_PERIOD);
+
+    FILE *f = fopen(TELEMETRY_FILE, "wb");
+    TEST_ASSERT(f != NULL);
+    if (f != NULL) {
+        TEST_ASSERT(fwrite(wire, 1, wire_len, f) == wire_len);
+        fclose(f);
+    }
+    printf("stream: %u bytes, %u samples, %u writes\n", (unsigned) wire_len, STREAM_NUM, (unsigned) write_cnt);
+}
+
+int main(void) {
+    RUN_TEST(test_frame_codec);
+    RUN_TEST(test_schema_period);
+    RUN_TEST(test_sample_during_write);
+    RUN_TEST(test_busy_drop_and_recover);
+    RUN_TEST(test_write_stream);
+    return unit_test_result();
+}
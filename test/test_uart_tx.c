@@ -0,0 +1,198 @@
+/**
+  * @file       test_uart_tx.c
+  * @brief      uart_tx against a fake dma: priority and commit order, deadline
+  *             drops, pool exhaustion, and stall recovery, where the dma must be
+  *             stopped before the stalled frame goes back to the pool. A mixed
+  *             load run checks that the dma never reads a pooled buffer.
+  *             uart_tx与模拟DMA: 优先级和提交顺序, 截止时间丢帧, 帧缓存耗尽, 以及完成中断丢失后的恢复,
+  *             回收卡住的帧之前必须先停止DMA. 混合负载下检查DMA从不读取已归还的缓存
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+#include "uart_tx.h"
+#include <string.h>
+
+static uart_tx_port_t port;
+static uint32_t now_ms;
+
+//模拟DMA
+static const uint8_t *dma_p;
+static uint16_t dma_len;
+static bool dma_busy, dma_lost;
+static uint32_t dma_start_cnt, dma_double_start, abort_cnt;
+static uint8_t wire[4096];
+static uint32_t wire_len;
+
+static void dma_start(const uint8_t *p_data, uint16_t len) {
+    dma_double_start += dma_busy;
+    dma_busy = true;
+    dma_lost = false;
+    dma_p = p_data;
+    dma_len = len;
+    dma_start_cnt++;
+}
+
+static void dma_abort(void) {
+    dma_busy = false;
+    abort_cnt++;
+}
+
+static uint32_t get_tick(void) {
+    return now_ms;
+}
+
+static bool frame_is_free(const uint8_t *p_data) {
+    for (uart_tx_frame_t *p_frame = port.p_free; p_frame != NULL; p_frame = p_frame->p_next) {
+        if (p_frame->data == p_data) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//DMA发送完一帧后进入完成中断
+static void dma_finish(void) {
+    if (wire_len + dma_len <= sizeof(wire)) {
+        memcpy(&wire[wire_len], dma_p, dma_len);
+        wire_len += dma_len;
+    }
+    dma_busy = false;
+    uart_tx_complete_irq(&port);
+}
+
+static void port_reset(void) {
+    dma_busy = false;
+    dma_start_cnt = dma_double_start = abort_cnt = wire_len = 0;
+    now_ms = 1000U;
+    uart_tx_init(&port, dma_start, dma_abort, get_tick);
+}
+
+static void test_priority_order(void) {
+    port_reset();
+    //第一帧立即发送, 其余排队
+    uart_tx_send(&port, (const uint8_t *) "a", 1, UART_TX_PRIORITY_LOW, 0);
+    uart_tx_send(&port, (const uint8_t *) "b", 1, UART_TX_PRIORITY_LOW, 0);
+    uart_tx_send(&port, (const uint8_t *) "c", 1, UART_TX_PRIORITY_NORMAL, 0);
+    uart_tx_send(&port, (const uint8_t *) "d", 1, UART_TX_PRIORITY_HIGH, 0);
+    uart_tx_send(&port, (const uint8_t *) "e", 1, UART_TX_PRIORITY_NORMAL, 0);
+    //非法优先级按最低处理
+    uart_tx_send(&port, (const uint8_t *) "f", 1, 9, 0);
+    TEST_ASSERT(uart_tx_pending(&port) == 5);
+    while (dma_busy) {
+        dma_finish();
+    }
+    TEST_ASSERT(wire_len == 6 && memcmp(wire, "adcebf", 6) == 0);
+    TEST_ASSERT(port.sent_cnt == 6 && port.sent_bytes == 6 && port.p_active == NULL);
+    TEST_ASSERT(dma_double_start == 0 && host_primask == 0U);
+}
+
+static void test_deadline_and_pool(void) {
+    port_reset();
+    uint8_t data[UART_TX_FRAME_SIZE + 1];
+    memset(data, 0x33, sizeof(data));
+    TEST_ASSERT(uart_tx_send(&port, data, UART_TX_FRAME_SIZE + 1, 0, 0) == -1);
+    TEST_ASSERT(uart_tx_send(&port, NULL, 1, 0, 0) == -1);
+
+    uart_tx_send(&port, (const uint8_t *) "1", 1, UART_TX_PRIORITY_NORMAL, 0);
+    uart_tx_send(&port, (const uint8_t *) "2", 1, UART_TX_PRIORITY_NORMAL, 5);
+    uart_tx_send(&port, (const uint8_t *) "3", 1, UART_TX_PRIORITY_NORMAL, 20);
+    //"2"在队首时已过期
+    now_ms += 10U;
+    while (dma_busy) {
+        dma_finish();
+    }
+    TEST_ASSERT(wire_len == 2 && memcmp(wire, "13", 2) == 0);
+    TEST_ASSERT(port.drop_expired_cnt == 1 && port.queue_ms_max == 10U);
+
+    //帧缓存耗尽后返回-1, 发送完成后归还
+    int ok = 0;
+    for (int i = 0; i < UART_TX_FRAME_NUM + 3; i++) {
+        ok += uart_tx_send(&port, data, 8, UART_TX_PRIORITY_LOW, 0) == 0;
+    }
+    TEST_ASSERT(ok == UART_TX_FRAME_NUM && port.drop_full_cnt == 3);
+    TEST_ASSERT(uart_tx_alloc(&port) == NULL);
+    dma_finish();
+    uart_tx_frame_t *p_frame = uart_tx_alloc(&port);
+    TEST_ASSERT(p_frame != NULL);
+    uart_tx_release(&port, p_frame);
+    while (dma_busy) {
+        dma_finish();
+    }
+    TEST_ASSERT(uart_tx_pending(&port) == 0 && host_primask == 0U);
+}
+
+static void test_stall_recovery(void) {
+    port_reset();
+    uart_tx_send(&port, (const uint8_t *) "x", 1, UART_TX_PRIORITY_NORMAL, 0);
+    const uint8_t *p_stalled = dma_p;
+    //完成中断丢失, 未超过阈值时只排队
+    now_ms += UART_TX_STALL_MS;
+    uart_tx_send(&port, (const uint8_t *) "y", 1, UART_TX_PRIORITY_NORMAL, 0);
+    TEST_ASSERT(port.stall_cnt == 0 && abort_cnt == 0 && dma_p == p_stalled);
+
+    now_ms += 1U;
+    uart_tx_send(&port, (const uint8_t *) "z", 1, UART_TX_PRIORITY_NORMAL, 0);
+    //先停止DMA, 再回收卡住的帧并启动下一帧
+    TEST_ASSERT(port.stall_cnt == 1 && abort_cnt == 1);
+    TEST_ASSERT(dma_double_start == 0);
+    TEST_ASSERT(dma_busy && dma_len == 1 && dma_p[0] == 'y');
+    TEST_ASSERT(frame_is_free(p_stalled));
+    while (dma_busy) {
+        dma_finish();
+    }
+    TEST_ASSERT(wire_len == 2 && memcmp(wire, "yz", 2) == 0);
+
+    //帧缓存全部在队列中时, 申请帧也会恢复卡住的端口
+    port_reset();
+    while (uart_tx_send(&port, (const uint8_t *) "r", 1, UART_TX_PRIORITY_NORMAL, 0) == 0) {
+    }
+    p_stalled = dma_p;
+    now_ms += UART_TX_STALL_MS + 1U;
+    TEST_ASSERT(uart_tx_send(&port, (const uint8_t *) "s", 1, UART_TX_PRIORITY_NORMAL, 0) == 0);
+    TEST_ASSERT(port.stall_cnt == 1 && abort_cnt == 1 && dma_p != p_stalled && !frame_is_free(dma_p));
+    TEST_ASSERT(host_primask == 0U);
+}
+
+static void test_mixed_load(void) {
+    //每毫秒提交3帧, DMA每毫秒完成1帧, 偶尔丢失完成中断
+    port_reset();
+    uint32_t lcg = 1U, sent = 0, bad_read = 0;
+    for (uint32_t t = 0; t < 20000U; t++) {
+        now_ms++;
+        for (int k = 0; k < 3; k++) {
+            lcg = lcg * 1103515245U + 12345U;
+            uint8_t data[40];
+            memset(data, (int) (lcg >> 24), sizeof(data));
+            uint8_t priority = (uint8_t) ((lcg >> 8) % UART_TX_PRIORITY_NUM);
+            sent += uart_tx_send(&port, data, (uint16_t) (1 + (lcg >> 16) % 40U), priority,
+                                 priority == UART_TX_PRIORITY_LOW ? 5 : 0) == 0;
+        }
+        if (dma_busy) {
+            bad_read += frame_is_free(dma_p);
+            lcg = lcg * 1103515245U + 12345U;
+            if ((lcg >> 8) % 500U == 0U) {
+                //该帧的完成中断丢失, 直到被停止
+                dma_lost = true;
+            }
+            if (!dma_lost) {
+                wire_len = 0;
+                dma_finish();
+            }
+        }
+    }
+    TEST_ASSERT(bad_read == 0 && dma_double_start == 0);
+    TEST_ASSERT(port.stall_cnt > 0 && port.stall_cnt == abort_cnt);
+    TEST_ASSERT(port.drop_expired_cnt > 0 && port.drop_full_cnt > 0);
+    TEST_ASSERT(host_primask == 0U);
+    printf("%u committed, %u sent, %u expired, %u pool full, %u stalls, queue max %u ms\n", sent, port.sent_cnt,
+           port.drop_expired_cnt, port.drop_full_cnt, port.stall_cnt, port.queue_ms_max);
+}
+
+int main(void) {
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_deadline_and_pool);
+    RUN_TEST(test_stall_recovery);
+    RUN_TEST(test_mixed_load);
+    return unit_test_result();
+}
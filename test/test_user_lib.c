@@ -0,0 +1,90 @@
+/**
+  * @file       test_user_lib.c
+  * @brief      fast inverse square root, limits, dead bands, loop constrain,
+  *             ramp and first order filter of user_lib.
+  *             user_lib的快速开方倒数、限幅、死区、循环限幅、斜波和一阶滤波
+  */
+#include "unit_test.h"
+#include "user_lib.h"
+#include "arm_math.h"
+
+static void test_inv_sqrt(void) {
+    //一次牛顿迭代, 相对误差小于0.2%
+    const float32_t values[] = {1e-4f, 0.01f, 0.5f, 1.0f, 2.0f, 9.81f, 100.0f, 1e6f};
+    for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        float32_t exact = 1.0f / sqrtf(values[i]);
+        TEST_ASSERT_NEAR(exact, invSqrt(values[i]), 2e-3f * exact);
+    }
+}
+
+static void test_constrain_and_deadline(void) {
+    TEST_ASSERT(fp32_constrain(3.0f, -1.0f, 2.0f) == 2.0f);
+    TEST_ASSERT(fp32_constrain(-3.0f, -1.0f, 2.0f) == -1.0f);
+    TEST_ASSERT(fp32_constrain(0.5f, -1.0f, 2.0f) == 0.5f);
+    TEST_ASSERT(int16_constrain(-32768, -100, 100) == -100);
+    TEST_ASSERT(int32_constrain(1 << 30, 0, 1000) == 1000);
+
+    TEST_ASSERT(fp32_deadline(0.05f, -0.1f, 0.1f) == 0.0f);
+    TEST_ASSERT(fp32_deadline(0.15f, -0.1f, 0.1f) == 0.15f);
+    TEST_ASSERT(int16_deadline(-9, -10, 10) == 0);
+    TEST_ASSERT(int16_deadline(-10, -10, 10) == -10);
+
+    float32_t v = 7.0f;
+    abs_limit(&v, 5.0f);
+    TEST_ASSERT(v == 5.0f);
+    v = -7.0f;
+    abs_limit(&v, 5.0f);
+    TEST_ASSERT(v == -5.0f);
+    TEST_ASSERT(sign(0.0f) == 1.0f && sign(-0.1f) == -1.0f);
+}
+
+static void test_loop_constrain(void) {
+    TEST_ASSERT_NEAR(-170.0f, theta_format(190.0f), 1e-4f);
+    TEST_ASSERT_NEAR(170.0f, theta_format(-190.0f), 1e-4f);
+    TEST_ASSERT_NEAR(10.0f, theta_format(730.0f), 1e-3f);
+    TEST_ASSERT(loop_uint16_constrain(8200, 0, 8191) == 9);
+    TEST_ASSERT(loop_fp32_constrain(1.0f, 2.0f, 0.0f) == 1.0f);     //区间无效时原样返回
+
+    TEST_ASSERT_NEAR(-0.2f, jump_error(2 * PI - 0.2f, 2 * PI), 1e-5f);
+    TEST_ASSERT_NEAR(0.2f, jump_error(-2 * PI + 0.2f, 2 * PI), 1e-5f);
+    TEST_ASSERT_NEAR(1.0f, jump_error(1.0f, 2 * PI), 1e-7f);
+}
+
+static void test_ramp(void) {
+    ramp_function_source_t ramp;
+    ramp_init(&ramp, 0.002f, 1.0f, -0.5f);
+    for (int i = 0; i < 100; i++) {
+        ramp_calc(&ramp, 2.0f);
+    }
+    TEST_ASSERT_NEAR(0.4f, ramp.out, 1e-5f);
+    for (int i = 0; i < 1000; i++) {
+        ramp_calc(&ramp, 2.0f);
+    }
+    TEST_ASSERT(ramp.out == 1.0f);
+    for (int i = 0; i < 1000; i++) {
+        ramp_calc(&ramp, -2.0f);
+    }
+    TEST_ASSERT(ramp.out == -0.5f);
+}
+
+static void test_first_order_filter(void) {
+    //num/(num+T)的离散一阶惯性, 阶跃响应在一个时间常数后约为63%
+    first_order_filter_type_t filter;
+    first_order_filter_init(&filter, 0.001f, 0.1f);
+    for (int i = 0; i < 100; i++) {
+        first_order_filter_cali(&filter, 1.0f);
+    }
+    TEST_ASSERT_NEAR(1.0f - powf(0.1f / 0.101f, 100.0f), filter.out, 1e-5f);
+    TEST_ASSERT_NEAR(0.63f, filter.out, 0.01f);
+    first_order_filter_clear(&filter);
+    TEST_ASSERT(filter.out == 0.0f && filter.input == 0.0f);
+}
+
+int main(void) {
+    RUN_TEST(test_inv_sqrt);
+    RUN_TEST(test_constrain_and_deadline);
+    RUN_TEST(test_loop_constrain);
+    RUN_TEST(test_ramp);
+    RUN_TEST(test_first_order_filter);
+    return unit_test_result();
+}
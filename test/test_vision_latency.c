@@ -0,0 +1,362 @@
+/**
+  * @file       test_vision_latency.c
+  * @brief      the vision capture time on a byte-level model of USART1: frames
+  *             are sent with a known capture time, several frames share one IDLE
+  *             chunk or one frame is split across two, and the parser runs late
+  *             in random batches. Every frame must get the tick of the chunk that
+  *             holds its first byte. Then a synthetic gimbal/target replay at
+  *             10/30/60 ms latency through the attitude history, compared with
+  *             using the current attitude, and the history miss path.
+  *             USART1逐字节模型上的视觉拍摄时刻: 以已知拍摄时刻发送帧, 多帧共用一个空闲中断片段或一帧分在两个片段中,
+  *             解析随机成批滞后.每帧必须使用其第一个字节所在片段的时刻.然后在10/30/60ms延迟下经姿态历史回放
+  *             合成的云台/目标运动, 与直接使用当前姿态比较, 以及超出姿态历史的情况
+  */
+#include "unit_test.h"
+#include "host_shim.h"
+#include "cmsis_host.h"
+//直接包含源文件, 测试中代替串口中断和vision_rx_task
+#include "../User/Application/vision_task.c"
+#include "attitude_history.h"
+#include <math.h>
+#include <string.h>
+
+#define CYCLES_PER_US   168U
+#define BAUD_RATE       115200U
+#define BYTE_US         (10.0 * 1e6 / BAUD_RATE)
+#define FRAME_LEN       ((uint16_t) sizeof(vision_sync_struct))
+#define FRAME_NUM       4000U
+#define PI_F            3.14159265358979
+
+UART_HandleTypeDef huart1 = {.Init.BaudRate = BAUD_RATE};
+TaskHandle_t matlab_tx_task_local_handler;
+task_time_record_t global_task_time;
+static uint32_t tick_base;
+static double now_us;
+static attitude_history_t history;
+
+static uint32_t lcg_state = 1U;
+
+static uint32_t rnd(uint32_t n) {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return (lcg_state >> 8) % n;
+}
+
+//DWT从回绕前开始计数
+static uint32_t us_tick(double us) {
+    return tick_base + (uint32_t) (int64_t) llround(us * CYCLES_PER_US);
+}
+
+uint32_t DWT_get_tick(void) {
+    return us_tick(now_us);
+}
+
+uint32_t DWT_us_to_tick(uint32_t us) {
+    return us * CYCLES_PER_US;
+}
+
+void DWT_get_time_interval_us(time_record_struct *task_time) {
+    (void) task_time;
+}
+
+void detect_hook(uint8_t toe) {
+    (void) toe;
+}
+
+void usart1_rx_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_buf_num) {
+    (void) rx1_buf;
+    (void) rx2_buf;
+    (void) dma_buf_num;
+}
+
+void usart1_tx_init(void) {
+}
+
+void Error_Handler(void) {
+    TEST_ASSERT(0);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return NULL;
+}
+
+BaseType_t xTaskGetSchedulerState(void) {
+    return taskSCHEDULER_NOT_STARTED;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    (void) xTaskToNotify;
+    (void) pxHigherPriorityTaskWoken;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    (void) xClearCountOnExit;
+    (void) xTicksToWait;
+    return 0;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return 0;
+}
+
+void vTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement) {
+    (void) pxPreviousWakeTime;
+    (void) xTimeIncrement;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+    (void) xTask;
+    return 0;
+}
+
+attitude_history_result_e get_INS_angle_at(uint32_t tick, float32_t angle[3]) {
+    return attitude_history_lookup(&history, tick, angle);
+}
+
+//每帧的拍摄时刻和算出的拍摄时刻, 以data3为序号
+static double cap_us[FRAME_NUM], send_us[FRAME_NUM];
+static int64_t tick_err[FRAME_NUM];
+static uint32_t seen, order_err;
+
+static void record_frame(const uint8_t *p_frame, uint16_t frame_len, uint16_t cmd_id) {
+    vision_frame_update(p_frame, frame_len, cmd_id);
+    uint16_t seq;
+    memcpy(&seq, p_frame + sizeof(vision_frame_header) + offsetof(vision_frame_data, data3), sizeof(seq));
+    if (seq != seen) {
+        order_err++;
+    }
+    tick_err[seq] = (int32_t) (global_vision_info.vision_control.capture_tick - us_tick(cap_us[seq]));
+    seen++;
+}
+
+static void vision_init(frame_callback_f frame_callback) {
+    static const frame_cmd_t record_table[] = {{0, 0, NULL, NULL, NULL}};
+    init_vision_struct_data();
+    spsc_fifo_init(&vision_rx_fifo, vision_fifo_rx_buf, VISION_FIFO_BUF_LENGTH);
+    vision_rx_chunk_head = vision_rx_chunk_tail = 0;
+    vision_rx_chunk_lost_cnt = 0;
+    if (frame_callback == NULL) {
+        frame_parser_init(&vision_parser, &vision_protocol, vision_cmd_table, 1, vision_frame_update,
+                          vision_unpack_obj.protocol_packet);
+    } else {
+        frame_parser_init(&vision_parser, &vision_protocol, record_table, 1, frame_callback,
+                          vision_unpack_obj.protocol_packet);
+    }
+}
+
+static uint16_t make_frame(uint8_t *p_frame, float yaw, uint16_t seq, uint32_t latency_us) {
+    vision_sync_struct frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.header.sof = VISION_HEADER_SOF;
+    frame.header.data_len = sizeof(vision_frame_data);
+    frame.data.data1 = yaw;
+    frame.data.data3 = seq;
+    frame.data.data4 = latency_us;
+    memcpy(p_frame, &frame, sizeof(frame));
+    append_CRC16_check_sum(p_frame, sizeof(frame));
+    return sizeof(frame);
+}
+
+static void test_chunk_tick(void) {
+    tick_base = 0xFFFFFFFFU - 50000000U;
+    vision_init(record_frame);
+    seen = order_err = 0;
+
+    //串口时间线: 连续发送的字节组成一个片段, 空闲一个字节时间后进入中断
+    uint8_t chunk[USART1_RX_BUF_LENGHT];
+    uint32_t chunk_len = 0, multi_chunk = 0, split_frame = 0;
+    double line_us = 1000.0;
+    uint32_t pending_chunks = 0;
+    int64_t old_err_max = 0;
+    for (uint16_t seq = 0; seq < FRAME_NUM; seq++) {
+        uint8_t frame[FRAME_LEN];
+        uint32_t latency_us = 2000U + rnd(30000U);
+        make_frame(frame, 0.0f, seq, latency_us);
+        //接收完上一片段后相机才可能开始发送, 拍摄时刻 = 开始发送 - 延迟
+        send_us[seq] = line_us;
+        cap_us[seq] = line_us - latency_us;
+        //一帧在中间停顿, 分在两个片段中
+        uint32_t split = rnd(8) == 0 ? 1U + rnd(FRAME_LEN - 1U) : FRAME_LEN;
+        memcpy(&chunk[chunk_len], frame, split);
+        chunk_len += split;
+        line_us += split * BYTE_US;
+        if (split < FRAME_LEN) {
+            now_us = line_us + BYTE_US;
+            vision_rx_chunk_put(chunk, (uint16_t) chunk_len);
+            pending_chunks++;
+            chunk_len = FRAME_LEN - split;
+            memcpy(chunk, &frame[split], chunk_len);
+            line_us = now_us + 100.0 + rnd(500);
+            line_us += chunk_len * BYTE_US;
+            split_frame++;
+        }
+        //一半的帧紧接着下一帧发送, 共用片段
+        if (rnd(2) == 0 && seq + 1U < FRAME_NUM && chunk_len + 2U * FRAME_LEN <= USART1_RX_BUF_LENGHT) {
+            multi_chunk++;
+            continue;
+        }
+        now_us = line_us + BYTE_US;
+        vision_rx_chunk_put(chunk, (uint16_t) chunk_len);
+        pending_chunks++;
+        chunk_len = 0;
+        line_us = now_us + 200.0 + rnd(3000);
+
+        //解析随机滞后几个片段
+        if (rnd(4) == 0 || pending_chunks >= VISION_RX_CHUNK_NUM - 4U || spsc_fifo_used(&vision_rx_fifo) > 512U) {
+            uint32_t before = seen;
+            vision_unpack_fifo_data();
+            //被替换的实现: 所有帧都使用最近一次中断时刻
+            for (uint32_t k = before; k < seen; k++) {
+                int64_t e = (int64_t) (now_us - (FRAME_LEN + 1U) * BYTE_US - send_us[k]);
+                if (e > old_err_max) {
+                    old_err_max = e;
+                }
+            }
+            pending_chunks = 0;
+        }
+    }
+    vision_unpack_fifo_data();
+
+    TEST_ASSERT(seen == FRAME_NUM && order_err == 0);
+    TEST_ASSERT(vision_rx_chunk_lost_cnt == 0 && vision_parser.err_cnt == 0);
+    //误差只来自us取整和波特率取整
+    int64_t err_max = 0;
+    for (uint32_t i = 0; i < FRAME_NUM; i++) {
+        int64_t e = tick_err[i] < 0 ? -tick_err[i] : tick_err[i];
+        if (e > err_max) {
+            err_max = e;
+        }
+    }
+    TEST_ASSERT(err_max <= 3 * CYCLES_PER_US);
+    printf("%u frames, %u shared a chunk, %u split: max error %.2f us (latest-IDLE tick: up to %lld us)\n",
+           FRAME_NUM, multi_chunk, split_frame, (double) err_max / CYCLES_PER_US, (long long) old_err_max);
+}
+
+static void test_chunk_overflow(void) {
+    //片段记录满时丢弃记录, 不覆盖尚未解析的片段, 退回最近一次中断时刻
+    tick_base = 0;
+    vision_init(NULL);
+    uint8_t frame[FRAME_LEN];
+    make_frame(frame, 0.0f, 0, 0);
+    for (uint32_t i = 0; i < VISION_RX_CHUNK_NUM + 3U; i++) {
+        now_us = 1000.0 * (i + 1);
+        vision_rx_chunk_put(frame, FRAME_LEN);
+    }
+    TEST_ASSERT(vision_rx_chunk_lost_cnt == 3);
+    uint32_t transfer_tick = DWT_us_to_tick((uint32_t) ((FRAME_LEN + 1U) * 10U * 1000000ULL / BAUD_RATE));
+    //第一帧使用自己的片段
+    vision_frame_update(frame, FRAME_LEN, 0);
+    TEST_ASSERT(global_vision_info.vision_control.capture_tick == us_tick(1000.0) - transfer_tick);
+    //最后一帧没有记录, 从帧起始到队列末尾按连续发送计算
+    vision_rx_fifo.tail = vision_rx_fifo.head - FRAME_LEN;
+    vision_frame_update(frame, FRAME_LEN, 0);
+    TEST_ASSERT(global_vision_info.vision_control.capture_tick == us_tick(now_us) - transfer_tick);
+    TEST_ASSERT(vision_rx_chunk_tail == vision_rx_chunk_head);
+}
+
+//合成运动: 云台yaw和目标方向, rad
+static double gimbal_yaw(double t) {
+    return 6.2 + 0.35 * sin(2.0 * PI_F * 3.0 * t) + 0.1 * sin(2.0 * PI_F * 7.0 * t);
+}
+
+static double target_yaw(double t) {
+    return 6.2 + 0.2 * sin(2.0 * PI_F * 0.5 * t);
+}
+
+static void replay(uint32_t latency_us, double *p_comp_rms, double *p_plain_rms, uint32_t *p_frames) {
+    tick_base = 0xFFFFFFFFU - 200000000U;
+    vision_init(NULL);
+    attitude_history_init(&history);
+
+    double comp_sum = 0.0, plain_sum = 0.0;
+    uint32_t frames = 0;
+    *p_comp_rms = *p_plain_rms = 0.0;
+    *p_frames = 0;
+    double next_frame_us = 300000.0;
+    //1kHz姿态, 100Hz相机, 回放3s
+    for (uint32_t ms = 0; ms < 3000U; ms++) {
+        now_us = ms * 1000.0;
+        float32_t angle[3] = {(float32_t) gimbal_yaw(now_us * 1e-6), 0.0f, 0.0f};
+        attitude_history_push(&history, DWT_get_tick(), angle);
+        if (now_us < next_frame_us) {
+            continue;
+        }
+        //拍摄时刻的目标偏差, 经过延迟和传输后在本毫秒内到达
+        double capture_us = next_frame_us - latency_us - FRAME_LEN * BYTE_US - BYTE_US;
+        double offset = target_yaw(capture_us * 1e-6) - gimbal_yaw(capture_us * 1e-6);
+        uint8_t frame[FRAME_LEN];
+        make_frame(frame, (float) offset, (uint16_t) frames, latency_us);
+        now_us = next_frame_us;
+        vision_rx_chunk_put(frame, FRAME_LEN);
+        vision_unpack_fifo_data();
+        TEST_ASSERT(global_vision_info.vision_control.update_flag);
+        clear_vision_update_flag();
+
+        uint32_t capture_tick;
+        float32_t target[2];
+        if (!get_vision_target_world(&capture_tick, target)) {
+            TEST_ASSERT(0);
+            return;
+        }
+        //真实目标, 以及直接用当前姿态换算的结果
+        double truth = target_yaw(capture_us * 1e-6);
+        double plain = gimbal_yaw(now_us * 1e-6) + offset;
+        comp_sum += (target[0] - truth) * (target[0] - truth);
+        plain_sum += (plain - truth) * (plain - truth);
+        frames++;
+        next_frame_us += 10000.0;
+    }
+    *p_comp_rms = sqrt(comp_sum / frames);
+    *p_plain_rms = sqrt(plain_sum / frames);
+    *p_frames = frames;
+}
+
+static void test_latency_replay(void) {
+    const uint32_t latency_ms[] = {10, 30, 60};
+    for (int i = 0; i < 3; i++) {
+        double comp_rms, plain_rms;
+        uint32_t frames;
+        replay(latency_ms[i] * 1000U, &comp_rms, &plain_rms, &frames);
+        TEST_ASSERT(frames > 250U && global_vision_info.history_miss_cnt == 0);
+        //剩余误差来自1ms姿态插值和float精度
+        TEST_ASSERT(comp_rms < 2e-3);
+        TEST_ASSERT(comp_rms < 0.1 * plain_rms);
+        printf("latency %2u ms: aim error rms %.2e rad compensated, %.2e rad with the current attitude\n",
+               latency_ms[i], comp_rms, plain_rms);
+    }
+}
+
+static void test_history_miss(void) {
+    tick_base = 0;
+    vision_init(NULL);
+    attitude_history_init(&history);
+    for (uint32_t ms = 0; ms < 1000U; ms++) {
+        now_us = ms * 1000.0;
+        float32_t angle[3] = {1.0f, 0.0f, 0.0f};
+        attitude_history_push(&history, DWT_get_tick(), angle);
+    }
+    //延迟超过姿态历史长度
+    uint8_t frame[FRAME_LEN];
+    make_frame(frame, 0.5f, 0, (ATTITUDE_HISTORY_LEN + 20U) * 1000U);
+    vision_rx_chunk_put(frame, FRAME_LEN);
+    vision_unpack_fifo_data();
+    uint32_t capture_tick;
+    float32_t target[2];
+    TEST_ASSERT(!get_vision_target_world(&capture_tick, target));
+    TEST_ASSERT(global_vision_info.history_miss_cnt == 1);
+
+    //拍摄时刻晚于最新样本时使用最新样本
+    make_frame(frame, 0.5f, 1, 0);
+    now_us += 3000.0;
+    vision_rx_chunk_put(frame, FRAME_LEN);
+    vision_unpack_fifo_data();
+    TEST_ASSERT(get_vision_target_world(&capture_tick, target));
+    TEST_ASSERT_NEAR(target[0], 1.5f, 1e-6f);
+}
+
+int main(void) {
+    RUN_TEST(test_chunk_tick);
+    RUN_TEST(test_chunk_overflow);
+    RUN_TEST(test_latency_replay);
+    RUN_TEST(test_history_miss);
+    return unit_test_result();
+}
@@ -0,0 +1,57 @@
+/**
+  * @file       unit_test.h
+  * @brief      minimal assertions for the host tests, a failed check prints
+  *             its location and the test exits non-zero for ctest.
+  *             主机测试用的最小断言, 检查失败时打印位置, 测试以非零值退出供ctest判断
+  */
+#ifndef UNIT_TEST_H
+#define UNIT_TEST_H
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+
+static int unit_test_failed = 0;
+
+#define TEST_ASSERT(cond)                                                           \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond);                \
+            unit_test_failed++;                                                     \
+        }                                                                           \
+    } while (0)
+
+#define TEST_ASSERT_NEAR(expect, actual, tol)                                       \
+    do {                                                                            \
+        double _e = (double) (expect), _a = (double) (actual);                      \
+        if (!(fabs(_e - _a) <= (double) (tol))) {                                   \
+            printf("%s:%d: %s = %.9g, expected %.9g (tol %g)\n", __FILE__, __LINE__,\
+                   #actual, _a, _e, (double) (tol));                                \
+            unit_test_failed++;                                                     \
+        }                                                                           \
+    } while (0)
+
+#define RUN_TEST(fn)                                                                \
+    do {                                                                            \
+        int _before = unit_test_failed;                                             \
+        fn();                                                                       \
+        printf("%-48s %s\n", #fn, unit_test_failed == _before ? "ok" : "FAILED");   \
+    } while (0)
+
+//主机单调时钟 ns, 基准测试用
+static inline uint64_t unit_test_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline int unit_test_result(void) {
+    if (unit_test_failed) {
+        printf("%d check(s) failed\n", unit_test_failed);
+        return 1;
+    }
+    return 0;
+}
+
+#endif